@@ -0,0 +1,18 @@
+# Check for libbz2. (bzip2)
+# There is no internal copy of libbz2, so bzip2 support
+# is disabled if a system version isn't found.
+
+IF(ENABLE_BZIP2)
+
+# Check for libbz2.
+FIND_PACKAGE(BZip2)
+IF(BZIP2_FOUND)
+	# Found system libbz2.
+	SET(HAVE_BZIP2 1)
+ELSE()
+	# System libbz2 was not found.
+	MESSAGE(STATUS "libbz2 was not found. bzip2 decompression will be disabled.")
+	UNSET(HAVE_BZIP2)
+ENDIF()
+
+ENDIF(ENABLE_BZIP2)
@@ -0,0 +1,18 @@
+# Check for liblzma. (xz)
+# There is no internal copy of liblzma, so xz support
+# is disabled if a system version isn't found.
+
+IF(ENABLE_XZ)
+
+# Check for liblzma.
+FIND_PACKAGE(LibLZMA)
+IF(LIBLZMA_FOUND)
+	# Found system liblzma.
+	SET(HAVE_LZMA 1)
+ELSE()
+	# System liblzma was not found.
+	MESSAGE(STATUS "liblzma was not found. xz decompression will be disabled.")
+	UNSET(HAVE_LZMA)
+ENDIF()
+
+ENDIF(ENABLE_XZ)
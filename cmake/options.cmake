@@ -44,6 +44,8 @@ OPTION(ENABLE_XML "Enable XML parsing for e.g. Windows manifests." ON)
 OPTION(ENABLE_ZSTD "Enable ZSTD decompression. (Required for some unit tests.)" ON)
 OPTION(ENABLE_LZ4 "Enable LZ4 decompression. (Required for some PSP disc formats.)" ON)
 OPTION(ENABLE_LZO "Enable LZO decompression. (Required for some PSP disc formats.)" ON)
+OPTION(ENABLE_XZ "Enable xz decompression. (Uses the system liblzma.)" ON)
+OPTION(ENABLE_BZIP2 "Enable bzip2 decompression. (Uses the system libbz2.)" ON)
 
 IF(WIN32)
 	SET(USE_INTERNAL_ZLIB ON)
@@ -150,6 +152,13 @@ ELSE(CMAKE_SYSTEM_NAME STREQUAL "Linux")
 	SET(INSTALL_APPARMOR OFF)
 ENDIF(CMAKE_SYSTEM_NAME STREQUAL "Linux")
 
+# io_uring for batched reads
+IF(CMAKE_SYSTEM_NAME STREQUAL "Linux")
+	OPTION(ENABLE_IO_URING "Use io_uring for batched reads. (Falls back to pread() at runtime if unavailable.)" ON)
+ELSE(CMAKE_SYSTEM_NAME STREQUAL "Linux")
+	SET(ENABLE_IO_URING OFF)
+ENDIF(CMAKE_SYSTEM_NAME STREQUAL "Linux")
+
 # Special handling for NixOS
 IF(CMAKE_SYSTEM_NAME STREQUAL "Linux")
 	OPTION(ENABLE_NIXOS "Enable special handling for NixOS builds." OFF)
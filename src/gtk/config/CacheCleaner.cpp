@@ -23,8 +23,6 @@ using namespace LibRpFile;
 #include "d_type.h"
 
 // C++ STL classes
-using std::forward_list;
-using std::pair;
 using std::string;
 
 /* Property identifiers */
@@ -233,6 +231,65 @@ rp_cache_cleaner_set_cache_dir(RpCacheCleaner *cleaner, RpCacheDir cache_dir)
 
 /** Internal functions **/
 
+struct DeleteData {
+	RpCacheCleaner *cleaner;
+	GThread *mainThread;	// Progress is only reported on this thread.
+	int count;
+	int total;
+	unsigned int dirErrs;
+	unsigned int fileErrs;
+	bool hasErrors;
+
+	DeleteData()
+		: cleaner(nullptr)
+		, mainThread(nullptr)
+		, count(0)
+		, total(0)
+		, dirErrs(0)
+		, fileErrs(0)
+		, hasErrors(false)
+	{}
+};
+
+/**
+ * recursiveScan() callback: Delete a file or directory.
+ * @param entry Entry
+ * @param userdata DeleteData
+ * @return 0 to continue scanning.
+ */
+static int
+deleteEntry(const RecursiveScanEntry *entry, void *userdata)
+{
+	DeleteData *const data = static_cast<DeleteData*>(userdata);
+
+	if (entry->d_type == DT_DIR) {
+		// Remove the directory.
+		int ret = rmdir(entry->path);
+		if (ret != 0) {
+			data->dirErrs++;
+			data->hasErrors = true;
+		}
+	} else {
+		// Delete the file.
+		// TODO: Does the parent directory mode need to be changed to writable?
+		int ret = unlink(entry->path);
+		if (ret != 0) {
+			data->fileErrs++;
+			data->hasErrors = true;
+		}
+	}
+	data->count++;
+
+	// NOTE: recursiveScan() uses worker threads, and cross-thread
+	// signals aren't safe for GTK, so progress is only reported
+	// when the callback runs on the GUI thread.
+	// TODO: Restrict update frequency to X number of files/directories?
+	if (g_thread_self() == data->mainThread) {
+		g_signal_emit(data->cleaner, signals[SIGNAL_PROGRESS], 0, data->count, data->total, data->hasErrors);
+	}
+	return 0;
+}
+
 /** Methods **/
 
 /**
@@ -304,10 +361,10 @@ rp_cache_cleaner_run(RpCacheCleaner *cleaner)
 	}
 
 	// Recursively scan the cache directory.
-	// TODO: Do we really want to store everything in a list? (Wastes memory.)
-	// Maybe do a simple counting scan first, then delete.
-	forward_list<pair<string, uint8_t> > rlist;
-	int ret = recursiveScan(cacheDir.c_str(), rlist);
+	// The first pass only counts the files and verifies that
+	// the directory only contains cache files.
+	RecursiveScanTotals totals;
+	int ret = recursiveScan(cacheDir.c_str(), RSF_CHECK_CACHE_FILES | RSF_NO_STAT, nullptr, nullptr, &totals);
 	if (ret != 0) {
 		// Non-image file found.
 		const char *s_err;
@@ -327,45 +384,81 @@ rp_cache_cleaner_run(RpCacheCleaner *cleaner)
 		g_signal_emit(cleaner, signals[SIGNAL_ERROR], 0, s_err);
 		g_signal_emit(cleaner, signals[SIGNAL_FINISHED], 0);
 		return;
-	} else if (rlist.empty()) {
+	} else if (totals.files == 0 && totals.dirs == 0) {
 		// Cache directory is empty.
 		g_signal_emit(cleaner, signals[SIGNAL_CACHE_IS_EMPTY], 0, cleaner->cache_dir);
 		g_signal_emit(cleaner, signals[SIGNAL_FINISHED], 0);
 		return;
 	}
 
-	// NOTE: std::forward_list doesn't have size().
-	const size_t rlist_size = std::distance(rlist.cbegin(), rlist.cend());
-
 	// Delete all of the files and subdirectories.
-	g_signal_emit(cleaner, signals[SIGNAL_PROGRESS], 0, 0, static_cast<int>(rlist_size), FALSE);
-	unsigned int count = 0;
-	unsigned int dirErrs = 0, fileErrs = 0;
-	bool hasErrors = false;
-	for (const auto &p : rlist) {
-		if (p.second == DT_DIR) {
-			// Remove the directory.
-			int ret = rmdir(p.first.c_str());
-			if (ret != 0) {
-				dirErrs++;
-				hasErrors = true;
-			}
-		} else {
-			// Delete the file.
-			// TODO: Does the parent directory mode need to be changed to writable?
-			int ret = unlink(p.first.c_str());
-			if (ret != 0) {
-				fileErrs++;
-				hasErrors = true;
-			}
-		}
+	// Subdirectories are reported after their contents.
+	DeleteData data;
+	data.cleaner = cleaner;
+	data.mainThread = g_thread_self();
+	data.total = static_cast<int>(totals.files + totals.dirs);
+	g_signal_emit(cleaner, signals[SIGNAL_PROGRESS], 0, 0, data.total, FALSE);
+	recursiveScan(cacheDir.c_str(), RSF_NO_STAT, deleteEntry, &data);
 
-		// TODO: Restrict update frequency to X number of files/directories?
-		count++;
-		g_signal_emit(cleaner, signals[SIGNAL_PROGRESS], 0, count, static_cast<int>(rlist_size), hasErrors);
-	}
+	// Make sure the final progress is shown.
+	g_signal_emit(cleaner, signals[SIGNAL_PROGRESS], 0, data.count, data.total, data.hasErrors);
 
 	// Directory processed.
-	g_signal_emit(cleaner, signals[SIGNAL_CACHE_CLEARED], 0, cleaner->cache_dir, dirErrs, fileErrs);
+	g_signal_emit(cleaner, signals[SIGNAL_CACHE_CLEARED], 0, cleaner->cache_dir, data.dirErrs, data.fileErrs);
 	g_signal_emit(cleaner, signals[SIGNAL_FINISHED], 0);
 }
+
+/**
+ * Get the usage of a cache directory.
+ * A cache directory that doesn't exist is reported as empty.
+ *
+ * This function doesn't emit any signals, so it can be
+ * called from any thread.
+ *
+ * @param cache_dir	[in] Cache directory
+ * @param pFiles	[out] Number of files
+ * @param pBytes	[out] Total size of all files, in bytes
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int
+rp_cache_cleaner_get_usage(RpCacheDir cache_dir, guint64 *pFiles, guint64 *pBytes)
+{
+	g_return_val_if_fail(pFiles != nullptr, -EINVAL);
+	g_return_val_if_fail(pBytes != nullptr, -EINVAL);
+	*pFiles = 0;
+	*pBytes = 0;
+
+	string cacheDir;
+	switch (cache_dir) {
+		default:
+			assert(!"Invalid cache directory specified.");
+			return -EINVAL;
+		case RP_CD_System:
+			// System thumbnails. (~/.cache/thumbnails)
+			cacheDir = LibUnixCommon::getCacheDirectory();
+			if (!cacheDir.empty()) {
+				cacheDir += "/thumbnails";
+			}
+			break;
+		case RP_CD_RomProperties:
+			// rom-properties cache. (~/.cache/rom-properties)
+			cacheDir = FileSystem::getCacheDirectory();
+			break;
+	}
+
+	if (cacheDir.empty()) {
+		return -ENOENT;
+	} else if (FileSystem::access(cacheDir.c_str(), R_OK) != 0) {
+		// Cache directory doesn't exist. Act like it's empty.
+		return 0;
+	}
+
+	// Only the totals are needed, so no callback.
+	RecursiveScanTotals totals;
+	const int ret = recursiveScanTotals(cacheDir.c_str(), &totals);
+	if (ret == 0) {
+		*pFiles = totals.files;
+		*pBytes = totals.bytes;
+	}
+	return ret;
+}
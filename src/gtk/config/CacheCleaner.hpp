@@ -39,4 +39,18 @@ void		rp_cache_cleaner_set_cache_dir	(RpCacheCleaner *cleaner, RpCacheDir cache_
  */
 void		rp_cache_cleaner_run		(RpCacheCleaner *cleaner) G_GNUC_INTERNAL;
 
+/**
+ * Get the usage of a cache directory.
+ * A cache directory that doesn't exist is reported as empty.
+ *
+ * This function doesn't emit any signals, so it can be
+ * called from any thread.
+ *
+ * @param cache_dir	[in] Cache directory
+ * @param pFiles	[out] Number of files
+ * @param pBytes	[out] Total size of all files, in bytes
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int		rp_cache_cleaner_get_usage	(RpCacheDir cache_dir, guint64 *pFiles, guint64 *pBytes) G_GNUC_INTERNAL;
+
 G_END_DECLS
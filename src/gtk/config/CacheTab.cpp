@@ -38,19 +38,40 @@ struct _RpCacheTabClass {
 	superclass __parent__;
 };
 
+// Cache usage calculation
+// Allocated by rp_cache_tab_update_usage() and freed by
+// rp_cache_tab_usage_calculated(). The worker thread only
+// writes the results.
+struct _RpCacheUsage {
+	RpCacheTab	*tab;		// nullptr if the CacheTab was disposed
+	GThread		*thread;
+
+	// Results (indexed by RpCacheDir)
+	int		ret[2];
+	guint64		files[2];
+	guint64		bytes[2];
+};
+typedef struct _RpCacheUsage RpCacheUsage;
+
 // CacheTab instance
 struct _RpCacheTab {
 	super __parent__;
 
 	GtkWidget	*lblSysCache;
 	GtkWidget	*btnSysCache;
+	GtkWidget	*lblSysCacheUsage;
 	GtkWidget	*lblRpCache;
 	GtkWidget	*btnRpCache;
+	GtkWidget	*lblRpCacheUsage;
 
 	GtkWidget	*lblCacheStatus;
 	GtkWidget	*pbCacheStatus;
 
 	RpCacheCleaner	*ccCleaner;
+
+	// Cache usage calculation that's currently running
+	RpCacheUsage	*usage;
+	gboolean	usage_rerun;	// Recalculate when the current one finishes
 };
 
 static void	rp_cache_tab_dispose			(GObject	*object);
@@ -66,6 +87,11 @@ static void	rp_cache_tab_save				(RpCacheTab	*tab,
 static void	rp_cache_tab_enable_ui_controls		(RpCacheTab	*tab,
 							 gboolean	enable);
 
+// Cache usage
+static void	rp_cache_tab_update_usage		(RpCacheTab	*tab);
+static gpointer	rp_cache_tab_usage_thread_run		(RpCacheUsage	*usage);
+static gboolean	rp_cache_tab_usage_calculated		(RpCacheUsage	*usage);
+
 // Widget signal handlers
 static void	rp_cache_tab_on_btnSysCache_clicked	(GtkButton	*button,
 							 RpCacheTab	*tab);
@@ -161,6 +187,10 @@ rp_cache_tab_init(RpCacheTab *tab)
 	tab->btnSysCache = gtk_button_new_with_label(C_("CacheTab", "Clear the System Thumbnail Cache"));
 	gtk_widget_set_name(tab->btnSysCache, "btnSysCache");
 
+	tab->lblSysCacheUsage = gtk_label_new(nullptr);
+	gtk_widget_set_name(tab->lblSysCacheUsage, "lblSysCacheUsage");
+	GTK_LABEL_XALIGN_LEFT(tab->lblSysCacheUsage);
+
 	tab->lblRpCache = gtk_label_new(
 		C_("CacheTab", "ROM Properties Page maintains its own download cache for external images.\n"
 			       "Clearing this cache will force external images to be redownloaded."));
@@ -171,6 +201,10 @@ rp_cache_tab_init(RpCacheTab *tab)
 	tab->btnRpCache = gtk_button_new_with_label(C_("CacheTab", "Clear the ROM Properties Page Download Cache"));
 	gtk_widget_set_name(tab->btnRpCache, "btnRpCache");
 
+	tab->lblRpCacheUsage = gtk_label_new(nullptr);
+	gtk_widget_set_name(tab->lblRpCacheUsage, "lblRpCacheUsage");
+	GTK_LABEL_XALIGN_LEFT(tab->lblRpCacheUsage);
+
 	tab->lblCacheStatus = gtk_label_new(nullptr);
 	gtk_widget_set_name(tab->lblCacheStatus, "lblCacheStatus");
 	GTK_LABEL_XALIGN_LEFT(tab->lblCacheStatus);
@@ -190,8 +224,10 @@ rp_cache_tab_init(RpCacheTab *tab)
 
 	gtk_box_append(GTK_BOX(tab), tab->lblSysCache);
 	gtk_box_append(GTK_BOX(tab), tab->btnSysCache);
+	gtk_box_append(GTK_BOX(tab), tab->lblSysCacheUsage);
 	gtk_box_append(GTK_BOX(tab), tab->lblRpCache);
 	gtk_box_append(GTK_BOX(tab), tab->btnRpCache);
+	gtk_box_append(GTK_BOX(tab), tab->lblRpCacheUsage);
 
 	// TODO: Spacer and/or alignment?
 	gtk_box_append(GTK_BOX(tab), tab->lblCacheStatus);
@@ -199,8 +235,10 @@ rp_cache_tab_init(RpCacheTab *tab)
 #else /* !GTK_CHECK_VERSION(4,0,0) */
 	gtk_box_pack_start(GTK_BOX(tab), tab->lblSysCache, false, false, 0);
 	gtk_box_pack_start(GTK_BOX(tab), tab->btnSysCache, false, false, 0);
+	gtk_box_pack_start(GTK_BOX(tab), tab->lblSysCacheUsage, false, false, 0);
 	gtk_box_pack_start(GTK_BOX(tab), tab->lblRpCache, false, false, 0);
 	gtk_box_pack_start(GTK_BOX(tab), tab->btnRpCache, false, false, 0);
+	gtk_box_pack_start(GTK_BOX(tab), tab->lblRpCacheUsage, false, false, 0);
 
 	// TODO: Spacer and/or alignment?
 	gtk_box_pack_end(GTK_BOX(tab), tab->pbCacheStatus, false, false, 0);
@@ -215,12 +253,17 @@ rp_cache_tab_init(RpCacheTab *tab)
 
 	gtk_widget_show(tab->lblSysCache);
 	gtk_widget_show(tab->btnSysCache);
+	gtk_widget_show(tab->lblSysCacheUsage);
 	gtk_widget_show(tab->lblRpCache);
 	gtk_widget_show(tab->btnRpCache);
+	gtk_widget_show(tab->lblRpCacheUsage);
 #endif /* GTK_CHECK_VERSION(4,0,0) */
 
 	// Load the current configuration.
 	rp_cache_tab_reset(tab);
+
+	// Get the current cache usage.
+	rp_cache_tab_update_usage(tab);
 }
 
 static void
@@ -233,6 +276,13 @@ rp_cache_tab_dispose(GObject *object)
 
 	g_clear_object(&tab->ccCleaner);
 
+	if (tab->usage) {
+		// The cache usage thread is still running.
+		// rp_cache_tab_usage_calculated() will free the data.
+		tab->usage->tab = nullptr;
+		tab->usage = nullptr;
+	}
+
 	// Call the superclass dispose() function.
 	G_OBJECT_CLASS(rp_cache_tab_parent_class)->dispose(object);
 }
@@ -307,6 +357,108 @@ rp_cache_tab_enable_ui_controls(RpCacheTab *tab, gboolean enable)
 #endif /* GTK_CHECK_VERSION(4,0,0) */
 }
 
+/**
+ * Update the cache usage labels.
+ * The usage is calculated in a separate thread.
+ * @param tab CacheTab
+ */
+static void
+rp_cache_tab_update_usage(RpCacheTab *tab)
+{
+	if (tab->usage) {
+		// Already running. The cache may have changed
+		// since the scan started, so run it again later.
+		tab->usage_rerun = TRUE;
+		return;
+	}
+
+	const char *const s_calc = C_("CacheTab", "Calculating cache usage...");
+	gtk_label_set_text(GTK_LABEL(tab->lblSysCacheUsage), s_calc);
+	gtk_label_set_text(GTK_LABEL(tab->lblRpCacheUsage), s_calc);
+
+	RpCacheUsage *const usage = g_new0(RpCacheUsage, 1);
+	usage->tab = tab;
+	tab->usage = usage;
+	tab->usage_rerun = FALSE;
+
+	// NOTE: rp_cache_tab_usage_calculated() runs on the GUI thread,
+	// so usage->thread is set before it's called.
+	usage->thread = g_thread_new("rpCacheUsage", (GThreadFunc)rp_cache_tab_usage_thread_run, usage);
+}
+
+/**
+ * Calculate the cache usage.
+ * This runs in a separate thread, and posts the results
+ * to the GUI thread using g_idle_add().
+ *
+ * @param usage Cache usage
+ * @return 0
+ */
+static gpointer
+rp_cache_tab_usage_thread_run(RpCacheUsage *usage)
+{
+	static const RpCacheDir cacheDirs[] = {RP_CD_System, RP_CD_RomProperties};
+	for (const RpCacheDir cache_dir : cacheDirs) {
+		usage->ret[cache_dir] = rp_cache_cleaner_get_usage(cache_dir,
+			&usage->files[cache_dir], &usage->bytes[cache_dir]);
+	}
+
+	g_idle_add(G_SOURCE_FUNC(rp_cache_tab_usage_calculated), usage);
+	return GINT_TO_POINTER(0);
+}
+
+/**
+ * The cache usage has been calculated. Update the labels.
+ * Called using g_idle_add().
+ * @param usage Cache usage
+ * @return G_SOURCE_REMOVE
+ */
+static gboolean
+rp_cache_tab_usage_calculated(RpCacheUsage *usage)
+{
+	// The thread has already posted this callback, so it's finished.
+	g_thread_join(usage->thread);
+
+	RpCacheTab *const tab = usage->tab;
+	if (!tab) {
+		// The CacheTab was disposed.
+		g_free(usage);
+		return G_SOURCE_REMOVE;
+	}
+
+	static const RpCacheDir cacheDirs[] = {RP_CD_System, RP_CD_RomProperties};
+	for (const RpCacheDir cache_dir : cacheDirs) {
+		GtkWidget *const lblUsage = (cache_dir == RP_CD_System)
+			? tab->lblSysCacheUsage
+			: tab->lblRpCacheUsage;
+
+		if (usage->ret[cache_dir] != 0) {
+			gtk_label_set_text(GTK_LABEL(lblUsage), C_("CacheTab", "Unable to calculate the cache usage."));
+			continue;
+		}
+
+		const guint64 files = usage->files[cache_dir];
+		char s_files[32];
+		snprintf(s_files, sizeof(s_files), "%" G_GUINT64_FORMAT, files);
+		// tr: %1$s == total size, %2$s == number of files
+		const string s_usage = rp_sprintf_p(NC_("CacheTab",
+			"Current usage: %1$s in %2$s file",
+			"Current usage: %1$s in %2$s files",
+			static_cast<unsigned long>(files)),
+			formatFileSize(static_cast<off64_t>(usage->bytes[cache_dir])).c_str(), s_files);
+		gtk_label_set_text(GTK_LABEL(lblUsage), s_usage.c_str());
+	}
+
+	tab->usage = nullptr;
+	g_free(usage);
+
+	if (tab->usage_rerun) {
+		// The cache was changed while the usage was being calculated.
+		rp_cache_tab_update_usage(tab);
+	}
+	return G_SOURCE_REMOVE;
+}
+
 static inline
 void gtk_progress_bar_set_error(GtkProgressBar *pb, gboolean error)
 {
@@ -563,6 +715,9 @@ ccCleaner_finished(RpCacheCleaner *cleaner, RpCacheTab *tab)
 {
 	RP_UNUSED(cleaner);
 	rp_cache_tab_enable_ui_controls(tab, TRUE);
+
+	// The cache usage has changed.
+	rp_cache_tab_update_usage(tab);
 }
 
 /** Widget signal handlers **/
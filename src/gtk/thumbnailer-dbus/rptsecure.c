@@ -43,6 +43,10 @@ int rpt_do_security_options(void)
 		SCMP_SYS(getppid),	// dll-search.c: walk_proc_tree()
 		SCMP_SYS(getuid),	// TODO: Only use geteuid()?
 		SCMP_SYS(lseek), SCMP_SYS(_llseek),
+		SCMP_SYS(pread64), SCMP_SYS(preadv),	// IRpFile::readAt(), readAtV()
+		SCMP_SYS(fadvise64), SCMP_SYS(fadvise64_64),	// IRpFile::advise()
+		SCMP_SYS(arm_fadvise64_64),	// CPU-specific syscall for Linux on 32-bit ARM
+		SCMP_SYS(madvise),	// IRpFile::advise() [memory-mapped files]
 		SCMP_SYS(lstat), SCMP_SYS(lstat64),	// LibRpBase::FileSystem::is_symlink(), resolve_symlink()
 		SCMP_SYS(mkdir),	// g_mkdir_with_parents() [rp_thumbnailer_process()]
 		SCMP_SYS(mmap),		// iconv_open(), dlopen()
@@ -19,8 +19,6 @@
 using namespace LibRpFile;
 
 // C++ STL classes
-using std::forward_list;
-using std::pair;
 using std::string;
 
 /** CacheCleaner **/
@@ -28,16 +26,121 @@ using std::string;
 CacheCleaner::CacheCleaner(QObject *parent, CacheCleaner::CacheDir cacheDir)
 	: super(parent)
 	, m_cacheDir(cacheDir)
+	, m_usageOnly(false)
 {
 	qRegisterMetaType<CacheDir>();
 }
 
+struct CacheCleaner::DeleteData {
+	CacheCleaner *cleaner;
+	int count;
+	int total;
+	unsigned int dirErrs;
+	unsigned int fileErrs;
+	bool hasErrors;
+
+	DeleteData()
+		: cleaner(nullptr)
+		, count(0)
+		, total(0)
+		, dirErrs(0)
+		, fileErrs(0)
+		, hasErrors(false)
+	{}
+};
+
+/**
+ * recursiveScan() callback: Delete a file or directory.
+ * NOTE: This may be called from a worker thread.
+ * @param entry Entry
+ * @param userdata DeleteData
+ * @return 0 to continue scanning.
+ */
+int CacheCleaner::deleteEntry(const RecursiveScanEntry *entry, void *userdata)
+{
+	DeleteData *const data = static_cast<DeleteData*>(userdata);
+
+	if (entry->d_type == DT_DIR) {
+		// Remove the directory.
+		int ret = rmdir(entry->path);
+		if (ret != 0) {
+			data->dirErrs++;
+			data->hasErrors = true;
+		}
+	} else {
+		// Delete the file.
+		// TODO: Does the parent directory mode need to be changed to writable?
+		int ret = unlink(entry->path);
+		if (ret != 0) {
+			data->fileErrs++;
+			data->hasErrors = true;
+		}
+	}
+
+	// TODO: Restrict update frequency to X number of files/directories?
+	data->count++;
+	emit data->cleaner->progress(data->count, data->total, data->hasErrors);
+	return 0;
+}
+
+/**
+ * Get the usage of a cache directory.
+ * A cache directory that doesn't exist is reported as empty.
+ * @param cacheDir	[in] Cache directory
+ * @param pTotals	[out] Totals
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int CacheCleaner::getUsage(CacheDir cacheDir, RecursiveScanTotals *pTotals)
+{
+	memset(pTotals, 0, sizeof(*pTotals));
+
+	string path;
+	switch (cacheDir) {
+		default:
+			assert(!"Invalid cache directory specified.");
+			return -EINVAL;
+		case CacheCleaner::CD_System:
+			// System thumbnails. (~/.cache/thumbnails)
+			path = LibUnixCommon::getCacheDirectory();
+			if (!path.empty()) {
+				path += "/thumbnails";
+			}
+			break;
+		case CacheCleaner::CD_RomProperties:
+			// rom-properties cache. (~/.cache/rom-properties)
+			path = FileSystem::getCacheDirectory();
+			break;
+	}
+
+	if (path.empty()) {
+		return -ENOENT;
+	} else if (FileSystem::access(path.c_str(), R_OK) != 0) {
+		// Cache directory doesn't exist. Act like it's empty.
+		return 0;
+	}
+
+	// Only the totals are needed, so no callback.
+	return recursiveScanTotals(path.c_str(), pTotals);
+}
+
 /**
  * Run the task.
  * This should be connected to QThread::started().
  */
 void CacheCleaner::run(void)
 {
+	if (m_usageOnly) {
+		// Get the usage of all cache directories.
+		static const CacheDir cacheDirs[] = {CD_System, CD_RomProperties};
+		for (const CacheDir cacheDir : cacheDirs) {
+			RecursiveScanTotals totals;
+			const int ret = getUsage(cacheDir, &totals);
+			emit cacheUsage(cacheDir, ret, totals.files, totals.bytes);
+		}
+		emit finished();
+		return;
+	}
+
 	string cacheDir;
 	const char *s_err = nullptr;
 	switch (m_cacheDir) {
@@ -92,10 +195,10 @@ void CacheCleaner::run(void)
 	}
 
 	// Recursively scan the cache directory.
-	// TODO: Do we really want to store everything in a list? (Wastes memory.)
-	// Maybe do a simple counting scan first, then delete.
-	forward_list<pair<string, uint8_t> > rlist;
-	int ret = recursiveScan(cacheDir.c_str(), rlist);
+	// The first pass only counts the files and verifies that
+	// the directory only contains cache files.
+	RecursiveScanTotals totals;
+	int ret = recursiveScan(cacheDir.c_str(), RSF_CHECK_CACHE_FILES | RSF_NO_STAT, nullptr, nullptr, &totals);
 	if (ret != 0) {
 		// Non-image file found.
 		switch (m_cacheDir) {
@@ -114,7 +217,7 @@ void CacheCleaner::run(void)
 		emit error(U82Q(s_err));
 		emit finished();
 		return;
-	} else if (rlist.empty()) {
+	} else if (totals.files == 0 && totals.dirs == 0) {
 		// Cache directory is empty.
 		emit progress(1, 1, false);
 		emit cacheIsEmpty(m_cacheDir);
@@ -122,38 +225,15 @@ void CacheCleaner::run(void)
 		return;
 	}
 
-	// NOTE: std::forward_list doesn't have size().
-	const size_t rlist_size = std::distance(rlist.cbegin(), rlist.cend());
-
 	// Delete all of the files and subdirectories.
-	emit progress(0, static_cast<int>(rlist_size), false);
-	unsigned int count = 0;
-	unsigned int dirErrs = 0, fileErrs = 0;
-	bool hasErrors = false;
-	for (const auto &p : rlist) {
-		if (p.second == DT_DIR) {
-			// Remove the directory.
-			int ret = rmdir(p.first.c_str());
-			if (ret != 0) {
-				dirErrs++;
-				hasErrors = true;
-			}
-		} else {
-			// Delete the file.
-			// TODO: Does the parent directory mode need to be changed to writable?
-			int ret = unlink(p.first.c_str());
-			if (ret != 0) {
-				fileErrs++;
-				hasErrors = true;
-			}
-		}
-
-		// TODO: Restrict update frequency to X number of files/directories?
-		count++;
-		emit progress(count, static_cast<int>(rlist_size), hasErrors);
-	}
+	// Subdirectories are reported after their contents.
+	DeleteData data;
+	data.cleaner = this;
+	data.total = static_cast<int>(totals.files + totals.dirs);
+	emit progress(0, data.total, false);
+	recursiveScan(cacheDir.c_str(), RSF_NO_STAT, deleteEntry, &data);
 
 	// Directory processed.
-	emit cacheCleared(m_cacheDir, dirErrs, fileErrs);
+	emit cacheCleared(m_cacheDir, data.dirErrs, data.fileErrs);
 	emit finished();
 }
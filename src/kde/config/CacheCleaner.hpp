@@ -10,12 +10,18 @@
 
 #include <QtCore/QObject>
 
+namespace LibRpFile {
+	struct RecursiveScanEntry;
+	struct RecursiveScanTotals;
+}
+
 class CacheCleaner : public QObject
 {
 Q_OBJECT
 
 Q_ENUMS(CacheCleaner::CacheDir)
 Q_PROPERTY(CacheCleaner::CacheDir cacheDir READ cacheDir WRITE setCacheDir)
+Q_PROPERTY(bool usageOnly READ usageOnly WRITE setUsageOnly)
 
 public:
 	enum CacheDir {
@@ -49,6 +55,27 @@ public:
 		m_cacheDir = cacheDir;
 	}
 
+	/**
+	 * Is this a usage-only task?
+	 * @return True if run() only gets the cache usage; false if it clears the cache.
+	 */
+	inline bool usageOnly(void) const
+	{
+		return m_usageOnly;
+	}
+
+	/**
+	 * Set the usage-only flag.
+	 * If set, run() gets the usage of all cache directories
+	 * instead of clearing the selected cache directory.
+	 * NOTE: Only do this when the object isn't running!
+	 * @param usageOnly True for usage only; false to clear the cache.
+	 */
+	inline void setUsageOnly(bool usageOnly)
+	{
+		m_usageOnly = usageOnly;
+	}
+
 public slots:
 	/**
 	 * Run the task.
@@ -85,14 +112,45 @@ signals:
 	 */
 	void cacheCleared(CacheCleaner::CacheDir cacheDir, unsigned int dirErrs, unsigned int fileErrs);
 
+	/**
+	 * Cache usage has been calculated. (usage-only task)
+	 * @param cacheDir Which cache directory was checked.
+	 * @param err 0 on success; negative POSIX error code on error.
+	 * @param files Number of files.
+	 * @param bytes Total size of all files, in bytes.
+	 */
+	void cacheUsage(CacheCleaner::CacheDir cacheDir, int err, quint64 files, quint64 bytes);
+
 	/**
 	 * Cache cleaning task has completed.
 	 * This is called when run() exits, regardless of status.
 	 */
 	void finished(void);
 
+private:
+	struct DeleteData;
+
+	/**
+	 * recursiveScan() callback: Delete a file or directory.
+	 * NOTE: This may be called from a worker thread.
+	 * @param entry Entry
+	 * @param userdata DeleteData
+	 * @return 0 to continue scanning.
+	 */
+	static int deleteEntry(const LibRpFile::RecursiveScanEntry *entry, void *userdata);
+
+	/**
+	 * Get the usage of a cache directory.
+	 * A cache directory that doesn't exist is reported as empty.
+	 * @param cacheDir	[in] Cache directory
+	 * @param pTotals	[out] Totals
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	static int getUsage(CacheDir cacheDir, LibRpFile::RecursiveScanTotals *pTotals);
+
 protected:
 	CacheDir m_cacheDir;
+	bool m_usageOnly;
 };
 
 Q_DECLARE_METATYPE(CacheCleaner::CacheDir)
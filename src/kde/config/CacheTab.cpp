@@ -44,6 +44,11 @@ public:
 	QThread thrCleaner;
 	CacheCleaner ccCleaner;
 
+	// Cache usage object and thread.
+	QThread thrUsage;
+	CacheCleaner ccUsage;
+	bool usagePending;	// Update the usage again once thrUsage finishes.
+
 public:
 	/**
 	 * Enable/disable the UI controls.
@@ -56,6 +61,12 @@ public:
 	 * @param cacheDir Cache directory.
 	 */
 	void clearCacheDir(CacheCleaner::CacheDir cacheDir);
+
+	/**
+	 * Update the cache usage labels.
+	 * The usage is calculated in a separate thread.
+	 */
+	void updateUsage(void);
 };
 
 /** CacheTabPrivate **/
@@ -63,6 +74,8 @@ public:
 CacheTabPrivate::CacheTabPrivate(CacheTab *q)
 	: q_ptr(q)
 	, thrCleaner(q)
+	, thrUsage(q)
+	, usagePending(false)
 {
 	thrCleaner.setObjectName(QLatin1String("thrCleaner"));
 
@@ -86,17 +99,34 @@ CacheTabPrivate::CacheTabPrivate(CacheTab *q)
 			 &ccCleaner, SLOT(run()));
 	QObject::connect(&ccCleaner, SIGNAL(finished()),
 			 &thrCleaner, SLOT(quit()));
+
+	// Cache usage object.
+	thrUsage.setObjectName(QLatin1String("thrUsage"));
+	ccUsage.setObjectName(QLatin1String("ccUsage"));
+	ccUsage.setUsageOnly(true);
+	ccUsage.moveToThread(&thrUsage);
+
+	QObject::connect(&ccUsage, SIGNAL(cacheUsage(CacheCleaner::CacheDir,int,quint64,quint64)),
+			 q, SLOT(ccUsage_cacheUsage(CacheCleaner::CacheDir,int,quint64,quint64)));
+	QObject::connect(&thrUsage, SIGNAL(started()),
+			 &ccUsage, SLOT(run()));
+	QObject::connect(&ccUsage, SIGNAL(finished()),
+			 &thrUsage, SLOT(quit()));
+	QObject::connect(&thrUsage, SIGNAL(finished()),
+			 q, SLOT(thrUsage_finished()));
 }
 
 CacheTabPrivate::~CacheTabPrivate()
 {
-	if (thrCleaner.isRunning()) {
-		// Make sure the thread is stopped.
-		thrCleaner.quit();
-		const bool ok = thrCleaner.wait(5000);
-		if (!ok) {
-			// Thread is hung. Terminate it.
-			thrCleaner.terminate();
+	for (QThread *thread : {&thrCleaner, &thrUsage}) {
+		if (thread->isRunning()) {
+			// Make sure the thread is stopped.
+			thread->quit();
+			const bool ok = thread->wait(5000);
+			if (!ok) {
+				// Thread is hung. Terminate it.
+				thread->terminate();
+			}
 		}
 	}
 }
@@ -165,6 +195,26 @@ void CacheTabPrivate::clearCacheDir(CacheCleaner::CacheDir cacheDir)
 	thrCleaner.start();
 }
 
+/**
+ * Update the cache usage labels.
+ * The usage is calculated in a separate thread.
+ */
+void CacheTabPrivate::updateUsage(void)
+{
+	if (thrUsage.isRunning()) {
+		// Usage thread is already running.
+		// Run it again once it's finished.
+		usagePending = true;
+		return;
+	}
+
+	usagePending = false;
+	const QString qs_calc = QC_("CacheTab", "Calculating cache usage...");
+	ui.lblSysCacheUsage->setText(qs_calc);
+	ui.lblRpCacheUsage->setText(qs_calc);
+	thrUsage.start();
+}
+
 /** CacheTab **/
 
 CacheTab::CacheTab(QWidget *parent)
@@ -177,6 +227,9 @@ CacheTab::CacheTab(QWidget *parent)
 	// Hide the status widgets.
 	d->ui.lblStatus->hide();
 	d->ui.pbStatus->hide();
+
+	// Get the current cache usage.
+	d->updateUsage();
 }
 
 CacheTab::~CacheTab()
@@ -333,4 +386,56 @@ void CacheTab::ccCleaner_finished(void)
 {
 	Q_D(CacheTab);
 	d->enableUiControls(true);
+
+	// The cache usage has changed.
+	d->updateUsage();
+}
+
+/**
+ * Cache usage has been calculated.
+ * @param cacheDir Which cache directory was checked.
+ * @param err 0 on success; negative POSIX error code on error.
+ * @param files Number of files.
+ * @param bytes Total size of all files, in bytes.
+ */
+void CacheTab::ccUsage_cacheUsage(CacheCleaner::CacheDir cacheDir, int err, quint64 files, quint64 bytes)
+{
+	Q_D(CacheTab);
+	QLabel *lblUsage;
+	switch (cacheDir) {
+		default:
+			assert(!"Invalid cache directory specified.");
+			return;
+		case CacheCleaner::CD_System:
+			lblUsage = d->ui.lblSysCacheUsage;
+			break;
+		case CacheCleaner::CD_RomProperties:
+			lblUsage = d->ui.lblRpCacheUsage;
+			break;
+	}
+
+	if (err != 0) {
+		lblUsage->setText(QC_("CacheTab", "Unable to calculate the cache usage."));
+		return;
+	}
+
+	// tr: %1 == total size, %2 == number of files
+	lblUsage->setText(QNC_("CacheTab",
+		"Current usage: %1 in %2 file",
+		"Current usage: %1 in %2 files",
+		static_cast<unsigned long>(files))
+		.arg(U82Q(formatFileSize(static_cast<off64_t>(bytes))))
+		.arg(QLocale().toString(files)));
+}
+
+/**
+ * Cache usage thread has finished.
+ */
+void CacheTab::thrUsage_finished(void)
+{
+	Q_D(CacheTab);
+	if (d->usagePending) {
+		// The cache was cleared while the usage was being calculated.
+		d->updateUsage();
+	}
 }
@@ -93,4 +93,18 @@ private slots:
 	 * This is called when run() exits, regardless of status.
 	 */
 	void ccCleaner_finished(void);
+
+	/**
+	 * Cache usage has been calculated.
+	 * @param cacheDir Which cache directory was checked.
+	 * @param err 0 on success; negative POSIX error code on error.
+	 * @param files Number of files.
+	 * @param bytes Total size of all files, in bytes.
+	 */
+	void ccUsage_cacheUsage(CacheCleaner::CacheDir cacheDir, int err, quint64 files, quint64 bytes);
+
+	/**
+	 * Cache usage thread has finished.
+	 */
+	void thrUsage_finished(void);
 };
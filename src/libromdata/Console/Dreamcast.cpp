@@ -25,6 +25,7 @@ using namespace LibRpTexture;
 #include "disc/IsoPartition.hpp"
 #include "disc/GdiReader.hpp"
 #include "disc/CdiReader.hpp"
+#include "disc/ChdReader.hpp"
 
 // Other RomData subclasses
 #include "Media/ISO.hpp"
@@ -48,7 +49,7 @@ private:
 
 public:
 	/** RomDataInfo **/
-	static const array<const char*, 4+1> exts;
+	static const array<const char*, 5+1> exts;
 	static const array<const char*, 6+1> mimeTypes;
 	static const RomDataInfo romDataInfo;
 
@@ -60,6 +61,7 @@ public:
 		Iso2352	= 1,	// ISO-9660, 2352-byte sectors.
 		GDI	= 2,	// GD-ROM cuesheet
 		CDI	= 3,	// DiscJuggler image
+		CHD	= 4,	// MAME CHD (GD-ROM)
 
 		Max
 	};
@@ -72,7 +74,7 @@ public:
 	int iso_start_offset;
 
 	// Disc reader
-	// NOTE: May be GdiReader. (TODO: std::variant<> so we don't need dynamic_cast<>?)
+	// NOTE: May be GdiReader, CdiReader, or ChdReader. (TODO: std::variant<> so we don't need dynamic_cast<>?)
 	IDiscReaderPtr discReader;
 
 	// ISO-9660 data track (GD data, not CD data)
@@ -117,11 +119,12 @@ ROMDATA_IMPL_IMG_TYPES(Dreamcast)
 /** DreamcastPrivate **/
 
 /* RomDataInfo */
-const array<const char*, 4+1> DreamcastPrivate::exts = {{
+const array<const char*, 5+1> DreamcastPrivate::exts = {{
 	".iso",	// ISO-9660 (2048-byte)
 	".bin",	// Raw (2352-byte)
 	".gdi",	// GD-ROM cuesheet
 	".cdi",	// DiscJuggler
+	".chd",	// MAME CHD
 
 	// TODO: Add these formats?
 	//".nrg",	// Nero
@@ -200,7 +203,8 @@ rp_image_const_ptr DreamcastPrivate::load0GDTEX(void)
 	if (!isoPartition) {
 		switch (discType) {
 			case DiscType::GDI:
-			case DiscType::CDI: {
+			case DiscType::CDI:
+			case DiscType::CHD: {
 				// Open track 3 as ISO-9660.
 				MultiTrackSparseDiscReader *const mtsDiscReader = dynamic_cast<MultiTrackSparseDiscReader*>(discReader.get());
 				assert(mtsDiscReader != nullptr);
@@ -369,6 +373,15 @@ Dreamcast::Dreamcast(const IRpFilePtr &file)
 		return;
 	}
 
+	if (d->discType == DreamcastPrivate::DiscType::Iso2048) {
+		// If this is a GD-ROM CHD, track 1 was detected.
+		// Use track 3 instead.
+		const ChdReader *const chdReader = dynamic_cast<const ChdReader*>(d->file.get());
+		if (chdReader && chdReader->isGdrom()) {
+			d->discType = DreamcastPrivate::DiscType::CHD;
+		}
+	}
+
 	switch (d->discType) {
 		case DreamcastPrivate::DiscType::Iso2048:
 			// 2048-byte sectors
@@ -395,17 +408,22 @@ Dreamcast::Dreamcast(const IRpFilePtr &file)
 		}
 
 		case DreamcastPrivate::DiscType::GDI:
-		case DreamcastPrivate::DiscType::CDI: {
-			// GD-ROM cuesheet or DiscJuggler image
+		case DreamcastPrivate::DiscType::CDI:
+		case DreamcastPrivate::DiscType::CHD: {
+			// GD-ROM cuesheet, DiscJuggler image, or GD-ROM CHD
 			// GDI does't use iso_start_offset.
 			// CDI manages its own iso_start_offset.
 			const char *mimeType;
 			if (d->discType == DreamcastPrivate::DiscType::GDI) {
 				d->discReader = std::make_shared<CdiReader>(d->file);
 				mimeType = "application/x-gd-rom-cue";
-			} else /*if (d->discType == DreamcastPrivate::DiscType::CDI)*/ {
+			} else if (d->discType == DreamcastPrivate::DiscType::CDI) {
 				d->discReader = std::make_shared<CdiReader>(d->file);
 				mimeType = "application/x-discjuggler-cd-image";
+			} else /*if (d->discType == DreamcastPrivate::DiscType::CHD)*/ {
+				// The file is already a ChdReader.
+				d->discReader = std::dynamic_pointer_cast<ChdReader>(d->file);
+				mimeType = "application/x-dreamcast-rom";	// unofficial
 			}
 
 			MultiTrackSparseDiscReader *const mtsDiscReader = static_cast<MultiTrackSparseDiscReader*>(d->discReader.get());
@@ -810,7 +828,8 @@ int Dreamcast::loadFieldData(void)
 	ISOPtr isoData;
 	switch (d->discType) {
 		case DreamcastPrivate::DiscType::GDI:
-		case DreamcastPrivate::DiscType::CDI: {
+		case DreamcastPrivate::DiscType::CDI:
+		case DreamcastPrivate::DiscType::CHD: {
 			// Open track 3 as ISO-9660.
 			MultiTrackSparseDiscReader *const mtsDiscReader = dynamic_cast<MultiTrackSparseDiscReader*>(d->discReader.get());
 			assert(mtsDiscReader != nullptr);
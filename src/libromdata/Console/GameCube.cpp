@@ -7,6 +7,8 @@
  ***************************************************************************/
 
 #include "stdafx.h"
+#include "config.librpbase.h"
+
 #include "GameCube.hpp"
 
 #include "gcn_structs.h"
@@ -29,8 +31,9 @@ using namespace LibRpTexture;
 
 // WiiPartition reader
 #include "disc/WiiPartition.hpp"
-// NASOSReader to check if it's a NASOS format disc image
+// NASOSReader and WiaReader to check for unencrypted partitions
 #include "disc/NASOSReader.hpp"
+#include "disc/WiaReader.hpp"
 
 // For sections delegated to other RomData subclasses.
 #include "GameCubeBNR.hpp"
@@ -85,7 +88,9 @@ public:
 		DISC_FORMAT_TGC   = (2U << 8),		// TGC (embedded disc image) (GCN only?)
 
 		// WIA and RVZ formats are similar
-		// TODO: Remove this once proper SparseDiscReader subclasses are added.
+		// NOTE: These are normally handled by WiaReader. They're only
+		// used if WiaReader can't open the image, e.g. if it uses
+		// an unsupported compression method.
 		DISC_FORMAT_WIA   = (3U << 8),		// WIA image (Header only!)
 		DISC_FORMAT_RVZ   = (4U << 8),		// RVZ image (Header only!)
 
@@ -140,17 +145,21 @@ public:
 	WiiPartition *gamePartition;
 
 	/**
-	 * Is this a NASOS format disc image?
+	 * Is this a disc image with decrypted Wii partitions, e.g. NASOS or WIA/RVZ?
 	 *
 	 * RomDataFactory handles SparseDiscReader subclasses itself now,
-	 * so this works by checking if d->file is a NASOSReader.
+	 * so this works by checking if d->file is a NASOSReader or WiaReader.
 	 *
-	 * @return True if this is a NASOS format disc image.
+	 * @return True if this is a disc image with decrypted Wii partitions.
 	 */
-	bool isNASOSFormatDiscImage(void) const
+	bool isDecryptedDiscImage(void) const
 	{
 		const NASOSReader *const nasos = dynamic_cast<NASOSReader*>(file.get());
-		return (nasos != nullptr);
+		if (nasos) {
+			return true;
+		}
+		const WiaReader *const wia = dynamic_cast<WiaReader*>(file.get());
+		return (wia && wia->hasDecryptedPartitions());
 	}
 
 	/**
@@ -213,8 +222,6 @@ const array<const char*, 13+1> GameCubePrivate::exts = {{
 	".dec",	// .iso.dec
 	".gcz",
 	".dpf", ".rpf",
-
-	// Partially supported. (Header only!)
 	".wia",
 	".rvz",	// based on WIA
 
@@ -331,7 +338,7 @@ int GameCubePrivate::loadWiiPartitionTables(void)
 	// Check the crypto and hash method.
 	// TODO: Lookup table instead of branches?
 	unsigned int cryptoMethod = 0;
-	if (discHeader.disc_noCrypto != 0 || isNASOSFormatDiscImage()) {
+	if (discHeader.disc_noCrypto != 0 || isDecryptedDiscImage()) {
 		// No encryption.
 		cryptoMethod |= WiiPartition::CM_UNENCRYPTED;
 	}
@@ -459,7 +466,7 @@ int GameCubePrivate::loadOpeningBnr(void)
 		return 0;
 	}
 
-	// FIXME: No DiscReader for WIA or RVZ yet.
+	// WIA or RVZ that WiaReader couldn't open: Only the header is available.
 	switch (discType & DISC_FORMAT_MASK) {
 		default:
 			break;
@@ -723,14 +730,14 @@ GameCube::GameCube(const IRpFilePtr &file)
 		}
 
 		case GameCubePrivate::DISC_FORMAT_WIA:
-			// TODO: Implement WiaReader.
-			// For now, only the header will be readable.
+			// WiaReader couldn't open this image.
+			// Only the header will be readable.
 			d->mimeType = "application/x-wia";
 			d->discReader = nullptr;
 			break;
 		case GameCubePrivate::DISC_FORMAT_RVZ:
-			// TODO: Implement RvzReader.
-			// For now, only the header will be readable.
+			// WiaReader couldn't open this image.
+			// Only the header will be readable.
 			d->mimeType = "application/x-rvz-image";
 			d->discReader = nullptr;
 			break;
@@ -750,7 +757,7 @@ GameCube::GameCube(const IRpFilePtr &file)
 	}
 
 	if (!d->discReader) {
-		// No WiaReader or RvzReader yet. If this is WIA or RVZ,
+		// WiaReader couldn't open this image. If this is WIA or RVZ,
 		// retrieve the header from header[].
 		switch (d->discType & GameCubePrivate::DISC_FORMAT_MASK) {
 			case GameCubePrivate::DISC_FORMAT_WIA:
@@ -855,7 +862,7 @@ GameCube::GameCube(const IRpFilePtr &file)
 	}
 
 	if (((d->discType & GameCubePrivate::DISC_SYSTEM_MASK) != GameCubePrivate::DISC_SYSTEM_UNKNOWN) ||
-	      d->isNASOSFormatDiscImage())
+	      d->isDecryptedDiscImage())
 	{
 		// Verify that the NASOS header matches the disc format.
 		bool isOK = true;
@@ -1096,7 +1103,8 @@ int GameCube::isRomSupported_static(const DetectInfo *info)
 	}
 
 	// Check for WIA or RVZ.
-	// TODO: Remove this when a proper SparseDiscReader subclass is added.
+	// NOTE: RomDataFactory normally opens these using WiaReader.
+	// This is only reached if WiaReader couldn't open the image.
 	static constexpr uint32_t wia_magic = 'WIA\x01';
 	static constexpr uint32_t rvz_magic = 'RVZ\x01';
 	if (pData32[0] == cpu_to_be32(rvz_magic) ||
@@ -1121,7 +1129,6 @@ int GameCube::isRomSupported_static(const DetectInfo *info)
 		}
 
 		// Check the GameCube/Wii magic.
-		// TODO: WIA struct when full WIA support is added.
 		gcn_header = reinterpret_cast<const GCN_DiscHeader*>(&info->header.pData[0x58]);
 		if (gcn_header->magic_wii == cpu_to_be32(WII_MAGIC)) {
 			// Wii disc image. (WIA format)
@@ -1347,7 +1354,7 @@ int GameCube::loadFieldData(void)
 
 	// The remaining fields are not located in the disc header.
 	// If we can't read the disc contents for some reason, e.g.
-	// unimplemented DiscReader (WIA), skip the fields.
+	// WIA/RVZ image that WiaReader couldn't open, skip the fields.
 	if (!d->discReader) {
 		// Cannot read the disc contents.
 		// We're done for now.
@@ -1708,8 +1715,8 @@ int GameCube::loadFieldData(void)
 
 			// Encryption key
 			WiiTicket::EncryptionKeys encKey;
-			if (d->isNASOSFormatDiscImage()) {
-				// NASOS disc image.
+			if (d->isDecryptedDiscImage()) {
+				// NASOS or WIA/RVZ disc image.
 				// If this would normally be an encrypted image, use encKeyReal().
 				encKey = (d->discHeader.disc_noCrypto == 0
 					? entry.partition->encKeyReal()
@@ -1891,7 +1898,7 @@ int GameCube::loadInternalImage(ImageType imageType, rp_image_const_ptr &pImage)
 
 		case GameCubePrivate::DISC_FORMAT_WIA:
 		case GameCubePrivate::DISC_FORMAT_RVZ:
-			// WIA/RVZ isn't fully supported, so we can't load images.
+			// WiaReader couldn't open this image, so we can't load images.
 			pImage.reset();
 			return -ENOENT;
 	}
@@ -2076,6 +2083,135 @@ int GameCube::extURLs(ImageType imageType, vector<ExtURL> *pExtURLs, int size) c
 	return 0;
 }
 
+/**
+ * Get the list of operations that can be performed on this ROM.
+ * Internal function; called by RomData::romOps().
+ * @return List of operations.
+ */
+vector<RomData::RomOp> GameCube::romOps_int(void) const
+{
+	RP_D(const GameCube);
+	vector<RomOp> ops;
+	if (!d->isValid || ((d->discType & GameCubePrivate::DISC_SYSTEM_MASK) != GameCubePrivate::DISC_SYSTEM_WII)) {
+		// Hash verification is only supported for Wii discs.
+		return ops;
+	}
+
+	// NOTE: SHA-1 is only available if decryption is enabled.
+	RomOp op(C_("GameCube|RomOps", "&Verify Partition Hashes"), RomOp::ROF_ENABLED);
+#ifndef ENABLE_DECRYPTION
+	op.flags &= ~RomOp::ROF_ENABLED;
+#endif /* ENABLE_DECRYPTION */
+	ops.emplace_back(std::move(op));
+	return ops;
+}
+
+/**
+ * Perform a ROM operation.
+ * Internal function; called by RomData::doRomOp().
+ * @param id		[in] Operation index.
+ * @param pParams	[in/out] Parameters and results. (for e.g. UI updates)
+ * @return 0 on success; positive if hash errors were found; negative POSIX error code on error.
+ */
+int GameCube::doRomOp_int(int id, RomOpParams *pParams)
+{
+	RP_D(GameCube);
+
+	// Currently only one ROM operation.
+	if (id != 0) {
+		pParams->status = -EINVAL;
+		pParams->msg = C_("RomData", "ROM operation ID is invalid for this object.");
+		return -EINVAL;
+	}
+
+	int ret = d->loadWiiPartitionTables();
+	if (ret != 0 || d->wiiPtbl.empty()) {
+		if (ret == 0) {
+			ret = -ENOENT;
+		}
+		pParams->status = ret;
+		pParams->msg = C_("GameCube", "Unable to load the Wii partition tables.");
+		return ret;
+	}
+
+	// Progress is reported for the whole disc, not for each partition.
+	struct ProgressInfo {
+		RomOpParams *pParams;
+		uint64_t base;
+		uint64_t total;
+	} progress = {pParams, 0, 0};
+	for (const auto &entry : d->wiiPtbl) {
+		progress.total += static_cast<uint64_t>(entry.partition->size() & ~0x7FFFLL);
+	}
+	WiiPartition::VerifyProgressCallback callback = nullptr;
+	if (pParams->progress) {
+		callback = [](uint64_t done, uint64_t total, void *userdata) -> int {
+			RP_UNUSED(total);
+			const ProgressInfo *const progress = static_cast<const ProgressInfo*>(userdata);
+			return progress->pParams->progress(progress->base + done,
+				progress->total, progress->pParams->progress_userdata);
+		};
+	}
+
+	string msg;
+	unsigned int badPartitions = 0;
+	for (const auto &entry : d->wiiPtbl) {
+		if (!msg.empty()) {
+			msg += '\n';
+		}
+		// tr: Wii partition number, e.g. "0p1"
+		msg += rp_sprintf(C_("GameCube", "Partition %dp%d: "), entry.vg, entry.pt);
+
+		WiiPartition::HashVerifyResult result;
+		ret = entry.partition->verifyHashes(&result, callback, &progress);
+		progress.base += static_cast<uint64_t>(entry.partition->size() & ~0x7FFFLL);
+		if (ret == -ECANCELED) {
+			pParams->status = ret;
+			pParams->msg = C_("GameCube", "Hash verification was cancelled.");
+			return ret;
+		} else if (ret == -ENOTSUP) {
+			msg += C_("GameCube", "Partition does not have hashes.");
+			continue;
+		} else if (ret != 0) {
+			badPartitions++;
+			msg += rp_sprintf(C_("GameCube", "Unable to verify the partition: %s"), strerror(-ret));
+			continue;
+		}
+
+		if (result.bad_sectors == 0 && result.h3_table_ok) {
+			msg += rp_sprintf(C_("GameCube", "OK (%u sectors)"), result.sectors);
+			continue;
+		}
+
+		badPartitions++;
+		if (!result.h3_table_ok) {
+			msg += C_("GameCube", "H3 table does not match the TMD.");
+			if (result.bad_sectors != 0) {
+				msg += ' ';
+			}
+		}
+		if (result.bad_sectors != 0) {
+			msg += rp_sprintf(C_("GameCube", "%u of %u sectors are bad (H0: %u, H1: %u, H2: %u, H3: %u)."),
+				result.bad_sectors, result.sectors,
+				result.bad_h0, result.bad_h1, result.bad_h2, result.bad_h3);
+
+			// List the bad sectors.
+			msg += '\n';
+			msg += C_("GameCube", "Bad sectors:");
+			for (const uint32_t sector : result.badSectorList) {
+				msg += rp_sprintf(" %u", sector);
+			}
+			if (result.badSectorList.size() < result.bad_sectors) {
+				msg += " ...";
+			}
+		}
+	}
+
+	pParams->status = (badPartitions == 0) ? 0 : 1;
+	pParams->msg = std::move(msg);
+	return pParams->status;
+}
+
 /**
  * Check for "viewed" achievements.
  *
@@ -2109,8 +2245,8 @@ int GameCube::checkViewedAchievements(void) const
 
 	int ret = 0;
 	WiiTicket::EncryptionKeys encKey;
-	if (d->isNASOSFormatDiscImage()) {
-		// NASOS disc image.
+	if (d->isDecryptedDiscImage()) {
+		// NASOS or WIA/RVZ disc image.
 		// If this would normally be an encrypted image, use encKeyReal().
 		encKey = (d->discHeader.disc_noCrypto == 0)
 			? pt->encKeyReal()
@@ -50,7 +50,7 @@ private:
 
 public:
 	/** RomDataInfo **/
-	static const array<const char*, 3+1> exts;
+	static const array<const char*, 4+1> exts;
 	static const array<const char*, 3+1> mimeTypes;
 	static const RomDataInfo romDataInfo;
 
@@ -116,10 +116,11 @@ ROMDATA_IMPL(PlayStationDisc)
 /** PlayStationDiscPrivate **/
 
 /* RomDataInfo */
-const array<const char*, 3+1> PlayStationDiscPrivate::exts = {{
+const array<const char*, 4+1> PlayStationDiscPrivate::exts = {{
 	".iso",		// ISO
 	".bin",		// BIN/CUE
 	".img",		// CCD/IMG
+	".chd",		// MAME CHD
 	// TODO: More?
 
 	nullptr
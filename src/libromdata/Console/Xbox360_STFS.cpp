@@ -7,6 +7,7 @@
  ***************************************************************************/
 
 #include "stdafx.h"
+#include "config.librpbase.h"
 
 #include "Xbox360_STFS.hpp"
 #include "Xbox360_XEX.hpp"
@@ -21,11 +22,19 @@
 #include "librpbase/img/RpPng.hpp"
 #include "librpfile/MemFile.hpp"
 #include "librpfile/SubFile.hpp"
+#ifdef ENABLE_DECRYPTION
+#  include "librpbase/crypto/Hash.hpp"
+#endif /* ENABLE_DECRYPTION */
 using namespace LibRpBase;
 using namespace LibRpFile;
 using namespace LibRpText;
 using namespace LibRpTexture;
 
+// OpenMP for hash verification
+#ifdef _OPENMP
+#  include <omp.h>
+#endif /* _OPENMP */
+
 // C++ STL classes
 using std::array;
 using std::shared_ptr;
@@ -118,19 +127,44 @@ public:
 	 * @param blockNumber Block number.
 	 * @return Offset, or -1 on error.
 	 */
-	inline int32_t blockNumberToOffset(int blockNumber)
+	inline off64_t blockNumberToOffset(int blockNumber)
 	{
 		// Reference: https://github.com/Free60Project/wiki/blob/master/STFS.md
-		int ret;
-		if (blockNumber > 0xFFFFFF) {
+		off64_t ret;
+		if (blockNumber < 0 || blockNumber > 0xFFFFFF) {
 			ret = -1;
 		} else {
-			ret = (((be32_to_cpu(stfsMetadata.header_size) + 0xFFF) & 0xF000) +
-			        (blockNumber * STFS_BLOCK_SIZE));
+			ret = static_cast<off64_t>((be32_to_cpu(stfsMetadata.header_size) + 0xFFF) & 0xF000) +
+			      (static_cast<off64_t>(blockNumber) * STFS_BLOCK_SIZE);
 		}
 		return ret;
 	}
 
+	/**
+	 * Get the block shift for hash tables.
+	 * If 1, each hash table has two copies.
+	 * @return Block shift. (0 or 1)
+	 */
+	int getBlockShift(void) const;
+
+	// Hash table levels.
+	// Each level-0 entry covers one data block; each
+	// higher-level entry covers a full lower-level table.
+	static constexpr uint32_t HASH_LEVEL1_BLOCKS = 0x70E4;		// 0xAA * 0xAA
+	static constexpr uint32_t HASH_LEVEL2_BLOCKS = 0x4AF768;	// 0xAA * 0xAA * 0xAA
+
+	// Block map: physical block number of each allocated data block.
+	// Built on first use by loadBlockMap().
+	rp::uvector<uint32_t> blockMap;
+	uint8_t tableCopies;	// Copies of each hash table (1 or 2)
+	uint8_t topLevel;	// Top hash table level (0-2)
+
+	/**
+	 * Build the data block map.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int loadBlockMap(void);
+
 	/**
 	 * Convert a data block number to a physical block number.
 	 * Data block numbers don't include hash blocks.
@@ -139,6 +173,33 @@ public:
 	 */
 	int32_t dataBlockNumberToPhys(int dataBlockNumber);
 
+	/**
+	 * Get the physical block number of a hash table.
+	 * If the package has two copies of each hash table,
+	 * this is the block number of the first copy.
+	 * @param level Hash table level. (0-2)
+	 * @param dataBlockNumber Data block number covered by the hash table.
+	 * @return Physical block number.
+	 */
+	int32_t hashTableBlockNumber(unsigned int level, uint32_t dataBlockNumber);
+
+	// Most recently loaded hash table for each level.
+	// Following a block chain usually stays within
+	// the same tables, so one table per level is enough.
+	struct HashTableCache {
+		int32_t physBlockNumber;	// -1 if not loaded
+		STFS_HashTable table;
+	};
+	array<HashTableCache, 3> hashTableCache;
+
+	/**
+	 * Load the active copy of a hash table.
+	 * @param level Hash table level. (0-2)
+	 * @param dataBlockNumber Data block number covered by the hash table.
+	 * @return Hash table, or nullptr on error.
+	 */
+	const STFS_HashTable *loadHashTable(unsigned int level, uint32_t dataBlockNumber);
+
 	/**
 	 * Load the file table.
 	 * @return 0 on success; negative POSIX error code on error.
@@ -150,6 +211,31 @@ public:
 	 * @return Default executable on success; nullptr on error.
 	 */
 	Xbox360_XEX *openDefaultXex(void);
+
+#ifdef ENABLE_DECRYPTION
+public:
+	// Package verification results.
+	struct VerifyResult {
+		uint32_t blocks;	// Data blocks checked
+		uint32_t bad_blocks;	// Data blocks that don't match the level-0 hash
+		uint32_t tables;	// Hash tables checked
+		uint32_t bad_tables;	// Hash tables that don't match the higher-level hash
+		bool top_hash_ok;	// True if the top hash table matches the volume descriptor
+		vector<uint32_t> badBlockList;	// Bad data block numbers (up to BAD_BLOCK_LIST_MAX)
+	};
+	static constexpr size_t BAD_BLOCK_LIST_MAX = 256;
+
+	// Number of level-0 groups read at once when verifying.
+	static constexpr unsigned int VERIFY_BATCH_GROUPS = 8;
+
+	/**
+	 * Verify the package's hash tables and data blocks.
+	 * @param pResult	[out] Verification results
+	 * @param pParams	[in,opt] RomOpParams, for the progress callback
+	 * @return 0 if verification completed; -ECANCELED if cancelled; negative POSIX error code on error.
+	 */
+	int verifyPackage(VerifyResult *pResult, RomData::RomOpParams *pParams);
+#endif /* ENABLE_DECRYPTION */
 };
 
 ROMDATA_IMPL(Xbox360_STFS)
@@ -181,11 +267,17 @@ Xbox360_STFS_Private::Xbox360_STFS_Private(const IRpFilePtr &file)
 	, stfsType(StfsType::Unknown)
 	, headers_loaded(0)
 	, xex(nullptr)
+	, tableCopies(1)
+	, topLevel(0)
 {
 	// Clear the headers.
 	memset(&stfsHeader, 0, sizeof(stfsHeader));
 	memset(&stfsMetadata, 0, sizeof(stfsMetadata));
 	memset(&stfsThumbnails, 0, sizeof(stfsThumbnails));
+
+	for (HashTableCache &cache : hashTableCache) {
+		cache.physBlockNumber = -1;
+	}
 }
 
 /**
@@ -332,11 +424,105 @@ int Xbox360_STFS_Private::loadHeader(unsigned int header)
 		if (ret == 0) {
 			ret = -EIO;
 		}
+	} else {
+		headers_loaded |= header;
 	}
 
 	return ret;
 }
 
+/**
+ * Get the block shift for hash tables.
+ * If 1, each hash table has two copies.
+ * @return Block shift. (0 or 1)
+ */
+int Xbox360_STFS_Private::getBlockShift(void) const
+{
+	// Reference: https://github.com/Free60Project/wiki/blob/master/STFS.md
+	// FIXME: Originally compared magic to blockShift,
+	// which doesn't make sense...
+	if (stfsType != StfsType::CON) {
+		return 0;
+	}
+
+	if (((be32_to_cpu(stfsMetadata.header_size) + 0xFFF) & 0xF000) == 0xB000) {
+		return 1;
+	}
+	return ((stfsMetadata.stfs_desc.block_separation & 1) == 1) ? 0 : 1;
+}
+
+/**
+ * Build the data block map.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int Xbox360_STFS_Private::loadBlockMap(void)
+{
+	if (!blockMap.empty()) {
+		// Block map is already loaded.
+		return 0;
+	}
+
+	if (!this->file) {
+		// File isn't open.
+		return -EBADF;
+	} else if (!this->isValid || static_cast<int>(this->stfsType) < 0) {
+		// STFS file isn't valid.
+		return -EIO;
+	}
+
+	// Make sure the STFS metadata is loaded.
+	int ret = loadHeader(Xbox360_STFS_Private::STFS_PRESENT_METADATA);
+	if (ret != 0) {
+		// Not loaded and unable to load.
+		return ret;
+	}
+	if (stfsMetadata.descriptor_type != cpu_to_be32(0)) {
+		// SVOD doesn't use STFS hash tables.
+		return -ENOTSUP;
+	}
+
+	const uint32_t allocBlockCount = be32_to_cpu(stfsMetadata.stfs_desc.total_alloc_block_count);
+	if (allocBlockCount == 0 || allocBlockCount > HASH_LEVEL2_BLOCKS) {
+		// No blocks, or too many blocks for three hash levels.
+		return -EIO;
+	}
+	topLevel = (allocBlockCount <= STFS_HASH_ENTRIES_PER_TABLE) ? 0
+		: (allocBlockCount <= HASH_LEVEL1_BLOCKS) ? 1 : 2;
+	tableCopies = 1U << getBlockShift();
+
+	// Don't map more blocks than the file can actually hold.
+	const off64_t dataStart = blockNumberToOffset(0);
+	const off64_t fileSize = file->size();
+	if (fileSize <= dataStart) {
+		return -EIO;
+	}
+	const uint32_t blockCount = static_cast<uint32_t>(std::min(
+		static_cast<off64_t>(allocBlockCount), (fileSize - dataStart) / STFS_BLOCK_SIZE));
+
+	// Hash tables are stored immediately before the group of data blocks
+	// that they cover, except for the first level-1 and level-2 tables,
+	// which are stored after the first lower-level group.
+	blockMap.resize(blockCount);
+	uint32_t physBlockNumber = 0;
+	for (uint32_t i = 0; i < blockCount; i++) {
+		if (i % STFS_HASH_ENTRIES_PER_TABLE == 0) {
+			if (i == STFS_HASH_ENTRIES_PER_TABLE || i == HASH_LEVEL1_BLOCKS) {
+				// First level-1 or level-2 table.
+				physBlockNumber += tableCopies;
+			}
+			if (i != 0 && i % HASH_LEVEL1_BLOCKS == 0) {
+				// Level-1 table for this group.
+				physBlockNumber += tableCopies;
+			}
+			// Level-0 table for this group.
+			physBlockNumber += tableCopies;
+		}
+		blockMap[i] = physBlockNumber++;
+	}
+
+	return 0;
+}
+
 /**
  * Convert a data block number to a physical block number.
  * Data block numbers don't include hash blocks.
@@ -345,43 +531,116 @@ int Xbox360_STFS_Private::loadHeader(unsigned int header)
  */
 int32_t Xbox360_STFS_Private::dataBlockNumberToPhys(int dataBlockNumber)
 {
+	if (dataBlockNumber >= 0 && static_cast<size_t>(dataBlockNumber) < blockMap.size()) {
+		return static_cast<int32_t>(blockMap[dataBlockNumber]);
+	}
+
+	// Not in the block map. Calculate the physical block number.
 	// Reference: https://github.com/Free60Project/wiki/blob/master/STFS.md
-	int blockShift;
-	if (((be32_to_cpu(stfsMetadata.header_size) + 0xFFF) & 0xF000) == 0xB000) {
-		blockShift = 1;
-	} else {
-		if ((stfsMetadata.stfs_desc.block_separation & 1) == 1) {
-			blockShift = 0;
-		} else {
-			blockShift = 1;
+	const int blockShift = getBlockShift();
+	int32_t ret = (((dataBlockNumber + 0xAA) / 0xAA) << blockShift) + dataBlockNumber;
+	if (dataBlockNumber >= 0xAA) {
+		ret += ((dataBlockNumber + 0x70E4) / 0x70E4) << blockShift;
+		if (dataBlockNumber >= 0x70E4) {
+			ret += ((dataBlockNumber + 0x4AF768) / 0x4AF768) << blockShift;
 		}
 	}
 
-	int32_t base = ((dataBlockNumber + 0xAA) / 0xAA);
-	if (stfsType == StfsType::CON) {
-		base <<= blockShift;
-	}
+	return ret;
+}
 
-	int32_t ret = (base + dataBlockNumber);
-	if (dataBlockNumber > 0xAA) {
-		base = ((dataBlockNumber + 0x70E4) / 0x70E4);
-		if (stfsType == StfsType::CON) {
-			base <<= blockShift;
+/**
+ * Get the physical block number of a hash table.
+ * If the package has two copies of each hash table,
+ * this is the block number of the first copy.
+ *
+ * NOTE: loadBlockMap() must have been called first.
+ *
+ * @param level Hash table level. (0-2)
+ * @param dataBlockNumber Data block number covered by the hash table.
+ * @return Physical block number.
+ */
+int32_t Xbox360_STFS_Private::hashTableBlockNumber(unsigned int level, uint32_t dataBlockNumber)
+{
+	assert(level <= 2);
+	switch (level) {
+		default:
+		case 0:
+			// Immediately before the first data block in the group.
+			return dataBlockNumberToPhys(dataBlockNumber - (dataBlockNumber % STFS_HASH_ENTRIES_PER_TABLE))
+				- tableCopies;
+		case 1: {
+			// Before the level-0 table of the first group, except for
+			// the first level-1 table, which is after the first group.
+			uint32_t firstBlock = dataBlockNumber - (dataBlockNumber % HASH_LEVEL1_BLOCKS);
+			if (firstBlock == 0) {
+				firstBlock = STFS_HASH_ENTRIES_PER_TABLE;
+			}
+			return dataBlockNumberToPhys(firstBlock) - (tableCopies * 2);
 		}
-		ret += base;
-
-		if (dataBlockNumber > 0x70E4) {
-			base = ((dataBlockNumber + 0x4AF768) / 0x4AF768);
-			// FIXME: Originally compared magic to blockShift,
-			// which doesn't make sense...
-			if (stfsType == StfsType::CON) {
-				base <<= blockShift;
+		case 2:
+			// After the first level-1 group.
+			return dataBlockNumberToPhys(HASH_LEVEL1_BLOCKS) - (tableCopies * 3);
+	}
+}
+
+/**
+ * Load the active copy of a hash table.
+ *
+ * NOTE: loadBlockMap() must have been called first.
+ *
+ * @param level Hash table level. (0-2)
+ * @param dataBlockNumber Data block number covered by the hash table.
+ * @return Hash table, or nullptr on error.
+ */
+const STFS_HashTable *Xbox360_STFS_Private::loadHashTable(unsigned int level, uint32_t dataBlockNumber)
+{
+	assert(level <= topLevel);
+	if (level > topLevel) {
+		return nullptr;
+	}
+
+	int32_t physBlockNumber = hashTableBlockNumber(level, dataBlockNumber);
+	if (tableCopies > 1) {
+		// Determine which copy of the table is active.
+		// The top-level table's active copy is specified in the
+		// volume descriptor; lower-level tables are specified
+		// in the higher-level table's entries.
+		bool active1;
+		if (level == topLevel) {
+			active1 = !!(stfsMetadata.stfs_desc.block_separation & 2);
+		} else {
+			const STFS_HashTable *const parent = loadHashTable(level + 1, dataBlockNumber);
+			if (!parent) {
+				return nullptr;
 			}
-			ret += base;
+			const uint32_t span = (level == 0) ? STFS_HASH_ENTRIES_PER_TABLE : HASH_LEVEL1_BLOCKS;
+			const STFS_HashEntry &entry = parent->entries[(dataBlockNumber / span) % STFS_HASH_ENTRIES_PER_TABLE];
+			active1 = !!(entry.status & STFS_HASH_STATUS_ACTIVE_INDEX);
+		}
+		if (active1) {
+			physBlockNumber++;
 		}
 	}
 
-	return ret;
+	HashTableCache &cache = hashTableCache[level];
+	if (cache.physBlockNumber == physBlockNumber) {
+		// Table is already loaded.
+		return &cache.table;
+	}
+
+	const off64_t offset = blockNumberToOffset(physBlockNumber);
+	if (offset < 0) {
+		return nullptr;
+	}
+	size_t size = file->seekAndRead(offset, &cache.table, sizeof(cache.table));
+	if (size != sizeof(cache.table)) {
+		// Seek and/or read error.
+		cache.physBlockNumber = -1;
+		return nullptr;
+	}
+	cache.physBlockNumber = physBlockNumber;
+	return &cache.table;
 }
 
 /**
@@ -395,51 +654,86 @@ int Xbox360_STFS_Private::loadFileTable(void)
 		return 0;
 	}
 
-	if (!this->file) {
-		// File isn't open.
-		return -EBADF;
-	} else if (!this->isValid || static_cast<int>(this->stfsType) < 0) {
-		// STFS file isn't valid.
-		return -EIO;
-	}
-
-	// Make sure the STFS metadata is loaded.
-	int ret = loadHeader(Xbox360_STFS_Private::STFS_PRESENT_METADATA);
+	// Make sure the block map is loaded.
+	// This also loads the STFS metadata.
+	int ret = loadBlockMap();
 	if (ret != 0) {
 		// Not loaded and unable to load.
 		return ret;
 	}
 
-	// TODO: Verify that this is STFS and not SVOD.
 	// NOTE: These values are signed. Make sure they're not negative.
 	const int16_t blockCount = be16_to_cpu(stfsMetadata.stfs_desc.file_table_block_count);
-	if (blockCount < 0 || stfsMetadata.stfs_desc.file_table_block_number[0] >= 0x80) {
-		// Negative values.
+	if (blockCount <= 0 || stfsMetadata.stfs_desc.file_table_block_number[0] >= 0x80) {
+		// Negative or zero values.
 		return -EIO;
 	}
-	const int32_t blockNumber =
+	uint32_t blockNumber =
 		(stfsMetadata.stfs_desc.file_table_block_number[0] << 16) |
 		(stfsMetadata.stfs_desc.file_table_block_number[1] <<  8) |
 		 stfsMetadata.stfs_desc.file_table_block_number[2];
-	const int32_t offset = blockNumberToOffset(dataBlockNumberToPhys(blockNumber));
-	if (offset < 0) {
-		// Invalid block number.
-		return -EIO;
-	}
 
 	// Load the file table.
-	size_t fileTableSize = ((uint32_t)blockCount * STFS_BLOCK_SIZE);
-	assert(fileTableSize % sizeof(STFS_DirEntry_t) == 0);
-	if (fileTableSize % sizeof(STFS_DirEntry_t) != 0) {
-		fileTableSize += sizeof(STFS_DirEntry_t);
-	}
-	fileTable.resize(fileTableSize / sizeof(STFS_DirEntry_t));
-	size_t size = file->seekAndRead(offset, fileTable.data(), fileTableSize);
-	if (size != fileTableSize) {
-		// Seek and/or read error.
+	// The file table's blocks are chained using the level-0 hash tables.
+	// Runs of physically consecutive blocks are read at once.
+	static constexpr unsigned int entriesPerBlock = STFS_BLOCK_SIZE / sizeof(STFS_DirEntry_t);
+	fileTable.resize(static_cast<size_t>(blockCount) * entriesPerBlock);
+	uint8_t *const pFileTable = reinterpret_cast<uint8_t*>(fileTable.data());
+	int32_t runStart = -1;
+	unsigned int runCount = 0;
+	unsigned int blocksRead = 0;
+
+	auto readRun = [this, pFileTable, &runStart, &runCount, &blocksRead]() -> bool {
+		const off64_t offset = blockNumberToOffset(runStart);
+		const size_t runSize = static_cast<size_t>(runCount) * STFS_BLOCK_SIZE;
+		if (offset < 0 || file->seekAndRead(offset,
+			&pFileTable[static_cast<size_t>(blocksRead) * STFS_BLOCK_SIZE], runSize) != runSize)
+		{
+			// Seek and/or read error.
+			return false;
+		}
+		blocksRead += runCount;
+		runCount = 0;
+		return true;
+	};
+
+	for (int i = 0; i < blockCount; i++) {
+		const int32_t physBlockNumber = dataBlockNumberToPhys(static_cast<int>(blockNumber));
+		if (runCount > 0 && physBlockNumber == runStart + static_cast<int32_t>(runCount)) {
+			runCount++;
+		} else {
+			if (runCount > 0 && !readRun()) {
+				fileTable.clear();
+				return -EIO;
+			}
+			runStart = physBlockNumber;
+			runCount = 1;
+		}
+
+		if (i + 1 == blockCount) {
+			break;
+		}
+
+		// Get the next block from the level-0 hash table.
+		const STFS_HashTable *const table = loadHashTable(0, blockNumber);
+		if (!table) {
+			fileTable.clear();
+			return -EIO;
+		}
+		const STFS_HashEntry &entry = table->entries[blockNumber % STFS_HASH_ENTRIES_PER_TABLE];
+		blockNumber = (entry.next_block[0] << 16) |
+		              (entry.next_block[1] <<  8) |
+		               entry.next_block[2];
+		if (blockNumber == STFS_HASH_NEXT_BLOCK_END) {
+			// End of the chain.
+			break;
+		}
+	}
+	if (runCount > 0 && !readRun()) {
 		fileTable.clear();
 		return -EIO;
 	}
+	fileTable.resize(static_cast<size_t>(blocksRead) * entriesPerBlock);
 
 	// Find the end of the file table.
 	for (size_t i = 0; i < fileTable.size(); i++) {
@@ -517,7 +811,7 @@ Xbox360_XEX *Xbox360_STFS_Private::openDefaultXex(void)
 		(dirEntry->block_number[2] << 16) |
 		(dirEntry->block_number[1] <<  8) |
 		 dirEntry->block_number[0];
-	const int32_t offset = blockNumberToOffset(dataBlockNumberToPhys(blockNumber));
+	const off64_t offset = blockNumberToOffset(dataBlockNumberToPhys(blockNumber));
 	const uint32_t filesize = be32_to_cpu(dirEntry->filesize);
 
 	// Load default.xexp.
@@ -536,6 +830,249 @@ Xbox360_XEX *Xbox360_STFS_Private::openDefaultXex(void)
 	return this->xex.get();
 }
 
+#ifdef ENABLE_DECRYPTION
+/**
+ * Verify the package's hash tables and data blocks.
+ * @param pResult	[out] Verification results
+ * @param pParams	[in,opt] RomOpParams, for the progress callback
+ * @return 0 if verification completed; -ECANCELED if cancelled; negative POSIX error code on error.
+ */
+int Xbox360_STFS_Private::verifyPackage(VerifyResult *pResult, RomData::RomOpParams *pParams)
+{
+	pResult->blocks = 0;
+	pResult->bad_blocks = 0;
+	pResult->tables = 0;
+	pResult->bad_tables = 0;
+	pResult->top_hash_ok = false;
+	pResult->badBlockList.clear();
+
+	int ret = loadBlockMap();
+	if (ret != 0) {
+		return ret;
+	}
+	const uint32_t blockCount = static_cast<uint32_t>(blockMap.size());
+	if (blockCount < be32_to_cpu(stfsMetadata.stfs_desc.total_alloc_block_count)) {
+		// File is truncated.
+		return -EIO;
+	}
+
+	// Set up the per-thread hash objects.
+#ifdef _OPENMP
+	const int threadCount = omp_get_max_threads();
+#else /* !_OPENMP */
+	static constexpr int threadCount = 1;
+#endif /* _OPENMP */
+	vector<unique_ptr<Hash> > sha1(threadCount);
+	for (unique_ptr<Hash> &hash : sha1) {
+		hash.reset(new Hash(Hash::Algorithm::SHA1));
+		if (!hash->isUsable()) {
+			return -ENOTSUP;
+		}
+	}
+
+	auto checkHash = [](Hash &hash, const void *data, const uint8_t *expected) -> bool {
+		uint8_t digest[20];
+		hash.reset();
+		hash.process(data, STFS_BLOCK_SIZE);
+		hash.getHash(digest, sizeof(digest));
+		return !memcmp(digest, expected, sizeof(digest));
+	};
+	auto readTable = [this](int32_t physBlockNumber, STFS_HashTable *table) -> bool {
+		const off64_t offset = blockNumberToOffset(physBlockNumber);
+		return (offset >= 0 && file->seekAndRead(offset, table, sizeof(*table)) == sizeof(*table));
+	};
+	const unsigned int copies = tableCopies;
+
+	// Verify the top hash table against the volume descriptor.
+	STFS_HashTable topTable;
+	const bool topActive1 = (copies > 1 && (stfsMetadata.stfs_desc.block_separation & 2));
+	if (!readTable(hashTableBlockNumber(topLevel, 0) + (topActive1 ? 1 : 0), &topTable)) {
+		return -EIO;
+	}
+	pResult->top_hash_ok = checkHash(*sha1[0], &topTable, stfsMetadata.stfs_desc.top_hash_table_hash);
+	pResult->tables = 1;
+
+	// Level-1 tables are kept in memory, since each one covers many groups.
+	rp::uvector<STFS_HashTable> level1Tables;
+	if (topLevel == 2) {
+		const uint32_t level1Count = (blockCount + HASH_LEVEL1_BLOCKS - 1) / HASH_LEVEL1_BLOCKS;
+		level1Tables.resize(level1Count);
+		for (uint32_t i = 0; i < level1Count; i++) {
+			const STFS_HashEntry &entry = topTable.entries[i];
+			const bool active1 = (copies > 1 && (entry.status & STFS_HASH_STATUS_ACTIVE_INDEX));
+			if (!readTable(hashTableBlockNumber(1, i * HASH_LEVEL1_BLOCKS) + (active1 ? 1 : 0), &level1Tables[i])) {
+				return -EIO;
+			}
+			pResult->tables++;
+			if (!checkHash(*sha1[0], &level1Tables[i], entry.sha1)) {
+				pResult->bad_tables++;
+			}
+		}
+	} else if (topLevel == 1) {
+		level1Tables.push_back(topTable);
+	}
+
+	// Verify the level-0 tables and data blocks, one group at a time.
+	// The level-0 table copies are stored immediately before the group's
+	// data blocks, so each group is read at once.
+	// The next batch is read while the current batch is being verified.
+	static constexpr uint32_t groupBlocks = STFS_HASH_ENTRIES_PER_TABLE;
+	const uint32_t groupCount = (blockCount + groupBlocks - 1) / groupBlocks;
+	const size_t groupSize = static_cast<size_t>(copies + groupBlocks) * STFS_BLOCK_SIZE;
+	const uint64_t totalBytes = static_cast<uint64_t>(blockCount) * STFS_BLOCK_SIZE;
+
+	rp::uvector<uint8_t> batch[2];
+	batch[0].resize(VERIFY_BATCH_GROUPS * groupSize);
+	batch[1].resize(VERIFY_BATCH_GROUPS * groupSize);
+
+	// Verification flags
+	enum VerifyFlags : uint8_t {
+		VF_CHECKED	= (1U << 0),
+		VF_BAD		= (1U << 1),
+	};
+	array<uint8_t, VERIFY_BATCH_GROUPS * groupBlocks> blockFlags;
+	array<uint8_t, VERIFY_BATCH_GROUPS> tableFlags;
+	array<uint8_t, VERIFY_BATCH_GROUPS> tableActive;
+
+	auto readBatch = [this, copies, blockCount, groupCount, groupSize](uint8_t *buf, uint32_t firstGroup) -> uint32_t {
+		const uint32_t count = std::min(groupCount - firstGroup, static_cast<uint32_t>(VERIFY_BATCH_GROUPS));
+		for (uint32_t i = 0; i < count; i++) {
+			const uint32_t firstBlock = (firstGroup + i) * groupBlocks;
+			const uint32_t blocks = std::min(blockCount - firstBlock, groupBlocks);
+			const size_t size = static_cast<size_t>(copies + blocks) * STFS_BLOCK_SIZE;
+			const off64_t addr = blockNumberToOffset(blockMap[firstBlock] - copies);
+			// NOTE: Using readAt(), since this runs inside a parallel region.
+			if (addr < 0 || file->readAt(addr, &buf[i * groupSize], size) != size) {
+				return 0;
+			}
+		}
+		return count;
+	};
+
+	uint32_t curCount = readBatch(batch[0].data(), 0);
+	if (curCount == 0) {
+		return -EIO;
+	}
+
+	int cur = 0;
+	for (uint32_t batchStart = 0; batchStart < groupCount; cur ^= 1) {
+		const uint8_t *const curBuf = batch[cur].data();
+		const uint32_t nextStart = batchStart + curCount;
+		uint32_t nextCount = 0;
+		const int itemCount = static_cast<int>(curCount * groupBlocks);
+		blockFlags.fill(0);
+		tableFlags.fill(0);
+
+		// Determine the active copy of each level-0 table.
+		for (uint32_t i = 0; i < curCount; i++) {
+			const uint32_t group = batchStart + i;
+			if (copies == 1) {
+				tableActive[i] = 0;
+			} else if (topLevel == 0) {
+				tableActive[i] = (topActive1 ? 1 : 0);
+			} else {
+				const STFS_HashEntry &entry = level1Tables[group / groupBlocks].entries[group % groupBlocks];
+				tableActive[i] = ((entry.status & STFS_HASH_STATUS_ACTIVE_INDEX) ? 1 : 0);
+			}
+		}
+
+#ifdef _OPENMP
+		#pragma omp parallel
+#endif /* _OPENMP */
+		{
+#ifdef _OPENMP
+			Hash &hash = *sha1[omp_get_thread_num()];
+			#pragma omp single nowait
+#else /* !_OPENMP */
+			Hash &hash = *sha1[0];
+#endif /* _OPENMP */
+			if (nextStart < groupCount) {
+				nextCount = readBatch(batch[cur ^ 1].data(), nextStart);
+			}
+
+#ifdef _OPENMP
+			#pragma omp for schedule(dynamic)
+#endif /* _OPENMP */
+			for (int i = 0; i < itemCount; i++) {
+				const uint32_t g = static_cast<uint32_t>(i) / groupBlocks;
+				const uint32_t j = static_cast<uint32_t>(i) % groupBlocks;
+				if ((batchStart + g) * groupBlocks + j >= blockCount) {
+					// Past the end of the last group.
+					continue;
+				}
+
+				const uint8_t *const pGroup = &curBuf[g * groupSize];
+				const STFS_HashTable *const table = reinterpret_cast<const STFS_HashTable*>(
+					&pGroup[tableActive[g] * STFS_BLOCK_SIZE]);
+				const STFS_HashEntry &entry = table->entries[j];
+				if (!(entry.status & STFS_HASH_STATUS_USED)) {
+					// Block isn't in use.
+					continue;
+				}
+				blockFlags[i] = VF_CHECKED;
+				if (!checkHash(hash, &pGroup[(copies + j) * STFS_BLOCK_SIZE], entry.sha1)) {
+					blockFlags[i] |= VF_BAD;
+				}
+			}
+
+			if (topLevel > 0) {
+#ifdef _OPENMP
+				#pragma omp for
+#endif /* _OPENMP */
+				for (int g = 0; g < static_cast<int>(curCount); g++) {
+					const uint32_t group = batchStart + g;
+					const STFS_HashEntry &entry = level1Tables[group / groupBlocks].entries[group % groupBlocks];
+					tableFlags[g] = VF_CHECKED;
+					if (!checkHash(hash, &curBuf[(g * groupSize) + (tableActive[g] * STFS_BLOCK_SIZE)], entry.sha1)) {
+						tableFlags[g] |= VF_BAD;
+					}
+				}
+			}
+		}
+
+		// Tally the results.
+		for (uint32_t g = 0; g < curCount; g++) {
+			if (tableFlags[g] & VF_CHECKED) {
+				pResult->tables++;
+				if (tableFlags[g] & VF_BAD) {
+					pResult->bad_tables++;
+				}
+			}
+		}
+		for (int i = 0; i < itemCount; i++) {
+			const uint8_t flags = blockFlags[i];
+			if (!(flags & VF_CHECKED)) {
+				continue;
+			}
+			pResult->blocks++;
+			if (flags & VF_BAD) {
+				pResult->bad_blocks++;
+				if (pResult->badBlockList.size() < BAD_BLOCK_LIST_MAX) {
+					pResult->badBlockList.push_back((batchStart * groupBlocks) + i);
+				}
+			}
+		}
+
+		batchStart = nextStart;
+		if (pParams && pParams->progress) {
+			const uint64_t done = std::min(static_cast<uint64_t>(batchStart) * groupBlocks * STFS_BLOCK_SIZE, totalBytes);
+			if (pParams->progress(done, totalBytes, pParams->progress_userdata) != 0) {
+				// Cancelled.
+				return -ECANCELED;
+			}
+		}
+
+		if (batchStart < groupCount && nextCount == 0) {
+			// Error reading the next batch.
+			return -EIO;
+		}
+		curCount = nextCount;
+	}
+
+	return 0;
+}
+#endif /* ENABLE_DECRYPTION */
+
 /** Xbox360_STFS **/
 
 /**
@@ -1145,4 +1682,106 @@ int Xbox360_STFS::loadInternalImage(ImageType imageType, rp_image_const_ptr &pIm
 		d->loadIcon);	// func
 }
 
+/**
+ * Get the list of operations that can be performed on this ROM.
+ * Internal function; called by RomData::romOps().
+ * @return List of operations.
+ */
+vector<RomData::RomOp> Xbox360_STFS::romOps_int(void) const
+{
+	RP_D(const Xbox360_STFS);
+	vector<RomOp> ops;
+	if (!d->isValid || static_cast<int>(d->stfsType) < 0) {
+		return ops;
+	}
+
+	// NOTE: SHA-1 is only available if decryption is enabled.
+	RomOp op(C_("Xbox360_STFS|RomOps", "&Verify Package"), RomOp::ROF_ENABLED);
+#ifndef ENABLE_DECRYPTION
+	op.flags &= ~RomOp::ROF_ENABLED;
+#endif /* ENABLE_DECRYPTION */
+	ops.emplace_back(std::move(op));
+	return ops;
+}
+
+/**
+ * Perform a ROM operation.
+ * Internal function; called by RomData::doRomOp().
+ * @param id		[in] Operation index.
+ * @param pParams	[in/out] Parameters and results. (for e.g. UI updates)
+ * @return 0 on success; positive if hash errors were found; negative POSIX error code on error.
+ */
+int Xbox360_STFS::doRomOp_int(int id, RomOpParams *pParams)
+{
+	// Currently only one ROM operation.
+	if (id != 0) {
+		pParams->status = -EINVAL;
+		pParams->msg = C_("RomData", "ROM operation ID is invalid for this object.");
+		return -EINVAL;
+	}
+
+#ifdef ENABLE_DECRYPTION
+	RP_D(Xbox360_STFS);
+	Xbox360_STFS_Private::VerifyResult result;
+	int ret = d->verifyPackage(&result, pParams);
+	if (ret == -ECANCELED) {
+		pParams->status = ret;
+		pParams->msg = C_("Xbox360_STFS", "Hash verification was cancelled.");
+		return ret;
+	} else if (ret == -ENOTSUP) {
+		pParams->status = ret;
+		pParams->msg = C_("Xbox360_STFS", "Package does not have STFS hash tables.");
+		return ret;
+	} else if (ret != 0) {
+		pParams->status = ret;
+		pParams->msg = rp_sprintf(C_("Xbox360_STFS", "Unable to verify the package: %s"), strerror(-ret));
+		return ret;
+	}
+
+	if (result.top_hash_ok && result.bad_tables == 0 && result.bad_blocks == 0) {
+		pParams->status = 0;
+		pParams->msg = rp_sprintf(C_("Xbox360_STFS", "OK (%u data blocks, %u hash tables)"),
+			result.blocks, result.tables);
+		return 0;
+	}
+
+	string msg;
+	if (!result.top_hash_ok) {
+		msg = C_("Xbox360_STFS", "Top hash table does not match the volume descriptor.");
+	}
+	if (result.bad_tables != 0) {
+		if (!msg.empty()) {
+			msg += ' ';
+		}
+		msg += rp_sprintf(C_("Xbox360_STFS", "%u of %u hash tables are bad."),
+			result.bad_tables, result.tables);
+	}
+	if (result.bad_blocks != 0) {
+		if (!msg.empty()) {
+			msg += ' ';
+		}
+		msg += rp_sprintf(C_("Xbox360_STFS", "%u of %u data blocks are bad."),
+			result.bad_blocks, result.blocks);
+
+		// List the bad blocks.
+		msg += '\n';
+		msg += C_("Xbox360_STFS", "Bad blocks:");
+		for (const uint32_t block : result.badBlockList) {
+			msg += rp_sprintf(" %u", block);
+		}
+		if (result.badBlockList.size() < result.bad_blocks) {
+			msg += " ...";
+		}
+	}
+
+	pParams->status = 1;
+	pParams->msg = std::move(msg);
+	return pParams->status;
+#else /* !ENABLE_DECRYPTION */
+	pParams->status = -ENOTSUP;
+	pParams->msg = C_("Xbox360_STFS", "SHA-1 is not available in this build.");
+	return -ENOTSUP;
+#endif /* ENABLE_DECRYPTION */
+}
+
 } // namespace LibRomData
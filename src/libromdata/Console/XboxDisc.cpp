@@ -10,7 +10,9 @@
 #include "XboxDisc.hpp"
 
 // Other rom-properties libraries
+#include "librpfile/BufferedFile.hpp"
 #include "librpfile/RpFile.hpp"
+#include "librpfile/TracingFile.hpp"
 using namespace LibRpBase;
 using namespace LibRpFile;
 using namespace LibRpText;
@@ -28,6 +30,7 @@ using namespace LibRpTexture;
 
 // C++ STL classes
 using std::array;
+using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 using std::vector;
@@ -64,7 +67,11 @@ public:
 	};
 	DiscType discType;
 	uint8_t wave;	// XGD2: Wave number
-	bool isKreon;	// Are we using a Kreon drive?
+
+	// Kreon drive, if we're using one.
+	// NOTE: This is the RpFile underneath any BufferedFile
+	// or TracingFile wrappers.
+	shared_ptr<RpFile> kreonFile;
 
 	// XDVDFS starting address
 	off64_t xdvdfs_addr;
@@ -111,6 +118,20 @@ public:
 	 */
 	ConsoleType getConsoleType(void) const;
 
+	/**
+	 * Get the RpFile underneath any BufferedFile or TracingFile wrappers.
+	 * @param file File
+	 * @return RpFile, or nullptr if the file isn't an RpFile.
+	 */
+	static shared_ptr<RpFile> getBaseRpFile(const IRpFilePtr &file);
+
+	/**
+	 * Discard data cached by BufferedFile wrappers.
+	 * This is needed when the Kreon lock state changes,
+	 * since the readable data changes.
+	 */
+	void invalidateBufferedFiles(void);
+
 	/**
 	 * Unlock the Kreon drive.
 	 */
@@ -150,7 +171,6 @@ XboxDiscPrivate::XboxDiscPrivate(const IRpFilePtr &file)
 	: super(file, &romDataInfo)
 	, discType(DiscType::Unknown)
 	, wave(0)
-	, isKreon(false)
 	, xdvdfs_addr(0)
 	, exeType(ExeType::Unknown)
 {
@@ -158,9 +178,7 @@ XboxDiscPrivate::XboxDiscPrivate(const IRpFilePtr &file)
 
 XboxDiscPrivate::~XboxDiscPrivate()
 {
-	if (isKreon) {
-		lockKreonDrive();
-	}
+	lockKreonDrive();
 }
 
 /**
@@ -263,19 +281,66 @@ XboxDiscPrivate::ConsoleType XboxDiscPrivate::getConsoleType(void) const
 	return ConsoleType::Xbox;
 }
 
+/**
+ * Get the RpFile underneath any BufferedFile or TracingFile wrappers.
+ * @param file File
+ * @return RpFile, or nullptr if the file isn't an RpFile.
+ */
+shared_ptr<RpFile> XboxDiscPrivate::getBaseRpFile(const IRpFilePtr &file)
+{
+	IRpFilePtr baseFile = file;
+	while (baseFile) {
+		const BufferedFile *const bufFile = dynamic_cast<const BufferedFile*>(baseFile.get());
+		if (bufFile) {
+			baseFile = bufFile->baseFile();
+			continue;
+		}
+		const TracingFile *const traceFile = dynamic_cast<const TracingFile*>(baseFile.get());
+		if (traceFile) {
+			baseFile = traceFile->baseFile();
+			continue;
+		}
+		break;
+	}
+
+	return std::dynamic_pointer_cast<RpFile>(baseFile);
+}
+
+/**
+ * Discard data cached by BufferedFile wrappers.
+ * This is needed when the Kreon lock state changes,
+ * since the readable data changes.
+ */
+void XboxDiscPrivate::invalidateBufferedFiles(void)
+{
+	IRpFilePtr baseFile = this->file;
+	while (baseFile) {
+		BufferedFile *const bufFile = dynamic_cast<BufferedFile*>(baseFile.get());
+		if (bufFile) {
+			bufFile->invalidate();
+			baseFile = bufFile->baseFile();
+			continue;
+		}
+		const TracingFile *const traceFile = dynamic_cast<const TracingFile*>(baseFile.get());
+		if (traceFile) {
+			baseFile = traceFile->baseFile();
+			continue;
+		}
+		break;
+	}
+}
+
 /**
  * Unlock the Kreon drive.
  */
 inline void XboxDiscPrivate::unlockKreonDrive(void)
 {
-	if (!isKreon || !this->file)
+	if (!kreonFile)
 		return;
 
-	RpFile *const rpFile = dynamic_cast<RpFile*>(this->file.get());
-	if (rpFile) {
-		rpFile->setKreonErrorSkipState(true);
-		rpFile->setKreonLockState(RpFile::KreonLockState::State2WxRipper);
-	}
+	kreonFile->setKreonErrorSkipState(true);
+	kreonFile->setKreonLockState(RpFile::KreonLockState::State2WxRipper);
+	invalidateBufferedFiles();
 }
 
 /**
@@ -283,14 +348,12 @@ inline void XboxDiscPrivate::unlockKreonDrive(void)
  */
 inline void XboxDiscPrivate::lockKreonDrive(void)
 {
-	if (!isKreon || !this->file)
+	if (!kreonFile)
 		return;
 
-	RpFile *const rpFile = dynamic_cast<RpFile*>(this->file.get());
-	if (rpFile) {
-		rpFile->setKreonErrorSkipState(false);
-		rpFile->setKreonLockState(RpFile::KreonLockState::Locked);
-	}
+	kreonFile->setKreonErrorSkipState(false);
+	kreonFile->setKreonLockState(RpFile::KreonLockState::Locked);
+	invalidateBufferedFiles();
 }
 
 /** XboxDisc **/
@@ -363,15 +426,16 @@ XboxDisc::XboxDisc(const IRpFilePtr &file)
 	}
 
 	// If this is a Kreon drive, unlock it.
+	// NOTE: rpcli may wrap the RpFile in a BufferedFile and/or TracingFile.
 	if (d->file->isDevice()) {
-		RpFile *const rpFile = dynamic_cast<RpFile*>(d->file.get());
+		const shared_ptr<RpFile> rpFile = XboxDiscPrivate::getBaseRpFile(d->file);
 		if (rpFile && rpFile->isKreonDriveModel()) {
 			// Do we have Kreon features?
 			const vector<RpFile::KreonFeature> features = rpFile->getKreonFeatureList();
 			if (!features.empty()) {
 				// Found Kreon features.
 				// TODO: Check the feature list?
-				d->isKreon = true;
+				d->kreonFile = rpFile;
 
 				// Unlock the drive.
 				d->unlockKreonDrive();
@@ -411,9 +475,9 @@ XboxDisc::XboxDisc(const IRpFilePtr &file)
 
 		if (!d->xdvdfsPartition) {
 			// Unable to open the XDVDFSPartition.
-			d->file.reset();
 			d->lockKreonDrive();
-			d->isKreon = false;
+			d->kreonFile.reset();
+			d->file.reset();
 			return;
 		}
 	}
@@ -450,6 +514,10 @@ void XboxDisc::close(void)
 
 	d->xdvdfsPartition.reset();
 
+	// Lock the Kreon drive before closing it.
+	d->lockKreonDrive();
+	d->kreonFile.reset();
+
 	// Call the superclass function.
 	super::close();
 }
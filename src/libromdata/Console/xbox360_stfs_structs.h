@@ -271,6 +271,50 @@ typedef struct _STFS_DirEntry_t {
 } STFS_DirEntry_t;
 ASSERT_STRUCT(STFS_DirEntry_t, 0x40);
 
+/**
+ * STFS: Hash table entry.
+ * Reference: https://github.com/Free60Project/wiki/blob/master/STFS.md
+ *
+ * All fields are in big-endian.
+ */
+#pragma pack(1)
+typedef struct PACKED _STFS_HashEntry {
+	uint8_t sha1[0x14];		// [0x000] SHA-1 of the data block or lower-level hash table
+	uint8_t status;			// [0x014] Status (see STFS_HashEntry_Status_e)
+	uint8_t next_block[3];		// [0x015] Next data block in the chain. (BE24; level 0 only)
+} STFS_HashEntry;
+ASSERT_STRUCT(STFS_HashEntry, 0x18);
+#pragma pack()
+
+/**
+ * STFS: Hash table entry status.
+ */
+typedef enum {
+	STFS_HASH_STATUS_UNUSED		= 0x00,
+	STFS_HASH_STATUS_FREE		= 0x40,
+	STFS_HASH_STATUS_USED		= 0x80,
+	STFS_HASH_STATUS_NEW		= 0xC0,
+
+	// For level 1 and 2 entries in packages with two copies
+	// of each hash table, this bit selects the active copy
+	// of the lower-level table.
+	STFS_HASH_STATUS_ACTIVE_INDEX	= 0x40,
+} STFS_HashEntry_Status_e;
+
+// Next block value indicating the end of a chain.
+#define STFS_HASH_NEXT_BLOCK_END 0xFFFFFFU
+
+/**
+ * STFS: Hash table.
+ * Each hash table occupies a single block.
+ */
+#define STFS_HASH_ENTRIES_PER_TABLE 0xAA
+typedef struct _STFS_HashTable {
+	STFS_HashEntry entries[STFS_HASH_ENTRIES_PER_TABLE];	// [0x000]
+	uint8_t padding[0x10];					// [0xFF0]
+} STFS_HashTable;
+ASSERT_STRUCT(STFS_HashTable, STFS_BLOCK_SIZE);
+
 #ifdef __cplusplus
 }
 #endif
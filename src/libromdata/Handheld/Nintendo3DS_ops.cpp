@@ -3,7 +3,7 @@
  * Nintendo3DS_ops.cpp: Nintendo 3DS ROM reader. (ROM operations)          *
  * Handles CCI/3DS, CIA, and SMDH files.                                   *
  *                                                                         *
- * Copyright (c) 2016-2023 by David Korth.                                 *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
  * SPDX-License-Identifier: GPL-2.0-or-later                               *
  ***************************************************************************/
 
@@ -13,20 +13,448 @@
 #include "Nintendo3DS_p.hpp"
 
 // Other rom-properties libraries
+#include "librpbase/disc/DiscReader.hpp"
+#ifdef ENABLE_DECRYPTION
+#  include "librpbase/crypto/Hash.hpp"
+#endif /* ENABLE_DECRYPTION */
+using namespace LibRpBase;
 using namespace LibRpFile;
-using LibRpBase::RomData;
+using namespace LibRpText;
 
 // For sections delegated to other RomData subclasses.
 #include "NintendoDS.hpp"
 
+// CIAReader
+#include "disc/CIAReader.hpp"
+
+// OpenMP for content verification
+#ifdef _OPENMP
+#  include <omp.h>
+#endif /* _OPENMP */
+
 // C++ STL classes
 using std::string;
+using std::unique_ptr;
 using std::vector;
 
 namespace LibRomData {
 
 /** Nintendo3DSPrivate **/
 
+#ifdef ENABLE_DECRYPTION
+/**
+ * Verify the contents against the TMD content hashes (CIA only)
+ * and the NCCH ExHeader, ExeFS, and RomFS hashes.
+ * @param results	[out] Verification results
+ * @param pParams	[in,opt] RomOpParams, for the progress callback
+ * @return 0 if verification completed; -ECANCELED if cancelled; negative POSIX error code on error.
+ */
+int Nintendo3DSPrivate::verifyContents(vector<VerifyResult> &results, RomData::RomOpParams *pParams)
+{
+	results.clear();
+
+	// Verification job for each content or partition.
+	// NOTE: The readers are created here, since loading the
+	// encryption keys isn't thread-safe. Each job has its own
+	// readers, which share the file using readAt().
+	struct VerifyJob {
+		VerifyResult result;
+
+		// Content reader and expected hash (CIA only)
+		IDiscReaderPtr content;
+		const uint8_t *content_sha256;
+		off64_t content_size;
+		off64_t content_pos;
+		unique_ptr<Hash> sha256;
+
+		// NCCH reader (nullptr if this isn't an NCCH)
+		NCCHReaderPtr ncch;
+		uint64_t ncch_bytes;	// Bytes hashed by the NCCH checks
+		bool ncch_checked;
+
+		rp::uvector<uint8_t> buf;
+	};
+	vector<VerifyJob> jobs;
+
+	auto addJob = [&jobs](uint16_t index) -> VerifyJob& {
+		jobs.emplace_back();
+		VerifyJob &job = jobs.back();
+		memset(&job.result, 0, sizeof(job.result));
+		job.result.index = index;
+		job.content_sha256 = nullptr;
+		job.content_size = 0;
+		job.content_pos = 0;
+		job.ncch_bytes = 0;
+		job.ncch_checked = false;
+		return job;
+	};
+
+	switch (romType) {
+		case RomType::CIA: {
+			if (loadTicketAndTMD() != 0) {
+				return -EIO;
+			}
+
+			// Contents are stored in TMD order, aligned to 64 bytes.
+			off64_t offset = mxh.content_start_addr;
+			jobs.reserve(content_chunks.size());
+			for (const N3DS_Content_Chunk_Record_t &p : content_chunks) {
+				const uint16_t index = be16_to_cpu(p.index);
+				const uint32_t size = static_cast<uint32_t>(be64_to_cpu(p.size));
+				VerifyJob &job = addJob(index);
+				job.result.content_id = be32_to_cpu(p.id);
+
+				if (p.type & cpu_to_be16(N3DS_CONTENT_CHUNK_ENCRYPTED)) {
+					job.content = std::make_shared<CIAReader>(file, offset, size, &mxh.ticket, index);
+				} else {
+					job.content = std::make_shared<DiscReader>(file, offset, size);
+				}
+				if (job.content->isOpen()) {
+					job.content->advise(0, 0, IRpFile::AH_SEQUENTIAL);
+					job.content_sha256 = p.sha256;
+					job.content_size = size;
+				} else {
+					// Unable to open the content.
+					// This usually means the title key isn't available.
+					job.content.reset();
+					job.result.content = VerifyStatus::NoKey;
+				}
+
+				loadNCCH(index, job.ncch);
+				offset += toNext64(size);
+			}
+			break;
+		}
+
+		case RomType::CCI:
+			for (unsigned int i = 0; i < ARRAY_SIZE(mxh.ncsd_header.partitions); i++) {
+				if (mxh.ncsd_header.partitions[i].length == 0) {
+					// Empty partition.
+					continue;
+				}
+				loadNCCH(i, addJob(i).ncch);
+			}
+			break;
+
+		case RomType::NCCH:
+			loadNCCH(0, addJob(0).ncch);
+			break;
+
+		default:
+			// Not supported.
+			return -ENOTSUP;
+	}
+
+	// Set up the hash objects and determine the total amount of data to hash.
+	uint64_t totalBytes = 0;
+	for (VerifyJob &job : jobs) {
+		job.sha256.reset(new Hash(Hash::Algorithm::SHA256));
+		if (!job.sha256->isUsable()) {
+			return -ENOTSUP;
+		}
+		totalBytes += job.content_size;
+
+		const N3DS_NCCH_Header_NoSig_t *const ncch_header =
+			(job.ncch && job.ncch->isOpen() ? job.ncch->ncchHeader() : nullptr);
+		if (!ncch_header) {
+			// Not an NCCH.
+			job.ncch.reset();
+			continue;
+		}
+		job.ncch_bytes = le32_to_cpu(ncch_header->exheader_size) +
+			(static_cast<uint64_t>(le32_to_cpu(ncch_header->exefs_size)) << media_unit_shift) +
+			(static_cast<uint64_t>(le32_to_cpu(ncch_header->romfs_hash_region_size)) << media_unit_shift);
+		totalBytes += job.ncch_bytes;
+	}
+
+	/**
+	 * Hash a region of an NCCH and check it against the expected hash.
+	 * @param job		[in] Verification job
+	 * @param pos		[in] Starting position
+	 * @param size		[in] Size
+	 * @param expected	[in] Expected SHA-256 hash
+	 * @return Verification status
+	 */
+	auto checkNCCHRegion = [](VerifyJob &job, off64_t pos, size_t size, const uint8_t *expected) -> VerifyStatus {
+		job.sha256->reset();
+		while (size > 0) {
+			const size_t sz = std::min(size, static_cast<size_t>(VERIFY_STEP_SIZE));
+			if (job.ncch->seekAndRead(pos, job.buf.data(), sz) != sz) {
+				return VerifyStatus::Error;
+			}
+			job.sha256->process(job.buf.data(), sz);
+			pos += sz;
+			size -= sz;
+		}
+
+		uint8_t digest[32];
+		job.sha256->getHash(digest, sizeof(digest));
+		if (!memcmp(digest, expected, sizeof(digest))) {
+			return VerifyStatus::OK;
+		}
+		// If the NCCH keys aren't available, NCCHReader assumes NoCrypto,
+		// so the hash won't match if the NCCH is actually encrypted.
+		// NOTE: forceNoCrypto is also set for NoCrypto NCCHs.
+		const N3DS_NCCH_Header_NoSig_t *const ncch_header = job.ncch->ncchHeader();
+		const bool isNoCrypto = !!(ncch_header->flags[N3DS_NCCH_FLAG_BIT_MASKS] & N3DS_NCCH_BIT_MASK_NoCrypto);
+		return (job.ncch->isForceNoCrypto() && !isNoCrypto) ? VerifyStatus::NoKey : VerifyStatus::Bad;
+	};
+
+	/**
+	 * Check the NCCH ExHeader, ExeFS, and RomFS hashes.
+	 * @param job Verification job
+	 */
+	auto checkNCCH = [this, &checkNCCHRegion](VerifyJob &job) {
+		const N3DS_NCCH_Header_NoSig_t *const ncch_header = job.ncch->ncchHeader();
+
+		// ExHeader (stored immediately after the NCCH header)
+		const uint32_t exheader_size = le32_to_cpu(ncch_header->exheader_size);
+		if (exheader_size != 0) {
+			job.result.exheader = checkNCCHRegion(job, sizeof(N3DS_NCCH_Header_t),
+				exheader_size, ncch_header->exheader_hash);
+		}
+
+		// ExeFS superblock
+		const off64_t exefs_offset = static_cast<off64_t>(le32_to_cpu(ncch_header->exefs_offset)) << media_unit_shift;
+		const uint32_t exefs_hash_size = le32_to_cpu(ncch_header->exefs_hash_region_size) << media_unit_shift;
+		if (exefs_offset != 0 && exefs_hash_size != 0) {
+			job.result.exefs = checkNCCHRegion(job, exefs_offset,
+				exefs_hash_size, ncch_header->exefs_uperblock_hash);
+		}
+
+		// ExeFS files
+		// NOTE: The file hashes are stored in reverse order.
+		// If the NCCH keys aren't available, the ExeFS header
+		// couldn't be decrypted, so the file table is garbage.
+		const N3DS_ExeFS_Header_t *const exefs_header = job.ncch->exefsHeader();
+		const bool isNoCrypto = !!(ncch_header->flags[N3DS_NCCH_FLAG_BIT_MASKS] & N3DS_NCCH_BIT_MASK_NoCrypto);
+		if (exefs_header && job.ncch->isForceNoCrypto() && !isNoCrypto) {
+			job.result.exefs_files = VerifyStatus::NoKey;
+		} else if (exefs_header) {
+			for (unsigned int i = 0; i < ARRAY_SIZE(exefs_header->files); i++) {
+				const N3DS_ExeFS_File_Header_t &file_header = exefs_header->files[i];
+				if (file_header.name[0] == '\0') {
+					// Empty entry.
+					continue;
+				}
+				const VerifyStatus status = checkNCCHRegion(job,
+					exefs_offset + sizeof(*exefs_header) + le32_to_cpu(file_header.offset),
+					le32_to_cpu(file_header.size),
+					exefs_header->hashes[ARRAY_SIZE(exefs_header->hashes) - 1 - i]);
+				if (status > job.result.exefs_files) {
+					// Keep the worst status.
+					job.result.exefs_files = status;
+				}
+			}
+		}
+
+		// RomFS superblock
+		const off64_t romfs_offset = static_cast<off64_t>(le32_to_cpu(ncch_header->romfs_offset)) << media_unit_shift;
+		const uint32_t romfs_hash_size = le32_to_cpu(ncch_header->romfs_hash_region_size) << media_unit_shift;
+		if (romfs_offset != 0 && romfs_hash_size != 0) {
+			job.result.romfs = checkNCCHRegion(job, romfs_offset,
+				romfs_hash_size, ncch_header->romfs_uperblock_hash);
+		}
+	};
+
+	/**
+	 * Run the next step of a verification job.
+	 * The NCCH is checked in the first step, and then
+	 * the content is hashed VERIFY_STEP_SIZE bytes at a time.
+	 * @param job Verification job
+	 */
+	auto runStep = [&checkNCCH](VerifyJob &job) {
+		if (job.buf.empty()) {
+			job.buf.resize(VERIFY_STEP_SIZE);
+		}
+		if (!job.ncch_checked) {
+			if (job.ncch) {
+				checkNCCH(job);
+				job.ncch.reset();
+			}
+			job.ncch_checked = true;
+			// NCCH checks reset the hash, so the content is hashed afterwards.
+			job.sha256->reset();
+		}
+
+		if (!job.content) {
+			// No content to hash.
+			job.buf.clear();
+			job.buf.shrink_to_fit();
+			return;
+		}
+		const size_t sz = static_cast<size_t>(std::min(job.content_size - job.content_pos,
+			static_cast<off64_t>(VERIFY_STEP_SIZE)));
+		// NOTE: Using readAt(), since DiscReader::read() uses the
+		// underlying file's position, which is shared by all jobs.
+		if (job.content->readAt(job.content_pos, job.buf.data(), sz) != sz) {
+			job.result.content = VerifyStatus::Error;
+			job.content.reset();
+			return;
+		}
+		job.sha256->process(job.buf.data(), sz);
+		job.content_pos += sz;
+
+		if (job.content_pos >= job.content_size) {
+			// Finished hashing the content.
+			uint8_t digest[32];
+			job.sha256->getHash(digest, sizeof(digest));
+			job.result.content = (!memcmp(digest, job.content_sha256, sizeof(digest)))
+				? VerifyStatus::OK : VerifyStatus::Bad;
+			job.content.reset();
+			job.buf.clear();
+			job.buf.shrink_to_fit();
+		}
+	};
+
+	// Run the jobs in parallel, one step at a time.
+	// Progress is reported and cancellation is checked after each step.
+	const int jobCount = static_cast<int>(jobs.size());
+	for (;;) {
+		int activeJobs = 0;
+		for (const VerifyJob &job : jobs) {
+			if (!job.ncch_checked || job.content) {
+				activeJobs++;
+			}
+		}
+		if (activeJobs == 0) {
+			break;
+		}
+
+		// NOTE: If only one job is active, the parallel region is disabled,
+		// so CIAReader's read/decrypt pipeline can use a second thread.
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic) if(activeJobs > 1)
+#endif /* _OPENMP */
+		for (int i = 0; i < jobCount; i++) {
+			VerifyJob &job = jobs[i];
+			if (!job.ncch_checked || job.content) {
+				runStep(job);
+			}
+		}
+
+		if (pParams && pParams->progress) {
+			uint64_t done = 0;
+			for (const VerifyJob &job : jobs) {
+				if (job.ncch_checked) {
+					done += job.ncch_bytes;
+				}
+				done += (job.content ? job.content_pos : job.content_size);
+			}
+			if (pParams->progress(done, totalBytes, pParams->progress_userdata) != 0) {
+				// Cancelled.
+				return -ECANCELED;
+			}
+		}
+	}
+
+	results.reserve(jobs.size());
+	for (const VerifyJob &job : jobs) {
+		results.push_back(job.result);
+	}
+	return 0;
+}
+#endif /* ENABLE_DECRYPTION */
+
+/**
+ * ROM operation: Verify the contents.
+ * @param pParams	[in/out] Parameters and results.
+ * @return 0 on success; positive if hash errors were found; negative POSIX error code on error.
+ */
+int Nintendo3DSPrivate::romOp_verifyContents(RomData::RomOpParams *pParams)
+{
+#ifdef ENABLE_DECRYPTION
+	vector<VerifyResult> results;
+	int ret = verifyContents(results, pParams);
+	if (ret == -ECANCELED) {
+		pParams->status = ret;
+		pParams->msg = C_("Nintendo3DS", "Content verification was cancelled.");
+		return ret;
+	} else if (ret != 0) {
+		pParams->status = ret;
+		pParams->msg = rp_sprintf(C_("Nintendo3DS", "Unable to verify the contents: %s"), strerror(-ret));
+		return ret;
+	}
+
+	// Hash names for each result field.
+	struct HashField {
+		VerifyStatus VerifyResult::*status;
+		const char *name;
+	};
+	static const HashField hashFields[] = {
+		{&VerifyResult::content,	NOP_C_("Nintendo3DS|Verify", "Content hash")},
+		{&VerifyResult::exheader,	NOP_C_("Nintendo3DS|Verify", "ExHeader hash")},
+		{&VerifyResult::exefs,		NOP_C_("Nintendo3DS|Verify", "ExeFS superblock hash")},
+		{&VerifyResult::exefs_files,	NOP_C_("Nintendo3DS|Verify", "ExeFS file hashes")},
+		{&VerifyResult::romfs,		NOP_C_("Nintendo3DS|Verify", "RomFS superblock hash")},
+	};
+
+	unsigned int hashCount = 0;
+	string msg;
+	for (const VerifyResult &result : results) {
+		string errs;
+		for (const HashField &field : hashFields) {
+			const char *s_status;
+			switch (result.*(field.status)) {
+				case VerifyStatus::NotChecked:
+					continue;
+				case VerifyStatus::OK:
+					hashCount++;
+					continue;
+				case VerifyStatus::Bad:
+					s_status = C_("Nintendo3DS|Verify", "bad");
+					break;
+				case VerifyStatus::NoKey:
+					s_status = C_("Nintendo3DS|Verify", "encryption key is not available");
+					break;
+				case VerifyStatus::Error:
+				default:
+					s_status = C_("Nintendo3DS|Verify", "read error");
+					break;
+			}
+			if (!errs.empty()) {
+				errs += "; ";
+			}
+			// tr: %1$s == hash name; %2$s == error
+			errs += rp_sprintf_p(C_("Nintendo3DS|Verify", "%1$s: %2$s"),
+				pgettext_expr("Nintendo3DS|Verify", field.name), s_status);
+		}
+
+		if (errs.empty()) {
+			continue;
+		}
+		if (!msg.empty()) {
+			msg += '\n';
+		}
+		if (romType == RomType::CIA) {
+			// tr: %1$u == content index; %2$08X == content ID; %3$s == errors
+			msg += rp_sprintf_p(C_("Nintendo3DS|Verify", "Content %1$u (ID %2$08X): %3$s"),
+				result.index, result.content_id, errs.c_str());
+		} else {
+			// tr: %1$u == partition number; %2$s == errors
+			msg += rp_sprintf_p(C_("Nintendo3DS|Verify", "Partition %1$u: %2$s"),
+				result.index, errs.c_str());
+		}
+	}
+
+	if (msg.empty()) {
+		pParams->status = 0;
+		// tr: %1$u == number of contents; %2$u == number of hashes checked
+		pParams->msg = rp_sprintf_p(C_("Nintendo3DS", "OK (%1$u contents, %2$u hashes)"),
+			static_cast<unsigned int>(results.size()), hashCount);
+		return 0;
+	}
+
+	pParams->status = 1;
+	pParams->msg = std::move(msg);
+	return pParams->status;
+#else /* !ENABLE_DECRYPTION */
+	pParams->status = -ENOTSUP;
+	pParams->msg = C_("Nintendo3DS", "SHA-256 is not available in this build.");
+	return -ENOTSUP;
+#endif /* ENABLE_DECRYPTION */
+}
+
 /**
  * Get the list of operations that can be performed on this ROM.
  * Internal function; called by RomData::romOps().
@@ -52,6 +480,23 @@ vector<RomData::RomOp> Nintendo3DS::romOps_int(void) const
 		ops.emplace_back(std::move(op));
 	}
 
+	// Verify the contents. (CIA, CCI, and NCCH only)
+	switch (d->romType) {
+		case Nintendo3DSPrivate::RomType::CIA:
+		case Nintendo3DSPrivate::RomType::CCI:
+		case Nintendo3DSPrivate::RomType::NCCH: {
+			// NOTE: SHA-256 is only available if decryption is enabled.
+			RomOp op(C_("Nintendo3DS|RomOps", "&Verify Contents"), RomOp::ROF_ENABLED);
+#ifndef ENABLE_DECRYPTION
+			op.flags &= ~RomOp::ROF_ENABLED;
+#endif /* ENABLE_DECRYPTION */
+			ops.emplace_back(std::move(op));
+			break;
+		}
+		default:
+			break;
+	}
+
 	return ops;
 }
 
@@ -60,18 +505,24 @@ vector<RomData::RomOp> Nintendo3DS::romOps_int(void) const
  * Internal function; called by RomData::doRomOp().
  * @param id		[in] Operation index.
  * @param pParams	[in/out] Parameters and results. (for e.g. UI updates)
- * @return 0 on success; negative POSIX error code on error.
+ * @return 0 on success; positive if hash errors were found; negative POSIX error code on error.
  */
 int Nintendo3DS::doRomOp_int(int id, RomOpParams *pParams)
 {
 	RP_D(Nintendo3DS);
 
-	// Currently only one ROM operation.
-	if (id != 0) {
+	// ROM operations:
+	// - Extract SRL (DSiWare SRLs only; this is the only one that saves a file)
+	// - Verify Contents
+	const vector<RomOp> ops = romOps_int();
+	if (id < 0 || id >= static_cast<int>(ops.size())) {
 		pParams->status = -EINVAL;
 		pParams->msg = C_("RomData", "ROM operation ID is invalid for this object.");
 		return -EINVAL;
 	}
+	if (!(ops[id].flags & RomOp::ROF_SAVE_FILE)) {
+		return d->romOp_verifyContents(pParams);
+	}
 
 	assert(pParams->save_filename != nullptr);
 	if (!pParams->save_filename) {
@@ -135,8 +586,12 @@ int Nintendo3DS::doRomOp_int(int id, RomOpParams *pParams)
 	}
 
 	// Extract the file.
+	// NOTE: The SRL is read sequentially, so enable read-ahead.
+	// For CIAs, this also overlaps reading and decrypting the content.
+	srcFile->advise(0, 0, IRpFile::AH_SEQUENTIAL);
 	srcFile->rewind();
 	ret = srcFile->copyTo(destFile, srcFile->size());
+	srcFile->advise(0, 0, IRpFile::AH_NORMAL);
 	pParams->status = ret;
 	switch (ret) {
 		case 0:
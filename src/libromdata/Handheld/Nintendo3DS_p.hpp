@@ -10,6 +10,7 @@
 #pragma once
 
 #include "common.h"
+#include "librpbase/config.librpbase.h"
 #include "n3ds_structs.h"
 
 // librpbase
@@ -256,6 +257,51 @@ public:
 	 * @return 0 on success; non-zero on error.
 	 */
 	int addFields_permissions(void);
+
+public:
+	/** ROM operations **/
+
+	/**
+	 * ROM operation: Verify the contents.
+	 * @param pParams	[in/out] Parameters and results.
+	 * @return 0 on success; positive if hash errors were found; negative POSIX error code on error.
+	 */
+	int romOp_verifyContents(LibRpBase::RomData::RomOpParams *pParams);
+
+#ifdef ENABLE_DECRYPTION
+public:
+	// Content verification status
+	enum class VerifyStatus : uint8_t {
+		NotChecked = 0,	// Not present, or not checked
+		OK,		// Hash matches
+		Bad,		// Hash doesn't match
+		NoKey,		// Hash doesn't match, but the encryption keys are unavailable
+		Error,		// Read error
+	};
+
+	// Content verification results, for each content or partition.
+	struct VerifyResult {
+		uint16_t index;			// Content index (CIA) or partition number (CCI)
+		uint32_t content_id;		// Content ID (CIA only)
+		VerifyStatus content;		// Content hash, from the TMD (CIA only)
+		VerifyStatus exheader;		// ExHeader hash
+		VerifyStatus exefs;		// ExeFS superblock hash
+		VerifyStatus exefs_files;	// ExeFS file hashes
+		VerifyStatus romfs;		// RomFS superblock hash
+	};
+
+	// Amount of content data hashed at once when verifying.
+	static constexpr size_t VERIFY_STEP_SIZE = 4U * 1024U * 1024U;
+
+	/**
+	 * Verify the contents against the TMD content hashes (CIA only)
+	 * and the NCCH ExHeader, ExeFS, and RomFS hashes.
+	 * @param results	[out] Verification results
+	 * @param pParams	[in,opt] RomOpParams, for the progress callback
+	 * @return 0 if verification completed; -ECANCELED if cancelled; negative POSIX error code on error.
+	 */
+	int verifyContents(std::vector<VerifyResult> &results, LibRpBase::RomData::RomOpParams *pParams);
+#endif /* ENABLE_DECRYPTION */
 };
 
 } // namespace LibRomData
@@ -523,6 +523,112 @@ typedef struct _N3DS_ExeFS_Header_t {
 } N3DS_ExeFS_Header_t;
 ASSERT_STRUCT(N3DS_ExeFS_Header_t, 512);
 
+/**
+ * Nintendo 3DS: IVFC level descriptor.
+ * Reference: https://3dbrew.org/wiki/RomFS
+ *
+ * All fields are little-endian.
+ */
+#pragma pack(1)
+typedef struct PACKED _N3DS_IVFC_Level_t {
+	uint64_t logical_offset;	// [0x000] Logical offset
+	uint64_t hashdata_size;		// [0x008] Hash data size
+	uint32_t block_size_log2;	// [0x010] Block size, in log2
+	uint32_t reserved;		// [0x014]
+} N3DS_IVFC_Level_t;
+ASSERT_STRUCT(N3DS_IVFC_Level_t, 0x18);
+#pragma pack()
+
+/**
+ * Nintendo 3DS: RomFS IVFC header.
+ * Located at the start of the RomFS.
+ * Reference: https://3dbrew.org/wiki/RomFS
+ *
+ * Level 3 (the actual filesystem) is located immediately after
+ * the header and master hash, aligned to the level 3 block size.
+ *
+ * All fields are little-endian.
+ */
+#define N3DS_IVFC_MAGIC 'IVFC'
+#define N3DS_IVFC_ROMFS_MAGIC_NUMBER 0x10000
+#pragma pack(1)
+typedef struct PACKED _N3DS_IVFC_Header_t {
+	uint32_t magic;			// [0x000] 'IVFC' (big-endian)
+	uint32_t magic_number;		// [0x004] 0x10000
+	uint32_t master_hash_size;	// [0x008] Master hash size
+	N3DS_IVFC_Level_t levels[3];	// [0x00C] Levels 1-3
+	uint32_t reserved;		// [0x054]
+	uint32_t optional_info_size;	// [0x058]
+} N3DS_IVFC_Header_t;
+ASSERT_STRUCT(N3DS_IVFC_Header_t, 0x5C);
+#pragma pack()
+
+// Size of the IVFC header area before the master hash.
+#define N3DS_IVFC_HEADER_AREA_SIZE 0x60
+
+/**
+ * Nintendo 3DS: RomFS level 3 header.
+ * Reference: https://3dbrew.org/wiki/RomFS
+ *
+ * All offsets are relative to the start of level 3.
+ * All fields are little-endian.
+ */
+typedef struct _N3DS_RomFS_Level3_Header_t {
+	uint32_t header_length;		// [0x000] Header length (0x28)
+	uint32_t dir_hash_offset;	// [0x004] Directory hash table offset
+	uint32_t dir_hash_length;	// [0x008] Directory hash table length
+	uint32_t dir_meta_offset;	// [0x00C] Directory metadata table offset
+	uint32_t dir_meta_length;	// [0x010] Directory metadata table length
+	uint32_t file_hash_offset;	// [0x014] File hash table offset
+	uint32_t file_hash_length;	// [0x018] File hash table length
+	uint32_t file_meta_offset;	// [0x01C] File metadata table offset
+	uint32_t file_meta_length;	// [0x020] File metadata table length
+	uint32_t file_data_offset;	// [0x024] File data offset
+} N3DS_RomFS_Level3_Header_t;
+ASSERT_STRUCT(N3DS_RomFS_Level3_Header_t, 0x28);
+
+// RomFS: Unused metadata offset.
+#define N3DS_ROMFS_NO_ENTRY 0xFFFFFFFFU
+
+/**
+ * Nintendo 3DS: RomFS directory metadata.
+ * Followed by the UTF-16LE name, padded to 4 bytes.
+ * Reference: https://3dbrew.org/wiki/RomFS
+ *
+ * All offsets are relative to the start of the directory metadata table.
+ * All fields are little-endian.
+ */
+typedef struct _N3DS_RomFS_DirEntry_t {
+	uint32_t parent_offset;		// [0x000] Parent directory
+	uint32_t next_sibling_offset;	// [0x004] Next sibling directory
+	uint32_t first_child_offset;	// [0x008] First subdirectory
+	uint32_t first_file_offset;	// [0x00C] First file (file metadata table)
+	uint32_t next_hash_offset;	// [0x010] Next directory in the same hash table bucket
+	uint32_t name_length;		// [0x014] Name length, in bytes
+} N3DS_RomFS_DirEntry_t;
+ASSERT_STRUCT(N3DS_RomFS_DirEntry_t, 0x18);
+
+/**
+ * Nintendo 3DS: RomFS file metadata.
+ * Followed by the UTF-16LE name, padded to 4 bytes.
+ * Reference: https://3dbrew.org/wiki/RomFS
+ *
+ * All offsets are relative to the start of the file metadata table,
+ * except for parent_offset, which is in the directory metadata table.
+ * All fields are little-endian.
+ */
+#pragma pack(1)
+typedef struct PACKED _N3DS_RomFS_FileEntry_t {
+	uint32_t parent_offset;		// [0x000] Parent directory
+	uint32_t next_sibling_offset;	// [0x004] Next sibling file
+	uint64_t data_offset;		// [0x008] File data offset (relative to file data)
+	uint64_t data_size;		// [0x010] File data size
+	uint32_t next_hash_offset;	// [0x018] Next file in the same hash table bucket
+	uint32_t name_length;		// [0x01C] Name length, in bytes
+} N3DS_RomFS_FileEntry_t;
+ASSERT_STRUCT(N3DS_RomFS_FileEntry_t, 0x20);
+#pragma pack()
+
 /**
  * Nintendo 3DS: Ticket and Title Metadata signature type.
  * TMD header location depends on the signature type.
@@ -14,7 +14,10 @@
 #include "RomData_p.hpp"	// for RomDataInfo
 
 // librpbase, librpfile
+#include "librpfile/BufferedFile.hpp"
+#include "librpfile/CompressedFile.hpp"
 #include "librpfile/DualFile.hpp"
+#include "librpfile/ReadBatch.hpp"
 #include "librpfile/RelatedFile.hpp"
 using namespace LibRpBase;
 using namespace LibRpFile;
@@ -121,11 +124,13 @@ using std::vector;
 #include "Console/dc_structs.h"
 
 // Sparse disc image formats
+#include "disc/ChdReader.hpp"
 #include "disc/CisoGcnReader.hpp"
 #include "disc/CisoPspReader.hpp"
 #include "disc/DpfReader.hpp"
 #include "disc/GczReader.hpp"
 #include "disc/NASOSReader.hpp"
+#include "disc/WiaReader.hpp"
 #include "disc/WbfsReader.hpp"
 #include "disc/WuxReader.hpp"
 
@@ -390,7 +395,8 @@ static IDiscReaderPtr IDiscReader_ctor(const IRpFilePtr &file)
 	 magic}
 
 #define P99_PROTECT(...) __VA_ARGS__	/* Reference: https://stackoverflow.com/a/5504336 */
-static const array<IDiscReaderFns, 6> iDiscReaderFns = {{
+static const array<IDiscReaderFns, 8> iDiscReaderFns = {{
+	GetIDiscReaderFns(ChdReader,		P99_PROTECT({{'MCom'}})),
 	GetIDiscReaderFns(CisoGcnReader,	P99_PROTECT({{'CISO'}})),
 	// NOTE: MSVC doesn't like putting #ifdef within the P99_PROTECT macro.
 	// TODO: Disable ZISO and JISO if LZ4 and LZO aren't available?
@@ -399,6 +405,7 @@ static const array<IDiscReaderFns, 6> iDiscReaderFns = {{
 	GetIDiscReaderFns(GczReader,		P99_PROTECT({{0xB10BC001}})),
 	GetIDiscReaderFns(NASOSReader,		P99_PROTECT({{'GCML', 'GCMM', 'WII5', 'WII9'}})),
 	//GetIDiscReaderFns(WbfsReader,		P99_PROTECT({{'WBFS'}})),	// Handled separately
+	GetIDiscReaderFns(WiaReader,		P99_PROTECT({{'WIA\x01', 'RVZ\x01'}})),
 	GetIDiscReaderFns(WuxReader,		P99_PROTECT({{'WUX0'}})),	// NOTE: Not checking second magic here.
 }};
 
@@ -664,6 +671,79 @@ RomDataPtr checkISO(const IRpFilePtr &file)
 	return nullptr;
 }
 
+/**
+ * Get header data from a file.
+ *
+ * If the file supports zero-copy access (e.g. a memory-mapped RpFile),
+ * a pointer to the file data is returned directly. Otherwise, the data
+ * is read into the specified buffer.
+ *
+ * @param file		[in] IRpFile
+ * @param addr		[in] Header address
+ * @param size		[in] Requested header size
+ * @param buf		[out] Fallback buffer (must be at least size bytes, 32-bit aligned)
+ * @param pcbHeader	[out] Number of bytes available
+ * @return Pointer to the header data, or nullptr on error.
+ */
+static const uint8_t *getHeaderData(const IRpFilePtr &file, off64_t addr, size_t size,
+	uint8_t *buf, uint32_t *pcbHeader)
+{
+	if (file->isPeekZeroCopy()) {
+		const off64_t szFile = file->size();
+		if (addr < szFile) {
+			const size_t cbAvail = static_cast<size_t>(
+				std::min(static_cast<off64_t>(size), szFile - addr));
+			const uint8_t *const pData = file->peek(addr, cbAvail);
+			// NOTE: isRomSupported() functions may access the header
+			// as 32-bit words, so the pointer must be 32-bit aligned.
+			// peek() doesn't guarantee this, e.g. for the footer.
+			if (pData && (reinterpret_cast<uintptr_t>(pData) & 3) == 0) {
+				*pcbHeader = static_cast<uint32_t>(cbAvail);
+				return pData;
+			}
+		}
+	}
+
+	// Read the header data into the buffer.
+	*pcbHeader = static_cast<uint32_t>(file->seekAndRead(addr, buf, size));
+	return (*pcbHeader != 0) ? buf : nullptr;
+}
+
+/**
+ * Wrap a file in a BufferedFile if it would benefit from it.
+ *
+ * Many RomData subclasses issue lots of small reads, which can be
+ * expensive if the file isn't local (e.g. GVfs or KIO). Files that
+ * support zero-copy access are already fast, and devices need to be
+ * accessed directly, so these are returned as-is.
+ *
+ * @param file IRpFile
+ * @return BufferedFile, or the original IRpFile.
+ */
+static IRpFilePtr getBufferedFile(const IRpFilePtr &file)
+{
+	if (file->isPeekZeroCopy() || file->isDevice() ||
+	    dynamic_cast<const BufferedFile*>(file.get()) != nullptr)
+	{
+		// No buffering needed.
+		return file;
+	}
+
+	return std::make_shared<BufferedFile>(file);
+}
+
+/**
+ * Get a Big-Endian 32-bit value from header data.
+ * @param pData Header data (may be unaligned)
+ * @return 32-bit value
+ */
+static inline uint32_t getHeaderBE32(const uint8_t *pData)
+{
+	uint32_t val;
+	memcpy(&val, pData, sizeof(val));
+	return be32_to_cpu(val);
+}
+
 } // namespace Private
 
 /** RomDataFactory **/
@@ -679,28 +759,36 @@ RomDataPtr checkISO(const IRpFilePtr &file)
  * types must be supported by the RomData subclass in order to
  * be returned.
  *
- * @param file ROM file.
+ * Compressed files (seekable zstd, xz) are transparently decompressed.
+ * Files that don't support zero-copy access are wrapped in a BufferedFile.
+ *
+ * @param srcFile ROM file.
  * @param attrs RomDataAttr bitfield. If set, RomData subclass must have the specified attributes.
  * @return RomData subclass, or nullptr if the ROM isn't supported.
  */
-RomDataPtr create(const IRpFilePtr &file, unsigned int attrs)
+RomDataPtr create(const IRpFilePtr &srcFile, unsigned int attrs)
 {
 	RomData::DetectInfo info;
 
+	// Transparently decompress compressed files.
+	// Use a BufferedFile for non-mmap files.
+	const IRpFilePtr cfile = CompressedFile::open(srcFile);
+	const IRpFilePtr file = Private::getBufferedFile(cfile ? cfile : srcFile);
+
 	// Get the file size.
 	info.szFile = file->size();
 
 	// Read 4,096+256 bytes from the ROM header.
 	// This should be enough to detect most systems.
+	// NOTE: If the file supports zero-copy access, the header
+	// is accessed directly and this buffer isn't used.
 	union {
 		uint8_t u8[4096+256];
 		uint32_t u32[(4096+256)/4];
 	} header;
-	file->rewind();
 	info.header.addr = 0;
-	info.header.pData = header.u8;
-	info.header.size = static_cast<uint32_t>(file->read(header.u8, sizeof(header.u8)));
-	if (info.header.size == 0) {
+	info.header.pData = Private::getHeaderData(file, 0, sizeof(header.u8), header.u8, &info.header.size);
+	if (!info.header.pData) {
 		// Read error.
 		return {};
 	}
@@ -740,15 +828,21 @@ RomDataPtr create(const IRpFilePtr &file, unsigned int attrs)
 	// If a sparse disc image format is detected, this will be
 	// a SparseDiscReader. Otherwise, it'll be the same as `file`.
 	bool isSparseDiscReader = false;
-	IRpFilePtr reader(Private::openIDiscReader(file, header.u32[0]));
+	IRpFilePtr reader;
+	if (info.header.size >= sizeof(uint32_t)) {
+		uint32_t magic0;
+		memcpy(&magic0, info.header.pData, sizeof(magic0));
+		reader = Private::openIDiscReader(file, magic0);
+	}
 	if (reader) {
 		// SparseDiscReader obtained. Re-read the header.
-		reader->rewind();
-		info.header.size = static_cast<uint32_t>(reader->read(header.u8, sizeof(header.u8)));
-		if (info.header.size == 0) {
+		info.header.pData = Private::getHeaderData(reader, 0, sizeof(header.u8), header.u8, &info.header.size);
+		if (!info.header.pData) {
 			// Read error.
 			return {};
 		}
+		// Header addresses are relative to the uncompressed image.
+		info.szFile = reader->size();
 		isSparseDiscReader = true;
 	} else {
 		// No SparseDiscReader. Use the original file.
@@ -772,8 +866,7 @@ RomDataPtr create(const IRpFilePtr &file, unsigned int attrs)
 		}
 
 		// Check the magic number.
-		// TODO: Verify alignment restrictions.
-		const uint32_t magic = be32_to_cpu(header.u32[fns.address/4]);
+		const uint32_t magic = Private::getHeaderBE32(&info.header.pData[fns.address]);
 		if (magic == fns.size) {
 			// Found a matching magic number.
 			if (fns.isRomSupported(&info) >= 0) {
@@ -865,10 +958,11 @@ RomDataPtr create(const IRpFilePtr &file, unsigned int attrs)
 
 			// Read the header data.
 			info.header.addr = fns.address;
-			int ret = reader->seek(info.header.addr);
-			if (ret != 0)
+			const uint8_t *const pData = Private::getHeaderData(
+				reader, info.header.addr, fns.size, header.u8, &info.header.size);
+			if (!pData)
 				continue;
-			info.header.size = static_cast<uint32_t>(reader->read(header.u8, fns.size));
+			info.header.pData = pData;
 			if (info.header.size != fns.size)
 				continue;
 		}
@@ -937,8 +1031,9 @@ RomDataPtr create(const IRpFilePtr &file, unsigned int attrs)
 			static constexpr int footer_size = 1024;
 			if (info.szFile > footer_size) {
 				info.header.addr = static_cast<uint32_t>(info.szFile - footer_size);
-				info.header.size = static_cast<uint32_t>(reader->seekAndRead(info.header.addr, header.u8, footer_size));
-				if (info.header.size == 0) {
+				info.header.pData = Private::getHeaderData(
+					reader, info.header.addr, footer_size, header.u8, &info.header.size);
+				if (!info.header.pData) {
 					// Seek and/or read error.
 					return {};
 				}
@@ -998,7 +1093,10 @@ static RomDataPtr T_create(const CharType *filename, unsigned int attrs)
 	// call create(IRpFile*,unsigned int).
 	if (likely(!FileSystem::is_directory(filename))) {
 		// Not a directory.
-		shared_ptr<RpFile> file = std::make_shared<RpFile>(filename, RpFile::FM_OPEN_READ_GZ);
+		// NOTE: The gzip index is cached so later accesses to the
+		// same gzipped file don't have to decompress it again.
+		shared_ptr<RpFile> file = std::make_shared<RpFile>(filename,
+			static_cast<RpFile::FileMode>(RpFile::FM_OPEN_READ_GZ | RpFile::FM_GZIP_INDEX_CACHE));
 		if (file->isOpen()) {
 			romData = create(file, attrs);
 		}
@@ -1068,6 +1166,188 @@ RomDataPtr create(const wchar_t *filename, unsigned int attrs)
 }
 #endif /* _WIN32 && _UNICODE */
 
+namespace Private {
+
+/**
+ * Get the block-aligned regions that create() will read from a file.
+ * These are read ahead of time by createBatch().
+ * @param szFile	[in] File size
+ * @param blockSize	[in] BufferedFile block size
+ * @return Block addresses (sorted, no duplicates)
+ */
+static vector<off64_t> getProbeBlocks(off64_t szFile, unsigned int blockSize)
+{
+	// Regions read by create() and checkISO().
+	// NOTE: The footer is handled separately.
+	static const array<off64_t, 6> probeAddrs = {{
+		0,				// Header
+		0x7FE0,				// Sega 8-bit header
+		0x40000,			// game.com header (alternate address)
+		ISO_PVD_ADDRESS_2048,		// ISO-9660 PVD (2048-byte sectors)
+		ISO_PVD_ADDRESS_2352,		// ISO-9660 PVD (2352-byte sectors)
+		XDVDFS_HEADER_LBA_OFFSET * XDVDFS_BLOCK_SIZE,	// XDVDFS header
+	}};
+
+	const off64_t blockMask = ~static_cast<off64_t>(blockSize - 1);
+	vector<off64_t> blocks;
+	blocks.reserve(probeAddrs.size() + 2);
+	for (const off64_t addr : probeAddrs) {
+		if (addr < szFile) {
+			blocks.push_back(addr & blockMask);
+		}
+	}
+
+	// Footer (last 1,024 bytes), if create() will check it.
+	static constexpr off64_t footer_size = 1024;
+	if (szFile > footer_size && szFile <= (1LL << 30)) {
+		blocks.push_back((szFile - footer_size) & blockMask);
+		blocks.push_back((szFile - 1) & blockMask);
+	}
+
+	std::sort(blocks.begin(), blocks.end());
+	blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+	return blocks;
+}
+
+/**
+ * Create RomData subclasses for multiple ROM files.
+ * @param filenames	[in] ROM filenames (encoding depends on CharType)
+ * @param count		[in] Number of filenames
+ * @param attrs		[in] RomDataAttr bitfield
+ * @return RomData subclasses (nullptr for unsupported files)
+ */
+template<typename CharType>
+static vector<RomDataPtr> T_createBatch(const CharType *const *filenames, size_t count, unsigned int attrs)
+{
+	vector<RomDataPtr> romDataList(count);
+
+	// Files are processed in groups so the read-ahead
+	// buffers don't get too large.
+	static constexpr size_t GROUP_SIZE = 32;
+
+	struct BatchFile {
+		shared_ptr<RpFile> file;		// Underlying file
+		shared_ptr<BufferedFile> bufFile;	// BufferedFile (nullptr if not batched)
+		vector<off64_t> blocks;			// Blocks to read ahead
+		vector<size_t> reqIdx;			// ReadBatch request indexes
+		rp::uvector<uint8_t> buf;		// Read-ahead buffer
+	};
+	vector<BatchFile> group;
+	group.reserve(GROUP_SIZE);
+
+	ReadBatch batch;
+	for (size_t base = 0; base < count; base += GROUP_SIZE) {
+		const size_t groupCount = std::min(GROUP_SIZE, count - base);
+		group.clear();
+		group.resize(groupCount);
+		batch.clear();
+
+		// Open the files and queue the read-ahead requests.
+		for (size_t i = 0; i < groupCount; i++) {
+			const CharType *const filename = filenames[base + i];
+			if (!filename || FileSystem::is_directory(filename)) {
+				// Directories are handled by create().
+				continue;
+			}
+
+			// NOTE: Not using mmap here. The read-ahead data
+			// is stored in a BufferedFile instead.
+			BatchFile &bf = group[i];
+			bf.file = std::make_shared<RpFile>(filename, RpFile::FM_OPEN_READ_GZ);
+			if (!bf.file->isOpen()) {
+				bf.file.reset();
+				continue;
+			}
+			if (bf.file->isCompressed() || bf.file->isDevice()) {
+				// Can't read ahead on this file.
+				continue;
+			}
+			const off64_t szFile = bf.file->size();
+			if (szFile <= 0) {
+				continue;
+			}
+
+			bf.bufFile = std::make_shared<BufferedFile>(bf.file);
+			const unsigned int blockSize = bf.bufFile->blockSize();
+			bf.blocks = getProbeBlocks(szFile, blockSize);
+			bf.buf.resize(bf.blocks.size() * blockSize);
+			bf.reqIdx.resize(bf.blocks.size());
+			for (size_t j = 0; j < bf.blocks.size(); j++) {
+				const off64_t pos = bf.blocks[j];
+				const size_t size = static_cast<size_t>(
+					std::min<off64_t>(blockSize, szFile - pos));
+				bf.reqIdx[j] = batch.add(bf.file, pos, &bf.buf[j * blockSize], size);
+			}
+		}
+
+		// Read everything at once.
+		batch.submit();
+
+		// Detect the files.
+		for (size_t i = 0; i < groupCount; i++) {
+			BatchFile &bf = group[i];
+			if (bf.bufFile) {
+				// Add the read-ahead blocks to the cache.
+				const unsigned int blockSize = bf.bufFile->blockSize();
+				for (size_t j = 0; j < bf.blocks.size(); j++) {
+					const size_t size = batch.result(bf.reqIdx[j]);
+					if (size > 0) {
+						bf.bufFile->prime(bf.blocks[j], &bf.buf[j * blockSize], size);
+					}
+				}
+				romDataList[base + i] = create(bf.bufFile, attrs);
+			} else if (bf.file) {
+				romDataList[base + i] = create(bf.file, attrs);
+			} else if (filenames[base + i]) {
+				// Directory, or the file couldn't be opened.
+				romDataList[base + i] = T_create(filenames[base + i], attrs);
+			}
+		}
+	}
+
+	return romDataList;
+}
+
+} // namespace Private
+
+/**
+ * Create RomData subclasses for multiple ROM files.
+ *
+ * The initial detection reads for all files are submitted together
+ * using ReadBatch (io_uring on Linux, if available), and then each
+ * file is detected using the read-ahead data. This is faster than
+ * calling create() for each file if the files are on slow storage.
+ *
+ * @param filenames ROM filenames (UTF-8)
+ * @param count Number of filenames
+ * @param attrs RomDataAttr bitfield. If set, RomData subclass must have the specified attributes.
+ * @return RomData subclasses, in the same order as filenames. (nullptr for unsupported files)
+ */
+vector<RomDataPtr> createBatch(const char *const *filenames, size_t count, unsigned int attrs)
+{
+	return Private::T_createBatch(filenames, count, attrs);
+}
+
+#if defined(_WIN32) && defined(_UNICODE)
+/**
+ * Create RomData subclasses for multiple ROM files.
+ *
+ * The initial detection reads for all files are submitted together
+ * using ReadBatch, and then each file is detected using the
+ * read-ahead data. This is faster than calling create() for each
+ * file if the files are on slow storage.
+ *
+ * @param filenames ROM filenames (UTF-16)
+ * @param count Number of filenames
+ * @param attrs RomDataAttr bitfield. If set, RomData subclass must have the specified attributes.
+ * @return RomData subclasses, in the same order as filenames. (nullptr for unsupported files)
+ */
+vector<RomDataPtr> createBatch(const wchar_t *const *filenames, size_t count, unsigned int attrs)
+{
+	return Private::T_createBatch(filenames, count, attrs);
+}
+#endif /* _WIN32 && _UNICODE */
+
 #ifdef ROMDATAFACTORY_USE_FILE_EXTENSIONS
 namespace Private {
 
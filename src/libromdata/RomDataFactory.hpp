@@ -66,6 +66,8 @@ enum RomDataAttr {
  * types must be supported by the RomData subclass in order to
  * be returned.
  *
+ * Files that don't support zero-copy access are wrapped in a BufferedFile.
+ *
  * @param file ROM file
  * @param attrs RomDataAttr bitfield. If set, RomData subclass must have the specified attributes.
  * @return RomData subclass, or nullptr if the ROM isn't supported.
@@ -119,6 +121,40 @@ RP_LIBROMDATA_PUBLIC
 LibRpBase::RomDataPtr create(const wchar_t *filename, unsigned int attrs = 0);
 #endif /* _WIN32 && _UNICODE */
 
+/**
+ * Create RomData subclasses for multiple ROM files.
+ *
+ * The initial detection reads for all files are submitted together
+ * using ReadBatch (io_uring on Linux, if available), and then each
+ * file is detected using the read-ahead data. This is faster than
+ * calling create() for each file if the files are on slow storage.
+ *
+ * @param filenames ROM filenames (UTF-8)
+ * @param count Number of filenames
+ * @param attrs RomDataAttr bitfield. If set, RomData subclass must have the specified attributes.
+ * @return RomData subclasses, in the same order as filenames. (nullptr for unsupported files)
+ */
+RP_LIBROMDATA_PUBLIC
+std::vector<LibRpBase::RomDataPtr> createBatch(const char *const *filenames, size_t count, unsigned int attrs = 0);
+
+#if defined(_WIN32) && defined(_UNICODE)
+/**
+ * Create RomData subclasses for multiple ROM files.
+ *
+ * The initial detection reads for all files are submitted together
+ * using ReadBatch, and then each file is detected using the
+ * read-ahead data. This is faster than calling create() for each
+ * file if the files are on slow storage.
+ *
+ * @param filenames ROM filenames (UTF-16)
+ * @param count Number of filenames
+ * @param attrs RomDataAttr bitfield. If set, RomData subclass must have the specified attributes.
+ * @return RomData subclasses, in the same order as filenames. (nullptr for unsupported files)
+ */
+RP_LIBROMDATA_PUBLIC
+std::vector<LibRpBase::RomDataPtr> createBatch(const wchar_t *const *filenames, size_t count, unsigned int attrs = 0);
+#endif /* _WIN32 && _UNICODE */
+
 #ifdef ROMDATAFACTORY_USE_FILE_EXTENSIONS
 struct ExtInfo {
 	const char *ext;
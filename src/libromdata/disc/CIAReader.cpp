@@ -12,6 +12,7 @@
 
 // Other rom-properties libraries
 #include "librpbase/disc/CBCReader.hpp"
+#include "librpfile/IoTrace.hpp"
 #ifdef ENABLE_DECRYPTION
 #  include "librpbase/crypto/AesCipherFactory.hpp"
 #  include "librpbase/crypto/IAesCipher.hpp"
@@ -21,6 +22,9 @@
 using namespace LibRpBase;
 using namespace LibRpFile;
 
+// C++ includes
+#include <typeinfo>
+
 // C++ STL classes
 using std::array;
 
@@ -232,9 +236,10 @@ size_t CIAReader::read(void *ptr, size_t size)
 		return 0;
 	}
 
+	IoTrace::Scope trace(IoTrace::Op::Read, typeid(*this).name(), -1, size);
 	size_t ret = d->cbcReader->read(ptr, size);
 	m_lastError = d->cbcReader->lastError();
-	return ret;
+	return trace.ret(ret);
 }
 
 /**
@@ -301,4 +306,26 @@ off64_t CIAReader::size(void)
 	return ret;
 }
 
+/** Access pattern hints **/
+
+/**
+ * Tell the OS how a range of the file will be accessed.
+ *
+ * AH_SEQUENTIAL also enables decryption read-ahead,
+ * e.g. when extracting or hashing the entire content.
+ *
+ * @param pos	[in] Start position.
+ * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+ * @param hint	[in] Access hint.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int CIAReader::advise(off64_t pos, off64_t size, AccessHint hint)
+{
+	RP_D(const CIAReader);
+	if (!m_file || !d->cbcReader) {
+		return -EBADF;
+	}
+	return d->cbcReader->advise(pos, size, hint);
+}
+
 }
@@ -90,6 +90,22 @@ public:
 	 * @return Data size, or -1 on error.
 	 */
 	off64_t size(void) final;
+
+public:
+	/** Access pattern hints **/
+
+	/**
+	 * Tell the OS how a range of the file will be accessed.
+	 *
+	 * AH_SEQUENTIAL also enables decryption read-ahead,
+	 * e.g. when extracting or hashing the entire content.
+	 *
+	 * @param pos	[in] Start position.
+	 * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+	 * @param hint	[in] Access hint.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int advise(off64_t pos, off64_t size, AccessHint hint) final;
 };
 
 typedef std::shared_ptr<CIAReader> CIAReaderPtr;
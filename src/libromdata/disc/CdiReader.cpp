@@ -112,6 +112,16 @@ public:
 	 * @return 0 on success; non-zero on error.
 	 */
 	int getTrackLBAInfo(int trackNumber, unsigned int &lba_start, unsigned int &lba_size, unsigned int &pregap_length);
+
+	/**
+	 * Find the block range that contains the specified block.
+	 * @param blockIdx Block index
+	 * @return Block range, or nullptr if not found.
+	 */
+	const BlockRange *findBlockRange(uint32_t blockIdx) const;
+
+	// Maximum number of raw sectors to read at once
+	static constexpr unsigned int RAW_SECTORS_MAX = 64;
 };
 
 /** CdiReaderPrivate **/
@@ -423,6 +433,31 @@ int CdiReaderPrivate::getTrackLBAInfo(int trackNumber, unsigned int &lba_start,
 	return 0;
 }
 
+/**
+ * Find the block range that contains the specified block.
+ * @param blockIdx Block index
+ * @return Block range, or nullptr if not found.
+ */
+const CdiReaderPrivate::BlockRange *CdiReaderPrivate::findBlockRange(uint32_t blockIdx) const
+{
+	// TODO: Cache this lookup somewhere or something.
+	for (const BlockRange &vbr : blockRanges) {
+		if (blockIdx < vbr.blockStart) {
+			// Not in this track.
+			continue;
+		}
+
+		// Check the end block.
+		if (vbr.blockEnd != 0 && blockIdx <= vbr.blockEnd) {
+			// Found the track.
+			return &vbr;
+		}
+	}
+
+	// Not found in any block range.
+	return nullptr;
+}
+
 /** CdiReader **/
 
 CdiReader::CdiReader(const IRpFilePtr &file)
@@ -558,22 +593,7 @@ int CdiReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 	}
 
 	// Find the block.
-	// TODO: Cache this lookup somewhere or something.
-	const CdiReaderPrivate::BlockRange *blockRange = nullptr;
-	for (const CdiReaderPrivate::BlockRange &vbr : d->blockRanges) {
-		if (blockIdx < vbr.blockStart) {
-			// Not in this track.
-			continue;
-		}
-
-		// Check the end block.
-		if (vbr.blockEnd != 0 && blockIdx <= vbr.blockEnd) {
-			// Found the track.
-			blockRange = (const CdiReaderPrivate::BlockRange*)&vbr;
-			break;
-		}
-	}
-
+	const CdiReaderPrivate::BlockRange *const blockRange = d->findBlockRange(blockIdx);
 	if (!blockRange) {
 		// Not found in any block range.
 		return 0;
@@ -586,7 +606,7 @@ int CdiReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 		// NOTE: May include subchannels, which are located after the 2352 bytes.
 		// TODO: Handle audio tracks properly?
 		CDROM_2352_Sector_t sector;
-		size_t sz_read = m_file->seekAndRead(phys_pos, &sector, sizeof(sector));
+		size_t sz_read = m_file->readAt(phys_pos, &sector, sizeof(sector));
 		m_lastError = m_file->lastError();
 		if (sz_read != sizeof(sector)) {
 			// Read error
@@ -600,7 +620,7 @@ int CdiReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 	} else if (blockRange->sectorSize == 2336) {
 		// Skip the first 8 bytes of the 2336-byte sector.
 		array<uint8_t, 2336> sector;
-		size_t sz_read = m_file->seekAndRead(phys_pos, sector.data(), sector.size());
+		size_t sz_read = m_file->readAt(phys_pos, sector.data(), sector.size());
 		if (sz_read != sector.size()) {
 			// Read error
 			return -1;
@@ -611,10 +631,87 @@ int CdiReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 	}
 
 	// 2048-byte sectors
-	size_t sz_read = m_file->seekAndRead(phys_pos, ptr, size);
+	size_t sz_read = m_file->readAt(phys_pos, ptr, size);
 	return (sz_read > 0 ? static_cast<int>(sz_read) : -1);
 }
 
+/**
+ * Read multiple full blocks.
+ *
+ * Each track's sectors are read with a single file read,
+ * and then the user data is copied to the output buffer.
+ *
+ * @param blockIdx	[in] First block index.
+ * @param count		[in] Number of blocks to read.
+ * @param ptr		[out] Output data buffer. (Must be at least count * block_size bytes!)
+ * @return Number of full blocks read. (Less than count on error.)
+ */
+unsigned int CdiReader::readBlocks(uint32_t blockIdx, unsigned int count, void *ptr)
+{
+	RP_D(CdiReader);
+	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
+	unsigned int ret = 0;
+
+	// Raw sector buffer
+	// NOTE: Allocated by the first track with raw sectors.
+	rp::uvector<uint8_t> rawBuf;
+
+	while (count > 0 && blockIdx < d->blockCount) {
+		// Find the block.
+		const CdiReaderPrivate::BlockRange *const blockRange = d->findBlockRange(blockIdx);
+		if (!blockRange) {
+			// Not found in any block range.
+			break;
+		}
+
+		// Don't read past the end of the track.
+		unsigned int n = std::min(count, blockRange->blockEnd - blockIdx + 1);
+		const unsigned int sectorSize = blockRange->sectorSize;
+		const off64_t phys_pos = blockRange->trackStart + (static_cast<off64_t>(blockIdx - blockRange->blockStart) * sectorSize);
+		unsigned int n_read;
+		if (sectorSize >= 2336) {
+			// 2336-byte or 2352-byte sectors
+			// NOTE: May include subchannels, which are located after the 2352 bytes.
+			// TODO: Handle audio tracks properly?
+			n = std::min(n, static_cast<unsigned int>(CdiReaderPrivate::RAW_SECTORS_MAX));
+			const size_t raw_size = static_cast<size_t>(n) * sectorSize;
+			if (rawBuf.size() < raw_size) {
+				rawBuf.resize(raw_size);
+			}
+			const size_t sz_read = m_file->readAt(phys_pos, rawBuf.data(), raw_size);
+			m_lastError = m_file->lastError();
+
+			n_read = static_cast<unsigned int>(sz_read / sectorSize);
+			const uint8_t *p_raw = rawBuf.data();
+			for (unsigned int i = 0; i < n_read; i++, p_raw += sectorSize, ptr8 += 2048) {
+				if (sectorSize == 2336) {
+					// Skip the first 8 bytes of the 2336-byte sector.
+					memcpy(ptr8, &p_raw[8], 2048);
+				} else {
+					// NOTE: Sector user data area position depends on the sector mode.
+					const CDROM_2352_Sector_t *const sector = reinterpret_cast<const CDROM_2352_Sector_t*>(p_raw);
+					memcpy(ptr8, cdromSectorDataPtr(sector), 2048);
+				}
+			}
+		} else {
+			// 2048-byte sectors
+			const size_t sz_read = m_file->readAt(phys_pos, ptr8, static_cast<size_t>(n) * 2048);
+			n_read = static_cast<unsigned int>(sz_read / 2048);
+			ptr8 += static_cast<size_t>(n_read) * 2048;
+		}
+
+		ret += n_read;
+		if (n_read != n) {
+			// Read error
+			break;
+		}
+		blockIdx += n;
+		count -= n;
+	}
+
+	return ret;
+}
+
 /** GDI-specific functions **/
 // TODO: "CdromReader" class?
 
@@ -10,6 +10,7 @@
 
 #include "MultiTrackSparseDiscReader.hpp"
 #include "IsoPartition.hpp"
+#include "dll-macros.h"	// for RP_LIBROMDATA_PUBLIC
 
 // for ISOPtr
 #include "../Media/ISO.hpp"
@@ -26,6 +27,7 @@ public:
 	 * unref()'d by the caller afterwards.
 	 * @param file File to read from.
 	 */
+	RP_LIBROMDATA_PUBLIC
 	explicit CdiReader(const LibRpFile::IRpFilePtr &file);
 
 private:
@@ -74,6 +76,19 @@ protected:
 	ATTR_ACCESS_SIZE(write_only, 4, 5)
 	int readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size) final;
 
+	/**
+	 * Read multiple full blocks.
+	 *
+	 * Each track's sectors are read with a single file read,
+	 * and then the user data is copied to the output buffer.
+	 *
+	 * @param blockIdx	[in] First block index.
+	 * @param count		[in] Number of blocks to read.
+	 * @param ptr		[out] Output data buffer. (Must be at least count * block_size bytes!)
+	 * @return Number of full blocks read. (Less than count on error.)
+	 */
+	unsigned int readBlocks(uint32_t blockIdx, unsigned int count, void *ptr) final;
+
 public:
 	/** MultiTrackSparseDiscReader functions **/
 
@@ -42,6 +42,9 @@ public:
 
 	// Number of 2352-byte blocks
 	unsigned int blockCount;
+
+	// Maximum number of raw sectors to read at once
+	static constexpr unsigned int RAW_SECTORS_MAX = 64;
 };
 
 /** Cdrom2352ReaderPrivate **/
@@ -190,7 +193,7 @@ int Cdrom2352Reader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t siz
 	// NOTE 2: No changes neeed for 2448-byte mode, since subchannels are
 	// stored *after* the 2352-byte sector data.
 	CDROM_2352_Sector_t sector;
-	size_t sz_read = m_file->seekAndRead(physBlockAddr, &sector, sizeof(sector));
+	size_t sz_read = m_file->readAt(physBlockAddr, &sector, sizeof(sector));
 	m_lastError = m_file->lastError();
 	if (sz_read != sizeof(sector)) {
 		// Read error.
@@ -203,4 +206,55 @@ int Cdrom2352Reader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t siz
 	return static_cast<int>(size);
 }
 
+/**
+ * Read multiple full blocks.
+ *
+ * Raw sectors are read with a single file read,
+ * and then the user data is copied to the output buffer.
+ *
+ * @param blockIdx	[in] First block index.
+ * @param count		[in] Number of blocks to read.
+ * @param ptr		[out] Output data buffer. (Must be at least count * block_size bytes!)
+ * @return Number of full blocks read. (Less than count on error.)
+ */
+unsigned int Cdrom2352Reader::readBlocks(uint32_t blockIdx, unsigned int count, void *ptr)
+{
+	RP_D(Cdrom2352Reader);
+	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
+	unsigned int ret = 0;
+
+	// Raw sector buffer
+	rp::uvector<uint8_t> rawBuf(static_cast<size_t>(
+		std::min(count, static_cast<unsigned int>(Cdrom2352ReaderPrivate::RAW_SECTORS_MAX))) * d->physBlockSize);
+
+	while (count > 0) {
+		const unsigned int n = std::min(count, static_cast<unsigned int>(Cdrom2352ReaderPrivate::RAW_SECTORS_MAX));
+
+		// Read the raw sectors.
+		// NOTE: Subchannels in 2448-byte mode are skipped, since they're
+		// stored *after* the 2352-byte sector data.
+		const off64_t physBlockAddr = static_cast<off64_t>(blockIdx) * d->physBlockSize;
+		const size_t sz_read = m_file->readAt(physBlockAddr, rawBuf.data(), static_cast<size_t>(n) * d->physBlockSize);
+		m_lastError = m_file->lastError();
+
+		// Copy the user data from each complete sector.
+		const unsigned int n_read = static_cast<unsigned int>(sz_read / d->physBlockSize);
+		const uint8_t *p_raw = rawBuf.data();
+		for (unsigned int i = 0; i < n_read; i++, p_raw += d->physBlockSize, ptr8 += 2048) {
+			const CDROM_2352_Sector_t *const sector = reinterpret_cast<const CDROM_2352_Sector_t*>(p_raw);
+			memcpy(ptr8, cdromSectorDataPtr(sector), 2048);
+		}
+
+		ret += n_read;
+		if (n_read != n) {
+			// Read error.
+			break;
+		}
+		blockIdx += n;
+		count -= n;
+	}
+
+	return ret;
+}
+
 } // namespace LibRomData
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "librpbase/disc/SparseDiscReader.hpp"
+#include "dll-macros.h"	// for RP_LIBROMDATA_PUBLIC
 
 namespace LibRomData {
 
@@ -37,6 +38,7 @@ public:
 	 * @param file File to read from
 	 * @param physBlockSize Sector size (2352, 2446)
 	 */
+	RP_LIBROMDATA_PUBLIC
 	explicit Cdrom2352Reader(const LibRpFile::IRpFilePtr &file, unsigned int physBlockSize);
 
 private:
@@ -92,6 +94,19 @@ protected:
 	 */
 	ATTR_ACCESS_SIZE(write_only, 4, 5)
 	int readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size) final;
+
+	/**
+	 * Read multiple full blocks.
+	 *
+	 * Raw sectors are read with a single file read,
+	 * and then the user data is copied to the output buffer.
+	 *
+	 * @param blockIdx	[in] First block index.
+	 * @param count		[in] Number of blocks to read.
+	 * @param ptr		[out] Output data buffer. (Must be at least count * block_size bytes!)
+	 * @return Number of full blocks read. (Less than count on error.)
+	 */
+	unsigned int readBlocks(uint32_t blockIdx, unsigned int count, void *ptr) final;
 };
 
 } // namespace LibRomData
@@ -0,0 +1,516 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata)                       *
+ * ChdFlac.cpp: FLAC frame decoder for CHD hunks.                          *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// References:
+// - https://xiph.org/flac/format.html
+// - https://github.com/mamedev/mame/blob/master/src/lib/util/flac.cpp
+
+#include "stdafx.h"
+#include "ChdFlac.hpp"
+
+// C++ STL classes
+#include "uvector.h"
+
+namespace LibRomData { namespace ChdFlac {
+
+namespace {
+
+/**
+ * Bitstream reader. (MSB first)
+ */
+class BitReader
+{
+	public:
+		BitReader(const uint8_t *p, size_t len)
+			: m_p(p)
+			, m_len(len)
+			, m_bytePos(0)
+			, m_bitPos(0)
+			, m_err(false)
+		{ }
+
+	public:
+		/**
+		 * Read up to 32 bits.
+		 * @param n Number of bits
+		 * @return Value
+		 */
+		uint32_t read(unsigned int n)
+		{
+			uint32_t v = 0;
+			while (n > 0) {
+				if (m_bytePos >= m_len) {
+					// End of the buffer.
+					m_err = true;
+					return 0;
+				}
+
+				const unsigned int avail = 8 - m_bitPos;
+				const unsigned int take = (n < avail) ? n : avail;
+				const unsigned int shift = avail - take;
+				v = (v << take) | ((m_p[m_bytePos] >> shift) & ((1U << take) - 1));
+				n -= take;
+				m_bitPos += take;
+				if (m_bitPos == 8) {
+					m_bitPos = 0;
+					m_bytePos++;
+				}
+			}
+			return v;
+		}
+
+		/**
+		 * Read a signed value of up to 32 bits.
+		 * @param n Number of bits
+		 * @return Sign-extended value
+		 */
+		int32_t readSigned(unsigned int n)
+		{
+			if (n == 0)
+				return 0;
+			const uint32_t v = read(n);
+			if (n >= 32)
+				return static_cast<int32_t>(v);
+			const unsigned int shift = 32 - n;
+			return static_cast<int32_t>(v << shift) >> shift;
+		}
+
+		/**
+		 * Read a unary-coded value. (number of 0 bits before a 1 bit)
+		 * @return Value
+		 */
+		uint32_t readUnary(void)
+		{
+			uint32_t v = 0;
+			while (m_bytePos < m_len) {
+				// Check the rest of the current byte.
+				const uint8_t b = static_cast<uint8_t>(m_p[m_bytePos] << m_bitPos);
+				if (b == 0) {
+					// No 1 bits left in this byte.
+					v += 8 - m_bitPos;
+					m_bitPos = 0;
+					m_bytePos++;
+					continue;
+				}
+
+				// Find the first 1 bit.
+				unsigned int zeros = 0;
+				for (uint8_t mask = 0x80; !(b & mask); mask >>= 1) {
+					zeros++;
+				}
+				v += zeros;
+				m_bitPos += zeros + 1;
+				if (m_bitPos >= 8) {
+					m_bitPos -= 8;
+					m_bytePos++;
+				}
+				return v;
+			}
+
+			// End of the buffer.
+			m_err = true;
+			return 0;
+		}
+
+		/**
+		 * Skip to the next byte boundary.
+		 */
+		inline void alignByte(void)
+		{
+			if (m_bitPos != 0) {
+				m_bitPos = 0;
+				m_bytePos++;
+			}
+		}
+
+		inline size_t bytePos(void) const { return m_bytePos; }
+		inline bool hasError(void) const { return m_err; }
+
+	private:
+		const uint8_t *const m_p;
+		const size_t m_len;
+		size_t m_bytePos;
+		unsigned int m_bitPos;
+		bool m_err;
+};
+
+/**
+ * Decode a residual.
+ * @param br		[in] BitReader
+ * @param out		[out] Output samples (starting after the warmup samples)
+ * @param blockSize	[in] Block size
+ * @param predOrder	[in] Predictor order
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int decodeResidual(BitReader &br, int32_t *out, unsigned int blockSize, unsigned int predOrder)
+{
+	const unsigned int method = br.read(2);
+	if (method > 1) {
+		// Reserved coding method.
+		return -EIO;
+	}
+	const unsigned int paramBits = (method == 0) ? 4 : 5;
+	const unsigned int escape = (method == 0) ? 15 : 31;
+
+	const unsigned int partOrder = br.read(4);
+	const unsigned int partSamples = blockSize >> partOrder;
+	if ((partSamples << partOrder) != blockSize || partSamples < predOrder) {
+		// Invalid partition order.
+		return -EIO;
+	}
+
+	const unsigned int partCount = 1U << partOrder;
+	for (unsigned int p = 0; p < partCount; p++) {
+		const unsigned int n = (p == 0) ? (partSamples - predOrder) : partSamples;
+		const unsigned int param = br.read(paramBits);
+		if (param == escape) {
+			// Unencoded binary.
+			const unsigned int rawBits = br.read(5);
+			for (unsigned int i = 0; i < n; i++) {
+				*out++ = br.readSigned(rawBits);
+			}
+		} else {
+			// Rice coding.
+			for (unsigned int i = 0; i < n; i++) {
+				// NOTE: The quotient and remainder have to be read in
+				// separate statements, since the evaluation order of
+				// the operands of '|' is unspecified.
+				const uint32_t q = br.readUnary();
+				const uint32_t u = (q << param) | br.read(param);
+				*out++ = static_cast<int32_t>(u >> 1) ^ -static_cast<int32_t>(u & 1);
+			}
+		}
+		if (br.hasError()) {
+			return -EIO;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Decode a subframe.
+ * @param br		[in] BitReader
+ * @param out		[out] Output samples
+ * @param blockSize	[in] Block size
+ * @param bps		[in] Bits per sample
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int decodeSubframe(BitReader &br, int32_t *out, unsigned int blockSize, unsigned int bps)
+{
+	if (br.read(1) != 0) {
+		// Padding bit must be 0.
+		return -EIO;
+	}
+	const unsigned int type = br.read(6);
+
+	// Wasted bits-per-sample
+	unsigned int wasted = 0;
+	if (br.read(1)) {
+		wasted = br.readUnary() + 1;
+		if (wasted >= bps) {
+			return -EIO;
+		}
+		bps -= wasted;
+	}
+
+	int ret = 0;
+	if (type == 0) {
+		// CONSTANT
+		const int32_t v = br.readSigned(bps);
+		for (unsigned int i = 0; i < blockSize; i++) {
+			out[i] = v;
+		}
+	} else if (type == 1) {
+		// VERBATIM
+		for (unsigned int i = 0; i < blockSize; i++) {
+			out[i] = br.readSigned(bps);
+		}
+	} else if (type >= 8 && type <= 12) {
+		// FIXED
+		const unsigned int order = type - 8;
+		if (order > blockSize) {
+			return -EIO;
+		}
+		for (unsigned int i = 0; i < order; i++) {
+			out[i] = br.readSigned(bps);
+		}
+		ret = decodeResidual(br, &out[order], blockSize, order);
+		if (ret != 0) {
+			return ret;
+		}
+
+		switch (order) {
+			default:
+			case 0:
+				break;
+			case 1:
+				for (unsigned int i = 1; i < blockSize; i++) {
+					out[i] += out[i-1];
+				}
+				break;
+			case 2:
+				for (unsigned int i = 2; i < blockSize; i++) {
+					out[i] += 2*out[i-1] - out[i-2];
+				}
+				break;
+			case 3:
+				for (unsigned int i = 3; i < blockSize; i++) {
+					out[i] += 3*out[i-1] - 3*out[i-2] + out[i-3];
+				}
+				break;
+			case 4:
+				for (unsigned int i = 4; i < blockSize; i++) {
+					out[i] += 4*out[i-1] - 6*out[i-2] + 4*out[i-3] - out[i-4];
+				}
+				break;
+		}
+	} else if (type >= 32) {
+		// LPC
+		const unsigned int order = (type & 31) + 1;
+		if (order > blockSize) {
+			return -EIO;
+		}
+		for (unsigned int i = 0; i < order; i++) {
+			out[i] = br.readSigned(bps);
+		}
+
+		const unsigned int precision = br.read(4) + 1;
+		if (precision == 16) {
+			// Invalid precision.
+			return -EIO;
+		}
+		const int shift = br.readSigned(5);
+		if (shift < 0) {
+			// Negative shifts aren't supported.
+			return -EIO;
+		}
+		int32_t coefs[32];
+		for (unsigned int i = 0; i < order; i++) {
+			coefs[i] = br.readSigned(precision);
+		}
+
+		ret = decodeResidual(br, &out[order], blockSize, order);
+		if (ret != 0) {
+			return ret;
+		}
+
+		for (unsigned int i = order; i < blockSize; i++) {
+			int64_t sum = 0;
+			for (unsigned int j = 0; j < order; j++) {
+				sum += static_cast<int64_t>(coefs[j]) * out[i-1-j];
+			}
+			out[i] += static_cast<int32_t>(sum >> shift);
+		}
+	} else {
+		// Reserved subframe type.
+		return -EIO;
+	}
+
+	if (br.hasError()) {
+		return -EIO;
+	}
+
+	if (wasted > 0) {
+		for (unsigned int i = 0; i < blockSize; i++) {
+			out[i] <<= wasted;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Decode a frame.
+ * @param br		[in] BitReader
+ * @param ch0		[out] Channel 0 samples
+ * @param ch1		[out] Channel 1 samples
+ * @param pBlockSize	[out] Block size
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int decodeFrame(BitReader &br, rp::uvector<int32_t> &ch0, rp::uvector<int32_t> &ch1, unsigned int *pBlockSize)
+{
+	// Frame header
+	if (br.read(14) != 0x3FFE || br.read(1) != 0) {
+		// Invalid sync code.
+		return -EIO;
+	}
+	br.read(1);	// blocking strategy
+	const unsigned int bsCode = br.read(4);
+	const unsigned int srCode = br.read(4);
+	const unsigned int chAssign = br.read(4);
+	const unsigned int ssCode = br.read(3);
+	br.read(1);	// reserved
+
+	// Frame or sample number (UTF-8 coded)
+	const uint8_t first = static_cast<uint8_t>(br.read(8));
+	if (first & 0x80) {
+		unsigned int extra = 0;
+		for (uint8_t mask = 0x40; (first & mask) && mask != 0; mask >>= 1) {
+			extra++;
+		}
+		if (extra == 0 || extra > 6) {
+			return -EIO;
+		}
+		for (; extra > 0; extra--) {
+			if ((br.read(8) & 0xC0) != 0x80) {
+				return -EIO;
+			}
+		}
+	}
+
+	unsigned int blockSize;
+	switch (bsCode) {
+		case 0:
+			// Reserved
+			return -EIO;
+		case 1:
+			blockSize = 192;
+			break;
+		case 2: case 3: case 4: case 5:
+			blockSize = 576U << (bsCode - 2);
+			break;
+		case 6:
+			blockSize = br.read(8) + 1;
+			break;
+		case 7:
+			blockSize = br.read(16) + 1;
+			break;
+		default:
+			blockSize = 256U << (bsCode - 8);
+			break;
+	}
+
+	if (srCode == 12) {
+		br.read(8);
+	} else if (srCode == 13 || srCode == 14) {
+		br.read(16);
+	} else if (srCode == 15) {
+		return -EIO;
+	}
+
+	// CHD only uses 16-bit samples.
+	// Sample size 0 means "same as STREAMINFO", which is 16-bit.
+	if (ssCode != 0 && ssCode != 4) {
+		return -ENOTSUP;
+	}
+	static constexpr unsigned int bps = 16;
+
+	// CHD only uses stereo.
+	if (chAssign != 1 && (chAssign < 8 || chAssign > 10)) {
+		return -ENOTSUP;
+	}
+
+	br.read(8);	// CRC-8
+	if (br.hasError()) {
+		return -EIO;
+	}
+
+	// Subframes
+	// The side channel has one extra bit.
+	ch0.resize(blockSize);
+	ch1.resize(blockSize);
+	int ret = decodeSubframe(br, ch0.data(), blockSize, bps + (chAssign == 9 ? 1 : 0));
+	if (ret != 0) {
+		return ret;
+	}
+	ret = decodeSubframe(br, ch1.data(), blockSize, bps + ((chAssign == 8 || chAssign == 10) ? 1 : 0));
+	if (ret != 0) {
+		return ret;
+	}
+
+	// Frame footer: Zero padding and CRC-16
+	br.alignByte();
+	br.read(16);
+	if (br.hasError()) {
+		return -EIO;
+	}
+
+	// Stereo decorrelation
+	int32_t *const p0 = ch0.data();
+	int32_t *const p1 = ch1.data();
+	switch (chAssign) {
+		default:
+			break;
+		case 8:
+			// Left/side
+			for (unsigned int i = 0; i < blockSize; i++) {
+				p1[i] = p0[i] - p1[i];
+			}
+			break;
+		case 9:
+			// Side/right
+			for (unsigned int i = 0; i < blockSize; i++) {
+				p0[i] += p1[i];
+			}
+			break;
+		case 10:
+			// Mid/side
+			for (unsigned int i = 0; i < blockSize; i++) {
+				const int32_t side = p1[i];
+				const int32_t mid = static_cast<int32_t>(static_cast<uint32_t>(p0[i]) << 1) | (side & 1);
+				p0[i] = (mid + side) >> 1;
+				p1[i] = (mid - side) >> 1;
+			}
+			break;
+	}
+
+	*pBlockSize = blockSize;
+	return 0;
+}
+
+}
+
+/**
+ * Decode FLAC frames into interleaved 16-bit stereo PCM.
+ *
+ * CHD stores raw FLAC frames without the "fLaC" stream header,
+ * so only frames with 2 channels and 16-bit samples are supported.
+ * Frames that don't specify the sample size use 16-bit.
+ *
+ * @param src		[in] FLAC frame data
+ * @param src_len	[in] Size of src, in bytes
+ * @param dest		[out] Output buffer (must be at least samples * 4 bytes)
+ * @param samples	[in] Number of samples per channel to decode
+ * @param bigEndian	[in] If true, write big-endian samples; otherwise, little-endian.
+ * @return Number of bytes of src used by the decoded frames, or negative POSIX error code on error.
+ */
+int decodeInterleaved(const uint8_t *src, size_t src_len, uint8_t *dest, unsigned int samples, bool bigEndian)
+{
+	BitReader br(src, src_len);
+	rp::uvector<int32_t> ch0, ch1;
+
+	while (samples > 0) {
+		unsigned int blockSize = 0;
+		const int ret = decodeFrame(br, ch0, ch1, &blockSize);
+		if (ret != 0) {
+			return ret;
+		}
+
+		const unsigned int count = (blockSize < samples) ? blockSize : samples;
+		for (unsigned int i = 0; i < count; i++) {
+			const uint16_t l = static_cast<uint16_t>(ch0[i]);
+			const uint16_t r = static_cast<uint16_t>(ch1[i]);
+			if (bigEndian) {
+				dest[0] = l >> 8;
+				dest[1] = l & 0xFF;
+				dest[2] = r >> 8;
+				dest[3] = r & 0xFF;
+			} else {
+				dest[0] = l & 0xFF;
+				dest[1] = l >> 8;
+				dest[2] = r & 0xFF;
+				dest[3] = r >> 8;
+			}
+			dest += 4;
+		}
+		samples -= count;
+	}
+
+	return static_cast<int>(br.bytePos());
+}
+
+} }
@@ -0,0 +1,34 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata)                       *
+ * ChdFlac.hpp: FLAC frame decoder for CHD hunks.                          *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+
+namespace LibRomData { namespace ChdFlac {
+
+/**
+ * Decode FLAC frames into interleaved 16-bit stereo PCM.
+ *
+ * CHD stores raw FLAC frames without the "fLaC" stream header,
+ * so only frames with 2 channels and 16-bit samples are supported.
+ * Frames that don't specify the sample size use 16-bit.
+ *
+ * @param src		[in] FLAC frame data
+ * @param src_len	[in] Size of src, in bytes
+ * @param dest		[out] Output buffer (must be at least samples * 4 bytes)
+ * @param samples	[in] Number of samples per channel to decode
+ * @param bigEndian	[in] If true, write big-endian samples; otherwise, little-endian.
+ * @return Number of bytes of src used by the decoded frames, or negative POSIX error code on error.
+ */
+ATTR_ACCESS_SIZE(read_only, 1, 2)
+int decodeInterleaved(const uint8_t *src, size_t src_len, uint8_t *dest, unsigned int samples, bool bigEndian);
+
+} }
@@ -0,0 +1,1695 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata)                       *
+ * ChdReader.cpp: MAME Compressed Hunks of Data (CHD) disc image reader.   *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// References:
+// - https://github.com/mamedev/mame/blob/master/src/lib/util/chd.cpp
+// - https://github.com/mamedev/mame/blob/master/src/lib/util/chdcodec.cpp
+// - https://github.com/mamedev/mame/blob/master/src/lib/util/cdrom.cpp
+// - https://github.com/mamedev/mame/blob/master/src/lib/util/huffman.cpp
+
+#include "stdafx.h"
+#include "config.libromdata.h"
+
+#include "ChdReader.hpp"
+#include "librpbase/disc/SparseDiscReader_p.hpp"
+#include "chd_structs.h"
+#include "ChdFlac.hpp"
+
+#include "../cdrom_structs.h"
+#include "IsoPartition.hpp"
+
+// zlib
+#include <zlib.h>
+
+// zstd
+#ifdef HAVE_ZSTD
+#  include <zstd.h>
+#endif /* HAVE_ZSTD */
+
+// liblzma
+#ifdef HAVE_LZMA
+#  include <lzma.h>
+#endif /* HAVE_LZMA */
+
+// librpthreads
+#include "librpthreads/Mutex.hpp"
+using LibRpThreads::Mutex;
+using LibRpThreads::MutexLocker;
+
+// Other rom-properties libraries
+using namespace LibRpBase;
+using namespace LibRpFile;
+
+// Other RomData subclasses
+#include "Media/ISO.hpp"
+
+// C++ STL classes
+using std::vector;
+
+namespace LibRomData {
+
+class ChdReaderPrivate final : public SparseDiscReaderPrivate
+{
+public:
+	explicit ChdReaderPrivate(ChdReader *q);
+
+private:
+	typedef SparseDiscReaderPrivate super;
+	RP_DISABLE_COPY(ChdReaderPrivate)
+
+public:
+	// CHD header (byteswapped to host-endian)
+	ChdHeaderV5 chdHeader;
+
+	// Hunk map
+	struct MapEntry {
+		uint64_t offset;	// File offset, or hunk index for CHD_COMPRESSION_SELF
+		uint32_t length;	// Compressed length
+		uint16_t crc16;		// CRC-16 of the decompressed hunk
+		uint8_t compression;	// Compression type (see CHD_Compression_e)
+		uint8_t reserved;
+	};
+	vector<MapEntry> hunkMap;
+	unsigned int hunkCount;
+	bool hasHunkCrc;	// Only the compressed map has CRC-16s
+
+	// Maximum number of hunks. (8M hunks == 128 MB map)
+	static constexpr unsigned int MAX_HUNK_COUNT = 8U * 1024U * 1024U;
+
+	// CD-ROM tracks
+	// NOTE: Audio tracks are included so track numbers can
+	// be used as indexes, but they can't be read.
+	enum class TrackType : uint8_t {
+		Audio,		// Audio track
+		Cooked,		// 2048-byte user data at the start of the frame (MODE1, MODE2_FORM1)
+		Mode2,		// 2336-byte sectors (MODE2, MODE2_FORM_MIX)
+		Raw,		// 2352-byte sectors (MODE1_RAW, MODE2_RAW)
+		Unsupported,	// MODE2_FORM2
+	};
+	struct TrackInfo {
+		unsigned int lbaStart;		// Starting LBA (index 01)
+		unsigned int lbaCount;		// Length, in LBAs
+		unsigned int chdFrameStart;	// CHD frame index of lbaStart
+		uint8_t trackNumber;		// Track number (1-based)
+		TrackType type;
+	};
+	vector<TrackInfo> tracks;
+	unsigned int framesPerHunk;	// CD-ROM only
+	bool isCdrom;
+	bool isGdrom;
+
+	// Hunk cache
+	// CD-ROM sectors are much smaller than hunks, and a hunk
+	// may contain sectors from more than one track, so hunks
+	// are cached here instead of by SparseDiscReader.
+	static constexpr unsigned int HUNK_CACHE_SIZE = 1024U * 1024U;
+	struct CachedHunk {
+		uint32_t hunkIdx;	// Hunk index (~0U if empty)
+		uint64_t lastUsed;	// LRU counter value at last use
+		rp::uvector<uint8_t> data;
+	};
+	vector<CachedHunk> hunkCache;
+	unsigned int maxCachedHunks;
+	uint64_t hunkLruCounter;
+	Mutex hunkCacheMutex;
+
+public:
+	/**
+	 * Load the hunk map.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int loadMap(void);
+
+	/**
+	 * Load the uncompressed hunk map.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int loadUncompressedMap(void);
+
+	/**
+	 * Load the compressed hunk map.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int loadCompressedMap(void);
+
+	/**
+	 * Load the metadata and determine the CD-ROM track layout.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int loadMetadata(void);
+
+	/**
+	 * Read and decompress a hunk.
+	 * This can be called concurrently.
+	 * @param hunkIdx	[in] Hunk index
+	 * @param dest		[out] Output buffer (must be hunk_bytes)
+	 * @param depth		[in] Self-reference depth
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int readHunk(uint32_t hunkIdx, uint8_t *dest, int depth = 0);
+
+	/**
+	 * Get a hunk from the hunk cache, reading it if necessary.
+	 * NOTE: hunkCacheMutex must be locked by the caller.
+	 * @param hunkIdx	[in] Hunk index
+	 * @param pErr		[out] Error code on error
+	 * @return Hunk data, or nullptr on error.
+	 */
+	const uint8_t *getCachedHunk(uint32_t hunkIdx, int *pErr);
+
+	/**
+	 * Find the data track containing an LBA.
+	 * @param lba LBA
+	 * @return Track, or nullptr if the LBA isn't in a data track.
+	 */
+	const TrackInfo *findDataTrack(unsigned int lba) const;
+
+	/**
+	 * Get a track by track number.
+	 * @param trackNumber Track number (1-based)
+	 * @return Track, or nullptr if not found.
+	 */
+	const TrackInfo *getTrack(int trackNumber) const;
+
+public:
+	/** Codecs **/
+
+	/**
+	 * Decompress data using a CHD codec.
+	 * @param codec		[in] Codec (see CHD_Codec_e)
+	 * @param src		[in] Compressed data
+	 * @param src_len	[in] Size of src
+	 * @param dest		[out] Output buffer
+	 * @param dest_len	[in] Expected decompressed size
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	static int decompress(uint32_t codec, const uint8_t *src, size_t src_len, uint8_t *dest, size_t dest_len);
+
+	/**
+	 * Decompress a CD-ROM hunk. (cdzl, cdlz, cdzs)
+	 * @param baseCodec	[in] Codec for the sector data
+	 * @param subCodec	[in] Codec for the subcode data
+	 * @param src		[in] Compressed data
+	 * @param src_len	[in] Size of src
+	 * @param dest		[out] Output buffer
+	 * @param dest_len	[in] Expected decompressed size
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	static int decompressCd(uint32_t baseCodec, uint32_t subCodec,
+		const uint8_t *src, size_t src_len, uint8_t *dest, size_t dest_len);
+
+	/**
+	 * Decompress a CD-ROM hunk using FLAC. (cdfl)
+	 * @param src		[in] Compressed data
+	 * @param src_len	[in] Size of src
+	 * @param dest		[out] Output buffer
+	 * @param dest_len	[in] Expected decompressed size
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	static int decompressCdFlac(const uint8_t *src, size_t src_len, uint8_t *dest, size_t dest_len);
+
+	/**
+	 * Calculate the CRC-16 (CCITT) of a buffer.
+	 * @param crc	[in] Previous CRC-16 (0xFFFF for the first block)
+	 * @param buf	[in] Buffer
+	 * @param size	[in] Size of buf
+	 * @return CRC-16
+	 */
+	static uint16_t crc16(uint16_t crc, const uint8_t *buf, size_t size);
+
+	/**
+	 * Regenerate the P and Q parity bytes of a CD-ROM sector.
+	 * Based on cdrom_file::ecc_generate() in MAME.
+	 * @param sector [in/out] 2352-byte sector
+	 */
+	static void ecc_generate(uint8_t *sector);
+};
+
+/** Internal helper classes **/
+
+namespace {
+
+/**
+ * Bitstream reader for the compressed hunk map. (MSB first)
+ * Reading past the end returns zeroes; check overflow() afterwards.
+ */
+class MapBitReader
+{
+	public:
+		MapBitReader(const uint8_t *p, size_t len)
+			: m_p(p)
+			, m_len(len)
+			, m_offset(0)
+			, m_buffer(0)
+			, m_bits(0)
+		{ }
+
+	public:
+		/**
+		 * Peek at up to 24 bits.
+		 * @param n Number of bits
+		 * @return Value
+		 */
+		uint32_t peek(unsigned int n)
+		{
+			assert(n <= 24);
+			if (n == 0)
+				return 0;
+			if (n > m_bits) {
+				while (m_bits <= 24) {
+					if (m_offset < m_len) {
+						m_buffer |= static_cast<uint32_t>(m_p[m_offset]) << (24 - m_bits);
+					}
+					m_offset++;
+					m_bits += 8;
+				}
+			}
+			return m_buffer >> (32 - n);
+		}
+
+		/**
+		 * Remove bits that were peeked at.
+		 * @param n Number of bits (up to 24)
+		 */
+		inline void remove(unsigned int n)
+		{
+			m_buffer <<= n;
+			m_bits -= n;
+		}
+
+		/**
+		 * Read up to 64 bits.
+		 * @param n Number of bits
+		 * @return Value
+		 */
+		uint64_t read(unsigned int n)
+		{
+			uint64_t v = 0;
+			while (n > 0) {
+				const unsigned int k = (n > 24) ? 24 : n;
+				v = (v << k) | peek(k);
+				remove(k);
+				n -= k;
+			}
+			return v;
+		}
+
+		/**
+		 * Did we read past the end of the buffer?
+		 * @return True if we did.
+		 */
+		inline bool overflow(void) const
+		{
+			return (m_offset - m_bits / 8) > m_len;
+		}
+
+	private:
+		const uint8_t *const m_p;
+		const size_t m_len;
+		size_t m_offset;
+		uint32_t m_buffer;
+		unsigned int m_bits;
+};
+
+/**
+ * Huffman decoder for the compressed hunk map.
+ * The map uses 16 codes with a maximum code length of 8 bits.
+ */
+class MapHuffmanDecoder
+{
+	public:
+		MapHuffmanDecoder() = default;
+
+	private:
+		static constexpr unsigned int NUM_CODES = 16;
+		static constexpr unsigned int MAX_BITS = 8;
+
+	public:
+		/**
+		 * Import an RLE-encoded Huffman tree.
+		 * @param br MapBitReader
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int importTreeRle(MapBitReader &br)
+		{
+			// Code lengths are 4 bits for MAX_BITS == 8.
+			uint8_t numbits[NUM_CODES];
+			unsigned int cur = 0;
+			while (cur < NUM_CODES) {
+				unsigned int nb = static_cast<unsigned int>(br.read(4));
+				if (nb != 1) {
+					numbits[cur++] = nb;
+					continue;
+				}
+
+				nb = static_cast<unsigned int>(br.read(4));
+				if (nb == 1) {
+					// Literal 1.
+					numbits[cur++] = nb;
+				} else {
+					// Repeated code length.
+					unsigned int repcount = static_cast<unsigned int>(br.read(4)) + 3;
+					if (repcount + cur > NUM_CODES) {
+						return -EIO;
+					}
+					for (; repcount > 0; repcount--) {
+						numbits[cur++] = nb;
+					}
+				}
+			}
+
+			// Assign canonical codes.
+			uint32_t bithisto[MAX_BITS+1] = { };
+			for (unsigned int i = 0; i < NUM_CODES; i++) {
+				if (numbits[i] > MAX_BITS) {
+					return -EIO;
+				}
+				bithisto[numbits[i]]++;
+			}
+			uint32_t curstart = 0;
+			for (unsigned int codelen = MAX_BITS; codelen > 0; codelen--) {
+				const uint32_t nextstart = (curstart + bithisto[codelen]) >> 1;
+				if (codelen != 1 && nextstart * 2 != (curstart + bithisto[codelen])) {
+					return -EIO;
+				}
+				bithisto[codelen] = curstart;
+				curstart = nextstart;
+			}
+
+			// Build the lookup table.
+			// Each entry is (symbol << 5) | code length.
+			memset(m_lookup, 0, sizeof(m_lookup));
+			for (unsigned int i = 0; i < NUM_CODES; i++) {
+				if (numbits[i] == 0)
+					continue;
+
+				const uint32_t code = bithisto[numbits[i]]++;
+				const unsigned int shift = MAX_BITS - numbits[i];
+				const unsigned int start = code << shift;
+				const unsigned int count = 1U << shift;
+				if (start + count > ARRAY_SIZE(m_lookup)) {
+					return -EIO;
+				}
+				const uint16_t value = static_cast<uint16_t>((i << 5) | numbits[i]);
+				for (unsigned int j = 0; j < count; j++) {
+					m_lookup[start + j] = value;
+				}
+			}
+
+			return (br.overflow() ? -EIO : 0);
+		}
+
+		/**
+		 * Decode a single symbol.
+		 * @param br MapBitReader
+		 * @return Symbol
+		 */
+		inline unsigned int decodeOne(MapBitReader &br)
+		{
+			const uint16_t lookup = m_lookup[br.peek(MAX_BITS)];
+			br.remove(lookup & 0x1F);
+			return lookup >> 5;
+		}
+
+	private:
+		uint16_t m_lookup[1U << MAX_BITS];
+};
+
+/**
+ * Read a 48-bit big-endian value.
+ * @param p Data
+ * @return Value
+ */
+static inline uint64_t read_be48(const uint8_t *p)
+{
+	return (static_cast<uint64_t>(p[0]) << 40) |
+	       (static_cast<uint64_t>(p[1]) << 32) |
+	       (static_cast<uint64_t>(p[2]) << 24) |
+	       (static_cast<uint64_t>(p[3]) << 16) |
+	       (static_cast<uint64_t>(p[4]) <<  8) |
+	        static_cast<uint64_t>(p[5]);
+}
+
+}
+
+/** ChdReaderPrivate **/
+
+ChdReaderPrivate::ChdReaderPrivate(ChdReader *q)
+	: super(q)
+	, hunkCount(0)
+	, hasHunkCrc(false)
+	, framesPerHunk(0)
+	, isCdrom(false)
+	, isGdrom(false)
+	, maxCachedHunks(0)
+	, hunkLruCounter(0)
+{
+	// Clear the CHD header struct.
+	memset(&chdHeader, 0, sizeof(chdHeader));
+}
+
+/**
+ * Calculate the CRC-16 (CCITT) of a buffer.
+ * @param crc	[in] Previous CRC-16 (0xFFFF for the first block)
+ * @param buf	[in] Buffer
+ * @param size	[in] Size of buf
+ * @return CRC-16
+ */
+uint16_t ChdReaderPrivate::crc16(uint16_t crc, const uint8_t *buf, size_t size)
+{
+	// CRC-16 table (polynomial 0x1021)
+	static const struct Crc16Table {
+		uint16_t t[256];
+		Crc16Table() {
+			for (unsigned int i = 0; i < 256; i++) {
+				uint16_t v = static_cast<uint16_t>(i << 8);
+				for (unsigned int j = 0; j < 8; j++) {
+					v = (v & 0x8000) ? static_cast<uint16_t>((v << 1) ^ 0x1021) : static_cast<uint16_t>(v << 1);
+				}
+				t[i] = v;
+			}
+		}
+	} crcTable;
+
+	for (; size > 0; size--, buf++) {
+		crc = static_cast<uint16_t>((crc << 8) ^ crcTable.t[(crc >> 8) ^ *buf]);
+	}
+	return crc;
+}
+
+/**
+ * Regenerate the P and Q parity bytes of a CD-ROM sector.
+ * Based on cdrom_file::ecc_generate() in MAME.
+ * @param sector [in/out] 2352-byte sector
+ */
+void ChdReaderPrivate::ecc_generate(uint8_t *sector)
+{
+	// The parity bytes cover the sector header and everything after it.
+	// - P: 86 rows of 24 components (0x00C-0x81B), stored at 0x81C.
+	// - Q: 52 rows of 43 components (0x00C-0x8C7), stored at 0x8C8.
+	static constexpr unsigned int ECC_DATA_OFFSET = 0x00C;
+	static constexpr unsigned int ECC_P_OFFSET = 0x81C;
+	static constexpr unsigned int ECC_P_NUM_BYTES = 86;
+	static constexpr unsigned int ECC_P_COMP = 24;
+	static constexpr unsigned int ECC_Q_OFFSET = ECC_P_OFFSET + (2 * ECC_P_NUM_BYTES);
+	static constexpr unsigned int ECC_Q_NUM_BYTES = 52;
+	static constexpr unsigned int ECC_Q_COMP = 43;
+	static constexpr unsigned int MODE_OFFSET = 0x00F;
+
+	// GF(2^8) tables and row offsets.
+	// MAME has these as precalculated tables.
+	static const struct EccTables {
+		uint8_t ecclow[256];
+		uint8_t ecchigh[256];
+		uint16_t poffsets[ECC_P_NUM_BYTES][ECC_P_COMP];
+		uint16_t qoffsets[ECC_Q_NUM_BYTES][ECC_Q_COMP];
+		EccTables() {
+			for (unsigned int i = 0; i < 256; i++) {
+				const unsigned int j = (i << 1) ^ ((i & 0x80) ? 0x11D : 0);
+				ecclow[i] = static_cast<uint8_t>(j);
+				ecchigh[i ^ static_cast<uint8_t>(j)] = static_cast<uint8_t>(i);
+			}
+			for (unsigned int byte = 0; byte < ECC_P_NUM_BYTES; byte++) {
+				for (unsigned int comp = 0; comp < ECC_P_COMP; comp++) {
+					poffsets[byte][comp] = static_cast<uint16_t>(byte + (comp * ECC_P_NUM_BYTES));
+				}
+			}
+			for (unsigned int byte = 0; byte < ECC_Q_NUM_BYTES; byte++) {
+				for (unsigned int comp = 0; comp < ECC_Q_COMP; comp++) {
+					// Q rows are diagonals over 16-bit words, wrapping at 1,118 words.
+					const unsigned int word = ((byte / 2) * ECC_Q_COMP + comp * (ECC_Q_COMP + 1)) %
+						((ECC_Q_OFFSET - ECC_DATA_OFFSET) / 2);
+					qoffsets[byte][comp] = static_cast<uint16_t>((word * 2) + (byte & 1));
+				}
+			}
+		}
+	} eccTables;
+
+	// Mode 2 sectors don't include the header in the parity calculation.
+	const bool isMode2 = (sector[MODE_OFFSET] == 2);
+	auto ecc_compute_bytes = [sector, isMode2](const uint16_t *row, unsigned int rowlen, uint8_t &val1, uint8_t &val2) {
+		val1 = val2 = 0;
+		for (unsigned int component = 0; component < rowlen; component++) {
+			const unsigned int offset = row[component];
+			const uint8_t b = (isMode2 && offset < 4) ? 0 : sector[ECC_DATA_OFFSET + offset];
+			val1 ^= b;
+			val2 ^= b;
+			val1 = eccTables.ecclow[val1];
+		}
+		val1 = eccTables.ecchigh[eccTables.ecclow[val1] ^ val2];
+		val2 ^= val1;
+	};
+
+	// P parity must be generated first, since Q parity covers it.
+	for (unsigned int byte = 0; byte < ECC_P_NUM_BYTES; byte++) {
+		ecc_compute_bytes(eccTables.poffsets[byte], ECC_P_COMP,
+			sector[ECC_P_OFFSET + byte], sector[ECC_P_OFFSET + ECC_P_NUM_BYTES + byte]);
+	}
+	for (unsigned int byte = 0; byte < ECC_Q_NUM_BYTES; byte++) {
+		ecc_compute_bytes(eccTables.qoffsets[byte], ECC_Q_COMP,
+			sector[ECC_Q_OFFSET + byte], sector[ECC_Q_OFFSET + ECC_Q_NUM_BYTES + byte]);
+	}
+}
+
+/**
+ * Load the hunk map.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ChdReaderPrivate::loadMap(void)
+{
+	// If there's no compressor, the map is uncompressed.
+	return (chdHeader.compressors[0] == CHD_CODEC_NONE)
+		? loadUncompressedMap()
+		: loadCompressedMap();
+}
+
+/**
+ * Load the uncompressed hunk map.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ChdReaderPrivate::loadUncompressedMap(void)
+{
+	// Each entry is a 32-bit big-endian hunk index.
+	// 0 indicates a hunk that isn't present. (all zeroes)
+	rp::uvector<uint32_t> rawMap(hunkCount);
+	const size_t sz = static_cast<size_t>(hunkCount) * sizeof(uint32_t);
+	if (readFileAt(static_cast<off64_t>(chdHeader.map_offset), rawMap.data(), sz) != sz) {
+		return -EIO;
+	}
+
+	hunkMap.resize(hunkCount);
+	for (unsigned int i = 0; i < hunkCount; i++) {
+		MapEntry &entry = hunkMap[i];
+		entry.offset = static_cast<uint64_t>(be32_to_cpu(rawMap[i])) * chdHeader.hunk_bytes;
+		entry.length = chdHeader.hunk_bytes;
+		entry.crc16 = 0;
+		entry.compression = CHD_COMPRESSION_NONE;
+		entry.reserved = 0;
+	}
+	hasHunkCrc = false;
+	return 0;
+}
+
+/**
+ * Load the compressed hunk map.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ChdReaderPrivate::loadCompressedMap(void)
+{
+	ChdMapHeaderV5 mapHeader;
+	if (readFileAt(static_cast<off64_t>(chdHeader.map_offset), &mapHeader, sizeof(mapHeader)) != sizeof(mapHeader)) {
+		return -EIO;
+	}
+
+	const uint32_t mapLength = be32_to_cpu(mapHeader.length);
+	const uint16_t mapCrc = be16_to_cpu(mapHeader.crc16);
+	const unsigned int lengthBits = mapHeader.length_bits;
+	const unsigned int selfBits = mapHeader.self_bits;
+	const unsigned int parentBits = mapHeader.parent_bits;
+	uint64_t curOffset = read_be48(mapHeader.data_start);
+
+	// Each map entry uses at most ~12 bytes.
+	if (mapLength == 0 || mapLength > (static_cast<uint64_t>(hunkCount) * 12) + 4096 ||
+	    lengthBits > 32 || selfBits > 32 || parentBits > 48)
+	{
+		return -EIO;
+	}
+
+	rp::uvector<uint8_t> compMap(mapLength);
+	if (readFileAt(static_cast<off64_t>(chdHeader.map_offset + sizeof(mapHeader)), compMap.data(), mapLength) != mapLength) {
+		return -EIO;
+	}
+
+	// Decode the compression types.
+	MapBitReader br(compMap.data(), mapLength);
+	MapHuffmanDecoder decoder;
+	int ret = decoder.importTreeRle(br);
+	if (ret != 0) {
+		return ret;
+	}
+
+	hunkMap.resize(hunkCount);
+	uint8_t lastComp = 0;
+	unsigned int repCount = 0;
+	for (MapEntry &entry : hunkMap) {
+		if (repCount > 0) {
+			entry.compression = lastComp;
+			repCount--;
+			continue;
+		}
+
+		const unsigned int val = decoder.decodeOne(br);
+		if (val == CHD_COMPRESSION_RLE_SMALL) {
+			entry.compression = lastComp;
+			repCount = 2 + decoder.decodeOne(br);
+		} else if (val == CHD_COMPRESSION_RLE_LARGE) {
+			entry.compression = lastComp;
+			repCount = 2 + 16 + (decoder.decodeOne(br) << 4);
+			repCount += decoder.decodeOne(br);
+		} else {
+			entry.compression = lastComp = static_cast<uint8_t>(val);
+		}
+	}
+
+	// Decode the offsets, lengths, and CRCs.
+	// The CRC-16 of the map is calculated using MAME's 12-byte raw map entries.
+	uint16_t crc = 0xFFFF;
+	uint64_t lastSelf = 0;
+	uint64_t lastParent = 0;
+	const uint64_t unitsPerHunk = chdHeader.hunk_bytes / chdHeader.unit_bytes;
+	for (unsigned int hunkIdx = 0; hunkIdx < hunkCount; hunkIdx++) {
+		MapEntry &entry = hunkMap[hunkIdx];
+		uint64_t offset = curOffset;
+		uint32_t length = 0;
+		uint16_t hunkCrc = 0;
+
+		switch (entry.compression) {
+			case CHD_COMPRESSION_TYPE_0:
+			case CHD_COMPRESSION_TYPE_1:
+			case CHD_COMPRESSION_TYPE_2:
+			case CHD_COMPRESSION_TYPE_3:
+				length = static_cast<uint32_t>(br.read(lengthBits));
+				curOffset += length;
+				hunkCrc = static_cast<uint16_t>(br.read(16));
+				break;
+
+			case CHD_COMPRESSION_NONE:
+				length = chdHeader.hunk_bytes;
+				curOffset += length;
+				hunkCrc = static_cast<uint16_t>(br.read(16));
+				break;
+
+			case CHD_COMPRESSION_SELF:
+				lastSelf = offset = br.read(selfBits);
+				break;
+
+			case CHD_COMPRESSION_PARENT:
+				lastParent = offset = br.read(parentBits);
+				break;
+
+			case CHD_COMPRESSION_SELF_1:
+				lastSelf++;
+				// fall-through
+			case CHD_COMPRESSION_SELF_0:
+				entry.compression = CHD_COMPRESSION_SELF;
+				offset = lastSelf;
+				break;
+
+			case CHD_COMPRESSION_PARENT_SELF:
+				entry.compression = CHD_COMPRESSION_PARENT;
+				lastParent = offset = static_cast<uint64_t>(hunkIdx) * unitsPerHunk;
+				break;
+
+			case CHD_COMPRESSION_PARENT_1:
+				lastParent += unitsPerHunk;
+				// fall-through
+			case CHD_COMPRESSION_PARENT_0:
+				entry.compression = CHD_COMPRESSION_PARENT;
+				offset = lastParent;
+				break;
+
+			default:
+				// Invalid compression type.
+				return -EIO;
+		}
+
+		entry.offset = offset;
+		entry.length = length;
+		entry.crc16 = hunkCrc;
+		entry.reserved = 0;
+
+		const uint8_t rawEntry[12] = {
+			entry.compression,
+			static_cast<uint8_t>(length >> 16),
+			static_cast<uint8_t>(length >> 8),
+			static_cast<uint8_t>(length),
+			static_cast<uint8_t>(offset >> 40),
+			static_cast<uint8_t>(offset >> 32),
+			static_cast<uint8_t>(offset >> 24),
+			static_cast<uint8_t>(offset >> 16),
+			static_cast<uint8_t>(offset >> 8),
+			static_cast<uint8_t>(offset),
+			static_cast<uint8_t>(hunkCrc >> 8),
+			static_cast<uint8_t>(hunkCrc),
+		};
+		crc = crc16(crc, rawEntry, sizeof(rawEntry));
+	}
+
+	if (br.overflow() || crc != mapCrc) {
+		// Map is corrupted.
+		return -EIO;
+	}
+
+	hasHunkCrc = true;
+	return 0;
+}
+
+/**
+ * Load the metadata and determine the CD-ROM track layout.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ChdReaderPrivate::loadMetadata(void)
+{
+	// Track metadata, as stored in the CHD.
+	struct TrackMetadata {
+		int trackNumber;
+		TrackType type;
+		unsigned int frames;
+		unsigned int pregap;
+		unsigned int pregapData;	// Pregap frames stored in the CHD
+		unsigned int postgap;
+		int pad;			// Padding frames (-1 if not specified)
+	};
+	vector<TrackMetadata> trackMeta;
+
+	// Limit the number of metadata entries in case of loops.
+	uint64_t offset = chdHeader.meta_offset;
+	for (unsigned int count = 0; offset != 0 && count < 1024; count++) {
+		ChdMetadataHeader metaHeader;
+		if (readFileAt(static_cast<off64_t>(offset), &metaHeader, sizeof(metaHeader)) != sizeof(metaHeader)) {
+			return -EIO;
+		}
+		const uint32_t tag = be32_to_cpu(metaHeader.tag);
+		const uint32_t length = be32_to_cpu(metaHeader.flags_length) & 0xFFFFFF;
+		const uint64_t next = be64_to_cpu(metaHeader.next);
+
+		if (tag == CHD_META_CDROM_TRACK || tag == CHD_META_CDROM_TRACK2 || tag == CHD_META_GDROM_TRACK) {
+			// CD-ROM or GD-ROM track. (text)
+			char buf[256];
+			if (length >= sizeof(buf)) {
+				return -EIO;
+			}
+			if (readFileAt(static_cast<off64_t>(offset + sizeof(metaHeader)), buf, length) != length) {
+				return -EIO;
+			}
+			buf[length] = '\0';
+
+			TrackMetadata tm;
+			char type[16], subtype[16], pgtype[16], pgsub[16];
+			pgtype[0] = '\0';
+			tm.pregap = 0;
+			tm.postgap = 0;
+			tm.pad = -1;
+			int n;
+			switch (tag) {
+				default:
+				case CHD_META_CDROM_TRACK:
+					n = sscanf(buf, "TRACK:%d TYPE:%15s SUBTYPE:%15s FRAMES:%u",
+						&tm.trackNumber, type, subtype, &tm.frames);
+					if (n != 4) {
+						return -EIO;
+					}
+					break;
+				case CHD_META_CDROM_TRACK2:
+					n = sscanf(buf, "TRACK:%d TYPE:%15s SUBTYPE:%15s FRAMES:%u PREGAP:%u PGTYPE:%15s PGSUB:%15s POSTGAP:%u",
+						&tm.trackNumber, type, subtype, &tm.frames,
+						&tm.pregap, pgtype, pgsub, &tm.postgap);
+					if (n != 8) {
+						return -EIO;
+					}
+					break;
+				case CHD_META_GDROM_TRACK:
+					n = sscanf(buf, "TRACK:%d TYPE:%15s SUBTYPE:%15s FRAMES:%u PAD:%d PREGAP:%u PGTYPE:%15s PGSUB:%15s POSTGAP:%u",
+						&tm.trackNumber, type, subtype, &tm.frames, &tm.pad,
+						&tm.pregap, pgtype, pgsub, &tm.postgap);
+					if (n != 9) {
+						return -EIO;
+					}
+					isGdrom = true;
+					break;
+			}
+
+			// If the pregap type starts with 'V', the pregap is stored in the CHD.
+			tm.pregapData = (pgtype[0] == 'V') ? tm.pregap : 0;
+
+			// Track type
+			static const struct {
+				char name[16];
+				TrackType type;
+			} trackTypes[] = {
+				{"MODE1",		TrackType::Cooked},
+				{"MODE1/2048",		TrackType::Cooked},
+				{"MODE1_RAW",		TrackType::Raw},
+				{"MODE1/2352",		TrackType::Raw},
+				{"MODE2",		TrackType::Mode2},
+				{"MODE2/2336",		TrackType::Mode2},
+				{"MODE2_FORM1",		TrackType::Cooked},
+				{"MODE2/2048",		TrackType::Cooked},
+				{"MODE2_FORM2",		TrackType::Unsupported},
+				{"MODE2/2324",		TrackType::Unsupported},
+				{"MODE2_FORM_MIX",	TrackType::Mode2},
+				{"MODE2_RAW",		TrackType::Raw},
+				{"MODE2/2352",		TrackType::Raw},
+				{"CDI/2352",		TrackType::Raw},
+				{"AUDIO",		TrackType::Audio},
+			};
+			tm.type = TrackType::Unsupported;
+			for (const auto &p : trackTypes) {
+				if (!strcmp(type, p.name)) {
+					tm.type = p.type;
+					break;
+				}
+			}
+
+			if (tm.trackNumber <= 0 || tm.trackNumber > 99 || tm.frames < tm.pregapData) {
+				return -EIO;
+			}
+			trackMeta.push_back(tm);
+		}
+
+		offset = next;
+	}
+
+	if (trackMeta.empty()) {
+		// Not a CD-ROM image.
+		return 0;
+	}
+
+	// CD-ROM frames are always 2,448 bytes.
+	if (chdHeader.unit_bytes != CHD_CD_FRAME_SIZE || (chdHeader.hunk_bytes % CHD_CD_FRAME_SIZE) != 0) {
+		return -EIO;
+	}
+	framesPerHunk = chdHeader.hunk_bytes / CHD_CD_FRAME_SIZE;
+	const uint64_t totalFrames = chdHeader.logical_bytes / CHD_CD_FRAME_SIZE;
+
+	// Tracks must be numbered 1 through N.
+	std::sort(trackMeta.begin(), trackMeta.end(),
+		[](const TrackMetadata &a, const TrackMetadata &b) noexcept -> bool {
+			return (a.trackNumber < b.trackNumber);
+		});
+
+	// Calculate the track layout.
+	// Based on cdrom_file::cdrom_file() in MAME.
+	// NOTE: Track 1's pregap isn't counted, so track 1 always starts at LBA 0.
+	uint64_t chdOfs = 0;
+	uint64_t logOfs = 0;
+	tracks.resize(trackMeta.size());
+	for (size_t i = 0; i < trackMeta.size(); i++) {
+		const TrackMetadata &tm = trackMeta[i];
+		if (tm.trackNumber != static_cast<int>(i + 1)) {
+			return -EIO;
+		}
+
+		if (isGdrom && tm.trackNumber == 3) {
+			// GD-ROM: Track 3 is the start of the high-density area.
+			if (logOfs + tm.pregap > CHD_GDROM_HD_AREA_LBA) {
+				return -EIO;
+			}
+			logOfs = CHD_GDROM_HD_AREA_LBA - tm.pregap;
+		}
+
+		TrackInfo &track = tracks[i];
+		track.lbaStart = static_cast<unsigned int>(logOfs + (i == 0 ? 0 : tm.pregap));
+		track.lbaCount = tm.frames - tm.pregapData;
+		track.chdFrameStart = static_cast<unsigned int>(chdOfs + tm.pregapData);
+		track.trackNumber = static_cast<uint8_t>(tm.trackNumber);
+		track.type = tm.type;
+
+		if (static_cast<uint64_t>(track.chdFrameStart) + track.lbaCount > totalFrames) {
+			// Track is past the end of the CHD.
+			return -EIO;
+		}
+
+		logOfs = static_cast<uint64_t>(track.lbaStart) + track.lbaCount + tm.postgap;
+		const unsigned int pad = (tm.pad >= 0)
+			? static_cast<unsigned int>(tm.pad)
+			: ((tm.frames + CHD_CD_TRACK_PADDING - 1) / CHD_CD_TRACK_PADDING * CHD_CD_TRACK_PADDING) - tm.frames;
+		chdOfs += tm.frames + pad;
+		if (logOfs > 0x7FFFFFFF || chdOfs > 0x7FFFFFFF) {
+			return -EIO;
+		}
+	}
+
+	isCdrom = true;
+	return 0;
+}
+
+/**
+ * Read and decompress a hunk.
+ * This can be called concurrently.
+ * @param hunkIdx	[in] Hunk index
+ * @param dest		[out] Output buffer (must be hunk_bytes)
+ * @param depth		[in] Self-reference depth
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ChdReaderPrivate::readHunk(uint32_t hunkIdx, uint8_t *dest, int depth)
+{
+	assert(hunkIdx < hunkCount);
+	if (hunkIdx >= hunkCount) {
+		return -EINVAL;
+	}
+
+	const uint32_t hunk_bytes = chdHeader.hunk_bytes;
+	const MapEntry &entry = hunkMap[hunkIdx];
+	switch (entry.compression) {
+		default:
+			assert(!"Invalid compression type.");
+			return -EIO;
+
+		case CHD_COMPRESSION_TYPE_0:
+		case CHD_COMPRESSION_TYPE_1:
+		case CHD_COMPRESSION_TYPE_2:
+		case CHD_COMPRESSION_TYPE_3: {
+			const uint32_t codec = chdHeader.compressors[entry.compression];
+			if (codec == CHD_CODEC_NONE || entry.length == 0 || entry.length > hunk_bytes) {
+				return -EIO;
+			}
+
+			// NOTE: Compressed data buffer is local so hunks
+			// can be decompressed concurrently.
+			rp::uvector<uint8_t> z_buffer(entry.length);
+			if (readFileAt(static_cast<off64_t>(entry.offset), z_buffer.data(), entry.length) != entry.length) {
+				return -EIO;
+			}
+			const int ret = decompress(codec, z_buffer.data(), entry.length, dest, hunk_bytes);
+			if (ret != 0) {
+				return ret;
+			}
+			break;
+		}
+
+		case CHD_COMPRESSION_NONE:
+			if (!hasHunkCrc && entry.offset == 0) {
+				// Uncompressed map: Hunk isn't present.
+				memset(dest, 0, hunk_bytes);
+				return 0;
+			}
+			if (readFileAt(static_cast<off64_t>(entry.offset), dest, hunk_bytes) != hunk_bytes) {
+				return -EIO;
+			}
+			break;
+
+		case CHD_COMPRESSION_SELF:
+			// Same as another hunk.
+			// NOTE: The CRC-16 isn't stored for self-references.
+			if (depth >= 8 || entry.offset >= hunkCount) {
+				return -EIO;
+			}
+			return readHunk(static_cast<uint32_t>(entry.offset), dest, depth + 1);
+
+		case CHD_COMPRESSION_PARENT:
+			// Parent CHDs aren't supported.
+			return -ENOTSUP;
+	}
+
+	if (hasHunkCrc && crc16(0xFFFF, dest, hunk_bytes) != entry.crc16) {
+		// CRC-16 mismatch.
+		return -EIO;
+	}
+	return 0;
+}
+
+/**
+ * Get a hunk from the hunk cache, reading it if necessary.
+ * NOTE: hunkCacheMutex must be locked by the caller.
+ * @param hunkIdx	[in] Hunk index
+ * @param pErr		[out] Error code on error
+ * @return Hunk data, or nullptr on error.
+ */
+const uint8_t *ChdReaderPrivate::getCachedHunk(uint32_t hunkIdx, int *pErr)
+{
+	// Check if the hunk is cached.
+	// Also find the least-recently used hunk in case it isn't.
+	CachedHunk *lru = nullptr;
+	for (CachedHunk &hunk : hunkCache) {
+		if (hunk.hunkIdx == hunkIdx) {
+			// Found the hunk.
+			hunk.lastUsed = ++hunkLruCounter;
+			return hunk.data.data();
+		}
+		if (!lru || hunk.lastUsed < lru->lastUsed) {
+			lru = &hunk;
+		}
+	}
+
+	if (hunkCache.size() < maxCachedHunks) {
+		// Cache isn't full yet.
+		// NOTE: hunkCache has maxCachedHunks reserved, so this won't reallocate.
+		hunkCache.resize(hunkCache.size() + 1);
+		lru = &hunkCache.back();
+		lru->data.resize(chdHeader.hunk_bytes);
+	}
+	assert(lru != nullptr);
+
+	// Read the hunk into the LRU slot.
+	lru->hunkIdx = ~0U;
+	const int ret = readHunk(hunkIdx, lru->data.data());
+	if (ret != 0) {
+		*pErr = -ret;
+		return nullptr;
+	}
+	lru->hunkIdx = hunkIdx;
+	lru->lastUsed = ++hunkLruCounter;
+	return lru->data.data();
+}
+
+/**
+ * Find the data track containing an LBA.
+ * @param lba LBA
+ * @return Track, or nullptr if the LBA isn't in a data track.
+ */
+const ChdReaderPrivate::TrackInfo *ChdReaderPrivate::findDataTrack(unsigned int lba) const
+{
+	for (const TrackInfo &track : tracks) {
+		if (lba >= track.lbaStart && lba - track.lbaStart < track.lbaCount) {
+			return (track.type != TrackType::Audio && track.type != TrackType::Unsupported)
+				? &track
+				: nullptr;
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * Get a track by track number.
+ * @param trackNumber Track number (1-based)
+ * @return Track, or nullptr if not found.
+ */
+const ChdReaderPrivate::TrackInfo *ChdReaderPrivate::getTrack(int trackNumber) const
+{
+	if (trackNumber <= 0 || trackNumber > static_cast<int>(tracks.size()))
+		return nullptr;
+	return &tracks[trackNumber - 1];
+}
+
+/** Codecs **/
+
+/**
+ * Decompress data using a CHD codec.
+ * @param codec		[in] Codec (see CHD_Codec_e)
+ * @param src		[in] Compressed data
+ * @param src_len	[in] Size of src
+ * @param dest		[out] Output buffer
+ * @param dest_len	[in] Expected decompressed size
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ChdReaderPrivate::decompress(uint32_t codec, const uint8_t *src, size_t src_len, uint8_t *dest, size_t dest_len)
+{
+	switch (codec) {
+		default:
+			// Unsupported codec, e.g. 'huff' or 'avhu'.
+			return -ENOTSUP;
+
+		case CHD_CODEC_ZLIB: {
+			// Raw deflate
+			z_stream strm = { };
+			strm.next_in = const_cast<Bytef*>(src);
+			strm.avail_in = static_cast<uInt>(src_len);
+			strm.next_out = dest;
+			strm.avail_out = static_cast<uInt>(dest_len);
+			if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+				return -ENOMEM;
+			}
+			const int status = inflate(&strm, Z_FINISH);
+			const uLong total_out = strm.total_out;
+			inflateEnd(&strm);
+			if ((status != Z_STREAM_END && status != Z_OK && status != Z_BUF_ERROR) || total_out != dest_len) {
+				return -EIO;
+			}
+			break;
+		}
+
+#ifdef HAVE_ZSTD
+		case CHD_CODEC_ZSTD: {
+			const size_t ret = ZSTD_decompress(dest, dest_len, src, src_len);
+			if (ZSTD_isError(ret) || ret != dest_len) {
+				return -EIO;
+			}
+			break;
+		}
+#endif /* HAVE_ZSTD */
+
+#ifdef HAVE_LZMA
+		case CHD_CODEC_LZMA: {
+			// Raw LZMA1 with no end marker.
+			// MAME uses level 9 with the dictionary size reduced
+			// to fit the decompressed size. The decoder only needs
+			// a dictionary at least as large as the encoder's.
+			lzma_options_lzma opt;
+			if (lzma_lzma_preset(&opt, 0)) {
+				return -EIO;
+			}
+			opt.dict_size = LZMA_DICT_SIZE_MIN;
+			for (unsigned int i = 11; i <= 30; i++) {
+				if (dest_len <= (2U << i)) {
+					opt.dict_size = (2U << i);
+					break;
+				} else if (dest_len <= (3U << i)) {
+					opt.dict_size = (3U << i);
+					break;
+				}
+			}
+			opt.lc = 3;
+			opt.lp = 0;
+			opt.pb = 2;
+
+			const lzma_filter filters[2] = {
+				{LZMA_FILTER_LZMA1, &opt},
+				{LZMA_VLI_UNKNOWN, nullptr},
+			};
+			lzma_stream strm = LZMA_STREAM_INIT;
+			if (lzma_raw_decoder(&strm, filters) != LZMA_OK) {
+				return -ENOMEM;
+			}
+			strm.next_in = src;
+			strm.avail_in = src_len;
+			strm.next_out = dest;
+			strm.avail_out = dest_len;
+			const lzma_ret status = lzma_code(&strm, LZMA_RUN);
+			const uint64_t total_out = strm.total_out;
+			lzma_end(&strm);
+			if ((status != LZMA_OK && status != LZMA_STREAM_END) || total_out != dest_len) {
+				return -EIO;
+			}
+			break;
+		}
+#endif /* HAVE_LZMA */
+
+		case CHD_CODEC_FLAC: {
+			// FLAC: First byte indicates the sample endianness.
+			if (src_len < 1 || (dest_len % 4) != 0 || (src[0] != 'L' && src[0] != 'B')) {
+				return -EIO;
+			}
+			const int ret = ChdFlac::decodeInterleaved(&src[1], src_len - 1, dest,
+				static_cast<unsigned int>(dest_len / 4), (src[0] == 'B'));
+			if (ret < 0) {
+				return ret;
+			}
+			break;
+		}
+
+		case CHD_CODEC_CD_ZLIB:
+			return decompressCd(CHD_CODEC_ZLIB, CHD_CODEC_ZLIB, src, src_len, dest, dest_len);
+		case CHD_CODEC_CD_LZMA:
+			return decompressCd(CHD_CODEC_LZMA, CHD_CODEC_ZLIB, src, src_len, dest, dest_len);
+		case CHD_CODEC_CD_ZSTD:
+			return decompressCd(CHD_CODEC_ZSTD, CHD_CODEC_ZSTD, src, src_len, dest, dest_len);
+		case CHD_CODEC_CD_FLAC:
+			return decompressCdFlac(src, src_len, dest, dest_len);
+	}
+
+	return 0;
+}
+
+/**
+ * Decompress a CD-ROM hunk. (cdzl, cdlz, cdzs)
+ * @param baseCodec	[in] Codec for the sector data
+ * @param subCodec	[in] Codec for the subcode data
+ * @param src		[in] Compressed data
+ * @param src_len	[in] Size of src
+ * @param dest		[out] Output buffer
+ * @param dest_len	[in] Expected decompressed size
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ChdReaderPrivate::decompressCd(uint32_t baseCodec, uint32_t subCodec,
+	const uint8_t *src, size_t src_len, uint8_t *dest, size_t dest_len)
+{
+	// Header:
+	// - ECC bitmap: 1 bit per frame. If set, the sync header
+	//   and ECC data were removed and must be regenerated.
+	// - Compressed size of the sector data: 2 or 3 bytes.
+	const unsigned int frames = static_cast<unsigned int>(dest_len / CHD_CD_FRAME_SIZE);
+	const unsigned int complen_bytes = (dest_len < 65536) ? 2 : 3;
+	const unsigned int ecc_bytes = (frames + 7) / 8;
+	const unsigned int header_bytes = ecc_bytes + complen_bytes;
+	if (src_len < header_bytes) {
+		return -EIO;
+	}
+
+	size_t complen_base = (src[ecc_bytes + 0] << 8) | src[ecc_bytes + 1];
+	if (complen_bytes > 2) {
+		complen_base = (complen_base << 8) | src[ecc_bytes + 2];
+	}
+	if (header_bytes + complen_base > src_len) {
+		return -EIO;
+	}
+
+	// Decompress the sector data and subcode data separately.
+	rp::uvector<uint8_t> buf(frames * CHD_CD_FRAME_SIZE);
+	uint8_t *const sectorBuf = buf.data();
+	uint8_t *const subcodeBuf = &buf[frames * CHD_CD_MAX_SECTOR_DATA];
+	int ret = decompress(baseCodec, &src[header_bytes], complen_base,
+		sectorBuf, frames * CHD_CD_MAX_SECTOR_DATA);
+	if (ret != 0) {
+		return ret;
+	}
+	ret = decompress(subCodec, &src[header_bytes + complen_base], src_len - header_bytes - complen_base,
+		subcodeBuf, frames * CHD_CD_MAX_SUBCODE_DATA);
+	if (ret != 0) {
+		return ret;
+	}
+
+	// Reassemble the frames.
+	// NOTE: The ECC data has to be regenerated, since the
+	// hunk's CRC-16 covers the original frames.
+	static const uint8_t sync_header[12] = {0x00,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x00};
+	for (unsigned int i = 0; i < frames; i++) {
+		uint8_t *const frame = &dest[i * CHD_CD_FRAME_SIZE];
+		memcpy(frame, &sectorBuf[i * CHD_CD_MAX_SECTOR_DATA], CHD_CD_MAX_SECTOR_DATA);
+		memcpy(&frame[CHD_CD_MAX_SECTOR_DATA], &subcodeBuf[i * CHD_CD_MAX_SUBCODE_DATA], CHD_CD_MAX_SUBCODE_DATA);
+		if (src[i / 8] & (1U << (i % 8))) {
+			memcpy(frame, sync_header, sizeof(sync_header));
+			ecc_generate(frame);
+		}
+	}
+	return 0;
+}
+
+/**
+ * Decompress a CD-ROM hunk using FLAC. (cdfl)
+ * @param src		[in] Compressed data
+ * @param src_len	[in] Size of src
+ * @param dest		[out] Output buffer
+ * @param dest_len	[in] Expected decompressed size
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ChdReaderPrivate::decompressCdFlac(const uint8_t *src, size_t src_len, uint8_t *dest, size_t dest_len)
+{
+	// Sector data is stored as big-endian 16-bit stereo samples,
+	// followed by the deflated subcode data.
+	const unsigned int frames = static_cast<unsigned int>(dest_len / CHD_CD_FRAME_SIZE);
+	rp::uvector<uint8_t> buf(frames * CHD_CD_FRAME_SIZE);
+	uint8_t *const sectorBuf = buf.data();
+	uint8_t *const subcodeBuf = &buf[frames * CHD_CD_MAX_SECTOR_DATA];
+
+	const int flac_len = ChdFlac::decodeInterleaved(src, src_len, sectorBuf,
+		frames * CHD_CD_MAX_SECTOR_DATA / 4, true);
+	if (flac_len < 0) {
+		return flac_len;
+	}
+	const int ret = decompress(CHD_CODEC_ZLIB, &src[flac_len], src_len - flac_len,
+		subcodeBuf, frames * CHD_CD_MAX_SUBCODE_DATA);
+	if (ret != 0) {
+		return ret;
+	}
+
+	// Reassemble the frames.
+	for (unsigned int i = 0; i < frames; i++) {
+		uint8_t *const frame = &dest[i * CHD_CD_FRAME_SIZE];
+		memcpy(frame, &sectorBuf[i * CHD_CD_MAX_SECTOR_DATA], CHD_CD_MAX_SECTOR_DATA);
+		memcpy(&frame[CHD_CD_MAX_SECTOR_DATA], &subcodeBuf[i * CHD_CD_MAX_SUBCODE_DATA], CHD_CD_MAX_SUBCODE_DATA);
+	}
+	return 0;
+}
+
+/** ChdReader **/
+
+ChdReader::ChdReader(const IRpFilePtr &file)
+	: super(new ChdReaderPrivate(this), file)
+{
+	if (!m_file) {
+		// File could not be ref()'d.
+		return;
+	}
+
+	// Read the CHD header.
+	RP_D(ChdReader);
+	size_t sz = m_file->seekAndRead(0, &d->chdHeader, sizeof(d->chdHeader));
+	if (sz != sizeof(d->chdHeader) ||
+	    isDiscSupported_static(reinterpret_cast<const uint8_t*>(&d->chdHeader), sizeof(d->chdHeader)) < 0)
+	{
+		// Error reading the CHD header, or not a supported CHD.
+		m_file.reset();
+		m_lastError = EIO;
+		return;
+	}
+
+	// Byteswap the header.
+	ChdHeaderV5 *const hdr = &d->chdHeader;
+	hdr->length		= be32_to_cpu(hdr->length);
+	hdr->version		= be32_to_cpu(hdr->version);
+	for (unsigned int i = 0; i < ARRAY_SIZE(hdr->compressors); i++) {
+		hdr->compressors[i] = be32_to_cpu(hdr->compressors[i]);
+	}
+	hdr->logical_bytes	= be64_to_cpu(hdr->logical_bytes);
+	hdr->map_offset		= be64_to_cpu(hdr->map_offset);
+	hdr->meta_offset	= be64_to_cpu(hdr->meta_offset);
+	hdr->hunk_bytes		= be32_to_cpu(hdr->hunk_bytes);
+	hdr->unit_bytes		= be32_to_cpu(hdr->unit_bytes);
+
+	// Validate the hunk size.
+	if (hdr->hunk_bytes == 0 || hdr->hunk_bytes > CHD_HUNK_BYTES_MAX ||
+	    hdr->unit_bytes == 0 || (hdr->hunk_bytes % hdr->unit_bytes) != 0 ||
+	    hdr->logical_bytes == 0)
+	{
+		m_file.reset();
+		m_lastError = EIO;
+		return;
+	}
+	const uint64_t hunkCount = (hdr->logical_bytes + hdr->hunk_bytes - 1) / hdr->hunk_bytes;
+	if (hunkCount > ChdReaderPrivate::MAX_HUNK_COUNT) {
+		// Too many hunks.
+		m_file.reset();
+		m_lastError = ENOMEM;
+		return;
+	}
+	d->hunkCount = static_cast<unsigned int>(hunkCount);
+
+	// Load the hunk map and metadata.
+	// NOTE: Hunks are only decompressed when they're read.
+	int ret = d->loadMap();
+	if (ret == 0) {
+		ret = d->loadMetadata();
+	}
+	if (ret != 0) {
+		m_file.reset();
+		m_lastError = -ret;
+		return;
+	}
+
+	if (d->isCdrom) {
+		// CD-ROM: Use 2048-byte logical sectors.
+		unsigned int blockCount = 0;
+		for (const ChdReaderPrivate::TrackInfo &track : d->tracks) {
+			if (track.type == ChdReaderPrivate::TrackType::Audio ||
+			    track.type == ChdReaderPrivate::TrackType::Unsupported)
+			{
+				continue;
+			}
+			blockCount = std::max(blockCount, track.lbaStart + track.lbaCount);
+		}
+		if (blockCount == 0) {
+			// No data tracks.
+			m_file.reset();
+			m_lastError = EIO;
+			return;
+		}
+
+		d->block_size = 2048;
+		d->disc_size = static_cast<off64_t>(blockCount) * 2048;
+
+		// Sectors are read from the hunk cache, so
+		// SparseDiscReader's block cache isn't needed.
+		d->cacheSizeMB = 0;
+	} else {
+		// Other image: Each hunk is a block.
+		d->block_size = hdr->hunk_bytes;
+		d->disc_size = static_cast<off64_t>(hdr->logical_bytes);
+
+		// Each hunk is compressed separately, and full hunks
+		// can be decompressed concurrently.
+		d->wholeBlocks = true;
+		d->parallelBlocks = true;
+	}
+
+	// Initialize the hunk cache.
+	d->maxCachedHunks = std::max(2U, ChdReaderPrivate::HUNK_CACHE_SIZE / hdr->hunk_bytes);
+	d->hunkCache.reserve(d->maxCachedHunks);
+
+	// Reset the disc position.
+	d->pos = 0;
+}
+
+/**
+ * Is a disc image supported by this class?
+ * @param pHeader Disc image header.
+ * @param szHeader Size of header.
+ * @return Class-specific disc format ID (>= 0) if supported; -1 if not.
+ */
+int ChdReader::isDiscSupported_static(const uint8_t *pHeader, size_t szHeader)
+{
+	if (szHeader < CHD_V5_HEADER_SIZE) {
+		// Not enough data to check.
+		return -1;
+	}
+
+	// Check the magic and version.
+	// NOTE: Only CHD v5 is supported.
+	const ChdHeaderV5 *const chdHeader = reinterpret_cast<const ChdHeaderV5*>(pHeader);
+	if (memcmp(chdHeader->magic, CHD_MAGIC, sizeof(chdHeader->magic)) != 0 ||
+	    chdHeader->length != cpu_to_be32(CHD_V5_HEADER_SIZE) ||
+	    chdHeader->version != cpu_to_be32(5))
+	{
+		// Incorrect magic or version.
+		return -1;
+	}
+
+	// This is a valid CHD v5 image.
+	return 0;
+}
+
+/**
+ * Is a disc image supported by this object?
+ * @param pHeader Disc image header.
+ * @param szHeader Size of header.
+ * @return Class-specific system ID (>= 0) if supported; -1 if not.
+ */
+int ChdReader::isDiscSupported(const uint8_t *pHeader, size_t szHeader) const
+{
+	return isDiscSupported_static(pHeader, szHeader);
+}
+
+/** SparseDiscReader functions **/
+
+/**
+ * Get the physical address of the specified logical block index.
+ *
+ * NOTE: Not implemented in this subclass.
+ *
+ * @param blockIdx	[in] Block index.
+ * @return Physical block address. (-1 due to not being implemented)
+ */
+off64_t ChdReader::getPhysBlockAddr(uint32_t blockIdx) const
+{
+	RP_UNUSED(blockIdx);
+	assert(!"ChdReader::getPhysBlockAddr() is not implemented.");
+	return -1;
+}
+
+/**
+ * Read the specified block.
+ *
+ * This can read either a full block or a partial block.
+ * For a full block, set pos = 0 and size = block_size.
+ *
+ * @param blockIdx	[in] Block index.
+ * @param pos		[in] Starting position. (Must be >= 0 and <= the block size!)
+ * @param ptr		[out] Output data buffer.
+ * @param size		[in] Amount of data to read, in bytes. (Must be <= the block size!)
+ * @return Number of bytes read, or -1 if the block index is invalid.
+ */
+int ChdReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
+{
+	// Read 'size' bytes of block 'blockIdx', starting at 'pos'.
+	// NOTE: This can only be called by SparseDiscReader,
+	// so the main assertions are already checked there.
+	RP_D(ChdReader);
+	assert(pos >= 0 && pos < (int)d->block_size);
+	assert(size <= d->block_size - pos);
+	// NOTE: size is checked against the rest of the block
+	// instead of checking pos+size, which could overflow.
+	if (pos < 0 || pos >= (int)d->block_size || size > d->block_size - static_cast<unsigned int>(pos)) {
+		// pos+size is out of range.
+		return -1;
+	}
+
+	if (unlikely(size == 0)) {
+		// Nothing to read.
+		return 0;
+	}
+
+	if (!d->isCdrom) {
+		// Each block is a hunk.
+		if (blockIdx >= d->hunkCount) {
+			return -1;
+		}
+
+		if (pos == 0 && size == d->block_size) {
+			// Full hunk. Decompress it directly into the output buffer.
+			const int ret = readFullBlock(blockIdx, ptr);
+			if (ret != 0) {
+				m_lastError = -ret;
+				return -1;
+			}
+			return static_cast<int>(size);
+		}
+
+		// Partial hunk. Use the hunk cache.
+		MutexLocker hunkCacheLocker(d->hunkCacheMutex);
+		int err = 0;
+		const uint8_t *const hunk = d->getCachedHunk(blockIdx, &err);
+		if (!hunk) {
+			m_lastError = err;
+			return -1;
+		}
+		memcpy(ptr, &hunk[pos], size);
+		return static_cast<int>(size);
+	}
+
+	// CD-ROM: Each block is a 2048-byte logical sector.
+	const ChdReaderPrivate::TrackInfo *const track = d->findDataTrack(blockIdx);
+	if (!track) {
+		// Not in a data track.
+		return 0;
+	}
+
+	const unsigned int chdFrame = track->chdFrameStart + (blockIdx - track->lbaStart);
+	const uint32_t hunkIdx = chdFrame / d->framesPerHunk;
+	const unsigned int frameOffset = (chdFrame % d->framesPerHunk) * CHD_CD_FRAME_SIZE;
+
+	MutexLocker hunkCacheLocker(d->hunkCacheMutex);
+	int err = 0;
+	const uint8_t *const hunk = d->getCachedHunk(hunkIdx, &err);
+	if (!hunk) {
+		m_lastError = err;
+		return -1;
+	}
+
+	// NOTE: Sector user data area position depends on the track type.
+	const uint8_t *const frame = &hunk[frameOffset];
+	const uint8_t *data;
+	switch (track->type) {
+		default:
+		case ChdReaderPrivate::TrackType::Cooked:
+			data = frame;
+			break;
+		case ChdReaderPrivate::TrackType::Mode2:
+			// Skip the 8-byte subheader.
+			data = &frame[8];
+			break;
+		case ChdReaderPrivate::TrackType::Raw:
+			data = cdromSectorDataPtr(reinterpret_cast<const CDROM_2352_Sector_t*>(frame));
+			break;
+	}
+	memcpy(ptr, &data[pos], size);
+	return static_cast<int>(size);
+}
+
+/**
+ * Read a full block. (thread-safe)
+ *
+ * If parallelBlocks is set in the private class, this is used
+ * to read multiple full blocks in parallel. It may be called
+ * concurrently from multiple threads, so it must not modify
+ * any shared state, including m_lastError and m_file.
+ *
+ * NOTE: Only supported for non-CD-ROM images. CD-ROM sectors
+ * are read from the hunk cache, so parallelBlocks isn't set.
+ *
+ * @param blockIdx	[in] Block index.
+ * @param ptr		[out] Output data buffer. (Must be block_size bytes!)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ChdReader::readFullBlock(uint32_t blockIdx, void *ptr)
+{
+	RP_D(ChdReader);
+	assert(!d->isCdrom);
+	if (d->isCdrom) {
+		// CD-ROM sectors aren't full hunks.
+		return -ENOTSUP;
+	} else if (blockIdx >= d->hunkCount) {
+		// Out of range.
+		return -EINVAL;
+	}
+
+	// Each block is a hunk.
+	// NOTE: readHunk() doesn't use any shared buffers.
+	return d->readHunk(blockIdx, static_cast<uint8_t*>(ptr));
+}
+
+/** CHD-specific functions **/
+
+/**
+ * Is this a CD-ROM or GD-ROM image?
+ * If not, there are no tracks, and the image is accessed as-is.
+ * @return True if CD-ROM or GD-ROM; false if not.
+ */
+bool ChdReader::isCdrom(void) const
+{
+	RP_D(const ChdReader);
+	return d->isCdrom;
+}
+
+/**
+ * Is this a GD-ROM image?
+ * @return True if GD-ROM; false if not.
+ */
+bool ChdReader::isGdrom(void) const
+{
+	RP_D(const ChdReader);
+	return d->isGdrom;
+}
+
+/**
+ * Get the track count.
+ * @return Track count. (0 if not a CD-ROM or GD-ROM image)
+ */
+int ChdReader::trackCount(void) const
+{
+	RP_D(const ChdReader);
+	return static_cast<int>(d->tracks.size());
+}
+
+/**
+ * Get the starting LBA of the specified track number.
+ * @param trackNumber Track number. (1-based)
+ * @return Starting LBA, or -1 if the track number is invalid.
+ */
+int ChdReader::startingLBA(int trackNumber) const
+{
+	assert(trackNumber > 0);
+	assert(trackNumber <= 99);
+
+	RP_D(const ChdReader);
+	const ChdReaderPrivate::TrackInfo *const track = d->getTrack(trackNumber);
+	if (!track)
+		return -1;
+
+	return static_cast<int>(track->lbaStart);
+}
+
+/**
+ * Open a track using IsoPartition.
+ * @param trackNumber Track number. (1-based)
+ * @return IsoPartition, or nullptr on error.
+ */
+IsoPartitionPtr ChdReader::openIsoPartition(int trackNumber)
+{
+	RP_D(const ChdReader);
+	const ChdReaderPrivate::TrackInfo *const track = d->getTrack(trackNumber);
+	if (!track || !d->findDataTrack(track->lbaStart)) {
+		// Not a data track.
+		return nullptr;
+	}
+
+	// Logical block size is 2048.
+	// ISO starting offset is the LBA.
+	return std::make_shared<IsoPartition>(this->shared_from_this(),
+		static_cast<off64_t>(track->lbaStart) * 2048, track->lbaStart);
+}
+
+/**
+ * Create an ISO RomData object for a given track number.
+ * @param trackNumber Track number. (1-based)
+ * @return ISO object, or nullptr on error.
+ */
+ISOPtr ChdReader::openIsoRomData(int trackNumber)
+{
+	RP_D(const ChdReader);
+	const ChdReaderPrivate::TrackInfo *const track = d->getTrack(trackNumber);
+	if (!track || !d->findDataTrack(track->lbaStart)) {
+		// Not a data track.
+		return nullptr;
+	}
+
+	PartitionFilePtr isoFile = std::make_shared<PartitionFile>(this->shared_from_this(),
+		static_cast<off64_t>(track->lbaStart) * 2048,
+		static_cast<off64_t>(track->lbaCount) * 2048);
+	if (isoFile->isOpen()) {
+		ISOPtr isoData = std::make_shared<ISO>(isoFile);
+		if (isoData->isOpen()) {
+			// ISO is opened.
+			return isoData;
+		}
+	}
+
+	// Unable to open the ISO object.
+	return nullptr;
+}
+
+}
@@ -56,6 +56,9 @@ CisoGcnReaderPrivate::CisoGcnReaderPrivate(CisoGcnReader *q)
 	memset(&cisoHeader, 0, sizeof(cisoHeader));
 	// Clear the CISO block map initially.
 	blockMap.fill(0xFFFF);
+
+	// Blocks are stored uncompressed.
+	physBlockAddrs = true;
 }
 
 /** CisoGcnReader **/
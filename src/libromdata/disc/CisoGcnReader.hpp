@@ -9,6 +9,7 @@
 #pragma once
 
 #include "librpbase/disc/SparseDiscReader.hpp"
+#include "dll-macros.h"	// for RP_LIBROMDATA_PUBLIC
 
 namespace LibRomData {
 
@@ -22,6 +23,7 @@ public:
 	 * unref()'d by the caller afterwards.
 	 * @param file File to read from.
 	 */
+	RP_LIBROMDATA_PUBLIC
 	explicit CisoGcnReader(const LibRpFile::IRpFilePtr &file);
 
 private:
@@ -39,6 +39,11 @@
 #  endif
 #endif /* HAVE_LZO */
 
+// librpthreads
+#include "librpthreads/Mutex.hpp"
+using LibRpThreads::Mutex;
+using LibRpThreads::MutexLocker;
+
 // Other rom-properties libraries
 using namespace LibRpBase;
 using namespace LibRpFile;
@@ -94,13 +99,13 @@ public:
 	// - v2: If set, block is compressed using LZ4; otherwise, deflate.
 	rp::uvector<uint32_t> indexEntries;
 
-	// Block cache
-	rp::uvector<uint8_t> blockCache;
-	uint32_t blockCacheIdx;
+	// Block buffer for partial block reads
+	// NOTE: Blocks are cached by SparseDiscReader.
+	rp::uvector<uint8_t> blockBuf;
 
-	// Decompression buffer
-	// (Same size as blockCache.)
-	rp::uvector<uint8_t> z_buffer;
+	// Mutex for blockBuf.
+	// readBlock() may be called concurrently via readAt().
+	Mutex blockBufMutex;
 
 	// DAX: Size and NC area tables
 	rp::uvector<uint16_t> daxSizeTable;
@@ -122,12 +127,17 @@ public:
 CisoPspReaderPrivate::CisoPspReaderPrivate(CisoPspReader *q)
 	: super(q)
 	, cisoType(CisoType::Unknown)
-	, blockCacheIdx(~0U)
 	, index_shift(0)
 	, isDaxWithoutNCTable(false)
 {
 	// Clear the header structs.
 	memset(&header, 0, sizeof(header));
+
+	// Each block is compressed separately, and full blocks
+	// can be decompressed concurrently.
+	wholeBlocks = true;
+	parallelBlocks = true;
+	physBlockAddrs = true;
 }
 
 /**
@@ -470,18 +480,9 @@ CisoPspReader::CisoPspReader(const IRpFilePtr &file)
 		}
 	}
 
-	// Initialize the block cache and decompression buffer.
+	// Initialize the block buffer.
 	// NOTE: Extra 64 bytes is for zlib, in case it needs it.
-	size_t cache_size = d->block_size + 64;
-	if (d->isDaxWithoutNCTable) {
-		// DAX with no NC table. Use double the block size,
-		// since zlib-compressed data can end up taking up
-		// more space than uncompressed.
-		cache_size *= 2;
-	}
-	d->blockCache.resize(cache_size);
-	d->z_buffer.resize(cache_size);
-	d->blockCacheIdx = ~0U;
+	d->blockBuf.resize(d->block_size + 64);
 
 	// Reset the disc position.
 	d->pos = 0;
@@ -748,19 +749,53 @@ int CisoPspReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 		return 0;
 	}
 
-	if (blockIdx == d->blockCacheIdx) {
-		// Block is cached.
-		memcpy(ptr, &d->blockCache[pos], size);
+	if (pos != 0 || size != d->block_size) {
+		// Partial block. Read the full block into the block buffer.
+		MutexLocker blockBufLocker(d->blockBufMutex);
+		const int rd = readBlock(blockIdx, 0, d->blockBuf.data(), d->block_size);
+		if (rd != static_cast<int>(d->block_size)) {
+			// Error reading the block.
+			return rd;
+		}
+		memcpy(ptr, &d->blockBuf[pos], size);
 		return static_cast<int>(size);
 	}
 
+	// Full block. Decompress it directly into the output buffer.
+	const int ret = readFullBlock(blockIdx, ptr);
+	if (ret != 0) {
+		m_lastError = -ret;
+		return 0;
+	}
+	return static_cast<int>(size);
+}
+
+/**
+ * Read a full block. (thread-safe)
+ *
+ * If parallelBlocks is set in the private class, this is used
+ * to read multiple full blocks in parallel. It may be called
+ * concurrently from multiple threads, so it must not modify
+ * any shared state, including m_lastError and m_file.
+ *
+ * @param blockIdx	[in] Block index.
+ * @param ptr		[out] Output data buffer. (Must be block_size bytes!)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int CisoPspReader::readFullBlock(uint32_t blockIdx, void *ptr)
+{
+	// NOTE: No shared buffers are used here, so multiple
+	// full blocks can be read concurrently.
+	RP_D(CisoPspReader);
+	uint8_t *const blockBuf = static_cast<uint8_t*>(ptr);
+	rp::uvector<uint8_t> z_buffer;	// Compressed data buffer
+
 	// Get the physical address first.
 	const uint32_t indexEntry = d->indexEntries[blockIdx];
 	uint32_t z_block_size = d->getBlockCompressedSize(blockIdx);
 	if (z_block_size == 0) {
 		// Unable to get the block's compressed size...
-		m_lastError = EIO;
-		return 0;
+		return -EIO;
 	}
 
 	enum class CompressionMode {
@@ -777,9 +812,7 @@ int CisoPspReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 		default:
 		case CisoPspReaderPrivate::CisoType::Unknown:
 			assert(!"Unsupported CisoType.");
-			m_file.reset();
-			m_lastError = ENOTSUP;
-			return 0;
+			return -ENOTSUP;
 
 		case CisoPspReaderPrivate::CisoType::CISO:
 			// CISO uses raw deflate.
@@ -800,8 +833,7 @@ int CisoPspReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 					// (Un)compressed block size must match the actual block size.
 					if (z_block_size != d->block_size) {
 						// Error...
-						m_lastError = EIO;
-						return 0;
+						return -EIO;
 					}
 				}
 			} else {
@@ -848,8 +880,7 @@ int CisoPspReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 				// TODO: jiso.exe says this can provide for "faster decompression".
 				if (z_block_size <= 4) {
 					// Incorrect block size.
-					m_lastError = EIO;
-					return 0;
+					return -EIO;
 				}
 				physBlockAddr += 4;
 				z_block_size -= 4;
@@ -869,8 +900,7 @@ int CisoPspReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 						break;
 					default:
 						assert(!"Unsupported JISO compression method.");
-						m_lastError = ENOTSUP;
-						return 0;
+						return -ENOTSUP;
 				}
 			}
 			break;
@@ -894,22 +924,21 @@ int CisoPspReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 	switch (z_mode) {
 		default:
 			assert(!"Compression mode not supported...");
-			m_lastError = ENOTSUP;
-			return 0;
+			return -ENOTSUP;
 
 		case CompressionMode::None: {
-			// Reading uncompressed data directly into the cache.
-			size_t sz_read = m_file->seekAndRead(physBlockAddr, d->blockCache.data(), z_block_size);
+			// Reading uncompressed data directly into the output buffer.
+			if (z_block_size > d->block_size) {
+				// Uncompressed data is larger than the block size.
+				return -EIO;
+			}
+			size_t sz_read = d->readFileAt(physBlockAddr, blockBuf, z_block_size);
 			if (sz_read != z_block_size) {
 				// Seek and/or read error.
-				d->blockCacheIdx = ~0U;
-				m_lastError = m_file->lastError();
-				if (m_lastError == 0) {
-					m_lastError = EIO;
-				}
-				return 0;
+				// NOTE: m_file->lastError() can't be used here,
+				// since other threads may be reading the file.
+				return -EIO;
 			}
-			d->blockCacheIdx = blockIdx;
 			break;
 		}
 
@@ -918,7 +947,7 @@ int CisoPspReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 			// then decompress it.
 			assert(windowBits != 0);
 			if (windowBits == 0) {
-				m_lastError = EINVAL;
+				return -EINVAL;
 			}
 			uint32_t z_max_size = d->block_size;
 			if (unlikely(d->isDaxWithoutNCTable)) {
@@ -929,25 +958,24 @@ int CisoPspReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 			if (z_block_size > z_max_size) {
 				// Compressed data is larger than the uncompressed block size.
 				// This is only allowed for DAX without NC table.
-				m_lastError = EIO;
-				return 0;
+				return -EIO;
 			}
 
-			size_t sz_read = m_file->seekAndRead(physBlockAddr, d->z_buffer.data(), z_block_size);
+			// NOTE: Extra 64 bytes is for zlib, in case it needs it.
+			z_buffer.resize(z_block_size + 64);
+			size_t sz_read = d->readFileAt(physBlockAddr, z_buffer.data(), z_block_size);
 			if (sz_read != z_block_size) {
 				// Seek and/or read error.
-				m_lastError = m_file->lastError();
-				if (m_lastError == 0) {
-					m_lastError = EIO;
-				}
-				return 0;
+				// NOTE: m_file->lastError() can't be used here,
+				// since other threads may be reading the file.
+				return -EIO;
 			}
 
 			// Decompress the data.
 			z_stream strm = { };
-			strm.next_in = d->z_buffer.data();
+			strm.next_in = z_buffer.data();
 			strm.avail_in = z_block_size;
-			strm.next_out = d->blockCache.data();
+			strm.next_out = blockBuf;
 			strm.avail_out = d->block_size;
 			inflateInit2(&strm, windowBits);
 
@@ -958,9 +986,7 @@ int CisoPspReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 			if (status != Z_STREAM_END || uncomp_size != d->block_size) {
 				// Decompression error.
 				// TODO: Print warnings and/or more comprehensive error codes.
-				d->blockCacheIdx = ~0U;
-				m_lastError = EIO;
-				return 0;
+				return -EIO;
 			}
 			break;
 		}
@@ -978,38 +1004,34 @@ int CisoPspReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 			if (z_block_size > z_max_size) {
 				// Compressed data is larger than the uncompressed block size.
 				// This is only allowed for DAX without NC table.
-				m_lastError = EIO;
-				return 0;
+				return -EIO;
 			}
 
-			size_t sz_read = m_file->seekAndRead(physBlockAddr, d->z_buffer.data(), z_block_size);
+			// NOTE: Extra 64 bytes is for zlib, in case it needs it.
+			z_buffer.resize(z_block_size + 64);
+			size_t sz_read = d->readFileAt(physBlockAddr, z_buffer.data(), z_block_size);
 			if (sz_read != z_block_size) {
 				// Seek and/or read error.
-				m_lastError = m_file->lastError();
-				if (m_lastError == 0) {
-					m_lastError = EIO;
-				}
-				return 0;
+				// NOTE: m_file->lastError() can't be used here,
+				// since other threads may be reading the file.
+				return -EIO;
 			}
 
 			// Decompress the data.
 			int sz_rd = LZ4_decompress_safe(
-				reinterpret_cast<const char*>(d->z_buffer.data()),
-				reinterpret_cast<char*>(d->blockCache.data()),
+				reinterpret_cast<const char*>(z_buffer.data()),
+				reinterpret_cast<char*>(blockBuf),
 				z_block_size, d->block_size);
 			if (sz_rd != (int)d->block_size) {
 				// Decompression error.
 				// TODO: Print warnings and/or more comprehensive error codes.
-				d->blockCacheIdx = ~0U;
-				m_lastError = EIO;
-				return 0;
+				return -EIO;
 			}
 			break;
 #else /* !HAVE_LZ4 */
 			// TODO: If it's CISOv2, check for LZ4-compressed blocks and fail early?
 			assert(!"LZ4 is not enabled in this build.");
-			m_lastError = EIO;
-			return 0;
+			return -EIO;
 #endif /* HAVE_LZ4 */
 		}
 
@@ -1026,47 +1048,41 @@ int CisoPspReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 			if (z_block_size > z_max_size) {
 				// Compressed data is larger than the uncompressed block size.
 				// This is only allowed for DAX without NC table.
-				m_lastError = EIO;
-				return 0;
+				return -EIO;
 			}
 
-			size_t sz_read = m_file->seekAndRead(physBlockAddr, d->z_buffer.data(), z_block_size);
+			// NOTE: Extra 64 bytes is for zlib, in case it needs it.
+			z_buffer.resize(z_block_size + 64);
+			size_t sz_read = d->readFileAt(physBlockAddr, z_buffer.data(), z_block_size);
 			if (sz_read != z_block_size) {
 				// Seek and/or read error.
-				m_lastError = m_file->lastError();
-				if (m_lastError == 0) {
-					m_lastError = EIO;
-				}
-				return 0;
+				// NOTE: m_file->lastError() can't be used here,
+				// since other threads may be reading the file.
+				return -EIO;
 			}
 
 			// Decompress the data.
 			// TODO: LZO in-place decompression?
 			lzo_uint dst_len = d->block_size;
 			int ret = lzo1x_decompress_safe(
-				d->z_buffer.data(), z_block_size,
-				d->blockCache.data(), &dst_len,
+				z_buffer.data(), z_block_size,
+				blockBuf, &dst_len,
 				nullptr);
 			if (ret != LZO_E_OK || dst_len != d->block_size) {
 				// Decompression error.
 				// TODO: Print warnings and/or more comprehensive error codes.
-				d->blockCacheIdx = ~0U;
-				m_lastError = EIO;
-				return 0;
+				return -EIO;
 			}
 			break;
 #else /* !HAVE_LZO */
 			assert(!"LZO is not enabled in this build.");
-			m_lastError = EIO;
-			return 0;
+			return -EIO;
 #endif /* HAVE_LZO */
 		}
 	}
 
-	// Block has been loaded into the cache.
-	memcpy(ptr, &d->blockCache[pos], size);
-	d->blockCacheIdx = blockIdx;
-	return static_cast<int>(size);
+	// Block has been loaded.
+	return 0;
 }
 
 }
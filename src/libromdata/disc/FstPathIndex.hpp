@@ -0,0 +1,294 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata)                       *
+ * FstPathIndex.hpp: Hashed path index for GameCube/Wii/Wii U FSTs.        *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+#include "common.h"
+#include "librpbyteswap/byteswap_rp.h"
+
+// C includes (C++ namespace)
+#include <cstring>
+
+// C++ includes
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace LibRomData {
+
+/**
+ * Hashed path index for Nintendo FSTs.
+ *
+ * GCN_FST_Entry and WUP_FST_Entry use the same directory layout:
+ * - The root directory's file_count is the total number of entries.
+ * - Each directory's next_offset is the index after its last entry.
+ * - file_type_name_offset has the type in the high 8 bits and the
+ *   string table offset in the low 24 bits.
+ *
+ * The index is built on the first lookup.
+ *
+ * @tparam FstEntry FST entry type. (fields are big-endian)
+ */
+template<typename FstEntry>
+class FstPathIndex
+{
+public:
+	/**
+	 * Create a path index for an FST.
+	 * The FST data must remain valid while the index is in use.
+	 * @param entries FST entries
+	 * @param string_table String table (must be NULL-terminated)
+	 * @param string_table_sz Size of the string table
+	 */
+	FstPathIndex(const FstEntry *entries, const char *string_table, uint32_t string_table_sz)
+		: m_entries(entries)
+		, m_string_table(string_table)
+		, m_string_table_sz(string_table_sz)
+	{ }
+
+private:
+	RP_DISABLE_COPY(FstPathIndex)
+
+private:
+	static constexpr uint32_t FNV_OFFSET_BASIS = 2166136261U;
+	static constexpr uint32_t FNV_PRIME = 16777619U;
+
+	/**
+	 * Add a path component to a path hash.
+	 * Hashing is case-insensitive. (ASCII only)
+	 * @param hash Path hash of the parent directory.
+	 * @param name Path component.
+	 * @param len Length of name.
+	 * @return Path hash.
+	 */
+	static inline uint32_t path_hash(uint32_t hash, const char *name, size_t len)
+	{
+		// FNV-1a, including the '/' separator.
+		hash = (hash ^ '/') * FNV_PRIME;
+		for (; len > 0; name++, len--) {
+			uint8_t chr = static_cast<uint8_t>(*name);
+			if (chr >= 'A' && chr <= 'Z') {
+				chr |= 0x20;
+			}
+			hash = (hash ^ chr) * FNV_PRIME;
+		}
+		return hash;
+	}
+
+	/**
+	 * Compare an FST entry name to a path component.
+	 * @param name FST entry name.
+	 * @param comp Path component. (not NULL-terminated)
+	 * @param len Length of comp.
+	 * @return 0 if equal; 1 if equal ignoring case (ASCII only); -1 if not equal.
+	 */
+	static int compare_name(const char *name, const char *comp, size_t len)
+	{
+		int ret = 0;
+		for (; len > 0; name++, comp++, len--) {
+			if (*name == *comp) {
+				continue;
+			}
+			// NOTE: *name == 0 is handled here, since *comp is never 0.
+			uint8_t chr1 = static_cast<uint8_t>(*name);
+			uint8_t chr2 = static_cast<uint8_t>(*comp);
+			if (chr1 >= 'A' && chr1 <= 'Z') chr1 |= 0x20;
+			if (chr2 >= 'A' && chr2 <= 'Z') chr2 |= 0x20;
+			if (chr1 != chr2) {
+				return -1;
+			}
+			ret = 1;
+		}
+		return (*name == '\0') ? ret : -1;
+	}
+
+	/**
+	 * Get an FST entry's name for the path index.
+	 * ASCII names are returned directly from the string table;
+	 * other names are converted to UTF-8 using entry_name.
+	 * @param idx FST entry index. (Must be in range!)
+	 * @param entry_name Function that converts an FST entry's name to UTF-8.
+	 * @return Name, or nullptr if an error occurred.
+	 */
+	template<typename EntryNameFn>
+	const char *index_name(uint32_t idx, const EntryNameFn &entry_name) const
+	{
+		const FstEntry *const fst_entry = &m_entries[idx];
+		const uint32_t offset = be32_to_cpu(fst_entry->file_type_name_offset) & 0xFFFFFF;
+		if (offset >= m_string_table_sz) {
+			// Out of range.
+			return nullptr;
+		}
+
+		// ASCII is the same in cp1252, Shift-JIS, and UTF-8.
+		const char *const str = &m_string_table[offset];
+		for (const char *p = str; *p != '\0'; p++) {
+			if (static_cast<uint8_t>(*p) & 0x80) {
+				// Not ASCII. Use the converted name.
+				return entry_name(fst_entry);
+			}
+		}
+		return str;
+	}
+
+	/**
+	 * Build the path index.
+	 * @param entry_name Function that converts an FST entry's name to UTF-8.
+	 */
+	template<typename EntryNameFn>
+	void build(const EntryNameFn &entry_name)
+	{
+		// NOTE: For the root directory, next_offset is the number of entries.
+		const uint32_t file_count = be32_to_cpu(m_entries[0].root_dir.file_count);
+		m_parent_idx.resize(file_count);
+		m_parent_idx[0] = 0;
+#ifdef HAVE_UNORDERED_MAP_RESERVE
+		m_path_index.reserve(file_count - 1);
+#endif
+
+		// Directory stack.
+		// Entries are processed in order, so the current directory
+		// ends when we reach its next_offset.
+		struct DirInfo {
+			uint32_t idx;		// FST entry index
+			uint32_t next_offset;	// Index *after* the last entry
+			uint32_t hash;		// Path hash
+		};
+		std::vector<DirInfo> dirStack;
+		dirStack.push_back({0, file_count, FNV_OFFSET_BASIS});
+
+		for (uint32_t idx = 1; idx < file_count; idx++) {
+			while (dirStack.size() > 1 && idx >= dirStack.back().next_offset) {
+				dirStack.pop_back();
+			}
+			const DirInfo parent = dirStack.back();
+			m_parent_idx[idx] = parent.idx;
+
+			// NOTE: If the name is invalid, the entry isn't indexed,
+			// but a directory's children still need to be processed.
+			const char *const name = index_name(idx, entry_name);
+			const uint32_t hash = (name)
+				? path_hash(parent.hash, name, strlen(name))
+				: parent.hash;
+			if (name) {
+				m_path_index.emplace(hash, idx);
+			}
+
+			const FstEntry *const fst_entry = &m_entries[idx];
+			if ((be32_to_cpu(fst_entry->file_type_name_offset) >> 24) == 1) {
+				// Make sure the subdirectory is within the parent directory.
+				// This also prevents infinite loops if the FST has weird corruption.
+				uint32_t next_offset = be32_to_cpu(fst_entry->dir.next_offset);
+				if (next_offset <= idx) {
+					next_offset = idx + 1;
+				} else if (next_offset > parent.next_offset) {
+					next_offset = parent.next_offset;
+				}
+				dirStack.push_back({idx, next_offset, hash});
+			}
+		}
+	}
+
+public:
+	/**
+	 * Find a path.
+	 *
+	 * Lookups are case-insensitive for ASCII characters.
+	 * An exact match is preferred over a case-insensitive match.
+	 * If multiple entries match, the first one in the FST is used.
+	 *
+	 * @param path Path. (Relative paths are treated as absolute paths.)
+	 * @param entry_name Function that converts an FST entry's name to UTF-8.
+	 * @return FST entry index (0 for the root directory), or -1 if not found.
+	 */
+	template<typename EntryNameFn>
+	int find(const char *path, const EntryNameFn &entry_name)
+	{
+		if (!path) {
+			// Invalid path.
+			return -1;
+		}
+
+		// Split the path into components and hash it.
+		// NOTE: Empty path components are ignored.
+		std::vector<std::pair<const char*, size_t> > components;
+		uint32_t hash = FNV_OFFSET_BASIS;
+		for (const char *p = path; *p != '\0'; ) {
+			if (*p == '/') {
+				p++;
+				continue;
+			}
+			const char *const comp = p;
+			do {
+				p++;
+			} while (*p != '\0' && *p != '/');
+			const size_t len = static_cast<size_t>(p - comp);
+			hash = path_hash(hash, comp, len);
+			components.emplace_back(comp, len);
+		}
+		if (components.empty()) {
+			// Empty path or "/".
+			// Return the root directory.
+			return 0;
+		}
+
+		if (m_parent_idx.empty()) {
+			// Build the path index.
+			build(entry_name);
+		}
+
+		// Check all entries with a matching hash.
+		// Hash collisions are resolved by walking up the parent
+		// directories and comparing each path component.
+		uint32_t found_idx = ~0U;
+		bool found_exact = false;
+		const auto range = m_path_index.equal_range(hash);
+		for (auto iter = range.first; iter != range.second; ++iter) {
+			const uint32_t idx = iter->second;
+			uint32_t cur_idx = idx;
+			bool exact = true;
+			bool match = true;
+			for (auto comp = components.crbegin(); comp != components.crend(); ++comp) {
+				const char *const name = (cur_idx != 0) ? index_name(cur_idx, entry_name) : nullptr;
+				const int cmp = (name) ? compare_name(name, comp->first, comp->second) : -1;
+				if (cmp < 0) {
+					match = false;
+					break;
+				}
+				exact &= (cmp == 0);
+				cur_idx = m_parent_idx[cur_idx];
+			}
+			if (!match || cur_idx != 0) {
+				// Not a match.
+				continue;
+			}
+
+			if (exact > found_exact || (exact == found_exact && idx < found_idx)) {
+				found_idx = idx;
+				found_exact = exact;
+			}
+		}
+
+		return (found_idx != ~0U) ? static_cast<int>(found_idx) : -1;
+	}
+
+private:
+	const FstEntry *const m_entries;
+	const char *const m_string_table;
+	const uint32_t m_string_table_sz;
+
+	// Path index
+	// - Key: Hash of the full path (see path_hash())
+	// - Value: FST entry index
+	std::unordered_multimap<uint32_t, uint32_t> m_path_index;
+	// Parent directory index for each FST entry.
+	// Used to verify path index matches.
+	std::vector<uint32_t> m_parent_idx;
+};
+
+}
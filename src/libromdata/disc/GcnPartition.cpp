@@ -127,6 +127,28 @@ off64_t GcnPartition::size(void)
 	return d->data_size;
 }
 
+/** Access pattern hints **/
+
+/**
+ * Tell the OS how a range of the partition will be accessed.
+ * @param pos	[in] Start position.
+ * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+ * @param hint	[in] Access hint.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int GcnPartition::advise(off64_t pos, off64_t size, AccessHint hint)
+{
+	RP_D(const GcnPartition);
+	if (!m_file) {
+		return -EBADF;
+	} else if (pos < 0 || size < 0) {
+		return -EINVAL;
+	}
+
+	// GCN partitions are stored as-is.
+	return m_file->advise(d->data_offset + pos, size, hint);
+}
+
 /** IPartition **/
 
 /**
@@ -73,6 +73,18 @@ public:
 	 */
 	off64_t size(void) final;
 
+public:
+	/** Access pattern hints **/
+
+	/**
+	 * Tell the OS how a range of the partition will be accessed.
+	 * @param pos	[in] Start position.
+	 * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+	 * @param hint	[in] Access hint.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int advise(off64_t pos, off64_t size, AccessHint hint) override;
+
 public:
 	/** IPartition **/
 
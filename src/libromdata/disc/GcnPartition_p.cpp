@@ -135,7 +135,11 @@ int GcnPartitionPrivate::loadFst(void)
 	}
 
 	// Seek to the beginning of the FST.
-	ret = q->seek(static_cast<off64_t>(bootBlock.fst_offset) << offsetShift);
+	// The entire FST is read at once, so let the OS start reading it now.
+	const off64_t fstData_pos = static_cast<off64_t>(bootBlock.fst_offset) << offsetShift;
+	const uint32_t fstData_len = bootBlock.fst_size << offsetShift;
+	q->advise(fstData_pos, fstData_len, LibRpFile::IRpFile::AH_WILLNEED);
+	ret = q->seek(fstData_pos);
 	if (ret != 0) {
 		// Seek failed.
 		return -q->m_lastError;
@@ -143,7 +147,6 @@ int GcnPartitionPrivate::loadFst(void)
 
 	// Read the FST.
 	// TODO: Eliminate the extra copy?
-	const uint32_t fstData_len = bootBlock.fst_size << offsetShift;
 	uint8_t *const fstData = new uint8_t[fstData_len];
 	size_t size = q->read(fstData, fstData_len);
 	if (size != fstData_len) {
@@ -156,6 +159,8 @@ int GcnPartitionPrivate::loadFst(void)
 	// Create the GcnFst.
 	GcnFst *const gcnFst = new GcnFst(fstData, fstData_len, offsetShift);
 	delete[] fstData;	// TODO: Eliminate the extra copy?
+	// The FST is only read once, so its pages aren't needed anymore.
+	q->advise(fstData_pos, fstData_len, LibRpFile::IRpFile::AH_DONTNEED);
 	if (gcnFst->hasErrors()) {
 		// FST has errors.
 		delete gcnFst;
@@ -24,6 +24,11 @@
 #  include "libwin32common/DelayLoadHelper.h"
 #endif /* _MSC_VER */
 
+// librpthreads
+#include "librpthreads/Mutex.hpp"
+using LibRpThreads::Mutex;
+using LibRpThreads::MutexLocker;
+
 // Other rom-properties libraries
 using namespace LibRpBase;
 using namespace LibRpFile;
@@ -54,13 +59,13 @@ public:
 	rp::uvector<uint64_t> blockPointers;
 	rp::uvector<uint32_t> hashes;
 
-	// Decompression buffer
-	// (Same size as blockCache)
-	rp::uvector<uint8_t> z_buffer;
+	// Block buffer for partial block reads
+	// NOTE: Blocks are cached by SparseDiscReader.
+	rp::uvector<uint8_t> blockBuf;
 
-	// Block cache
-	rp::uvector<uint8_t> blockCache;
-	uint32_t blockCacheIdx;
+	// Mutex for blockBuf.
+	// readBlock() may be called concurrently via readAt().
+	Mutex blockBufMutex;
 
 	// Starting offset of the data area
 	// This offset must be added to the blockPointers value
@@ -78,11 +83,16 @@ public:
 
 GczReaderPrivate::GczReaderPrivate(GczReader *q)
 	: super(q)
-	, blockCacheIdx(~0U)
 	, dataOffset(0)
 {
 	// Clear the GCZ header struct.
 	memset(&gczHeader, 0, sizeof(gczHeader));
+
+	// Each block is compressed separately, and full blocks
+	// can be decompressed concurrently.
+	wholeBlocks = true;
+	parallelBlocks = true;
+	physBlockAddrs = true;
 }
 
 /**
@@ -260,11 +270,12 @@ GczReader::GczReader(const IRpFilePtr &file)
 	}
 	d->dataOffset = static_cast<uint32_t>(pos);
 
-	// Initialize the block cache and decompression buffer.
+	// The block pointers and hashes are only read once.
+	m_file->advise(sizeof(d->gczHeader), pos - sizeof(d->gczHeader), IRpFile::AH_DONTNEED);
+
+	// Initialize the block buffer.
 	// NOTE: Extra 64 bytes is for zlib, in case it needs it.
-	d->blockCache.resize(d->block_size + 64);
-	d->z_buffer.resize(d->block_size + 64);
-	d->blockCacheIdx = ~0U;
+	d->blockBuf.resize(d->block_size + 64);
 
 	// Reset the disc position.
 	d->pos = 0;
@@ -404,12 +415,46 @@ int GczReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 		return 0;
 	}
 
-	if (blockIdx == d->blockCacheIdx) {
-		// Block is cached.
-		memcpy(ptr, &d->blockCache[pos], size);
+	if (pos != 0 || size != d->block_size) {
+		// Partial block. Read the full block into the block buffer.
+		MutexLocker blockBufLocker(d->blockBufMutex);
+		const int rd = readBlock(blockIdx, 0, d->blockBuf.data(), d->block_size);
+		if (rd != static_cast<int>(d->block_size)) {
+			// Error reading the block.
+			return rd;
+		}
+		memcpy(ptr, &d->blockBuf[pos], size);
 		return static_cast<int>(size);
 	}
 
+	// Full block. Decompress it directly into the output buffer.
+	const int ret = readFullBlock(blockIdx, ptr);
+	if (ret != 0) {
+		m_lastError = -ret;
+		return 0;
+	}
+	return static_cast<int>(size);
+}
+
+/**
+ * Read a full block. (thread-safe)
+ *
+ * If parallelBlocks is set in the private class, this is used
+ * to read multiple full blocks in parallel. It may be called
+ * concurrently from multiple threads, so it must not modify
+ * any shared state, including m_lastError and m_file.
+ *
+ * @param blockIdx	[in] Block index.
+ * @param ptr		[out] Output data buffer. (Must be block_size bytes!)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int GczReader::readFullBlock(uint32_t blockIdx, void *ptr)
+{
+	// NOTE: No shared buffers are used here, so multiple
+	// full blocks can be read concurrently.
+	RP_D(GczReader);
+	uint8_t *const blockBuf = static_cast<uint8_t*>(ptr);
+
 	// NOTE: If this is the last block, then we might have
 	// a short read. We'll allow it.
 	const bool isLastBlock = (blockIdx + 1 == d->blockPointers.size());
@@ -420,8 +465,7 @@ int GczReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 	const uint32_t z_block_size = d->getBlockCompressedSize(blockIdx);
 	if (z_block_size == 0) {
 		// Unable to get the block's compressed size...
-		m_lastError = EIO;
-		return 0;
+		return -EIO;
 	}
 
 	const bool compressed = (!(blockPointer & GCZ_FLAG_BLOCK_NOT_COMPRESSED));
@@ -429,62 +473,55 @@ int GczReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 		// (Un)compressed block size must match the actual block size.
 		if (z_block_size != d->block_size) {
 			// Error...
-			m_lastError = EIO;
-			return 0;
+			return -EIO;
 		}
 	}
 
 	if (!compressed) {
-		// Reading uncompressed data directly into the cache.
+		// Reading uncompressed data directly into the output buffer.
 		if (isLastBlock) {
-			memset(d->blockCache.data(), 0, d->blockCache.size());
+			memset(blockBuf, 0, d->block_size);
 		}
 
-		size_t sz_read = m_file->seekAndRead(physBlockAddr, d->blockCache.data(), z_block_size);
+		size_t sz_read = d->readFileAt(physBlockAddr, blockBuf, z_block_size);
 		if (sz_read != z_block_size && !isLastBlock) {
 			// Seek and/or read error.
-			d->blockCacheIdx = ~0U;
-			m_lastError = m_file->lastError();
-			if (m_lastError == 0) {
-				m_lastError = EIO;
-			}
-			return 0;
+			// NOTE: m_file->lastError() can't be used here,
+			// since other threads may be reading the file.
+			return -EIO;
 		}
-		d->blockCacheIdx = blockIdx;
 	} else {
 		// Read compressed data into a temporary buffer,
 		// then decompress it.
 		if (z_block_size > d->block_size) {
 			// Compressed data is larger than the uncompressed block size...
-			m_lastError = EIO;
-			return 0;
+			return -EIO;
 		}
 
-		size_t sz_read = m_file->seekAndRead(physBlockAddr, d->z_buffer.data(), z_block_size);
+		// NOTE: Extra 64 bytes is for zlib, in case it needs it.
+		rp::uvector<uint8_t> z_buffer(z_block_size + 64);
+		size_t sz_read = d->readFileAt(physBlockAddr, z_buffer.data(), z_block_size);
 		if (sz_read != z_block_size) {
 			// Seek and/or read error.
-			m_lastError = m_file->lastError();
-			if (m_lastError == 0) {
-				m_lastError = EIO;
-			}
-			return 0;
+			// NOTE: m_file->lastError() can't be used here,
+			// since other threads may be reading the file.
+			return -EIO;
 		}
 
 		// Verify the hash of the *compressed* data.
 		uint32_t hash_calc = adler32(0L, Z_NULL, 0);
-		hash_calc = adler32(hash_calc, d->z_buffer.data(), z_block_size);
+		hash_calc = adler32(hash_calc, z_buffer.data(), z_block_size);
 		if (hash_calc != le32_to_cpu(d->hashes[blockIdx])) {
 			// Hash error.
 			// TODO: Print warnings and/or more comprehensive error codes.
-			m_lastError = EIO;
-			return 0;
+			return -EIO;
 		}
 
 		// Decompress the data.
 		z_stream z = { };
-		z.next_in = d->z_buffer.data();
+		z.next_in = z_buffer.data();
 		z.avail_in = z_block_size;
-		z.next_out = d->blockCache.data();
+		z.next_out = blockBuf;
 		z.avail_out = d->block_size;
 		inflateInit(&z);
 
@@ -495,16 +532,12 @@ int GczReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 		if (status != Z_STREAM_END || uncomp_size != d->block_size) {
 			// Decompression error.
 			// TODO: Print warnings and/or more comprehensive error codes.
-			d->blockCacheIdx = ~0U;
-			m_lastError = EIO;
-			return 0;
+			return -EIO;
 		}
 	}
 
-	// Block has been loaded into the cache.
-	memcpy(ptr, &d->blockCache[pos], size);
-	d->blockCacheIdx = blockIdx;
-	return static_cast<int>(size);
+	// Block has been loaded.
+	return 0;
 }
 
 }
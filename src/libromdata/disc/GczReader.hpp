@@ -76,6 +76,20 @@ protected:
 	 */
 	ATTR_ACCESS_SIZE(write_only, 4, 5)
 	int readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size) final;
+
+	/**
+	 * Read a full block. (thread-safe)
+	 *
+	 * If parallelBlocks is set in the private class, this is used
+	 * to read multiple full blocks in parallel. It may be called
+	 * concurrently from multiple threads, so it must not modify
+	 * any shared state, including m_lastError and m_file.
+	 *
+	 * @param blockIdx	[in] Block index.
+	 * @param ptr		[out] Output data buffer. (Must be block_size bytes!)
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int readFullBlock(uint32_t blockIdx, void *ptr) final;
 };
 
 }
@@ -97,6 +97,17 @@ public:
 	 * @return 0 on success; non-zero on error.
 	 */
 	int getTrackLBAInfo(int trackNumber, unsigned int &lba_start, unsigned int &lba_size);
+
+	/**
+	 * Find the block range that contains the specified block.
+	 * The track will be opened if it isn't open already.
+	 * @param blockIdx Block index
+	 * @return Block range, or nullptr if not found.
+	 */
+	const BlockRange *findBlockRange(uint32_t blockIdx);
+
+	// Maximum number of raw sectors to read at once
+	static constexpr unsigned int RAW_SECTORS_MAX = 64;
 };
 
 /** GdiReaderPrivate **/
@@ -352,6 +363,43 @@ int GdiReaderPrivate::getTrackLBAInfo(int trackNumber, unsigned int &lba_start,
 	return 0;
 }
 
+/**
+ * Find the block range that contains the specified block.
+ * The track will be opened if it isn't open already.
+ * @param blockIdx Block index
+ * @return Block range, or nullptr if not found.
+ */
+const GdiReaderPrivate::BlockRange *GdiReaderPrivate::findBlockRange(uint32_t blockIdx)
+{
+	// TODO: Cache this lookup somewhere or something.
+	for (const BlockRange &vbr : blockRanges) {
+		if (blockIdx < vbr.blockStart) {
+			// Not in this track.
+			continue;
+		}
+
+		// Is the track loaded?
+		if (vbr.blockEnd == 0) {
+			// Track isn't loaded. Load it.
+			int ret = openTrack(vbr.trackNumber);
+			if (ret != 0) {
+				// Unable to load the track.
+				// Skip for now.
+				continue;
+			}
+		}
+
+		// Check the end block.
+		if (vbr.blockEnd != 0 && blockIdx <= vbr.blockEnd) {
+			// Found the track.
+			return &vbr;
+		}
+	}
+
+	// Not found in any block range.
+	return nullptr;
+}
+
 /** GdiReader **/
 
 GdiReader::GdiReader(const IRpFilePtr &file)
@@ -566,33 +614,7 @@ int GdiReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 	}
 
 	// Find the block.
-	// TODO: Cache this lookup somewhere or something.
-	const GdiReaderPrivate::BlockRange *blockRange = nullptr;
-	for (const GdiReaderPrivate::BlockRange &vbr : d->blockRanges) {
-		if (blockIdx < vbr.blockStart) {
-			// Not in this track.
-			continue;
-		}
-
-		// Is the track loaded?
-		if (vbr.blockEnd == 0) {
-			// Track isn't loaded. Load it.
-			int ret = d->openTrack(vbr.trackNumber);
-			if (ret != 0) {
-				// Unable to load the track.
-				// Skip for now.
-				continue;
-			}
-		}
-
-		// Check the end block.
-		if (vbr.blockEnd != 0 && blockIdx <= vbr.blockEnd) {
-			// Found the track.
-			blockRange = (const GdiReaderPrivate::BlockRange*)&vbr;
-			break;
-		}
-	}
-
+	const GdiReaderPrivate::BlockRange *const blockRange = d->findBlockRange(blockIdx);
 	if (!blockRange) {
 		// Not found in any block range.
 		return 0;
@@ -610,7 +632,7 @@ int GdiReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 		// 2352-byte sectors.
 		// TODO: Handle audio tracks properly?
 		CDROM_2352_Sector_t sector;
-		size_t sz_read = blockRange->file->seekAndRead(phys_pos, &sector, sizeof(sector));
+		size_t sz_read = blockRange->file->readAt(phys_pos, &sector, sizeof(sector));
 		m_lastError = blockRange->file->lastError();
 		if (sz_read != sizeof(sector)) {
 			// Read error.
@@ -624,10 +646,79 @@ int GdiReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
 	}
 
 	// 2048-byte sectors.
-	size_t sz_read = blockRange->file->seekAndRead(phys_pos, ptr, size);
+	size_t sz_read = blockRange->file->readAt(phys_pos, ptr, size);
 	return (sz_read > 0 ? static_cast<int>(sz_read) : -1);
 }
 
+/**
+ * Read multiple full blocks.
+ *
+ * Each track's sectors are read with a single file read,
+ * and then the user data is copied to the output buffer.
+ *
+ * @param blockIdx	[in] First block index.
+ * @param count		[in] Number of blocks to read.
+ * @param ptr		[out] Output data buffer. (Must be at least count * block_size bytes!)
+ * @return Number of full blocks read. (Less than count on error.)
+ */
+unsigned int GdiReader::readBlocks(uint32_t blockIdx, unsigned int count, void *ptr)
+{
+	RP_D(GdiReader);
+	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
+	unsigned int ret = 0;
+
+	// Raw sector buffer
+	// NOTE: Allocated by the first track with 2352-byte sectors.
+	rp::uvector<uint8_t> rawBuf;
+
+	while (count > 0 && blockIdx < d->blockCount) {
+		// Find the block.
+		const GdiReaderPrivate::BlockRange *const blockRange = d->findBlockRange(blockIdx);
+		if (!blockRange || !blockRange->file) {
+			// Not found in any block range, or the file isn't open.
+			break;
+		}
+
+		// Don't read past the end of the track.
+		unsigned int n = std::min(count, blockRange->blockEnd - blockIdx + 1);
+		const off64_t phys_pos = (static_cast<off64_t>(blockIdx - blockRange->blockStart) * blockRange->sectorSize);
+		unsigned int n_read;
+		if (blockRange->sectorSize == 2352) {
+			// 2352-byte sectors.
+			// TODO: Handle audio tracks properly?
+			n = std::min(n, static_cast<unsigned int>(GdiReaderPrivate::RAW_SECTORS_MAX));
+			const size_t raw_size = static_cast<size_t>(n) * 2352;
+			if (rawBuf.size() < raw_size) {
+				rawBuf.resize(raw_size);
+			}
+			const size_t sz_read = blockRange->file->readAt(phys_pos, rawBuf.data(), raw_size);
+			m_lastError = blockRange->file->lastError();
+
+			// NOTE: Sector user data area position depends on the sector mode.
+			n_read = static_cast<unsigned int>(sz_read / 2352);
+			const CDROM_2352_Sector_t *sector = reinterpret_cast<const CDROM_2352_Sector_t*>(rawBuf.data());
+			for (unsigned int i = 0; i < n_read; i++, sector++, ptr8 += 2048) {
+				memcpy(ptr8, cdromSectorDataPtr(sector), 2048);
+			}
+		} else {
+			// 2048-byte sectors.
+			const size_t sz_read = blockRange->file->readAt(phys_pos, ptr8, static_cast<size_t>(n) * 2048);
+			n_read = static_cast<unsigned int>(sz_read / 2048);
+			ptr8 += static_cast<size_t>(n_read) * 2048;
+		}
+
+		ret += n_read;
+		if (n_read != n) {
+			// Read error.
+			break;
+		}
+		blockIdx += n;
+		count -= n;
+	}
+
+	return ret;
+}
+
 /** GDI-specific functions **/
 // TODO: "CdromReader" class?
 
@@ -18,6 +18,7 @@ using namespace LibRpText;
 // C++ STL classes
 using std::string;
 using std::unordered_map;
+using std::unordered_multimap;
 
 namespace LibRomData {
 
@@ -39,13 +40,55 @@ public:
 	// ISO primary volume descriptor
 	ISO_Primary_Volume_Descriptor pvd;
 
-	// Directories
-	// - Key: Directory name, WITHOUT leading slash. (Root == empty string) [cp1252]
-	// - Value: Directory entries.
+	// Directory data.
 	// NOTE: Directory entries are variable-length, so this
 	// is a byte array, not an ISO_DirEntry array.
 	typedef rp::uvector<uint8_t> DirData_t;
-	unordered_map<string, DirData_t> dir_data;
+
+	// Cached directory
+	struct Directory {
+		DirData_t data;		// Directory entries
+
+		// Filename index
+		// - Key: Filename hash (see filename_hash())
+		// - Value: Offset of the directory entry in data
+		// Filenames with ";1" are indexed both with and without ";1".
+		unordered_multimap<uint32_t, uint32_t> name_index;
+
+		size_t cost;		// Approximate memory usage, in bytes
+		uint64_t lastUsed;	// dir_lru_counter value when this directory was last used
+	};
+
+	// Directories
+	// - Key: Directory name, WITHOUT leading slash. (Root == empty string) [cp1252]
+	// - Value: Directory
+	unordered_map<string, Directory> dir_data;
+	size_t dir_data_cost;		// Total cost of all directories in dir_data
+	uint64_t dir_lru_counter;
+
+	// Maximum memory usage for dir_data.
+	// The least-recently used directories are evicted if this is exceeded.
+	// NOTE: The root directory and the most recently loaded
+	// directory are never evicted.
+	static constexpr size_t DIR_CACHE_MAX_COST = 1024U * 1024U;
+
+	// Maximum directory size
+	static constexpr unsigned int DIR_SIZE_MAX = 16U * 1024U * 1024U;
+
+	// Path table (L), used by prefetchDirectories()
+	// Loaded on demand.
+	DirData_t path_table;
+	bool path_table_loaded;
+
+	// Maximum path table size
+	static constexpr unsigned int PATH_TABLE_SIZE_MAX = 256U * 1024U;
+
+	// Prefetched directory extents (see prefetchDirectories())
+	off64_t prefetch_addr;
+	DirData_t prefetch_buf;
+
+	// Maximum number of blocks to prefetch at once
+	static constexpr unsigned int PREFETCH_BLOCKS_MAX = 64;
 
 	// ISO start offset (in blocks)
 	// -1 == unknown
@@ -68,6 +111,21 @@ public:
 		return (sl ? sl : bs);
 	}
 
+	/**
+	 * Hash a filename for the filename index.
+	 * Hashing is case-insensitive. (ASCII only)
+	 * @param filename Filename [cp1252]
+	 * @param len Length of filename
+	 * @return Filename hash
+	 */
+	static uint32_t filename_hash(const char *filename, size_t len);
+
+	/**
+	 * Build a directory's filename index.
+	 * @param dir Directory
+	 */
+	void buildNameIndex(Directory &dir) const;
+
 	/**
 	 * Look up a directory entry from a base filename and directory.
 	 * @param pDir		[in] Directory
@@ -75,7 +133,14 @@ public:
 	 * @param bFindDir	[in] True to find a subdirectory; false to find a file.
 	 * @return ISO directory entry.
 	 */
-	const ISO_DirEntry *lookup_int(const DirData_t *pDir, const char *filename, bool bFindDir);
+	const ISO_DirEntry *lookup_int(const Directory *pDir, const char *filename, bool bFindDir);
+
+	/**
+	 * Evict least-recently used directories until
+	 * dir_data is within DIR_CACHE_MAX_COST.
+	 * @param keep Directory to keep. (The root directory is always kept.)
+	 */
+	void evictDirectories(const string &keep);
 
 	/**
 	 * Get a directory.
@@ -83,7 +148,24 @@ public:
 	 * @param pError	[out] POSIX error code on error.
 	 * @return Directory on success; nullptr on error.
 	 */
-	const DirData_t *getDirectory(const char *path, int *pError = nullptr);
+	const Directory *getDirectory(const char *path, int *pError = nullptr);
+
+	/**
+	 * Load the path table.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int loadPathTable(void);
+
+	/**
+	 * Prefetch the uncached directories in a path.
+	 *
+	 * The directories are located using the path table, and all
+	 * of their extents are read at once if they're close together.
+	 * getDirectory() will use the prefetched data if possible.
+	 *
+	 * @param path Pathname [cp1252]
+	 */
+	void prefetchDirectories(const char *path);
 
 	/**
 	 * Look up a directory entry from a filename.
@@ -107,6 +189,10 @@ IsoPartitionPrivate::IsoPartitionPrivate(IsoPartition *q,
 	: q_ptr(q)
 	, partition_offset(partition_offset)
 	, partition_size(0)
+	, dir_data_cost(0)
+	, dir_lru_counter(0)
+	, path_table_loaded(false)
+	, prefetch_addr(0)
 	, iso_start_offset(iso_start_offset)
 {
 	// Clear the PVD struct.
@@ -150,6 +236,82 @@ IsoPartitionPrivate::IsoPartitionPrivate(IsoPartition *q,
 	getDirectory("/");
 }
 
+/**
+ * Hash a filename for the filename index.
+ * Hashing is case-insensitive. (ASCII only)
+ * @param filename Filename [cp1252]
+ * @param len Length of filename
+ * @return Filename hash
+ */
+uint32_t IsoPartitionPrivate::filename_hash(const char *filename, size_t len)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261U;
+	for (; len > 0; filename++, len--) {
+		uint8_t chr = static_cast<uint8_t>(*filename);
+		if (chr >= 'a' && chr <= 'z') {
+			chr &= ~0x20;
+		}
+		hash = (hash ^ chr) * 16777619U;
+	}
+	return hash;
+}
+
+/**
+ * Build a directory's filename index.
+ * @param dir Directory
+ */
+void IsoPartitionPrivate::buildNameIndex(Directory &dir) const
+{
+	// Block size.
+	// Should be 2048, but other values are possible.
+	const unsigned int block_size = pvd.logical_block_size.he;
+
+	const uint8_t *const p_start = dir.data.data();
+	const size_t dir_size = dir.data.size();
+	size_t pos = 0;
+	while (pos + sizeof(ISO_DirEntry) <= dir_size) {
+		const ISO_DirEntry *const dirEntry = reinterpret_cast<const ISO_DirEntry*>(&p_start[pos]);
+		if (dirEntry->entry_length == 0) {
+			// Directory entries can't cross block boundaries,
+			// so the rest of this block is empty.
+			if (block_size == 0) {
+				break;
+			}
+			pos = ((pos / block_size) + 1) * block_size;
+			continue;
+		} else if (dirEntry->entry_length < sizeof(*dirEntry)) {
+			// Invalid directory entry.
+			break;
+		}
+
+		const char *const entry_filename = reinterpret_cast<const char*>(dirEntry) + sizeof(*dirEntry);
+		const size_t entry_filename_len = dirEntry->filename_length;
+		if (pos + sizeof(*dirEntry) + entry_filename_len > dir_size) {
+			// Filename is out of bounds.
+			break;
+		}
+
+		const uint32_t offset = static_cast<uint32_t>(pos);
+		dir.name_index.emplace(filename_hash(entry_filename, entry_filename_len), offset);
+		if (entry_filename_len > 2 &&
+		    entry_filename[entry_filename_len-2] == ';' &&
+		    entry_filename[entry_filename_len-1] == '1')
+		{
+			// Also index the filename without ";1".
+			dir.name_index.emplace(filename_hash(entry_filename, entry_filename_len - 2), offset);
+		}
+
+		// Next entry.
+		pos += dirEntry->entry_length;
+	}
+
+	// Approximate memory usage: Directory data, plus
+	// one node and one bucket per filename index entry.
+	dir.cost = dir_size + (dir.name_index.size() *
+		(sizeof(std::pair<const uint32_t, uint32_t>) + (sizeof(void*) * 3)));
+}
+
 /**
  * Look up a directory entry from a base filename and directory.
  * @param pDir		[in] Directory
@@ -157,72 +319,87 @@ IsoPartitionPrivate::IsoPartitionPrivate(IsoPartition *q,
  * @param bFindDir	[in] True to find a subdirectory; false to find a file.
  * @return ISO directory entry.
  */
-const ISO_DirEntry *IsoPartitionPrivate::lookup_int(const DirData_t *pDir, const char *filename, bool bFindDir)
+const ISO_DirEntry *IsoPartitionPrivate::lookup_int(const Directory *pDir, const char *filename, bool bFindDir)
 {
 	// Find the file in the directory.
 	// NOTE: Filenames are case-insensitive.
 	// NOTE: File might have a ";1" suffix.
-	int err = ENOENT;
-	const unsigned int filename_len = static_cast<unsigned int>(strlen(filename));
-	const ISO_DirEntry *dirEntry_found = nullptr;
-	const uint8_t *p = pDir->data();
-	const uint8_t *const p_end = p + pDir->size();
-	while (p < p_end) {
-		const ISO_DirEntry *dirEntry = reinterpret_cast<const ISO_DirEntry*>(p);
-		if (dirEntry->entry_length < sizeof(*dirEntry)) {
-			// End of directory.
-			break;
-		}
-
-		const char *const entry_filename = reinterpret_cast<const char*>(p) + sizeof(*dirEntry);
-		if (entry_filename + dirEntry->filename_length > reinterpret_cast<const char*>(p_end)) {
-			// Filename is out of bounds.
-			break;
-		}
-
-		// Check the filename.
-		// 1990s and early 2000s CD-ROM games usually have
-		// ";1" filenames, so check for that first.
+	// 1990s and early 2000s CD-ROM games usually have
+	// ";1" filenames, so the filename index has both versions.
+	// TODO: Also allow other version numbers?
+	const size_t filename_len = strlen(filename);
+	const uint8_t *const p_start = pDir->data.data();
+
+	// If multiple entries match, use the first one in the directory.
+	uint32_t found_offset = ~0U;
+	const auto range = pDir->name_index.equal_range(filename_hash(filename, filename_len));
+	for (auto iter = range.first; iter != range.second; ++iter) {
+		const ISO_DirEntry *const dirEntry = reinterpret_cast<const ISO_DirEntry*>(&p_start[iter->second]);
+		const char *const entry_filename = reinterpret_cast<const char*>(dirEntry) + sizeof(*dirEntry);
 		if (dirEntry->filename_length == filename_len + 2) {
 			// +2 length match.
 			// This might have ";1".
-			if (!strncasecmp(entry_filename, filename, filename_len)) {
-				// Check for ";1".
-				// TODO: Also allow other version numbers?
-				if (entry_filename[filename_len]   == ';' &&
-				    entry_filename[filename_len+1] == '1')
-				{
-					// Found it!
-					// Verify directory vs. file.
-					const bool isDir = !!(dirEntry->flags & ISO_FLAG_DIRECTORY);
-					if (isDir == bFindDir) {
-						// Directory attribute matches.
-						dirEntry_found = dirEntry;
-					} else {
-						// Not a match.
-						err = (isDir ? EISDIR : ENOTDIR);
-					}
-					break;
-				}
-			}
-		} else if (dirEntry->filename_length == filename_len) {
-			// Exact length match.
-			if (!strncasecmp(entry_filename, filename, filename_len)) {
-				// Found it!
-				dirEntry_found = dirEntry;
-				break;
+			if (entry_filename[filename_len] != ';' || entry_filename[filename_len+1] != '1') {
+				continue;
 			}
+		} else if (dirEntry->filename_length != filename_len) {
+			continue;
 		}
 
-		// Next entry.
-		p += dirEntry->entry_length;
+		if (!strncasecmp(entry_filename, filename, filename_len)) {
+			// Found a match.
+			found_offset = std::min(found_offset, iter->second);
+		}
 	}
 
-	if (!dirEntry_found) {
-		RP_Q(IsoPartition);
-		q->m_lastError = err;
+	RP_Q(IsoPartition);
+	if (found_offset == ~0U) {
+		// Not found.
+		q->m_lastError = ENOENT;
+		return nullptr;
+	}
+
+	const ISO_DirEntry *const dirEntry = reinterpret_cast<const ISO_DirEntry*>(&p_start[found_offset]);
+	if (dirEntry->filename_length == filename_len + 2) {
+		// Filename has ";1".
+		// Verify directory vs. file.
+		const bool isDir = !!(dirEntry->flags & ISO_FLAG_DIRECTORY);
+		if (isDir != bFindDir) {
+			// Not a match.
+			q->m_lastError = (isDir ? EISDIR : ENOTDIR);
+			return nullptr;
+		}
+	}
+
+	return dirEntry;
+}
+
+/**
+ * Evict least-recently used directories until
+ * dir_data is within DIR_CACHE_MAX_COST.
+ * @param keep Directory to keep. (The root directory is always kept.)
+ */
+void IsoPartitionPrivate::evictDirectories(const string &keep)
+{
+	while (dir_data_cost > DIR_CACHE_MAX_COST) {
+		auto lru = dir_data.end();
+		for (auto iter = dir_data.begin(); iter != dir_data.end(); ++iter) {
+			if (iter->first.empty() || iter->first == keep) {
+				// Don't evict this directory.
+				continue;
+			}
+			if (lru == dir_data.end() || iter->second.lastUsed < lru->second.lastUsed) {
+				lru = iter;
+			}
+		}
+		if (lru == dir_data.end()) {
+			// Nothing left to evict.
+			break;
+		}
+
+		dir_data_cost -= lru->second.cost;
+		dir_data.erase(lru);
 	}
-	return dirEntry_found;
 }
 
 /**
@@ -231,7 +408,7 @@ const ISO_DirEntry *IsoPartitionPrivate::lookup_int(const DirData_t *pDir, const
  * @param pError	[out] POSIX error code on error.
  * @return Directory on success; nullptr on error.
  */
-const IsoPartitionPrivate::DirData_t *IsoPartitionPrivate::getDirectory(const char *path, int *pError)
+const IsoPartitionPrivate::Directory *IsoPartitionPrivate::getDirectory(const char *path, int *pError)
 {
 	RP_Q(IsoPartition);
 	if (!path || !strcmp(path, "/")) {
@@ -240,9 +417,11 @@ const IsoPartitionPrivate::DirData_t *IsoPartitionPrivate::getDirectory(const ch
 	}
 
 	// Check if this directory was already loaded.
-	auto iter = dir_data.find(path);
+	const string s_path(path);
+	auto iter = dir_data.find(s_path);
 	if (iter != dir_data.end()) {
 		// Directory is already loaded.
+		iter->second.lastUsed = ++dir_lru_counter;
 		return &iter->second;
 	}
 
@@ -267,14 +446,14 @@ const IsoPartitionPrivate::DirData_t *IsoPartitionPrivate::getDirectory(const ch
 	const unsigned int block_size = pvd.logical_block_size.he;
 
 	// Determine the directory size and address.
-	DirData_t dir;
+	Directory dir;
 	off64_t dir_addr;
 	if (path[0] == '\0') {
 		// Loading the root directory.
 
 		// Check the root directory entry.
 		const ISO_DirEntry *const rootdir = &pvd.dir_entry_root;
-		if (rootdir->size.he > 16*1024*1024) {
+		if (rootdir->size.he > DIR_SIZE_MAX) {
 			// Root directory is too big.
 			q->m_lastError = EIO;
 			if (pError) {
@@ -310,11 +489,11 @@ const IsoPartitionPrivate::DirData_t *IsoPartitionPrivate::getDirectory(const ch
 			iso_start_offset = static_cast<int>(rootdir->block.he - 20);
 		}
 
-		dir.resize(rootdir->size.he);
+		dir.data.resize(rootdir->size.he);
 		dir_addr = partition_offset + static_cast<off64_t>(rootdir->block.he - iso_start_offset) * block_size;
 	} else {
 		// Get the parent directory.
-		const DirData_t *pDir;
+		const Directory *pDir;
 		const char *const sl = findLastSlash(path);
 		if (!sl) {
 			// No slash. Parent is root.
@@ -340,32 +519,188 @@ const IsoPartitionPrivate::DirData_t *IsoPartitionPrivate::getDirectory(const ch
 			return nullptr;
 		}
 
-		dir.resize(entry->size.he);
+		if (entry->size.he > DIR_SIZE_MAX) {
+			// Directory is too big.
+			q->m_lastError = EIO;
+			if (pError) {
+				*pError = EIO;
+			}
+			return nullptr;
+		}
+
+		dir.data.resize(entry->size.he);
 		dir_addr = partition_offset + static_cast<off64_t>(entry->block.he - iso_start_offset) * block_size;
 	}
 
 	// Load the directory.
 	// NOTE: Due to variable-length entries, we need to load
 	// the entire directory all at once.
-	size_t size = q->m_file->seekAndRead(dir_addr, dir.data(), dir.size());
-	if (size != dir.size()) {
-		// Seek and/or read error.
-		dir.clear();
-		q->m_lastError = q->m_file->lastError();
-		if (q->m_lastError == 0) {
-			q->m_lastError = EIO;
-		}
-		if (pError) {
-			*pError = q->m_lastError;
+	if (!prefetch_buf.empty() && dir_addr >= prefetch_addr &&
+	    dir_addr + static_cast<off64_t>(dir.data.size()) <= prefetch_addr + static_cast<off64_t>(prefetch_buf.size()))
+	{
+		// Directory was prefetched.
+		memcpy(dir.data.data(), &prefetch_buf[static_cast<size_t>(dir_addr - prefetch_addr)], dir.data.size());
+	} else {
+		size_t size = q->m_file->seekAndRead(dir_addr, dir.data.data(), dir.data.size());
+		if (size != dir.data.size()) {
+			// Seek and/or read error.
+			q->m_lastError = q->m_file->lastError();
+			if (q->m_lastError == 0) {
+				q->m_lastError = EIO;
+			}
+			if (pError) {
+				*pError = q->m_lastError;
+			}
+			return nullptr;
 		}
-		return nullptr;
 	}
 
 	// Directory loaded.
-	auto ins = dir_data.emplace(path, std::move(dir));
+	buildNameIndex(dir);
+	dir.lastUsed = ++dir_lru_counter;
+	dir_data_cost += dir.cost;
+	auto ins = dir_data.emplace(s_path, std::move(dir));
+	evictDirectories(s_path);
 	return &(ins.first->second);
 }
 
+/**
+ * Load the path table.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int IsoPartitionPrivate::loadPathTable(void)
+{
+	if (path_table_loaded) {
+		// Path table was already loaded. (or failed to load)
+		return (!path_table.empty() ? 0 : -EIO);
+	}
+	path_table_loaded = true;
+
+	RP_Q(IsoPartition);
+	const unsigned int path_table_size = pvd.path_table_size.he;
+	const unsigned int path_table_lba = le32_to_cpu(pvd.path_table_lba_L);
+	if (!q->m_file || iso_start_offset < 0 ||
+	    path_table_size < sizeof(ISO_PathTableEntry) || path_table_size > PATH_TABLE_SIZE_MAX ||
+	    path_table_lba < static_cast<unsigned int>(iso_start_offset))
+	{
+		// Path table is invalid or too big.
+		return -EIO;
+	}
+
+	const off64_t addr = partition_offset +
+		static_cast<off64_t>(path_table_lba - iso_start_offset) * pvd.logical_block_size.he;
+	path_table.resize(path_table_size);
+	size_t size = q->m_file->seekAndRead(addr, path_table.data(), path_table.size());
+	if (size != path_table.size()) {
+		// Seek and/or read error.
+		path_table.clear();
+		return -EIO;
+	}
+	return 0;
+}
+
+/**
+ * Prefetch the uncached directories in a path.
+ *
+ * The directories are located using the path table, and all
+ * of their extents are read at once if they're close together.
+ * getDirectory() will use the prefetched data if possible.
+ *
+ * @param path Pathname [cp1252]
+ */
+void IsoPartitionPrivate::prefetchDirectories(const char *path)
+{
+	if (loadPathTable() != 0) {
+		// Can't prefetch without the path table.
+		return;
+	}
+
+	// Find the starting block of each uncached directory.
+	// NOTE: Path table entries are sorted by parent directory number.
+	// Directory numbers are 1-based, and the root directory is 1.
+	const uint8_t *const pt_start = path_table.data();
+	const size_t pt_size = path_table.size();
+	uint32_t min_block = ~0U, max_block = 0;
+	unsigned int uncached_count = 0;
+	unsigned int parent_num = 1;
+	const char *p = path;
+	while (*p != '\0') {
+		// Get the next path component.
+		if (*p == '/' || *p == '\\') {
+			p++;
+			continue;
+		}
+		const char *const comp = p;
+		do {
+			p++;
+		} while (*p != '\0' && *p != '/' && *p != '\\');
+		const size_t comp_len = static_cast<size_t>(p - comp);
+
+		// Find this directory in the path table.
+		const ISO_PathTableEntry *ptEntry_found = nullptr;
+		unsigned int dir_num = 1;
+		size_t pos = 0;
+		while (pos + sizeof(ISO_PathTableEntry) <= pt_size) {
+			const ISO_PathTableEntry *const ptEntry = reinterpret_cast<const ISO_PathTableEntry*>(&pt_start[pos]);
+			const size_t dirname_len = ptEntry->dirname_length;
+			if (dirname_len == 0 || pos + sizeof(*ptEntry) + dirname_len > pt_size) {
+				// Invalid path table entry.
+				break;
+			}
+
+			const unsigned int entry_parent = le16_to_cpu(ptEntry->parent_dir);
+			if (entry_parent > parent_num) {
+				// No more subdirectories of parent_num.
+				break;
+			} else if (entry_parent == parent_num && dirname_len == comp_len &&
+			           !strncasecmp(reinterpret_cast<const char*>(ptEntry) + sizeof(*ptEntry), comp, comp_len))
+			{
+				// Found the directory.
+				ptEntry_found = ptEntry;
+				break;
+			}
+
+			// Next entry. (Directory identifiers are padded to an even length.)
+			pos += sizeof(*ptEntry) + dirname_len + (dirname_len & 1);
+			dir_num++;
+		}
+		if (!ptEntry_found) {
+			// Not found. getDirectory() will handle it.
+			break;
+		}
+		parent_num = dir_num;
+
+		if (dir_data.find(string(path, p - path)) == dir_data.end()) {
+			// Directory isn't cached.
+			const uint32_t block = le32_to_cpu(ptEntry_found->block);
+			min_block = std::min(min_block, block);
+			max_block = std::max(max_block, block);
+			uncached_count++;
+		}
+	}
+
+	if (uncached_count < 2 || min_block < static_cast<unsigned int>(iso_start_offset) ||
+	    max_block - min_block >= PREFETCH_BLOCKS_MAX)
+	{
+		// Prefetching won't reduce the number of reads.
+		return;
+	}
+
+	// Read all of the directory extents at once.
+	// NOTE: Only the first block of the last directory is read.
+	// If it's larger than that, getDirectory() will read it separately.
+	RP_Q(IsoPartition);
+	const unsigned int block_size = pvd.logical_block_size.he;
+	prefetch_addr = partition_offset + static_cast<off64_t>(min_block - iso_start_offset) * block_size;
+	prefetch_buf.resize(static_cast<size_t>(max_block - min_block + 1) * block_size);
+	size_t size = q->m_file->seekAndRead(prefetch_addr, prefetch_buf.data(), prefetch_buf.size());
+	if (size != prefetch_buf.size()) {
+		// Seek and/or read error.
+		// getDirectory() will read the directories normally.
+		prefetch_buf.clear();
+	}
+}
+
 /**
  * Look up a directory entry from a filename.
  * @param filename Filename [UTF-8]
@@ -389,7 +724,7 @@ const ISO_DirEntry *IsoPartitionPrivate::lookup(const char *filename)
 
 	// TODO: Which encoding?
 	// Assuming cp1252...
-	const DirData_t *pDir;
+	const Directory *pDir;
 
 	// Is this file in a subdirectory?
 	const char *const sl = findLastSlash(filename);
@@ -397,7 +732,16 @@ const ISO_DirEntry *IsoPartitionPrivate::lookup(const char *filename)
 		// This file is in a subdirectory.
 		const string s_parentDir = utf8_to_cp1252(filename, static_cast<int>(sl - filename));
 		filename = sl + 1;
-		pDir = getDirectory(s_parentDir.c_str());
+		if (dir_data.find(s_parentDir) == dir_data.end()) {
+			// Parent directory isn't cached.
+			// Prefetch it and its uncached parents.
+			prefetchDirectories(s_parentDir.c_str());
+			pDir = getDirectory(s_parentDir.c_str());
+			prefetch_buf.clear();
+			prefetch_buf.shrink_to_fit();
+		} else {
+			pDir = getDirectory(s_parentDir.c_str());
+		}
 	} else {
 		// Not in a subdirectory.
 		// Parent directory is root.
@@ -11,6 +11,8 @@
 #include "librpbase/disc/IPartition.hpp"
 //#include "librpbase/disc/IFst.hpp"
 
+#include "dll-macros.h"	// for RP_LIBROMDATA_PUBLIC
+
 namespace LibRomData {
 
 class IsoPartitionPrivate;
@@ -24,8 +26,10 @@ public:
 	 * @param partition_offset Partition start offset.
 	 * @param iso_start_offset ISO start offset, in blocks. (If -1, uses heuristics.)
 	 */
+	RP_LIBROMDATA_PUBLIC
 	IsoPartition(const LibRpFile::IRpFilePtr &discReader, off64_t partition_offset, int iso_start_offset = -1);
 public:
+	RP_LIBROMDATA_PUBLIC
 	~IsoPartition() final;
 
 private:
@@ -68,6 +68,9 @@ NASOSReaderPrivate::NASOSReaderPrivate(NASOSReader *q)
 {
 	// Clear the NASOSHeader structs.
 	memset(&header, 0, sizeof(header));
+
+	// Blocks are stored uncompressed.
+	physBlockAddrs = true;
 }
 
 /** NASOSReader **/
@@ -17,9 +17,13 @@
 #  include "librpbase/crypto/IAesCipher.hpp"
 #endif /* ENABLE_DECRYPTION */
 #include "librpbase/disc/PartitionFile.hpp"
+#include "librpfile/IoTrace.hpp"
 using namespace LibRpBase;
 using namespace LibRpFile;
 
+// C++ includes
+#include <typeinfo>
+
 #include "NCCHReader_p.hpp"
 namespace LibRomData {
 
@@ -41,12 +45,22 @@ NCCHReaderPrivate::NCCHReaderPrivate(NCCHReader *q,
 	, tid_be(0)
 	, tmd_content_index(0)
 	, isDebug(false)
+	, cipherKeyIdx(-1)
+	, ksCacheCounter(0)
 #endif /* ENABLE_DECRYPTION */
 {
 	// Clear the various structs.
 	memset(&ncch_header, 0, sizeof(ncch_header));
 	memset(&ncch_exheader, 0, sizeof(ncch_exheader));
 	memset(&exefs_header, 0, sizeof(exefs_header));
+#ifdef ENABLE_DECRYPTION
+	for (KeystreamWindow &window : ksCache) {
+		window.address = ~0U;
+		window.length = 0;
+		window.lastUsed = 0;
+		window.sectIdx = -1;
+	}
+#endif /* ENABLE_DECRYPTION */
 
 	// Read the NCCH header.
 	// We're including the signature, since the first 16 bytes
@@ -246,7 +260,7 @@ NCCHReaderPrivate::NCCHReaderPrivate(NCCHReader *q,
 			// - ExeFS:
 			//   - Header, "icon" and "banner": ncchKey0, N3DS_NCCH_SECTION_EXEFS
 			//   - Other files: ncchKey1, N3DS_NCCH_SECTION_EXEFS
-			// - RomFS (TODO): ncchKey1, N3DS_NCCH_SECTION_ROMFS
+			// - RomFS: ncchKey1, N3DS_NCCH_SECTION_ROMFS
 
 			// Logo (SDK5+)
 			// NOTE: This is plaintext, but read() doesn't work properly
@@ -303,13 +317,14 @@ NCCHReaderPrivate::NCCHReaderPrivate(NCCHReader *q,
 			}
 
 			// RomFS
+			// NOTE: RomFS uses the secondary key.
 			if (ncch_header.hdr.romfs_size != cpu_to_le32(0)) {
 				const uint32_t romfs_offset = (le32_to_cpu(ncch_header.hdr.romfs_offset) << media_unit_shift);
 				encSections.emplace_back(
 					romfs_offset,	// Address within NCCH.
 					romfs_offset,	// Counter base address.
 					(le32_to_cpu(ncch_header.hdr.romfs_size) << media_unit_shift),
-					0, N3DS_NCCH_SECTION_ROMFS);
+					1, N3DS_NCCH_SECTION_ROMFS);
 			}
 
 			// Sort encSections by NCCH-relative address.
@@ -341,6 +356,120 @@ int NCCHReaderPrivate::findEncSection(uint32_t address) const
 	// Not an encrypted section.
 	return -1;
 }
+
+/**
+ * Load an NCCH key into the cipher if it isn't already loaded.
+ * @param keyIdx ncch_keys[] index
+ */
+void NCCHReaderPrivate::setCipherKey(uint8_t keyIdx)
+{
+	assert(keyIdx < ARRAY_SIZE(ncch_keys));
+	if (cipherKeyIdx == static_cast<int8_t>(keyIdx))
+		return;
+
+	cipher->setKey(ncch_keys[keyIdx].u8, sizeof(ncch_keys[keyIdx].u8));
+	cipherKeyIdx = static_cast<int8_t>(keyIdx);
+}
+
+/**
+ * Get the keystream window containing the specified address,
+ * generating it if it isn't cached.
+ * @param sectIdx	[in] encSections index
+ * @param address	[in] Address, relative to ncch_offset
+ * @return Keystream window, or nullptr on error.
+ */
+const NCCHReaderPrivate::KeystreamWindow *NCCHReaderPrivate::getKeystreamWindow(int sectIdx, uint32_t address)
+{
+	const EncSection &section = encSections[sectIdx];
+
+	// Windows are aligned to KEYSTREAM_WINDOW_SIZE,
+	// but they can't cross section boundaries.
+	const uint32_t aligned = address & ~(KEYSTREAM_WINDOW_SIZE - 1);
+	const uint32_t win_start = std::max(section.address, aligned);
+
+	// Check the cache first.
+	KeystreamWindow *pLRU = &ksCache[0];
+	for (KeystreamWindow &window : ksCache) {
+		if (window.address == win_start && window.sectIdx == sectIdx) {
+			// Found a cached window.
+			window.lastUsed = ++ksCacheCounter;
+			return &window;
+		}
+		if (window.lastUsed < pLRU->lastUsed) {
+			pLRU = &window;
+		}
+	}
+
+	// Not cached. Generate the keystream by decrypting zeroes.
+	const uint32_t win_end = static_cast<uint32_t>(std::min(
+		static_cast<uint64_t>(section.address) + section.length,
+		static_cast<uint64_t>(aligned) + KEYSTREAM_WINDOW_SIZE));
+	const uint32_t length = ALIGN_BYTES(16, win_end - win_start);
+	KeystreamWindow &window = *pLRU;
+	window.address = ~0U;
+	window.data.resize(KEYSTREAM_WINDOW_SIZE);
+	memset(window.data.data(), 0, length);
+
+	setCipherKey(section.keyIdx);
+	u128_t ctr;
+	ctr.init_ctr(tid_be, section.section, win_start - section.ctr_base);
+	cipher->setIV(ctr.u8, sizeof(ctr.u8));
+	if (cipher->decrypt(window.data.data(), length) != length) {
+		// Decryption failed.
+		return nullptr;
+	}
+
+	window.address = win_start;
+	window.length = length;
+	window.sectIdx = sectIdx;
+	window.lastUsed = ++ksCacheCounter;
+	return &window;
+}
+
+/**
+ * Decrypt data using the keystream cache.
+ * @param sectIdx	[in] encSections index
+ * @param address	[in] Address, relative to ncch_offset (must be a multiple of 16)
+ * @param ptr		[in/out] Data to decrypt
+ * @param size		[in] Size of data
+ * @return Number of bytes decrypted.
+ */
+size_t NCCHReaderPrivate::decryptWithKeystream(int sectIdx, uint32_t address, uint8_t *ptr, size_t size)
+{
+	size_t sz_done = 0;
+	while (sz_done < size) {
+		const KeystreamWindow *const window = getKeystreamWindow(sectIdx, address);
+		if (!window) {
+			// Unable to generate the keystream.
+			break;
+		}
+
+		const uint32_t ks_pos = address - window->address;
+		const size_t sz = std::min(size - sz_done, static_cast<size_t>(window->length - ks_pos));
+		const uint8_t *ks = &window->data[ks_pos];
+
+		// XOR the data with the keystream.
+		// NOTE: Using memcpy() for unaligned access; the compiler
+		// optimizes this into wide loads and stores.
+		size_t i = 0;
+		for (; i + sizeof(uint64_t) <= sz; i += sizeof(uint64_t)) {
+			uint64_t data, key;
+			memcpy(&data, &ptr[i], sizeof(data));
+			memcpy(&key, &ks[i], sizeof(key));
+			data ^= key;
+			memcpy(&ptr[i], &data, sizeof(data));
+		}
+		for (; i < sz; i++) {
+			ptr[i] ^= ks[i];
+		}
+
+		ptr += sz;
+		address += static_cast<uint32_t>(sz);
+		sz_done += sz;
+	}
+
+	return sz_done;
+}
 #endif /* ENABLE_DECRYPTION */
 
 /**
@@ -369,11 +498,13 @@ size_t NCCHReaderPrivate::readFromROM(uint32_t offset, void *ptr, size_t size)
 		return 0;
 	}
 
-	// Seek to the start of the data and read it.
+	// Read the data.
+	// NOTE: Using readAt() so multiple NCCHReaders can share
+	// the same file across threads, e.g. when verifying contents.
 	const off64_t phys_addr = ncch_offset + offset;
-	size_t sz_read = q->m_file->seekAndRead(phys_addr, ptr, size);
+	size_t sz_read = q->m_file->readAt(phys_addr, ptr, size);
 	if (sz_read != size) {
-		// Seek and/or read error.
+		// Read error.
 		q->m_lastError = q->m_file->lastError();
 		if (q->m_lastError == 0) {
 			q->m_lastError = EIO;
@@ -384,6 +515,155 @@ size_t NCCHReaderPrivate::readFromROM(uint32_t offset, void *ptr, size_t size)
 	return sz_read;
 }
 
+/**
+ * Read data from the NCCH at the current position.
+ * Encrypted sections are decrypted automatically.
+ *
+ * NOTE: The current position and size must both be multiples of 16,
+ * and the caller must have already checked the NCCH bounds.
+ *
+ * @param ptr	[out] Output buffer.
+ * @param size	[in] Amount of data to read.
+ * @return Number of bytes read.
+ */
+size_t NCCHReaderPrivate::readAligned(void *ptr, size_t size)
+{
+	assert(pos % 16 == 0);
+	assert(size % 16 == 0);
+
+	if ((ncch_header.hdr.flags[N3DS_NCCH_FLAG_BIT_MASKS] & N3DS_NCCH_BIT_MASK_NoCrypto) ||
+	     forceNoCrypto)
+	{
+		// No NCCH encryption.
+		// NOTE: readFromROM() sets q->m_lastError, so we
+		// don't need to check if a short read occurred.
+		const size_t sz_read = readFromROM(pos, ptr, size);
+		pos += static_cast<uint32_t>(sz_read);
+		return sz_read;
+	}
+
+#ifdef ENABLE_DECRYPTION
+	if (pos % 16 != 0 || size % 16 != 0) {
+		// Cannot read now.
+		return 0;
+	}
+
+	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
+	size_t sz_total_read = 0;
+	while (size > 0) {
+		// Determine what section we're in.
+		const int sectIdx = findEncSection(pos);
+		const EncSection *section = (
+			sectIdx >= 0 ? &encSections.at(sectIdx) : nullptr);
+
+		size_t sz_to_read = 0;
+		if (!section) {
+			// Not in a defined section.
+			// TODO: Handle this?
+			assert(!"Reading in an undefined section.");
+			return sz_total_read;
+		} else {
+			// We're in an encrypted section.
+			const uint32_t section_offset = static_cast<uint32_t>(pos - section->address);
+			if (section_offset + size <= section->length) {
+				// Remainder of reading is in this section.
+				sz_to_read = size;
+			} else {
+				// We're reading past the end of this section.
+				sz_to_read = section->length - section_offset;
+			}
+		}
+
+		// Read from the ROM image.
+		// This automatically removes the outer CIA
+		// title key encryption if it's present.
+		size_t ret_sz = readFromROM(pos, ptr8, sz_to_read);
+
+		if (section && section->section > N3DS_NCCH_SECTION_PLAIN) {
+			// FIXME: Round up to 16 if a short read occurred?
+			if (ret_sz >= KEYSTREAM_WINDOW_SIZE) {
+				// Large read: Decrypt directly in the destination buffer.
+				setCipherKey(section->keyIdx);
+
+				// Initialize the counter based on section and offset.
+				u128_t ctr;
+				ctr.init_ctr(tid_be, section->section, pos - section->ctr_base);
+				cipher->setIV(ctr.u8, sizeof(ctr.u8));
+
+				// Decrypt the data.
+				ret_sz = cipher->decrypt(ptr8, ret_sz);
+			} else {
+				// Small read: Use the keystream cache.
+				ret_sz = decryptWithKeystream(sectIdx, pos, ptr8, ret_sz);
+			}
+		}
+
+		pos += static_cast<uint32_t>(ret_sz);
+		ptr8 += ret_sz;
+		sz_total_read += ret_sz;
+		size -= ret_sz;
+		if (pos > ncch_length) {
+			pos = ncch_length;
+			break;
+		}
+		if (ret_sz != sz_to_read) {
+			// Short read.
+			break;
+		}
+	}
+
+	return sz_total_read;
+#else /* !ENABLE_DECRYPTION */
+	// Decryption is not enabled.
+	RP_UNUSED(ptr);
+	RP_UNUSED(size);
+	return 0;
+#endif /* ENABLE_DECRYPTION */
+}
+
+/**
+ * Load the RomFS.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int NCCHReaderPrivate::loadRomFS(void)
+{
+	if (romfs) {
+		// RomFS is already loaded.
+		return 0;
+	}
+
+	RP_Q(NCCHReader);
+	if (!(headers_loaded & HEADER_NCCH)) {
+		// NCCH header wasn't loaded.
+		q->m_lastError = EIO;
+		return -EIO;
+	}
+
+	const uint32_t romfs_offset = le32_to_cpu(ncch_header.hdr.romfs_offset) << media_unit_shift;
+	const uint32_t romfs_size = le32_to_cpu(ncch_header.hdr.romfs_size) << media_unit_shift;
+	if (romfs_size == 0) {
+		// No RomFS.
+		q->m_lastError = ENOENT;
+		return -ENOENT;
+	} else if (romfs_offset >= ncch_length || romfs_size > ncch_length - romfs_offset) {
+		// RomFS is out of bounds.
+		q->m_lastError = EIO;
+		return -EIO;
+	}
+
+	// NOTE: Only the RomFS headers are read here.
+	// Metadata and file data are read (and decrypted) on demand.
+	std::unique_ptr<NCCHRomFS> newRomFS(new NCCHRomFS(q, romfs_offset, romfs_size));
+	if (!newRomFS->isOpen()) {
+		// RomFS is invalid, or the key is incorrect.
+		q->m_lastError = EIO;
+		return -EIO;
+	}
+
+	romfs = std::move(newRomFS);
+	return 0;
+}
+
 /**
  * Load the NCCH Extended Header.
  * @return 0 on success; non-zero on error.
@@ -535,6 +815,7 @@ size_t NCCHReader::read(void *ptr, size_t size)
 		// Nothing to do...
 		return 0;
 	}
+	IoTrace::Scope trace(IoTrace::Op::Read, typeid(*this).name(), d->pos, size);
 
 	// Are we already at the end of the file?
 	if (d->pos >= d->ncch_length)
@@ -546,89 +827,64 @@ size_t NCCHReader::read(void *ptr, size_t size)
 		size = static_cast<size_t>(d->ncch_length - d->pos);
 	}
 
-	if ((d->ncch_header.hdr.flags[N3DS_NCCH_FLAG_BIT_MASKS] & N3DS_NCCH_BIT_MASK_NoCrypto) ||
-	     d->forceNoCrypto)
-	{
-		// No NCCH encryption.
-		// NOTE: readFromROM() sets q->m_lastError, so we
-		// don't need to check if a short read occurred.
-		return d->readFromROM(d->pos, ptr, size);
-	}
-
-#ifdef ENABLE_DECRYPTION
-	// TODO: Handle reads that aren't a multiple of 16 bytes.
-	assert(d->pos % 16 == 0);
-	assert(size % 16 == 0);
-	if (d->pos % 16 != 0 || size % 16 != 0) {
-		// Cannot read now.
-		return 0;
+	if (d->pos % 16 == 0 && size % 16 == 0) {
+		// Aligned read.
+		return trace.ret(d->readAligned(ptr, size));
 	}
 
+	// Unaligned read. (e.g. a RomFS file opened with open())
+	// Partial blocks are read into a bounce buffer.
+	// NOTE: ncch_length is a multiple of the media unit size,
+	// so reading a full block at the end won't go out of bounds.
 	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
 	size_t sz_total_read = 0;
-	while (size > 0) {
-		// Determine what section we're in.
-		const int sectIdx = d->findEncSection(d->pos);
-		const NCCHReaderPrivate::EncSection *section = (
-			sectIdx >= 0 ? &d->encSections.at(sectIdx) : nullptr);
-
-		size_t sz_to_read = 0;
-		if (!section) {
-			// Not in a defined section.
-			// TODO: Handle this?
-			assert(!"Reading in an undefined section.");
-			return sz_total_read;
-		} else {
-			// We're in an encrypted section.
-			const uint32_t section_offset = static_cast<uint32_t>(d->pos - section->address);
-			if (section_offset + size <= section->length) {
-				// Remainder of reading is in this section.
-				sz_to_read = size;
-			} else {
-				// We're reading past the end of this section.
-				sz_to_read = section->length - section_offset;
-			}
+	uint8_t block[16];
+
+	// Partial first block.
+	const unsigned int head = d->pos % 16;
+	if (head != 0) {
+		const uint32_t pos = d->pos;
+		d->pos -= head;
+		if (d->readAligned(block, sizeof(block)) != sizeof(block)) {
+			// Read error.
+			d->pos = pos;
+			return trace.ret(0);
 		}
+		const size_t sz = std::min(size, sizeof(block) - head);
+		memcpy(ptr8, &block[head], sz);
+		d->pos = pos + static_cast<uint32_t>(sz);
+		ptr8 += sz;
+		sz_total_read += sz;
+		size -= sz;
+	}
 
-		// Read from the ROM image.
-		// This automatically removes the outer CIA
-		// title key encryption if it's present.
-		size_t ret_sz = d->readFromROM(d->pos, ptr8, sz_to_read);
-
-		if (section && section->section > N3DS_NCCH_SECTION_PLAIN) {
-			// Set the required key.
-			// TODO: Don't set the key if it hasn't changed.
-			d->cipher->setKey(d->ncch_keys[section->keyIdx].u8, sizeof(d->ncch_keys[section->keyIdx].u8));
-
-			// Initialize the counter based on section and offset.
-			u128_t ctr;
-			ctr.init_ctr(d->tid_be, section->section, d->pos - section->ctr_base);
-			d->cipher->setIV(ctr.u8, sizeof(ctr.u8));
-
-			// Decrypt the data.
-			// FIXME: Round up to 16 if a short read occurred?
-			ret_sz = d->cipher->decrypt(static_cast<uint8_t*>(ptr), ret_sz);
+	// Full blocks.
+	const size_t sz_blocks = size & ~static_cast<size_t>(15);
+	if (sz_blocks > 0) {
+		const size_t sz = d->readAligned(ptr8, sz_blocks);
+		ptr8 += sz;
+		sz_total_read += sz;
+		size -= sz;
+		if (sz != sz_blocks) {
+			// Short read.
+			return trace.ret(sz_total_read);
 		}
+	}
 
-		d->pos += static_cast<uint32_t>(ret_sz);
-		ptr8 += ret_sz;
-		sz_total_read += ret_sz;
-		size -= ret_sz;
-		if (d->pos > d->ncch_length) {
-			d->pos = d->ncch_length;
-			break;
-		}
-		if (ret_sz != sz_to_read) {
-			// Short read.
-			break;
+	// Partial last block.
+	if (size > 0) {
+		const uint32_t pos = d->pos;
+		if (d->readAligned(block, sizeof(block)) != sizeof(block)) {
+			// Read error.
+			d->pos = pos;
+			return trace.ret(sz_total_read);
 		}
+		memcpy(ptr8, block, size);
+		d->pos = pos + static_cast<uint32_t>(size);
+		sz_total_read += size;
 	}
 
-	return sz_total_read;
-#else /* !ENABLE_DECRYPTION */
-	// Decryption is not enabled.
-	return 0;
-#endif /* ENABLE_DECRYPTION */
+	return trace.ret(sz_total_read);
 }
 
 /**
@@ -716,6 +972,118 @@ off64_t NCCHReader::partition_size_used(void) const
 	return d->ncch_length;
 }
 
+/** IFst wrapper functions **/
+
+/**
+ * Open a directory.
+ * @param path	[in] Directory path.
+ * @return IFst::Dir*, or nullptr on error.
+ */
+IFst::Dir *NCCHReader::opendir(const char *path)
+{
+	RP_D(NCCHReader);
+	if (!d->romfs) {
+		// RomFS isn't loaded.
+		if (d->loadRomFS() != 0) {
+			// RomFS load failed.
+			// TODO: Errors?
+			return nullptr;
+		}
+	}
+
+	return d->romfs->opendir(path);
+}
+
+/**
+ * Read a directory entry.
+ * @param dirp IFst::Dir pointer.
+ * @return IFst::DirEnt*, or nullptr if end of directory or on error.
+ * (TODO: Add lastError()?)
+ */
+IFst::DirEnt *NCCHReader::readdir(IFst::Dir *dirp)
+{
+	RP_D(NCCHReader);
+	if (!d->romfs) {
+		// TODO: Errors?
+		return nullptr;
+	}
+
+	return d->romfs->readdir(dirp);
+}
+
+/**
+ * Close an opened directory.
+ * @param dirp IFst::Dir pointer.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int NCCHReader::closedir(IFst::Dir *dirp)
+{
+	RP_D(NCCHReader);
+	if (!d->romfs) {
+		// TODO: Errors?
+		return -EBADF;
+	}
+
+	return d->romfs->closedir(dirp);
+}
+
+/**
+ * Open a file from the RomFS. (read-only)
+ * @param filename Filename.
+ * @return IRpFile*, or nullptr on error.
+ */
+IRpFilePtr NCCHReader::open(const char *filename)
+{
+	RP_D(NCCHReader);
+	if (!isOpen()) {
+		m_lastError = EBADF;
+		return nullptr;
+	} else if (!filename) {
+		// No filename.
+		m_lastError = EINVAL;
+		return nullptr;
+	}
+
+	if (!d->romfs) {
+		// RomFS isn't loaded.
+		if (d->loadRomFS() != 0) {
+			// RomFS load failed.
+			// NOTE: loadRomFS() sets m_lastError.
+			return nullptr;
+		}
+	}
+
+	// Find the file in the RomFS.
+	IFst::DirEnt dirent;
+	int ret = d->romfs->find_file(filename, &dirent);
+	if (ret != 0) {
+		// File not found.
+		m_lastError = ENOENT;
+		return nullptr;
+	}
+
+	// Make sure this is a regular file.
+	if (dirent.type != DT_REG) {
+		// Not a regular file.
+		m_lastError = (dirent.type == DT_DIR ? EISDIR : EPERM);
+		return nullptr;
+	}
+
+	// Make sure the file is in bounds.
+	if (dirent.offset >= d->ncch_length ||
+	    dirent.offset > d->ncch_length - dirent.size)
+	{
+		// File is out of bounds.
+		m_lastError = EIO;
+		return nullptr;
+	}
+
+	// Create the PartitionFile.
+	// NOTE: RomFS files usually aren't 16-byte aligned.
+	// read() handles this using a bounce buffer.
+	return std::make_shared<PartitionFile>(this->shared_from_this(), dirent.offset, dirent.size);
+}
+
 /** NCCHReader **/
 
 /**
@@ -966,31 +1334,38 @@ const char *NCCHReader::contentType(void) const
 /**
  * Open a file. (read-only)
  *
- * NOTE: Only ExeFS is currently supported.
+ * NOTE: Only ExeFS and RomFS are currently supported.
  *
  * @param section NCCH section.
- * @param filename Filename. (ASCII)
+ * @param filename Filename. (ASCII for ExeFS; UTF-8 path for RomFS)
  * @return IRpFile*, or nullptr on error.
  */
 IRpFilePtr NCCHReader::open(int section, const char *filename)
 {
 	RP_D(const NCCHReader);
 	assert(isOpen());
-	assert(section == N3DS_NCCH_SECTION_EXEFS);
+	assert(section == N3DS_NCCH_SECTION_EXEFS || section == N3DS_NCCH_SECTION_ROMFS);
 	assert(filename != nullptr);
 	if (!isOpen()) {
 		m_lastError = EBADF;
 		return nullptr;
-	} else if (section != N3DS_NCCH_SECTION_EXEFS) {
-		// Only ExeFS is currently supported.
-		m_lastError = ENOTSUP;
-		return nullptr;
 	} else if (!filename) {
 		// Invalid filename.
 		m_lastError = EINVAL;
 		return nullptr;
 	}
 
+	switch (section) {
+		case N3DS_NCCH_SECTION_EXEFS:
+			break;
+		case N3DS_NCCH_SECTION_ROMFS:
+			return this->open(filename);
+		default:
+			// Only ExeFS and RomFS are currently supported.
+			m_lastError = ENOTSUP;
+			return nullptr;
+	}
+
 	// Get the ExeFS header.
 	const N3DS_ExeFS_Header_t *const exefs_header = exefsHeader();
 	if (!exefs_header) {
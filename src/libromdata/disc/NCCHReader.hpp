@@ -13,6 +13,7 @@
 // librpbase
 #include "librpbase/disc/IPartition.hpp"
 #include "librpbase/crypto/KeyManager.hpp"
+#include "dll-macros.h"	// for RP_LIBROMDATA_PUBLIC
 
 // CIAReader
 #include "CIAReader.hpp"
@@ -31,6 +32,7 @@ public:
 	 * @param ncch_offset		[in] NCCH start offset, in bytes.
 	 * @param ncch_length		[in] NCCH length, in bytes.
 	 */
+	RP_LIBROMDATA_PUBLIC
 	NCCHReader(const LibRpFile::IRpFilePtr &file,
 		uint8_t media_unit_shift,
 		off64_t ncch_offset, uint32_t ncch_length);
@@ -47,6 +49,7 @@ public:
 		uint8_t media_unit_shift,
 		off64_t ncch_offset, uint32_t ncch_length);
 public:
+	RP_LIBROMDATA_PUBLIC
 	~NCCHReader() final;
 
 private:
@@ -108,6 +111,39 @@ public:
 	 */
 	off64_t partition_size_used(void) const final;
 
+public:
+	/** IFst wrapper functions **/
+	// NOTE: These operate on the RomFS.
+
+	/**
+	 * Open a directory.
+	 * @param path	[in] Directory path.
+	 * @return IFst::Dir*, or nullptr on error.
+	 */
+	LibRpBase::IFst::Dir *opendir(const char *path) final;
+
+	/**
+	 * Read a directory entry.
+	 * @param dirp IFst::Dir pointer.
+	 * @return IFst::DirEnt, or nullptr if end of directory or on error.
+	 * (TODO: Add lastError()?)
+	 */
+	LibRpBase::IFst::DirEnt *readdir(LibRpBase::IFst::Dir *dirp) final;
+
+	/**
+	 * Close an opened directory.
+	 * @param dirp IFst::Dir pointer.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int closedir(LibRpBase::IFst::Dir *dirp) final;
+
+	/**
+	 * Open a file from the RomFS. (read-only)
+	 * @param filename Filename.
+	 * @return IRpFile*, or nullptr on error.
+	 */
+	LibRpFile::IRpFilePtr open(const char *filename) final;
+
 public:
 	/** NCCHReader **/
 
@@ -184,12 +220,13 @@ public:
 	/**
 	 * Open a file. (read-only)
 	 *
-	 * NOTE: Only ExeFS is currently supported.
+	 * NOTE: Only ExeFS and RomFS are currently supported.
 	 *
 	 * @param section NCCH section.
-	 * @param filename Filename. (ASCII)
+	 * @param filename Filename. (ASCII for ExeFS; UTF-8 path for RomFS)
 	 * @return IRpFile*, or nullptr on error.
 	 */
+	RP_LIBROMDATA_PUBLIC
 	LibRpFile::IRpFilePtr open(int section, const char *filename);
 
 	/**
@@ -11,6 +11,7 @@
 
 #include "librpbase/config.librpbase.h"
 #include "NCCHReader.hpp"
+#include "NCCHRomFS.hpp"
 
 // librpbase
 #include "librpbase/crypto/KeyManager.hpp"
@@ -25,9 +26,11 @@
 
 // C++ includes
 #ifdef ENABLE_DECRYPTION
-#  include <memory>
+#  include <array>
 #endif /* ENABLE_DECRYPTION */
+#include <memory>
 #include <vector>
+#include "uvector.h"
 
 #ifdef ENABLE_DECRYPTION
 namespace LibRpBase {
@@ -96,6 +99,9 @@ protected:
 	// ExeFS header
 	N3DS_ExeFS_Header_t exefs_header;
 
+	// RomFS (loaded on demand)
+	std::unique_ptr<NCCHRomFS> romfs;
+
 	/**
 	 * Read data from the underlying ROM image.
 	 * CIA decryption is automatically handled if set up properly.
@@ -110,6 +116,26 @@ protected:
 	ATTR_ACCESS_SIZE(write_only, 3, 4)
 	size_t readFromROM(uint32_t offset, void *ptr, size_t size);
 
+	/**
+	 * Read data from the NCCH at the current position.
+	 * Encrypted sections are decrypted automatically.
+	 *
+	 * NOTE: The current position and size must both be multiples of 16,
+	 * and the caller must have already checked the NCCH bounds.
+	 *
+	 * @param ptr	[out] Output buffer.
+	 * @param size	[in] Amount of data to read.
+	 * @return Number of bytes read.
+	 */
+	ATTR_ACCESS_SIZE(write_only, 2, 3)
+	size_t readAligned(void *ptr, size_t size);
+
+	/**
+	 * Load the RomFS.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int loadRomFS(void);
+
 	/**
 	 * Load the NCCH Extended Header.
 	 * @return 0 on success; non-zero on error.
@@ -172,6 +198,51 @@ protected:
 	 * @return Index in encSections, or -1 if not encrypted.
 	 */
 	int findEncSection(uint32_t address) const;
+
+	// Key currently loaded in the cipher. (ncch_keys[] index; -1 if unknown)
+	int8_t cipherKeyIdx;
+
+	/**
+	 * Load an NCCH key into the cipher if it isn't already loaded.
+	 * @param keyIdx ncch_keys[] index
+	 */
+	void setCipherKey(uint8_t keyIdx);
+
+	// AES-CTR keystream cache.
+	// Small reads are decrypted by XORing with precomputed keystream,
+	// so reading headers in small pieces doesn't need a cipher setup
+	// and a tiny AES call for every read. Reads of at least one window
+	// are decrypted directly in the destination buffer instead.
+	static constexpr uint32_t KEYSTREAM_WINDOW_SIZE = 64U * 1024U;
+	static constexpr unsigned int KEYSTREAM_CACHE_WINDOWS = 2;
+	struct KeystreamWindow {
+		uint32_t address;	// Relative to ncch_offset; ~0 if unused
+		uint32_t length;	// Keystream length
+		uint32_t lastUsed;
+		int sectIdx;		// encSections index
+		rp::uvector<uint8_t> data;
+	};
+	std::array<KeystreamWindow, KEYSTREAM_CACHE_WINDOWS> ksCache;
+	uint32_t ksCacheCounter;
+
+	/**
+	 * Get the keystream window containing the specified address,
+	 * generating it if it isn't cached.
+	 * @param sectIdx	[in] encSections index
+	 * @param address	[in] Address, relative to ncch_offset
+	 * @return Keystream window, or nullptr on error.
+	 */
+	const KeystreamWindow *getKeystreamWindow(int sectIdx, uint32_t address);
+
+	/**
+	 * Decrypt data using the keystream cache.
+	 * @param sectIdx	[in] encSections index
+	 * @param address	[in] Address, relative to ncch_offset (must be a multiple of 16)
+	 * @param ptr		[in/out] Data to decrypt
+	 * @param size		[in] Size of data
+	 * @return Number of bytes decrypted.
+	 */
+	size_t decryptWithKeystream(int sectIdx, uint32_t address, uint8_t *ptr, size_t size);
 #endif /* ENABLE_DECRYPTION */
 };
 
@@ -0,0 +1,738 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata)                       *
+ * NCCHRomFS.cpp: Nintendo 3DS NCCH RomFS parser.                          *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "stdafx.h"
+#include "NCCHRomFS.hpp"
+#include "../Handheld/n3ds_structs.h"
+
+// Other rom-properties libraries
+using namespace LibRpBase;
+using namespace LibRpText;
+
+// C++ STL classes
+using std::array;
+using std::string;
+using std::u16string;
+
+namespace LibRomData {
+
+class NCCHRomFSPrivate
+{
+public:
+	NCCHRomFSPrivate(IDiscReader *reader, off64_t romfs_offset, off64_t romfs_size);
+
+private:
+	RP_DISABLE_COPY(NCCHRomFSPrivate)
+
+public:
+	IDiscReader *const reader;
+
+	// Level 3 location, relative to the IDiscReader.
+	off64_t level3_offset;
+	uint32_t level3_size;	// 0 if the RomFS isn't valid
+
+	// Level 3 header
+	// NOTE: Fields are NOT byteswapped!
+	N3DS_RomFS_Level3_Header_t l3hdr;
+
+	bool hasErrors;
+
+	// IFst::Dir* reference counter
+	int fstDirCount;
+
+	// Last filename returned by find_file().
+	string find_name;
+
+	// Directory iterator.
+	struct RomFSDir : public IFst::Dir {
+		uint32_t next_dir;	// Next subdirectory (dir metadata offset)
+		uint32_t next_file;	// Next file (file metadata offset)
+		string name;		// Name of the current entry
+
+		explicit RomFSDir(IFst *parent)
+			: IFst::Dir(parent)
+			, next_dir(N3DS_ROMFS_NO_ENTRY)
+			, next_file(N3DS_ROMFS_NO_ENTRY)
+		{}
+	};
+
+	// Metadata block cache.
+	// Lookups only touch a few small entries, so metadata
+	// is read in small blocks instead of loading the tables.
+	static constexpr unsigned int META_BLOCK_SIZE = 512;
+	static constexpr unsigned int META_CACHE_BLOCKS = 16;
+	struct MetaBlock {
+		uint32_t offset;	// Level 3 offset; ~0 if unused
+		uint32_t lastUsed;
+		uint8_t data[META_BLOCK_SIZE];
+	};
+	array<MetaBlock, META_CACHE_BLOCKS> metaCache;
+	uint32_t metaCacheCounter;
+
+	/**
+	 * Read level 3 data using the metadata block cache.
+	 * @param offset	[in] Level 3 offset
+	 * @param buf		[out] Output buffer
+	 * @param size		[in] Size
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int readMeta(uint32_t offset, void *buf, size_t size);
+
+	/**
+	 * Read a metadata entry and its name.
+	 * @param table_offset	[in] Metadata table offset (from l3hdr, not byteswapped)
+	 * @param table_length	[in] Metadata table length (from l3hdr, not byteswapped)
+	 * @param offset	[in] Entry offset within the metadata table
+	 * @param entry		[out] Entry header
+	 * @param entry_size	[in] Size of the entry header
+	 * @param name_len_off	[in] Offset of the name length field in the entry header
+	 * @param name		[out] Entry name (UTF-16, host-endian)
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int readEntry(uint32_t table_offset, uint32_t table_length, uint32_t offset,
+		void *entry, size_t entry_size, size_t name_len_off, u16string &name);
+
+	inline int readDirEntry(uint32_t offset, N3DS_RomFS_DirEntry_t *entry, u16string &name)
+	{
+		return readEntry(l3hdr.dir_meta_offset, l3hdr.dir_meta_length, offset,
+			entry, sizeof(*entry), offsetof(N3DS_RomFS_DirEntry_t, name_length), name);
+	}
+
+	inline int readFileEntry(uint32_t offset, N3DS_RomFS_FileEntry_t *entry, u16string &name)
+	{
+		return readEntry(l3hdr.file_meta_offset, l3hdr.file_meta_length, offset,
+			entry, sizeof(*entry), offsetof(N3DS_RomFS_FileEntry_t, name_length), name);
+	}
+
+	/**
+	 * Calculate a RomFS hash table bucket.
+	 * @param parent	[in] Parent directory offset
+	 * @param name		[in] Name (UTF-16, host-endian)
+	 * @param buckets	[in] Number of buckets
+	 * @return Bucket index.
+	 */
+	static uint32_t hashBucket(uint32_t parent, const u16string &name, uint32_t buckets);
+
+	/**
+	 * Look up an entry using a RomFS hash table.
+	 * @param isDir		[in] True for directories; false for files
+	 * @param parent	[in] Parent directory offset
+	 * @param name		[in] Name (UTF-16, host-endian)
+	 * @return Metadata offset, or N3DS_ROMFS_NO_ENTRY if not found.
+	 */
+	uint32_t lookup(bool isDir, uint32_t parent, const u16string &name);
+
+	/**
+	 * Find a path.
+	 * @param path		[in] Path
+	 * @param pIsDir	[out] True if this is a directory
+	 * @param pName		[out,opt] Entry name (UTF-8)
+	 * @return Metadata offset, or N3DS_ROMFS_NO_ENTRY if not found.
+	 */
+	uint32_t find_path(const char *path, bool *pIsDir, string *pName = nullptr);
+
+	/**
+	 * Get a file's absolute offset.
+	 * @param entry File entry
+	 * @return Offset, relative to the IDiscReader.
+	 */
+	inline off64_t fileOffset(const N3DS_RomFS_FileEntry_t &entry) const
+	{
+		return level3_offset + le32_to_cpu(l3hdr.file_data_offset) +
+			static_cast<off64_t>(le64_to_cpu(entry.data_offset));
+	}
+};
+
+/** NCCHRomFSPrivate **/
+
+NCCHRomFSPrivate::NCCHRomFSPrivate(IDiscReader *reader, off64_t romfs_offset, off64_t romfs_size)
+	: reader(reader)
+	, level3_offset(0)
+	, level3_size(0)
+	, hasErrors(false)
+	, fstDirCount(0)
+	, metaCacheCounter(0)
+{
+	memset(&l3hdr, 0, sizeof(l3hdr));
+	for (MetaBlock &block : metaCache) {
+		block.offset = ~0U;
+		block.lastUsed = 0;
+	}
+
+	if (!reader || romfs_offset < 0 || romfs_size < N3DS_IVFC_HEADER_AREA_SIZE) {
+		// Invalid parameters.
+		return;
+	}
+
+	// Read the IVFC header.
+	// NOTE: Reading the full header area, since
+	// encrypted reads must be a multiple of 16 bytes.
+	union {
+		N3DS_IVFC_Header_t ivfc;
+		uint8_t u8[N3DS_IVFC_HEADER_AREA_SIZE];
+	} ivfc_buf;
+	size_t size = reader->seekAndRead(romfs_offset, &ivfc_buf, sizeof(ivfc_buf));
+	if (size != sizeof(ivfc_buf)) {
+		// Seek and/or read error.
+		return;
+	}
+	const N3DS_IVFC_Header_t *const ivfc = &ivfc_buf.ivfc;
+	if (ivfc->magic != cpu_to_be32(N3DS_IVFC_MAGIC) ||
+	    ivfc->magic_number != cpu_to_le32(N3DS_IVFC_ROMFS_MAGIC_NUMBER))
+	{
+		// Incorrect magic.
+		return;
+	}
+
+	// Level 3 is located after the master hash,
+	// aligned to the level 3 block size.
+	const N3DS_IVFC_Level_t &level3 = ivfc->levels[2];
+	const uint32_t block_size_log2 = le32_to_cpu(level3.block_size_log2);
+	const uint64_t l3_size = le64_to_cpu(level3.hashdata_size);
+	if (block_size_log2 < 4 || block_size_log2 > 24) {
+		// Block size must be a multiple of 16 for decryption.
+		return;
+	}
+	const uint64_t l3_start = ALIGN_BYTES(1ULL << block_size_log2,
+		N3DS_IVFC_HEADER_AREA_SIZE + static_cast<uint64_t>(le32_to_cpu(ivfc->master_hash_size)));
+	if (l3_size < sizeof(l3hdr) || l3_size > 0xFFFFFFFFU ||
+	    l3_start + l3_size > static_cast<uint64_t>(romfs_size))
+	{
+		// Level 3 is out of range.
+		return;
+	}
+	level3_offset = romfs_offset + static_cast<off64_t>(l3_start);
+	level3_size = static_cast<uint32_t>(l3_size);
+
+	// Read the level 3 header and validate the tables.
+	if (readMeta(0, &l3hdr, sizeof(l3hdr)) != 0 ||
+	    l3hdr.header_length != cpu_to_le32(sizeof(l3hdr)))
+	{
+		level3_size = 0;
+		return;
+	}
+
+	const array<std::pair<uint32_t, uint32_t>, 4> tables = {{
+		{le32_to_cpu(l3hdr.dir_hash_offset), le32_to_cpu(l3hdr.dir_hash_length)},
+		{le32_to_cpu(l3hdr.dir_meta_offset), le32_to_cpu(l3hdr.dir_meta_length)},
+		{le32_to_cpu(l3hdr.file_hash_offset), le32_to_cpu(l3hdr.file_hash_length)},
+		{le32_to_cpu(l3hdr.file_meta_offset), le32_to_cpu(l3hdr.file_meta_length)},
+	}};
+	for (const auto &table : tables) {
+		if (table.first > level3_size || table.second > level3_size - table.first) {
+			// Table is out of range.
+			level3_size = 0;
+			return;
+		}
+	}
+	if (tables[0].second < 4 || tables[2].second < 4 ||
+	    tables[1].second < sizeof(N3DS_RomFS_DirEntry_t) ||
+	    le32_to_cpu(l3hdr.file_data_offset) > level3_size)
+	{
+		// Hash tables and root directory are required.
+		level3_size = 0;
+		return;
+	}
+}
+
+/**
+ * Read level 3 data using the metadata block cache.
+ * @param offset	[in] Level 3 offset
+ * @param buf		[out] Output buffer
+ * @param size		[in] Size
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int NCCHRomFSPrivate::readMeta(uint32_t offset, void *buf, size_t size)
+{
+	if (offset > level3_size || size > level3_size - offset) {
+		// Out of range.
+		hasErrors = true;
+		return -EIO;
+	}
+
+	uint8_t *pDest = static_cast<uint8_t*>(buf);
+	while (size > 0) {
+		const uint32_t blockOffset = offset & ~(META_BLOCK_SIZE - 1);
+
+		// Check the cache first.
+		MetaBlock *pBlock = nullptr;
+		MetaBlock *pLRU = &metaCache[0];
+		for (MetaBlock &block : metaCache) {
+			if (block.offset == blockOffset) {
+				pBlock = &block;
+				break;
+			}
+			if (block.lastUsed < pLRU->lastUsed) {
+				pLRU = &block;
+			}
+		}
+
+		if (!pBlock) {
+			// Not cached. Replace the least-recently used block.
+			// NOTE: Rounding up to 16 bytes for decryption; this stays
+			// within the RomFS, since level 3 is followed by hash levels.
+			size_t blockSize = std::min(
+				static_cast<size_t>(META_BLOCK_SIZE), static_cast<size_t>(level3_size - blockOffset));
+			const size_t readSize = ALIGN_BYTES(16, blockSize);
+			pBlock = pLRU;
+			pBlock->offset = ~0U;
+			size_t sz_read = reader->seekAndRead(level3_offset + blockOffset, pBlock->data, readSize);
+			if (sz_read != readSize) {
+				// Seek and/or read error.
+				return -EIO;
+			}
+			pBlock->offset = blockOffset;
+		}
+		pBlock->lastUsed = ++metaCacheCounter;
+
+		const uint32_t blockPos = offset - blockOffset;
+		const size_t chunk = std::min(size, static_cast<size_t>(META_BLOCK_SIZE - blockPos));
+		memcpy(pDest, &pBlock->data[blockPos], chunk);
+		pDest += chunk;
+		offset += static_cast<uint32_t>(chunk);
+		size -= chunk;
+	}
+
+	return 0;
+}
+
+/**
+ * Read a metadata entry and its name.
+ * @param table_offset	[in] Metadata table offset (from l3hdr, not byteswapped)
+ * @param table_length	[in] Metadata table length (from l3hdr, not byteswapped)
+ * @param offset	[in] Entry offset within the metadata table
+ * @param entry		[out] Entry header
+ * @param entry_size	[in] Size of the entry header
+ * @param name_len_off	[in] Offset of the name length field in the entry header
+ * @param name		[out] Entry name (UTF-16, host-endian)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int NCCHRomFSPrivate::readEntry(uint32_t table_offset, uint32_t table_length, uint32_t offset,
+	void *entry, size_t entry_size, size_t name_len_off, u16string &name)
+{
+	table_offset = le32_to_cpu(table_offset);
+	table_length = le32_to_cpu(table_length);
+	if (offset > table_length || entry_size > table_length - offset) {
+		// Entry is out of range.
+		hasErrors = true;
+		return -EIO;
+	}
+
+	int ret = readMeta(table_offset + offset, entry, entry_size);
+	if (ret != 0) {
+		return ret;
+	}
+
+	uint32_t name_length;
+	memcpy(&name_length, static_cast<const uint8_t*>(entry) + name_len_off, sizeof(name_length));
+	name_length = le32_to_cpu(name_length);
+	if ((name_length & 1) || name_length > table_length - offset - entry_size) {
+		// Name is invalid or out of range.
+		hasErrors = true;
+		return -EIO;
+	}
+
+	name.resize(name_length / sizeof(char16_t));
+	if (name_length > 0) {
+		ret = readMeta(table_offset + offset + static_cast<uint32_t>(entry_size), &name[0], name_length);
+		if (ret != 0) {
+			return ret;
+		}
+#if SYS_BYTEORDER == SYS_BIG_ENDIAN
+		for (char16_t &c : name) {
+			c = le16_to_cpu(c);
+		}
+#endif /* SYS_BYTEORDER == SYS_BIG_ENDIAN */
+	}
+	return 0;
+}
+
+/**
+ * Calculate a RomFS hash table bucket.
+ * @param parent	[in] Parent directory offset
+ * @param name		[in] Name (UTF-16, host-endian)
+ * @param buckets	[in] Number of buckets
+ * @return Bucket index.
+ */
+uint32_t NCCHRomFSPrivate::hashBucket(uint32_t parent, const u16string &name, uint32_t buckets)
+{
+	// Reference: https://3dbrew.org/wiki/RomFS
+	uint32_t hash = parent ^ 123456789U;
+	for (const char16_t c : name) {
+		hash = (hash >> 5) | (hash << 27);
+		hash ^= c;
+	}
+	return hash % buckets;
+}
+
+/**
+ * Look up an entry using a RomFS hash table.
+ * @param isDir		[in] True for directories; false for files
+ * @param parent	[in] Parent directory offset
+ * @param name		[in] Name (UTF-16, host-endian)
+ * @return Metadata offset, or N3DS_ROMFS_NO_ENTRY if not found.
+ */
+uint32_t NCCHRomFSPrivate::lookup(bool isDir, uint32_t parent, const u16string &name)
+{
+	const uint32_t hash_offset = le32_to_cpu(isDir ? l3hdr.dir_hash_offset : l3hdr.file_hash_offset);
+	const uint32_t buckets = le32_to_cpu(isDir ? l3hdr.dir_hash_length : l3hdr.file_hash_length) / 4;
+	const uint32_t bucket = hashBucket(parent, name, buckets);
+
+	uint32_t offset;
+	if (readMeta(hash_offset + (bucket * 4), &offset, sizeof(offset)) != 0) {
+		return N3DS_ROMFS_NO_ENTRY;
+	}
+	offset = le32_to_cpu(offset);
+
+	// Follow the bucket's chain.
+	// NOTE: Limiting the number of iterations in case the chain loops.
+	u16string entry_name;
+	const uint32_t meta_length = le32_to_cpu(isDir ? l3hdr.dir_meta_length : l3hdr.file_meta_length);
+	for (uint32_t i = 0; offset != N3DS_ROMFS_NO_ENTRY; i++) {
+		if (i >= meta_length / sizeof(N3DS_RomFS_DirEntry_t)) {
+			hasErrors = true;
+			break;
+		}
+
+		uint32_t entry_parent, next_hash;
+		if (isDir) {
+			N3DS_RomFS_DirEntry_t entry;
+			if (readDirEntry(offset, &entry, entry_name) != 0) {
+				break;
+			}
+			entry_parent = le32_to_cpu(entry.parent_offset);
+			next_hash = le32_to_cpu(entry.next_hash_offset);
+		} else {
+			N3DS_RomFS_FileEntry_t entry;
+			if (readFileEntry(offset, &entry, entry_name) != 0) {
+				break;
+			}
+			entry_parent = le32_to_cpu(entry.parent_offset);
+			next_hash = le32_to_cpu(entry.next_hash_offset);
+		}
+
+		if (entry_parent == parent && entry_name == name) {
+			// Found the entry.
+			return offset;
+		}
+		offset = next_hash;
+	}
+
+	// Not found.
+	return N3DS_ROMFS_NO_ENTRY;
+}
+
+/**
+ * Find a path.
+ * @param path		[in] Path
+ * @param pIsDir	[out] True if this is a directory
+ * @param pName		[out,opt] Entry name (UTF-8)
+ * @return Metadata offset, or N3DS_ROMFS_NO_ENTRY if not found.
+ */
+uint32_t NCCHRomFSPrivate::find_path(const char *path, bool *pIsDir, string *pName)
+{
+	if (!path || level3_size == 0) {
+		return N3DS_ROMFS_NO_ENTRY;
+	}
+
+	// Root directory is always at offset 0.
+	uint32_t dir = 0;
+	*pIsDir = true;
+	if (pName) {
+		pName->clear();
+	}
+
+	const char *p = path;
+	while (*p != '\0') {
+		// Skip slashes.
+		while (*p == '/') {
+			p++;
+		}
+		if (*p == '\0') {
+			break;
+		}
+
+		const char *const comp = p;
+		while (*p != '\0' && *p != '/') {
+			p++;
+		}
+		const size_t len = p - comp;
+		const u16string name = utf8_to_utf16(comp, static_cast<int>(len));
+
+		// Check if this is the last component.
+		const char *q = p;
+		while (*q == '/') {
+			q++;
+		}
+		const bool isLast = (*q == '\0');
+
+		if (isLast) {
+			// Check for a file first.
+			const uint32_t file = lookup(false, dir, name);
+			if (file != N3DS_ROMFS_NO_ENTRY) {
+				*pIsDir = false;
+				if (pName) {
+					pName->assign(comp, len);
+				}
+				return file;
+			}
+		}
+
+		dir = lookup(true, dir, name);
+		if (dir == N3DS_ROMFS_NO_ENTRY) {
+			// Not found.
+			return N3DS_ROMFS_NO_ENTRY;
+		}
+		if (pName) {
+			pName->assign(comp, len);
+		}
+	}
+
+	return dir;
+}
+
+/** NCCHRomFS **/
+
+/**
+ * Parse an NCCH RomFS.
+ *
+ * Only the IVFC and level 3 headers are read here.
+ * Directory and file metadata is read on demand.
+ *
+ * NOTE: The IDiscReader *must* remain valid while this
+ * NCCHRomFS is open. Reads must be a multiple of 16 bytes,
+ * so this works with encrypted NCCHs.
+ *
+ * @param reader	[in] IDiscReader, e.g. NCCHReader
+ * @param romfs_offset	[in] RomFS offset within the IDiscReader
+ * @param romfs_size	[in] RomFS size
+ */
+NCCHRomFS::NCCHRomFS(IDiscReader *reader, off64_t romfs_offset, off64_t romfs_size)
+	: d(new NCCHRomFSPrivate(reader, romfs_offset, romfs_size))
+{ }
+
+NCCHRomFS::~NCCHRomFS()
+{
+	assert(d->fstDirCount == 0);
+	delete d;
+}
+
+/**
+ * Is the FST open?
+ * @return True if open; false if not.
+ */
+bool NCCHRomFS::isOpen(void) const
+{
+	return (d->level3_size != 0);
+}
+
+/**
+ * Have any errors been detected in the FST?
+ * @return True if yes; false if no.
+ */
+bool NCCHRomFS::hasErrors(void) const
+{
+	return d->hasErrors;
+}
+
+/** opendir() interface **/
+
+/**
+ * Open a directory.
+ * @param path	[in] Directory path.
+ * @return IFst::Dir*, or nullptr on error.
+ */
+IFst::Dir *NCCHRomFS::opendir(const char *path)
+{
+	bool isDir = false;
+	string name;
+	const uint32_t offset = d->find_path(path, &isDir, &name);
+	if (offset == N3DS_ROMFS_NO_ENTRY || !isDir) {
+		// Not found, or not a directory.
+		return nullptr;
+	}
+
+	N3DS_RomFS_DirEntry_t entry;
+	u16string u16name;
+	if (d->readDirEntry(offset, &entry, u16name) != 0) {
+		return nullptr;
+	}
+
+	NCCHRomFSPrivate::RomFSDir *const dirp = new NCCHRomFSPrivate::RomFSDir(this);
+	d->fstDirCount++;
+	dirp->dir_idx = static_cast<int>(offset);
+	dirp->next_dir = le32_to_cpu(entry.first_child_offset);
+	dirp->next_file = le32_to_cpu(entry.first_file_offset);
+	dirp->name = std::move(name);
+
+	// Initialize the entry to this directory.
+	dirp->entry.ptnum = 0;	// not used for RomFS
+	dirp->entry.idx = dirp->dir_idx;
+	dirp->entry.type = DT_DIR;
+	dirp->entry.name = dirp->name.c_str();
+	// offset and size are not valid for directories.
+	dirp->entry.offset = 0;
+	dirp->entry.size = 0;
+
+	// Return the IFst::Dir*.
+	return dirp;
+}
+
+/**
+ * Read a directory entry.
+ * Subdirectories are returned first, followed by files.
+ * @param dirp Dir pointer.
+ * @return IFst::DirEnt*, or nullptr if end of directory or on error.
+ * (TODO: Add lastError()?)
+ */
+IFst::DirEnt *NCCHRomFS::readdir(IFst::Dir *dirp)
+{
+	assert(dirp != nullptr);
+	assert(dirp->parent == this);
+	if (!dirp || dirp->parent != this) {
+		// No directory pointer, or the dirp
+		// doesn't belong to this IFst.
+		return nullptr;
+	}
+
+	NCCHRomFSPrivate::RomFSDir *const rdirp = static_cast<NCCHRomFSPrivate::RomFSDir*>(dirp);
+	u16string u16name;
+	if (rdirp->next_dir != N3DS_ROMFS_NO_ENTRY) {
+		// Next subdirectory.
+		N3DS_RomFS_DirEntry_t entry;
+		if (d->readDirEntry(rdirp->next_dir, &entry, u16name) != 0) {
+			rdirp->next_dir = N3DS_ROMFS_NO_ENTRY;
+			rdirp->next_file = N3DS_ROMFS_NO_ENTRY;
+			return nullptr;
+		}
+		rdirp->entry.idx = static_cast<int>(rdirp->next_dir);
+		rdirp->entry.type = DT_DIR;
+		// offset and size are not valid for directories.
+		rdirp->entry.offset = 0;
+		rdirp->entry.size = 0;
+
+		const uint32_t next = le32_to_cpu(entry.next_sibling_offset);
+		if (next != N3DS_ROMFS_NO_ENTRY && next <= rdirp->next_dir) {
+			// Seeking backwards? (or looping to the same entry)
+			d->hasErrors = true;
+			rdirp->next_dir = N3DS_ROMFS_NO_ENTRY;
+			rdirp->next_file = N3DS_ROMFS_NO_ENTRY;
+		} else {
+			rdirp->next_dir = next;
+		}
+	} else if (rdirp->next_file != N3DS_ROMFS_NO_ENTRY) {
+		// Next file.
+		N3DS_RomFS_FileEntry_t entry;
+		if (d->readFileEntry(rdirp->next_file, &entry, u16name) != 0) {
+			rdirp->next_file = N3DS_ROMFS_NO_ENTRY;
+			return nullptr;
+		}
+		rdirp->entry.idx = static_cast<int>(rdirp->next_file);
+		rdirp->entry.type = DT_REG;
+		rdirp->entry.offset = d->fileOffset(entry);
+		rdirp->entry.size = static_cast<off64_t>(le64_to_cpu(entry.data_size));
+
+		const uint32_t next = le32_to_cpu(entry.next_sibling_offset);
+		if (next != N3DS_ROMFS_NO_ENTRY && next <= rdirp->next_file) {
+			// Seeking backwards? (or looping to the same entry)
+			d->hasErrors = true;
+			rdirp->next_file = N3DS_ROMFS_NO_ENTRY;
+		} else {
+			rdirp->next_file = next;
+		}
+	} else {
+		// No more entries.
+		return nullptr;
+	}
+
+	if (u16name.empty()) {
+		// Empty name. This is invalid.
+		d->hasErrors = true;
+		rdirp->next_dir = N3DS_ROMFS_NO_ENTRY;
+		rdirp->next_file = N3DS_ROMFS_NO_ENTRY;
+		return nullptr;
+	}
+	rdirp->name = utf16_to_utf8(u16name.data(), static_cast<int>(u16name.size()));
+	rdirp->entry.ptnum = 0;	// not used for RomFS
+	rdirp->entry.name = rdirp->name.c_str();
+	return &rdirp->entry;
+}
+
+/**
+ * Close an opened directory.
+ * @param dirp Dir pointer.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int NCCHRomFS::closedir(IFst::Dir *dirp)
+{
+	assert(dirp != nullptr);
+	assert(dirp->parent == this);
+	if (!dirp) {
+		// No directory pointer.
+		// In release builds, this is a no-op.
+		return 0;
+	} else if (dirp->parent != this) {
+		// The dirp doesn't belong to this IFst.
+		return -EINVAL;
+	}
+
+	assert(d->fstDirCount > 0);
+	delete static_cast<NCCHRomFSPrivate::RomFSDir*>(dirp);
+	d->fstDirCount--;
+	return 0;
+}
+
+/**
+ * Get the directory entry for the specified file.
+ *
+ * NOTE: dirent->name is valid until the next call to find_file().
+ * DirEnt offsets are relative to the IDiscReader.
+ *
+ * @param filename	[in] Filename.
+ * @param dirent	[out] Pointer to DirEnt buffer.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int NCCHRomFS::find_file(const char *filename, DirEnt *dirent)
+{
+	if (!filename || !dirent) {
+		// Invalid parameters.
+		return -EINVAL;
+	}
+
+	bool isDir = false;
+	const uint32_t offset = d->find_path(filename, &isDir, &d->find_name);
+	if (offset == N3DS_ROMFS_NO_ENTRY) {
+		// Not found.
+		return -ENOENT;
+	}
+
+	// Copy the relevant information to dirent.
+	dirent->ptnum = 0;	// not used for RomFS
+	dirent->idx = static_cast<int>(offset);
+	dirent->type = isDir ? DT_DIR : DT_REG;
+	dirent->name = d->find_name.c_str();
+	if (isDir) {
+		// offset and size are not valid for directories.
+		dirent->offset = 0;
+		dirent->size = 0;
+	} else {
+		// Save the offset and size.
+		N3DS_RomFS_FileEntry_t entry;
+		u16string u16name;
+		int ret = d->readFileEntry(offset, &entry, u16name);
+		if (ret != 0) {
+			return ret;
+		}
+		dirent->offset = d->fileOffset(entry);
+		dirent->size = static_cast<off64_t>(le64_to_cpu(entry.data_size));
+	}
+
+	return 0;
+}
+
+}
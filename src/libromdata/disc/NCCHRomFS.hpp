@@ -0,0 +1,97 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata)                       *
+ * NCCHRomFS.hpp: Nintendo 3DS NCCH RomFS parser.                          *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+#include "librpbase/disc/IFst.hpp"
+#include "librpbase/disc/IDiscReader.hpp"
+
+namespace LibRomData {
+
+class NCCHRomFSPrivate;
+class NCCHRomFS final : public LibRpBase::IFst
+{
+public:
+	/**
+	 * Parse an NCCH RomFS.
+	 *
+	 * Only the IVFC and level 3 headers are read here.
+	 * Directory and file metadata is read on demand.
+	 *
+	 * NOTE: The IDiscReader *must* remain valid while this
+	 * NCCHRomFS is open. Reads must be a multiple of 16 bytes,
+	 * so this works with encrypted NCCHs.
+	 *
+	 * @param reader	[in] IDiscReader, e.g. NCCHReader
+	 * @param romfs_offset	[in] RomFS offset within the IDiscReader
+	 * @param romfs_size	[in] RomFS size
+	 */
+	NCCHRomFS(LibRpBase::IDiscReader *reader, off64_t romfs_offset, off64_t romfs_size);
+
+	~NCCHRomFS() final;
+
+private:
+	typedef IFst super;
+	RP_DISABLE_COPY(NCCHRomFS)
+
+private:
+	friend class NCCHRomFSPrivate;
+	NCCHRomFSPrivate *const d;
+
+public:
+	/**
+	 * Is the FST open?
+	 * @return True if open; false if not.
+	 */
+	bool isOpen(void) const final;
+
+	/**
+	 * Have any errors been detected in the FST?
+	 * @return True if yes; false if no.
+	 */
+	bool hasErrors(void) const final;
+
+public:
+	/** opendir() interface **/
+
+	/**
+	 * Open a directory.
+	 * @param path	[in] Directory path.
+	 * @return Dir*, or nullptr on error.
+	 */
+	Dir *opendir(const char *path) final;
+
+	/**
+	 * Read a directory entry.
+	 * @param dirp Dir pointer.
+	 * @return DirEnt*, or nullptr if end of directory or on error.
+	 * (TODO: Add lastError()?)
+	 */
+	DirEnt *readdir(Dir *dirp) final;
+
+	/**
+	 * Close an opened directory.
+	 * @param dirp Dir pointer.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int closedir(Dir *dirp) final;
+
+	/**
+	 * Get the directory entry for the specified file.
+	 *
+	 * NOTE: dirent->name is valid until the next call to find_file().
+	 * DirEnt offsets are relative to the IDiscReader.
+	 *
+	 * @param filename	[in] Filename.
+	 * @param dirent	[out] Pointer to DirEnt buffer.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int find_file(const char *filename, DirEnt *dirent) final;
+};
+
+}
@@ -82,7 +82,10 @@ WbfsReaderPrivate::WbfsReaderPrivate(WbfsReader *q)
 	, m_wbfs(nullptr)
 	, m_wbfs_disc(nullptr)
 	, wlba_table(nullptr)
-{ }
+{
+	// Blocks are stored uncompressed.
+	physBlockAddrs = true;
+}
 
 WbfsReaderPrivate::~WbfsReaderPrivate()
 {
@@ -189,7 +192,9 @@ wbfs_t *WbfsReaderPrivate::readWbfsHeader(void)
 	}
 
 	// Save the wbfs_head_t in the wbfs_t struct.
+	// The header is only read once, so its pages aren't needed anymore.
 	p->head = head;
+	q->m_file->advise(0, hd_sec_sz, IRpFile::AH_DONTNEED);
 
 	// Constants.
 	p->wii_sec_sz = 0x8000;
@@ -266,8 +271,13 @@ wbfs_disc_t *WbfsReaderPrivate::openWbfsDisc(wbfs_t *p, uint32_t index)
 					free(disc);
 					return nullptr;
 				}
-				size_t size = q->m_file->seekAndRead((p->hd_sec_sz + (i*p->disc_info_sz)),
-					disc->header, p->disc_info_sz);
+				// The disc information includes the wlba table,
+				// so let the OS start reading all of it now.
+				const off64_t disc_info_pos = p->hd_sec_sz + (i*p->disc_info_sz);
+				q->m_file->advise(disc_info_pos, p->disc_info_sz, IRpFile::AH_WILLNEED);
+				size_t size = q->m_file->seekAndRead(disc_info_pos, disc->header, p->disc_info_sz);
+				// The disc information is only read once.
+				q->m_file->advise(disc_info_pos, p->disc_info_sz, IRpFile::AH_DONTNEED);
 				if (size != p->disc_info_sz) {
 					// Error reading the disc information.
 					free(disc->header);
@@ -0,0 +1,1589 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata)                       *
+ * WiaReader.cpp: GameCube/Wii WIA and RVZ disc image reader.              *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// References:
+// - https://github.com/dolphin-emu/dolphin/blob/master/docs/WiaAndRvz.md
+// - https://github.com/dolphin-emu/dolphin/blob/master/Source/Core/DiscIO/WIABlob.cpp
+// - https://github.com/dolphin-emu/dolphin/blob/master/Source/Core/DiscIO/WIACompression.cpp
+
+#include "stdafx.h"
+#include "config.libromdata.h"
+#include "librpbase/config.librpbase.h"
+
+#include "WiaReader.hpp"
+#include "librpbase/disc/SparseDiscReader_p.hpp"
+#include "wia_structs.h"
+
+#ifdef ENABLE_DECRYPTION
+#  include "librpbase/crypto/Hash.hpp"
+#endif /* ENABLE_DECRYPTION */
+
+// bzip2
+#ifdef HAVE_BZIP2
+#  include <bzlib.h>
+#endif /* HAVE_BZIP2 */
+
+// zstd
+#ifdef HAVE_ZSTD
+#  include <zstd.h>
+#endif /* HAVE_ZSTD */
+
+// liblzma
+#ifdef HAVE_LZMA
+#  include <lzma.h>
+#endif /* HAVE_LZMA */
+
+// librpthreads
+#include "librpthreads/Mutex.hpp"
+using LibRpThreads::Mutex;
+using LibRpThreads::MutexLocker;
+
+// Other rom-properties libraries
+using namespace LibRpBase;
+using namespace LibRpFile;
+
+// C++ STL classes
+using std::unique_ptr;
+using std::vector;
+
+namespace LibRomData {
+
+class WiaReaderPrivate final : public SparseDiscReaderPrivate
+{
+public:
+	explicit WiaReaderPrivate(WiaReader *q);
+
+private:
+	typedef SparseDiscReaderPrivate super;
+	RP_DISABLE_COPY(WiaReaderPrivate)
+
+public:
+	// Wii sector layout
+	static constexpr unsigned int SECTOR_SIZE = 0x8000;
+	static constexpr unsigned int SECTOR_HASH_SIZE = 0x400;
+	static constexpr unsigned int SECTOR_DATA_SIZE = SECTOR_SIZE - SECTOR_HASH_SIZE;
+	static constexpr unsigned int SECTORS_PER_WII_GROUP = 64;
+	static constexpr unsigned int SECTORS_PER_SUBGROUP = 8;
+
+	// Hash area layout
+	static constexpr unsigned int H0_OFFSET = 0x000;
+	static constexpr unsigned int H0_SIZE = 31 * 20;
+	static constexpr unsigned int H1_OFFSET = 0x280;
+	static constexpr unsigned int H1_SIZE = 8 * 20;
+	static constexpr unsigned int H2_OFFSET = 0x340;
+	static constexpr unsigned int H2_SIZE = 8 * 20;
+
+	// Maximum number of exceptions in a single list:
+	// one for each hash in a Wii group.
+	static constexpr unsigned int EXCEPTIONS_PER_LIST_MAX = SECTORS_PER_WII_GROUP * (31 + 8 + 8);
+
+	// Table limits
+	static constexpr unsigned int MAX_PARTITIONS = 64;
+	static constexpr unsigned int MAX_RAW_DATA = 65536;
+	static constexpr unsigned int MAX_GROUPS = 1024U * 1024U;
+
+	// Headers (byteswapped to host-endian)
+	WIA_FileHeader wiaHeader;
+	WIA_Disc wiaDisc;
+	WiaReader::DiscFormat discFormat;
+
+	// Data entries, sorted by end offset.
+	// Raw data entries start on a sector boundary, and partition
+	// data entries cover entire sectors.
+	struct DataEntry {
+		uint64_t start;		// Disc offset of the first group
+		uint64_t end;		// Disc offset of the end of the data
+		uint32_t group_index;	// First group index
+		uint32_t n_groups;	// Number of groups
+		int partIdx;		// Partition index (-1 for raw data)
+	};
+	vector<DataEntry> dataEntries;
+
+	// First sector of each partition's data.
+	// Hash groups are aligned relative to this sector.
+	vector<uint32_t> partFirstSector;
+
+	// Group table
+	struct GroupEntry {
+		uint64_t offset;		// File offset
+		uint32_t size;			// Stored size (0 == all zeroes)
+		uint32_t rvz_packed_size;	// RVZ: Size before unpacking (0 if not packed)
+		bool compressed;		// False for RVZ groups stored as-is
+	};
+	vector<GroupEntry> groups;
+
+	// Hash exception, relative to the start of a group.
+	struct Exception {
+		uint16_t sector;	// Sector index within the group
+		uint16_t offset;	// Offset within the sector's hash area
+		uint8_t hash[20];
+	};
+
+	// Group cache
+	// Groups are usually much larger than a sector, so
+	// decompressed groups are cached here instead of by
+	// SparseDiscReader.
+	static constexpr unsigned int GROUP_CACHE_SIZE = 8U * 1024U * 1024U;
+	struct CachedGroup {
+		uint32_t groupIdx;	// Group index (~0U if empty)
+		uint64_t lastUsed;	// LRU counter value at last use
+		rp::uvector<uint8_t> data;
+		vector<Exception> exceptions;
+	};
+	vector<CachedGroup> groupCache;
+	unsigned int maxCachedGroups;
+	uint64_t groupLruCounter;
+	Mutex groupCacheMutex;
+
+#ifdef ENABLE_DECRYPTION
+	// Calculated hashes for the last Wii group that had
+	// its hash area read. Exceptions aren't applied here,
+	// since H1 and H2 are calculated from the original hashes.
+	struct HashCache {
+		int partIdx;		// Partition index (-1 if empty)
+		uint32_t wiiGroup;	// Wii group index within the partition
+		uint64_t h0valid;	// Bitfield: H0 hashes calculated for each sector
+		uint8_t h1valid;	// Bitfield: H1 hashes calculated for each subgroup
+		uint8_t h0[SECTORS_PER_WII_GROUP][H0_SIZE];
+		uint8_t h1[SECTORS_PER_WII_GROUP / SECTORS_PER_SUBGROUP][H1_SIZE];
+	};
+	unique_ptr<HashCache> hashCache;
+#endif /* ENABLE_DECRYPTION */
+
+public:
+	/**
+	 * Is this an RVZ image?
+	 * @return True if RVZ; false if WIA.
+	 */
+	inline bool isRvz(void) const
+	{
+		return (discFormat == WiaReader::DiscFormat::RVZ);
+	}
+
+	/**
+	 * Get the decompressed group size for partition data.
+	 * Partition data doesn't include the hash area.
+	 * @return Decompressed group size for partition data
+	 */
+	inline unsigned int partChunkSize(void) const
+	{
+		return (wiaDisc.chunk_size / SECTOR_SIZE) * SECTOR_DATA_SIZE;
+	}
+
+	/**
+	 * Read and decompress a table, e.g. the raw data or group table.
+	 * Tables use the disc's compression method.
+	 * @param offset	[in] File offset
+	 * @param src_len	[in] Compressed size
+	 * @param dest		[out] Output buffer
+	 * @param dest_len	[in] Decompressed size
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int readTable(uint64_t offset, uint32_t src_len, uint8_t *dest, size_t dest_len);
+
+	/**
+	 * Load the partition, raw data, and group tables.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int loadTables(void);
+
+	/**
+	 * Find the data entry containing a disc offset.
+	 * @param offset Disc offset
+	 * @return First data entry that ends after offset, or nullptr if none.
+	 */
+	const DataEntry *findDataEntry(uint64_t offset) const;
+
+	/**
+	 * Find the partition data entry containing a sector.
+	 * @param partIdx	[in] Partition index
+	 * @param sector	[in] Disc sector
+	 * @return Data entry, or nullptr if the sector isn't partition data.
+	 */
+	const DataEntry *findPartitionEntry(int partIdx, uint32_t sector) const;
+
+	/**
+	 * Read and decompress a group.
+	 * @param groupIdx	[in] Group index
+	 * @param dec_size	[in] Decompressed size, not including exception lists
+	 * @param n_lists	[in] Number of exception lists (0 for raw data)
+	 * @param data_offset	[in] Offset of the group within its data entry (for RVZ junk data)
+	 * @param group		[out] Cached group
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int readGroup(uint32_t groupIdx, size_t dec_size, unsigned int n_lists,
+		uint64_t data_offset, CachedGroup &group);
+
+	/**
+	 * Get a group from the group cache, reading it if necessary.
+	 * NOTE: groupCacheMutex must be locked by the caller.
+	 * @param entry	[in] Data entry
+	 * @param i	[in] Group index within the data entry
+	 * @param pErr	[out] Error code on error
+	 * @return Cached group, or nullptr on error.
+	 */
+	const CachedGroup *getCachedGroup(const DataEntry &entry, uint32_t i, int *pErr);
+
+	/**
+	 * Read raw (non-partition) data.
+	 * NOTE: groupCacheMutex must be locked by the caller.
+	 * @param entry		[in] Raw data entry
+	 * @param offset	[in] Disc offset
+	 * @param ptr		[out] Output buffer
+	 * @param size		[in] Size (must be within the data entry)
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int readRawData(const DataEntry &entry, uint64_t offset, uint8_t *ptr, size_t size);
+
+	/**
+	 * Read data from a partition sector, not including the hash area.
+	 * NOTE: groupCacheMutex must be locked by the caller.
+	 * @param entry		[in] Partition data entry
+	 * @param sector	[in] Disc sector
+	 * @param pos		[in] Starting position within the sector data
+	 * @param ptr		[out] Output buffer
+	 * @param size		[in] Size (pos + size <= SECTOR_DATA_SIZE)
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int readPartitionData(const DataEntry &entry, uint32_t sector, unsigned int pos, uint8_t *ptr, size_t size);
+
+	/**
+	 * Reconstruct the hash area of a partition sector.
+	 * Only the hashes that are actually requested are calculated.
+	 * NOTE: groupCacheMutex must be locked by the caller.
+	 * @param entry		[in] Partition data entry
+	 * @param sector	[in] Disc sector
+	 * @param pos		[in] Starting position within the hash area
+	 * @param ptr		[out] Output buffer
+	 * @param size		[in] Size (pos + size <= SECTOR_HASH_SIZE)
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int readHashArea(const DataEntry &entry, uint32_t sector, unsigned int pos, uint8_t *ptr, size_t size);
+
+#ifdef ENABLE_DECRYPTION
+	/**
+	 * Calculate the H0 hashes for a sector in the cached Wii group.
+	 * NOTE: groupCacheMutex must be locked by the caller.
+	 * @param sha1	[in] SHA-1 hash object
+	 * @param j	[in] Sector index within the Wii group
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int calcH0(Hash &sha1, unsigned int j);
+
+	/**
+	 * Calculate the H1 hashes for a subgroup in the cached Wii group.
+	 * NOTE: groupCacheMutex must be locked by the caller.
+	 * @param sha1	[in] SHA-1 hash object
+	 * @param sg	[in] Subgroup index within the Wii group
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int calcH1(Hash &sha1, unsigned int sg);
+#endif /* ENABLE_DECRYPTION */
+
+public:
+	/** Codecs **/
+
+	/**
+	 * Decompress data.
+	 * The decompressed size doesn't need to be known in advance,
+	 * since exception lists have a variable size.
+	 * @param compression	[in] Compression method (see WIA_Compression_e; not PURGE)
+	 * @param src		[in] Compressed data
+	 * @param src_len	[in] Size of src
+	 * @param dest		[out] Output buffer
+	 * @param dest_len	[in] Size of dest
+	 * @return Decompressed size on success; negative POSIX error code on error.
+	 */
+	int decompress(uint32_t compression, const uint8_t *src, size_t src_len, uint8_t *dest, size_t dest_len) const;
+
+	/**
+	 * Decompress PURGE data.
+	 * Each segment has a 32-bit offset and a 32-bit size, followed by
+	 * the segment data. Anything not covered by a segment is zero.
+	 * A SHA-1 hash follows the last segment.
+	 * @param src		[in] PURGE data
+	 * @param src_len	[in] Size of src
+	 * @param dest		[out] Output buffer
+	 * @param dest_len	[in] Decompressed size
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	static int decompressPurge(const uint8_t *src, size_t src_len, uint8_t *dest, size_t dest_len);
+
+	/**
+	 * Decode RVZ-packed data.
+	 * @param src		[in] Packed data
+	 * @param src_len	[in] Size of src
+	 * @param dest		[out] Output buffer
+	 * @param dest_len	[in] Decoded size
+	 * @param data_offset	[in] Offset of dest within its data entry
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	static int rvzUnpack(const uint8_t *src, size_t src_len, uint8_t *dest, size_t dest_len, uint64_t data_offset);
+};
+
+/** Internal helper classes **/
+
+namespace {
+
+/**
+ * Lagged Fibonacci generator for RVZ junk data.
+ * This is the same generator used to create the padding
+ * on retail GameCube and Wii discs.
+ */
+class RvzLfg
+{
+	public:
+		RvzLfg() = default;
+
+	private:
+		static constexpr size_t BUFFER_BYTES = RVZ_LFG_K * sizeof(uint32_t);
+
+	public:
+		/**
+		 * Set the seed.
+		 * @param seed Seed (RVZ_LFG_SEED_SIZE big-endian 32-bit words)
+		 */
+		void setSeed(const uint8_t *seed)
+		{
+			for (unsigned int i = 0; i < RVZ_LFG_SEED_SIZE; i++, seed += 4) {
+				m_buffer[i] = (static_cast<uint32_t>(seed[0]) << 24) |
+				              (static_cast<uint32_t>(seed[1]) << 16) |
+				              (static_cast<uint32_t>(seed[2]) <<  8) |
+				               static_cast<uint32_t>(seed[3]);
+			}
+			for (unsigned int i = RVZ_LFG_SEED_SIZE; i < RVZ_LFG_K; i++) {
+				m_buffer[i] = (m_buffer[i - 17] << 23) ^ (m_buffer[i - 16] >> 9) ^ m_buffer[i - 1];
+			}
+
+			// The output uses bits 18-25 instead of 16-23 for the
+			// second byte. Adjust for that here, and store the words
+			// in big-endian so the buffer can be copied as-is.
+			for (uint32_t &x : m_buffer) {
+				x = cpu_to_be32((x & 0xFF00FFFFU) | ((x >> 2) & 0x00FF0000U));
+			}
+			for (unsigned int i = 0; i < 4; i++) {
+				forward();
+			}
+			m_position = 0;
+		}
+
+		/**
+		 * Skip ahead in the output.
+		 * @param count Number of bytes to skip
+		 */
+		void forward(size_t count)
+		{
+			m_position += count;
+			while (m_position >= BUFFER_BYTES) {
+				forward();
+				m_position -= BUFFER_BYTES;
+			}
+		}
+
+		/**
+		 * Get bytes from the generator.
+		 * @param out Output buffer
+		 * @param count Number of bytes
+		 */
+		void getBytes(uint8_t *out, size_t count)
+		{
+			const uint8_t *const buf8 = reinterpret_cast<const uint8_t*>(m_buffer);
+			while (count > 0) {
+				const size_t len = std::min(count, BUFFER_BYTES - m_position);
+				memcpy(out, &buf8[m_position], len);
+				out += len;
+				count -= len;
+				m_position += len;
+				if (m_position == BUFFER_BYTES) {
+					forward();
+					m_position = 0;
+				}
+			}
+		}
+
+	private:
+		/**
+		 * Advance the generator by one buffer.
+		 * NOTE: The buffer is big-endian, but XOR doesn't care.
+		 */
+		void forward(void)
+		{
+			for (unsigned int i = 0; i < RVZ_LFG_J; i++) {
+				m_buffer[i] ^= m_buffer[i + RVZ_LFG_K - RVZ_LFG_J];
+			}
+			for (unsigned int i = RVZ_LFG_J; i < RVZ_LFG_K; i++) {
+				m_buffer[i] ^= m_buffer[i - RVZ_LFG_J];
+			}
+		}
+
+	private:
+		uint32_t m_buffer[RVZ_LFG_K];
+		size_t m_position;
+};
+
+}
+
+/** WiaReaderPrivate **/
+
+WiaReaderPrivate::WiaReaderPrivate(WiaReader *q)
+	: super(q)
+	, discFormat(WiaReader::DiscFormat::Unknown)
+	, maxCachedGroups(0)
+	, groupLruCounter(0)
+{
+	// Clear the WIA header structs.
+	memset(&wiaHeader, 0, sizeof(wiaHeader));
+	memset(&wiaDisc, 0, sizeof(wiaDisc));
+}
+
+/**
+ * Read and decompress a table, e.g. the raw data or group table.
+ * Tables use the disc's compression method.
+ * @param offset	[in] File offset
+ * @param src_len	[in] Compressed size
+ * @param dest		[out] Output buffer
+ * @param dest_len	[in] Decompressed size
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int WiaReaderPrivate::readTable(uint64_t offset, uint32_t src_len, uint8_t *dest, size_t dest_len)
+{
+	if (dest_len == 0) {
+		// Empty table.
+		return 0;
+	}
+
+	const uint32_t compression = wiaDisc.compression;
+	if (compression == WIA_COMPRESSION_NONE) {
+		if (src_len < dest_len) {
+			return -EIO;
+		}
+		return (readFileAt(static_cast<off64_t>(offset), dest, dest_len) == dest_len ? 0 : -EIO);
+	}
+
+	if (src_len == 0 || src_len > dest_len + 64U * 1024U) {
+		// Compressed size is out of range.
+		return -EIO;
+	}
+	rp::uvector<uint8_t> z_buffer(src_len);
+	if (readFileAt(static_cast<off64_t>(offset), z_buffer.data(), src_len) != src_len) {
+		return -EIO;
+	}
+
+	if (compression == WIA_COMPRESSION_PURGE) {
+		return decompressPurge(z_buffer.data(), src_len, dest, dest_len);
+	}
+	const int ret = decompress(compression, z_buffer.data(), src_len, dest, dest_len);
+	if (ret < 0) {
+		return ret;
+	}
+	return (static_cast<size_t>(ret) == dest_len ? 0 : -EIO);
+}
+
+/**
+ * Load the partition, raw data, and group tables.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int WiaReaderPrivate::loadTables(void)
+{
+	const uint64_t iso_file_size = wiaHeader.iso_file_size;
+
+	// Partition table (uncompressed)
+	if (wiaDisc.n_part > MAX_PARTITIONS) {
+		return -ENOMEM;
+	}
+	vector<WIA_Partition> partitions(wiaDisc.n_part);
+	if (wiaDisc.n_part > 0) {
+		if (wiaDisc.part_t_size < sizeof(WIA_Partition) || wiaDisc.part_t_size > 1024) {
+			return -EIO;
+		}
+		const size_t part_tbl_size = static_cast<size_t>(wiaDisc.n_part) * wiaDisc.part_t_size;
+		rp::uvector<uint8_t> part_tbl(part_tbl_size);
+		if (readFileAt(static_cast<off64_t>(wiaDisc.part_off), part_tbl.data(), part_tbl_size) != part_tbl_size) {
+			return -EIO;
+		}
+		for (unsigned int i = 0; i < wiaDisc.n_part; i++) {
+			memcpy(&partitions[i], &part_tbl[i * wiaDisc.part_t_size], sizeof(WIA_Partition));
+		}
+	}
+
+	// Raw data table
+	if (wiaDisc.n_raw_data > MAX_RAW_DATA) {
+		return -ENOMEM;
+	}
+	vector<WIA_RawData> rawData(wiaDisc.n_raw_data);
+	int ret = readTable(wiaDisc.raw_data_off, wiaDisc.raw_data_size,
+		reinterpret_cast<uint8_t*>(rawData.data()), rawData.size() * sizeof(WIA_RawData));
+	if (ret != 0) {
+		return ret;
+	}
+
+	// Group table
+	if (wiaDisc.n_groups > MAX_GROUPS) {
+		return -ENOMEM;
+	}
+	const unsigned int group_entry_size = (isRvz() ? sizeof(RVZ_Group) : sizeof(WIA_Group));
+	rp::uvector<uint8_t> group_tbl(static_cast<size_t>(wiaDisc.n_groups) * group_entry_size);
+	ret = readTable(wiaDisc.group_off, wiaDisc.group_size, group_tbl.data(), group_tbl.size());
+	if (ret != 0) {
+		return ret;
+	}
+	groups.resize(wiaDisc.n_groups);
+	for (unsigned int i = 0; i < wiaDisc.n_groups; i++) {
+		// NOTE: WIA_Group is the first part of RVZ_Group.
+		const uint8_t *const p = &group_tbl[i * group_entry_size];
+		const WIA_Group *const wiaGroup = reinterpret_cast<const WIA_Group*>(p);
+		GroupEntry &group = groups[i];
+		group.offset = static_cast<uint64_t>(be32_to_cpu(wiaGroup->data_off4)) << 2;
+		group.size = be32_to_cpu(wiaGroup->data_size);
+		group.rvz_packed_size = 0;
+		group.compressed = true;
+		if (isRvz()) {
+			const RVZ_Group *const rvzGroup = reinterpret_cast<const RVZ_Group*>(p);
+			group.compressed = !!(group.size & RVZ_GROUP_COMPRESSED);
+			group.size &= ~RVZ_GROUP_COMPRESSED;
+			group.rvz_packed_size = be32_to_cpu(rvzGroup->rvz_packed_size);
+		}
+	}
+
+	// Build the data entry list.
+	const uint32_t n_groups = wiaDisc.n_groups;
+	auto checkGroups = [n_groups](uint32_t group_index, uint32_t count) -> bool {
+		return (group_index <= n_groups && count <= n_groups - group_index);
+	};
+
+	for (const WIA_RawData &raw : rawData) {
+		const uint64_t off = be64_to_cpu(raw.raw_data_off);
+		const uint64_t size = be64_to_cpu(raw.raw_data_size);
+		if (size == 0) {
+			continue;
+		}
+
+		DataEntry entry;
+		entry.start = off - (off % SECTOR_SIZE);
+		entry.end = off + size;
+		entry.group_index = be32_to_cpu(raw.group_index);
+		entry.n_groups = be32_to_cpu(raw.n_groups);
+		entry.partIdx = -1;
+		if (entry.end < off || entry.end > iso_file_size ||
+		    !checkGroups(entry.group_index, entry.n_groups))
+		{
+			return -EIO;
+		}
+		dataEntries.push_back(entry);
+	}
+
+	partFirstSector.resize(partitions.size());
+	for (unsigned int i = 0; i < partitions.size(); i++) {
+		const WIA_Partition &part = partitions[i];
+		partFirstSector[i] = be32_to_cpu(part.pd[0].first_sector);
+		for (const WIA_PartitionData &pd : part.pd) {
+			const uint32_t first_sector = be32_to_cpu(pd.first_sector);
+			const uint32_t n_sectors = be32_to_cpu(pd.n_sectors);
+			if (n_sectors == 0) {
+				continue;
+			}
+
+			DataEntry entry;
+			entry.start = static_cast<uint64_t>(first_sector) * SECTOR_SIZE;
+			entry.end = entry.start + (static_cast<uint64_t>(n_sectors) * SECTOR_SIZE);
+			entry.group_index = be32_to_cpu(pd.group_index);
+			entry.n_groups = be32_to_cpu(pd.n_groups);
+			entry.partIdx = static_cast<int>(i);
+			if (first_sector < partFirstSector[i] || entry.end > iso_file_size ||
+			    !checkGroups(entry.group_index, entry.n_groups))
+			{
+				return -EIO;
+			}
+			dataEntries.push_back(entry);
+		}
+	}
+
+	std::sort(dataEntries.begin(), dataEntries.end(),
+		[](const DataEntry &a, const DataEntry &b) { return (a.end < b.end); });
+	return 0;
+}
+
+/**
+ * Find the data entry containing a disc offset.
+ * @param offset Disc offset
+ * @return First data entry that ends after offset, or nullptr if none.
+ */
+const WiaReaderPrivate::DataEntry *WiaReaderPrivate::findDataEntry(uint64_t offset) const
+{
+	auto iter = std::upper_bound(dataEntries.cbegin(), dataEntries.cend(), offset,
+		[](uint64_t offset, const DataEntry &entry) { return (offset < entry.end); });
+	return (iter != dataEntries.cend() ? &(*iter) : nullptr);
+}
+
+/**
+ * Find the partition data entry containing a sector.
+ * @param partIdx	[in] Partition index
+ * @param sector	[in] Disc sector
+ * @return Data entry, or nullptr if the sector isn't partition data.
+ */
+const WiaReaderPrivate::DataEntry *WiaReaderPrivate::findPartitionEntry(int partIdx, uint32_t sector) const
+{
+	const uint64_t offset = static_cast<uint64_t>(sector) * SECTOR_SIZE;
+	for (const DataEntry &entry : dataEntries) {
+		if (entry.partIdx == partIdx && offset >= entry.start && offset < entry.end) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * Read and decompress a group.
+ * @param groupIdx	[in] Group index
+ * @param dec_size	[in] Decompressed size, not including exception lists
+ * @param n_lists	[in] Number of exception lists (0 for raw data)
+ * @param data_offset	[in] Offset of the group within its data entry (for RVZ junk data)
+ * @param group		[out] Cached group
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int WiaReaderPrivate::readGroup(uint32_t groupIdx, size_t dec_size, unsigned int n_lists,
+	uint64_t data_offset, CachedGroup &group)
+{
+	assert(groupIdx < groups.size());
+	const GroupEntry &entry = groups[groupIdx];
+	group.data.resize(dec_size);
+	group.exceptions.clear();
+
+	if (entry.size == 0) {
+		// Group is all zeroes.
+		memset(group.data.data(), 0, dec_size);
+		return 0;
+	}
+
+	// Maximum size of the data once decompressed, including exception lists.
+	const bool isPacked = (entry.rvz_packed_size != 0);
+	if (isPacked && entry.rvz_packed_size > wiaDisc.chunk_size * 2) {
+		// Packed size is out of range.
+		return -EIO;
+	}
+	const size_t data_size = (isPacked ? entry.rvz_packed_size : dec_size);
+	const size_t max_size = data_size +
+		(n_lists * (sizeof(uint16_t) + (EXCEPTIONS_PER_LIST_MAX * sizeof(WIA_Exception))));
+	if (entry.size > max_size + 64U * 1024U) {
+		// Stored size is out of range.
+		return -EIO;
+	}
+
+	rp::uvector<uint8_t> z_buffer(entry.size);
+	if (readFileAt(static_cast<off64_t>(entry.offset), z_buffer.data(), entry.size) != entry.size) {
+		return -EIO;
+	}
+
+	// NOTE: Exception lists are only compressed if the data is
+	// actually compressed. Otherwise, they're stored as-is at the
+	// start of the group, padded to a multiple of 4 bytes.
+	const uint32_t compression = (entry.compressed ? wiaDisc.compression : static_cast<uint32_t>(WIA_COMPRESSION_NONE));
+	const bool comprExceptions = (compression > WIA_COMPRESSION_PURGE);
+
+	const uint8_t *src;
+	size_t src_len;
+	rp::uvector<uint8_t> dec_buffer;
+	if (comprExceptions) {
+		dec_buffer.resize(max_size);
+		const int ret = decompress(compression, z_buffer.data(), z_buffer.size(), dec_buffer.data(), max_size);
+		if (ret < 0) {
+			return ret;
+		}
+		src = dec_buffer.data();
+		src_len = static_cast<size_t>(ret);
+	} else {
+		src = z_buffer.data();
+		src_len = z_buffer.size();
+	}
+
+	// Exception lists
+	size_t pos = 0;
+	for (unsigned int i = 0; i < n_lists; i++) {
+		if (src_len - pos < sizeof(uint16_t)) {
+			return -EIO;
+		}
+		const unsigned int count = (src[pos] << 8) | src[pos + 1];
+		pos += sizeof(uint16_t);
+		if (count > EXCEPTIONS_PER_LIST_MAX || (src_len - pos) < count * sizeof(WIA_Exception)) {
+			return -EIO;
+		}
+
+		for (unsigned int j = 0; j < count; j++, pos += sizeof(WIA_Exception)) {
+			const WIA_Exception *const wiaExc = reinterpret_cast<const WIA_Exception*>(&src[pos]);
+			const unsigned int offset = be16_to_cpu(wiaExc->offset);
+			Exception exc;
+			exc.sector = static_cast<uint16_t>((i * SECTORS_PER_WII_GROUP) + (offset / SECTOR_HASH_SIZE));
+			exc.offset = static_cast<uint16_t>(offset % SECTOR_HASH_SIZE);
+			memcpy(exc.hash, wiaExc->hash, sizeof(exc.hash));
+			group.exceptions.push_back(exc);
+		}
+	}
+	if (n_lists > 0 && !comprExceptions) {
+		pos = ALIGN_BYTES(4, pos);
+		if (pos > src_len) {
+			return -EIO;
+		}
+	}
+	src += pos;
+	src_len -= pos;
+
+	// Group data
+	if (compression == WIA_COMPRESSION_PURGE) {
+		return decompressPurge(src, src_len, group.data.data(), dec_size);
+	} else if (isPacked) {
+		if (src_len < entry.rvz_packed_size) {
+			return -EIO;
+		}
+		return rvzUnpack(src, entry.rvz_packed_size, group.data.data(), dec_size, data_offset);
+	}
+
+	if (src_len < dec_size) {
+		return -EIO;
+	}
+	memcpy(group.data.data(), src, dec_size);
+	return 0;
+}
+
+/**
+ * Get a group from the group cache, reading it if necessary.
+ * NOTE: groupCacheMutex must be locked by the caller.
+ * @param entry	[in] Data entry
+ * @param i	[in] Group index within the data entry
+ * @param pErr	[out] Error code on error
+ * @return Cached group, or nullptr on error.
+ */
+const WiaReaderPrivate::CachedGroup *WiaReaderPrivate::getCachedGroup(const DataEntry &entry, uint32_t i, int *pErr)
+{
+	if (i >= entry.n_groups) {
+		// Group index is out of range.
+		*pErr = EIO;
+		return nullptr;
+	}
+	const uint32_t groupIdx = entry.group_index + i;
+
+	// Check if the group is cached.
+	// Also find the least-recently used group in case it isn't.
+	CachedGroup *lru = nullptr;
+	for (CachedGroup &group : groupCache) {
+		if (group.groupIdx == groupIdx) {
+			// Found the group.
+			group.lastUsed = ++groupLruCounter;
+			return &group;
+		}
+		if (!lru || group.lastUsed < lru->lastUsed) {
+			lru = &group;
+		}
+	}
+
+	if (groupCache.size() < maxCachedGroups) {
+		// Cache isn't full yet.
+		// NOTE: groupCache has maxCachedGroups reserved, so this won't reallocate.
+		groupCache.resize(groupCache.size() + 1);
+		lru = &groupCache.back();
+	}
+	assert(lru != nullptr);
+
+	// Determine the decompressed size.
+	size_t dec_size;
+	unsigned int n_lists;
+	uint64_t data_offset;
+	if (entry.partIdx < 0) {
+		// Raw data
+		const uint64_t chunk_size = wiaDisc.chunk_size;
+		data_offset = i * chunk_size;
+		dec_size = static_cast<size_t>(std::min(chunk_size, (entry.end - entry.start) - data_offset));
+		n_lists = 0;
+	} else {
+		// Partition data
+		// One exception list is stored for each Wii group.
+		const uint64_t chunk_size = partChunkSize();
+		const uint64_t part_data_size = ((entry.end - entry.start) / SECTOR_SIZE) * SECTOR_DATA_SIZE;
+		data_offset = i * chunk_size;
+		if (data_offset >= part_data_size) {
+			*pErr = EIO;
+			return nullptr;
+		}
+		dec_size = static_cast<size_t>(std::min(chunk_size, part_data_size - data_offset));
+		n_lists = std::max(1U, wiaDisc.chunk_size / (SECTORS_PER_WII_GROUP * SECTOR_SIZE));
+	}
+
+	// Read the group into the LRU slot.
+	lru->groupIdx = ~0U;
+	const int ret = readGroup(groupIdx, dec_size, n_lists, data_offset, *lru);
+	if (ret != 0) {
+		*pErr = -ret;
+		return nullptr;
+	}
+	lru->groupIdx = groupIdx;
+	lru->lastUsed = ++groupLruCounter;
+	return lru;
+}
+
+/**
+ * Read raw (non-partition) data.
+ * NOTE: groupCacheMutex must be locked by the caller.
+ * @param entry		[in] Raw data entry
+ * @param offset	[in] Disc offset
+ * @param ptr		[out] Output buffer
+ * @param size		[in] Size (must be within the data entry)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int WiaReaderPrivate::readRawData(const DataEntry &entry, uint64_t offset, uint8_t *ptr, size_t size)
+{
+	assert(offset >= entry.start && offset + size <= entry.end);
+	const uint64_t chunk_size = wiaDisc.chunk_size;
+	uint64_t rel = offset - entry.start;
+	while (size > 0) {
+		int err = 0;
+		const CachedGroup *const group = getCachedGroup(entry, static_cast<uint32_t>(rel / chunk_size), &err);
+		if (!group) {
+			return -err;
+		}
+
+		const size_t pos = static_cast<size_t>(rel % chunk_size);
+		if (pos >= group->data.size()) {
+			return -EIO;
+		}
+		const size_t len = std::min(size, group->data.size() - pos);
+		memcpy(ptr, &group->data[pos], len);
+		ptr += len;
+		size -= len;
+		rel += len;
+	}
+	return 0;
+}
+
+/**
+ * Read data from a partition sector, not including the hash area.
+ * NOTE: groupCacheMutex must be locked by the caller.
+ * @param entry		[in] Partition data entry
+ * @param sector	[in] Disc sector
+ * @param pos		[in] Starting position within the sector data
+ * @param ptr		[out] Output buffer
+ * @param size		[in] Size (pos + size <= SECTOR_DATA_SIZE)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int WiaReaderPrivate::readPartitionData(const DataEntry &entry, uint32_t sector, unsigned int pos, uint8_t *ptr, size_t size)
+{
+	assert(pos + size <= SECTOR_DATA_SIZE);
+	const unsigned int sectorsPerGroup = wiaDisc.chunk_size / SECTOR_SIZE;
+	const uint32_t idx = sector - static_cast<uint32_t>(entry.start / SECTOR_SIZE);
+
+	int err = 0;
+	const CachedGroup *const group = getCachedGroup(entry, idx / sectorsPerGroup, &err);
+	if (!group) {
+		return -err;
+	}
+
+	const size_t group_pos = ((idx % sectorsPerGroup) * SECTOR_DATA_SIZE) + pos;
+	assert(group_pos + size <= group->data.size());
+	memcpy(ptr, &group->data[group_pos], size);
+	return 0;
+}
+
+#ifdef ENABLE_DECRYPTION
+/**
+ * Calculate the H0 hashes for a sector in the cached Wii group.
+ * NOTE: groupCacheMutex must be locked by the caller.
+ * @param sha1	[in] SHA-1 hash object
+ * @param j	[in] Sector index within the Wii group
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int WiaReaderPrivate::calcH0(Hash &sha1, unsigned int j)
+{
+	assert(j < SECTORS_PER_WII_GROUP);
+	if (hashCache->h0valid & (1ULL << j)) {
+		// Already calculated.
+		return 0;
+	}
+
+	// Read the sector data.
+	// Sectors that aren't present are hashed as zeroes.
+	const int partIdx = hashCache->partIdx;
+	const uint32_t sector = partFirstSector[partIdx] + (hashCache->wiiGroup * SECTORS_PER_WII_GROUP) + j;
+	rp::uvector<uint8_t> data(SECTOR_DATA_SIZE);
+	const DataEntry *const entry = findPartitionEntry(partIdx, sector);
+	if (entry) {
+		const int ret = readPartitionData(*entry, sector, 0, data.data(), data.size());
+		if (ret != 0) {
+			return ret;
+		}
+	} else {
+		memset(data.data(), 0, data.size());
+	}
+
+	// H0: SHA-1 of each 1 KB block.
+	uint8_t *const h0 = hashCache->h0[j];
+	for (unsigned int i = 0; i < SECTOR_DATA_SIZE / 0x400; i++) {
+		sha1.reset();
+		sha1.process(&data[i * 0x400], 0x400);
+		sha1.getHash(&h0[i * 20], 20);
+	}
+	hashCache->h0valid |= (1ULL << j);
+	return 0;
+}
+
+/**
+ * Calculate the H1 hashes for a subgroup in the cached Wii group.
+ * NOTE: groupCacheMutex must be locked by the caller.
+ * @param sha1	[in] SHA-1 hash object
+ * @param sg	[in] Subgroup index within the Wii group
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int WiaReaderPrivate::calcH1(Hash &sha1, unsigned int sg)
+{
+	assert(sg < SECTORS_PER_WII_GROUP / SECTORS_PER_SUBGROUP);
+	if (hashCache->h1valid & (1U << sg)) {
+		// Already calculated.
+		return 0;
+	}
+
+	// H1: SHA-1 of each sector's H0 table.
+	uint8_t *const h1 = hashCache->h1[sg];
+	for (unsigned int i = 0; i < SECTORS_PER_SUBGROUP; i++) {
+		const unsigned int j = (sg * SECTORS_PER_SUBGROUP) + i;
+		const int ret = calcH0(sha1, j);
+		if (ret != 0) {
+			return ret;
+		}
+		sha1.reset();
+		sha1.process(hashCache->h0[j], H0_SIZE);
+		sha1.getHash(&h1[i * 20], 20);
+	}
+	hashCache->h1valid |= (1U << sg);
+	return 0;
+}
+#endif /* ENABLE_DECRYPTION */
+
+/**
+ * Reconstruct the hash area of a partition sector.
+ * Only the hashes that are actually requested are calculated.
+ * NOTE: groupCacheMutex must be locked by the caller.
+ * @param entry		[in] Partition data entry
+ * @param sector	[in] Disc sector
+ * @param pos		[in] Starting position within the hash area
+ * @param ptr		[out] Output buffer
+ * @param size		[in] Size (pos + size <= SECTOR_HASH_SIZE)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int WiaReaderPrivate::readHashArea(const DataEntry &entry, uint32_t sector, unsigned int pos, uint8_t *ptr, size_t size)
+{
+	assert(pos + size <= SECTOR_HASH_SIZE);
+	uint8_t hashArea[SECTOR_HASH_SIZE];
+	memset(hashArea, 0, sizeof(hashArea));
+
+#ifdef ENABLE_DECRYPTION
+	const int partIdx = entry.partIdx;
+	const uint32_t relSector = sector - partFirstSector[partIdx];
+	const uint32_t wiiGroup = relSector / SECTORS_PER_WII_GROUP;
+	const unsigned int j = relSector % SECTORS_PER_WII_GROUP;
+	const unsigned int sg = j / SECTORS_PER_SUBGROUP;
+
+	if (!hashCache) {
+		hashCache.reset(new HashCache);
+		hashCache->partIdx = -1;
+	}
+	if (hashCache->partIdx != partIdx || hashCache->wiiGroup != wiiGroup) {
+		// Different Wii group.
+		hashCache->partIdx = partIdx;
+		hashCache->wiiGroup = wiiGroup;
+		hashCache->h0valid = 0;
+		hashCache->h1valid = 0;
+	}
+
+	// Determine which hash levels were requested.
+	const unsigned int end = pos + static_cast<unsigned int>(size);
+	const bool needH0 = (pos < H0_OFFSET + H0_SIZE);
+	const bool needH1 = (pos < H1_OFFSET + H1_SIZE && end > H1_OFFSET);
+	const bool needH2 = (pos < H2_OFFSET + H2_SIZE && end > H2_OFFSET);
+
+	if (needH0 || needH1 || needH2) {
+		Hash sha1(Hash::Algorithm::SHA1);
+		if (!sha1.isUsable()) {
+			return -ENOTSUP;
+		}
+
+		if (needH0) {
+			const int ret = calcH0(sha1, j);
+			if (ret != 0) {
+				return ret;
+			}
+			memcpy(&hashArea[H0_OFFSET], hashCache->h0[j], H0_SIZE);
+		}
+		if (needH1) {
+			const int ret = calcH1(sha1, sg);
+			if (ret != 0) {
+				return ret;
+			}
+			memcpy(&hashArea[H1_OFFSET], hashCache->h1[sg], H1_SIZE);
+		}
+		if (needH2) {
+			// H2: SHA-1 of each subgroup's H1 table.
+			// This requires the entire Wii group.
+			for (unsigned int i = 0; i < SECTORS_PER_WII_GROUP / SECTORS_PER_SUBGROUP; i++) {
+				const int ret = calcH1(sha1, i);
+				if (ret != 0) {
+					return ret;
+				}
+				sha1.reset();
+				sha1.process(hashCache->h1[i], H1_SIZE);
+				sha1.getHash(&hashArea[H2_OFFSET + (i * 20)], 20);
+			}
+		}
+	}
+#endif /* ENABLE_DECRYPTION */
+
+	// Apply hash exceptions from the group containing this sector.
+	// NOTE: Without decryption support, SHA-1 isn't available, so
+	// only the exceptions will be present.
+	const unsigned int sectorsPerGroup = wiaDisc.chunk_size / SECTOR_SIZE;
+	const uint32_t idx = sector - static_cast<uint32_t>(entry.start / SECTOR_SIZE);
+	int err = 0;
+	const CachedGroup *const group = getCachedGroup(entry, idx / sectorsPerGroup, &err);
+	if (!group) {
+		return -err;
+	}
+	const unsigned int sectorInGroup = idx % sectorsPerGroup;
+	for (const Exception &exc : group->exceptions) {
+		if (exc.sector != sectorInGroup) {
+			continue;
+		}
+		const unsigned int len = std::min(static_cast<unsigned int>(sizeof(exc.hash)),
+			SECTOR_HASH_SIZE - exc.offset);
+		memcpy(&hashArea[exc.offset], exc.hash, len);
+	}
+
+	memcpy(ptr, &hashArea[pos], size);
+	return 0;
+}
+
+/** Codecs **/
+
+/**
+ * Decompress data.
+ * The decompressed size doesn't need to be known in advance,
+ * since exception lists have a variable size.
+ * @param compression	[in] Compression method (see WIA_Compression_e; not PURGE)
+ * @param src		[in] Compressed data
+ * @param src_len	[in] Size of src
+ * @param dest		[out] Output buffer
+ * @param dest_len	[in] Size of dest
+ * @return Decompressed size on success; negative POSIX error code on error.
+ */
+int WiaReaderPrivate::decompress(uint32_t compression, const uint8_t *src, size_t src_len, uint8_t *dest, size_t dest_len) const
+{
+	switch (compression) {
+		default:
+			// Unsupported compression method.
+			return -ENOTSUP;
+
+		case WIA_COMPRESSION_NONE: {
+			const size_t len = std::min(src_len, dest_len);
+			memcpy(dest, src, len);
+			return static_cast<int>(len);
+		}
+
+#ifdef HAVE_BZIP2
+		case WIA_COMPRESSION_BZIP2: {
+			bz_stream strm;
+			memset(&strm, 0, sizeof(strm));
+			if (BZ2_bzDecompressInit(&strm, 0, 0) != BZ_OK) {
+				return -ENOMEM;
+			}
+			strm.next_in = reinterpret_cast<char*>(const_cast<uint8_t*>(src));
+			strm.avail_in = static_cast<unsigned int>(src_len);
+			strm.next_out = reinterpret_cast<char*>(dest);
+			strm.avail_out = static_cast<unsigned int>(dest_len);
+			int status;
+			do {
+				status = BZ2_bzDecompress(&strm);
+			} while (status == BZ_OK && strm.avail_in > 0 && strm.avail_out > 0);
+			const size_t total_out = dest_len - strm.avail_out;
+			BZ2_bzDecompressEnd(&strm);
+			if (status != BZ_OK && status != BZ_STREAM_END) {
+				return -EIO;
+			}
+			return static_cast<int>(total_out);
+		}
+#endif /* HAVE_BZIP2 */
+
+#ifdef HAVE_LZMA
+		case WIA_COMPRESSION_LZMA:
+		case WIA_COMPRESSION_LZMA2: {
+			// Raw LZMA or LZMA2 stream.
+			// The filter properties are stored in the disc header.
+			lzma_filter filters[2] = {
+				{(compression == WIA_COMPRESSION_LZMA ? LZMA_FILTER_LZMA1 : LZMA_FILTER_LZMA2), nullptr},
+				{LZMA_VLI_UNKNOWN, nullptr},
+			};
+			if (lzma_properties_decode(&filters[0], nullptr,
+			    wiaDisc.compr_data, wiaDisc.compr_data_len) != LZMA_OK)
+			{
+				return -EIO;
+			}
+			lzma_stream strm = LZMA_STREAM_INIT;
+			const lzma_ret init_status = lzma_raw_decoder(&strm, filters);
+			free(filters[0].options);
+			if (init_status != LZMA_OK) {
+				return -ENOMEM;
+			}
+			strm.next_in = src;
+			strm.avail_in = src_len;
+			strm.next_out = dest;
+			strm.avail_out = dest_len;
+			lzma_ret status;
+			do {
+				status = lzma_code(&strm, LZMA_RUN);
+			} while (status == LZMA_OK && strm.avail_in > 0 && strm.avail_out > 0);
+			const uint64_t total_out = strm.total_out;
+			lzma_end(&strm);
+			if (status != LZMA_OK && status != LZMA_STREAM_END) {
+				return -EIO;
+			}
+			return static_cast<int>(total_out);
+		}
+#endif /* HAVE_LZMA */
+
+#ifdef HAVE_ZSTD
+		case WIA_COMPRESSION_ZSTD: {
+			const size_t ret = ZSTD_decompress(dest, dest_len, src, src_len);
+			if (ZSTD_isError(ret)) {
+				return -EIO;
+			}
+			return static_cast<int>(ret);
+		}
+#endif /* HAVE_ZSTD */
+	}
+}
+
+/**
+ * Decompress PURGE data.
+ * Each segment has a 32-bit offset and a 32-bit size, followed by
+ * the segment data. Anything not covered by a segment is zero.
+ * A SHA-1 hash follows the last segment.
+ * @param src		[in] PURGE data
+ * @param src_len	[in] Size of src
+ * @param dest		[out] Output buffer
+ * @param dest_len	[in] Decompressed size
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int WiaReaderPrivate::decompressPurge(const uint8_t *src, size_t src_len, uint8_t *dest, size_t dest_len)
+{
+	if (src_len < 20) {
+		// No room for the SHA-1 hash.
+		return -EIO;
+	}
+	src_len -= 20;
+
+	size_t out = 0;
+	while (src_len > 0) {
+		if (src_len < 8) {
+			return -EIO;
+		}
+		const uint32_t seg_offset = be32_to_cpu(*reinterpret_cast<const uint32_t*>(&src[0]));
+		const uint32_t seg_size = be32_to_cpu(*reinterpret_cast<const uint32_t*>(&src[4]));
+		src += 8;
+		src_len -= 8;
+		if (seg_offset < out || seg_offset > dest_len || seg_size > dest_len - seg_offset ||
+		    seg_size > src_len)
+		{
+			// Segments must be in order and within the output buffer.
+			return -EIO;
+		}
+
+		memset(&dest[out], 0, seg_offset - out);
+		memcpy(&dest[seg_offset], src, seg_size);
+		out = seg_offset + seg_size;
+		src += seg_size;
+		src_len -= seg_size;
+	}
+
+	memset(&dest[out], 0, dest_len - out);
+	return 0;
+}
+
+/**
+ * Decode RVZ-packed data.
+ * @param src		[in] Packed data
+ * @param src_len	[in] Size of src
+ * @param dest		[out] Output buffer
+ * @param dest_len	[in] Decoded size
+ * @param data_offset	[in] Offset of dest within its data entry
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int WiaReaderPrivate::rvzUnpack(const uint8_t *src, size_t src_len, uint8_t *dest, size_t dest_len, uint64_t data_offset)
+{
+	// Each record has a 32-bit size. If bit 31 is set, the record is
+	// junk data, and the size is followed by the generator's seed.
+	// Otherwise, the size is followed by the data itself.
+	static constexpr size_t SEED_BYTES = RVZ_LFG_SEED_SIZE * sizeof(uint32_t);
+	unique_ptr<RvzLfg> lfg;
+	size_t out = 0;
+	while (out < dest_len) {
+		if (src_len < sizeof(uint32_t)) {
+			return -EIO;
+		}
+		uint32_t size = be32_to_cpu(*reinterpret_cast<const uint32_t*>(src));
+		src += sizeof(uint32_t);
+		src_len -= sizeof(uint32_t);
+		const bool isJunk = !!(size & 0x80000000U);
+		size &= ~0x80000000U;
+		const size_t len = std::min(static_cast<size_t>(size), dest_len - out);
+
+		if (isJunk) {
+			if (src_len < SEED_BYTES) {
+				return -EIO;
+			}
+			if (!lfg) {
+				lfg.reset(new RvzLfg);
+			}
+			lfg->setSeed(src);
+			src += SEED_BYTES;
+			src_len -= SEED_BYTES;
+
+			// Junk data restarts every sector.
+			lfg->forward(static_cast<size_t>(data_offset % SECTOR_SIZE));
+			lfg->getBytes(&dest[out], len);
+		} else {
+			if (src_len < len) {
+				return -EIO;
+			}
+			memcpy(&dest[out], src, len);
+			src += len;
+			src_len -= len;
+		}
+
+		out += len;
+		data_offset += len;
+	}
+	return 0;
+}
+
+/** WiaReader **/
+
+WiaReader::WiaReader(const IRpFilePtr &file)
+	: super(new WiaReaderPrivate(this), file)
+{
+	if (!m_file) {
+		// File could not be ref()'d.
+		return;
+	}
+
+	// Read the WIA file header.
+	RP_D(WiaReader);
+	size_t sz = m_file->seekAndRead(0, &d->wiaHeader, sizeof(d->wiaHeader));
+	const int discFormat = isDiscSupported_static(reinterpret_cast<const uint8_t*>(&d->wiaHeader), sz);
+	if (sz != sizeof(d->wiaHeader) || discFormat < 0) {
+		// Error reading the WIA header, or not a supported WIA version.
+		m_file.reset();
+		m_lastError = EIO;
+		return;
+	}
+	d->discFormat = static_cast<DiscFormat>(discFormat);
+
+	// Byteswap the file header.
+	WIA_FileHeader *const hdr = &d->wiaHeader;
+	hdr->magic		= be32_to_cpu(hdr->magic);
+	hdr->version		= be32_to_cpu(hdr->version);
+	hdr->version_compatible	= be32_to_cpu(hdr->version_compatible);
+	hdr->disc_size		= be32_to_cpu(hdr->disc_size);
+	hdr->iso_file_size	= be64_to_cpu(hdr->iso_file_size);
+	hdr->wia_file_size	= be64_to_cpu(hdr->wia_file_size);
+
+	// Read the disc struct.
+	// NOTE: Older versions may have a shorter struct without compr_data.
+	static constexpr size_t WIA_DISC_MIN_SIZE = offsetof(WIA_Disc, compr_data);
+	if (hdr->disc_size < WIA_DISC_MIN_SIZE || hdr->iso_file_size == 0) {
+		m_file.reset();
+		m_lastError = EIO;
+		return;
+	}
+	const size_t disc_size = std::min(static_cast<size_t>(hdr->disc_size), sizeof(d->wiaDisc));
+	sz = m_file->seekAndRead(sizeof(*hdr), &d->wiaDisc, disc_size);
+	if (sz != disc_size) {
+		m_file.reset();
+		m_lastError = EIO;
+		return;
+	}
+
+	// Byteswap the disc struct.
+	// NOTE: dhead is left as-is.
+	WIA_Disc *const disc = &d->wiaDisc;
+	disc->disc_type		= be32_to_cpu(disc->disc_type);
+	disc->compression	= be32_to_cpu(disc->compression);
+	disc->compr_level	= be32_to_cpu(disc->compr_level);
+	disc->chunk_size	= be32_to_cpu(disc->chunk_size);
+	disc->n_part		= be32_to_cpu(disc->n_part);
+	disc->part_t_size	= be32_to_cpu(disc->part_t_size);
+	disc->part_off		= be64_to_cpu(disc->part_off);
+	disc->n_raw_data	= be32_to_cpu(disc->n_raw_data);
+	disc->raw_data_off	= be64_to_cpu(disc->raw_data_off);
+	disc->raw_data_size	= be32_to_cpu(disc->raw_data_size);
+	disc->n_groups		= be32_to_cpu(disc->n_groups);
+	disc->group_off		= be64_to_cpu(disc->group_off);
+	disc->group_size	= be32_to_cpu(disc->group_size);
+	if (disc->compr_data_len > sizeof(disc->compr_data)) {
+		disc->compr_data_len = sizeof(disc->compr_data);
+	}
+
+	// Validate the group size.
+	if (disc->chunk_size == 0 || (disc->chunk_size % WiaReaderPrivate::SECTOR_SIZE) != 0 ||
+	    disc->chunk_size > WIA_CHUNK_SIZE_MAX)
+	{
+		m_file.reset();
+		m_lastError = EIO;
+		return;
+	}
+
+	// Check if the compression method is supported.
+	bool isSupported;
+	switch (disc->compression) {
+		case WIA_COMPRESSION_NONE:
+			isSupported = true;
+			break;
+		case WIA_COMPRESSION_PURGE:
+			// PURGE isn't allowed in RVZ.
+			isSupported = !d->isRvz();
+			break;
+#ifdef HAVE_BZIP2
+		case WIA_COMPRESSION_BZIP2:
+			isSupported = true;
+			break;
+#endif /* HAVE_BZIP2 */
+#ifdef HAVE_LZMA
+		case WIA_COMPRESSION_LZMA:
+		case WIA_COMPRESSION_LZMA2:
+			isSupported = true;
+			break;
+#endif /* HAVE_LZMA */
+#ifdef HAVE_ZSTD
+		case WIA_COMPRESSION_ZSTD:
+			isSupported = true;
+			break;
+#endif /* HAVE_ZSTD */
+		default:
+			isSupported = false;
+			break;
+	}
+	if (!isSupported) {
+		// Unsupported compression method.
+		m_file.reset();
+		m_lastError = ENOTSUP;
+		return;
+	}
+
+	// Load the tables.
+	// NOTE: Groups are only decompressed when they're read.
+	const int ret = d->loadTables();
+	if (ret != 0) {
+		m_file.reset();
+		m_lastError = -ret;
+		return;
+	}
+
+	// Each block is a 32 KB sector.
+	// Groups are read from the group cache, so
+	// SparseDiscReader's block cache isn't needed.
+	d->block_size = WiaReaderPrivate::SECTOR_SIZE;
+	d->disc_size = static_cast<off64_t>(hdr->iso_file_size);
+	d->cacheSizeMB = 0;
+
+	// Initialize the group cache.
+	d->maxCachedGroups = std::max(2U, WiaReaderPrivate::GROUP_CACHE_SIZE / disc->chunk_size);
+	d->groupCache.reserve(d->maxCachedGroups);
+
+	// Reset the disc position.
+	d->pos = 0;
+}
+
+/**
+ * Is a disc image supported by this class?
+ * @param pHeader Disc image header.
+ * @param szHeader Size of header.
+ * @return Class-specific disc format ID (>= 0) if supported; -1 if not.
+ */
+int WiaReader::isDiscSupported_static(const uint8_t *pHeader, size_t szHeader)
+{
+	if (szHeader < sizeof(WIA_FileHeader)) {
+		// Not enough data to check.
+		return -1;
+	}
+
+	// Check the magic number.
+	const WIA_FileHeader *const wiaHeader = reinterpret_cast<const WIA_FileHeader*>(pHeader);
+	DiscFormat discFormat;
+	uint32_t version, version_read_compatible;
+	switch (be32_to_cpu(wiaHeader->magic)) {
+		case WIA_MAGIC:
+			discFormat = DiscFormat::WIA;
+			version = WIA_VERSION;
+			version_read_compatible = WIA_VERSION_READ_COMPATIBLE;
+			break;
+		case RVZ_MAGIC:
+			discFormat = DiscFormat::RVZ;
+			version = RVZ_VERSION;
+			version_read_compatible = RVZ_VERSION_READ_COMPATIBLE;
+			break;
+		default:
+			// Incorrect magic.
+			return -1;
+	}
+
+	// Check the version.
+	if (be32_to_cpu(wiaHeader->version_compatible) > version ||
+	    be32_to_cpu(wiaHeader->version) < version_read_compatible)
+	{
+		// Unsupported version.
+		return -1;
+	}
+
+	// This is a valid WIA or RVZ image.
+	return static_cast<int>(discFormat);
+}
+
+/**
+ * Is a disc image supported by this object?
+ * @param pHeader Disc image header.
+ * @param szHeader Size of header.
+ * @return Class-specific system ID (>= 0) if supported; -1 if not.
+ */
+int WiaReader::isDiscSupported(const uint8_t *pHeader, size_t szHeader) const
+{
+	return isDiscSupported_static(pHeader, szHeader);
+}
+
+/** SparseDiscReader functions **/
+
+/**
+ * Get the physical address of the specified logical block index.
+ *
+ * NOTE: Not implemented in this subclass.
+ *
+ * @param blockIdx	[in] Block index.
+ * @return Physical block address. (-1 due to not being implemented)
+ */
+off64_t WiaReader::getPhysBlockAddr(uint32_t blockIdx) const
+{
+	RP_UNUSED(blockIdx);
+	assert(!"WiaReader::getPhysBlockAddr() is not implemented.");
+	return -1;
+}
+
+/**
+ * Read the specified block.
+ *
+ * This can read either a full block or a partial block.
+ * For a full block, set pos = 0 and size = block_size.
+ *
+ * @param blockIdx	[in] Block index.
+ * @param pos		[in] Starting position. (Must be >= 0 and <= the block size!)
+ * @param ptr		[out] Output data buffer.
+ * @param size		[in] Amount of data to read, in bytes. (Must be <= the block size!)
+ * @return Number of bytes read, or -1 if the block index is invalid.
+ */
+int WiaReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size)
+{
+	// Read 'size' bytes of block 'blockIdx', starting at 'pos'.
+	// NOTE: This can only be called by SparseDiscReader,
+	// so the main assertions are already checked there.
+	RP_D(WiaReader);
+	assert(pos >= 0 && pos < (int)d->block_size);
+	assert(size <= d->block_size - pos);
+	// NOTE: size is checked against the rest of the block
+	// instead of checking pos+size, which could overflow.
+	if (pos < 0 || pos >= (int)d->block_size || size > d->block_size - static_cast<unsigned int>(pos)) {
+		// pos+size is out of range.
+		return -1;
+	}
+
+	if (unlikely(size == 0)) {
+		// Nothing to read.
+		return 0;
+	}
+
+	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
+	uint64_t offset = (static_cast<uint64_t>(blockIdx) * d->block_size) + pos;
+	size_t remain = size;
+
+	MutexLocker groupCacheLocker(d->groupCacheMutex);
+	while (remain > 0) {
+		size_t len;
+		int ret = 0;
+
+		if (offset < sizeof(d->wiaDisc.dhead)) {
+			// The first 0x80 bytes are stored in the disc struct.
+			len = std::min(remain, static_cast<size_t>(sizeof(d->wiaDisc.dhead) - offset));
+			memcpy(ptr8, &d->wiaDisc.dhead[offset], len);
+		} else {
+			const WiaReaderPrivate::DataEntry *const entry = d->findDataEntry(offset);
+			if (!entry) {
+				// No more data entries. The rest of the disc is empty.
+				len = remain;
+				memset(ptr8, 0, len);
+			} else if (offset < entry->start) {
+				// Gap between data entries.
+				len = static_cast<size_t>(std::min(static_cast<uint64_t>(remain), entry->start - offset));
+				memset(ptr8, 0, len);
+			} else if (entry->partIdx < 0) {
+				// Raw data
+				len = static_cast<size_t>(std::min(static_cast<uint64_t>(remain), entry->end - offset));
+				ret = d->readRawData(*entry, offset, ptr8, len);
+			} else {
+				// Partition data
+				// NOTE: Blocks are sectors, so this is always within a single sector.
+				const uint32_t sector = static_cast<uint32_t>(offset / WiaReaderPrivate::SECTOR_SIZE);
+				const unsigned int sector_pos = static_cast<unsigned int>(offset % WiaReaderPrivate::SECTOR_SIZE);
+				if (sector_pos < WiaReaderPrivate::SECTOR_HASH_SIZE) {
+					// Hash area
+					len = std::min(remain, static_cast<size_t>(WiaReaderPrivate::SECTOR_HASH_SIZE - sector_pos));
+					ret = d->readHashArea(*entry, sector, sector_pos, ptr8, len);
+				} else {
+					// Sector data
+					len = std::min(remain, static_cast<size_t>(WiaReaderPrivate::SECTOR_SIZE - sector_pos));
+					ret = d->readPartitionData(*entry, sector,
+						sector_pos - WiaReaderPrivate::SECTOR_HASH_SIZE, ptr8, len);
+				}
+			}
+		}
+
+		if (ret != 0) {
+			m_lastError = -ret;
+			return -1;
+		}
+		ptr8 += len;
+		offset += len;
+		remain -= len;
+	}
+
+	return static_cast<int>(size);
+}
+
+/** WIA-specific functions **/
+
+/**
+ * Get the disc format.
+ * @return Disc format.
+ */
+WiaReader::DiscFormat WiaReader::discFormat(void) const
+{
+	RP_D(const WiaReader);
+	return d->discFormat;
+}
+
+/**
+ * Does this image have Wii partitions stored without encryption?
+ * If so, partitions must be read using WiiPartition::CM_NASOS.
+ * @return True if it does; false if not.
+ */
+bool WiaReader::hasDecryptedPartitions(void) const
+{
+	RP_D(const WiaReader);
+	return !d->partFirstSector.empty();
+}
+
+}
@@ -0,0 +1,115 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata)                       *
+ * WiaReader.hpp: GameCube/Wii WIA and RVZ disc image reader.              *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+#include "dll-macros.h"	// for RP_LIBROMDATA_PUBLIC
+#include "librpbase/disc/SparseDiscReader.hpp"
+
+namespace LibRomData {
+
+class WiaReaderPrivate;
+class WiaReader : public LibRpBase::SparseDiscReader
+{
+public:
+	/**
+	 * Construct a WiaReader with the specified file.
+	 * The file is ref()'d, so the original file can be
+	 * unref()'d by the caller afterwards.
+	 *
+	 * Wii partitions are presented unencrypted, similar to
+	 * NASOS images. The hash area of each partition sector
+	 * is only recalculated if it's actually read.
+	 *
+	 * @param file File to read from.
+	 */
+	RP_LIBROMDATA_PUBLIC
+	explicit WiaReader(const LibRpFile::IRpFilePtr &file);
+
+private:
+	typedef SparseDiscReader super;
+	RP_DISABLE_COPY(WiaReader)
+private:
+	friend class WiaReaderPrivate;
+
+public:
+	/** Disc image detection functions **/
+
+	enum class DiscFormat {
+		Unknown = -1,
+
+		WIA = 0,
+		RVZ = 1,
+	};
+
+	/**
+	 * Is a disc image supported by this class?
+	 * @param pHeader Disc image header.
+	 * @param szHeader Size of header.
+	 * @return Class-specific disc format ID (>= 0) if supported; -1 if not.
+	 */
+	ATTR_ACCESS_SIZE(read_only, 1, 2)
+	static int isDiscSupported_static(const uint8_t *pHeader, size_t szHeader);
+
+	/**
+	 * Is a disc image supported by this object?
+	 * @param pHeader Disc image header.
+	 * @param szHeader Size of header.
+	 * @return Class-specific disc format ID (>= 0) if supported; -1 if not.
+	 */
+	ATTR_ACCESS_SIZE(read_only, 2, 3)
+	int isDiscSupported(const uint8_t *pHeader, size_t szHeader) const final;
+
+protected:
+	/** SparseDiscReader functions **/
+
+	/**
+	 * Get the physical address of the specified logical block index.
+	 *
+	 * NOTE: Not implemented in this subclass.
+	 *
+	 * @param blockIdx	[in] Block index.
+	 * @return Physical block address. (-1 due to not being implemented)
+	 */
+	off64_t getPhysBlockAddr(uint32_t blockIdx) const final;
+
+	/**
+	 * Read the specified block.
+	 *
+	 * This can read either a full block or a partial block.
+	 * For a full block, set pos = 0 and size = block_size.
+	 *
+	 * @param blockIdx	[in] Block index.
+	 * @param pos		[in] Starting position. (Must be >= 0 and <= the block size!)
+	 * @param ptr		[out] Output data buffer.
+	 * @param size		[in] Amount of data to read, in bytes. (Must be <= the block size!)
+	 * @return Number of bytes read, or -1 if the block index is invalid.
+	 */
+	ATTR_ACCESS_SIZE(write_only, 4, 5)
+	int readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size) final;
+
+public:
+	/** WIA-specific functions **/
+
+	/**
+	 * Get the disc format.
+	 * @return Disc format.
+	 */
+	DiscFormat discFormat(void) const;
+
+	/**
+	 * Does this image have Wii partitions stored without encryption?
+	 * If so, partitions must be read using WiiPartition::CM_NASOS.
+	 * @return True if it does; false if not.
+	 */
+	bool hasDecryptedPartitions(void) const;
+};
+
+typedef std::shared_ptr<WiaReader> WiaReaderPtr;
+
+}
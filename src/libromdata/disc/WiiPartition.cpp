@@ -17,17 +17,28 @@
 #ifdef ENABLE_DECRYPTION
 #  include "librpbase/crypto/IAesCipher.hpp"
 #  include "librpbase/crypto/AesCipherFactory.hpp"
+#  include "librpbase/crypto/Hash.hpp"
 #endif /* ENABLE_DECRYPTION */
 using namespace LibRpBase;
 
 // WiiTicket for title key decryption
 #include "../Console/WiiTicket.hpp"
+#include "librpfile/IoTrace.hpp"
 #include "librpfile/MemFile.hpp"
 using namespace LibRpFile;
 
+// OpenMP for hash verification
+#ifdef _OPENMP
+#  include <omp.h>
+#endif /* _OPENMP */
+
+// C++ includes
+#include <typeinfo>
+
 // C++ STL classes
 using std::array;
 using std::unique_ptr;
+using std::vector;
 
 #include "GcnPartition_p.hpp"
 namespace LibRomData {
@@ -75,10 +86,9 @@ public:
 	static constexpr unsigned int SECTOR_SIZE_DECRYPTED = 0x7C00U;
 	static constexpr unsigned int SECTOR_SIZE_DECRYPTED_OFFSET = 0x400U;
 
-	// Decrypted sector cache.
+	// Encrypted sector layout.
 	// NOTE: Actual data starts at 0x400.
 	// Hashes and the sector IV are stored first.
-	uint32_t sector_num;				// Sector number.
 	union EncSector_t {
 		struct {
 			// NOTE: &hashes.H2[7][4], when encrypted, is the sector IV.
@@ -96,16 +106,52 @@ public:
 	};
 	ASSERT_STRUCT(EncSector_t, SECTOR_SIZE_ENCRYPTED);
 	static_assert(offsetof(EncSector_t, hashes.H2) + (7*20) + 4 == 0x3D0, "IV location is wrong");
-	EncSector_t sector_buf;	// Decrypted sector data.
+
+	// Decrypted sector cache. (LRU)
+	// Metadata reads tend to bounce between a few sectors,
+	// e.g. the FST, opening.bnr, and the main.dol header.
+	static constexpr unsigned int SECTOR_CACHE_COUNT = 8;
+	struct CachedSector {
+		uint32_t sector_num;	// Sector number
+		uint64_t lastUsed;	// LRU counter value at last use
+		EncSector_t buf;	// Decrypted sector data
+	};
+	vector<CachedSector> sectorCache;
+	uint64_t sectorLruCounter;
+
+	/**
+	 * Find a sector in the sector cache.
+	 * @param sector_num Sector number.
+	 * @return Cached sector, or nullptr if it isn't cached.
+	 */
+	const EncSector_t *findCachedSector(uint32_t sector_num);
 
 	/**
 	 * Read and decrypt a sector.
-	 * The decrypted sector is stored in sector_buf.
+	 * The decrypted sector is stored in the sector cache.
 	 *
 	 * @param sector_num Sector number. (address / 0x7C00)
-	 * @return 0 on success; negative POSIX error code on error.
+	 * @return Decrypted sector on success; nullptr on error.
 	 */
-	int readSector(uint32_t sector_num);
+	const EncSector_t *readSector(uint32_t sector_num);
+
+	// Maximum number of sectors to read in a single I/O request
+	// when reading runs of whole sectors.
+	static constexpr unsigned int SECTOR_RUN_MAX = 32;
+	rp::uvector<uint8_t> run_buf;
+
+	/**
+	 * Read and decrypt a run of contiguous whole sectors.
+	 * The run is read using a single I/O request, then each sector
+	 * is decrypted in place. The sectors are copied directly to the
+	 * output buffer and are not added to the sector cache.
+	 *
+	 * @param ptr		[out] Output buffer (sector_count * sector data size)
+	 * @param sector_num	[in] First sector number
+	 * @param sector_count	[in] Number of sectors (must be <= SECTOR_RUN_MAX)
+	 * @return Number of sectors read. (If less than sector_count, m_lastError is set.)
+	 */
+	unsigned int readSectorRun(uint8_t *ptr, uint32_t sector_num, unsigned int sector_count);
 
 public:
 	/**
@@ -118,7 +164,70 @@ public:
 public:
 	// AES cipher for this partition's title key
 	unique_ptr<IAesCipher> aes_title;
-#endif
+	// Decrypted title key
+	// Needed to create additional ciphers for worker threads.
+	array<uint8_t, 16> title_key;
+
+public:
+	/** Hash verification **/
+
+	// H3 table size
+	static constexpr unsigned int H3_TABLE_SIZE = 0x18000U;
+	static constexpr unsigned int H3_TABLE_ENTRIES = H3_TABLE_SIZE / 20U;
+	// Sectors per group. (Each group has one H3 hash.)
+	static constexpr unsigned int SECTORS_PER_GROUP = 64U;
+	static constexpr unsigned int SECTORS_PER_SUBGROUP = 8U;
+	// Number of groups to read at once when verifying hashes.
+	// Two batches are allocated: one being read, one being verified.
+	static constexpr unsigned int VERIFY_BATCH_GROUPS = 8U;
+	static constexpr unsigned int VERIFY_BATCH_SECTORS = VERIFY_BATCH_GROUPS * SECTORS_PER_GROUP;
+
+	// Per-sector verification flags
+	enum VerifyFlags : uint8_t {
+		VF_BAD_H0	= (1U << 0),
+		VF_BAD_H1	= (1U << 1),
+		VF_BAD_H2	= (1U << 2),
+		VF_BAD_H3	= (1U << 3),
+		VF_ERROR	= (1U << 7),	// Decryption or hashing error
+	};
+
+	// Per-thread verification state
+	struct VerifyThreadState {
+		unique_ptr<IAesCipher> cipher;
+		unique_ptr<Hash> sha1;
+	};
+
+	/**
+	 * Decrypt a sector and verify its data against H0.
+	 * The hash area and the data are both decrypted in place.
+	 * @param sector	[in/out] Sector
+	 * @param state		[in] Thread state
+	 * @return VerifyFlags
+	 */
+	uint8_t verifySectorH0(EncSector_t *sector, VerifyThreadState &state) const;
+
+	/**
+	 * Verify the H1, H2, and H3 hashes for a group of sectors.
+	 * verifySectorH0() must have been run on all sectors in the group.
+	 * @param sectors	[in] First sector in the group
+	 * @param count		[in] Number of sectors in the group (1-64)
+	 * @param h3		[in] H3 hash for this group, or nullptr if out of range
+	 * @param flags		[in/out] VerifyFlags for each sector
+	 * @param state		[in] Thread state
+	 */
+	static void verifyGroupH1H2H3(const EncSector_t *sectors, unsigned int count,
+		const uint8_t *h3, uint8_t *flags, VerifyThreadState &state);
+
+	/**
+	 * Verify the partition's hash tree.
+	 * @param pResult	[out] Verification results
+	 * @param callback	[in,opt] Progress callback
+	 * @param userdata	[in,opt] User data for the progress callback
+	 * @return 0 if verification completed; -ECANCELED if cancelled; negative POSIX error code on error.
+	 */
+	int verifyHashes(WiiPartition::HashVerifyResult *pResult,
+		WiiPartition::VerifyProgressCallback callback, void *userdata);
+#endif /* ENABLE_DECRYPTION */
 };
 
 /** WiiPartitionPrivate **/
@@ -145,7 +254,7 @@ WiiPartitionPrivate::WiiPartitionPrivate(WiiPartition *q,
 	, encKeyReal(WiiTicket::EncryptionKeys::Unknown)
 	, cryptoMethod(cryptoMethod)
 	, pos_7C00(-1)
-	, sector_num(~0)
+	, sectorLruCounter(0)
 {
 	// Clear data set by GcnPartition in case the
 	// partition headers can't be read.
@@ -217,8 +326,7 @@ KeyManager::VerifyResult WiiPartitionPrivate::initDecryption(void)
 
 #ifdef ENABLE_DECRYPTION
 	// Get the title key.
-	uint8_t title_key[16];
-	int ret = wiiTicket->decryptTitleKey(title_key, sizeof(title_key));
+	int ret = wiiTicket->decryptTitleKey(title_key.data(), title_key.size());
 	if (ret != 0) {
 		// Title key decryption failed.
 		verifyResult = wiiTicket->verifyResult();
@@ -234,7 +342,7 @@ KeyManager::VerifyResult WiiPartitionPrivate::initDecryption(void)
 	}
 
 	// Load the decrypted title key. (CBC mode)
-	ret = cipher->setKey(title_key, sizeof(title_key));
+	ret = cipher->setKey(title_key.data(), title_key.size());
 	ret |= cipher->setChainingMode(IAesCipher::ChainingMode::CBC);
 	if (ret != 0) {
 		// Error initializing the cipher.
@@ -247,7 +355,8 @@ KeyManager::VerifyResult WiiPartitionPrivate::initDecryption(void)
 
 	// Read sector 0, which contains a disc header.
 	// NOTE: readSector() doesn't check verifyResult.
-	if (readSector(0) != 0) {
+	const EncSector_t *const sector0 = readSector(0);
+	if (!sector0) {
 		// Error reading sector 0.
 		aes_title.reset();
 		verifyResult = KeyManager::VerifyResult::IAesCipherDecryptErr;
@@ -257,12 +366,12 @@ KeyManager::VerifyResult WiiPartitionPrivate::initDecryption(void)
 	// Verify that this is a Wii partition.
 	// If it isn't, the key is probably wrong.
 	const GCN_DiscHeader *const discHeader =
-		reinterpret_cast<const GCN_DiscHeader*>(sector_buf.data);
+		reinterpret_cast<const GCN_DiscHeader*>(sector0->data);
 	if (discHeader->magic_wii != cpu_to_be32(WII_MAGIC)) {
 		// Invalid disc header.
 
 		// NOTE: Debug discs may have incrementing values in update partitions.
-		if (!memcmp(sector_buf.data, incr_vals.data(), incr_vals.size())) {
+		if (!memcmp(sector0->data, incr_vals.data(), incr_vals.size())) {
 			// Found incrementing values.
 			verifyResult = KeyManager::VerifyResult::IncrementingValues;
 		} else {
@@ -285,18 +394,35 @@ KeyManager::VerifyResult WiiPartitionPrivate::initDecryption(void)
 	return verifyResult;
 }
 
+/**
+ * Find a sector in the sector cache.
+ * @param sector_num Sector number.
+ * @return Cached sector, or nullptr if it isn't cached.
+ */
+const WiiPartitionPrivate::EncSector_t *WiiPartitionPrivate::findCachedSector(uint32_t sector_num)
+{
+	for (CachedSector &sector : sectorCache) {
+		if (sector.sector_num == sector_num) {
+			sector.lastUsed = ++sectorLruCounter;
+			return &sector.buf;
+		}
+	}
+	return nullptr;
+}
+
 /**
  * Read and decrypt a sector.
- * The decrypted sector is stored in sector_buf.
+ * The decrypted sector is stored in the sector cache.
  *
  * @param sector_num Sector number. (address / 0x7C00)
- * @return 0 on success; negative POSIX error code on error.
+ * @return Decrypted sector on success; nullptr on error.
  */
-int WiiPartitionPrivate::readSector(uint32_t sector_num)
+const WiiPartitionPrivate::EncSector_t *WiiPartitionPrivate::readSector(uint32_t sector_num)
 {
-	if (this->sector_num == sector_num) {
-		// Sector is already in memory.
-		return 0;
+	// Check if the sector is already in memory.
+	const EncSector_t *const cached = findCachedSector(sector_num);
+	if (cached) {
+		return cached;
 	}
 
 	RP_Q(WiiPartition);
@@ -305,28 +431,55 @@ int WiiPartitionPrivate::readSector(uint32_t sector_num)
 	if (isCrypted) {
 		// Decryption is disabled.
 		q->m_lastError = EIO;
-		return -1;
+		return nullptr;
 	}
 #endif /* !ENABLE_DECRYPTION */
 
+	// Get a cache entry: either a new one, or the least-recently used one.
+	CachedSector *entry;
+	if (sectorCache.size() < SECTOR_CACHE_COUNT) {
+		// NOTE: Reserving SECTOR_CACHE_COUNT entries ensures this won't reallocate.
+		sectorCache.reserve(SECTOR_CACHE_COUNT);
+		sectorCache.resize(sectorCache.size() + 1);
+		entry = &sectorCache.back();
+	} else {
+		entry = &sectorCache[0];
+		for (CachedSector &sector : sectorCache) {
+			if (sector.lastUsed < entry->lastUsed) {
+				entry = &sector;
+			}
+		}
+	}
+	// Invalidate the entry in case the read fails.
+	entry->sector_num = ~0U;
+	EncSector_t &sector_buf = entry->buf;
+
 	// NOTE: This function doesn't check verifyResult,
 	// since it's called by initDecryption() before
 	// verifyResult is set.
 	off64_t sector_addr = partition_offset + data_offset;
 	sector_addr += (static_cast<off64_t>(sector_num) * SECTOR_SIZE_ENCRYPTED);
 
-	int ret = q->m_file->seek(sector_addr);
-	if (ret != 0) {
+	// Unencrypted sectors with hashes (NASOS, WIA/RVZ) don't need
+	// the hash area, and WiaReader would have to recalculate it,
+	// so only read the sector data.
+	uint8_t *buf = sector_buf.fulldata;
+	size_t buf_size = sizeof(sector_buf);
+	if (cryptoMethod == WiiPartition::CM_NASOS) {
+		sector_addr += SECTOR_SIZE_DECRYPTED_OFFSET;
+		buf = sector_buf.data;
+		buf_size = sizeof(sector_buf.data);
+	}
+
+	if (q->m_file->seek(sector_addr) != 0) {
 		q->m_lastError = q->m_file->lastError();
-		return ret;
+		return nullptr;
 	}
 
-	size_t sz = q->m_file->read(&sector_buf, sizeof(sector_buf));
-	if (sz != sizeof(sector_buf)) {
-		// sector_buf may be invalid.
-		this->sector_num = ~0;
+	size_t sz = q->m_file->read(buf, buf_size);
+	if (sz != buf_size) {
 		q->m_lastError = EIO;
-		return -1;
+		return nullptr;
 	}
 
 #ifdef ENABLE_DECRYPTION
@@ -335,19 +488,380 @@ int WiiPartitionPrivate::readSector(uint32_t sector_num)
 		if (aes_title->decrypt(sector_buf.data, sizeof(sector_buf.data),
 		    &sector_buf.hashes.H2[7][4], 16) != SECTOR_SIZE_DECRYPTED)
 		{
-			// sector_buf may be invalid.
-			this->sector_num = ~0;
 			q->m_lastError = EIO;
-			return -1;
+			return nullptr;
 		}
 	}
 #endif /* ENABLE_DECRYPTION */
 
 	// Sector read and decrypted.
-	this->sector_num = sector_num;
+	entry->sector_num = sector_num;
+	entry->lastUsed = ++sectorLruCounter;
+	return &sector_buf;
+}
+
+/**
+ * Read and decrypt a run of contiguous whole sectors.
+ * The run is read using a single I/O request, then each sector
+ * is decrypted in place. The sectors are copied directly to the
+ * output buffer and are not added to the sector cache.
+ *
+ * @param ptr		[out] Output buffer (sector_count * sector data size)
+ * @param sector_num	[in] First sector number
+ * @param sector_count	[in] Number of sectors (must be <= SECTOR_RUN_MAX)
+ * @return Number of sectors read. (If less than sector_count, m_lastError is set.)
+ */
+unsigned int WiiPartitionPrivate::readSectorRun(uint8_t *ptr, uint32_t sector_num, unsigned int sector_count)
+{
+	assert(sector_count > 0);
+	assert(sector_count <= SECTOR_RUN_MAX);
+
+	RP_Q(WiiPartition);
+	off64_t sector_addr = partition_offset + data_offset;
+	sector_addr += (static_cast<off64_t>(sector_num) * SECTOR_SIZE_ENCRYPTED);
+
+	if ((cryptoMethod & WiiPartition::CM_MASK_SECTOR) == WiiPartition::CM_32K) {
+		// Full 32K sectors. (implies no encryption)
+		// Read directly into the output buffer.
+		const size_t run_size = static_cast<size_t>(sector_count) * SECTOR_SIZE_ENCRYPTED;
+		size_t sz = q->m_file->seekAndRead(sector_addr, ptr, run_size);
+		if (sz != run_size) {
+			q->m_lastError = EIO;
+		}
+		return static_cast<unsigned int>(sz / SECTOR_SIZE_ENCRYPTED);
+	}
+
+	if (cryptoMethod == WiiPartition::CM_NASOS) {
+		// Unencrypted sectors with hashes. Skip the hash areas
+		// so WiaReader doesn't have to recalculate them.
+		for (unsigned int i = 0; i < sector_count; i++, ptr += SECTOR_SIZE_DECRYPTED,
+		     sector_addr += SECTOR_SIZE_ENCRYPTED)
+		{
+			size_t sz = q->m_file->seekAndRead(sector_addr + SECTOR_SIZE_DECRYPTED_OFFSET,
+				ptr, SECTOR_SIZE_DECRYPTED);
+			if (sz != SECTOR_SIZE_DECRYPTED) {
+				q->m_lastError = EIO;
+				return i;
+			}
+		}
+		return sector_count;
+	}
+
+#ifdef ENABLE_DECRYPTION
+	// Encrypted sectors: Read the entire run, then decrypt each sector.
+	// NOTE: Each sector has its own IV, so each sector is a separate CBC chain.
+	const size_t run_size = static_cast<size_t>(sector_count) * SECTOR_SIZE_ENCRYPTED;
+	if (run_buf.size() < run_size) {
+		run_buf.resize(run_size);
+	}
+	size_t sz = q->m_file->seekAndRead(sector_addr, run_buf.data(), run_size);
+	if (sz != run_size) {
+		// Short read. Decrypt whatever whole sectors were read.
+		q->m_lastError = EIO;
+		sector_count = static_cast<unsigned int>(sz / SECTOR_SIZE_ENCRYPTED);
+	}
+
+	EncSector_t *sector = reinterpret_cast<EncSector_t*>(run_buf.data());
+	for (unsigned int i = 0; i < sector_count; i++, sector++, ptr += SECTOR_SIZE_DECRYPTED) {
+		if (aes_title->decrypt(sector->data, sizeof(sector->data),
+		    &sector->hashes.H2[7][4], 16) != SECTOR_SIZE_DECRYPTED)
+		{
+			q->m_lastError = EIO;
+			return i;
+		}
+		memcpy(ptr, sector->data, SECTOR_SIZE_DECRYPTED);
+	}
+	return sector_count;
+#else /* !ENABLE_DECRYPTION */
+	// Decryption is disabled.
+	q->m_lastError = EIO;
 	return 0;
+#endif /* ENABLE_DECRYPTION */
 }
 
+#ifdef ENABLE_DECRYPTION
+/**
+ * Decrypt a sector and verify its data against H0.
+ * The hash area and the data are both decrypted in place.
+ * @param sector	[in/out] Sector
+ * @param state		[in] Thread state
+ * @return VerifyFlags
+ */
+uint8_t WiiPartitionPrivate::verifySectorH0(EncSector_t *sector, VerifyThreadState &state) const
+{
+	if ((cryptoMethod & WiiPartition::CM_MASK_ENCRYPTED) == WiiPartition::CM_ENCRYPTED) {
+		// The data IV is part of the *encrypted* hash area,
+		// so it must be saved before the hash area is decrypted.
+		static const uint8_t zero_iv[16] = {0};
+		uint8_t data_iv[16];
+		memcpy(data_iv, &sector->hashes.H2[7][4], sizeof(data_iv));
+
+		if (state.cipher->decrypt(sector->fulldata, SECTOR_SIZE_DECRYPTED_OFFSET,
+		                          zero_iv, sizeof(zero_iv)) != SECTOR_SIZE_DECRYPTED_OFFSET ||
+		    state.cipher->decrypt(sector->data, sizeof(sector->data),
+		                          data_iv, sizeof(data_iv)) != SECTOR_SIZE_DECRYPTED)
+		{
+			return VF_ERROR;
+		}
+	}
+
+	// Each H0 hash covers 1 KB of data.
+	uint8_t digest[20];
+	for (unsigned int i = 0; i < ARRAY_SIZE(sector->hashes.H0); i++) {
+		state.sha1->reset();
+		state.sha1->process(&sector->data[i * 1024], 1024);
+		if (state.sha1->getHash(digest, sizeof(digest)) != 0) {
+			return VF_ERROR;
+		}
+		if (memcmp(digest, sector->hashes.H0[i], sizeof(digest)) != 0) {
+			return VF_BAD_H0;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Verify the H1, H2, and H3 hashes for a group of sectors.
+ * verifySectorH0() must have been run on all sectors in the group.
+ * @param sectors	[in] First sector in the group
+ * @param count		[in] Number of sectors in the group (1-64)
+ * @param h3		[in] H3 hash for this group, or nullptr if out of range
+ * @param flags		[in/out] VerifyFlags for each sector
+ * @param state		[in] Thread state
+ */
+void WiiPartitionPrivate::verifyGroupH1H2H3(const EncSector_t *sectors, unsigned int count,
+	const uint8_t *h3, uint8_t *flags, VerifyThreadState &state)
+{
+	assert(count > 0);
+	assert(count <= SECTORS_PER_GROUP);
+	Hash &sha1 = *state.sha1;
+	uint8_t digest[20];
+
+	for (unsigned int sg = 0; sg * SECTORS_PER_SUBGROUP < count; sg++) {
+		const unsigned int sg_start = sg * SECTORS_PER_SUBGROUP;
+		const unsigned int sg_count = std::min(count - sg_start, static_cast<unsigned int>(SECTORS_PER_SUBGROUP));
+
+		// H1: Hashes of each sector's H0 table in this subgroup.
+		uint8_t h1[SECTORS_PER_SUBGROUP][20];
+		for (unsigned int j = 0; j < sg_count; j++) {
+			sha1.reset();
+			sha1.process(sectors[sg_start + j].hashes.H0, sizeof(sectors[sg_start + j].hashes.H0));
+			sha1.getHash(h1[j], sizeof(h1[j]));
+		}
+
+		for (unsigned int k = 0; k < sg_count; k++) {
+			const EncSector_t &sector = sectors[sg_start + k];
+			uint8_t &sflags = flags[sg_start + k];
+			if (sflags & VF_ERROR) {
+				// Sector couldn't be decrypted.
+				continue;
+			}
+
+			// Each sector has a copy of its subgroup's H1 table.
+			if (memcmp(sector.hashes.H1, h1, sg_count * sizeof(h1[0])) != 0) {
+				sflags |= VF_BAD_H1;
+			}
+
+			// Each sector has a copy of its group's H2 table.
+			sha1.reset();
+			sha1.process(sector.hashes.H1, sizeof(sector.hashes.H1));
+			sha1.getHash(digest, sizeof(digest));
+			if (memcmp(digest, sector.hashes.H2[sg], sizeof(digest)) != 0) {
+				sflags |= VF_BAD_H2;
+			}
+
+			// H3: Hash of the H2 table.
+			sha1.reset();
+			sha1.process(sector.hashes.H2, sizeof(sector.hashes.H2));
+			sha1.getHash(digest, sizeof(digest));
+			if (!h3 || memcmp(digest, h3, sizeof(digest)) != 0) {
+				sflags |= VF_BAD_H3;
+			}
+		}
+	}
+}
+
+/**
+ * Verify the partition's hash tree.
+ * @param pResult	[out] Verification results
+ * @param callback	[in,opt] Progress callback
+ * @param userdata	[in,opt] User data for the progress callback
+ * @return 0 if verification completed; -ECANCELED if cancelled; negative POSIX error code on error.
+ */
+int WiiPartitionPrivate::verifyHashes(WiiPartition::HashVerifyResult *pResult,
+	WiiPartition::VerifyProgressCallback callback, void *userdata)
+{
+	RP_Q(WiiPartition);
+	const bool isCrypted = ((cryptoMethod & WiiPartition::CM_MASK_ENCRYPTED) == WiiPartition::CM_ENCRYPTED);
+
+	// Set up the per-thread state.
+#ifdef _OPENMP
+	const int threadCount = omp_get_max_threads();
+#else /* !_OPENMP */
+	static constexpr int threadCount = 1;
+#endif /* _OPENMP */
+	vector<VerifyThreadState> threadState(threadCount);
+	for (VerifyThreadState &state : threadState) {
+		state.sha1.reset(new Hash(Hash::Algorithm::SHA1));
+		if (!state.sha1->isUsable()) {
+			return -ENOTSUP;
+		}
+		if (isCrypted) {
+			state.cipher.reset(AesCipherFactory::create());
+			if (!state.cipher || !state.cipher->isInit() ||
+			    state.cipher->setKey(title_key.data(), title_key.size()) != 0 ||
+			    state.cipher->setChainingMode(IAesCipher::ChainingMode::CBC) != 0)
+			{
+				return -EIO;
+			}
+		}
+	}
+
+	// Read the H3 table and check it against the TMD.
+	// NOTE: The TMD's first content entry has the H3 table hash.
+	unique_ptr<uint8_t[]> h3_table(new uint8_t[H3_TABLE_SIZE]);
+	size_t size = q->m_file->seekAndRead(partition_offset + partitionHeader.h3_table_offset.geto_be(),
+		h3_table.get(), H3_TABLE_SIZE);
+	if (size != H3_TABLE_SIZE) {
+		q->m_lastError = EIO;
+		return -EIO;
+	}
+
+	const RVL_TMD_Header *const tmdHeader =
+		reinterpret_cast<const RVL_TMD_Header*>(partitionHeader.tmd);
+	const RVL_Content_Entry *const content0 =
+		reinterpret_cast<const RVL_Content_Entry*>(&partitionHeader.tmd[sizeof(RVL_TMD_Header)]);
+	uint8_t digest[20];
+	Hash &sha1 = *threadState[0].sha1;
+	sha1.reset();
+	sha1.process(h3_table.get(), H3_TABLE_SIZE);
+	sha1.getHash(digest, sizeof(digest));
+	pResult->h3_table_ok = (tmdHeader->nbr_cont != 0 &&
+		!memcmp(digest, content0->sha1_hash, sizeof(digest)));
+
+	// Verify the sectors.
+	// The next batch is read while the current batch is being verified.
+	const uint32_t sectorCount = static_cast<uint32_t>(data_size / SECTOR_SIZE_ENCRYPTED);
+	const uint64_t totalBytes = static_cast<uint64_t>(sectorCount) * SECTOR_SIZE_ENCRYPTED;
+	pResult->sectors = 0;
+	pResult->bad_sectors = 0;
+	pResult->bad_h0 = 0;
+	pResult->bad_h1 = 0;
+	pResult->bad_h2 = 0;
+	pResult->bad_h3 = 0;
+	pResult->badSectorList.clear();
+	if (sectorCount == 0) {
+		return 0;
+	}
+
+	unique_ptr<EncSector_t[]> batch[2];
+	batch[0].reset(new EncSector_t[VERIFY_BATCH_SECTORS]);
+	batch[1].reset(new EncSector_t[VERIFY_BATCH_SECTORS]);
+	array<uint8_t, VERIFY_BATCH_SECTORS> flags;
+
+	const off64_t sector_base = partition_offset + data_offset;
+	auto readBatch = [this, q, sector_base, sectorCount](EncSector_t *buf, uint32_t sector_num) -> uint32_t {
+		const uint32_t count = std::min(sectorCount - sector_num, static_cast<uint32_t>(VERIFY_BATCH_SECTORS));
+		const size_t batch_size = static_cast<size_t>(count) * SECTOR_SIZE_ENCRYPTED;
+		const off64_t addr = sector_base + (static_cast<off64_t>(sector_num) * SECTOR_SIZE_ENCRYPTED);
+		// NOTE: Using readAt(), since this runs inside a parallel region.
+		if (q->m_file->readAt(addr, buf, batch_size) != batch_size) {
+			return 0;
+		}
+		return count;
+	};
+
+	uint32_t curCount = readBatch(batch[0].get(), 0);
+	if (curCount == 0) {
+		q->m_lastError = EIO;
+		return -EIO;
+	}
+
+	int cur = 0;
+	for (uint32_t batchStart = 0; batchStart < sectorCount; cur ^= 1) {
+		EncSector_t *const curBuf = batch[cur].get();
+		const uint32_t nextStart = batchStart + curCount;
+		uint32_t nextCount = 0;
+		const int groupCount = static_cast<int>((curCount + SECTORS_PER_GROUP - 1) / SECTORS_PER_GROUP);
+		flags.fill(0);
+
+#ifdef _OPENMP
+		#pragma omp parallel
+#endif /* _OPENMP */
+		{
+#ifdef _OPENMP
+			VerifyThreadState &state = threadState[omp_get_thread_num()];
+			#pragma omp single nowait
+#else /* !_OPENMP */
+			VerifyThreadState &state = threadState[0];
+#endif /* _OPENMP */
+			if (nextStart < sectorCount) {
+				nextCount = readBatch(batch[cur ^ 1].get(), nextStart);
+			}
+
+#ifdef _OPENMP
+			#pragma omp for schedule(dynamic)
+#endif /* _OPENMP */
+			for (int i = 0; i < static_cast<int>(curCount); i++) {
+				flags[i] = verifySectorH0(&curBuf[i], state);
+			}
+
+#ifdef _OPENMP
+			#pragma omp for schedule(dynamic)
+#endif /* _OPENMP */
+			for (int g = 0; g < groupCount; g++) {
+				const uint32_t first = static_cast<uint32_t>(g) * SECTORS_PER_GROUP;
+				const uint32_t group = (batchStart + first) / SECTORS_PER_GROUP;
+				const uint8_t *const h3 = (group < H3_TABLE_ENTRIES)
+					? &h3_table[group * 20]
+					: nullptr;
+				verifyGroupH1H2H3(&curBuf[first], std::min(curCount - first, static_cast<uint32_t>(SECTORS_PER_GROUP)),
+					h3, &flags[first], state);
+			}
+		}
+
+		// Tally the results.
+		for (uint32_t i = 0; i < curCount; i++) {
+			const uint8_t sflags = flags[i];
+			if (sflags == 0) {
+				continue;
+			} else if (sflags & VF_ERROR) {
+				q->m_lastError = EIO;
+				return -EIO;
+			}
+
+			pResult->bad_sectors++;
+			if (sflags & VF_BAD_H0) pResult->bad_h0++;
+			if (sflags & VF_BAD_H1) pResult->bad_h1++;
+			if (sflags & VF_BAD_H2) pResult->bad_h2++;
+			if (sflags & VF_BAD_H3) pResult->bad_h3++;
+			if (pResult->badSectorList.size() < WiiPartition::BAD_SECTOR_LIST_MAX) {
+				pResult->badSectorList.push_back(batchStart + i);
+			}
+		}
+		pResult->sectors += curCount;
+
+		if (callback) {
+			const uint64_t done = static_cast<uint64_t>(pResult->sectors) * SECTOR_SIZE_ENCRYPTED;
+			if (callback(done, totalBytes, userdata) != 0) {
+				// Cancelled.
+				return -ECANCELED;
+			}
+		}
+
+		batchStart = nextStart;
+		if (batchStart < sectorCount && nextCount == 0) {
+			// Error reading the next batch.
+			q->m_lastError = EIO;
+			return -EIO;
+		}
+		curCount = nextCount;
+	}
+
+	return 0;
+}
+#endif /* ENABLE_DECRYPTION */
+
 /** WiiPartition **/
 
 /**
@@ -433,6 +947,8 @@ WiiPartition::WiiPartition(const IDiscReaderPtr &discReader, off64_t partition_o
 	// Encryption will not be initialized until read() is called.
 }
 
+WiiPartition::~WiiPartition() = default;
+
 /** IDiscReader **/
 
 /**
@@ -450,8 +966,8 @@ size_t WiiPartition::read(void *ptr, size_t size)
 		m_lastError = EBADF;
 		return 0;
 	}
+	IoTrace::Scope trace(IoTrace::Op::Read, typeid(*this).name(), d->pos_7C00, size);
 
-	// TODO: Consolidate this code and optimize it.
 	size_t ret = 0;
 	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
 
@@ -465,153 +981,131 @@ size_t WiiPartition::read(void *ptr, size_t size)
 		size = static_cast<size_t>(d->data_size - d->pos_7C00);
 	}
 
-	if ((d->cryptoMethod & CM_MASK_SECTOR) == CM_32K) {
-		// Full 32K sectors. (implies no encryption)
-
-		// Check if we're not starting on a block boundary.
-		const uint32_t blockStartOffset = d->pos_7C00 % WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED;
-		if (blockStartOffset != 0) {
-			// Not a block boundary.
-			// Read the end of the block.
-			uint32_t read_sz = WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED - blockStartOffset;
-			if (size < static_cast<size_t>(read_sz)) {
-				read_sz = static_cast<uint32_t>(size);
-			}
-
-			// Read and decrypt the sector.
-			const uint32_t blockStart = static_cast<uint32_t>(d->pos_7C00 / WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED);
-			d->readSector(blockStart);
-
-			// Copy data from the sector.
-			memcpy(ptr8, &d->sector_buf.fulldata[blockStartOffset], read_sz);
-
-			// Starting block read.
-			size -= read_sz;
-			ptr8 += read_sz;
-			ret += read_sz;
-			d->pos_7C00 += read_sz;
-		}
-
-		// Read entire blocks.
-		for (; size >= WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED;
-		     size -= WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED, ptr8 += WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED,
-		     ret += WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED, d->pos_7C00 += WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED)
-		{
-			assert(d->pos_7C00 % WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED == 0);
-
-			// Read the sector.
-			const uint32_t blockStart = static_cast<uint32_t>(d->pos_7C00 / WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED);
-			d->readSector(blockStart);
-
-			// Copy data from the sector.
-			memcpy(ptr8, d->sector_buf.fulldata, WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED);
-		}
-
-		// Check if we still have data left. (not a full block)
-		if (size > 0) {
-			// Not a full block.
-
-			// Read the sector.
-			assert(d->pos_7C00 % WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED == 0);
-			const uint32_t blockEnd = static_cast<uint32_t>(d->pos_7C00 / WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED);
-			d->readSector(blockEnd);
-
-			// Copy data from the sector.
-			memcpy(ptr8, d->sector_buf.fulldata, size);
-
-			ret += size;
-			d->pos_7C00 += size;
-		}
-	} else {
-		if ((d->cryptoMethod & CM_MASK_ENCRYPTED) == CM_ENCRYPTED) {
+	if ((d->cryptoMethod & CM_MASK_ENCRYPTED) == CM_ENCRYPTED) {
 #ifdef ENABLE_DECRYPTION
-			// Make sure decryption is initialized.
-			switch (d->verifyResult) {
-				case KeyManager::VerifyResult::Unknown:
-					// Attempt to initialize decryption.
-					if (d->initDecryption() != KeyManager::VerifyResult::OK) {
-						// Decryption could not be initialized.
-						// TODO: Better error?
-						m_lastError = EIO;
-						return 0;
-					}
-					break;
-
-				case KeyManager::VerifyResult::OK:
-					// Decryption is initialized.
-					break;
-
-				default:
-					// Decryption failed to initialize.
+		// Make sure decryption is initialized.
+		switch (d->verifyResult) {
+			case KeyManager::VerifyResult::Unknown:
+				// Attempt to initialize decryption.
+				if (d->initDecryption() != KeyManager::VerifyResult::OK) {
+					// Decryption could not be initialized.
 					// TODO: Better error?
 					m_lastError = EIO;
 					return 0;
-			}
+				}
+				break;
+
+			case KeyManager::VerifyResult::OK:
+				// Decryption is initialized.
+				break;
+
+			default:
+				// Decryption failed to initialize.
+				// TODO: Better error?
+				m_lastError = EIO;
+				return 0;
+		}
 #else /* !ENABLE_DECRYPTION */
-			// Decryption is not enabled.
-			m_lastError = EIO;
-			ret = 0;
+		// Decryption is not enabled.
+		m_lastError = EIO;
+		return 0;
 #endif /* ENABLE_DECRYPTION */
-		}
-
-		// Check if we're not starting on a block boundary.
-		const uint32_t blockStartOffset = d->pos_7C00 % WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED;
-		if (blockStartOffset != 0) {
-			// Not a block boundary.
-			// Read the end of the block.
-			uint32_t read_sz = WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED - blockStartOffset;
-			if (size < static_cast<size_t>(read_sz)) {
-				read_sz = static_cast<uint32_t>(size);
-			}
-
-			// Read and decrypt the sector.
-			const uint32_t blockStart = static_cast<uint32_t>(d->pos_7C00 / WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED);
-			d->readSector(blockStart);
+	}
 
-			// Copy data from the sector.
-			memcpy(ptr8, &d->sector_buf.data[blockStartOffset], read_sz);
+	// Full 32K sectors (no hashes) are returned as-is.
+	// Otherwise, only the 0x7C00 bytes of data are returned.
+	const bool is32K = ((d->cryptoMethod & CM_MASK_SECTOR) == CM_32K);
+	const uint32_t sector_data_size = (is32K
+		? WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED
+		: WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED);
+	const unsigned int sector_data_offset = (is32K
+		? 0 : WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED_OFFSET);
+
+	// Check if we're not starting on a block boundary.
+	const uint32_t blockStartOffset = d->pos_7C00 % sector_data_size;
+	if (blockStartOffset != 0) {
+		// Not a block boundary.
+		// Read the end of the block.
+		uint32_t read_sz = sector_data_size - blockStartOffset;
+		if (size < static_cast<size_t>(read_sz)) {
+			read_sz = static_cast<uint32_t>(size);
+		}
 
-			// Starting block read.
-			size -= read_sz;
-			ptr8 += read_sz;
-			ret += read_sz;
-			d->pos_7C00 += read_sz;
+		// Read and decrypt the sector.
+		const uint32_t blockStart = static_cast<uint32_t>(d->pos_7C00 / sector_data_size);
+		const WiiPartitionPrivate::EncSector_t *const sector = d->readSector(blockStart);
+		if (!sector) {
+			// Read error.
+			return trace.ret(ret);
 		}
 
-		// Read entire blocks.
-		for (; size >= WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED;
-		    size -= WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED, ptr8 += WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED,
-		    ret += WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED, d->pos_7C00 += WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED)
-		{
-			assert(d->pos_7C00 % WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED == 0);
+		// Copy data from the sector.
+		memcpy(ptr8, &sector->fulldata[sector_data_offset + blockStartOffset], read_sz);
 
-			// Read and decrypt the sector.
-			const uint32_t blockStart = static_cast<uint32_t>(d->pos_7C00 / WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED);
-			d->readSector(blockStart);
+		// Starting block read.
+		size -= read_sz;
+		ptr8 += read_sz;
+		ret += read_sz;
+		d->pos_7C00 += read_sz;
+	}
 
-			// Copy data from the sector.
-			memcpy(ptr8, d->sector_buf.data, WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED);
+	// Read entire blocks.
+	while (size >= sector_data_size) {
+		assert(d->pos_7C00 % sector_data_size == 0);
+		const uint32_t blockStart = static_cast<uint32_t>(d->pos_7C00 / sector_data_size);
+		size_t read_sz;
+
+		const WiiPartitionPrivate::EncSector_t *const sector = d->findCachedSector(blockStart);
+		if (sector) {
+			// Sector is already in memory.
+			memcpy(ptr8, &sector->fulldata[sector_data_offset], sector_data_size);
+			read_sz = sector_data_size;
+		} else {
+			// Read a run of uncached sectors using a single I/O request.
+			const size_t run_max = std::min(size / sector_data_size,
+				static_cast<size_t>(WiiPartitionPrivate::SECTOR_RUN_MAX));
+			unsigned int run_count = 1;
+			while (run_count < run_max && !d->findCachedSector(blockStart + run_count)) {
+				run_count++;
+			}
+			const unsigned int sectors_read = d->readSectorRun(ptr8, blockStart, run_count);
+			read_sz = static_cast<size_t>(sectors_read) * sector_data_size;
+			if (sectors_read != run_count) {
+				// Read error.
+				ret += read_sz;
+				d->pos_7C00 += read_sz;
+				return trace.ret(ret);
+			}
 		}
 
-		// Check if we still have data left. (not a full block)
-		if (size > 0) {
-			// Not a full block.
+		size -= read_sz;
+		ptr8 += read_sz;
+		ret += read_sz;
+		d->pos_7C00 += read_sz;
+	}
 
-			// Read and decrypt the sector.
-			assert(d->pos_7C00 % WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED == 0);
-			const uint32_t blockEnd = static_cast<uint32_t>(d->pos_7C00 / WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED);
-			d->readSector(blockEnd);
+	// Check if we still have data left. (not a full block)
+	if (size > 0) {
+		// Not a full block.
+
+		// Read and decrypt the sector.
+		assert(d->pos_7C00 % sector_data_size == 0);
+		const uint32_t blockEnd = static_cast<uint32_t>(d->pos_7C00 / sector_data_size);
+		const WiiPartitionPrivate::EncSector_t *const sector = d->readSector(blockEnd);
+		if (!sector) {
+			// Read error.
+			return trace.ret(ret);
+		}
 
-			// Copy data from the sector.
-			memcpy(ptr8, d->sector_buf.data, size);
+		// Copy data from the sector.
+		memcpy(ptr8, &sector->fulldata[sector_data_offset], size);
 
-			ret += size;
-			d->pos_7C00 += size;
-		}
+		ret += size;
+		d->pos_7C00 += size;
 	}
 
 	// Finished reading the data.
-	return ret;
+	return trace.ret(ret);
 }
 
 /**
@@ -659,6 +1153,49 @@ off64_t WiiPartition::tell(void)
 	return d->pos_7C00;
 }
 
+/** Access pattern hints **/
+
+/**
+ * Tell the OS how a range of the partition will be accessed.
+ * The range is converted to the corresponding physical sectors.
+ * @param pos	[in] Start position.
+ * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+ * @param hint	[in] Access hint.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int WiiPartition::advise(off64_t pos, off64_t size, AccessHint hint)
+{
+	RP_D(const WiiPartition);
+	if (!m_file) {
+		return -EBADF;
+	} else if (pos < 0 || size < 0) {
+		return -EINVAL;
+	}
+
+	// Determine the first physical sector.
+	// NOTE: data_size is the physical size, including hashes.
+	const unsigned int sector_size = ((d->cryptoMethod & CM_MASK_SECTOR) == CM_32K)
+		? WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED
+		: WiiPartitionPrivate::SECTOR_SIZE_DECRYPTED;
+	const off64_t sector_first = pos / sector_size;
+	const off64_t phys_offset = sector_first * WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED;
+	if (phys_offset >= d->data_size) {
+		return 0;
+	}
+
+	off64_t phys_size = d->data_size - phys_offset;
+	if (size != 0) {
+		// Include all sectors up to the end of the range.
+		const off64_t sector_last = (pos + size - 1) / sector_size;
+		const off64_t range_size = (sector_last - sector_first + 1) * WiiPartitionPrivate::SECTOR_SIZE_ENCRYPTED;
+		if (range_size < phys_size) {
+			phys_size = range_size;
+		}
+	}
+
+	return m_file->advise(d->partition_offset + d->data_offset + phys_offset, phys_size, hint);
+}
+
 /**
  * Get the used partition size.
  * This size includes the partition header and hashes,
@@ -763,4 +1300,59 @@ Nintendo_TitleID_BE_t WiiPartition::titleID(void) const
 	return d->partitionHeader.ticket.title_id;
 }
 
+
+/** Hash verification **/
+
+/**
+ * Verify the partition's hash tree.
+ *
+ * Each sector's data is checked against H0, and the H0, H1, and H2
+ * tables are checked against H1, H2, and H3. The H3 table is checked
+ * against the TMD. Reading, decryption, and hashing are overlapped
+ * and spread across all available CPUs.
+ *
+ * Sizes passed to the progress callback are physical sizes,
+ * i.e. they're based on size(), not the decrypted data size.
+ *
+ * @param pResult	[out] Verification results
+ * @param callback	[in,opt] Progress callback
+ * @param userdata	[in,opt] User data for the progress callback
+ * @return 0 if verification completed (check pResult for bad hashes); -ECANCELED if cancelled; negative POSIX error code on error.
+ */
+int WiiPartition::verifyHashes(HashVerifyResult *pResult, VerifyProgressCallback callback, void *userdata)
+{
+	RP_D(WiiPartition);
+	assert(pResult != nullptr);
+	if (!pResult) {
+		return -EINVAL;
+	} else if (!m_file || !m_file->isOpen()) {
+		m_lastError = EBADF;
+		return -EBADF;
+	}
+
+	if ((d->cryptoMethod & CM_MASK_SECTOR) == CM_32K) {
+		// No hashes.
+		m_lastError = ENOTSUP;
+		return -ENOTSUP;
+	}
+
+#ifdef ENABLE_DECRYPTION
+	if ((d->cryptoMethod & CM_MASK_ENCRYPTED) == CM_ENCRYPTED) {
+		// Make sure decryption is initialized.
+		if (d->initDecryption() != KeyManager::VerifyResult::OK) {
+			m_lastError = EIO;
+			return -EIO;
+		}
+	}
+
+	return d->verifyHashes(pResult, callback, userdata);
+#else /* !ENABLE_DECRYPTION */
+	// SHA-1 isn't available.
+	RP_UNUSED(callback);
+	RP_UNUSED(userdata);
+	m_lastError = ENOTSUP;
+	return -ENOTSUP;
+#endif /* ENABLE_DECRYPTION */
+}
+
 }
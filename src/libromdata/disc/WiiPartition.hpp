@@ -18,6 +18,11 @@
 // WiiTicket for EncryptionKeys
 #include "../Console/WiiTicket.hpp"
 
+#include "dll-macros.h"	// for RP_LIBROMDATA_PUBLIC
+
+// C++ includes
+#include <vector>
+
 namespace LibRomData {
 
 class WiiPartitionPrivate;
@@ -50,8 +55,12 @@ public:
 	 * @param partition_size	[in] Calculated partition size. Used if the size in the header is 0.
 	 * @param cryptoMethod		[in] Crypto method
 	 */
+	RP_LIBROMDATA_PUBLIC
 	WiiPartition(const LibRpBase::IDiscReaderPtr &discReader, off64_t partition_offset,
 		off64_t partition_size, CryptoMethod crypto = CM_STANDARD);
+public:
+	RP_LIBROMDATA_PUBLIC
+	~WiiPartition() final;
 
 private:
 	typedef GcnPartition super;
@@ -87,6 +96,19 @@ public:
 	 */
 	off64_t tell(void) final;
 
+public:
+	/** Access pattern hints **/
+
+	/**
+	 * Tell the OS how a range of the partition will be accessed.
+	 * The range is converted to the corresponding physical sectors.
+	 * @param pos	[in] Start position.
+	 * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+	 * @param hint	[in] Access hint.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	int advise(off64_t pos, off64_t size, AccessHint hint) final;
+
 public:
 	/**
 	 * Get the used partition size.
@@ -135,6 +157,54 @@ public:
 	 * @return Title ID. (0-0 if unavailable)
 	 */
 	Nintendo_TitleID_BE_t titleID(void) const;
+
+public:
+	/** Hash verification **/
+
+	/**
+	 * Hash verification results.
+	 * Sector counts are for 32 KB physical sectors.
+	 */
+	struct HashVerifyResult {
+		uint32_t sectors;		// Number of sectors checked
+		uint32_t bad_sectors;		// Number of sectors with at least one bad hash
+		uint32_t bad_h0;		// Sectors whose data doesn't match H0
+		uint32_t bad_h1;		// Sectors whose H0 table doesn't match H1
+		uint32_t bad_h2;		// Sectors whose H1 table doesn't match H2
+		uint32_t bad_h3;		// Sectors whose H2 table doesn't match H3
+		bool h3_table_ok;		// True if the H3 table matches the TMD
+		std::vector<uint32_t> badSectorList;	// Bad sector numbers (up to BAD_SECTOR_LIST_MAX)
+	};
+	static constexpr size_t BAD_SECTOR_LIST_MAX = 256;
+
+	/**
+	 * Hash verification progress callback.
+	 * @param done		[in] Number of bytes verified
+	 * @param total		[in] Total number of bytes to verify
+	 * @param userdata	[in] User data
+	 * @return 0 to continue; non-zero to cancel.
+	 */
+	typedef int (*VerifyProgressCallback)(uint64_t done, uint64_t total, void *userdata);
+
+	/**
+	 * Verify the partition's hash tree.
+	 *
+	 * Each sector's data is checked against H0, and the H0, H1, and H2
+	 * tables are checked against H1, H2, and H3. The H3 table is checked
+	 * against the TMD. Reading, decryption, and hashing are overlapped
+	 * and spread across all available CPUs.
+	 *
+	 * Sizes passed to the progress callback are physical sizes,
+	 * i.e. they're based on size(), not the decrypted data size.
+	 *
+	 * @param pResult	[out] Verification results
+	 * @param callback	[in,opt] Progress callback
+	 * @param userdata	[in,opt] User data for the progress callback
+	 * @return 0 if verification completed (check pResult for bad hashes); -ECANCELED if cancelled; negative POSIX error code on error.
+	 */
+	RP_LIBROMDATA_PUBLIC
+	int verifyHashes(HashVerifyResult *pResult,
+		VerifyProgressCallback callback = nullptr, void *userdata = nullptr);
 };
 
 typedef std::shared_ptr<WiiPartition> WiiPartitionPtr;
@@ -300,8 +300,12 @@ const rp::uvector<uint8_t> *XDVDFSPartitionPrivate::getDirectory(const char *pat
 	}
 
 	// Read the directory.
+	// The entire directory table is read at once, so let the OS start reading it now.
 	rp::uvector<uint8_t> dirTable(dir_size);
+	q->m_file->advise(dir_addr, dir_size, IRpFile::AH_WILLNEED);
 	size_t size = q->m_file->seekAndRead(dir_addr, dirTable.data(), dirTable.size());
+	// The directory table is cached, so its pages aren't needed anymore.
+	q->m_file->advise(dir_addr, dir_size, IRpFile::AH_DONTNEED);
 	if (size != dirTable.size()) {
 		// Seek and/or read error.
 		q->m_lastError = q->m_file->lastError();
@@ -0,0 +1,159 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata)                       *
+ * chd_structs.h: MAME Compressed Hunks of Data (CHD) structs.             *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// References:
+// - https://github.com/mamedev/mame/blob/master/src/lib/util/chd.h
+// - https://github.com/mamedev/mame/blob/master/src/lib/util/chd.cpp
+// - https://github.com/mamedev/mame/blob/master/src/lib/util/chdcodec.cpp
+// - https://github.com/mamedev/mame/blob/master/src/lib/util/cdrom.h
+
+#pragma once
+
+#include <stdint.h>
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * CHD v5 header.
+ *
+ * All fields are in big-endian.
+ */
+#define CHD_MAGIC "MComprHD"
+#define CHD_V5_HEADER_SIZE 124
+#pragma pack(1)
+typedef struct PACKED _ChdHeaderV5 {
+	char magic[8];			// [0x000] "MComprHD"
+	uint32_t length;		// [0x008] Header length (124)
+	uint32_t version;		// [0x00C] Header version (5)
+	uint32_t compressors[4];	// [0x010] Compressors (fourCCs; 0 == none)
+	uint64_t logical_bytes;		// [0x020] Logical size of the data, in bytes
+	uint64_t map_offset;		// [0x028] Offset of the hunk map
+	uint64_t meta_offset;		// [0x030] Offset of the first metadata entry
+	uint32_t hunk_bytes;		// [0x038] Bytes per hunk
+	uint32_t unit_bytes;		// [0x03C] Bytes per unit within each hunk
+	uint8_t raw_sha1[20];		// [0x040] Raw data SHA-1
+	uint8_t sha1[20];		// [0x054] Combined raw+meta SHA-1
+	uint8_t parent_sha1[20];	// [0x068] Parent CHD's combined SHA-1 (all zero if none)
+} ChdHeaderV5;
+ASSERT_STRUCT(ChdHeaderV5, CHD_V5_HEADER_SIZE);
+#pragma pack()
+
+// Maximum hunk size supported by rom-properties.
+// MAME's default hunk size is 4 KB (HD) or 19,584 bytes (CD),
+// and chdman allows up to 1 MB.
+#define CHD_HUNK_BYTES_MAX (1024U*1024U)
+
+/**
+ * CHD codecs. (fourCCs)
+ */
+typedef enum {
+	CHD_CODEC_NONE		= 0,
+
+	// General codecs
+	CHD_CODEC_ZLIB		= 'zlib',
+	CHD_CODEC_ZSTD		= 'zstd',
+	CHD_CODEC_LZMA		= 'lzma',
+	CHD_CODEC_HUFFMAN	= 'huff',
+	CHD_CODEC_FLAC		= 'flac',
+
+	// CD-ROM codecs
+	// Sector data and subcode data are compressed separately.
+	CHD_CODEC_CD_ZLIB	= 'cdzl',
+	CHD_CODEC_CD_ZSTD	= 'cdzs',
+	CHD_CODEC_CD_LZMA	= 'cdlz',
+	CHD_CODEC_CD_FLAC	= 'cdfl',
+
+	// A/V codecs
+	CHD_CODEC_AVHUFF	= 'avhu',
+} CHD_Codec_e;
+
+/**
+ * CHD v5 compressed map header.
+ *
+ * All fields are in big-endian.
+ */
+typedef struct _ChdMapHeaderV5 {
+	uint32_t length;		// [0x000] Length of the compressed map
+	uint8_t data_start[6];		// [0x004] Offset of the first hunk (48-bit)
+	uint16_t crc16;			// [0x00A] CRC-16 of the decompressed map
+	uint8_t length_bits;		// [0x00C] Bits used to store the compressed length
+	uint8_t self_bits;		// [0x00D] Bits used to store self-references
+	uint8_t parent_bits;		// [0x00E] Bits used to store parent references
+	uint8_t reserved;		// [0x00F]
+} ChdMapHeaderV5;
+ASSERT_STRUCT(ChdMapHeaderV5, 16);
+
+/**
+ * CHD v5 map entry compression types.
+ * Types 0-3 refer to the compressors in the header.
+ * Types 7 and up are only used in the compressed map.
+ */
+typedef enum {
+	CHD_COMPRESSION_TYPE_0		= 0,	// Codec #0
+	CHD_COMPRESSION_TYPE_1		= 1,	// Codec #1
+	CHD_COMPRESSION_TYPE_2		= 2,	// Codec #2
+	CHD_COMPRESSION_TYPE_3		= 3,	// Codec #3
+	CHD_COMPRESSION_NONE		= 4,	// Uncompressed
+	CHD_COMPRESSION_SELF		= 5,	// Same as another hunk in this CHD
+	CHD_COMPRESSION_PARENT		= 6,	// Same as a hunk in the parent CHD
+
+	CHD_COMPRESSION_RLE_SMALL	= 7,	// Repeat the last compression type (2-17 times)
+	CHD_COMPRESSION_RLE_LARGE	= 8,	// Repeat the last compression type (18-273 times)
+	CHD_COMPRESSION_SELF_0		= 9,	// Same as the last SELF hunk
+	CHD_COMPRESSION_SELF_1		= 10,	// Same as the last SELF hunk + 1
+	CHD_COMPRESSION_PARENT_SELF	= 11,	// Same as the same hunk in the parent CHD
+	CHD_COMPRESSION_PARENT_0	= 12,	// Same as the last PARENT hunk
+	CHD_COMPRESSION_PARENT_1	= 13,	// Same as the last PARENT hunk + 1
+} CHD_Compression_e;
+
+/**
+ * CHD metadata entry header.
+ * The entry data immediately follows the header.
+ *
+ * All fields are in big-endian.
+ */
+typedef struct _ChdMetadataHeader {
+	uint32_t tag;			// [0x000] Metadata tag (fourCC)
+	uint32_t flags_length;		// [0x004] High 8 bits: flags; low 24 bits: data length
+	uint64_t next;			// [0x008] Offset of the next entry (0 if last)
+} ChdMetadataHeader;
+ASSERT_STRUCT(ChdMetadataHeader, 16);
+
+/**
+ * CHD metadata tags.
+ */
+typedef enum {
+	CHD_META_HARD_DISK		= 'GDDD',	// Hard disk geometry
+	CHD_META_CDROM_OLD		= 'CHCD',	// CD-ROM TOC (binary; old format)
+	CHD_META_CDROM_TRACK		= 'CHTR',	// CD-ROM track (text)
+	CHD_META_CDROM_TRACK2		= 'CHT2',	// CD-ROM track with pregap/postgap (text)
+	CHD_META_GDROM_TRACK		= 'CHGD',	// GD-ROM track (text)
+	CHD_META_DVD			= 'DVD ',	// DVD
+} CHD_Metadata_Tag_e;
+
+/**
+ * CHD CD-ROM frame layout.
+ * Each frame has a full 2352-byte sector followed by
+ * 96 bytes of subcode data.
+ */
+#define CHD_CD_MAX_SECTOR_DATA	2352
+#define CHD_CD_MAX_SUBCODE_DATA	96
+#define CHD_CD_FRAME_SIZE	(CHD_CD_MAX_SECTOR_DATA + CHD_CD_MAX_SUBCODE_DATA)
+
+// Tracks are padded to a multiple of 4 frames.
+#define CHD_CD_TRACK_PADDING	4
+
+// GD-ROM high-density area starting LBA.
+#define CHD_GDROM_HD_AREA_LBA	45000
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
@@ -0,0 +1,194 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata)                       *
+ * wia_structs.h: Wii ISO Archive (WIA) and RVZ structs.                   *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// References:
+// - https://github.com/dolphin-emu/dolphin/blob/master/docs/WiaAndRvz.md
+// - https://github.com/dolphin-emu/dolphin/blob/master/Source/Core/DiscIO/WIABlob.cpp
+// - https://github.com/dolphin-emu/dolphin/blob/master/Source/Core/DiscIO/LaggedFibonacciGenerator.cpp
+
+#pragma once
+
+#include <stdint.h>
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * WIA/RVZ file header. (wia_file_head_t)
+ * Located at the start of the file.
+ *
+ * All fields are in big-endian.
+ */
+#define WIA_MAGIC 'WIA\x01'
+#define RVZ_MAGIC 'RVZ\x01'
+#define WIA_VERSION 0x01000000U
+#define WIA_VERSION_READ_COMPATIBLE 0x00080000U
+#define RVZ_VERSION 0x01000000U
+#define RVZ_VERSION_READ_COMPATIBLE 0x00030000U
+#pragma pack(1)
+typedef struct PACKED _WIA_FileHeader {
+	uint32_t magic;			// [0x000] 'WIA\x01' or 'RVZ\x01'
+	uint32_t version;		// [0x004] Version
+	uint32_t version_compatible;	// [0x008] Oldest compatible version
+	uint32_t disc_size;		// [0x00C] Size of WIA_Disc
+	uint8_t disc_hash[20];		// [0x010] SHA-1 of WIA_Disc
+	uint64_t iso_file_size;		// [0x024] Size of the original ISO image
+	uint64_t wia_file_size;		// [0x02C] Size of this file
+	uint8_t file_head_hash[20];	// [0x034] SHA-1 of this struct, up to this field
+} WIA_FileHeader;
+ASSERT_STRUCT(WIA_FileHeader, 0x48);
+#pragma pack()
+
+/**
+ * WIA/RVZ disc information. (wia_disc_t)
+ * Located immediately after WIA_FileHeader.
+ *
+ * All fields are in big-endian.
+ */
+#pragma pack(1)
+typedef struct PACKED _WIA_Disc {
+	uint32_t disc_type;		// [0x000] Disc type (see WIA_DiscType_e)
+	uint32_t compression;		// [0x004] Compression method (see WIA_Compression_e)
+	int32_t compr_level;		// [0x008] Compression level (informational)
+	uint32_t chunk_size;		// [0x00C] Group size, in bytes (multiple of 32 KB)
+	uint8_t dhead[0x80];		// [0x010] First 0x80 bytes of the disc image
+	uint32_t n_part;		// [0x090] Number of WIA_Partition entries
+	uint32_t part_t_size;		// [0x094] Size of each WIA_Partition entry
+	uint64_t part_off;		// [0x098] Offset of the WIA_Partition table
+	uint8_t part_hash[20];		// [0x0A0] SHA-1 of the WIA_Partition table
+	uint32_t n_raw_data;		// [0x0B4] Number of WIA_RawData entries
+	uint64_t raw_data_off;		// [0x0B8] Offset of the WIA_RawData table
+	uint32_t raw_data_size;		// [0x0C0] Compressed size of the WIA_RawData table
+	uint32_t n_groups;		// [0x0C4] Number of group entries
+	uint64_t group_off;		// [0x0C8] Offset of the group table
+	uint32_t group_size;		// [0x0D0] Compressed size of the group table
+	uint8_t compr_data_len;		// [0x0D4] Length of compr_data
+	uint8_t compr_data[7];		// [0x0D5] Compressor properties (LZMA/LZMA2)
+} WIA_Disc;
+ASSERT_STRUCT(WIA_Disc, 0xDC);
+#pragma pack()
+
+/**
+ * WIA disc type.
+ */
+typedef enum {
+	WIA_DISC_TYPE_GCN	= 1,
+	WIA_DISC_TYPE_WII	= 2,
+} WIA_DiscType_e;
+
+/**
+ * WIA compression method.
+ * RVZ doesn't allow PURGE or LZMA.
+ */
+typedef enum {
+	WIA_COMPRESSION_NONE	= 0,
+	WIA_COMPRESSION_PURGE	= 1,	// Zero runs removed; not otherwise compressed
+	WIA_COMPRESSION_BZIP2	= 2,
+	WIA_COMPRESSION_LZMA	= 3,
+	WIA_COMPRESSION_LZMA2	= 4,
+	WIA_COMPRESSION_ZSTD	= 5,	// RVZ only
+} WIA_Compression_e;
+
+/**
+ * WIA partition data entry. (wia_part_data_t)
+ *
+ * Partition data is stored decrypted, without the
+ * 0x400-byte hash area at the start of each sector.
+ *
+ * All fields are in big-endian.
+ */
+typedef struct _WIA_PartitionData {
+	uint32_t first_sector;		// [0x000] First sector on the disc (32 KB units)
+	uint32_t n_sectors;		// [0x004] Number of sectors
+	uint32_t group_index;		// [0x008] First group index
+	uint32_t n_groups;		// [0x00C] Number of groups
+} WIA_PartitionData;
+ASSERT_STRUCT(WIA_PartitionData, 16);
+
+/**
+ * WIA partition entry. (wia_part_t)
+ *
+ * All fields are in big-endian.
+ */
+typedef struct _WIA_Partition {
+	uint8_t part_key[16];		// [0x000] Decrypted title key
+	WIA_PartitionData pd[2];	// [0x010] Partition data entries
+} WIA_Partition;
+ASSERT_STRUCT(WIA_Partition, 48);
+
+/**
+ * WIA raw data entry. (wia_raw_data_t)
+ * Covers everything that isn't Wii partition data.
+ *
+ * All fields are in big-endian.
+ */
+#pragma pack(1)
+typedef struct PACKED _WIA_RawData {
+	uint64_t raw_data_off;		// [0x000] Offset on the disc
+	uint64_t raw_data_size;		// [0x008] Size, in bytes
+	uint32_t group_index;		// [0x010] First group index
+	uint32_t n_groups;		// [0x014] Number of groups
+} WIA_RawData;
+ASSERT_STRUCT(WIA_RawData, 24);
+#pragma pack()
+
+/**
+ * WIA group entry. (wia_group_t)
+ *
+ * All fields are in big-endian.
+ */
+typedef struct _WIA_Group {
+	uint32_t data_off4;		// [0x000] File offset, divided by 4
+	uint32_t data_size;		// [0x004] Stored size (0 == all zeroes)
+} WIA_Group;
+ASSERT_STRUCT(WIA_Group, 8);
+
+/**
+ * RVZ group entry.
+ *
+ * All fields are in big-endian.
+ */
+typedef struct _RVZ_Group {
+	uint32_t data_off4;		// [0x000] File offset, divided by 4
+	uint32_t data_size;		// [0x004] Stored size; bit 31 == compressed
+	uint32_t rvz_packed_size;	// [0x008] Size before RVZ unpacking (0 if not packed)
+} RVZ_Group;
+ASSERT_STRUCT(RVZ_Group, 12);
+#define RVZ_GROUP_COMPRESSED	0x80000000U
+
+/**
+ * WIA hash exception. (wia_except_t)
+ * Partition data groups start with exception lists, each of
+ * which is a 16-bit count followed by the exceptions. One list
+ * is stored for each 2 MB of the group, with a minimum of 1.
+ *
+ * All fields are in big-endian.
+ */
+#pragma pack(1)
+typedef struct PACKED _WIA_Exception {
+	uint16_t offset;		// [0x000] Offset within the hash areas covered by the list
+	uint8_t hash[20];		// [0x002] SHA-1 that differs from the calculated value
+} WIA_Exception;
+ASSERT_STRUCT(WIA_Exception, 22);
+#pragma pack()
+
+// Maximum group size supported by rom-properties.
+// wit uses 2 MB by default, and Dolphin allows up to 2 MB
+// for RVZ; larger sizes are allowed for WIA.
+#define WIA_CHUNK_SIZE_MAX (8U*1024U*1024U)
+
+// RVZ junk data: Lagged Fibonacci generator parameters.
+#define RVZ_LFG_K		521
+#define RVZ_LFG_J		32
+#define RVZ_LFG_SEED_SIZE	17
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
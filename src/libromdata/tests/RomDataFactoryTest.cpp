@@ -0,0 +1,244 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata/tests)                 *
+ * RomDataFactoryTest.cpp: RomDataFactory::createBatch() test              *
+ *                                                                         *
+ * Extracts sample ROM headers from the RomHeaders .tar files and checks   *
+ * that createBatch() returns the same RomData subclasses as create().     *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// For .tar.zst
+#include "microtar_zstd.h"
+
+// Other rom-properties libraries
+#include "libromdata/RomDataFactory.hpp"
+#include "librpbase/RomData.hpp"
+using namespace LibRpBase;
+
+// C includes
+#ifdef _WIN32
+#  include <process.h>
+#  define getpid() _getpid()
+#else /* !_WIN32 */
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+// C includes (C++ namespace)
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <array>
+#include <string>
+#include <vector>
+using std::array;
+using std::string;
+using std::vector;
+
+// Uninitialized vector class
+#include "uvector.h"
+
+namespace LibRomData { namespace Tests {
+
+class RomDataFactoryTest : public ::testing::Test
+{
+	protected:
+		RomDataFactoryTest() = default;
+
+	public:
+		// Maximum number of files to extract from each .tar file.
+		static constexpr unsigned int MAX_FILES_PER_TAR = 8;
+
+		/**
+		 * Extract files from a .bin.tar.zst file into the temporary directory.
+		 * The original file extensions are kept, since some RomData
+		 * subclasses check the file extension.
+		 * @param tar_filename	[in] .bin.tar.zst filename
+		 * @param filenames	[out] Extracted filenames
+		 */
+		static void extractTar(const char *tar_filename, vector<string> &filenames);
+};
+
+void RomDataFactoryTest::extractTar(const char *tar_filename, vector<string> &filenames)
+{
+	string tmpDir = ::testing::TempDir();
+	if (!tmpDir.empty() && tmpDir.back() != '/' && tmpDir.back() != '\\') {
+		tmpDir += '/';
+	}
+
+	mtar_t tar;
+	int ret = mtar_zstd_open_ro(&tar, tar_filename);
+	ASSERT_EQ(0, ret) << "Could not open '" << tar_filename << "', check the test directory!";
+
+	mtar_header_t h;
+	rp::uvector<uint8_t> buf;
+	unsigned int count = 0;
+	for (; count < MAX_FILES_PER_TAR; mtar_next(&tar)) {
+		int err = mtar_read_header(&tar, &h);
+		if (err == MTAR_ENULLRECORD) {
+			// Finished reading the .tar file.
+			break;
+		}
+		EXPECT_EQ(MTAR_ESUCCESS, err) << "Error reading from '" << tar_filename << "'.";
+		if (err != MTAR_ESUCCESS)
+			break;
+		if (h.type != 0 /*MTAR_TREG*/) {
+			// Not a regular file.
+			continue;
+		}
+
+		buf.resize(h.size);
+		err = mtar_read_data(&tar, buf.data(), h.size);
+		EXPECT_EQ(MTAR_ESUCCESS, err) << "Error reading '" << h.name << "' from '" << tar_filename << "'.";
+		if (err != MTAR_ESUCCESS)
+			break;
+
+		// Use the basename, with a unique prefix.
+		const char *basename = strrchr(h.name, '/');
+		basename = (basename ? basename + 1 : h.name);
+		char prefix[32];
+		snprintf(prefix, sizeof(prefix), "RDFT.%u.%u.",
+			static_cast<unsigned int>(getpid()),
+			static_cast<unsigned int>(filenames.size()));
+		string filename = tmpDir + prefix + basename;
+
+		FILE *f = fopen(filename.c_str(), "wb");
+		EXPECT_NE(nullptr, f) << "Could not create '" << filename << "'.";
+		if (!f)
+			break;
+		const size_t size = fwrite(buf.data(), 1, buf.size(), f);
+		fclose(f);
+		EXPECT_EQ(buf.size(), size);
+
+		filenames.emplace_back(std::move(filename));
+		count++;
+	}
+
+	mtar_close(&tar);
+}
+
+/**
+ * createBatch() should return the same RomData subclasses as create().
+ */
+TEST_F(RomDataFactoryTest, createBatch)
+{
+	static constexpr array<const char*, 6> tar_filenames = {{
+		"Console/MegaDrive.bin.tar.zst",
+		"Console/NES.bin.tar.zst",
+		"Console/SNES.bin.tar.zst",
+		"Handheld/DMG.bin.tar.zst",
+		"Handheld/GameBoyAdvance.bin.tar.zst",
+		"Handheld/NintendoDS.bin.tar.zst",
+	}};
+
+	vector<string> filenames;
+	for (const char *tar_filename : tar_filenames) {
+		extractTar(tar_filename, filenames);
+	}
+	ASSERT_FALSE(filenames.empty());
+
+	// Add a nonexistent file and a directory.
+	// createBatch() should return nullptr for these.
+	filenames.emplace_back(::testing::TempDir() + "RDFT.nonexistent.bin");
+	filenames.emplace_back(".");
+
+	vector<const char*> c_filenames;
+	c_filenames.reserve(filenames.size());
+	for (const string &filename : filenames) {
+		c_filenames.push_back(filename.c_str());
+	}
+
+	const vector<RomDataPtr> batch = RomDataFactory::createBatch(c_filenames.data(), c_filenames.size());
+	ASSERT_EQ(filenames.size(), batch.size());
+
+	unsigned int supported = 0;
+	for (size_t i = 0; i < filenames.size(); i++) {
+		const RomDataPtr romData = RomDataFactory::create(filenames[i].c_str());
+		if (!romData) {
+			EXPECT_FALSE(batch[i]) << filenames[i];
+			continue;
+		}
+
+		ASSERT_TRUE(batch[i]) << filenames[i];
+		EXPECT_STREQ(romData->className(), batch[i]->className()) << filenames[i];
+		EXPECT_EQ(romData->isValid(), batch[i]->isValid()) << filenames[i];
+		supported++;
+	}
+	EXPECT_GT(supported, 0U);
+
+	// Remove the extracted files.
+	for (size_t i = 0; i < filenames.size() - 2; i++) {
+		remove(filenames[i].c_str());
+	}
+}
+
+/**
+ * createBatch() with no files should return an empty vector.
+ */
+TEST_F(RomDataFactoryTest, createBatchEmpty)
+{
+	const vector<RomDataPtr> batch = RomDataFactory::createBatch(nullptr, 0);
+	EXPECT_TRUE(batch.empty());
+}
+
+} }
+
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fprintf(stderr, "LibRomData test suite: RomDataFactory tests.\n\n");
+	fflush(nullptr);
+
+	// Check for the RomHeaders directory and chdir() into it.
+#ifdef _WIN32
+	static constexpr array<const TCHAR*, 11> subdirs = {{
+		_T("RomHeaders"),
+		_T("bin\\RomHeaders"),
+		_T("src\\libromdata\\tests\\RomHeaders"),
+		_T("..\\src\\libromdata\\tests\\RomHeaders"),
+		_T("..\\..\\src\\libromdata\\tests\\RomHeaders"),
+		_T("..\\..\\..\\src\\libromdata\\tests\\RomHeaders"),
+		_T("..\\..\\..\\..\\src\\libromdata\\tests\\RomHeaders"),
+		_T("..\\..\\..\\..\\..\\src\\libromdata\\tests\\RomHeaders"),
+		_T("..\\..\\..\\bin\\RomHeaders"),
+		_T("..\\..\\..\\bin\\Debug\\RomHeaders"),
+		_T("..\\..\\..\\bin\\Release\\RomHeaders"),
+	}};
+#else /* !_WIN32 */
+	static constexpr array<const TCHAR* ,9> subdirs = {{
+		_T("RomHeaders"),
+		_T("bin/RomHeaders"),
+		_T("src/libromdata/tests/RomHeaders"),
+		_T("../src/libromdata/tests/RomHeaders"),
+		_T("../../src/libromdata/tests/RomHeaders"),
+		_T("../../../src/libromdata/tests/RomHeaders"),
+		_T("../../../../src/libromdata/tests/RomHeaders"),
+		_T("../../../../../src/libromdata/tests/RomHeaders"),
+		_T("../../../bin/RomHeaders"),
+	}};
+#endif /* _WIN32 */
+
+	bool is_found = false;
+	for (const TCHAR *const subdir : subdirs) {
+		if (!_taccess(subdir, R_OK)) {
+			if (_tchdir(subdir) == 0) {
+				is_found = true;
+				break;
+			}
+		}
+	}
+
+	if (!is_found) {
+		fputs("*** ERROR: Cannot find the RomHeaders test directory.\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,582 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata/tests)                 *
+ * Xbox360_STFSTest.cpp: Xbox360_STFS class test.                          *
+ *                                                                         *
+ * Builds synthetic STFS packages with one and two copies of each hash     *
+ * table, then checks the default.xex lookup and "Verify Package".         *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// Xbox360_STFS
+#include "libromdata/RomDataFactory.hpp"
+#include "libromdata/Console/xbox360_stfs_structs.h"
+#include "libromdata/Console/xbox360_xex_structs.h"
+
+// Other rom-properties libraries
+#include "librpbase/RomData.hpp"
+#include "librpbase/RomFields.hpp"
+#include "librpbase/crypto/Hash.hpp"
+#include "librpbyteswap/byteswap_rp.h"
+#include "librpfile/MemFile.hpp"
+using namespace LibRpBase;
+using namespace LibRpFile;
+
+// C includes (C++ namespace)
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <memory>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+namespace LibRomData { namespace Tests {
+
+class Xbox360_STFSTest : public ::testing::Test
+{
+	protected:
+		Xbox360_STFSTest() = default;
+
+	public:
+		// Header size, and the start of the first hash table.
+		// NOTE: 0x971A is rounded up to 0xA000, so the number
+		// of hash table copies is set by block_separation.
+		static constexpr uint32_t HEADER_SIZE = 0x971A;
+		static constexpr uint32_t DATA_START = 0xA000;
+
+		// Data blocks covered by each hash level.
+		static constexpr uint32_t LEVEL0_BLOCKS = STFS_HASH_ENTRIES_PER_TABLE;
+		static constexpr uint32_t LEVEL1_BLOCKS = LEVEL0_BLOCKS * STFS_HASH_ENTRIES_PER_TABLE;
+
+		/**
+		 * Synthetic package layout.
+		 */
+		struct PackageLayout {
+			uint32_t blockCount;	// Number of data blocks
+			bool twoCopies;		// Two copies of each hash table
+			uint32_t fileTable[2];	// File table data blocks (chained)
+			uint32_t xexBlock;	// default.xex data block
+		};
+
+		/**
+		 * Physical block number of the level-0 hash table for a data block.
+		 * Reference: https://github.com/Free60Project/wiki/blob/master/STFS.md
+		 * @param layout	[in] Package layout
+		 * @param block		[in] Data block number
+		 * @return Physical block number of the first copy
+		 */
+		static uint32_t level0TableBlock(const PackageLayout &layout, uint32_t block);
+
+		/**
+		 * Physical block number of the level-1 hash table for a data block.
+		 * @param layout	[in] Package layout
+		 * @param block		[in] Data block number
+		 * @return Physical block number of the first copy
+		 */
+		static uint32_t level1TableBlock(const PackageLayout &layout, uint32_t block);
+
+		/**
+		 * Physical block number of the level-2 hash table.
+		 * @param layout	[in] Package layout
+		 * @return Physical block number of the first copy
+		 */
+		static inline uint32_t level2TableBlock(const PackageLayout &layout)
+		{
+			return (layout.twoCopies ? 0x723A : 0x718F);
+		}
+
+		/**
+		 * Physical block number of a data block.
+		 * @param layout	[in] Package layout
+		 * @param block		[in] Data block number
+		 * @return Physical block number
+		 */
+		static inline uint32_t dataBlock(const PackageLayout &layout, uint32_t block)
+		{
+			return level0TableBlock(layout, block) + (layout.twoCopies ? 2 : 1) + (block % LEVEL0_BLOCKS);
+		}
+
+		/**
+		 * Get the active copy of a hash table.
+		 * Packages with two copies alternate between the two,
+		 * so using the wrong copy will always fail.
+		 * @param layout	[in] Package layout
+		 * @param level		[in] Hash table level
+		 * @param index		[in] Table index within the level
+		 * @return Active copy (0 or 1)
+		 */
+		static inline unsigned int activeCopy(const PackageLayout &layout, unsigned int level, uint32_t index)
+		{
+			return (layout.twoCopies ? ((level + index) & 1) : 0);
+		}
+
+		/**
+		 * Get a pointer to a physical block.
+		 * @param pkg		[in] Package
+		 * @param physBlock	[in] Physical block number
+		 * @return Block
+		 */
+		static inline uint8_t *blockPtr(vector<uint8_t> &pkg, uint32_t physBlock)
+		{
+			return &pkg[DATA_START + (static_cast<size_t>(physBlock) * STFS_BLOCK_SIZE)];
+		}
+
+		/**
+		 * Build a synthetic CON package.
+		 * The file table has two chained blocks; default.xex is
+		 * the first entry in the second block.
+		 * @param layout	[in] Package layout
+		 * @return Package
+		 */
+		static vector<uint8_t> buildPackage(const PackageLayout &layout);
+
+		/**
+		 * Open a package and check that default.xex was found.
+		 * @param pkg		[in] Package
+		 * @return RomData object
+		 */
+		static RomDataPtr openPackage(const vector<uint8_t> &pkg);
+
+		/**
+		 * Run "Verify Package" on a package.
+		 * @param pkg		[in] Package
+		 * @param params	[out] ROM operation results
+		 * @return doRomOp() return value
+		 */
+		static int verifyPackage(const vector<uint8_t> &pkg, RomData::RomOpParams &params);
+
+		/**
+		 * Get the "Verify Package" success message.
+		 * @param blocks	[in] Number of data blocks
+		 * @param tables	[in] Number of hash tables
+		 * @return Message
+		 */
+		static string okMessage(unsigned int blocks, unsigned int tables);
+};
+
+/**
+ * Store a 24-bit big-endian value.
+ * @param p Destination
+ * @param v Value
+ */
+static inline void put_be24(uint8_t *p, uint32_t v)
+{
+	p[0] = (v >> 16) & 0xFF;
+	p[1] = (v >>  8) & 0xFF;
+	p[2] =  v        & 0xFF;
+}
+
+/**
+ * Store a 24-bit little-endian value.
+ * @param p Destination
+ * @param v Value
+ */
+static inline void put_le24(uint8_t *p, uint32_t v)
+{
+	p[0] =  v        & 0xFF;
+	p[1] = (v >>  8) & 0xFF;
+	p[2] = (v >> 16) & 0xFF;
+}
+
+/**
+ * Calculate the SHA-1 hash of a block.
+ * @param hash		[in] Hash object
+ * @param digest	[out] SHA-1 hash
+ * @param data		[in] Block
+ */
+static void sha1Block(Hash &hash, uint8_t digest[20], const uint8_t *data)
+{
+	hash.reset();
+	hash.process(data, STFS_BLOCK_SIZE);
+	hash.getHash(digest, 20);
+}
+
+/**
+ * Physical block number of the level-0 hash table for a data block.
+ * Reference: https://github.com/Free60Project/wiki/blob/master/STFS.md
+ * @param layout	[in] Package layout
+ * @param block		[in] Data block number
+ * @return Physical block number of the first copy
+ */
+uint32_t Xbox360_STFSTest::level0TableBlock(const PackageLayout &layout, uint32_t block)
+{
+	const unsigned int shift = (layout.twoCopies ? 1 : 0);
+	uint32_t num = (block / LEVEL0_BLOCKS) * (layout.twoCopies ? 0xAC : 0xAB);
+	if (block >= LEVEL0_BLOCKS) {
+		num += ((block / LEVEL1_BLOCKS) + 1) << shift;
+		if (block >= LEVEL1_BLOCKS) {
+			num += 1U << shift;
+		}
+	}
+	return num;
+}
+
+/**
+ * Physical block number of the level-1 hash table for a data block.
+ * @param layout	[in] Package layout
+ * @param block		[in] Data block number
+ * @return Physical block number of the first copy
+ */
+uint32_t Xbox360_STFSTest::level1TableBlock(const PackageLayout &layout, uint32_t block)
+{
+	if (block < LEVEL1_BLOCKS) {
+		return (layout.twoCopies ? 0xAC : 0xAB);
+	}
+	return ((block / LEVEL1_BLOCKS) * level2TableBlock(layout)) + (layout.twoCopies ? 2 : 1);
+}
+
+/**
+ * Build a synthetic CON package.
+ * The file table has two chained blocks; default.xex is
+ * the first entry in the second block.
+ * @param layout	[in] Package layout
+ * @return Package
+ */
+vector<uint8_t> Xbox360_STFSTest::buildPackage(const PackageLayout &layout)
+{
+	const uint32_t count = layout.blockCount;
+	const unsigned int topLevel = (count <= LEVEL0_BLOCKS) ? 0 : (count <= LEVEL1_BLOCKS) ? 1 : 2;
+	vector<uint8_t> pkg(DATA_START + ((static_cast<size_t>(dataBlock(layout, count - 1)) + 1) * STFS_BLOCK_SIZE));
+
+	// Package header
+	STFS_Package_Header *const header = reinterpret_cast<STFS_Package_Header*>(pkg.data());
+	header->magic = cpu_to_be32(STFS_MAGIC_CON);
+	header->console.console_type = STFS_CONSOLE_TYPE_RETAIL;
+	memcpy(header->console.datestamp, "01-01-24", sizeof(header->console.datestamp));
+
+	// Package metadata
+	STFS_Package_Metadata *const metadata = reinterpret_cast<STFS_Package_Metadata*>(&pkg[STFS_METADATA_ADDRESS]);
+	metadata->header_size = cpu_to_be32(HEADER_SIZE);
+	metadata->content_type = cpu_to_be32(STFS_CONTENT_TYPE_ARCADE_TITLE);
+	metadata->descriptor_type = cpu_to_be32(0);
+	STFS_Volume_Descriptor *const desc = &metadata->stfs_desc;
+	desc->size = sizeof(*desc);
+	desc->block_separation = (layout.twoCopies ? 0 : 1) | (activeCopy(layout, topLevel, 0) ? 2 : 0);
+	desc->file_table_block_count = cpu_to_be16(2);
+	put_be24(desc->file_table_block_number, layout.fileTable[0]);
+	desc->total_alloc_block_count = cpu_to_be32(count);
+
+	// File table: The first block is full, so default.xex
+	// can only be found by following the chain.
+	STFS_DirEntry_t *dirEntry = reinterpret_cast<STFS_DirEntry_t*>(
+		blockPtr(pkg, dataBlock(layout, layout.fileTable[0])));
+	for (unsigned int i = 0; i < STFS_BLOCK_SIZE / sizeof(STFS_DirEntry_t); i++, dirEntry++) {
+		snprintf(dirEntry->filename, sizeof(dirEntry->filename), "file%02u.dat", i);
+		dirEntry->flags_len = 10;
+	}
+	dirEntry = reinterpret_cast<STFS_DirEntry_t*>(blockPtr(pkg, dataBlock(layout, layout.fileTable[1])));
+	strcpy(dirEntry->filename, "default.xex");
+	dirEntry->flags_len = 11;
+	put_le24(dirEntry->blocks, 1);
+	put_le24(dirEntry->blocks2, 1);
+	put_le24(dirEntry->block_number, layout.xexBlock);
+	dirEntry->path = cpu_to_be16(-1);
+	dirEntry->filesize = cpu_to_be32(STFS_BLOCK_SIZE);
+
+	// default.xex: XEX2 header with no optional headers.
+	XEX2_Header *const xex2Header = reinterpret_cast<XEX2_Header*>(blockPtr(pkg, dataBlock(layout, layout.xexBlock)));
+	xex2Header->magic = cpu_to_be32(XEX2_MAGIC);
+	xex2Header->sec_info_offset = cpu_to_be32(0x100);
+
+	// Hash tables. Inactive copies are filled with garbage.
+	Hash hash(Hash::Algorithm::SHA1);
+	EXPECT_TRUE(hash.isUsable());
+	auto writeTable = [&](uint32_t physBlock, unsigned int active, const STFS_HashTable &table) {
+		memcpy(blockPtr(pkg, physBlock + active), &table, sizeof(table));
+		if (layout.twoCopies) {
+			memset(blockPtr(pkg, physBlock + (active ^ 1)), 0xFF, STFS_BLOCK_SIZE);
+		}
+	};
+
+	// Level 0
+	const uint32_t groupCount = (count + LEVEL0_BLOCKS - 1) / LEVEL0_BLOCKS;
+	for (uint32_t g = 0; g < groupCount; g++) {
+		STFS_HashTable table;
+		memset(&table, 0, sizeof(table));
+		for (uint32_t j = 0; j < LEVEL0_BLOCKS && (g * LEVEL0_BLOCKS) + j < count; j++) {
+			const uint32_t block = (g * LEVEL0_BLOCKS) + j;
+			STFS_HashEntry &entry = table.entries[j];
+			sha1Block(hash, entry.sha1, blockPtr(pkg, dataBlock(layout, block)));
+			entry.status = STFS_HASH_STATUS_USED;
+			put_be24(entry.next_block, (block == layout.fileTable[0])
+				? layout.fileTable[1] : STFS_HASH_NEXT_BLOCK_END);
+		}
+		writeTable(level0TableBlock(layout, g * LEVEL0_BLOCKS), activeCopy(layout, 0, g), table);
+	}
+
+	// Level 1
+	const uint32_t level1Count = (topLevel >= 1) ? (count + LEVEL1_BLOCKS - 1) / LEVEL1_BLOCKS : 0;
+	for (uint32_t k = 0; k < level1Count; k++) {
+		STFS_HashTable table;
+		memset(&table, 0, sizeof(table));
+		for (uint32_t j = 0; j < STFS_HASH_ENTRIES_PER_TABLE && (k * STFS_HASH_ENTRIES_PER_TABLE) + j < groupCount; j++) {
+			const uint32_t g = (k * STFS_HASH_ENTRIES_PER_TABLE) + j;
+			const unsigned int active = activeCopy(layout, 0, g);
+			STFS_HashEntry &entry = table.entries[j];
+			sha1Block(hash, entry.sha1, blockPtr(pkg, level0TableBlock(layout, g * LEVEL0_BLOCKS) + active));
+			entry.status = STFS_HASH_STATUS_USED | (active ? STFS_HASH_STATUS_ACTIVE_INDEX : 0);
+		}
+		writeTable(level1TableBlock(layout, k * LEVEL1_BLOCKS), activeCopy(layout, 1, k), table);
+	}
+
+	// Level 2
+	if (topLevel == 2) {
+		STFS_HashTable table;
+		memset(&table, 0, sizeof(table));
+		for (uint32_t k = 0; k < level1Count; k++) {
+			const unsigned int active = activeCopy(layout, 1, k);
+			STFS_HashEntry &entry = table.entries[k];
+			sha1Block(hash, entry.sha1, blockPtr(pkg, level1TableBlock(layout, k * LEVEL1_BLOCKS) + active));
+			entry.status = STFS_HASH_STATUS_USED | (active ? STFS_HASH_STATUS_ACTIVE_INDEX : 0);
+		}
+		writeTable(level2TableBlock(layout), activeCopy(layout, 2, 0), table);
+	}
+
+	// Top hash table
+	const uint32_t topBlock = (topLevel == 2) ? level2TableBlock(layout)
+		: (topLevel == 1) ? level1TableBlock(layout, 0) : level0TableBlock(layout, 0);
+	sha1Block(hash, desc->top_hash_table_hash, blockPtr(pkg, topBlock + activeCopy(layout, topLevel, 0)));
+	return pkg;
+}
+
+/**
+ * Open a package and check that default.xex was found.
+ * @param pkg		[in] Package
+ * @return RomData object
+ */
+RomDataPtr Xbox360_STFSTest::openPackage(const vector<uint8_t> &pkg)
+{
+	const IRpFilePtr memFile = std::make_shared<MemFile>(pkg.data(), pkg.size());
+	RomDataPtr romData = RomDataFactory::create(memFile);
+	EXPECT_TRUE(romData && romData->isValid());
+	if (!romData) {
+		return romData;
+	}
+
+	// default.xex's fields are added in a separate tab.
+	const RomFields *const fields = romData->fields();
+	EXPECT_NE(nullptr, fields);
+	bool foundXex = false;
+	if (fields) {
+		for (int i = 0; i < fields->tabCount(); i++) {
+			const char *const tabName = fields->tabName(i);
+			if (tabName && !strcmp(tabName, "XEX2")) {
+				foundXex = true;
+				break;
+			}
+		}
+	}
+	EXPECT_TRUE(foundXex) << "default.xex was not found.";
+	return romData;
+}
+
+/**
+ * Run "Verify Package" on a package.
+ * @param pkg		[in] Package
+ * @param params	[out] ROM operation results
+ * @return doRomOp() return value
+ */
+int Xbox360_STFSTest::verifyPackage(const vector<uint8_t> &pkg, RomData::RomOpParams &params)
+{
+	const IRpFilePtr memFile = std::make_shared<MemFile>(pkg.data(), pkg.size());
+	const RomDataPtr romData = RomDataFactory::create(memFile);
+	EXPECT_TRUE(romData && romData->isValid());
+	if (!romData) {
+		return -EIO;
+	}
+	EXPECT_EQ(1U, romData->romOps().size());
+	return romData->doRomOp(0, &params);
+}
+
+/**
+ * Get the "Verify Package" success message.
+ * @param blocks	[in] Number of data blocks
+ * @param tables	[in] Number of hash tables
+ * @return Message
+ */
+string Xbox360_STFSTest::okMessage(unsigned int blocks, unsigned int tables)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "OK (%u data blocks, %u hash tables)", blocks, tables);
+	return buf;
+}
+
+// Small packages: Two level-0 groups and one level-1 table.
+// The file table crosses from data block 0xA9 to 0xAA, where
+// the first level-1 table is stored.
+static constexpr Xbox360_STFSTest::PackageLayout smallOneCopy = {
+	0xAA + 0x20, false, {0xA9, 0xAA}, 0xAB
+};
+static constexpr Xbox360_STFSTest::PackageLayout smallTwoCopies = {
+	0xAA + 0x20, true, {0xA9, 0xAA}, 0xAB
+};
+
+// Large packages: Two level-1 groups and one level-2 table.
+// The file table crosses from data block 0x70E3 to 0x70E4, where
+// the level-2 table is stored.
+static constexpr Xbox360_STFSTest::PackageLayout largeOneCopy = {
+	0x70E4 + 2, false, {0x70E3, 0x70E4}, 0x70E5
+};
+static constexpr Xbox360_STFSTest::PackageLayout largeTwoCopies = {
+	0x70E4 + 2, true, {0x70E3, 0x70E4}, 0x70E5
+};
+
+/**
+ * One copy of each hash table, with the first level-1 table.
+ */
+TEST_F(Xbox360_STFSTest, oneCopy)
+{
+	const vector<uint8_t> pkg = buildPackage(smallOneCopy);
+	ASSERT_TRUE(openPackage(pkg));
+
+	RomData::RomOpParams params;
+	EXPECT_EQ(0, verifyPackage(pkg, params));
+	EXPECT_EQ(0, params.status);
+	EXPECT_EQ(okMessage(0xAA + 0x20, 3), params.msg);
+}
+
+/**
+ * Two copies of each hash table, with the first level-1 table.
+ */
+TEST_F(Xbox360_STFSTest, twoCopies)
+{
+	const vector<uint8_t> pkg = buildPackage(smallTwoCopies);
+	ASSERT_TRUE(openPackage(pkg));
+
+	RomData::RomOpParams params;
+	EXPECT_EQ(0, verifyPackage(pkg, params));
+	EXPECT_EQ(0, params.status);
+	EXPECT_EQ(okMessage(0xAA + 0x20, 3), params.msg);
+}
+
+/**
+ * The file table is chained backwards through non-consecutive blocks.
+ */
+TEST_F(Xbox360_STFSTest, chainedFileTable)
+{
+	static constexpr PackageLayout layout = {
+		0xAA + 0x20, true, {0xC0, 0x10}, 0x50
+	};
+	const vector<uint8_t> pkg = buildPackage(layout);
+	ASSERT_TRUE(openPackage(pkg));
+}
+
+/**
+ * One copy of each hash table, with the level-2 table.
+ * A bad data block after the level-2 table is reported
+ * with the correct data block number.
+ */
+TEST_F(Xbox360_STFSTest, largeOneCopy)
+{
+	vector<uint8_t> pkg = buildPackage(largeOneCopy);
+	ASSERT_TRUE(openPackage(pkg));
+
+	// 1 level-2 table, 2 level-1 tables, 171 level-0 tables
+	RomData::RomOpParams params;
+	EXPECT_EQ(0, verifyPackage(pkg, params));
+	EXPECT_EQ(0, params.status);
+	EXPECT_EQ(okMessage(0x70E4 + 2, 174), params.msg);
+
+	blockPtr(pkg, dataBlock(largeOneCopy, 0x70E5))[STFS_BLOCK_SIZE - 1] ^= 0x01;
+	params = RomData::RomOpParams();
+	EXPECT_EQ(1, verifyPackage(pkg, params));
+	EXPECT_EQ(1, params.status);
+	EXPECT_EQ("1 of 28902 data blocks are bad.\nBad blocks: 28901", params.msg);
+}
+
+/**
+ * Two copies of each hash table, with the level-2 table.
+ * A bad level-1 table after the level-2 table is reported.
+ */
+TEST_F(Xbox360_STFSTest, largeTwoCopies)
+{
+	vector<uint8_t> pkg = buildPackage(largeTwoCopies);
+	ASSERT_TRUE(openPackage(pkg));
+
+	RomData::RomOpParams params;
+	EXPECT_EQ(0, verifyPackage(pkg, params));
+	EXPECT_EQ(0, params.status);
+	EXPECT_EQ(okMessage(0x70E4 + 2, 174), params.msg);
+
+	blockPtr(pkg, level1TableBlock(largeTwoCopies, 0x70E4) + activeCopy(largeTwoCopies, 1, 1))[0xFF0] ^= 0x01;
+	params = RomData::RomOpParams();
+	EXPECT_EQ(1, verifyPackage(pkg, params));
+	EXPECT_EQ(1, params.status);
+	EXPECT_EQ("1 of 174 hash tables are bad.", params.msg);
+}
+
+/**
+ * Corrupted data blocks are reported by data block number.
+ */
+TEST_F(Xbox360_STFSTest, corruptBlock)
+{
+	vector<uint8_t> pkg = buildPackage(smallOneCopy);
+	blockPtr(pkg, dataBlock(smallOneCopy, 5))[100] ^= 0x01;
+	blockPtr(pkg, dataBlock(smallOneCopy, 0xAA))[0] ^= 0x80;
+
+	RomData::RomOpParams params;
+	EXPECT_EQ(1, verifyPackage(pkg, params));
+	EXPECT_EQ(1, params.status);
+	EXPECT_EQ("2 of 202 data blocks are bad.\nBad blocks: 5 170", params.msg);
+}
+
+/**
+ * A corrupted level-0 table is reported.
+ * Corrupting the inactive copy of a table has no effect.
+ */
+TEST_F(Xbox360_STFSTest, corruptTable)
+{
+	vector<uint8_t> pkg = buildPackage(smallTwoCopies);
+	const uint32_t table0 = level0TableBlock(smallTwoCopies, 0);
+	const uint32_t table1 = level0TableBlock(smallTwoCopies, 0xAA);
+	blockPtr(pkg, table0 + (activeCopy(smallTwoCopies, 0, 0) ^ 1))[0] ^= 0x01;
+
+	RomData::RomOpParams params;
+	EXPECT_EQ(0, verifyPackage(pkg, params));
+	EXPECT_EQ(0, params.status);
+
+	// Padding only, so the data blocks are still OK.
+	blockPtr(pkg, table1 + activeCopy(smallTwoCopies, 0, 1))[0xFF0] ^= 0x01;
+	params = RomData::RomOpParams();
+	EXPECT_EQ(1, verifyPackage(pkg, params));
+	EXPECT_EQ(1, params.status);
+	EXPECT_EQ("1 of 3 hash tables are bad.", params.msg);
+}
+
+/**
+ * The top hash table doesn't match the volume descriptor.
+ */
+TEST_F(Xbox360_STFSTest, corruptTopTable)
+{
+	vector<uint8_t> pkg = buildPackage(smallTwoCopies);
+	blockPtr(pkg, level1TableBlock(smallTwoCopies, 0) + activeCopy(smallTwoCopies, 1, 0))[0xFF0] ^= 0x01;
+
+	RomData::RomOpParams params;
+	EXPECT_EQ(1, verifyPackage(pkg, params));
+	EXPECT_EQ(1, params.status);
+	EXPECT_EQ("Top hash table does not match the volume descriptor.", params.msg);
+}
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRomData test suite: Xbox360_STFS tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
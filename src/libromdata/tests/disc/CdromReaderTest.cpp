@@ -0,0 +1,512 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata/tests)                 *
+ * CdromReaderTest.cpp: CD-ROM image reader tests.                         *
+ * (Cdrom2352Reader, CdiReader, GdiReader)                                 *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// CD-ROM readers
+#include "libromdata/disc/Cdrom2352Reader.hpp"
+#include "libromdata/disc/CdiReader.hpp"
+#include "libromdata/disc/GdiReader.hpp"
+#include "libromdata/cdrom_structs.h"
+
+// Other rom-properties libraries
+#include "librpfile/MemFile.hpp"
+#include "librpfile/RpFile.hpp"
+using namespace LibRpBase;
+using namespace LibRpFile;
+
+// libwin32common
+#ifdef _WIN32
+#  include "libwin32common/RpWin32_sdk.h"
+#endif
+
+// C includes (C++ namespace)
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <algorithm>
+#include <memory>
+#include <vector>
+using std::vector;
+
+namespace LibRomData { namespace Tests {
+
+class CdromReaderTest : public ::testing::Test
+{
+	protected:
+		CdromReaderTest() = default;
+
+	public:
+		/**
+		 * Track description for synthetic disc images.
+		 */
+		struct TrackDesc {
+			unsigned int sectorSize;	// Physical sector size (2336, 2352, 2448)
+			uint8_t mode;			// Sector mode (1, 2; 0 == alternating)
+			uint32_t sectorCount;		// Number of sectors
+		};
+
+		/**
+		 * Get a byte of user data for a synthetic sector.
+		 * @param lba LBA
+		 * @param i Byte index
+		 * @return User data byte
+		 */
+		static inline uint8_t userData(uint32_t lba, unsigned int i)
+		{
+			return static_cast<uint8_t>((lba * 0x9E) ^ (i * 0x1F) ^ (i >> 8));
+		}
+
+		/**
+		 * Build a synthetic raw sector.
+		 * 2352-byte and 2448-byte sectors have a sync pattern and header.
+		 * 2336-byte sectors only have the Mode 2 XA subheader and data.
+		 * EDC, ECC, and subchannels are filled with junk.
+		 * @param buf		[out] Sector buffer (sectorSize bytes)
+		 * @param sectorSize	[in] Physical sector size
+		 * @param lba		[in] LBA
+		 * @param mode		[in] Sector mode (1, 2)
+		 */
+		static void buildSector(uint8_t *buf, unsigned int sectorSize, uint32_t lba, uint8_t mode);
+
+		/**
+		 * Build a synthetic track.
+		 * @param img		[in/out] Disc image (track is appended)
+		 * @param track		[in] Track description
+		 * @param lba		[in] First LBA
+		 */
+		static void buildTrack(vector<uint8_t> &img, const TrackDesc &track, uint32_t lba);
+
+		/**
+		 * Build a DiscJuggler CDI image. (v2.0)
+		 * The tracks are contiguous and start at LBA 0.
+		 * @param tracks Tracks
+		 * @return CDI image
+		 */
+		static vector<uint8_t> buildCdi(const vector<TrackDesc> &tracks);
+
+		/**
+		 * Read data from a disc reader and compare it to the expected data.
+		 * @param reader	[in] Disc reader
+		 * @param expected	[in] Expected data (entire disc)
+		 * @param pos		[in] Starting position
+		 * @param size		[in] Number of bytes to read
+		 */
+		static void checkRead(IDiscReader &reader, const vector<uint8_t> &expected, off64_t pos, size_t size);
+
+		/**
+		 * Read an entire disc using runs of different alignments,
+		 * and one sector at a time.
+		 * @param reader	[in] Disc reader
+		 * @param expected	[in] Expected data (entire disc)
+		 */
+		static void checkDisc(IDiscReader &reader, const vector<uint8_t> &expected);
+
+		/**
+		 * Get the expected user data for synthetic tracks.
+		 * @param tracks Tracks
+		 * @return Expected user data
+		 */
+		static vector<uint8_t> expectedData(const vector<TrackDesc> &tracks);
+
+		/**
+		 * Test Cdrom2352Reader with a synthetic disc image.
+		 * @param sectorSize	[in] Physical sector size (2352, 2448)
+		 * @param mode		[in] Sector mode (1, 2; 0 == alternating)
+		 */
+		static void testCdrom2352Reader(unsigned int sectorSize, uint8_t mode);
+};
+
+/**
+ * Convert a binary value to BCD.
+ * @param val Binary value (0-99)
+ * @return BCD value
+ */
+static inline uint8_t toBCD(unsigned int val)
+{
+	return static_cast<uint8_t>(((val / 10) << 4) | (val % 10));
+}
+
+/**
+ * Build a synthetic raw sector.
+ * 2352-byte and 2448-byte sectors have a sync pattern and header.
+ * 2336-byte sectors only have the Mode 2 XA subheader and data.
+ * EDC, ECC, and subchannels are filled with junk.
+ * @param buf		[out] Sector buffer (sectorSize bytes)
+ * @param sectorSize	[in] Physical sector size
+ * @param lba		[in] LBA
+ * @param mode		[in] Sector mode (1, 2)
+ */
+void CdromReaderTest::buildSector(uint8_t *buf, unsigned int sectorSize, uint32_t lba, uint8_t mode)
+{
+	memset(buf, 0xEC, sectorSize);
+
+	uint8_t *data;
+	if (sectorSize == 2336) {
+		// Mode 2 XA subheader, then user data.
+		memset(buf, 0, 8);
+		data = &buf[8];
+	} else {
+		CDROM_2352_Sector_t *const sector = reinterpret_cast<CDROM_2352_Sector_t*>(buf);
+		static const uint8_t sync[12] = {0x00,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x00};
+		memcpy(sector->sync, sync, sizeof(sync));
+		const uint32_t addr = lba + 150;
+		sector->msf.min = toBCD(addr / (75 * 60));
+		sector->msf.sec = toBCD((addr / 75) % 60);
+		sector->msf.frame = toBCD(addr % 75);
+		sector->mode = mode;
+		if (mode == 2) {
+			memset(&sector->m2xa_f1.sub, 0, sizeof(sector->m2xa_f1.sub));
+			data = sector->m2xa_f1.data;
+		} else {
+			data = sector->m1.data;
+		}
+	}
+
+	for (unsigned int i = 0; i < 2048; i++) {
+		data[i] = userData(lba, i);
+	}
+}
+
+/**
+ * Build a synthetic track.
+ * @param img		[in/out] Disc image (track is appended)
+ * @param track		[in] Track description
+ * @param lba		[in] First LBA
+ */
+void CdromReaderTest::buildTrack(vector<uint8_t> &img, const TrackDesc &track, uint32_t lba)
+{
+	size_t pos = img.size();
+	img.resize(pos + (static_cast<size_t>(track.sectorCount) * track.sectorSize));
+	for (uint32_t i = 0; i < track.sectorCount; i++, pos += track.sectorSize) {
+		const uint8_t mode = (track.mode != 0 ? track.mode : static_cast<uint8_t>((i & 1) + 1));
+		buildSector(&img[pos], track.sectorSize, lba + i, mode);
+	}
+}
+
+/**
+ * Append a little-endian value to a vector.
+ * @param v	[in/out] Vector
+ * @param val	[in] Value
+ * @param size	[in] Size of the value, in bytes
+ */
+static void appendLE(vector<uint8_t> &v, uint32_t val, unsigned int size)
+{
+	for (unsigned int i = 0; i < size; i++, val >>= 8) {
+		v.push_back(static_cast<uint8_t>(val & 0xFF));
+	}
+}
+
+/**
+ * Build a DiscJuggler CDI image. (v2.0)
+ * The tracks are contiguous and start at LBA 0.
+ * @param tracks Tracks
+ * @return CDI image
+ */
+vector<uint8_t> CdromReaderTest::buildCdi(const vector<TrackDesc> &tracks)
+{
+	// Track data
+	vector<uint8_t> img;
+	uint32_t lba = 0;
+	for (const TrackDesc &track : tracks) {
+		buildTrack(img, track, lba);
+		lba += track.sectorCount;
+	}
+
+	// Header: One session with all tracks.
+	const size_t header_pos = img.size();
+	appendLE(img, 1, 2);	// num_sessions
+	appendLE(img, static_cast<uint32_t>(tracks.size()), 2);	// num_tracks
+
+	static const uint8_t TRACK_START_MARK[10] = {0, 0, 0x01, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF};
+	lba = 0;
+	unsigned int trackNumber = 0;
+	for (const TrackDesc &track : tracks) {
+		uint32_t read_mode;
+		switch (track.sectorSize) {
+			case 2336:	read_mode = 1; break;
+			case 2352:	read_mode = 2; break;
+			case 2448:	read_mode = 4; break;
+			default:
+				assert(!"Unsupported sector size.");
+				read_mode = 0;
+				break;
+		}
+
+		appendLE(img, 0, 4);
+		img.insert(img.end(), TRACK_START_MARK, TRACK_START_MARK + sizeof(TRACK_START_MARK));
+		img.insert(img.end(), TRACK_START_MARK, TRACK_START_MARK + sizeof(TRACK_START_MARK));
+		appendLE(img, 0, 4);
+		img.push_back(0);	// filename_length
+		img.insert(img.end(), 11 + 4 + 4, 0);
+		appendLE(img, 0, 4);
+		appendLE(img, 1, 2);	// num_indexes
+		appendLE(img, track.sectorCount, 4);	// data length
+
+		// Length fields
+		appendLE(img, 0, 4);	// cd_text_count
+		img.insert(img.end(), 2, 0);
+		appendLE(img, 2, 4);	// mode (2 == data)
+		img.insert(img.end(), 4, 0);
+		appendLE(img, 0, 4);	// session_number
+		appendLE(img, trackNumber++, 4);	// track_number
+		appendLE(img, lba, 4);	// start_lba
+		appendLE(img, track.sectorCount, 4);	// total_length
+		img.insert(img.end(), 12 + 4, 0);
+		appendLE(img, read_mode, 4);
+
+		img.insert(img.end(), 29, 0);
+		lba += track.sectorCount;
+	}
+	img.insert(img.end(), 4 + 8, 0);
+
+	// Footer: Version and header offset.
+	appendLE(img, 0x80000004, 4);	// CDI_V2
+	appendLE(img, static_cast<uint32_t>(img.size() + 4 - header_pos), 4);
+	return img;
+}
+
+/**
+ * Get the expected user data for synthetic tracks.
+ * @param tracks Tracks
+ * @return Expected user data
+ */
+vector<uint8_t> CdromReaderTest::expectedData(const vector<TrackDesc> &tracks)
+{
+	vector<uint8_t> data;
+	uint32_t lba = 0;
+	for (const TrackDesc &track : tracks) {
+		for (uint32_t i = 0; i < track.sectorCount; i++, lba++) {
+			for (unsigned int j = 0; j < 2048; j++) {
+				data.push_back(userData(lba, j));
+			}
+		}
+	}
+	return data;
+}
+
+/**
+ * Read data from a disc reader and compare it to the expected data.
+ * @param reader	[in] Disc reader
+ * @param expected	[in] Expected data (entire disc)
+ * @param pos		[in] Starting position
+ * @param size		[in] Number of bytes to read
+ */
+void CdromReaderTest::checkRead(IDiscReader &reader, const vector<uint8_t> &expected, off64_t pos, size_t size)
+{
+	ASSERT_LE(pos + static_cast<off64_t>(size), static_cast<off64_t>(expected.size()));
+	vector<uint8_t> buf(size);
+	ASSERT_EQ(0, reader.seek(pos)) << "pos == " << pos;
+	ASSERT_EQ(size, reader.read(buf.data(), size)) << "pos == " << pos << ", size == " << size;
+	EXPECT_TRUE(std::equal(buf.begin(), buf.end(), expected.begin() + static_cast<size_t>(pos)))
+		<< "pos == " << pos << ", size == " << size;
+}
+
+/**
+ * Read an entire disc using runs of different alignments,
+ * and one sector at a time.
+ * @param reader	[in] Disc reader
+ * @param expected	[in] Expected data (entire disc)
+ */
+void CdromReaderTest::checkDisc(IDiscReader &reader, const vector<uint8_t> &expected)
+{
+	ASSERT_TRUE(reader.isOpen());
+	ASSERT_EQ(static_cast<off64_t>(expected.size()), reader.size());
+	const size_t disc_size = expected.size();
+
+	// One sector at a time. (readBlock())
+	for (size_t pos = 0; pos < disc_size; pos += 2048) {
+		checkRead(reader, expected, static_cast<off64_t>(pos), 2048);
+	}
+
+	// Entire disc in a single read. (readBlocks())
+	checkRead(reader, expected, 0, disc_size);
+
+	// Unaligned at both ends.
+	checkRead(reader, expected, 2048 + 0x123, disc_size - (2 * 2048) - 0x246);
+	// Aligned start, unaligned end.
+	checkRead(reader, expected, 2048, disc_size - 2048 - 1);
+	// Unaligned start, aligned end.
+	checkRead(reader, expected, 1, disc_size - 1);
+}
+
+/**
+ * Test Cdrom2352Reader with a synthetic disc image.
+ * @param sectorSize	[in] Physical sector size (2352, 2448)
+ * @param mode		[in] Sector mode (1, 2; 0 == alternating)
+ */
+void CdromReaderTest::testCdrom2352Reader(unsigned int sectorSize, uint8_t mode)
+{
+	// More sectors than RAW_SECTORS_MAX.
+	const vector<TrackDesc> tracks = {{sectorSize, mode, 150}};
+	vector<uint8_t> img;
+	buildTrack(img, tracks[0], 0);
+
+	const IRpFilePtr memFile = std::make_shared<MemFile>(img.data(), img.size());
+	const IDiscReaderPtr reader = std::make_shared<Cdrom2352Reader>(memFile, sectorSize);
+	checkDisc(*reader, expectedData(tracks));
+}
+
+/**
+ * Cdrom2352Reader: 2352-byte Mode 1 sectors.
+ */
+TEST_F(CdromReaderTest, Cdrom2352Reader_2352_Mode1)
+{
+	testCdrom2352Reader(2352, 1);
+}
+
+/**
+ * Cdrom2352Reader: 2352-byte Mode 2 XA sectors.
+ */
+TEST_F(CdromReaderTest, Cdrom2352Reader_2352_Mode2XA)
+{
+	testCdrom2352Reader(2352, 2);
+}
+
+/**
+ * Cdrom2352Reader: 2352-byte sectors, alternating Mode 1 and Mode 2 XA.
+ */
+TEST_F(CdromReaderTest, Cdrom2352Reader_2352_Mixed)
+{
+	testCdrom2352Reader(2352, 0);
+}
+
+/**
+ * Cdrom2352Reader: 2448-byte Mode 1 sectors. (with subchannels)
+ */
+TEST_F(CdromReaderTest, Cdrom2352Reader_2448_Mode1)
+{
+	testCdrom2352Reader(2448, 1);
+}
+
+/**
+ * Cdrom2352Reader: 2448-byte Mode 2 XA sectors. (with subchannels)
+ */
+TEST_F(CdromReaderTest, Cdrom2352Reader_2448_Mode2XA)
+{
+	testCdrom2352Reader(2448, 2);
+}
+
+/**
+ * CdiReader: Tracks with 2352-byte, 2336-byte, and 2448-byte sectors.
+ * Runs cross the track boundaries.
+ */
+TEST_F(CdromReaderTest, CdiReader_MultiTrack)
+{
+	// The 2336-byte track has more sectors than RAW_SECTORS_MAX.
+	const vector<TrackDesc> tracks = {
+		{2352, 1, 40},
+		{2336, 2, 70},
+		{2448, 0, 30},
+	};
+	const vector<uint8_t> img = buildCdi(tracks);
+	const vector<uint8_t> expected = expectedData(tracks);
+
+	const IRpFilePtr memFile = std::make_shared<MemFile>(img.data(), img.size());
+	const IDiscReaderPtr reader = std::make_shared<CdiReader>(memFile);
+	checkDisc(*reader, expected);
+
+	// Short runs across each track boundary.
+	checkRead(*reader, expected, (39 * 2048) + 0x10, 2048 + 0x20);
+	checkRead(*reader, expected, 38 * 2048, 4 * 2048);
+	checkRead(*reader, expected, (108 * 2048) + 0x7FF, (3 * 2048) + 2);
+	checkRead(*reader, expected, 109 * 2048, 2 * 2048);
+}
+
+/**
+ * GdiReader: Two data tracks. (Mode 1, then Mode 2 XA)
+ * Runs cross the track boundary.
+ */
+TEST_F(CdromReaderTest, GdiReader_MultiTrack)
+{
+	// Get the expected data from the raw tracks.
+	vector<uint8_t> expected;
+	for (const char *const filename : {"track01.bin", "track02.bin"}) {
+		const IRpFilePtr trackFile = std::make_shared<RpFile>(filename, RpFile::FM_OPEN_READ);
+		ASSERT_TRUE(trackFile->isOpen()) << "filename == " << filename;
+		CDROM_2352_Sector_t sector;
+		while (trackFile->read(&sector, sizeof(sector)) == sizeof(sector)) {
+			const uint8_t *const data = (sector.mode == 2 ? sector.m2xa_f1.data : sector.m1.data);
+			expected.insert(expected.end(), data, data + 2048);
+		}
+	}
+	ASSERT_EQ(10U * 2048U, expected.size());
+
+	const IRpFilePtr gdiFile = std::make_shared<RpFile>("test.gdi", RpFile::FM_OPEN_READ);
+	ASSERT_TRUE(gdiFile->isOpen());
+	const IDiscReaderPtr reader = std::make_shared<GdiReader>(gdiFile);
+	checkDisc(*reader, expected);
+
+	// Short runs across the track boundary.
+	checkRead(*reader, expected, (4 * 2048) + 0x10, 2048 + 0x20);
+	checkRead(*reader, expected, 3 * 2048, 4 * 2048);
+}
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRomData test suite: CD-ROM reader tests.\n\n", stderr);
+	fflush(nullptr);
+
+#ifdef _WIN32
+	// Check for the cdrom_data directory and chdir() into it.
+	static constexpr const TCHAR *const subdirs[] = {
+		_T("cdrom_data"),
+		_T("bin\\cdrom_data"),
+		_T("src\\libromdata\\tests\\disc\\cdrom_data"),
+		_T("..\\src\\libromdata\\tests\\disc\\cdrom_data"),
+		_T("..\\..\\src\\libromdata\\tests\\disc\\cdrom_data"),
+		_T("..\\..\\..\\src\\libromdata\\tests\\disc\\cdrom_data"),
+		_T("..\\..\\..\\..\\src\\libromdata\\tests\\disc\\cdrom_data"),
+		_T("..\\..\\..\\..\\..\\src\\libromdata\\tests\\disc\\cdrom_data"),
+		_T("..\\..\\..\\bin\\cdrom_data"),
+		_T("..\\..\\..\\bin\\Debug\\cdrom_data"),
+		_T("..\\..\\..\\bin\\Release\\cdrom_data"),
+	};
+#else /* !_WIN32 */
+	static constexpr const TCHAR *const subdirs[] = {
+		_T("cdrom_data"),
+		_T("bin/cdrom_data"),
+		_T("src/libromdata/tests/disc/cdrom_data"),
+		_T("../src/libromdata/tests/disc/cdrom_data"),
+		_T("../../src/libromdata/tests/disc/cdrom_data"),
+		_T("../../../src/libromdata/tests/disc/cdrom_data"),
+		_T("../../../../src/libromdata/tests/disc/cdrom_data"),
+		_T("../../../../../src/libromdata/tests/disc/cdrom_data"),
+		_T("../../../bin/cdrom_data"),
+	};
+#endif /* _WIN32 */
+
+	bool is_found = false;
+	for (const TCHAR *const subdir : subdirs) {
+		if (!_taccess(subdir, R_OK)) {
+			if (_tchdir(subdir) == 0) {
+				is_found = true;
+				break;
+			}
+		}
+	}
+
+	if (!is_found) {
+		fputs("*** ERROR: Cannot find the cdrom_data test data directory.\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
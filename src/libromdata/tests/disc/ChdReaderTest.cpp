@@ -0,0 +1,1214 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata/tests)                 *
+ * ChdReaderTest.cpp: ChdReader class test.                                *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "config.libromdata.h"
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// ChdReader
+#include "libromdata/disc/ChdReader.hpp"
+#include "libromdata/disc/chd_structs.h"
+
+// Other rom-properties libraries
+#include "librpbyteswap/byteswap_rp.h"
+#include "librpfile/MemFile.hpp"
+using namespace LibRpFile;
+
+// zlib
+#include <zlib.h>
+
+// zstd
+#ifdef HAVE_ZSTD
+#  include <zstd.h>
+#endif /* HAVE_ZSTD */
+
+// liblzma
+#ifdef HAVE_LZMA
+#  include <lzma.h>
+#endif /* HAVE_LZMA */
+
+// C includes (C++ namespace)
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <memory>
+#include <vector>
+using std::vector;
+
+namespace LibRomData { namespace Tests {
+
+class ChdReaderTest : public ::testing::Test
+{
+	protected:
+		ChdReaderTest() = default;
+
+	public:
+		static void SetUpTestSuite(void);
+		static void TearDownTestSuite(void);
+
+	public:
+		// Synthetic CHD layout:
+		// - One MODE1_RAW track with one frame per hunk.
+		// - Hunk 0: zlib
+		// - Hunk 1: cdzl, with the sync header and ECC data removed
+		// - Hunk 2: Self-reference to hunk 0
+		// - Hunk 3: Uncompressed
+		static constexpr unsigned int HUNK_COUNT = 4;
+		static constexpr unsigned int HUNK_BYTES = CHD_CD_FRAME_SIZE;
+		static constexpr uint32_t META_OFFSET = 0x80;
+
+		// Original frames (2352-byte sector + 96 bytes of subcode data)
+		static vector<uint8_t> frames;
+
+		// Offsets of the uncompressed hunk and the map.
+		static uint32_t rawHunkOffset;
+		static uint32_t mapOffset;
+
+		// CHD image
+		static vector<uint8_t> chd;
+
+		// Synthetic CHD layout for the CD-ROM codecs:
+		// - One MODE1_RAW track with one frame per hunk.
+		// - Hunk 0: cdfl
+		// - Hunk 1: cdlz, with the sync header and ECC data removed
+		// - Hunk 2: cdzs
+		static constexpr unsigned int CD_CODEC_HUNK_COUNT = 3;
+		static vector<uint8_t> cdCodecFrames;
+		static vector<uint8_t> chdCdCodecs;
+
+		// Synthetic CHD layout for the other codecs:
+		// - No metadata, so each hunk is a block.
+		// - Hunk 0: flac (little-endian)
+		// - Hunk 1: flac (big-endian)
+		// - Hunk 2: lzma
+		// - Hunk 3: zstd
+		static constexpr unsigned int CODEC_HUNK_COUNT = 4;
+		static constexpr unsigned int CODEC_HUNK_BYTES = 4096;
+		static vector<uint8_t> codecData;
+		static vector<uint8_t> chdCodecs;
+
+		// Synthetic CHD layout for parallel reads:
+		// - No metadata, so each hunk is a block.
+		// - All hunks are zlib, except:
+		//   - Hunk 5: Parent CHD hunk (not supported: ENOTSUP)
+		//   - Hunk 9: Uncompressed, with a CRC-16 mismatch (EIO)
+		static constexpr unsigned int PARALLEL_HUNK_COUNT = 12;
+		static constexpr unsigned int PARALLEL_HUNK_BYTES = 2048;
+		static constexpr unsigned int PARALLEL_PARENT_HUNK = 5;
+		static constexpr unsigned int PARALLEL_BAD_CRC_HUNK = 9;
+		static vector<uint8_t> parallelData;
+		static vector<uint8_t> chdParallel;
+
+		/**
+		 * Hunk to store in a CHD image.
+		 */
+		struct HunkSpec {
+			uint8_t compression;	// Compression type (see CHD_Compression_e)
+			uint32_t selfHunk;	// CHD_COMPRESSION_SELF: Referenced hunk
+			vector<uint8_t> data;	// Stored data
+		};
+
+		/**
+		 * Compression function.
+		 * @param data Data
+		 * @param size Size of data
+		 * @return Compressed data
+		 */
+		typedef vector<uint8_t> (*CompressFn)(const uint8_t *data, size_t size);
+
+		/**
+		 * Build a CHD image.
+		 * @param compressors	[in] Codecs (see CHD_Codec_e)
+		 * @param hunkData	[in] Original hunk data, for the CRC-16s
+		 * @param hunkBytes	[in] Hunk size
+		 * @param unitBytes	[in] Unit size
+		 * @param hunks		[in] Hunks to store
+		 * @param trackMeta	[in,opt] CD-ROM track metadata
+		 * @param pRawHunkOffset [out,opt] Offset of the last uncompressed hunk
+		 * @param pMapOffset	[out,opt] Offset of the map
+		 * @return CHD image
+		 */
+		static vector<uint8_t> buildChd(const uint32_t compressors[4],
+			const vector<uint8_t> &hunkData, unsigned int hunkBytes, unsigned int unitBytes,
+			const vector<HunkSpec> &hunks, const char *trackMeta,
+			uint32_t *pRawHunkOffset = nullptr, uint32_t *pMapOffset = nullptr);
+
+		/**
+		 * Create Mode 1 frames.
+		 * @param count	[in] Number of frames
+		 * @param seed	[in] Seed for the user data
+		 * @return Frames (2352-byte sector + 96 bytes of subcode data)
+		 */
+		static vector<uint8_t> makeFrames(unsigned int count, unsigned int seed);
+
+		/**
+		 * Build a cdzl/cdlz/cdzs hunk with one frame.
+		 * @param frame		[in] Frame
+		 * @param baseFn	[in] Compression function for the sector data
+		 * @param subFn		[in] Compression function for the subcode data
+		 * @param stripEcc	[in] If true, remove the sync header and ECC data.
+		 * @return Hunk data
+		 */
+		static vector<uint8_t> buildCdHunk(const uint8_t *frame, CompressFn baseFn, CompressFn subFn, bool stripEcc);
+
+		/**
+		 * Open a CHD image.
+		 * @param data CHD image
+		 * @return ChdReader
+		 */
+		static ChdReaderPtr openChd(const vector<uint8_t> &data);
+
+		/**
+		 * Calculate the CRC-16 (CCITT) of a buffer.
+		 * @param buf Buffer
+		 * @param size Size of buf
+		 * @return CRC-16
+		 */
+		static uint16_t crc16(const uint8_t *buf, size_t size);
+
+		/**
+		 * Generate the ECC data of a Mode 1 sector.
+		 * Based on ECM, which uses the ECMA-130 row layout directly
+		 * instead of MAME's precalculated offset tables.
+		 * @param sector 2352-byte sector
+		 */
+		static void eccGenerate(uint8_t *sector);
+
+		/**
+		 * Compress data using raw deflate.
+		 * @param data Data
+		 * @param size Size of data
+		 * @return Compressed data
+		 */
+		static vector<uint8_t> deflateRaw(const uint8_t *data, size_t size);
+
+#ifdef HAVE_LZMA
+		/**
+		 * Compress data using raw LZMA1.
+		 * @param data Data
+		 * @param size Size of data
+		 * @return Compressed data
+		 */
+		static vector<uint8_t> lzmaRaw(const uint8_t *data, size_t size);
+#endif /* HAVE_LZMA */
+
+#ifdef HAVE_ZSTD
+		/**
+		 * Compress data using zstd.
+		 * @param data Data
+		 * @param size Size of data
+		 * @return Compressed data
+		 */
+		static vector<uint8_t> zstdCompress(const uint8_t *data, size_t size);
+#endif /* HAVE_ZSTD */
+
+		/**
+		 * Encode 16-bit stereo samples as FLAC frames.
+		 * @param pcm		[in] Interleaved 16-bit samples
+		 * @param samples	[in] Number of samples per channel
+		 * @param bigEndian	[in] If true, samples are big-endian; otherwise, little-endian.
+		 * @return FLAC frames
+		 */
+		static vector<uint8_t> flacEncode(const uint8_t *pcm, unsigned int samples, bool bigEndian);
+};
+
+vector<uint8_t> ChdReaderTest::frames;
+uint32_t ChdReaderTest::rawHunkOffset;
+uint32_t ChdReaderTest::mapOffset;
+vector<uint8_t> ChdReaderTest::chd;
+vector<uint8_t> ChdReaderTest::cdCodecFrames;
+vector<uint8_t> ChdReaderTest::chdCdCodecs;
+vector<uint8_t> ChdReaderTest::codecData;
+vector<uint8_t> ChdReaderTest::chdCodecs;
+vector<uint8_t> ChdReaderTest::parallelData;
+vector<uint8_t> ChdReaderTest::chdParallel;
+
+/**
+ * MSB-first bit writer for the compressed hunk map and FLAC frames.
+ */
+class BitWriter
+{
+	public:
+		void write(uint32_t value, unsigned int n)
+		{
+			for (; n > 0; n--) {
+				if ((m_bits % 8) == 0) {
+					data.push_back(0);
+				}
+				if (value & (1U << (n - 1))) {
+					data.back() |= (0x80 >> (m_bits % 8));
+				}
+				m_bits++;
+			}
+		}
+
+		void writeSigned(int32_t value, unsigned int n)
+		{
+			write(static_cast<uint32_t>(value) & ((n < 32) ? ((1U << n) - 1) : ~0U), n);
+		}
+
+		void writeUnary(uint32_t value)
+		{
+			for (; value > 0; value--) {
+				write(0, 1);
+			}
+			write(1, 1);
+		}
+
+		void alignByte(void)
+		{
+			m_bits = (m_bits + 7) & ~7U;
+		}
+
+	public:
+		vector<uint8_t> data;
+	private:
+		unsigned int m_bits = 0;
+};
+
+/**
+ * Calculate the CRC-16 (CCITT) of a buffer.
+ * @param buf Buffer
+ * @param size Size of buf
+ * @return CRC-16
+ */
+uint16_t ChdReaderTest::crc16(const uint8_t *buf, size_t size)
+{
+	uint16_t crc = 0xFFFF;
+	for (; size > 0; size--, buf++) {
+		crc ^= static_cast<uint16_t>(*buf << 8);
+		for (unsigned int i = 0; i < 8; i++) {
+			crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+		}
+	}
+	return crc;
+}
+
+/**
+ * Generate the ECC data of a Mode 1 sector.
+ * Based on ECM, which uses the ECMA-130 row layout directly
+ * instead of MAME's precalculated offset tables.
+ * @param sector 2352-byte sector
+ */
+void ChdReaderTest::eccGenerate(uint8_t *sector)
+{
+	uint8_t f_lut[256], b_lut[256];
+	for (unsigned int i = 0; i < 256; i++) {
+		const unsigned int j = (i << 1) ^ ((i & 0x80) ? 0x11D : 0);
+		f_lut[i] = static_cast<uint8_t>(j);
+		b_lut[i ^ j] = static_cast<uint8_t>(i);
+	}
+
+	auto computeBlock = [&](unsigned int major_count, unsigned int minor_count,
+		unsigned int major_mult, unsigned int minor_inc, uint8_t *dest)
+	{
+		const uint8_t *const src = &sector[0x00C];
+		const unsigned int size = major_count * minor_count;
+		for (unsigned int major = 0; major < major_count; major++) {
+			unsigned int index = (major >> 1) * major_mult + (major & 1);
+			uint8_t ecc_a = 0, ecc_b = 0;
+			for (unsigned int minor = 0; minor < minor_count; minor++) {
+				const uint8_t temp = src[index];
+				index += minor_inc;
+				if (index >= size) {
+					index -= size;
+				}
+				ecc_a ^= temp;
+				ecc_b ^= temp;
+				ecc_a = f_lut[ecc_a];
+			}
+			ecc_a = b_lut[f_lut[ecc_a] ^ ecc_b];
+			dest[major] = ecc_a;
+			dest[major + major_count] = ecc_a ^ ecc_b;
+		}
+	};
+
+	computeBlock(86, 24, 2, 86, &sector[0x81C]);	// P
+	computeBlock(52, 43, 86, 88, &sector[0x8C8]);	// Q
+}
+
+/**
+ * Compress data using raw deflate.
+ * @param data Data
+ * @param size Size of data
+ * @return Compressed data
+ */
+vector<uint8_t> ChdReaderTest::deflateRaw(const uint8_t *data, size_t size)
+{
+	z_stream strm = { };
+	EXPECT_EQ(Z_OK, deflateInit2(&strm, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY));
+	vector<uint8_t> out(deflateBound(&strm, static_cast<uLong>(size)));
+	strm.next_in = const_cast<Bytef*>(data);
+	strm.avail_in = static_cast<uInt>(size);
+	strm.next_out = out.data();
+	strm.avail_out = static_cast<uInt>(out.size());
+	EXPECT_EQ(Z_STREAM_END, deflate(&strm, Z_FINISH));
+	out.resize(strm.total_out);
+	deflateEnd(&strm);
+	return out;
+}
+
+#ifdef HAVE_LZMA
+/**
+ * Compress data using raw LZMA1.
+ * @param data Data
+ * @param size Size of data
+ * @return Compressed data
+ */
+vector<uint8_t> ChdReaderTest::lzmaRaw(const uint8_t *data, size_t size)
+{
+	// NOTE: The dictionary must not be larger than the decoder's,
+	// which is based on the decompressed size.
+	lzma_options_lzma opt;
+	EXPECT_FALSE(lzma_lzma_preset(&opt, 9));
+	opt.dict_size = LZMA_DICT_SIZE_MIN;
+	const lzma_filter filters[2] = {
+		{LZMA_FILTER_LZMA1, &opt},
+		{LZMA_VLI_UNKNOWN, nullptr},
+	};
+	vector<uint8_t> out(size + 1024);
+	size_t out_pos = 0;
+	EXPECT_EQ(LZMA_OK, lzma_raw_buffer_encode(filters, nullptr, data, size, out.data(), &out_pos, out.size()));
+	out.resize(out_pos);
+	return out;
+}
+#endif /* HAVE_LZMA */
+
+#ifdef HAVE_ZSTD
+/**
+ * Compress data using zstd.
+ * @param data Data
+ * @param size Size of data
+ * @return Compressed data
+ */
+vector<uint8_t> ChdReaderTest::zstdCompress(const uint8_t *data, size_t size)
+{
+	vector<uint8_t> out(ZSTD_compressBound(size));
+	const size_t ret = ZSTD_compress(out.data(), out.size(), data, size, 19);
+	EXPECT_FALSE(ZSTD_isError(ret));
+	out.resize(ZSTD_isError(ret) ? 0 : ret);
+	return out;
+}
+#endif /* HAVE_ZSTD */
+
+/**
+ * Encode a FLAC residual.
+ * Each partition uses the smallest Rice parameter,
+ * or an escape code if that's smaller.
+ * @param bw		[in] BitWriter
+ * @param residual	[in] Residual (not including the warmup samples)
+ * @param blockSize	[in] Block size
+ * @param order		[in] Predictor order
+ */
+static void flacEncodeResidual(BitWriter &bw, const int32_t *residual, unsigned int blockSize, unsigned int order)
+{
+	// Use the highest partition order that fits.
+	unsigned int partOrder = 3;
+	while (partOrder > 0 && ((blockSize % (1U << partOrder)) != 0 || (blockSize >> partOrder) < order)) {
+		partOrder--;
+	}
+	const unsigned int partSamples = blockSize >> partOrder;
+
+	bw.write(0, 2);	// Rice coding, 4-bit parameters
+	bw.write(partOrder, 4);
+	for (unsigned int p = 0; p < (1U << partOrder); p++) {
+		const unsigned int n = (p == 0) ? (partSamples - order) : partSamples;
+
+		// Determine the best Rice parameter, and the escape size.
+		uint64_t bestBits = ~0ULL;
+		unsigned int bestParam = 0;
+		for (unsigned int k = 0; k < 15; k++) {
+			uint64_t bits = 0;
+			for (unsigned int i = 0; i < n; i++) {
+				const uint32_t u = (static_cast<uint32_t>(residual[i]) << 1) ^ static_cast<uint32_t>(residual[i] >> 31);
+				bits += (u >> k) + 1 + k;
+			}
+			if (bits < bestBits) {
+				bestBits = bits;
+				bestParam = k;
+			}
+		}
+		unsigned int rawBits = 0;
+		for (unsigned int i = 0; i < n; i++) {
+			while (rawBits < 31 && (residual[i] < -(1 << (rawBits - (rawBits > 0 ? 1 : 0))) ||
+			       residual[i] >= (rawBits > 0 ? (1 << (rawBits - 1)) : 1)))
+			{
+				rawBits++;
+			}
+		}
+
+		if (static_cast<uint64_t>(rawBits) * n + 5 < bestBits) {
+			// Escape code: Unencoded binary.
+			bw.write(15, 4);
+			bw.write(rawBits, 5);
+			for (unsigned int i = 0; i < n; i++) {
+				bw.writeSigned(residual[i], rawBits);
+			}
+		} else {
+			bw.write(bestParam, 4);
+			for (unsigned int i = 0; i < n; i++) {
+				const uint32_t u = (static_cast<uint32_t>(residual[i]) << 1) ^ static_cast<uint32_t>(residual[i] >> 31);
+				bw.writeUnary(u >> bestParam);
+				bw.write(u & ((1U << bestParam) - 1), bestParam);
+			}
+		}
+		residual += n;
+	}
+}
+
+/**
+ * Encode a FLAC subframe.
+ * @param bw		[in] BitWriter
+ * @param x		[in] Samples
+ * @param blockSize	[in] Block size
+ * @param bps		[in] Bits per sample
+ * @param type		[in] Subframe type: 1 == VERBATIM; 8-12 == FIXED; 32+ == LPC (order 1 or 2)
+ */
+static void flacEncodeSubframe(BitWriter &bw, const int32_t *x, unsigned int blockSize, unsigned int bps, unsigned int type)
+{
+	bool isConstant = true;
+	for (unsigned int i = 1; i < blockSize; i++) {
+		if (x[i] != x[0]) {
+			isConstant = false;
+			break;
+		}
+	}
+	if (isConstant) {
+		// CONSTANT
+		bw.write(0, 1);
+		bw.write(0, 6);
+		bw.write(0, 1);
+		bw.writeSigned(x[0], bps);
+		return;
+	}
+
+	bw.write(0, 1);
+	bw.write(type, 6);
+	bw.write(0, 1);	// no wasted bits
+
+	if (type == 1) {
+		// VERBATIM
+		for (unsigned int i = 0; i < blockSize; i++) {
+			bw.writeSigned(x[i], bps);
+		}
+		return;
+	}
+
+	vector<int32_t> residual;
+	if (type < 32) {
+		// FIXED
+		const unsigned int order = type - 8;
+		for (unsigned int i = 0; i < order; i++) {
+			bw.writeSigned(x[i], bps);
+		}
+		for (unsigned int i = order; i < blockSize; i++) {
+			int32_t pred;
+			switch (order) {
+				default:
+				case 0:	pred = 0; break;
+				case 1:	pred = x[i-1]; break;
+				case 2:	pred = 2*x[i-1] - x[i-2]; break;
+				case 3:	pred = 3*x[i-1] - 3*x[i-2] + x[i-3]; break;
+				case 4:	pred = 4*x[i-1] - 6*x[i-2] + 4*x[i-3] - x[i-4]; break;
+			}
+			residual.push_back(x[i] - pred);
+		}
+		flacEncodeResidual(bw, residual.data(), blockSize, order);
+		return;
+	}
+
+	// LPC: Order 1 uses x[i-1]; order 2 uses 2*x[i-1] - x[i-2].
+	// The coefficients are scaled by 2 with a shift of 1.
+	const unsigned int order = (type & 31) + 1;
+	static const int32_t coefs[2][2] = {{2, 0}, {4, -2}};
+	static constexpr unsigned int precision = 4;
+	static constexpr int shift = 1;
+	for (unsigned int i = 0; i < order; i++) {
+		bw.writeSigned(x[i], bps);
+	}
+	bw.write(precision - 1, 4);
+	bw.writeSigned(shift, 5);
+	for (unsigned int i = 0; i < order; i++) {
+		bw.writeSigned(coefs[order - 1][i], precision);
+	}
+	for (unsigned int i = order; i < blockSize; i++) {
+		int64_t sum = 0;
+		for (unsigned int j = 0; j < order; j++) {
+			sum += static_cast<int64_t>(coefs[order - 1][j]) * x[i-1-j];
+		}
+		residual.push_back(x[i] - static_cast<int32_t>(sum >> shift));
+	}
+	flacEncodeResidual(bw, residual.data(), blockSize, order);
+}
+
+/**
+ * Encode 16-bit stereo samples as FLAC frames.
+ * Each frame uses a different channel assignment and different
+ * subframe types, so all of the decoder's code paths are used.
+ * @param pcm		[in] Interleaved 16-bit samples
+ * @param samples	[in] Number of samples per channel
+ * @param bigEndian	[in] If true, samples are big-endian; otherwise, little-endian.
+ * @return FLAC frames
+ */
+vector<uint8_t> ChdReaderTest::flacEncode(const uint8_t *pcm, unsigned int samples, bool bigEndian)
+{
+	static constexpr unsigned int BLOCK_SIZE = 256;
+	static const struct {
+		uint8_t chAssign;	// Channel assignment
+		uint8_t type0;		// Subframe type for channel 0
+		uint8_t type1;		// Subframe type for channel 1
+	} strategies[] = {
+		{ 1,  8 + 2, 32 + 1},	// Left/right: FIXED order 2, LPC order 2
+		{ 8,  8 + 1,  1},	// Left/side: FIXED order 1, VERBATIM
+		{ 9,  8 + 3,  8 + 4},	// Side/right: FIXED order 3, FIXED order 4
+		{10, 32 + 0,  8 + 0},	// Mid/side: LPC order 1, FIXED order 0
+	};
+
+	BitWriter bw;
+	vector<int32_t> ch0(BLOCK_SIZE), ch1(BLOCK_SIZE);
+	for (unsigned int frame = 0, pos = 0; pos < samples; frame++) {
+		const unsigned int blockSize = std::min(BLOCK_SIZE, samples - pos);
+		const auto &strategy = strategies[frame % ARRAY_SIZE(strategies)];
+		for (unsigned int i = 0; i < blockSize; i++) {
+			const uint8_t *const p = &pcm[(pos + i) * 4];
+			const int32_t l = (bigEndian)
+				? static_cast<int16_t>((p[0] << 8) | p[1])
+				: static_cast<int16_t>((p[1] << 8) | p[0]);
+			const int32_t r = (bigEndian)
+				? static_cast<int16_t>((p[2] << 8) | p[3])
+				: static_cast<int16_t>((p[3] << 8) | p[2]);
+			switch (strategy.chAssign) {
+				default:
+				case 1:
+					ch0[i] = l;
+					ch1[i] = r;
+					break;
+				case 8:
+					ch0[i] = l;
+					ch1[i] = l - r;
+					break;
+				case 9:
+					ch0[i] = l - r;
+					ch1[i] = r;
+					break;
+				case 10:
+					ch0[i] = (l + r) >> 1;
+					ch1[i] = l - r;
+					break;
+			}
+		}
+
+		// Frame header
+		bw.write(0x3FFE, 14);
+		bw.write(0, 1);
+		bw.write(0, 1);			// fixed block size
+		bw.write(7, 4);			// block size: 16-bit value at the end of the header
+		bw.write(0, 4);			// sample rate: from STREAMINFO
+		bw.write(strategy.chAssign, 4);
+		bw.write(4, 3);			// 16-bit samples
+		bw.write(0, 1);
+		bw.write(frame & 0x7F, 8);	// frame number
+		bw.write(blockSize - 1, 16);
+		bw.write(0, 8);			// CRC-8 (not checked)
+
+		// Subframes
+		// The side channel has one extra bit.
+		const unsigned int bps0 = (strategy.chAssign == 9) ? 17 : 16;
+		const unsigned int bps1 = (strategy.chAssign == 8 || strategy.chAssign == 10) ? 17 : 16;
+		flacEncodeSubframe(bw, ch0.data(), blockSize, bps0, strategy.type0);
+		flacEncodeSubframe(bw, ch1.data(), blockSize, bps1, strategy.type1);
+
+		// Frame footer
+		bw.alignByte();
+		bw.write(0, 16);		// CRC-16 (not checked)
+		pos += blockSize;
+	}
+	return bw.data;
+}
+
+/**
+ * Build a CHD image.
+ * @param compressors	[in] Codecs (see CHD_Codec_e)
+ * @param hunkData	[in] Original hunk data, for the CRC-16s
+ * @param hunkBytes	[in] Hunk size
+ * @param unitBytes	[in] Unit size
+ * @param hunks		[in] Hunks to store
+ * @param trackMeta	[in,opt] CD-ROM track metadata
+ * @param pRawHunkOffset [out,opt] Offset of the last uncompressed hunk
+ * @param pMapOffset	[out,opt] Offset of the map
+ * @return CHD image
+ */
+vector<uint8_t> ChdReaderTest::buildChd(const uint32_t compressors[4],
+	const vector<uint8_t> &hunkData, unsigned int hunkBytes, unsigned int unitBytes,
+	const vector<HunkSpec> &hunks, const char *trackMeta,
+	uint32_t *pRawHunkOffset, uint32_t *pMapOffset)
+{
+	vector<uint8_t> out(META_OFFSET, 0);
+
+	// Metadata
+	if (trackMeta) {
+		const uint32_t len = static_cast<uint32_t>(strlen(trackMeta) + 1);
+		ChdMetadataHeader metaHeader;
+		metaHeader.tag = cpu_to_be32(CHD_META_CDROM_TRACK);
+		metaHeader.flags_length = cpu_to_be32(len);
+		metaHeader.next = 0;
+		out.insert(out.end(), reinterpret_cast<const uint8_t*>(&metaHeader),
+			reinterpret_cast<const uint8_t*>(&metaHeader) + sizeof(metaHeader));
+		out.insert(out.end(), trackMeta, trackMeta + len);
+	}
+
+	// Hunk data
+	const uint32_t dataStart = static_cast<uint32_t>(out.size());
+	vector<uint64_t> hunkOffsets;
+	for (const HunkSpec &hunk : hunks) {
+		hunkOffsets.push_back(out.size());
+		if (hunk.compression == CHD_COMPRESSION_NONE && pRawHunkOffset) {
+			*pRawHunkOffset = static_cast<uint32_t>(out.size());
+		}
+		out.insert(out.end(), hunk.data.begin(), hunk.data.end());
+	}
+	const uint32_t mapOffset = static_cast<uint32_t>(out.size());
+	if (pMapOffset) {
+		*pMapOffset = mapOffset;
+	}
+
+	// Compressed map
+	// All 16 Huffman codes are 4 bits, so each code is written as-is.
+	static constexpr unsigned int LENGTH_BITS = 16;
+	static constexpr unsigned int SELF_BITS = 8;
+	BitWriter bw;
+	for (unsigned int i = 0; i < 16; i++) {
+		bw.write(4, 4);
+	}
+	for (const HunkSpec &hunk : hunks) {
+		bw.write(hunk.compression, 4);
+	}
+
+	// Map entries, and the CRC-16 of MAME's 12-byte raw map entries.
+	vector<uint8_t> rawMap;
+	for (size_t i = 0; i < hunks.size(); i++) {
+		const HunkSpec &hunk = hunks[i];
+		const uint16_t hunkCrc = crc16(&hunkData[i * hunkBytes], hunkBytes);
+		const uint32_t length = static_cast<uint32_t>(hunk.data.size());
+		uint64_t offset = hunkOffsets[i];
+		switch (hunk.compression) {
+			case CHD_COMPRESSION_TYPE_0:
+			case CHD_COMPRESSION_TYPE_1:
+			case CHD_COMPRESSION_TYPE_2:
+			case CHD_COMPRESSION_TYPE_3:
+				bw.write(length, LENGTH_BITS);
+				bw.write(hunkCrc, 16);
+				break;
+			case CHD_COMPRESSION_NONE:
+				bw.write(hunkCrc, 16);
+				break;
+			case CHD_COMPRESSION_SELF:
+				offset = hunk.selfHunk;
+				bw.write(static_cast<uint32_t>(offset), SELF_BITS);
+				break;
+			case CHD_COMPRESSION_PARENT_SELF:
+				// Same hunk in the parent CHD. No fields are stored.
+				offset = static_cast<uint64_t>(i) * (hunkBytes / unitBytes);
+				break;
+			default:
+				break;
+		}
+
+		// NOTE: MAME's raw map entries store PARENT_SELF as PARENT.
+		const bool isParent = (hunk.compression == CHD_COMPRESSION_PARENT_SELF);
+		const uint16_t entryCrc = (hunk.compression == CHD_COMPRESSION_SELF || isParent) ? 0 : hunkCrc;
+		const uint8_t rawEntry[12] = {
+			(isParent ? static_cast<uint8_t>(CHD_COMPRESSION_PARENT) : hunk.compression),
+			static_cast<uint8_t>(length >> 16), static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length),
+			static_cast<uint8_t>(offset >> 40), static_cast<uint8_t>(offset >> 32), static_cast<uint8_t>(offset >> 24),
+			static_cast<uint8_t>(offset >> 16), static_cast<uint8_t>(offset >> 8), static_cast<uint8_t>(offset),
+			static_cast<uint8_t>(entryCrc >> 8), static_cast<uint8_t>(entryCrc),
+		};
+		rawMap.insert(rawMap.end(), rawEntry, rawEntry + sizeof(rawEntry));
+	}
+
+	ChdMapHeaderV5 mapHeader;
+	memset(&mapHeader, 0, sizeof(mapHeader));
+	mapHeader.length = cpu_to_be32(static_cast<uint32_t>(bw.data.size()));
+	mapHeader.data_start[2] = static_cast<uint8_t>(dataStart >> 24);
+	mapHeader.data_start[3] = static_cast<uint8_t>(dataStart >> 16);
+	mapHeader.data_start[4] = static_cast<uint8_t>(dataStart >> 8);
+	mapHeader.data_start[5] = static_cast<uint8_t>(dataStart);
+	mapHeader.crc16 = cpu_to_be16(crc16(rawMap.data(), rawMap.size()));
+	mapHeader.length_bits = LENGTH_BITS;
+	mapHeader.self_bits = SELF_BITS;
+	out.insert(out.end(), reinterpret_cast<const uint8_t*>(&mapHeader),
+		reinterpret_cast<const uint8_t*>(&mapHeader) + sizeof(mapHeader));
+	out.insert(out.end(), bw.data.begin(), bw.data.end());
+
+	// CHD header
+	ChdHeaderV5 *const chdHeader = reinterpret_cast<ChdHeaderV5*>(out.data());
+	memcpy(chdHeader->magic, CHD_MAGIC, sizeof(chdHeader->magic));
+	chdHeader->length = cpu_to_be32(CHD_V5_HEADER_SIZE);
+	chdHeader->version = cpu_to_be32(5);
+	for (unsigned int i = 0; i < 4; i++) {
+		chdHeader->compressors[i] = cpu_to_be32(compressors[i]);
+	}
+	chdHeader->logical_bytes = cpu_to_be64(static_cast<uint64_t>(hunks.size()) * hunkBytes);
+	chdHeader->map_offset = cpu_to_be64(mapOffset);
+	chdHeader->meta_offset = cpu_to_be64(trackMeta ? META_OFFSET : 0);
+	chdHeader->hunk_bytes = cpu_to_be32(hunkBytes);
+	chdHeader->unit_bytes = cpu_to_be32(unitBytes);
+	return out;
+}
+
+/**
+ * Create Mode 1 frames.
+ * @param count	[in] Number of frames
+ * @param seed	[in] Seed for the user data
+ * @return Frames (2352-byte sector + 96 bytes of subcode data)
+ */
+vector<uint8_t> ChdReaderTest::makeFrames(unsigned int count, unsigned int seed)
+{
+	static const uint8_t sync_header[12] = {0x00,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x00};
+	vector<uint8_t> out(count * CHD_CD_FRAME_SIZE, 0);
+	for (unsigned int lba = 0; lba < count; lba++) {
+		uint8_t *const frame = &out[lba * CHD_CD_FRAME_SIZE];
+		memcpy(frame, sync_header, sizeof(sync_header));
+		frame[12] = 0x00;		// M (BCD)
+		frame[13] = 0x02;		// S (BCD)
+		frame[14] = static_cast<uint8_t>(lba);	// F (BCD)
+		frame[15] = 1;			// Mode 1
+		for (unsigned int i = 0; i < 2048; i++) {
+			// User data: Compressible, but different for each LBA.
+			frame[16 + i] = static_cast<uint8_t>((i / 16) * (lba + seed + 1) + lba);
+		}
+		// NOTE: The EDC isn't checked, so it's left as zero.
+		eccGenerate(frame);
+		memset(&frame[CHD_CD_MAX_SECTOR_DATA], static_cast<uint8_t>(0xA0 + lba + seed), CHD_CD_MAX_SUBCODE_DATA);
+	}
+	return out;
+}
+
+/**
+ * Build a cdzl/cdlz/cdzs hunk with one frame.
+ * @param frame		[in] Frame
+ * @param baseFn	[in] Compression function for the sector data
+ * @param subFn		[in] Compression function for the subcode data
+ * @param stripEcc	[in] If true, remove the sync header and ECC data.
+ * @return Hunk data
+ */
+vector<uint8_t> ChdReaderTest::buildCdHunk(const uint8_t *frame, CompressFn baseFn, CompressFn subFn, bool stripEcc)
+{
+	uint8_t sector[CHD_CD_MAX_SECTOR_DATA];
+	memcpy(sector, frame, sizeof(sector));
+	if (stripEcc) {
+		memset(sector, 0, 12);
+		memset(&sector[0x81C], 0, 0x930 - 0x81C);
+	}
+	const vector<uint8_t> base = baseFn(sector, sizeof(sector));
+	const vector<uint8_t> sub = subFn(&frame[CHD_CD_MAX_SECTOR_DATA], CHD_CD_MAX_SUBCODE_DATA);
+
+	vector<uint8_t> hunk;
+	hunk.push_back(stripEcc ? 0x01 : 0x00);	// ECC bitmap
+	hunk.push_back(static_cast<uint8_t>(base.size() >> 8));
+	hunk.push_back(static_cast<uint8_t>(base.size()));
+	hunk.insert(hunk.end(), base.begin(), base.end());
+	hunk.insert(hunk.end(), sub.begin(), sub.end());
+	return hunk;
+}
+
+/**
+ * Create the synthetic CHD images.
+ */
+void ChdReaderTest::SetUpTestSuite(void)
+{
+	// Mode 1 frames
+	frames = makeFrames(HUNK_COUNT, 0);
+	// Hunk 2 is a self-reference to hunk 0.
+	memcpy(&frames[2 * CHD_CD_FRAME_SIZE], &frames[0], CHD_CD_FRAME_SIZE);
+
+	static const char track_meta[] = "TRACK:1 TYPE:MODE1_RAW SUBTYPE:NONE FRAMES:4";
+	{
+		vector<HunkSpec> hunks(HUNK_COUNT);
+		hunks[0].compression = CHD_COMPRESSION_TYPE_0;	// zlib
+		hunks[0].data = deflateRaw(&frames[0], CHD_CD_FRAME_SIZE);
+		hunks[1].compression = CHD_COMPRESSION_TYPE_1;	// cdzl
+		hunks[1].data = buildCdHunk(&frames[1 * CHD_CD_FRAME_SIZE], deflateRaw, deflateRaw, true);
+		hunks[2].compression = CHD_COMPRESSION_SELF;
+		hunks[2].selfHunk = 0;
+		hunks[3].compression = CHD_COMPRESSION_NONE;
+		hunks[3].data.assign(frames.begin() + (3 * CHD_CD_FRAME_SIZE), frames.end());
+		ASSERT_LT(hunks[0].data.size(), HUNK_BYTES);
+		ASSERT_LT(hunks[1].data.size(), HUNK_BYTES);
+
+		static const uint32_t compressors[4] = {CHD_CODEC_ZLIB, CHD_CODEC_CD_ZLIB, CHD_CODEC_NONE, CHD_CODEC_NONE};
+		chd = buildChd(compressors, frames, HUNK_BYTES, CHD_CD_FRAME_SIZE, hunks, track_meta, &rawHunkOffset, &mapOffset);
+	}
+
+	// CD-ROM codecs
+	// NOTE: If lzma or zstd isn't available, the hunk is stored uncompressed.
+	cdCodecFrames = makeFrames(CD_CODEC_HUNK_COUNT, 5);
+	{
+		static const char cd_track_meta[] = "TRACK:1 TYPE:MODE1_RAW SUBTYPE:NONE FRAMES:3";
+		vector<HunkSpec> hunks(CD_CODEC_HUNK_COUNT);
+
+		// cdfl: Sector data is stored as big-endian 16-bit stereo samples.
+		const uint8_t *const frame0 = &cdCodecFrames[0];
+		hunks[0].compression = CHD_COMPRESSION_TYPE_0;
+		hunks[0].data = flacEncode(frame0, CHD_CD_MAX_SECTOR_DATA / 4, true);
+		const vector<uint8_t> sub = deflateRaw(&frame0[CHD_CD_MAX_SECTOR_DATA], CHD_CD_MAX_SUBCODE_DATA);
+		hunks[0].data.insert(hunks[0].data.end(), sub.begin(), sub.end());
+
+#ifdef HAVE_LZMA
+		hunks[1].compression = CHD_COMPRESSION_TYPE_1;
+		hunks[1].data = buildCdHunk(&cdCodecFrames[1 * CHD_CD_FRAME_SIZE], lzmaRaw, deflateRaw, true);
+#else /* !HAVE_LZMA */
+		hunks[1].compression = CHD_COMPRESSION_NONE;
+		hunks[1].data.assign(&cdCodecFrames[1 * CHD_CD_FRAME_SIZE], &cdCodecFrames[2 * CHD_CD_FRAME_SIZE]);
+#endif /* HAVE_LZMA */
+#ifdef HAVE_ZSTD
+		hunks[2].compression = CHD_COMPRESSION_TYPE_2;
+		hunks[2].data = buildCdHunk(&cdCodecFrames[2 * CHD_CD_FRAME_SIZE], zstdCompress, zstdCompress, false);
+#else /* !HAVE_ZSTD */
+		hunks[2].compression = CHD_COMPRESSION_NONE;
+		hunks[2].data.assign(&cdCodecFrames[2 * CHD_CD_FRAME_SIZE], &cdCodecFrames[3 * CHD_CD_FRAME_SIZE]);
+#endif /* HAVE_ZSTD */
+		for (const HunkSpec &hunk : hunks) {
+			ASSERT_LE(hunk.data.size(), HUNK_BYTES);
+		}
+
+		static const uint32_t compressors[4] = {CHD_CODEC_CD_FLAC, CHD_CODEC_CD_LZMA, CHD_CODEC_CD_ZSTD, CHD_CODEC_NONE};
+		chdCdCodecs = buildChd(compressors, cdCodecFrames, HUNK_BYTES, CHD_CD_FRAME_SIZE, hunks, cd_track_meta);
+	}
+
+	// Other codecs
+	// Hunks 0 and 1 are audio-like, so the FLAC predictors work,
+	// and part of hunk 0 is silent, so CONSTANT subframes are used.
+	codecData.resize(CODEC_HUNK_COUNT * CODEC_HUNK_BYTES);
+	for (unsigned int i = 0; i < 2 * CODEC_HUNK_BYTES / 4; i++) {
+		uint8_t *const p = &codecData[i * 4];
+		int16_t l = 0, r = 0;
+		if (i < 256 || i >= 512) {
+			const int tri = static_cast<int>(i % 200);
+			l = static_cast<int16_t>((tri < 100 ? tri : 200 - tri) * 300 - 15000 + ((i * 7) % 5));
+			r = static_cast<int16_t>(l / 2 + static_cast<int>((i * 13) % 64) - 32);
+		}
+		if (i < CODEC_HUNK_BYTES / 4) {
+			// Hunk 0: Little-endian
+			p[0] = static_cast<uint8_t>(l);
+			p[1] = static_cast<uint8_t>(l >> 8);
+			p[2] = static_cast<uint8_t>(r);
+			p[3] = static_cast<uint8_t>(r >> 8);
+		} else {
+			// Hunk 1: Big-endian
+			p[0] = static_cast<uint8_t>(l >> 8);
+			p[1] = static_cast<uint8_t>(l);
+			p[2] = static_cast<uint8_t>(r >> 8);
+			p[3] = static_cast<uint8_t>(r);
+		}
+	}
+	for (unsigned int i = 2 * CODEC_HUNK_BYTES; i < codecData.size(); i++) {
+		codecData[i] = static_cast<uint8_t>((i / 32) ^ (i * 3));
+	}
+	{
+		vector<HunkSpec> hunks(CODEC_HUNK_COUNT);
+		hunks[0].compression = CHD_COMPRESSION_TYPE_0;
+		hunks[0].data.push_back('L');
+		const vector<uint8_t> flacL = flacEncode(&codecData[0], CODEC_HUNK_BYTES / 4, false);
+		hunks[0].data.insert(hunks[0].data.end(), flacL.begin(), flacL.end());
+		hunks[1].compression = CHD_COMPRESSION_TYPE_0;
+		hunks[1].data.push_back('B');
+		const vector<uint8_t> flacB = flacEncode(&codecData[CODEC_HUNK_BYTES], CODEC_HUNK_BYTES / 4, true);
+		hunks[1].data.insert(hunks[1].data.end(), flacB.begin(), flacB.end());
+
+		for (unsigned int i = 2; i < CODEC_HUNK_COUNT; i++) {
+			const uint8_t *const hunkData = &codecData[i * CODEC_HUNK_BYTES];
+			vector<uint8_t> data;
+#ifdef HAVE_LZMA
+			if (i == 2) {
+				hunks[i].compression = CHD_COMPRESSION_TYPE_1;
+				data = lzmaRaw(hunkData, CODEC_HUNK_BYTES);
+			}
+#endif /* HAVE_LZMA */
+#ifdef HAVE_ZSTD
+			if (i == 3) {
+				hunks[i].compression = CHD_COMPRESSION_TYPE_2;
+				data = zstdCompress(hunkData, CODEC_HUNK_BYTES);
+			}
+#endif /* HAVE_ZSTD */
+			if (data.empty()) {
+				hunks[i].compression = CHD_COMPRESSION_NONE;
+				data.assign(hunkData, hunkData + CODEC_HUNK_BYTES);
+			}
+			hunks[i].data = std::move(data);
+		}
+		for (const HunkSpec &hunk : hunks) {
+			ASSERT_LE(hunk.data.size(), CODEC_HUNK_BYTES);
+		}
+
+		static const uint32_t compressors[4] = {CHD_CODEC_FLAC, CHD_CODEC_LZMA, CHD_CODEC_ZSTD, CHD_CODEC_NONE};
+		chdCodecs = buildChd(compressors, codecData, CODEC_HUNK_BYTES, 512, hunks, nullptr);
+	}
+
+	// Parallel reads
+	parallelData.resize(PARALLEL_HUNK_COUNT * PARALLEL_HUNK_BYTES);
+	for (unsigned int i = 0; i < parallelData.size(); i++) {
+		parallelData[i] = static_cast<uint8_t>((i / 64) * 3 + (i / PARALLEL_HUNK_BYTES));
+	}
+	{
+		vector<HunkSpec> hunks(PARALLEL_HUNK_COUNT);
+		for (unsigned int i = 0; i < PARALLEL_HUNK_COUNT; i++) {
+			const uint8_t *const hunkData = &parallelData[i * PARALLEL_HUNK_BYTES];
+			switch (i) {
+				case PARALLEL_PARENT_HUNK:
+					hunks[i].compression = CHD_COMPRESSION_PARENT_SELF;
+					break;
+				case PARALLEL_BAD_CRC_HUNK:
+					hunks[i].compression = CHD_COMPRESSION_NONE;
+					hunks[i].data.assign(hunkData, hunkData + PARALLEL_HUNK_BYTES);
+					hunks[i].data[100] ^= 0xFF;
+					break;
+				default:
+					hunks[i].compression = CHD_COMPRESSION_TYPE_0;
+					hunks[i].data = deflateRaw(hunkData, PARALLEL_HUNK_BYTES);
+					break;
+			}
+		}
+
+		static const uint32_t compressors[4] = {CHD_CODEC_ZLIB, CHD_CODEC_NONE, CHD_CODEC_NONE, CHD_CODEC_NONE};
+		chdParallel = buildChd(compressors, parallelData, PARALLEL_HUNK_BYTES, 512, hunks, nullptr);
+	}
+}
+
+void ChdReaderTest::TearDownTestSuite(void)
+{
+	frames.clear();
+	frames.shrink_to_fit();
+	chd.clear();
+	chd.shrink_to_fit();
+	cdCodecFrames.clear();
+	cdCodecFrames.shrink_to_fit();
+	chdCdCodecs.clear();
+	chdCdCodecs.shrink_to_fit();
+	codecData.clear();
+	codecData.shrink_to_fit();
+	chdCodecs.clear();
+	chdCodecs.shrink_to_fit();
+	parallelData.clear();
+	parallelData.shrink_to_fit();
+	chdParallel.clear();
+	chdParallel.shrink_to_fit();
+}
+
+/**
+ * Open a CHD image.
+ * @param data CHD image
+ * @return ChdReader
+ */
+ChdReaderPtr ChdReaderTest::openChd(const vector<uint8_t> &data)
+{
+	MemFilePtr memFile = std::make_shared<MemFile>(data.data(), data.size());
+	return std::make_shared<ChdReader>(memFile);
+}
+
+/**
+ * Read all four sectors.
+ * Hunk 1's CRC-16 covers the ECC data, so this also checks
+ * that the ECC data is regenerated correctly.
+ */
+TEST_F(ChdReaderTest, readSectors)
+{
+	ChdReaderPtr chdReader = openChd(chd);
+	ASSERT_TRUE(chdReader->isOpen());
+	EXPECT_TRUE(chdReader->isCdrom());
+	EXPECT_FALSE(chdReader->isGdrom());
+	EXPECT_EQ(1, chdReader->trackCount());
+	EXPECT_EQ(0, chdReader->startingLBA(1));
+	ASSERT_EQ(static_cast<off64_t>(HUNK_COUNT) * 2048, static_cast<LibRpBase::IDiscReader*>(chdReader.get())->size());
+
+	vector<uint8_t> buf(HUNK_COUNT * 2048);
+	ASSERT_EQ(buf.size(), chdReader->seekAndRead(0, buf.data(), buf.size()));
+	for (unsigned int lba = 0; lba < HUNK_COUNT; lba++) {
+		EXPECT_EQ(0, memcmp(&frames[lba * CHD_CD_FRAME_SIZE + 16], &buf[lba * 2048], 2048)) << "lba == " << lba;
+	}
+}
+
+/**
+ * Read the ECC-stripped sector by itself.
+ */
+TEST_F(ChdReaderTest, readEccStrippedSector)
+{
+	ChdReaderPtr chdReader = openChd(chd);
+	ASSERT_TRUE(chdReader->isOpen());
+
+	uint8_t buf[512];
+	ASSERT_EQ(sizeof(buf), chdReader->seekAndRead(2048 + 1024, buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(&frames[1 * CHD_CD_FRAME_SIZE + 16 + 1024], buf, sizeof(buf)));
+}
+
+/**
+ * Corrupt the uncompressed hunk.
+ * Reading it should fail due to a CRC-16 mismatch.
+ */
+TEST_F(ChdReaderTest, hunkCrcMismatch)
+{
+	vector<uint8_t> bad = chd;
+	bad[rawHunkOffset + 100] ^= 0xFF;
+	ChdReaderPtr chdReader = openChd(bad);
+	ASSERT_TRUE(chdReader->isOpen());
+
+	// Hunk 0 can still be read.
+	uint8_t buf[2048];
+	ASSERT_EQ(sizeof(buf), chdReader->seekAndRead(0, buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(&frames[16], buf, sizeof(buf)));
+
+	// Hunk 3 can't be read.
+	EXPECT_EQ(0U, chdReader->seekAndRead(3 * 2048, buf, sizeof(buf)));
+	EXPECT_EQ(EIO, chdReader->lastError());
+}
+
+/**
+ * Corrupt the map CRC-16.
+ * The CHD should not be opened.
+ */
+TEST_F(ChdReaderTest, mapCrcMismatch)
+{
+	vector<uint8_t> bad = chd;
+	bad[mapOffset + offsetof(ChdMapHeaderV5, crc16)] ^= 0xFF;
+	ChdReaderPtr chdReader = openChd(bad);
+	EXPECT_FALSE(chdReader->isOpen());
+	EXPECT_EQ(EIO, chdReader->lastError());
+}
+
+/**
+ * Read all sectors from the CD-ROM codec image.
+ * Hunk 0 uses the FLAC decoder for the sector data.
+ */
+TEST_F(ChdReaderTest, readCdCodecSectors)
+{
+	ChdReaderPtr chdReader = openChd(chdCdCodecs);
+	ASSERT_TRUE(chdReader->isOpen());
+	EXPECT_TRUE(chdReader->isCdrom());
+	ASSERT_EQ(static_cast<off64_t>(CD_CODEC_HUNK_COUNT) * 2048, static_cast<LibRpBase::IDiscReader*>(chdReader.get())->size());
+
+	vector<uint8_t> buf(CD_CODEC_HUNK_COUNT * 2048);
+	ASSERT_EQ(buf.size(), chdReader->seekAndRead(0, buf.data(), buf.size()));
+	for (unsigned int lba = 0; lba < CD_CODEC_HUNK_COUNT; lba++) {
+		EXPECT_EQ(0, memcmp(&cdCodecFrames[lba * CHD_CD_FRAME_SIZE + 16], &buf[lba * 2048], 2048)) << "lba == " << lba;
+	}
+}
+
+/**
+ * Read all hunks from the flac/lzma/zstd image.
+ * This image doesn't have CD-ROM metadata, so each hunk is a block.
+ */
+TEST_F(ChdReaderTest, readCodecHunks)
+{
+	ChdReaderPtr chdReader = openChd(chdCodecs);
+	ASSERT_TRUE(chdReader->isOpen());
+	EXPECT_FALSE(chdReader->isCdrom());
+	ASSERT_EQ(static_cast<off64_t>(codecData.size()), static_cast<LibRpBase::IDiscReader*>(chdReader.get())->size());
+
+	vector<uint8_t> buf(codecData.size());
+	ASSERT_EQ(buf.size(), chdReader->seekAndRead(0, buf.data(), buf.size()));
+	for (unsigned int hunk = 0; hunk < CODEC_HUNK_COUNT; hunk++) {
+		EXPECT_EQ(0, memcmp(&codecData[hunk * CODEC_HUNK_BYTES], &buf[hunk * CODEC_HUNK_BYTES], CODEC_HUNK_BYTES)) << "hunk == " << hunk;
+	}
+
+	// Partial read across the FLAC hunks.
+	uint8_t pbuf[1000];
+	ASSERT_EQ(sizeof(pbuf), chdReader->seekAndRead(CODEC_HUNK_BYTES - 500, pbuf, sizeof(pbuf)));
+	EXPECT_EQ(0, memcmp(&codecData[CODEC_HUNK_BYTES - 500], pbuf, sizeof(pbuf)));
+}
+
+/**
+ * Read multiple full hunks, some of which are cached.
+ * If OpenMP is enabled, uncached hunks are decompressed in parallel.
+ */
+TEST_F(ChdReaderTest, parallelReadMixedCache)
+{
+	ChdReaderPtr chdReader = openChd(chdParallel);
+	ASSERT_TRUE(chdReader->isOpen());
+	EXPECT_FALSE(chdReader->isCdrom());
+	LibRpBase::SparseDiscReader *const sparseReader = chdReader.get();
+
+	// Cache hunks 1 and 3 using partial reads.
+	uint8_t pbuf[16];
+	ASSERT_EQ(sizeof(pbuf), chdReader->seekAndRead(1 * PARALLEL_HUNK_BYTES + 32, pbuf, sizeof(pbuf)));
+	ASSERT_EQ(sizeof(pbuf), chdReader->seekAndRead(3 * PARALLEL_HUNK_BYTES + 32, pbuf, sizeof(pbuf)));
+	sparseReader->resetCacheStats();
+
+	// Hunks 1 and 3 are copied from the cache; hunks 0, 2, and 4 are decompressed.
+	vector<uint8_t> buf(5 * PARALLEL_HUNK_BYTES);
+	ASSERT_EQ(buf.size(), chdReader->seekAndRead(0, buf.data(), buf.size()));
+	EXPECT_EQ(0, memcmp(parallelData.data(), buf.data(), buf.size()));
+
+	const LibRpBase::SparseDiscReader::CacheStats stats = sparseReader->cacheStats();
+	EXPECT_EQ(2U, stats.hits);
+	EXPECT_EQ(0U, stats.misses);
+	EXPECT_EQ(3U, stats.bypass);
+
+	// Cached hunks at both ends of the run.
+	ASSERT_EQ(sizeof(pbuf), chdReader->seekAndRead(6 * PARALLEL_HUNK_BYTES + 32, pbuf, sizeof(pbuf)));
+	ASSERT_EQ(sizeof(pbuf), chdReader->seekAndRead(8 * PARALLEL_HUNK_BYTES + 32, pbuf, sizeof(pbuf)));
+	buf.resize(3 * PARALLEL_HUNK_BYTES);
+	ASSERT_EQ(buf.size(), chdReader->seekAndRead(6 * PARALLEL_HUNK_BYTES, buf.data(), buf.size()));
+	EXPECT_EQ(0, memcmp(&parallelData[6 * PARALLEL_HUNK_BYTES], buf.data(), buf.size()));
+}
+
+/**
+ * If a hunk can't be read, only the hunks before the first failed hunk
+ * are returned, and lastError() is set to the first failed hunk's error,
+ * even if later hunks fail on other threads first.
+ */
+TEST_F(ChdReaderTest, parallelReadFirstError)
+{
+	ChdReaderPtr chdReader = openChd(chdParallel);
+	ASSERT_TRUE(chdReader->isOpen());
+	LibRpBase::SparseDiscReader *const sparseReader = chdReader.get();
+
+	vector<uint8_t> buf(PARALLEL_HUNK_COUNT * PARALLEL_HUNK_BYTES);
+	for (unsigned int i = 0; i < 8; i++) {
+		// Disable the cache so every hunk is decompressed each time.
+		sparseReader->setCacheSize(0);
+		chdReader->clearError();
+
+		// Hunks 5 and 9 both fail. Hunk 5 is first.
+		ASSERT_EQ(PARALLEL_PARENT_HUNK * PARALLEL_HUNK_BYTES, chdReader->seekAndRead(0, buf.data(), buf.size()));
+		EXPECT_EQ(ENOTSUP, chdReader->lastError());
+		EXPECT_EQ(0, memcmp(parallelData.data(), buf.data(), PARALLEL_PARENT_HUNK * PARALLEL_HUNK_BYTES));
+
+		// Only hunk 9 fails.
+		chdReader->clearError();
+		const size_t start = (PARALLEL_PARENT_HUNK + 1) * PARALLEL_HUNK_BYTES;
+		const size_t expected = (PARALLEL_BAD_CRC_HUNK - PARALLEL_PARENT_HUNK - 1) * PARALLEL_HUNK_BYTES;
+		ASSERT_EQ(expected, chdReader->seekAndRead(start, buf.data(), buf.size() - start));
+		EXPECT_EQ(EIO, chdReader->lastError());
+		EXPECT_EQ(0, memcmp(&parallelData[start], buf.data(), expected));
+	}
+
+	// Hunks after the failed hunks can still be read.
+	sparseReader->setCacheSize(LibRpBase::SparseDiscReader::DEFAULT_CACHE_SIZE_MB);
+	const size_t start = (PARALLEL_BAD_CRC_HUNK + 1) * PARALLEL_HUNK_BYTES;
+	ASSERT_EQ(buf.size() - start, chdReader->seekAndRead(start, buf.data(), buf.size() - start));
+	EXPECT_EQ(0, memcmp(&parallelData[start], buf.data(), buf.size() - start));
+}
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRomData test suite: ChdReader tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -19,6 +19,7 @@
 #include "mz_compat.h"
 
 // Other rom-properties libraries
+#include "librpbyteswap/byteswap_rp.h"
 #include "librpfile/FileSystem.hpp"
 #include "librptext/conversion.hpp"
 #include "librptext/printf.hpp"
@@ -26,6 +27,7 @@ using namespace LibRpText;
 
 // libromdata
 #include "disc/GcnFst.hpp"
+#include "Console/gcn_structs.h"
 using LibRpBase::IFst;
 
 // libwin32common
@@ -42,6 +44,7 @@ using LibRpBase::IFst;
 // C++ includes
 #include <algorithm>
 #include <array>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <unordered_set>
@@ -599,6 +602,159 @@ INSTANTIATE_TEST_SUITE_P(Wii, GcnFstTest,
 	testing::ValuesIn(GcnFstTest::ReadTestCasesFromDisk(2))
 	, GcnFstTest::test_case_suffix_generator);
 
+/**
+ * Synthetic FST for testing path lookups.
+ *
+ * Directory structure:
+ * - /Data/File.txt	(offset 0x200)
+ * - /Data/FILE.TXT	(offset 0x300)
+ * - /dir2/File.txt	(offset 0x500)
+ * - /faltzx.bin	(offset 0x600)
+ * - /fa21cd.bin	(offset 0x700)
+ *
+ * "File.txt" and "FILE.TXT" have the same path hash, since
+ * hashing is case-insensitive. "faltzx.bin" and "fa21cd.bin"
+ * are different names with the same (FNV-1a) path hash.
+ */
+class GcnFstPathTest : public ::testing::Test
+{
+	protected:
+		void SetUp(void) final;
+
+		/**
+		 * Add an FST entry.
+		 * @param type 0 == file; 1 == directory
+		 * @param name Name
+		 * @param val1 dir: parent_dir_idx; file: offset
+		 * @param val2 dir: next_offset; file: size
+		 */
+		void addEntry(uint8_t type, const char *name, uint32_t val1, uint32_t val2);
+
+		/**
+		 * Look up a file and get its offset.
+		 * @param filename Filename
+		 * @return File offset, or -1 if not found.
+		 */
+		off64_t findFileOffset(const char *filename);
+
+	public:
+		vector<GCN_FST_Entry> m_entries;
+		string m_string_table;
+		std::unique_ptr<IFst> m_fst;
+};
+
+void GcnFstPathTest::addEntry(uint8_t type, const char *name, uint32_t val1, uint32_t val2)
+{
+	GCN_FST_Entry entry;
+	entry.file_type_name_offset = cpu_to_be32((type << 24) | static_cast<uint32_t>(m_string_table.size()));
+	entry.file.offset = cpu_to_be32(val1);
+	entry.file.size = cpu_to_be32(val2);
+	m_entries.push_back(entry);
+
+	m_string_table += name;
+	m_string_table += '\0';
+}
+
+void GcnFstPathTest::SetUp(void)
+{
+	// Root directory
+	addEntry(1, "", 0, 8);
+
+	addEntry(1, "Data", 0, 4);		// 1
+	addEntry(0, "File.txt", 0x200, 2);	// 2
+	addEntry(0, "FILE.TXT", 0x300, 3);	// 3
+	addEntry(1, "dir2", 0, 6);		// 4
+	addEntry(0, "File.txt", 0x500, 5);	// 5
+	addEntry(0, "faltzx.bin", 0x600, 6);	// 6
+	addEntry(0, "fa21cd.bin", 0x700, 7);	// 7
+	ASSERT_EQ(8U, m_entries.size());
+
+	vector<uint8_t> fstData(m_entries.size() * sizeof(GCN_FST_Entry));
+	memcpy(fstData.data(), m_entries.data(), fstData.size());
+	fstData.insert(fstData.end(), m_string_table.begin(), m_string_table.end());
+
+	m_fst.reset(new GcnFst(fstData.data(), static_cast<uint32_t>(fstData.size()), 0));
+	ASSERT_TRUE(m_fst->isOpen());
+	ASSERT_FALSE(m_fst->hasErrors());
+}
+
+off64_t GcnFstPathTest::findFileOffset(const char *filename)
+{
+	IFst::DirEnt dirent;
+	int ret = m_fst->find_file(filename, &dirent);
+	if (ret != 0) {
+		EXPECT_EQ(-ENOENT, ret);
+		return -1;
+	}
+	return dirent.offset;
+}
+
+/**
+ * Exact matches are preferred over case-insensitive matches.
+ */
+TEST_F(GcnFstPathTest, ExactMatch)
+{
+	EXPECT_EQ(0x200, findFileOffset("/Data/File.txt"));
+	EXPECT_EQ(0x300, findFileOffset("/Data/FILE.TXT"));
+	EXPECT_EQ(0x500, findFileOffset("/dir2/File.txt"));
+	EXPECT_EQ(0x600, findFileOffset("/faltzx.bin"));
+	EXPECT_EQ(0x700, findFileOffset("/fa21cd.bin"));
+
+	// Relative paths and empty path components.
+	EXPECT_EQ(0x300, findFileOffset("Data//FILE.TXT"));
+}
+
+/**
+ * Case-insensitive lookups. (ASCII only)
+ */
+TEST_F(GcnFstPathTest, CaseInsensitive)
+{
+	// Multiple case-insensitive matches: The first entry is used.
+	EXPECT_EQ(0x200, findFileOffset("/data/file.txt"));
+	EXPECT_EQ(0x200, findFileOffset("/DATA/File.Txt"));
+	// Directory name doesn't match exactly, so "File.txt" and
+	// "FILE.TXT" are both case-insensitive matches.
+	EXPECT_EQ(0x200, findFileOffset("/data/FILE.TXT"));
+
+	EXPECT_EQ(0x500, findFileOffset("/DIR2/file.TXT"));
+	EXPECT_EQ(0x700, findFileOffset("/FA21CD.BIN"));
+
+	IFst::DirEnt dirent;
+	ASSERT_EQ(0, m_fst->find_file("/DIR2", &dirent));
+	EXPECT_EQ(DT_DIR, dirent.type);
+	EXPECT_STREQ("dir2", dirent.name);
+
+	IFst::Dir *const dirp = m_fst->opendir("/data");
+	ASSERT_TRUE(dirp != nullptr);
+	EXPECT_EQ(1, dirp->dir_idx);
+	m_fst->closedir(dirp);
+}
+
+/**
+ * Different paths with the same path hash.
+ */
+TEST_F(GcnFstPathTest, HashCollision)
+{
+	// Same name in different directories.
+	EXPECT_EQ(0x200, findFileOffset("/Data/File.txt"));
+	EXPECT_EQ(0x500, findFileOffset("/dir2/File.txt"));
+
+	// Different names with the same path hash.
+	IFst::DirEnt dirent;
+	ASSERT_EQ(0, m_fst->find_file("/fa21cd.bin", &dirent));
+	EXPECT_STREQ("fa21cd.bin", dirent.name);
+	EXPECT_EQ(0x700, dirent.offset);
+	ASSERT_EQ(0, m_fst->find_file("/FALTZX.BIN", &dirent));
+	EXPECT_STREQ("faltzx.bin", dirent.name);
+	EXPECT_EQ(0x600, dirent.offset);
+
+	// Not found.
+	EXPECT_EQ(-1, findFileOffset("/fa21cd.bi"));
+	EXPECT_EQ(-1, findFileOffset("/dir2/FILE.TXT/x"));
+	EXPECT_EQ(-1, findFileOffset("/Data/faltzx.bin"));
+	EXPECT_EQ(-1, findFileOffset("/File.txt"));
+}
+
 } }
 
 extern "C" int gtest_main(int argc, TCHAR *argv[])
@@ -0,0 +1,423 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata/tests)                 *
+ * IsoPartitionTest.cpp: IsoPartition class test.                          *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// IsoPartition
+#include "libromdata/disc/IsoPartition.hpp"
+#include "libromdata/iso_structs.h"
+
+// Other rom-properties libraries
+#include "librpbyteswap/byteswap_rp.h"
+#include "librpfile/MemFile.hpp"
+using namespace LibRpBase;
+using namespace LibRpFile;
+
+// C includes (C++ namespace)
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <algorithm>
+#include <memory>
+#include <vector>
+using std::vector;
+
+namespace LibRomData { namespace Tests {
+
+/**
+ * MemFile wrapper that records the position of each read().
+ */
+class CountingFile final : public IRpFile
+{
+	public:
+		CountingFile(const void *buf, size_t size)
+			: m_file(std::make_shared<MemFile>(buf, size))
+		{ }
+
+	public:
+		bool isOpen(void) const final { return m_file->isOpen(); }
+		void close(void) final { m_file->close(); }
+		size_t write(const void *ptr, size_t size) final { return m_file->write(ptr, size); }
+		int seek(off64_t pos) final { return m_file->seek(pos); }
+		off64_t tell(void) final { return m_file->tell(); }
+		off64_t size(void) final { return m_file->size(); }
+
+		size_t read(void *ptr, size_t size) final
+		{
+			reads.push_back(m_file->tell());
+			return m_file->read(ptr, size);
+		}
+
+		/**
+		 * Count the reads starting at a given position.
+		 * @param pos Position
+		 * @return Number of reads
+		 */
+		unsigned int readsAt(off64_t pos) const
+		{
+			return static_cast<unsigned int>(std::count(reads.begin(), reads.end(), pos));
+		}
+
+	public:
+		vector<off64_t> reads;
+
+	private:
+		std::shared_ptr<MemFile> m_file;
+};
+
+class IsoPartitionTest : public ::testing::Test
+{
+	protected:
+		IsoPartitionTest() = default;
+
+	public:
+		static void SetUpTestSuite(void);
+		static void TearDownTestSuite(void);
+
+		void SetUp(void) final;
+		void TearDown(void) final;
+
+	public:
+		// Synthetic ISO-9660 image: (2048-byte blocks)
+		// - Block 16: Primary volume descriptor (no path table)
+		// - Block 20: Root directory
+		//   - README.TXT;1, NOVER.BIN, DIRV;1 (directory), A, BIG
+		// - Block 21: /A
+		//   - S00 through S04, HUGE
+		// - Blocks 22-24: /BIG, three blocks with zero padding at the
+		//   end of each block. LAST.BIN;1 is in the last block.
+		// - Block 25: README.TXT data
+		// - Block 26: Data for all other files
+		// - /A/S00 through /A/S04: 256 KB each, so four of them
+		//   don't fit in the 1 MB directory cache.
+		// - /A/HUGE: 1.5 MB, larger than the directory cache.
+		// Each subdirectory of /A has F.BIN;1 in its first block.
+		static constexpr unsigned int BLOCK_SIZE = 2048;
+		static constexpr uint32_t ROOT_BLOCK = 20;
+		static constexpr uint32_t A_BLOCK = 21;
+		static constexpr uint32_t BIG_BLOCK = 22;
+		static constexpr uint32_t BIG_BLOCKS = 3;
+		static constexpr uint32_t README_BLOCK = 25;
+		static constexpr uint32_t FILE_BLOCK = 26;
+		static constexpr uint32_t SUB_BLOCK = 32;
+		static constexpr uint32_t SUB_BLOCKS = 128;
+		static constexpr unsigned int SUB_COUNT = 5;
+		static constexpr uint32_t HUGE_BLOCK = SUB_BLOCK + (SUB_BLOCKS * SUB_COUNT);
+		static constexpr uint32_t HUGE_BLOCKS = 768;
+		static constexpr uint32_t BLOCK_COUNT = HUGE_BLOCK + HUGE_BLOCKS;
+
+		static constexpr char readme_data[] = "ISO-9660 test image.\n";
+		static vector<uint8_t> iso;
+
+		// Reader for the current test.
+		std::shared_ptr<CountingFile> countingFile;
+		IPartitionPtr isoPartition;
+
+		/**
+		 * Get the address of a block.
+		 * @param block Block number
+		 * @return Address
+		 */
+		static inline off64_t blockAddr(uint32_t block)
+		{
+			return static_cast<off64_t>(block) * BLOCK_SIZE;
+		}
+
+		/**
+		 * Get the starting block of /A/Sxx.
+		 * @param idx Subdirectory index
+		 * @return Starting block
+		 */
+		static inline uint32_t subBlock(unsigned int idx)
+		{
+			return SUB_BLOCK + (idx * SUB_BLOCKS);
+		}
+
+		/**
+		 * Open a file, and check that it was found.
+		 * @param filename Filename
+		 */
+		void openFile(const char *filename);
+};
+
+constexpr char IsoPartitionTest::readme_data[];
+vector<uint8_t> IsoPartitionTest::iso;
+
+/**
+ * Add a directory entry.
+ * @param dir		[in/out] Directory data
+ * @param pos		[in/out] Position in the directory data
+ * @param filename	[in] Filename ("\0" for ".", "\1" for "..")
+ * @param block		[in] Starting block
+ * @param size		[in] Size, in bytes
+ * @param isDir		[in] True if this is a subdirectory
+ */
+static void addDirEntry(uint8_t *dir, size_t &pos, const char *filename,
+	uint32_t block, uint32_t size, bool isDir)
+{
+	const size_t filename_len = std::max(strlen(filename), static_cast<size_t>(1));
+	ISO_DirEntry *const dirEntry = reinterpret_cast<ISO_DirEntry*>(&dir[pos]);
+	// NOTE: Directory records are padded to an even length.
+	dirEntry->entry_length = static_cast<uint8_t>(sizeof(*dirEntry) + filename_len + !(filename_len & 1));
+	dirEntry->block.le = cpu_to_le32(block);
+	dirEntry->block.be = cpu_to_be32(block);
+	dirEntry->size.le = cpu_to_le32(size);
+	dirEntry->size.be = cpu_to_be32(size);
+	dirEntry->flags = (isDir ? ISO_FLAG_DIRECTORY : 0);
+	dirEntry->filename_length = static_cast<uint8_t>(filename_len);
+	memcpy(&dir[pos + sizeof(*dirEntry)], filename, filename_len);
+	pos += dirEntry->entry_length;
+}
+
+void IsoPartitionTest::SetUpTestSuite(void)
+{
+	iso.assign(static_cast<size_t>(BLOCK_COUNT) * BLOCK_SIZE, 0);
+
+	// Primary volume descriptor
+	ISO_Primary_Volume_Descriptor *const pvd =
+		reinterpret_cast<ISO_Primary_Volume_Descriptor*>(&iso[ISO_PVD_ADDRESS_2048]);
+	pvd->header.type = ISO_VDT_PRIMARY;
+	memcpy(pvd->header.identifier, ISO_VD_MAGIC, sizeof(pvd->header.identifier));
+	pvd->header.version = ISO_VD_VERSION;
+	pvd->volume_space_size.le = cpu_to_le32(BLOCK_COUNT);
+	pvd->volume_space_size.be = cpu_to_be32(BLOCK_COUNT);
+	pvd->logical_block_size.le = cpu_to_le16(BLOCK_SIZE);
+	pvd->logical_block_size.be = cpu_to_be16(BLOCK_SIZE);
+	uint8_t *const pRootEntry = reinterpret_cast<uint8_t*>(&pvd->dir_entry_root);
+	size_t pos = 0;
+	addDirEntry(pRootEntry, pos, "", ROOT_BLOCK, BLOCK_SIZE, true);
+
+	// Root directory
+	uint8_t *dir = &iso[blockAddr(ROOT_BLOCK)];
+	pos = 0;
+	addDirEntry(dir, pos, "", ROOT_BLOCK, BLOCK_SIZE, true);
+	addDirEntry(dir, pos, "\1", ROOT_BLOCK, BLOCK_SIZE, true);
+	addDirEntry(dir, pos, "A", A_BLOCK, BLOCK_SIZE, true);
+	addDirEntry(dir, pos, "BIG", BIG_BLOCK, BIG_BLOCKS * BLOCK_SIZE, true);
+	addDirEntry(dir, pos, "DIRV;1", A_BLOCK, BLOCK_SIZE, true);
+	addDirEntry(dir, pos, "NOVER.BIN", FILE_BLOCK, BLOCK_SIZE, false);
+	addDirEntry(dir, pos, "README.TXT;1", README_BLOCK, sizeof(readme_data) - 1, false);
+	memcpy(&iso[blockAddr(README_BLOCK)], readme_data, sizeof(readme_data) - 1);
+
+	// /A
+	dir = &iso[blockAddr(A_BLOCK)];
+	pos = 0;
+	addDirEntry(dir, pos, "", A_BLOCK, BLOCK_SIZE, true);
+	addDirEntry(dir, pos, "\1", ROOT_BLOCK, BLOCK_SIZE, true);
+	addDirEntry(dir, pos, "HUGE", HUGE_BLOCK, HUGE_BLOCKS * BLOCK_SIZE, true);
+	for (unsigned int i = 0; i < SUB_COUNT; i++) {
+		char name[8];
+		snprintf(name, sizeof(name), "S%02u", i);
+		addDirEntry(dir, pos, name, subBlock(i), SUB_BLOCKS * BLOCK_SIZE, true);
+	}
+
+	// /A/Sxx and /A/HUGE
+	// Only the first block has directory entries.
+	for (unsigned int i = 0; i <= SUB_COUNT; i++) {
+		const uint32_t block = (i < SUB_COUNT ? subBlock(i) : HUGE_BLOCK);
+		dir = &iso[blockAddr(block)];
+		pos = 0;
+		addDirEntry(dir, pos, "", block, (i < SUB_COUNT ? SUB_BLOCKS : HUGE_BLOCKS) * BLOCK_SIZE, true);
+		addDirEntry(dir, pos, "\1", A_BLOCK, BLOCK_SIZE, true);
+		addDirEntry(dir, pos, "F.BIN;1", FILE_BLOCK, BLOCK_SIZE, false);
+	}
+
+	// /BIG
+	// Directory entries can't cross block boundaries,
+	// so each block is filled, then padded with zeroes.
+	dir = &iso[blockAddr(BIG_BLOCK)];
+	pos = 0;
+	addDirEntry(dir, pos, "", BIG_BLOCK, BIG_BLOCKS * BLOCK_SIZE, true);
+	addDirEntry(dir, pos, "\1", ROOT_BLOCK, BLOCK_SIZE, true);
+	unsigned int filler = 0;
+	for (unsigned int block = 0; block < BIG_BLOCKS - 1; block++) {
+		static constexpr size_t FILLER_ENTRY_LENGTH = sizeof(ISO_DirEntry) + 14 + 1;
+		while (pos + FILLER_ENTRY_LENGTH + 8 <= (block + 1) * BLOCK_SIZE) {
+			char name[16];
+			snprintf(name, sizeof(name), "FILLER%02u.BIN;1", filler++);
+			addDirEntry(dir, pos, name, FILE_BLOCK, BLOCK_SIZE, false);
+		}
+		pos = (block + 1) * BLOCK_SIZE;
+	}
+	addDirEntry(dir, pos, "LAST.BIN;1", FILE_BLOCK, BLOCK_SIZE, false);
+}
+
+void IsoPartitionTest::TearDownTestSuite(void)
+{
+	iso.clear();
+	iso.shrink_to_fit();
+}
+
+/**
+ * SetUp() function.
+ * Run before each test.
+ */
+void IsoPartitionTest::SetUp(void)
+{
+	ASSERT_FALSE(iso.empty());
+	countingFile = std::make_shared<CountingFile>(iso.data(), iso.size());
+	isoPartition = std::make_shared<IsoPartition>(countingFile, 0, -1);
+	ASSERT_TRUE(isoPartition->isOpen());
+}
+
+/**
+ * TearDown() function.
+ * Run after each test.
+ */
+void IsoPartitionTest::TearDown(void)
+{
+	isoPartition.reset();
+	countingFile.reset();
+}
+
+/**
+ * Open a file, and check that it was found.
+ * @param filename Filename
+ */
+void IsoPartitionTest::openFile(const char *filename)
+{
+	const IRpFilePtr file = isoPartition->open(filename);
+	EXPECT_TRUE(file != nullptr) << "filename == " << filename;
+}
+
+/**
+ * Look up files with and without the ";1" version suffix.
+ */
+TEST_F(IsoPartitionTest, versionSuffix)
+{
+	// README.TXT;1 can be opened with or without ";1".
+	// Lookups are case-insensitive.
+	for (const char *filename : {"/README.TXT", "/README.TXT;1", "/readme.txt", "/ReadMe.Txt;1"}) {
+		const IRpFilePtr file = isoPartition->open(filename);
+		ASSERT_TRUE(file != nullptr) << "filename == " << filename;
+		char buf[sizeof(readme_data)];
+		ASSERT_EQ(sizeof(readme_data) - 1, file->read(buf, sizeof(buf)));
+		EXPECT_EQ(0, memcmp(readme_data, buf, sizeof(readme_data) - 1));
+	}
+
+	// A partial name doesn't match.
+	EXPECT_TRUE(isoPartition->open("/README.TX") == nullptr);
+	EXPECT_EQ(ENOENT, isoPartition->lastError());
+	EXPECT_TRUE(isoPartition->open("/README.TXT;2") == nullptr);
+	EXPECT_EQ(ENOENT, isoPartition->lastError());
+
+	// NOVER.BIN doesn't have ";1", so it can't be opened with ";1".
+	openFile("/NOVER.BIN");
+	EXPECT_TRUE(isoPartition->open("/NOVER.BIN;1") == nullptr);
+	EXPECT_EQ(ENOENT, isoPartition->lastError());
+
+	// DIRV;1 is a directory, so it can't be opened as a file.
+	EXPECT_TRUE(isoPartition->open("/DIRV") == nullptr);
+	EXPECT_EQ(EISDIR, isoPartition->lastError());
+	EXPECT_TRUE(isoPartition->open("/A") == nullptr);
+	EXPECT_EQ(EISDIR, isoPartition->lastError());
+
+	// Subdirectories are found without ";1", too.
+	openFile("/A/S00/F.BIN");
+	openFile("/a/s00/f.bin;1");
+}
+
+/**
+ * Find a file in the last block of a multi-block directory.
+ * The first two blocks end with zero padding.
+ */
+TEST_F(IsoPartitionTest, multiBlockDirectory)
+{
+	openFile("/BIG/FILLER00.BIN");
+	openFile("/BIG/LAST.BIN");
+	openFile("/BIG/LAST.BIN;1");
+
+	// Each directory is only read once.
+	EXPECT_EQ(1U, countingFile->readsAt(blockAddr(BIG_BLOCK)));
+}
+
+/**
+ * Directory LRU eviction.
+ * The root directory and the most recently loaded directory
+ * are never evicted.
+ */
+TEST_F(IsoPartitionTest, directoryLRU)
+{
+	// The root directory is loaded by the constructor.
+	EXPECT_EQ(1U, countingFile->readsAt(blockAddr(ROOT_BLOCK)));
+
+	// Load S00, S01, and S02. They all fit in the cache.
+	// NOTE: Loading /A/Sxx only uses /A, not the root directory,
+	// so the root directory is now the least-recently used.
+	openFile("/A/S00/F.BIN");
+	openFile("/A/S01/F.BIN");
+	openFile("/A/S02/F.BIN");
+
+	// Load S03. S00 is evicted; the root directory isn't.
+	openFile("/A/S03/F.BIN");
+
+	// Use S01, then load S04. S02 is evicted; S01 isn't.
+	openFile("/A/S01/F.BIN");
+	openFile("/A/S04/F.BIN");
+
+	// Check which directories are still cached.
+	openFile("/README.TXT");
+	openFile("/A/S01/F.BIN");
+	openFile("/A/S03/F.BIN");
+	openFile("/A/S04/F.BIN");
+	EXPECT_EQ(1U, countingFile->readsAt(blockAddr(ROOT_BLOCK)));
+	EXPECT_EQ(1U, countingFile->readsAt(blockAddr(A_BLOCK)));
+	EXPECT_EQ(1U, countingFile->readsAt(blockAddr(subBlock(1))));
+	EXPECT_EQ(1U, countingFile->readsAt(blockAddr(subBlock(3))));
+	EXPECT_EQ(1U, countingFile->readsAt(blockAddr(subBlock(4))));
+
+	// S00 and S02 were evicted, so they're read again.
+	openFile("/A/S02/F.BIN");
+	EXPECT_EQ(2U, countingFile->readsAt(blockAddr(subBlock(2))));
+	openFile("/A/S00/F.BIN");
+	EXPECT_EQ(2U, countingFile->readsAt(blockAddr(subBlock(0))));
+}
+
+/**
+ * A directory that's larger than the directory cache
+ * stays cached until another directory is loaded.
+ */
+TEST_F(IsoPartitionTest, directoryLargerThanCache)
+{
+	openFile("/A/S00/F.BIN");
+
+	// HUGE evicts everything except for itself and the root directory.
+	openFile("/A/HUGE/F.BIN");
+	openFile("/A/HUGE/F.BIN");
+	openFile("/README.TXT");
+	EXPECT_EQ(1U, countingFile->readsAt(blockAddr(HUGE_BLOCK)));
+	EXPECT_EQ(1U, countingFile->readsAt(blockAddr(ROOT_BLOCK)));
+
+	// /A and S00 were evicted.
+	openFile("/A/S00/F.BIN");
+	EXPECT_EQ(2U, countingFile->readsAt(blockAddr(A_BLOCK)));
+	EXPECT_EQ(2U, countingFile->readsAt(blockAddr(subBlock(0))));
+
+	// HUGE is no longer the most recently loaded directory, so it was evicted.
+	openFile("/A/HUGE/F.BIN");
+	EXPECT_EQ(2U, countingFile->readsAt(blockAddr(HUGE_BLOCK)));
+}
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRomData test suite: IsoPartition tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,947 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata/tests)                 *
+ * NCCHReaderTest.cpp: NCCHReader class test.                              *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// NCCHReader
+#include "libromdata/disc/NCCHReader.hpp"
+#include "libromdata/crypto/N3DSVerifyKeys.hpp"
+#include "libromdata/RomDataFactory.hpp"
+
+// Other rom-properties libraries
+#include "librpbase/crypto/AesCipherFactory.hpp"
+#include "librpbase/crypto/IAesCipher.hpp"
+#include "librpbase/crypto/Hash.hpp"
+#include "librpbase/RomData.hpp"
+#include "librpfile/MemFile.hpp"
+using namespace LibRpBase;
+using namespace LibRpFile;
+
+// C includes (C++ namespace)
+#include <cerrno>
+#include <cstdio>
+
+// C++ includes
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace LibRomData { namespace Tests {
+
+class NCCHReaderTest : public ::testing::Test
+{
+	protected:
+		NCCHReaderTest() = default;
+
+	public:
+		static void SetUpTestSuite(void);
+		static void TearDownTestSuite(void);
+
+		void SetUp(void) final;
+		void TearDown(void) final;
+
+	public:
+		// Synthetic NCCH layout:
+		// - 0x0000: NCCH header
+		// - 0x0200: ExeFS header
+		// - 0x0400: ExeFS ".code" (CODE_SIZE bytes)
+		static constexpr unsigned int MEDIA_UNIT_SHIFT = 9;
+		static constexpr uint32_t EXEFS_OFFSET = 0x200;
+		static constexpr uint32_t CODE_OFFSET = EXEFS_OFFSET + sizeof(N3DS_ExeFS_Header_t);
+		static constexpr uint32_t CODE_SIZE = 8U * 1024U * 1024U;
+		static constexpr uint64_t TITLE_ID = 0x0004000000ABCD00ULL;
+
+		// Number of passes over the .code file for benchmarks.
+		static constexpr unsigned int BENCHMARK_PASSES = 8;
+
+		// Plaintext .code file and the encrypted NCCH.
+		static vector<uint8_t> code_plain;
+		static vector<uint8_t> ncch_enc;
+
+		// Reader for the current test.
+		MemFilePtr memFile;
+		IDiscReaderPtr ncchReader;
+
+		/**
+		 * Open the .code file using NCCHReader.
+		 * @return PartitionFile for ".code".
+		 */
+		IRpFilePtr openCode(void);
+
+		/**
+		 * Print the throughput of a benchmark.
+		 * @param desc Description
+		 * @param bytes Number of bytes processed
+		 * @param start Start time
+		 */
+		static void printThroughput(const char *desc, uint64_t bytes,
+			std::chrono::steady_clock::time_point start);
+};
+
+vector<uint8_t> NCCHReaderTest::code_plain;
+vector<uint8_t> NCCHReaderTest::ncch_enc;
+
+/**
+ * Create the synthetic encrypted NCCH.
+ * This uses the fixed zero key, so no key files are needed.
+ */
+void NCCHReaderTest::SetUpTestSuite(void)
+{
+	// Plaintext .code data
+	code_plain.resize(CODE_SIZE);
+	uint32_t seed = 0x12345678;
+	for (uint8_t &p : code_plain) {
+		seed = seed * 1103515245U + 12345U;
+		p = static_cast<uint8_t>(seed >> 16);
+	}
+
+	ncch_enc.assign(CODE_OFFSET + CODE_SIZE, 0);
+
+	// NCCH header
+	N3DS_NCCH_Header_t *const ncch_header = reinterpret_cast<N3DS_NCCH_Header_t*>(ncch_enc.data());
+	ncch_header->hdr.magic = cpu_to_be32(N3DS_NCCH_HEADER_MAGIC);
+	ncch_header->hdr.content_size = cpu_to_le32(static_cast<uint32_t>(ncch_enc.size() >> MEDIA_UNIT_SHIFT));
+	ncch_header->hdr.title_id.id = cpu_to_le64(TITLE_ID);
+	ncch_header->hdr.program_id.id = cpu_to_le64(TITLE_ID);
+	ncch_header->hdr.flags[N3DS_NCCH_FLAG_CONTENT_TYPE] = N3DS_NCCH_CONTENT_TYPE_Executable;
+	ncch_header->hdr.flags[N3DS_NCCH_FLAG_BIT_MASKS] = N3DS_NCCH_BIT_MASK_FixedCryptoKey;
+	ncch_header->hdr.exefs_offset = cpu_to_le32(EXEFS_OFFSET >> MEDIA_UNIT_SHIFT);
+	ncch_header->hdr.exefs_size = cpu_to_le32((ncch_enc.size() - EXEFS_OFFSET) >> MEDIA_UNIT_SHIFT);
+
+	// ExeFS header
+	N3DS_ExeFS_Header_t *const exefs_header = reinterpret_cast<N3DS_ExeFS_Header_t*>(&ncch_enc[EXEFS_OFFSET]);
+	memcpy(exefs_header->files[0].name, ".code", 6);
+	exefs_header->files[0].offset = cpu_to_le32(0);
+	exefs_header->files[0].size = cpu_to_le32(CODE_SIZE);
+	memcpy(&ncch_enc[CODE_OFFSET], code_plain.data(), CODE_SIZE);
+
+	// Encrypt the ExeFS using the zero key.
+	// NOTE: The ExeFS header uses key 0 and .code uses key 1,
+	// but both keys are zero here.
+	unique_ptr<IAesCipher> cipher(AesCipherFactory::create());
+	ASSERT_TRUE(cipher != nullptr);
+	static const uint8_t zero_key[16] = {0};
+	ASSERT_EQ(0, cipher->setChainingMode(IAesCipher::ChainingMode::CTR));
+	ASSERT_EQ(0, cipher->setKey(zero_key, sizeof(zero_key)));
+	u128_t ctr;
+	ctr.init_ctr(__swab64(TITLE_ID), N3DS_NCCH_SECTION_EXEFS, 0);
+	ASSERT_EQ(0, cipher->setIV(ctr.u8, sizeof(ctr.u8)));
+	const size_t exefs_size = ncch_enc.size() - EXEFS_OFFSET;
+	ASSERT_EQ(exefs_size, cipher->decrypt(&ncch_enc[EXEFS_OFFSET], exefs_size));
+}
+
+void NCCHReaderTest::TearDownTestSuite(void)
+{
+	code_plain.clear();
+	code_plain.shrink_to_fit();
+	ncch_enc.clear();
+	ncch_enc.shrink_to_fit();
+}
+
+/**
+ * SetUp() function.
+ * Run before each test.
+ */
+void NCCHReaderTest::SetUp(void)
+{
+	ASSERT_FALSE(ncch_enc.empty());
+	memFile = std::make_shared<MemFile>(ncch_enc.data(), ncch_enc.size());
+	ncchReader = std::make_shared<NCCHReader>(memFile, MEDIA_UNIT_SHIFT,
+		0, static_cast<uint32_t>(ncch_enc.size()));
+	ASSERT_TRUE(ncchReader->isOpen());
+}
+
+/**
+ * TearDown() function.
+ * Run after each test.
+ */
+void NCCHReaderTest::TearDown(void)
+{
+	ncchReader.reset();
+	memFile.reset();
+}
+
+/**
+ * Open the .code file using NCCHReader.
+ * @return PartitionFile for ".code".
+ */
+IRpFilePtr NCCHReaderTest::openCode(void)
+{
+	return std::static_pointer_cast<NCCHReader>(ncchReader)->open(N3DS_NCCH_SECTION_EXEFS, ".code");
+}
+
+/**
+ * Print the throughput of a benchmark.
+ * @param desc Description
+ * @param bytes Number of bytes processed
+ * @param start Start time
+ */
+void NCCHReaderTest::printThroughput(const char *desc, uint64_t bytes,
+	std::chrono::steady_clock::time_point start)
+{
+	const auto end = std::chrono::steady_clock::now();
+	const double secs = std::chrono::duration<double>(end - start).count();
+	fprintf(stderr, "%s: %.1f MB/s\n", desc,
+		(secs > 0 ? (static_cast<double>(bytes) / (1024.0 * 1024.0) / secs) : 0.0));
+}
+
+/**
+ * Read the .code file in small, unaligned pieces.
+ * This uses the keystream cache.
+ */
+TEST_F(NCCHReaderTest, smallUnalignedReads)
+{
+	IRpFilePtr code = openCode();
+	ASSERT_TRUE(code != nullptr);
+	ASSERT_EQ(static_cast<off64_t>(CODE_SIZE), code->size());
+
+	// Only check the first 512 KB; this covers multiple keystream windows.
+	static constexpr size_t CHECK_SIZE = 512U * 1024U;
+	vector<uint8_t> buf(CHECK_SIZE);
+	size_t pos = 0;
+	size_t chunk = 1;
+	while (pos < CHECK_SIZE) {
+		const size_t sz = std::min(chunk, CHECK_SIZE - pos);
+		ASSERT_EQ(sz, code->read(&buf[pos], sz)) << "pos == " << pos;
+		pos += sz;
+		chunk = (chunk * 3 + 7) % 1000 + 1;
+	}
+	EXPECT_EQ(0, memcmp(code_plain.data(), buf.data(), CHECK_SIZE));
+}
+
+/**
+ * Read small pieces from different windows, out of order.
+ * This checks keystream window replacement.
+ */
+TEST_F(NCCHReaderTest, smallReadsOutOfOrder)
+{
+	IRpFilePtr code = openCode();
+	ASSERT_TRUE(code != nullptr);
+
+	static const uint32_t offsets[] = {
+		0x7FFFF0, 0, 0x10000 - 8, 0x123456, 0x10, 0x7FFFF0, 0x200000, 0x123450,
+	};
+	for (const uint32_t offset : offsets) {
+		uint8_t buf[16];
+		const size_t sz = std::min(sizeof(buf), static_cast<size_t>(CODE_SIZE - offset));
+		ASSERT_EQ(sz, code->seekAndRead(offset, buf, sz));
+		EXPECT_EQ(0, memcmp(&code_plain[offset], buf, sz)) << "offset == " << offset;
+	}
+}
+
+/**
+ * Read the .code file in large pieces.
+ * This decrypts directly in the destination buffer.
+ */
+TEST_F(NCCHReaderTest, largeReads)
+{
+	IRpFilePtr code = openCode();
+	ASSERT_TRUE(code != nullptr);
+
+	vector<uint8_t> buf(CODE_SIZE);
+	static constexpr size_t CHUNK_SIZE = 1024U * 1024U;
+	for (size_t pos = 0; pos < CODE_SIZE; pos += CHUNK_SIZE) {
+		ASSERT_EQ(CHUNK_SIZE, code->read(&buf[pos], CHUNK_SIZE));
+	}
+	EXPECT_EQ(0, memcmp(code_plain.data(), buf.data(), CODE_SIZE));
+}
+
+/** RomFS tests **/
+
+class NCCHReaderRomFSTest : public ::testing::Test
+{
+	protected:
+		NCCHReaderRomFSTest() = default;
+
+	public:
+		// Synthetic NCCH layout:
+		// - 0x0000: NCCH header
+		// - 0x0200: RomFS (IVFC header, level 3 at +0x1000)
+		static constexpr unsigned int MEDIA_UNIT_SHIFT = 9;
+		static constexpr uint32_t ROMFS_OFFSET = 0x200;
+		static constexpr uint32_t LEVEL3_OFFSET = 0x1000;
+		static constexpr uint64_t TITLE_ID = 0x0004000000ABCE00ULL;
+
+		// RomFS contents:
+		// - /dirA/a.bin
+		// - /dirB/
+		// - /root.txt
+		struct TestDir {
+			const char16_t *name;
+			int parent;
+		};
+		struct TestFile {
+			const char16_t *name;
+			int parent;
+			const char *data;
+		};
+		static const TestDir dirs[3];
+		static const TestFile files[2];
+
+		/**
+		 * Build the encrypted NCCH.
+		 * @param siblingCycle If true, make dirB's next sibling point back to dirA.
+		 * @return NCCH
+		 */
+		static vector<uint8_t> buildNcch(bool siblingCycle);
+
+		/**
+		 * Open an NCCH.
+		 * @param ncch NCCH
+		 * @return NCCHReader
+		 */
+		IPartitionPtr openNcch(const vector<uint8_t> &ncch);
+
+		/**
+		 * Read all entries in a directory.
+		 * @param partition NCCHReader
+		 * @param path Directory path
+		 * @return Entry names, with a trailing slash for directories.
+		 */
+		static vector<string> readAllEntries(IPartition *partition, const char *path);
+
+	private:
+		MemFilePtr memFile;
+};
+
+const NCCHReaderRomFSTest::TestDir NCCHReaderRomFSTest::dirs[3] = {
+	{u"", 0},
+	{u"dirA", 0},
+	{u"dirB", 0},
+};
+const NCCHReaderRomFSTest::TestFile NCCHReaderRomFSTest::files[2] = {
+	{u"root.txt", 0, "Root file contents.\n"},
+	{u"a.bin", 1, "Contents of a.bin, which is in dirA."},
+};
+
+/**
+ * Build the encrypted NCCH.
+ * @param siblingCycle If true, make dirB's next sibling point back to dirA.
+ * @return NCCH
+ */
+vector<uint8_t> NCCHReaderRomFSTest::buildNcch(bool siblingCycle)
+{
+	// RomFS hash function.
+	// Reference: https://3dbrew.org/wiki/RomFS
+	static constexpr uint32_t HASH_BUCKETS = 3;
+	auto hashBucket = [](uint32_t parent, const char16_t *name) -> uint32_t {
+		uint32_t hash = parent ^ 123456789U;
+		for (; *name != 0; name++) {
+			hash = (hash >> 5) | (hash << 27);
+			hash ^= *name;
+		}
+		return hash % HASH_BUCKETS;
+	};
+	auto nameLength = [](const char16_t *name) -> uint32_t {
+		uint32_t len = 0;
+		for (; name[len] != 0; len++) { }
+		return len * sizeof(char16_t);
+	};
+	auto entrySize = [&nameLength](size_t hdrSize, const char16_t *name) -> uint32_t {
+		return static_cast<uint32_t>(hdrSize) + ((nameLength(name) + 3) & ~3U);
+	};
+
+	// Metadata offsets
+	uint32_t dirOffsets[ARRAY_SIZE(dirs)], fileOffsets[ARRAY_SIZE(files)];
+	uint32_t dir_meta_length = 0, file_meta_length = 0;
+	for (size_t i = 0; i < ARRAY_SIZE(dirs); i++) {
+		dirOffsets[i] = dir_meta_length;
+		dir_meta_length += entrySize(sizeof(N3DS_RomFS_DirEntry_t), dirs[i].name);
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(files); i++) {
+		fileOffsets[i] = file_meta_length;
+		file_meta_length += entrySize(sizeof(N3DS_RomFS_FileEntry_t), files[i].name);
+	}
+
+	// Level 3 layout
+	N3DS_RomFS_Level3_Header_t l3hdr;
+	const uint32_t dir_hash_offset = sizeof(l3hdr);
+	const uint32_t dir_meta_offset = dir_hash_offset + (HASH_BUCKETS * 4);
+	const uint32_t file_hash_offset = dir_meta_offset + dir_meta_length;
+	const uint32_t file_meta_offset = file_hash_offset + (HASH_BUCKETS * 4);
+	const uint32_t file_data_offset = (file_meta_offset + file_meta_length + 15) & ~15U;
+	uint32_t file_data_length = 0;
+	for (const TestFile &file : files) {
+		file_data_length += (static_cast<uint32_t>(strlen(file.data)) + 15) & ~15U;
+	}
+	vector<uint8_t> l3(file_data_offset + file_data_length, 0);
+
+	l3hdr.header_length = cpu_to_le32(sizeof(l3hdr));
+	l3hdr.dir_hash_offset = cpu_to_le32(dir_hash_offset);
+	l3hdr.dir_hash_length = cpu_to_le32(HASH_BUCKETS * 4);
+	l3hdr.dir_meta_offset = cpu_to_le32(dir_meta_offset);
+	l3hdr.dir_meta_length = cpu_to_le32(dir_meta_length);
+	l3hdr.file_hash_offset = cpu_to_le32(file_hash_offset);
+	l3hdr.file_hash_length = cpu_to_le32(HASH_BUCKETS * 4);
+	l3hdr.file_meta_offset = cpu_to_le32(file_meta_offset);
+	l3hdr.file_meta_length = cpu_to_le32(file_meta_length);
+	l3hdr.file_data_offset = cpu_to_le32(file_data_offset);
+	memcpy(l3.data(), &l3hdr, sizeof(l3hdr));
+
+	// Hash tables
+	uint32_t dirHash[HASH_BUCKETS], fileHash[HASH_BUCKETS];
+	for (size_t i = 0; i < HASH_BUCKETS; i++) {
+		dirHash[i] = fileHash[i] = N3DS_ROMFS_NO_ENTRY;
+	}
+
+	// Directory entries
+	for (size_t i = 0; i < ARRAY_SIZE(dirs); i++) {
+		N3DS_RomFS_DirEntry_t entry;
+		const uint32_t parent = dirOffsets[dirs[i].parent];
+		entry.parent_offset = cpu_to_le32(parent);
+		entry.next_sibling_offset = cpu_to_le32(N3DS_ROMFS_NO_ENTRY);
+		for (size_t j = i + 1; j < ARRAY_SIZE(dirs); j++) {
+			if (dirs[j].parent == dirs[i].parent) {
+				entry.next_sibling_offset = cpu_to_le32(dirOffsets[j]);
+				break;
+			}
+		}
+		if (i == 0) {
+			// Root directory has no siblings.
+			entry.next_sibling_offset = cpu_to_le32(N3DS_ROMFS_NO_ENTRY);
+		} else if (i == 2 && siblingCycle) {
+			// Loop back to dirA.
+			entry.next_sibling_offset = cpu_to_le32(dirOffsets[1]);
+		}
+		entry.first_child_offset = cpu_to_le32(N3DS_ROMFS_NO_ENTRY);
+		for (size_t j = 1; j < ARRAY_SIZE(dirs); j++) {
+			if (dirs[j].parent == static_cast<int>(i)) {
+				entry.first_child_offset = cpu_to_le32(dirOffsets[j]);
+				break;
+			}
+		}
+		entry.first_file_offset = cpu_to_le32(N3DS_ROMFS_NO_ENTRY);
+		for (size_t j = 0; j < ARRAY_SIZE(files); j++) {
+			if (files[j].parent == static_cast<int>(i)) {
+				entry.first_file_offset = cpu_to_le32(fileOffsets[j]);
+				break;
+			}
+		}
+		const uint32_t bucket = hashBucket(parent, dirs[i].name);
+		entry.next_hash_offset = cpu_to_le32(dirHash[bucket]);
+		dirHash[bucket] = dirOffsets[i];
+		entry.name_length = cpu_to_le32(nameLength(dirs[i].name));
+
+		uint8_t *const p = &l3[dir_meta_offset + dirOffsets[i]];
+		memcpy(p, &entry, sizeof(entry));
+		for (size_t c = 0; dirs[i].name[c] != 0; c++) {
+			const uint16_t ch = cpu_to_le16(dirs[i].name[c]);
+			memcpy(&p[sizeof(entry) + (c * 2)], &ch, sizeof(ch));
+		}
+	}
+
+	// File entries and data
+	uint64_t data_offset = 0;
+	for (size_t i = 0; i < ARRAY_SIZE(files); i++) {
+		N3DS_RomFS_FileEntry_t entry;
+		const uint32_t parent = dirOffsets[files[i].parent];
+		const size_t data_size = strlen(files[i].data);
+		entry.parent_offset = cpu_to_le32(parent);
+		entry.next_sibling_offset = cpu_to_le32(N3DS_ROMFS_NO_ENTRY);
+		for (size_t j = i + 1; j < ARRAY_SIZE(files); j++) {
+			if (files[j].parent == files[i].parent) {
+				entry.next_sibling_offset = cpu_to_le32(fileOffsets[j]);
+				break;
+			}
+		}
+		entry.data_offset = cpu_to_le64(data_offset);
+		entry.data_size = cpu_to_le64(data_size);
+		const uint32_t bucket = hashBucket(parent, files[i].name);
+		entry.next_hash_offset = cpu_to_le32(fileHash[bucket]);
+		fileHash[bucket] = fileOffsets[i];
+		entry.name_length = cpu_to_le32(nameLength(files[i].name));
+
+		uint8_t *const p = &l3[file_meta_offset + fileOffsets[i]];
+		memcpy(p, &entry, sizeof(entry));
+		for (size_t c = 0; files[i].name[c] != 0; c++) {
+			const uint16_t ch = cpu_to_le16(files[i].name[c]);
+			memcpy(&p[sizeof(entry) + (c * 2)], &ch, sizeof(ch));
+		}
+
+		memcpy(&l3[file_data_offset + data_offset], files[i].data, data_size);
+		data_offset += (data_size + 15) & ~15U;
+	}
+
+	for (size_t i = 0; i < HASH_BUCKETS; i++) {
+		const uint32_t dh = cpu_to_le32(dirHash[i]);
+		const uint32_t fh = cpu_to_le32(fileHash[i]);
+		memcpy(&l3[dir_hash_offset + (i * 4)], &dh, sizeof(dh));
+		memcpy(&l3[file_hash_offset + (i * 4)], &fh, sizeof(fh));
+	}
+
+	// NCCH
+	const uint32_t romfs_size = (LEVEL3_OFFSET + static_cast<uint32_t>(l3.size()) + 0x1FF) & ~0x1FFU;
+	vector<uint8_t> ncch(ROMFS_OFFSET + romfs_size, 0);
+	memcpy(&ncch[ROMFS_OFFSET + LEVEL3_OFFSET], l3.data(), l3.size());
+
+	N3DS_NCCH_Header_t *const ncch_header = reinterpret_cast<N3DS_NCCH_Header_t*>(ncch.data());
+	ncch_header->hdr.magic = cpu_to_be32(N3DS_NCCH_HEADER_MAGIC);
+	ncch_header->hdr.content_size = cpu_to_le32(static_cast<uint32_t>(ncch.size() >> MEDIA_UNIT_SHIFT));
+	ncch_header->hdr.title_id.id = cpu_to_le64(TITLE_ID);
+	ncch_header->hdr.program_id.id = cpu_to_le64(TITLE_ID);
+	ncch_header->hdr.flags[N3DS_NCCH_FLAG_CONTENT_TYPE] = N3DS_NCCH_CONTENT_TYPE_Data;
+	ncch_header->hdr.flags[N3DS_NCCH_FLAG_BIT_MASKS] = N3DS_NCCH_BIT_MASK_FixedCryptoKey;
+	ncch_header->hdr.romfs_offset = cpu_to_le32(ROMFS_OFFSET >> MEDIA_UNIT_SHIFT);
+	ncch_header->hdr.romfs_size = cpu_to_le32(romfs_size >> MEDIA_UNIT_SHIFT);
+
+	// IVFC header
+	// NOTE: Levels 1 and 2 aren't used by NCCHRomFS.
+	N3DS_IVFC_Header_t *const ivfc = reinterpret_cast<N3DS_IVFC_Header_t*>(&ncch[ROMFS_OFFSET]);
+	ivfc->magic = cpu_to_be32(N3DS_IVFC_MAGIC);
+	ivfc->magic_number = cpu_to_le32(N3DS_IVFC_ROMFS_MAGIC_NUMBER);
+	ivfc->master_hash_size = cpu_to_le32(0);
+	ivfc->levels[2].hashdata_size = cpu_to_le64(l3.size());
+	ivfc->levels[2].block_size_log2 = cpu_to_le32(12);
+
+	// Encrypt the RomFS using the zero key.
+	unique_ptr<IAesCipher> cipher(AesCipherFactory::create());
+	EXPECT_TRUE(cipher != nullptr);
+	static const uint8_t zero_key[16] = {0};
+	EXPECT_EQ(0, cipher->setChainingMode(IAesCipher::ChainingMode::CTR));
+	EXPECT_EQ(0, cipher->setKey(zero_key, sizeof(zero_key)));
+	u128_t ctr;
+	ctr.init_ctr(__swab64(TITLE_ID), N3DS_NCCH_SECTION_ROMFS, 0);
+	EXPECT_EQ(0, cipher->setIV(ctr.u8, sizeof(ctr.u8)));
+	EXPECT_EQ(romfs_size, cipher->decrypt(&ncch[ROMFS_OFFSET], romfs_size));
+	return ncch;
+}
+
+/**
+ * Open an NCCH.
+ * @param ncch NCCH
+ * @return NCCHReader
+ */
+IPartitionPtr NCCHReaderRomFSTest::openNcch(const vector<uint8_t> &ncch)
+{
+	memFile = std::make_shared<MemFile>(ncch.data(), ncch.size());
+	return std::make_shared<NCCHReader>(memFile, MEDIA_UNIT_SHIFT,
+		0, static_cast<uint32_t>(ncch.size()));
+}
+
+/**
+ * Read all entries in a directory.
+ * @param partition NCCHReader
+ * @param path Directory path
+ * @return Entry names, with a trailing slash for directories.
+ */
+vector<string> NCCHReaderRomFSTest::readAllEntries(IPartition *partition, const char *path)
+{
+	vector<string> names;
+	IFst::Dir *const dirp = partition->opendir(path);
+	EXPECT_TRUE(dirp != nullptr) << "path == " << path;
+	if (!dirp) {
+		return names;
+	}
+
+	// NOTE: Limiting the number of entries in case readdir() loops.
+	for (unsigned int i = 0; i < 16; i++) {
+		const IFst::DirEnt *const dirent = partition->readdir(dirp);
+		if (!dirent) {
+			break;
+		}
+		names.emplace_back(dirent->name);
+		if (dirent->type == DT_DIR) {
+			names.back() += '/';
+		}
+	}
+	partition->closedir(dirp);
+	return names;
+}
+
+/**
+ * Read the RomFS directories.
+ */
+TEST_F(NCCHReaderRomFSTest, readdir)
+{
+	IPartitionPtr partition = openNcch(buildNcch(false));
+	ASSERT_TRUE(partition->isOpen());
+
+	// Subdirectories are returned first, followed by files.
+	const vector<string> rootExpected = {"dirA/", "dirB/", "root.txt"};
+	EXPECT_EQ(rootExpected, readAllEntries(partition.get(), "/"));
+	const vector<string> dirAExpected = {"a.bin"};
+	EXPECT_EQ(dirAExpected, readAllEntries(partition.get(), "/dirA"));
+	EXPECT_TRUE(readAllEntries(partition.get(), "/dirB").empty());
+
+	// Nonexistent directory
+	EXPECT_TRUE(partition->opendir("/dirC") == nullptr);
+}
+
+/**
+ * Open RomFS files using the level 3 hash tables.
+ */
+TEST_F(NCCHReaderRomFSTest, find_file)
+{
+	IPartitionPtr partition = openNcch(buildNcch(false));
+	ASSERT_TRUE(partition->isOpen());
+
+	for (const char *const path : {"/root.txt", "/dirA/a.bin", "dirA//a.bin"}) {
+		IRpFilePtr file = partition->open(path);
+		ASSERT_TRUE(file != nullptr) << "path == " << path;
+		const char *const data = (strstr(path, "a.bin") ? files[1].data : files[0].data);
+		const size_t data_size = strlen(data);
+		ASSERT_EQ(static_cast<off64_t>(data_size), file->size()) << "path == " << path;
+
+		char buf[64];
+		ASSERT_EQ(data_size, file->read(buf, data_size)) << "path == " << path;
+		EXPECT_EQ(0, memcmp(data, buf, data_size)) << "path == " << path;
+	}
+
+	// Directories and nonexistent files can't be opened.
+	EXPECT_TRUE(partition->open("/dirA") == nullptr);
+	EXPECT_EQ(EISDIR, partition->lastError());
+	EXPECT_TRUE(partition->open("/a.bin") == nullptr);
+	EXPECT_TRUE(partition->open("/dirB/a.bin") == nullptr);
+	EXPECT_EQ(ENOENT, partition->lastError());
+}
+
+/**
+ * A directory sibling that points backwards must stop readdir().
+ */
+TEST_F(NCCHReaderRomFSTest, readdir_siblingCycle)
+{
+	IPartitionPtr partition = openNcch(buildNcch(true));
+	ASSERT_TRUE(partition->isOpen());
+
+	// dirB's sibling is dirA, so readdir() stops after dirB.
+	// Files aren't returned, since the directory is corrupted.
+	const vector<string> rootExpected = {"dirA/", "dirB/"};
+	EXPECT_EQ(rootExpected, readAllEntries(partition.get(), "/"));
+}
+
+/** Verify Contents tests **/
+
+class NCCHReaderVerifyTest : public ::testing::Test
+{
+	protected:
+		NCCHReaderVerifyTest() = default;
+
+	public:
+		// Synthetic NCCH layout:
+		// - 0x0000: NCCH header
+		// - 0x0200: ExHeader
+		// - 0x0A00: ExeFS header
+		// - 0x0C00: ExeFS ".code" (CODE_SIZE bytes)
+		// - 0x4C00: RomFS (ROMFS_SIZE bytes; the first 0x200 bytes are hashed)
+		static constexpr unsigned int MEDIA_UNIT_SHIFT = 9;
+		static constexpr uint32_t EXHEADER_OFFSET = sizeof(N3DS_NCCH_Header_t);
+		static constexpr uint32_t EXHEADER_SIZE = 0x400;
+		static constexpr uint32_t EXEFS_OFFSET = 0xA00;
+		static constexpr uint32_t CODE_OFFSET = EXEFS_OFFSET + sizeof(N3DS_ExeFS_Header_t);
+		static constexpr uint32_t CODE_SIZE = 0x4000;
+		static constexpr uint32_t ROMFS_OFFSET = CODE_OFFSET + CODE_SIZE;
+		static constexpr uint32_t ROMFS_SIZE = 0x1000;
+		static constexpr uint32_t ROMFS_HASH_SIZE = 0x200;
+		static constexpr uint64_t TITLE_ID = 0x0004000000ABCF00ULL;
+
+		/**
+		 * Build an NCCH with valid ExHeader, ExeFS, and RomFS hashes.
+		 * Unless NoCrypto is set, the NCCH is encrypted with the zero key.
+		 * @param bitMasks NCCH crypto flags (N3DS_NCCH_FLAG_BIT_MASKS)
+		 * @return NCCH
+		 */
+		static vector<uint8_t> buildNcch(uint8_t bitMasks);
+
+		/**
+		 * Run "Verify Contents" on an NCCH.
+		 * @param ncch		[in] NCCH
+		 * @param params	[out] ROM operation results
+		 * @return doRomOp() return value
+		 */
+		static int verifyContents(const vector<uint8_t> &ncch, RomData::RomOpParams &params);
+};
+
+/**
+ * Calculate a SHA-256 hash.
+ * @param digest	[out] SHA-256 hash
+ * @param data		[in] Data
+ * @param size		[in] Size of data
+ */
+static void sha256(uint8_t digest[32], const uint8_t *data, size_t size)
+{
+	Hash hash(Hash::Algorithm::SHA256);
+	ASSERT_TRUE(hash.isUsable());
+	hash.process(data, size);
+	ASSERT_EQ(0, hash.getHash(digest, 32));
+}
+
+/**
+ * Encrypt an NCCH section using the zero key.
+ * @param ncch		[in/out] NCCH
+ * @param offset	[in] Section offset
+ * @param size		[in] Section size
+ * @param section	[in] Section type (N3DS_NCCH_Sections)
+ */
+static void encryptSection(vector<uint8_t> &ncch, uint32_t offset, uint32_t size, uint8_t section)
+{
+	unique_ptr<IAesCipher> cipher(AesCipherFactory::create());
+	ASSERT_TRUE(cipher != nullptr);
+	static const uint8_t zero_key[16] = {0};
+	ASSERT_EQ(0, cipher->setChainingMode(IAesCipher::ChainingMode::CTR));
+	ASSERT_EQ(0, cipher->setKey(zero_key, sizeof(zero_key)));
+	u128_t ctr;
+	ctr.init_ctr(__swab64(NCCHReaderVerifyTest::TITLE_ID), section, 0);
+	ASSERT_EQ(0, cipher->setIV(ctr.u8, sizeof(ctr.u8)));
+	ASSERT_EQ(size, cipher->decrypt(&ncch[offset], size));
+}
+
+/**
+ * Build an NCCH with valid ExHeader, ExeFS, and RomFS hashes.
+ * Unless NoCrypto is set, the NCCH is encrypted with the zero key.
+ * @param bitMasks NCCH crypto flags (N3DS_NCCH_FLAG_BIT_MASKS)
+ * @return NCCH
+ */
+vector<uint8_t> NCCHReaderVerifyTest::buildNcch(uint8_t bitMasks)
+{
+	vector<uint8_t> ncch(ROMFS_OFFSET + ROMFS_SIZE);
+	uint32_t seed = 0x87654321;
+	for (uint32_t i = EXHEADER_OFFSET; i < ncch.size(); i++) {
+		seed = seed * 1103515245U + 12345U;
+		ncch[i] = static_cast<uint8_t>(seed >> 16);
+	}
+
+	// NCCH header
+	N3DS_NCCH_Header_t *const ncch_header = reinterpret_cast<N3DS_NCCH_Header_t*>(ncch.data());
+	ncch_header->hdr.magic = cpu_to_be32(N3DS_NCCH_HEADER_MAGIC);
+	ncch_header->hdr.content_size = cpu_to_le32(static_cast<uint32_t>(ncch.size() >> MEDIA_UNIT_SHIFT));
+	ncch_header->hdr.title_id.id = cpu_to_le64(TITLE_ID);
+	ncch_header->hdr.program_id.id = cpu_to_le64(TITLE_ID);
+	ncch_header->hdr.flags[N3DS_NCCH_FLAG_CONTENT_TYPE] = N3DS_NCCH_CONTENT_TYPE_Executable;
+	ncch_header->hdr.flags[N3DS_NCCH_FLAG_BIT_MASKS] = bitMasks;
+	ncch_header->hdr.exheader_size = cpu_to_le32(EXHEADER_SIZE);
+	ncch_header->hdr.exefs_offset = cpu_to_le32(EXEFS_OFFSET >> MEDIA_UNIT_SHIFT);
+	ncch_header->hdr.exefs_size = cpu_to_le32((ROMFS_OFFSET - EXEFS_OFFSET) >> MEDIA_UNIT_SHIFT);
+	ncch_header->hdr.exefs_hash_region_size = cpu_to_le32(sizeof(N3DS_ExeFS_Header_t) >> MEDIA_UNIT_SHIFT);
+	ncch_header->hdr.romfs_offset = cpu_to_le32(ROMFS_OFFSET >> MEDIA_UNIT_SHIFT);
+	ncch_header->hdr.romfs_size = cpu_to_le32(ROMFS_SIZE >> MEDIA_UNIT_SHIFT);
+	ncch_header->hdr.romfs_hash_region_size = cpu_to_le32(ROMFS_HASH_SIZE >> MEDIA_UNIT_SHIFT);
+
+	// ExeFS header
+	// NOTE: The file hashes are stored in reverse order.
+	N3DS_ExeFS_Header_t *const exefs_header = reinterpret_cast<N3DS_ExeFS_Header_t*>(&ncch[EXEFS_OFFSET]);
+	memset(exefs_header, 0, sizeof(*exefs_header));
+	memcpy(exefs_header->files[0].name, ".code", 6);
+	exefs_header->files[0].offset = cpu_to_le32(0);
+	exefs_header->files[0].size = cpu_to_le32(CODE_SIZE);
+	sha256(exefs_header->hashes[ARRAY_SIZE(exefs_header->hashes) - 1], &ncch[CODE_OFFSET], CODE_SIZE);
+
+	// Hashes
+	sha256(ncch_header->hdr.exheader_hash, &ncch[EXHEADER_OFFSET], EXHEADER_SIZE);
+	sha256(ncch_header->hdr.exefs_uperblock_hash, &ncch[EXEFS_OFFSET], sizeof(N3DS_ExeFS_Header_t));
+	sha256(ncch_header->hdr.romfs_uperblock_hash, &ncch[ROMFS_OFFSET], ROMFS_HASH_SIZE);
+
+	if (!(bitMasks & N3DS_NCCH_BIT_MASK_NoCrypto)) {
+		// NOTE: The ExeFS header uses key 0 and .code uses key 1,
+		// but both keys are zero here.
+		encryptSection(ncch, EXHEADER_OFFSET, EXHEADER_SIZE, N3DS_NCCH_SECTION_EXHEADER);
+		encryptSection(ncch, EXEFS_OFFSET, ROMFS_OFFSET - EXEFS_OFFSET, N3DS_NCCH_SECTION_EXEFS);
+		encryptSection(ncch, ROMFS_OFFSET, ROMFS_SIZE, N3DS_NCCH_SECTION_ROMFS);
+	}
+	return ncch;
+}
+
+/**
+ * Run "Verify Contents" on an NCCH.
+ * @param ncch		[in] NCCH
+ * @param params	[out] ROM operation results
+ * @return doRomOp() return value
+ */
+int NCCHReaderVerifyTest::verifyContents(const vector<uint8_t> &ncch, RomData::RomOpParams &params)
+{
+	const IRpFilePtr memFile = std::make_shared<MemFile>(ncch.data(), ncch.size());
+	const RomDataPtr romData = RomDataFactory::create(memFile);
+	EXPECT_TRUE(romData && romData->isValid());
+	if (!romData) {
+		return -EIO;
+	}
+
+	// "Verify Contents" is the only ROM operation for NCCHs.
+	EXPECT_EQ(1U, romData->romOps().size());
+	return romData->doRomOp(0, &params);
+}
+
+/**
+ * Encrypted NCCH with the fixed key. All hashes are valid.
+ */
+TEST_F(NCCHReaderVerifyTest, verifyOK)
+{
+	RomData::RomOpParams params;
+	EXPECT_EQ(0, verifyContents(buildNcch(N3DS_NCCH_BIT_MASK_FixedCryptoKey), params));
+	EXPECT_EQ(0, params.status);
+	EXPECT_EQ("OK (1 contents, 4 hashes)", params.msg);
+}
+
+/**
+ * Unencrypted NCCH. All hashes are valid.
+ */
+TEST_F(NCCHReaderVerifyTest, verifyOK_NoCrypto)
+{
+	RomData::RomOpParams params;
+	EXPECT_EQ(0, verifyContents(buildNcch(N3DS_NCCH_BIT_MASK_NoCrypto), params));
+	EXPECT_EQ(0, params.status);
+	EXPECT_EQ("OK (1 contents, 4 hashes)", params.msg);
+}
+
+/**
+ * A byte in the ExeFS ".code" file is flipped.
+ */
+TEST_F(NCCHReaderVerifyTest, badExeFSFile)
+{
+	vector<uint8_t> ncch = buildNcch(N3DS_NCCH_BIT_MASK_FixedCryptoKey);
+	ncch[CODE_OFFSET + CODE_SIZE - 1] ^= 0x01;
+
+	RomData::RomOpParams params;
+	EXPECT_EQ(1, verifyContents(ncch, params));
+	EXPECT_EQ(1, params.status);
+	EXPECT_EQ("Partition 0: ExeFS file hashes: bad", params.msg);
+}
+
+/**
+ * A byte in the ExHeader is flipped.
+ */
+TEST_F(NCCHReaderVerifyTest, badExHeader)
+{
+	vector<uint8_t> ncch = buildNcch(N3DS_NCCH_BIT_MASK_FixedCryptoKey);
+	ncch[EXHEADER_OFFSET + EXHEADER_SIZE - 1] ^= 0x01;
+
+	RomData::RomOpParams params;
+	EXPECT_EQ(1, verifyContents(ncch, params));
+	EXPECT_EQ(1, params.status);
+	EXPECT_EQ("Partition 0: ExHeader hash: bad", params.msg);
+}
+
+/**
+ * A byte in the RomFS superblock is flipped.
+ * The rest of the RomFS isn't covered by the superblock hash.
+ */
+TEST_F(NCCHReaderVerifyTest, badRomFSSuperblock)
+{
+	vector<uint8_t> ncch = buildNcch(N3DS_NCCH_BIT_MASK_FixedCryptoKey);
+	ncch[ROMFS_OFFSET + ROMFS_HASH_SIZE] ^= 0x01;
+
+	RomData::RomOpParams params;
+	EXPECT_EQ(0, verifyContents(ncch, params));
+	EXPECT_EQ(0, params.status);
+
+	ncch[ROMFS_OFFSET + 0x10] ^= 0x01;
+	params = RomData::RomOpParams();
+	EXPECT_EQ(1, verifyContents(ncch, params));
+	EXPECT_EQ(1, params.status);
+	EXPECT_EQ("Partition 0: RomFS superblock hash: bad", params.msg);
+}
+
+/**
+ * Encrypted NCCH that needs the retail keys, which aren't available.
+ * Every hash is reported as NoKey instead of bad.
+ */
+TEST_F(NCCHReaderVerifyTest, encryptedNoKey)
+{
+	RomData::RomOpParams params;
+	EXPECT_EQ(1, verifyContents(buildNcch(0), params));
+	EXPECT_EQ(1, params.status);
+	EXPECT_EQ("Partition 0: "
+		"ExHeader hash: encryption key is not available; "
+		"ExeFS superblock hash: encryption key is not available; "
+		"ExeFS file hashes: encryption key is not available; "
+		"RomFS superblock hash: encryption key is not available", params.msg);
+}
+
+/**
+ * Benchmark: 512-byte reads, setting up the cipher for every read.
+ * This is how NCCHReader decrypted small reads without the keystream cache.
+ */
+TEST_F(NCCHReaderTest, smallReads_uncached_benchmark)
+{
+	unique_ptr<IAesCipher> cipher(AesCipherFactory::create());
+	ASSERT_TRUE(cipher != nullptr);
+	static const uint8_t zero_key[16] = {0};
+	ASSERT_EQ(0, cipher->setChainingMode(IAesCipher::ChainingMode::CTR));
+
+	static constexpr size_t CHUNK_SIZE = 512;
+	uint8_t buf[CHUNK_SIZE];
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned int pass = BENCHMARK_PASSES; pass > 0; pass--) {
+		for (uint32_t pos = 0; pos < CODE_SIZE; pos += CHUNK_SIZE) {
+			memcpy(buf, &ncch_enc[CODE_OFFSET + pos], CHUNK_SIZE);
+			cipher->setKey(zero_key, sizeof(zero_key));
+			u128_t ctr;
+			ctr.init_ctr(__swab64(TITLE_ID), N3DS_NCCH_SECTION_EXEFS, CODE_OFFSET - EXEFS_OFFSET + pos);
+			cipher->setIV(ctr.u8, sizeof(ctr.u8));
+			cipher->decrypt(buf, CHUNK_SIZE);
+		}
+	}
+	EXPECT_EQ(0, memcmp(&code_plain[CODE_SIZE - CHUNK_SIZE], buf, CHUNK_SIZE));
+	printThroughput("512-byte reads (cipher setup per read)",
+		static_cast<uint64_t>(CODE_SIZE) * BENCHMARK_PASSES, start);
+}
+
+/**
+ * Benchmark: 512-byte reads using NCCHReader.
+ */
+TEST_F(NCCHReaderTest, smallReads_benchmark)
+{
+	IRpFilePtr code = openCode();
+	ASSERT_TRUE(code != nullptr);
+
+	static constexpr size_t CHUNK_SIZE = 512;
+	uint8_t buf[CHUNK_SIZE];
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned int pass = BENCHMARK_PASSES; pass > 0; pass--) {
+		code->rewind();
+		for (uint32_t pos = 0; pos < CODE_SIZE; pos += CHUNK_SIZE) {
+			ASSERT_EQ(CHUNK_SIZE, code->read(buf, CHUNK_SIZE));
+		}
+	}
+	EXPECT_EQ(0, memcmp(&code_plain[CODE_SIZE - CHUNK_SIZE], buf, CHUNK_SIZE));
+	printThroughput("512-byte reads (NCCHReader)",
+		static_cast<uint64_t>(CODE_SIZE) * BENCHMARK_PASSES, start);
+}
+
+/**
+ * Benchmark: 1 MB reads using NCCHReader.
+ */
+TEST_F(NCCHReaderTest, largeReads_benchmark)
+{
+	IRpFilePtr code = openCode();
+	ASSERT_TRUE(code != nullptr);
+
+	static constexpr size_t CHUNK_SIZE = 1024U * 1024U;
+	vector<uint8_t> buf(CHUNK_SIZE);
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned int pass = BENCHMARK_PASSES; pass > 0; pass--) {
+		code->rewind();
+		for (uint32_t pos = 0; pos < CODE_SIZE; pos += CHUNK_SIZE) {
+			ASSERT_EQ(CHUNK_SIZE, code->read(buf.data(), CHUNK_SIZE));
+		}
+	}
+	EXPECT_EQ(0, memcmp(&code_plain[CODE_SIZE - CHUNK_SIZE], buf.data(), CHUNK_SIZE));
+	printThroughput("1 MB reads (NCCHReader)",
+		static_cast<uint64_t>(CODE_SIZE) * BENCHMARK_PASSES, start);
+}
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRomData test suite: NCCHReader tests.\n\n", stderr);
+	fprintf(stderr, "Benchmark passes: %u\n", LibRomData::Tests::NCCHReaderTest::BENCHMARK_PASSES);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,406 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata/tests)                 *
+ * SparseDiscReaderTest.cpp: SparseDiscReader access hint and cache test.  *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// SparseDiscReader
+#include "libromdata/disc/CisoGcnReader.hpp"
+#include "libromdata/disc/ciso_gcn.h"
+
+// Other rom-properties libraries
+#include "librpbyteswap/byteswap_rp.h"
+#include "librpfile/MemFile.hpp"
+using namespace LibRpBase;
+using namespace LibRpFile;
+
+// C includes (C++ namespace)
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <memory>
+#include <vector>
+using std::vector;
+
+namespace LibRomData { namespace Tests {
+
+/**
+ * MemFile wrapper that records advise() calls
+ * and counts readAt() calls.
+ */
+class AdviseFile final : public IRpFile
+{
+	public:
+		AdviseFile(const void *buf, size_t size)
+			: m_file(std::make_shared<MemFile>(buf, size))
+		{ }
+
+	public:
+		bool isOpen(void) const final { return m_file->isOpen(); }
+		void close(void) final { m_file->close(); }
+		size_t read(void *ptr, size_t size) final { return m_file->read(ptr, size); }
+		size_t write(const void *ptr, size_t size) final { return m_file->write(ptr, size); }
+		int seek(off64_t pos) final { return m_file->seek(pos); }
+		off64_t tell(void) final { return m_file->tell(); }
+		off64_t size(void) final { return m_file->size(); }
+		size_t readAt(off64_t pos, void *ptr, size_t size) final
+		{
+			readAtCount++;
+			return m_file->readAt(pos, ptr, size);
+		}
+
+		int advise(off64_t pos, off64_t size, AccessHint hint) final
+		{
+			calls.push_back({pos, size, hint});
+			return 0;
+		}
+
+	public:
+		struct AdviseCall {
+			off64_t pos;
+			off64_t size;
+			AccessHint hint;
+
+			bool operator==(const AdviseCall &other) const
+			{
+				return (pos == other.pos && size == other.size && hint == other.hint);
+			}
+		};
+		vector<AdviseCall> calls;
+		unsigned int readAtCount = 0;
+
+	private:
+		std::shared_ptr<MemFile> m_file;
+};
+
+inline ::std::ostream& operator<<(::std::ostream& os, const AdviseFile::AdviseCall &call) {
+	return os << "{0x" << std::hex << call.pos << ", 0x" << call.size << std::dec << ", " << (int)call.hint << '}';
+};
+
+class SparseDiscReaderTest : public ::testing::Test
+{
+	protected:
+		SparseDiscReaderTest() = default;
+
+	public:
+		void SetUp(void) final;
+
+	public:
+		// Synthetic CISO layout:
+		// - Logical blocks 0, 1, 3, and 4 are used.
+		// - Logical block 2 is empty, so block 3 is stored
+		//   directly after block 1.
+		static constexpr unsigned int BLOCK_SIZE = CISO_BLOCK_SIZE_MIN;
+		static constexpr unsigned int BLOCK_COUNT = 5;
+		static constexpr off64_t PHYS_BLOCK0 = CISO_HEADER_SIZE;
+
+		vector<uint8_t> m_ciso;
+		vector<uint8_t> m_expected;	// Logical disc contents
+		std::shared_ptr<AdviseFile> m_file;
+		std::unique_ptr<IDiscReader> m_reader;
+
+		/**
+		 * Get the SparseDiscReader.
+		 * @return SparseDiscReader
+		 */
+		SparseDiscReader *sparseReader(void)
+		{
+			return static_cast<SparseDiscReader*>(m_reader.get());
+		}
+
+		/**
+		 * Read data from the disc and compare it to the expected data.
+		 * @param pos Start position
+		 * @param size Size
+		 */
+		void checkRead(off64_t pos, size_t size)
+		{
+			vector<uint8_t> buf(size);
+			ASSERT_EQ(size, m_reader->seekAndRead(pos, buf.data(), size));
+			EXPECT_EQ(0, memcmp(&m_expected[static_cast<size_t>(pos)], buf.data(), size))
+				<< "pos == " << pos << ", size == " << size;
+		}
+
+		/**
+		 * Check the cache statistics.
+		 * @param hits Expected hits
+		 * @param misses Expected misses
+		 * @param bypass Expected bypassed reads
+		 */
+		void checkStats(uint64_t hits, uint64_t misses, uint64_t bypass)
+		{
+			const SparseDiscReader::CacheStats stats = sparseReader()->cacheStats();
+			EXPECT_EQ(hits, stats.hits);
+			EXPECT_EQ(misses, stats.misses);
+			EXPECT_EQ(bypass, stats.bypass);
+		}
+
+		/**
+		 * Create a CISO image with all blocks used.
+		 * @param blockSize Block size
+		 * @param blockCount Block count
+		 */
+		void createCiso(unsigned int blockSize, unsigned int blockCount);
+};
+
+void SparseDiscReaderTest::SetUp(void)
+{
+	m_ciso.assign(CISO_HEADER_SIZE + ((BLOCK_COUNT - 1) * BLOCK_SIZE), 0);
+	CISOHeader *const cisoHeader = reinterpret_cast<CISOHeader*>(m_ciso.data());
+	cisoHeader->magic = cpu_to_be32(CISO_MAGIC);
+	cisoHeader->block_size = cpu_to_le32(BLOCK_SIZE);
+	cisoHeader->map[0] = 1;
+	cisoHeader->map[1] = 1;
+	cisoHeader->map[3] = 1;
+	cisoHeader->map[4] = 1;
+
+	// Fill the used blocks with data based on the logical position.
+	m_expected.assign(BLOCK_COUNT * BLOCK_SIZE, 0);
+	for (unsigned int i = 0; i < m_expected.size(); i++) {
+		if (i / BLOCK_SIZE == 2)
+			continue;
+		m_expected[i] = static_cast<uint8_t>((i >> 8) ^ (i * 7));
+	}
+	memcpy(&m_ciso[PHYS_BLOCK0], &m_expected[0], 2 * BLOCK_SIZE);
+	memcpy(&m_ciso[PHYS_BLOCK0 + 2 * BLOCK_SIZE], &m_expected[3 * BLOCK_SIZE], 2 * BLOCK_SIZE);
+
+	m_file = std::make_shared<AdviseFile>(m_ciso.data(), m_ciso.size());
+	m_reader.reset(new CisoGcnReader(m_file));
+	ASSERT_TRUE(m_reader->isOpen());
+	ASSERT_EQ(static_cast<off64_t>(BLOCK_COUNT * BLOCK_SIZE), m_reader->size());
+	m_file->calls.clear();
+}
+
+/**
+ * Create a CISO image with all blocks used.
+ * @param blockSize Block size
+ * @param blockCount Block count
+ */
+void SparseDiscReaderTest::createCiso(unsigned int blockSize, unsigned int blockCount)
+{
+	m_reader.reset();
+	m_ciso.assign(CISO_HEADER_SIZE + (blockCount * blockSize), 0);
+	CISOHeader *const cisoHeader = reinterpret_cast<CISOHeader*>(m_ciso.data());
+	cisoHeader->magic = cpu_to_be32(CISO_MAGIC);
+	cisoHeader->block_size = cpu_to_le32(blockSize);
+	memset(cisoHeader->map, 1, blockCount);
+
+	m_expected.resize(blockCount * blockSize);
+	for (unsigned int i = 0; i < m_expected.size(); i++) {
+		m_expected[i] = static_cast<uint8_t>((i >> 16) ^ (i >> 8) ^ (i * 7));
+	}
+	memcpy(&m_ciso[CISO_HEADER_SIZE], m_expected.data(), m_expected.size());
+
+	m_file = std::make_shared<AdviseFile>(m_ciso.data(), m_ciso.size());
+	m_reader.reset(new CisoGcnReader(m_file));
+	ASSERT_TRUE(m_reader->isOpen());
+}
+
+/**
+ * Access pattern hints apply to the entire file.
+ */
+TEST_F(SparseDiscReaderTest, accessPattern)
+{
+	EXPECT_EQ(0, m_reader->advise(BLOCK_SIZE, BLOCK_SIZE, IRpFile::AH_SEQUENTIAL));
+	EXPECT_EQ(0, m_reader->advise(0, 0, IRpFile::AH_RANDOM));
+
+	const vector<AdviseFile::AdviseCall> expected = {
+		{0, 0, IRpFile::AH_SEQUENTIAL},
+		{0, 0, IRpFile::AH_RANDOM},
+	};
+	EXPECT_EQ(expected, m_file->calls);
+}
+
+/**
+ * Ranges are converted to physical blocks, and contiguous blocks are combined.
+ */
+TEST_F(SparseDiscReaderTest, willNeedRange)
+{
+	// Entire disc: Blocks 0, 1, 3, and 4 are stored contiguously.
+	EXPECT_EQ(0, m_reader->advise(0, 0, IRpFile::AH_WILLNEED));
+
+	// Part of block 1.
+	EXPECT_EQ(0, m_reader->advise(BLOCK_SIZE + 0x100, 0x200, IRpFile::AH_DONTNEED));
+
+	// Empty block only.
+	EXPECT_EQ(0, m_reader->advise(2 * BLOCK_SIZE, BLOCK_SIZE, IRpFile::AH_WILLNEED));
+
+	// End of block 1, block 2 (empty), and the start of block 3.
+	EXPECT_EQ(0, m_reader->advise(2 * BLOCK_SIZE - 0x100, BLOCK_SIZE + 0x200, IRpFile::AH_WILLNEED));
+
+	// Past the end of the disc.
+	EXPECT_EQ(0, m_reader->advise(BLOCK_COUNT * BLOCK_SIZE, 0x100, IRpFile::AH_WILLNEED));
+
+	const vector<AdviseFile::AdviseCall> expected = {
+		{PHYS_BLOCK0, 4 * BLOCK_SIZE, IRpFile::AH_WILLNEED},
+		{PHYS_BLOCK0 + BLOCK_SIZE + 0x100, 0x200, IRpFile::AH_DONTNEED},
+		{PHYS_BLOCK0 + 2 * BLOCK_SIZE - 0x100, 0x200, IRpFile::AH_WILLNEED},
+	};
+	EXPECT_EQ(expected, m_file->calls);
+}
+
+/**
+ * Invalid parameters.
+ */
+TEST_F(SparseDiscReaderTest, invalidParams)
+{
+	EXPECT_EQ(-EINVAL, m_reader->advise(-1, 0, IRpFile::AH_WILLNEED));
+	EXPECT_EQ(-EINVAL, m_reader->advise(0, -1, IRpFile::AH_WILLNEED));
+	EXPECT_TRUE(m_file->calls.empty());
+}
+
+/**
+ * Cache hits, misses, and bypassed reads.
+ */
+TEST_F(SparseDiscReaderTest, cacheStats)
+{
+	m_file->readAtCount = 0;
+
+	// Partial line: Miss, then hit.
+	checkRead(0x100, 16);
+	checkStats(0, 1, 0);
+	EXPECT_EQ(1U, m_file->readAtCount);
+	checkRead(0x200, 16);
+	checkStats(1, 1, 0);
+	EXPECT_EQ(1U, m_file->readAtCount);
+
+	// Full line that's already cached: Copied from the cache.
+	checkRead(0, BLOCK_SIZE);
+	checkStats(2, 1, 0);
+	EXPECT_EQ(1U, m_file->readAtCount);
+
+	// Full line that isn't cached: Bypasses the cache.
+	checkRead(3 * BLOCK_SIZE, BLOCK_SIZE);
+	checkStats(2, 1, 1);
+	EXPECT_EQ(2U, m_file->readAtCount);
+
+	// Multiple full lines: Block 0 is cached; blocks 1 and 2 are read directly.
+	// Block 2 is empty, so it doesn't read the file.
+	checkRead(0, 3 * BLOCK_SIZE);
+	checkStats(3, 1, 3);
+	EXPECT_EQ(3U, m_file->readAtCount);
+
+	// Full lines that bypassed the cache weren't cached.
+	checkRead(3 * BLOCK_SIZE + 0x100, 16);
+	checkStats(3, 2, 3);
+	EXPECT_EQ(4U, m_file->readAtCount);
+
+	sparseReader()->resetCacheStats();
+	checkStats(0, 0, 0);
+}
+
+/**
+ * The least-recently used line should be evicted.
+ */
+TEST_F(SparseDiscReaderTest, cacheEvictionOrder)
+{
+	// 1 MB blocks are split into 64 KB lines,
+	// so a 1 MB cache has 16 lines.
+	static constexpr unsigned int BIG_BLOCK_SIZE = 1024U * 1024U;
+	static constexpr unsigned int LINE_SIZE = 64U * 1024U;
+	static constexpr unsigned int LINE_COUNT = 16;
+	ASSERT_NO_FATAL_FAILURE(createCiso(BIG_BLOCK_SIZE, 2));
+	sparseReader()->setCacheSize(1);
+
+	// Fill the cache.
+	for (unsigned int i = 0; i < LINE_COUNT; i++) {
+		checkRead(i * LINE_SIZE + 8, 16);
+	}
+	checkStats(0, LINE_COUNT, 0);
+
+	// Use line 0 again, so line 1 is the LRU line.
+	checkRead(32, 16);
+	checkStats(1, LINE_COUNT, 0);
+
+	// Load line 16. This should evict line 1.
+	checkRead(LINE_COUNT * LINE_SIZE + 8, 16);
+	checkStats(1, LINE_COUNT + 1, 0);
+
+	// Lines 0 and 2 should still be cached.
+	checkRead(64, 16);
+	checkRead(2 * LINE_SIZE + 64, 16);
+	checkStats(3, LINE_COUNT + 1, 0);
+
+	// Line 1 was evicted. Reloading it evicts line 3.
+	checkRead(LINE_SIZE + 64, 16);
+	checkStats(3, LINE_COUNT + 2, 0);
+	checkRead(3 * LINE_SIZE + 64, 16);
+	checkStats(3, LINE_COUNT + 3, 0);
+}
+
+/**
+ * setCacheSize(0) disables the cache.
+ */
+TEST_F(SparseDiscReaderTest, cacheDisabled)
+{
+	checkRead(0x100, 16);
+	checkStats(0, 1, 0);
+
+	// Disabling the cache discards all cached lines.
+	sparseReader()->setCacheSize(0);
+	sparseReader()->resetCacheStats();
+	m_file->readAtCount = 0;
+
+	// Every read goes to the underlying file, and nothing is counted.
+	checkRead(0x100, 16);
+	checkRead(0x100, 16);
+	checkRead(BLOCK_SIZE - 8, 16);
+	checkRead(0, 2 * BLOCK_SIZE);
+	checkStats(0, 0, 0);
+	EXPECT_EQ(6U, m_file->readAtCount);
+
+	// Re-enabling the cache.
+	sparseReader()->setCacheSize(SparseDiscReader::DEFAULT_CACHE_SIZE_MB);
+	checkRead(0x100, 16);
+	checkRead(0x100, 16);
+	checkStats(1, 1, 0);
+}
+
+/**
+ * Reads that start and/or end partway through a line.
+ */
+TEST_F(SparseDiscReaderTest, partialLineReads)
+{
+	// Across a line boundary: Two misses.
+	checkRead(BLOCK_SIZE - 8, 16);
+	checkStats(0, 2, 0);
+
+	// Unaligned at both ends, with full lines in the middle.
+	// Block 1 is already cached, blocks 2 and 3 are read directly,
+	// and block 4 is cached.
+	checkRead(BLOCK_SIZE + 0x100, 3 * BLOCK_SIZE);
+	checkStats(1, 3, 2);
+
+	// Partial empty block. It wasn't cached by the previous read.
+	checkRead(2 * BLOCK_SIZE + 0x100, 0x100);
+	checkStats(1, 4, 2);
+
+	// End of the disc.
+	checkRead((BLOCK_COUNT * BLOCK_SIZE) - 16, 16);
+	checkStats(2, 4, 2);
+	uint8_t buf[32];
+	EXPECT_EQ(16U, m_reader->seekAndRead((BLOCK_COUNT * BLOCK_SIZE) - 16, buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(&m_expected[(BLOCK_COUNT * BLOCK_SIZE) - 16], buf, 16));
+}
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRomData test suite: SparseDiscReader tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
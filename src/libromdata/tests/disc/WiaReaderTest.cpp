@@ -0,0 +1,513 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata/tests)                 *
+ * WiaReaderTest.cpp: WiaReader class test.                                *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// WiaReader
+#include "libromdata/disc/WiaReader.hpp"
+#include "libromdata/disc/wia_structs.h"
+
+// Other rom-properties libraries
+#include "librpbyteswap/byteswap_rp.h"
+#include "librpfile/MemFile.hpp"
+using namespace LibRpBase;
+using namespace LibRpFile;
+
+// C includes (C++ namespace)
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <memory>
+#include <vector>
+using std::vector;
+
+namespace LibRomData { namespace Tests {
+
+/**
+ * MemFile wrapper that counts readAt() calls.
+ */
+class CountingFile final : public IRpFile
+{
+	public:
+		CountingFile(const void *buf, size_t size)
+			: readAtCount(0)
+			, m_file(std::make_shared<MemFile>(buf, size))
+		{ }
+
+	public:
+		bool isOpen(void) const final { return m_file->isOpen(); }
+		void close(void) final { m_file->close(); }
+		size_t read(void *ptr, size_t size) final { return m_file->read(ptr, size); }
+		size_t write(const void *ptr, size_t size) final { return m_file->write(ptr, size); }
+		int seek(off64_t pos) final { return m_file->seek(pos); }
+		off64_t tell(void) final { return m_file->tell(); }
+		off64_t size(void) final { return m_file->size(); }
+
+		size_t readAt(off64_t pos, void *ptr, size_t size) final
+		{
+			readAtCount++;
+			return m_file->readAt(pos, ptr, size);
+		}
+
+	public:
+		unsigned int readAtCount;
+
+	private:
+		std::shared_ptr<MemFile> m_file;
+};
+
+class WiaReaderTest : public ::testing::Test
+{
+	protected:
+		WiaReaderTest() = default;
+
+	public:
+		static void SetUpTestSuite(void);
+		static void TearDownTestSuite(void);
+
+	public:
+		// Wii sector layout
+		static constexpr unsigned int SECTOR_SIZE = 0x8000;
+		static constexpr unsigned int SECTOR_HASH_SIZE = 0x400;
+		static constexpr unsigned int SECTOR_DATA_SIZE = SECTOR_SIZE - SECTOR_HASH_SIZE;
+
+		// Synthetic WIA image with NONE compression:
+		// - GameCube disc with 32 KB groups.
+		// - One raw data entry covering the entire disc.
+		// - Groups 0 and 1 are stored as-is; group 2 is all zeroes.
+		static constexpr unsigned int NONE_CHUNK_SIZE = 0x8000;
+		static constexpr unsigned int NONE_GROUP_COUNT = 3;
+		static vector<uint8_t> isoNone;
+		static vector<uint8_t> wiaNone;
+
+		// Synthetic WIA image with PURGE compression:
+		// - Wii disc with 4 MB groups, so only two groups are cached.
+		// - Partition data starts at sector 2, and has three groups.
+		// - Each group has two exception lists, one per Wii group.
+		//   Group 0 has an exception in each list.
+		static constexpr unsigned int PURGE_CHUNK_SIZE = 0x400000;
+		static constexpr unsigned int PURGE_SECTORS_PER_GROUP = PURGE_CHUNK_SIZE / SECTOR_SIZE;
+		static constexpr unsigned int PURGE_GROUP_COUNT = 3;
+		static constexpr uint32_t PART_FIRST_SECTOR = 2;
+		static constexpr unsigned int PURGE_SEGMENT_SIZE = 0x200;
+		static vector<uint8_t> wiaPurge;
+
+		// Hash exceptions in group 0.
+		struct TestException {
+			unsigned int sector;	// Sector index within the group
+			unsigned int offset;	// Offset within the sector's hash area
+			uint8_t hash[20];
+		};
+		static const TestException exceptions[2];
+
+		/**
+		 * Build a WIA image.
+		 * Group offsets and table locations are filled in automatically.
+		 * @param disc		[in] WIA_Disc (host-endian) with disc_type, compression, chunk_size, and dhead set
+		 * @param iso_file_size	[in] Size of the original ISO image
+		 * @param partitions	[in] Partition entries (big-endian)
+		 * @param rawData	[in] Raw data entries (big-endian)
+		 * @param groups	[in] Stored group data (empty == all zeroes)
+		 * @return WIA image
+		 */
+		static vector<uint8_t> buildWia(WIA_Disc disc, uint64_t iso_file_size,
+			const vector<WIA_Partition> &partitions, const vector<WIA_RawData> &rawData,
+			const vector<vector<uint8_t> > &groups);
+
+		/**
+		 * Build a PURGE partition data group.
+		 * @param excs		[in] Hash exceptions for each list
+		 * @param seg_offset	[in] Offset of the single PURGE segment
+		 * @param fill		[in] Fill byte for the segment
+		 * @return Stored group data
+		 */
+		static vector<uint8_t> buildPurgeGroup(const vector<const TestException*> excs[2],
+			uint32_t seg_offset, uint8_t fill);
+
+		/**
+		 * Open a WIA image.
+		 * @param data WIA image
+		 * @param pFile [out,opt] CountingFile used by the reader
+		 * @return WiaReader
+		 */
+		static WiaReaderPtr openWia(const vector<uint8_t> &data, std::shared_ptr<CountingFile> *pFile = nullptr);
+
+		/**
+		 * Get the disc offset of a partition sector's data area.
+		 * @param group	[in] Group index within the partition
+		 * @param sector	[in] Sector index within the group
+		 * @return Disc offset
+		 */
+		static inline off64_t partSectorOffset(unsigned int group, unsigned int sector)
+		{
+			return static_cast<off64_t>(PART_FIRST_SECTOR + (group * PURGE_SECTORS_PER_GROUP) + sector) * SECTOR_SIZE;
+		}
+};
+
+vector<uint8_t> WiaReaderTest::isoNone;
+vector<uint8_t> WiaReaderTest::wiaNone;
+vector<uint8_t> WiaReaderTest::wiaPurge;
+
+const WiaReaderTest::TestException WiaReaderTest::exceptions[2] = {
+	// List 0: H0 hash in sector 5.
+	{5, 0x010, {0x11,0x11,0x11,0x11,0x11,0x11,0x11,0x11,0x11,0x11,
+	            0x11,0x11,0x11,0x11,0x11,0x11,0x11,0x11,0x11,0x11}},
+	// List 1: H1 hash in sector 67. (sector 3 of the second Wii group)
+	{67, 0x280, {0x22,0x33,0x22,0x33,0x22,0x33,0x22,0x33,0x22,0x33,
+	             0x22,0x33,0x22,0x33,0x22,0x33,0x22,0x33,0x22,0x33}},
+};
+
+/**
+ * Build a WIA image.
+ * Group offsets and table locations are filled in automatically.
+ * @param disc		[in] WIA_Disc (host-endian) with disc_type, compression, chunk_size, and dhead set
+ * @param iso_file_size	[in] Size of the original ISO image
+ * @param partitions	[in] Partition entries (big-endian)
+ * @param rawData	[in] Raw data entries (big-endian)
+ * @param groups	[in] Stored group data (empty == all zeroes)
+ * @return WIA image
+ */
+vector<uint8_t> WiaReaderTest::buildWia(WIA_Disc disc, uint64_t iso_file_size,
+	const vector<WIA_Partition> &partitions, const vector<WIA_RawData> &rawData,
+	const vector<vector<uint8_t> > &groups)
+{
+	// Tables are stored after the headers.
+	// PURGE tables are stored as a single segment plus the SHA-1 hash.
+	const bool isPurge = (disc.compression == WIA_COMPRESSION_PURGE);
+	vector<uint8_t> wia(sizeof(WIA_FileHeader) + sizeof(WIA_Disc));
+
+	auto appendTable = [&wia, isPurge](const void *data, size_t size, uint32_t *pStoredSize) -> uint64_t {
+		const uint64_t offset = wia.size();
+		const uint8_t *const data8 = static_cast<const uint8_t*>(data);
+		if (isPurge && size > 0) {
+			const uint32_t seg[2] = {0, cpu_to_be32(static_cast<uint32_t>(size))};
+			wia.insert(wia.end(), reinterpret_cast<const uint8_t*>(seg), reinterpret_cast<const uint8_t*>(seg) + sizeof(seg));
+			wia.insert(wia.end(), data8, data8 + size);
+			wia.insert(wia.end(), 20, 0);	// SHA-1 (not checked)
+		} else {
+			wia.insert(wia.end(), data8, data8 + size);
+		}
+		*pStoredSize = static_cast<uint32_t>(wia.size() - offset);
+		return offset;
+	};
+
+	// Partition table (never compressed)
+	disc.n_part = static_cast<uint32_t>(partitions.size());
+	disc.part_t_size = sizeof(WIA_Partition);
+	disc.part_off = wia.size();
+	wia.insert(wia.end(), reinterpret_cast<const uint8_t*>(partitions.data()),
+		reinterpret_cast<const uint8_t*>(partitions.data() + partitions.size()));
+
+	// Raw data table
+	disc.n_raw_data = static_cast<uint32_t>(rawData.size());
+	uint32_t storedSize;
+	disc.raw_data_off = appendTable(rawData.data(), rawData.size() * sizeof(WIA_RawData), &storedSize);
+	disc.raw_data_size = storedSize;
+
+	// Group data
+	vector<WIA_Group> groupTbl(groups.size());
+	for (size_t i = 0; i < groups.size(); i++) {
+		if (groups[i].empty()) {
+			// All zeroes.
+			groupTbl[i].data_off4 = 0;
+			groupTbl[i].data_size = 0;
+			continue;
+		}
+		wia.resize((wia.size() + 3) & ~3);
+		groupTbl[i].data_off4 = cpu_to_be32(static_cast<uint32_t>(wia.size() >> 2));
+		groupTbl[i].data_size = cpu_to_be32(static_cast<uint32_t>(groups[i].size()));
+		wia.insert(wia.end(), groups[i].begin(), groups[i].end());
+	}
+
+	// Group table
+	disc.n_groups = static_cast<uint32_t>(groupTbl.size());
+	disc.group_off = appendTable(groupTbl.data(), groupTbl.size() * sizeof(WIA_Group), &storedSize);
+	disc.group_size = storedSize;
+
+	// File header
+	WIA_FileHeader *const hdr = reinterpret_cast<WIA_FileHeader*>(wia.data());
+	hdr->magic = cpu_to_be32(WIA_MAGIC);
+	hdr->version = cpu_to_be32(WIA_VERSION);
+	hdr->version_compatible = cpu_to_be32(WIA_VERSION_READ_COMPATIBLE);
+	hdr->disc_size = cpu_to_be32(sizeof(WIA_Disc));
+	hdr->iso_file_size = cpu_to_be64(iso_file_size);
+	hdr->wia_file_size = cpu_to_be64(wia.size());
+
+	// Disc struct
+	disc.disc_type		= cpu_to_be32(disc.disc_type);
+	disc.compression	= cpu_to_be32(disc.compression);
+	disc.chunk_size		= cpu_to_be32(disc.chunk_size);
+	disc.n_part		= cpu_to_be32(disc.n_part);
+	disc.part_t_size	= cpu_to_be32(disc.part_t_size);
+	disc.part_off		= cpu_to_be64(disc.part_off);
+	disc.n_raw_data		= cpu_to_be32(disc.n_raw_data);
+	disc.raw_data_off	= cpu_to_be64(disc.raw_data_off);
+	disc.raw_data_size	= cpu_to_be32(disc.raw_data_size);
+	disc.n_groups		= cpu_to_be32(disc.n_groups);
+	disc.group_off		= cpu_to_be64(disc.group_off);
+	disc.group_size		= cpu_to_be32(disc.group_size);
+	memcpy(&wia[sizeof(WIA_FileHeader)], &disc, sizeof(disc));
+	return wia;
+}
+
+/**
+ * Build a PURGE partition data group.
+ * @param excs		[in] Hash exceptions for each list
+ * @param seg_offset	[in] Offset of the single PURGE segment
+ * @param fill		[in] Fill byte for the segment
+ * @return Stored group data
+ */
+vector<uint8_t> WiaReaderTest::buildPurgeGroup(const vector<const TestException*> excs[2],
+	uint32_t seg_offset, uint8_t fill)
+{
+	vector<uint8_t> group;
+
+	// Exception lists
+	// NOTE: Exception offsets are relative to the hash areas
+	// covered by each list, i.e. 64 sectors.
+	for (unsigned int i = 0; i < 2; i++) {
+		const uint16_t count = cpu_to_be16(static_cast<uint16_t>(excs[i].size()));
+		group.insert(group.end(), reinterpret_cast<const uint8_t*>(&count),
+			reinterpret_cast<const uint8_t*>(&count) + sizeof(count));
+		for (const TestException *exc : excs[i]) {
+			WIA_Exception wiaExc;
+			wiaExc.offset = cpu_to_be16(static_cast<uint16_t>(((exc->sector % 64) * SECTOR_HASH_SIZE) + exc->offset));
+			memcpy(wiaExc.hash, exc->hash, sizeof(wiaExc.hash));
+			group.insert(group.end(), reinterpret_cast<const uint8_t*>(&wiaExc),
+				reinterpret_cast<const uint8_t*>(&wiaExc) + sizeof(wiaExc));
+		}
+	}
+	// Uncompressed exception lists are padded to a multiple of 4 bytes.
+	group.resize((group.size() + 3) & ~3);
+
+	// PURGE data: One segment, then the SHA-1 hash.
+	const uint32_t seg[2] = {cpu_to_be32(seg_offset), cpu_to_be32(PURGE_SEGMENT_SIZE)};
+	group.insert(group.end(), reinterpret_cast<const uint8_t*>(seg), reinterpret_cast<const uint8_t*>(seg) + sizeof(seg));
+	group.insert(group.end(), PURGE_SEGMENT_SIZE, fill);
+	group.insert(group.end(), 20, 0);	// SHA-1 (not checked)
+	return group;
+}
+
+void WiaReaderTest::SetUpTestSuite(void)
+{
+	// NONE image: GameCube disc with a byte pattern in groups 0 and 1.
+	isoNone.resize(NONE_GROUP_COUNT * NONE_CHUNK_SIZE);
+	for (size_t i = 0; i < (NONE_GROUP_COUNT - 1) * NONE_CHUNK_SIZE; i++) {
+		isoNone[i] = static_cast<uint8_t>((i * 7) + (i >> 8));
+	}
+	memset(&isoNone[(NONE_GROUP_COUNT - 1) * NONE_CHUNK_SIZE], 0, NONE_CHUNK_SIZE);
+	{
+		WIA_Disc disc;
+		memset(&disc, 0, sizeof(disc));
+		disc.disc_type = WIA_DISC_TYPE_GCN;
+		disc.compression = WIA_COMPRESSION_NONE;
+		disc.chunk_size = NONE_CHUNK_SIZE;
+		memcpy(disc.dhead, isoNone.data(), sizeof(disc.dhead));
+
+		// NOTE: Raw data starts after dhead, but groups start
+		// on a sector boundary, so group 0 includes dhead.
+		vector<WIA_RawData> rawData(1);
+		rawData[0].raw_data_off = cpu_to_be64(sizeof(disc.dhead));
+		rawData[0].raw_data_size = cpu_to_be64(isoNone.size() - sizeof(disc.dhead));
+		rawData[0].group_index = 0;
+		rawData[0].n_groups = cpu_to_be32(NONE_GROUP_COUNT);
+
+		vector<vector<uint8_t> > groups(NONE_GROUP_COUNT);
+		for (unsigned int i = 0; i < NONE_GROUP_COUNT - 1; i++) {
+			groups[i].assign(isoNone.begin() + (i * NONE_CHUNK_SIZE),
+				isoNone.begin() + ((i + 1) * NONE_CHUNK_SIZE));
+		}
+		wiaNone = buildWia(disc, isoNone.size(), vector<WIA_Partition>(), rawData, groups);
+	}
+
+	// PURGE image: Wii disc with one partition.
+	{
+		WIA_Disc disc;
+		memset(&disc, 0, sizeof(disc));
+		disc.disc_type = WIA_DISC_TYPE_WII;
+		disc.compression = WIA_COMPRESSION_PURGE;
+		disc.chunk_size = PURGE_CHUNK_SIZE;
+		disc.dhead[0] = 'R';
+
+		vector<WIA_Partition> partitions(1);
+		memset(partitions.data(), 0, sizeof(WIA_Partition));
+		WIA_PartitionData &pd = partitions[0].pd[0];
+		pd.first_sector = cpu_to_be32(PART_FIRST_SECTOR);
+		pd.n_sectors = cpu_to_be32(PURGE_GROUP_COUNT * PURGE_SECTORS_PER_GROUP);
+		pd.group_index = 0;
+		pd.n_groups = cpu_to_be32(PURGE_GROUP_COUNT);
+
+		// Each group has one PURGE segment at a different offset.
+		vector<vector<uint8_t> > groups(PURGE_GROUP_COUNT);
+		for (unsigned int i = 0; i < PURGE_GROUP_COUNT; i++) {
+			vector<const TestException*> excs[2];
+			if (i == 0) {
+				excs[0].push_back(&exceptions[0]);
+				excs[1].push_back(&exceptions[1]);
+			}
+			groups[i] = buildPurgeGroup(excs, 0x100 * (i + 1), static_cast<uint8_t>(0xA0 + i));
+		}
+
+		const uint64_t iso_file_size = static_cast<uint64_t>(PART_FIRST_SECTOR +
+			(PURGE_GROUP_COUNT * PURGE_SECTORS_PER_GROUP)) * SECTOR_SIZE;
+		wiaPurge = buildWia(disc, iso_file_size, partitions, vector<WIA_RawData>(), groups);
+	}
+}
+
+void WiaReaderTest::TearDownTestSuite(void)
+{
+	isoNone.clear();
+	isoNone.shrink_to_fit();
+	wiaNone.clear();
+	wiaNone.shrink_to_fit();
+	wiaPurge.clear();
+	wiaPurge.shrink_to_fit();
+}
+
+/**
+ * Open a WIA image.
+ * @param data WIA image
+ * @param pFile [out,opt] CountingFile used by the reader
+ * @return WiaReader
+ */
+WiaReaderPtr WiaReaderTest::openWia(const vector<uint8_t> &data, std::shared_ptr<CountingFile> *pFile)
+{
+	std::shared_ptr<CountingFile> file = std::make_shared<CountingFile>(data.data(), data.size());
+	if (pFile) {
+		*pFile = file;
+	}
+	return std::make_shared<WiaReader>(file);
+}
+
+/**
+ * Read the entire NONE image.
+ */
+TEST_F(WiaReaderTest, noneReadAll)
+{
+	WiaReaderPtr wiaReader = openWia(wiaNone);
+	ASSERT_TRUE(wiaReader->isOpen());
+	ASSERT_EQ(static_cast<off64_t>(isoNone.size()), static_cast<IDiscReader*>(wiaReader.get())->size());
+
+	vector<uint8_t> buf(isoNone.size());
+	ASSERT_EQ(buf.size(), wiaReader->seekAndRead(0, buf.data(), buf.size()));
+	EXPECT_EQ(isoNone, buf);
+}
+
+/**
+ * Read across group boundaries in the NONE image.
+ * This includes the all-zeroes group.
+ */
+TEST_F(WiaReaderTest, noneReadSpansGroups)
+{
+	WiaReaderPtr wiaReader = openWia(wiaNone);
+	ASSERT_TRUE(wiaReader->isOpen());
+
+	for (unsigned int i = 1; i < NONE_GROUP_COUNT; i++) {
+		const off64_t pos = (i * NONE_CHUNK_SIZE) - 0x100;
+		uint8_t buf[0x300];
+		ASSERT_EQ(sizeof(buf), wiaReader->seekAndRead(pos, buf, sizeof(buf))) << "group boundary == " << i;
+		EXPECT_EQ(0, memcmp(&isoNone[pos], buf, sizeof(buf))) << "group boundary == " << i;
+	}
+}
+
+/**
+ * Read partition data from the PURGE image.
+ * Anything outside of the PURGE segment should be zero.
+ */
+TEST_F(WiaReaderTest, purgeReadData)
+{
+	WiaReaderPtr wiaReader = openWia(wiaPurge);
+	ASSERT_TRUE(wiaReader->isOpen());
+
+	// The segment is at 0x100 in group 0, i.e. sector 0's data area.
+	uint8_t buf[0x400];
+	ASSERT_EQ(sizeof(buf), wiaReader->seekAndRead(partSectorOffset(0, 0) + SECTOR_HASH_SIZE, buf, sizeof(buf)));
+	for (unsigned int i = 0; i < sizeof(buf); i++) {
+		const uint8_t expected = (i >= 0x100 && i < 0x100 + PURGE_SEGMENT_SIZE) ? 0xA0 : 0x00;
+		ASSERT_EQ(expected, buf[i]) << "i == " << i;
+	}
+
+	// Group 2's segment is at 0x300.
+	ASSERT_EQ(sizeof(buf), wiaReader->seekAndRead(partSectorOffset(2, 0) + SECTOR_HASH_SIZE, buf, sizeof(buf)));
+	for (unsigned int i = 0; i < sizeof(buf); i++) {
+		const uint8_t expected = (i >= 0x300 && i < 0x300 + PURGE_SEGMENT_SIZE) ? 0xA2 : 0x00;
+		ASSERT_EQ(expected, buf[i]) << "i == " << i;
+	}
+}
+
+/**
+ * Hash exceptions in the PURGE image should replace
+ * the calculated hashes, including in the second list.
+ */
+TEST_F(WiaReaderTest, purgeHashExceptions)
+{
+	WiaReaderPtr wiaReader = openWia(wiaPurge);
+	ASSERT_TRUE(wiaReader->isOpen());
+
+	for (const TestException &exc : exceptions) {
+		uint8_t buf[20];
+		const off64_t pos = partSectorOffset(0, exc.sector) + exc.offset;
+		ASSERT_EQ(sizeof(buf), wiaReader->seekAndRead(pos, buf, sizeof(buf))) << "sector == " << exc.sector;
+		EXPECT_EQ(0, memcmp(exc.hash, buf, sizeof(buf))) << "sector == " << exc.sector;
+	}
+
+	// The same hash in another sector isn't replaced.
+	uint8_t buf[20];
+	ASSERT_EQ(sizeof(buf), wiaReader->seekAndRead(partSectorOffset(0, 6) + exceptions[0].offset, buf, sizeof(buf)));
+	EXPECT_NE(0, memcmp(exceptions[0].hash, buf, sizeof(buf)));
+}
+
+/**
+ * The group cache should evict the least-recently used group.
+ * With 4 MB groups, only two groups are cached.
+ */
+TEST_F(WiaReaderTest, groupCacheLru)
+{
+	std::shared_ptr<CountingFile> file;
+	WiaReaderPtr wiaReader = openWia(wiaPurge, &file);
+	ASSERT_TRUE(wiaReader->isOpen());
+
+	// Group, and whether or not it should be read from the file.
+	static const struct {
+		unsigned int group;
+		bool miss;
+	} reads[] = {
+		{0, true},
+		{1, true},
+		{0, false},
+		{2, true},	// evicts group 1
+		{0, false},
+		{1, true},	// evicts group 2
+		{2, true},
+	};
+
+	for (const auto &rd : reads) {
+		const unsigned int prevCount = file->readAtCount;
+		uint8_t buf[16];
+		ASSERT_EQ(sizeof(buf), wiaReader->seekAndRead(partSectorOffset(rd.group, 0) + SECTOR_HASH_SIZE, buf, sizeof(buf)));
+		EXPECT_EQ(rd.miss ? 1U : 0U, file->readAtCount - prevCount) << "group == " << rd.group;
+	}
+}
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRomData test suite: WiaReader tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
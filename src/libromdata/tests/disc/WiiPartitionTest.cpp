@@ -0,0 +1,606 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (libromdata/tests)                 *
+ * WiiPartitionTest.cpp: WiiPartition class test.                          *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// WiiPartition
+#include "libromdata/disc/WiiPartition.hpp"
+#include "libromdata/Console/gcn_structs.h"
+#include "libromdata/Console/wii_structs.h"
+
+// Other rom-properties libraries
+#include "librpbase/crypto/Hash.hpp"
+#include "librpbase/disc/CBCReader.hpp"
+#include "librpbyteswap/byteswap_rp.h"
+#include "librpfile/MemFile.hpp"
+using namespace LibRpBase;
+using namespace LibRpFile;
+
+// C includes (C++ namespace)
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <algorithm>
+#include <memory>
+#include <vector>
+using std::vector;
+
+namespace LibRomData { namespace Tests {
+
+class WiiPartitionTest : public ::testing::Test
+{
+	protected:
+		WiiPartitionTest() = default;
+
+	public:
+		static void SetUpTestSuite(void);
+		static void TearDownTestSuite(void);
+
+	public:
+		// Wii sector layout
+		static constexpr unsigned int SECTOR_SIZE = 0x8000;
+		static constexpr unsigned int SECTOR_HASH_SIZE = 0x400;
+		static constexpr unsigned int SECTOR_DATA_SIZE = SECTOR_SIZE - SECTOR_HASH_SIZE;
+		static constexpr unsigned int H0_OFFSET = 0x000;
+		static constexpr unsigned int H1_OFFSET = 0x280;
+		static constexpr unsigned int H2_OFFSET = 0x340;
+		static constexpr unsigned int H0_TABLE_SIZE = 31 * 20;
+		static constexpr unsigned int H1_TABLE_SIZE = 8 * 20;
+		static constexpr unsigned int H2_TABLE_SIZE = 8 * 20;
+		static constexpr unsigned int SECTORS_PER_SUBGROUP = 8;
+		static constexpr unsigned int SECTORS_PER_GROUP = 64;
+
+		// Synthetic unencrypted partition with hashes: (NASOS)
+		// - Partition header at 0, with a TMD that has one content entry.
+		// - H3 table at 0x8000.
+		// - Data starts at 0x20000.
+		// - More than one verification batch (512 sectors),
+		//   and a partial group at the end.
+		static constexpr unsigned int H3_TABLE_OFFSET = 0x8000;
+		static constexpr unsigned int H3_TABLE_SIZE = 0x18000;
+		static constexpr unsigned int DATA_OFFSET = H3_TABLE_OFFSET + H3_TABLE_SIZE;
+		static constexpr unsigned int SECTOR_COUNT = 520;
+		static vector<uint8_t> partition;
+
+		/**
+		 * Hash levels for updateHashes().
+		 */
+		enum HashLevel {
+			HASH_H0,	// H0 table of each sector
+			HASH_H1,	// H1 tables (copied to each sector in the subgroup)
+			HASH_H2,	// H2 tables (copied to each sector in the group)
+			HASH_H3,	// H3 table entry
+			HASH_TMD,	// H3 table hash in the TMD
+		};
+
+		/**
+		 * Update the hashes for a group of sectors.
+		 * @param img	[in/out] Partition image
+		 * @param group	[in] Group number
+		 * @param level	[in] Highest hash level to update
+		 */
+		static void updateHashes(vector<uint8_t> &img, unsigned int group, HashLevel level);
+
+		/**
+		 * Calculate a SHA-1 hash.
+		 * @param digest	[out] SHA-1 hash
+		 * @param data		[in] Data
+		 * @param size		[in] Size of data
+		 */
+		static void sha1(uint8_t digest[20], const uint8_t *data, size_t size);
+
+		/**
+		 * Get a pointer to a sector in a partition image.
+		 * @param img		[in] Partition image
+		 * @param sector	[in] Sector number
+		 * @return Sector
+		 */
+		static inline uint8_t *sectorPtr(vector<uint8_t> &img, unsigned int sector)
+		{
+			return &img[DATA_OFFSET + (static_cast<size_t>(sector) * SECTOR_SIZE)];
+		}
+
+		/**
+		 * Verify the hashes in a partition image.
+		 * @param img		[in] Partition image
+		 * @param pResult	[out] Verification results
+		 * @param callback	[in,opt] Progress callback
+		 * @param userdata	[in,opt] User data for the progress callback
+		 * @return verifyHashes() return value
+		 */
+		static int verify(const vector<uint8_t> &img, WiiPartition::HashVerifyResult *pResult,
+			WiiPartition::VerifyProgressCallback callback = nullptr, void *userdata = nullptr);
+
+		/**
+		 * Open a partition image.
+		 * @param img		[in] Partition image
+		 * @param crypto	[in] Crypto method
+		 * @return WiiPartition
+		 */
+		static std::shared_ptr<WiiPartition> openPartition(const vector<uint8_t> &img,
+			WiiPartition::CryptoMethod crypto);
+
+		/**
+		 * Read data from a partition and compare it to the
+		 * sector data in the partition image, one sector at a time.
+		 * @param reader	[in] WiiPartition
+		 * @param img		[in] Partition image
+		 * @param crypto	[in] Crypto method
+		 * @param pos		[in] Starting position
+		 * @param size		[in] Number of bytes to read
+		 */
+		static void checkRead(IDiscReader &reader, const vector<uint8_t> &img,
+			WiiPartition::CryptoMethod crypto, off64_t pos, size_t size);
+
+		/**
+		 * Check the verification results.
+		 * @param result		[in] Verification results
+		 * @param h3_table_ok		[in] Expected h3_table_ok
+		 * @param bad_h0		[in] Expected bad_h0
+		 * @param bad_h1		[in] Expected bad_h1
+		 * @param bad_h2		[in] Expected bad_h2
+		 * @param bad_h3		[in] Expected bad_h3
+		 * @param badSectorList		[in] Expected bad sectors
+		 */
+		static void checkResult(const WiiPartition::HashVerifyResult &result, bool h3_table_ok,
+			uint32_t bad_h0, uint32_t bad_h1, uint32_t bad_h2, uint32_t bad_h3,
+			const vector<uint32_t> &badSectorList);
+};
+
+vector<uint8_t> WiiPartitionTest::partition;
+
+/**
+ * Calculate a SHA-1 hash.
+ * @param digest	[out] SHA-1 hash
+ * @param data		[in] Data
+ * @param size		[in] Size of data
+ */
+void WiiPartitionTest::sha1(uint8_t digest[20], const uint8_t *data, size_t size)
+{
+	Hash hash(Hash::Algorithm::SHA1);
+	ASSERT_TRUE(hash.isUsable());
+	hash.process(data, size);
+	ASSERT_EQ(0, hash.getHash(digest, 20));
+}
+
+/**
+ * Update the hashes for a group of sectors.
+ * @param img	[in/out] Partition image
+ * @param group	[in] Group number
+ * @param level	[in] Highest hash level to update
+ */
+void WiiPartitionTest::updateHashes(vector<uint8_t> &img, unsigned int group, HashLevel level)
+{
+	const unsigned int first = group * SECTORS_PER_GROUP;
+	const unsigned int count = std::min(SECTOR_COUNT - first, SECTORS_PER_GROUP);
+
+	// H0: One hash per 1 KB of data.
+	for (unsigned int i = 0; i < count; i++) {
+		uint8_t *const sector = sectorPtr(img, first + i);
+		for (unsigned int j = 0; j < 31; j++) {
+			sha1(&sector[H0_OFFSET + (j * 20)], &sector[SECTOR_HASH_SIZE + (j * 1024)], 1024);
+		}
+	}
+	if (level < HASH_H1)
+		return;
+
+	// H1: Hashes of each H0 table in the subgroup.
+	uint8_t h2[8][20];
+	memset(h2, 0, sizeof(h2));
+	for (unsigned int sg = 0; sg * SECTORS_PER_SUBGROUP < count; sg++) {
+		const unsigned int sg_first = first + (sg * SECTORS_PER_SUBGROUP);
+		const unsigned int sg_count = std::min(count - (sg * SECTORS_PER_SUBGROUP), SECTORS_PER_SUBGROUP);
+		uint8_t h1[8][20];
+		memset(h1, 0, sizeof(h1));
+		for (unsigned int i = 0; i < sg_count; i++) {
+			sha1(h1[i], &sectorPtr(img, sg_first + i)[H0_OFFSET], H0_TABLE_SIZE);
+		}
+		for (unsigned int i = 0; i < sg_count; i++) {
+			memcpy(&sectorPtr(img, sg_first + i)[H1_OFFSET], h1, H1_TABLE_SIZE);
+		}
+		sha1(h2[sg], &h1[0][0], H1_TABLE_SIZE);
+	}
+	if (level < HASH_H2)
+		return;
+
+	// H2: Hashes of each H1 table in the group.
+	for (unsigned int i = 0; i < count; i++) {
+		memcpy(&sectorPtr(img, first + i)[H2_OFFSET], h2, H2_TABLE_SIZE);
+	}
+	if (level < HASH_H3)
+		return;
+
+	// H3: Hash of the H2 table.
+	sha1(&img[H3_TABLE_OFFSET + (group * 20)], &h2[0][0], H2_TABLE_SIZE);
+	if (level < HASH_TMD)
+		return;
+
+	// TMD: Hash of the H3 table.
+	RVL_PartitionHeader *const header = reinterpret_cast<RVL_PartitionHeader*>(img.data());
+	RVL_Content_Entry *const content0 =
+		reinterpret_cast<RVL_Content_Entry*>(&header->tmd[sizeof(RVL_TMD_Header)]);
+	sha1(content0->sha1_hash, &img[H3_TABLE_OFFSET], H3_TABLE_SIZE);
+}
+
+void WiiPartitionTest::SetUpTestSuite(void)
+{
+	partition.assign(DATA_OFFSET + (static_cast<size_t>(SECTOR_COUNT) * SECTOR_SIZE), 0);
+
+	// Partition header
+	RVL_PartitionHeader *const header = reinterpret_cast<RVL_PartitionHeader*>(partition.data());
+	header->ticket.signature_type = cpu_to_be32(RVL_CERT_SIGTYPE_RSA2048_SHA1);
+	header->h3_table_offset.val = cpu_to_be32(H3_TABLE_OFFSET >> 2);
+	header->data_offset.val = cpu_to_be32(DATA_OFFSET >> 2);
+	header->data_size.val = cpu_to_be32((SECTOR_COUNT * SECTOR_SIZE) >> 2);
+	RVL_TMD_Header *const tmdHeader = reinterpret_cast<RVL_TMD_Header*>(header->tmd);
+	tmdHeader->signature_type = cpu_to_be32(RVL_CERT_SIGTYPE_RSA2048_SHA1);
+	tmdHeader->nbr_cont = cpu_to_be16(1);
+
+	// Sector data
+	uint32_t state = 0x2468;
+	for (unsigned int i = 0; i < SECTOR_COUNT; i++) {
+		uint8_t *const data = &sectorPtr(partition, i)[SECTOR_HASH_SIZE];
+		for (unsigned int j = 0; j < SECTOR_DATA_SIZE; j++) {
+			state = (state * 1103515245U) + 12345U;
+			data[j] = static_cast<uint8_t>(state >> 16);
+		}
+	}
+
+	// Sector 0 has a disc header with the Wii magic number.
+	GCN_DiscHeader *const discHeader =
+		reinterpret_cast<GCN_DiscHeader*>(&sectorPtr(partition, 0)[SECTOR_HASH_SIZE]);
+	discHeader->magic_wii = cpu_to_be32(WII_MAGIC);
+
+	// Hashes
+	const unsigned int groupCount = (SECTOR_COUNT + SECTORS_PER_GROUP - 1) / SECTORS_PER_GROUP;
+	for (unsigned int group = 0; group < groupCount; group++) {
+		updateHashes(partition, group, (group + 1 == groupCount) ? HASH_TMD : HASH_H3);
+	}
+}
+
+void WiiPartitionTest::TearDownTestSuite(void)
+{
+	partition.clear();
+	partition.shrink_to_fit();
+}
+
+/**
+ * Verify the hashes in a partition image.
+ * @param img		[in] Partition image
+ * @param pResult	[out] Verification results
+ * @param callback	[in,opt] Progress callback
+ * @param userdata	[in,opt] User data for the progress callback
+ * @return verifyHashes() return value
+ */
+int WiiPartitionTest::verify(const vector<uint8_t> &img, WiiPartition::HashVerifyResult *pResult,
+	WiiPartition::VerifyProgressCallback callback, void *userdata)
+{
+	const IRpFilePtr memFile = std::make_shared<MemFile>(img.data(), img.size());
+	// NOTE: CBCReader without a key is a passthrough reader.
+	const IDiscReaderPtr discReader = std::make_shared<CBCReader>(
+		memFile, 0, static_cast<off64_t>(img.size()), nullptr, nullptr);
+	WiiPartition wiiPartition(discReader, 0, static_cast<off64_t>(img.size()), WiiPartition::CM_NASOS);
+	EXPECT_TRUE(wiiPartition.isOpen());
+	return wiiPartition.verifyHashes(pResult, callback, userdata);
+}
+
+/**
+ * Open a partition image.
+ * @param img		[in] Partition image
+ * @param crypto	[in] Crypto method
+ * @return WiiPartition
+ */
+std::shared_ptr<WiiPartition> WiiPartitionTest::openPartition(const vector<uint8_t> &img,
+	WiiPartition::CryptoMethod crypto)
+{
+	const IRpFilePtr memFile = std::make_shared<MemFile>(img.data(), img.size());
+	// NOTE: CBCReader without a key is a passthrough reader.
+	const IDiscReaderPtr discReader = std::make_shared<CBCReader>(
+		memFile, 0, static_cast<off64_t>(img.size()), nullptr, nullptr);
+	return std::make_shared<WiiPartition>(discReader, 0, static_cast<off64_t>(img.size()), crypto);
+}
+
+/**
+ * Read data from a partition and compare it to the
+ * sector data in the partition image, one sector at a time.
+ * @param reader	[in] WiiPartition
+ * @param img		[in] Partition image
+ * @param crypto	[in] Crypto method
+ * @param pos		[in] Starting position
+ * @param size		[in] Number of bytes to read
+ */
+void WiiPartitionTest::checkRead(IDiscReader &reader, const vector<uint8_t> &img,
+	WiiPartition::CryptoMethod crypto, off64_t pos, size_t size)
+{
+	// Full 32K sectors include the hash area.
+	const bool is32K = ((crypto & WiiPartition::CM_MASK_SECTOR) == WiiPartition::CM_32K);
+	const unsigned int sector_data_size = (is32K ? SECTOR_SIZE : SECTOR_DATA_SIZE);
+	const unsigned int sector_data_offset = (is32K ? 0 : SECTOR_HASH_SIZE);
+
+	vector<uint8_t> expected;
+	expected.reserve(size);
+	for (off64_t p = pos; p < pos + static_cast<off64_t>(size); ) {
+		const unsigned int sector = static_cast<unsigned int>(p / sector_data_size);
+		const unsigned int offset = static_cast<unsigned int>(p % sector_data_size);
+		const size_t len = std::min(static_cast<size_t>(sector_data_size - offset),
+			static_cast<size_t>(pos + static_cast<off64_t>(size) - p));
+		const uint8_t *const src = &img[DATA_OFFSET + (static_cast<size_t>(sector) * SECTOR_SIZE) +
+			sector_data_offset + offset];
+		expected.insert(expected.end(), src, src + len);
+		p += len;
+	}
+
+	vector<uint8_t> buf(size);
+	ASSERT_EQ(0, reader.seek(pos)) << "pos == " << pos;
+	ASSERT_EQ(size, reader.read(buf.data(), size)) << "pos == " << pos << ", size == " << size;
+	EXPECT_TRUE(expected == buf) << "pos == " << pos << ", size == " << size;
+}
+
+/**
+ * Check the verification results.
+ * @param result		[in] Verification results
+ * @param h3_table_ok		[in] Expected h3_table_ok
+ * @param bad_h0		[in] Expected bad_h0
+ * @param bad_h1		[in] Expected bad_h1
+ * @param bad_h2		[in] Expected bad_h2
+ * @param bad_h3		[in] Expected bad_h3
+ * @param badSectorList		[in] Expected bad sectors
+ */
+void WiiPartitionTest::checkResult(const WiiPartition::HashVerifyResult &result, bool h3_table_ok,
+	uint32_t bad_h0, uint32_t bad_h1, uint32_t bad_h2, uint32_t bad_h3,
+	const vector<uint32_t> &badSectorList)
+{
+	EXPECT_EQ(SECTOR_COUNT, result.sectors);
+	EXPECT_EQ(h3_table_ok, result.h3_table_ok);
+	EXPECT_EQ(static_cast<uint32_t>(badSectorList.size()), result.bad_sectors);
+	EXPECT_EQ(bad_h0, result.bad_h0);
+	EXPECT_EQ(bad_h1, result.bad_h1);
+	EXPECT_EQ(bad_h2, result.bad_h2);
+	EXPECT_EQ(bad_h3, result.bad_h3);
+	EXPECT_EQ(badSectorList, result.badSectorList);
+}
+
+/**
+ * Build a list of consecutive sector numbers.
+ * @param first First sector
+ * @param count Number of sectors
+ * @return Sector numbers
+ */
+static vector<uint32_t> sectorRange(uint32_t first, uint32_t count)
+{
+	vector<uint32_t> v(count);
+	for (uint32_t i = 0; i < count; i++) {
+		v[i] = first + i;
+	}
+	return v;
+}
+
+/**
+ * All hashes are valid.
+ */
+TEST_F(WiiPartitionTest, verifyHashesOK)
+{
+	WiiPartition::HashVerifyResult result;
+	ASSERT_EQ(0, verify(partition, &result));
+	checkResult(result, true, 0, 0, 0, 0, {});
+}
+
+/**
+ * Sector data doesn't match H0.
+ */
+TEST_F(WiiPartitionTest, verifyHashesBadH0)
+{
+	vector<uint8_t> img = partition;
+	sectorPtr(img, 3)[SECTOR_HASH_SIZE + 5000] ^= 0x01;
+	sectorPtr(img, 515)[SECTOR_SIZE - 1] ^= 0x80;
+
+	WiiPartition::HashVerifyResult result;
+	ASSERT_EQ(0, verify(img, &result));
+	checkResult(result, true, 2, 0, 0, 0, {3, 515});
+}
+
+/**
+ * An H0 table doesn't match H1.
+ * The sector's H0 table is updated, so only H1 fails, but every sector
+ * in the subgroup has a copy of the H1 table.
+ */
+TEST_F(WiiPartitionTest, verifyHashesBadH1)
+{
+	vector<uint8_t> img = partition;
+	sectorPtr(img, 10)[SECTOR_HASH_SIZE + 100] ^= 0x01;
+	updateHashes(img, 0, HASH_H0);
+
+	WiiPartition::HashVerifyResult result;
+	ASSERT_EQ(0, verify(img, &result));
+	checkResult(result, true, 0, 8, 0, 0, sectorRange(8, 8));
+}
+
+/**
+ * An H1 table doesn't match H2.
+ * Only the sectors in the subgroup have the modified H1 table.
+ */
+TEST_F(WiiPartitionTest, verifyHashesBadH2)
+{
+	vector<uint8_t> img = partition;
+	sectorPtr(img, 64 + 20)[SECTOR_HASH_SIZE] ^= 0x01;
+	updateHashes(img, 1, HASH_H1);
+
+	WiiPartition::HashVerifyResult result;
+	ASSERT_EQ(0, verify(img, &result));
+	checkResult(result, true, 0, 0, 8, 0, sectorRange(64 + 16, 8));
+}
+
+/**
+ * An H2 table doesn't match H3.
+ * Every sector in the group has a copy of the H2 table.
+ */
+TEST_F(WiiPartitionTest, verifyHashesBadH3)
+{
+	vector<uint8_t> img = partition;
+	sectorPtr(img, 128)[SECTOR_HASH_SIZE] ^= 0x01;
+	updateHashes(img, 2, HASH_H2);
+
+	WiiPartition::HashVerifyResult result;
+	ASSERT_EQ(0, verify(img, &result));
+	checkResult(result, true, 0, 0, 0, 64, sectorRange(128, 64));
+}
+
+/**
+ * The H3 table doesn't match the TMD.
+ * Only the last group is affected, and it's only 8 sectors.
+ */
+TEST_F(WiiPartitionTest, verifyHashesBadH3Table)
+{
+	vector<uint8_t> img = partition;
+	img[H3_TABLE_OFFSET + (8 * 20)] ^= 0x01;
+
+	WiiPartition::HashVerifyResult result;
+	ASSERT_EQ(0, verify(img, &result));
+	checkResult(result, false, 0, 0, 0, 8, sectorRange(512, 8));
+}
+
+/**
+ * Progress callback user data.
+ */
+struct ProgressData {
+	unsigned int calls;
+	unsigned int cancelAt;	// Cancel on this call (0 == never)
+	uint64_t lastDone;
+	uint64_t lastTotal;
+};
+
+/**
+ * Progress callback.
+ * @param done		[in] Number of bytes verified
+ * @param total		[in] Total number of bytes to verify
+ * @param userdata	[in] ProgressData
+ * @return 0 to continue; non-zero to cancel.
+ */
+static int progressCallback(uint64_t done, uint64_t total, void *userdata)
+{
+	ProgressData *const progress = static_cast<ProgressData*>(userdata);
+	progress->calls++;
+	progress->lastDone = done;
+	progress->lastTotal = total;
+	return (progress->calls == progress->cancelAt);
+}
+
+/**
+ * The progress callback is called after each batch.
+ */
+TEST_F(WiiPartitionTest, verifyHashesProgress)
+{
+	ProgressData progress = {0, 0, 0, 0};
+	WiiPartition::HashVerifyResult result;
+	ASSERT_EQ(0, verify(partition, &result, progressCallback, &progress));
+	checkResult(result, true, 0, 0, 0, 0, {});
+
+	const uint64_t total = static_cast<uint64_t>(SECTOR_COUNT) * SECTOR_SIZE;
+	EXPECT_EQ(2U, progress.calls);
+	EXPECT_EQ(total, progress.lastDone);
+	EXPECT_EQ(total, progress.lastTotal);
+}
+
+/**
+ * Verification can be cancelled using the progress callback.
+ */
+TEST_F(WiiPartitionTest, verifyHashesCancel)
+{
+	// Bad sector in the second batch, which shouldn't be checked.
+	vector<uint8_t> img = partition;
+	sectorPtr(img, 515)[SECTOR_HASH_SIZE] ^= 0x01;
+
+	ProgressData progress = {0, 1, 0, 0};
+	WiiPartition::HashVerifyResult result;
+	EXPECT_EQ(-ECANCELED, verify(img, &result, progressCallback, &progress));
+	EXPECT_EQ(1U, progress.calls);
+	EXPECT_EQ(512U, result.sectors);
+	EXPECT_EQ(0U, result.bad_sectors);
+	EXPECT_EQ(static_cast<uint64_t>(512) * SECTOR_SIZE, progress.lastDone);
+}
+
+/**
+ * Crypto methods that can be read without keys.
+ */
+static const WiiPartition::CryptoMethod readCryptoMethods[] = {
+	WiiPartition::CM_NASOS,
+	WiiPartition::CM_RVTH,
+};
+
+/**
+ * Read a run of sectors that's unaligned at both ends
+ * and longer than the maximum run length.
+ */
+TEST_F(WiiPartitionTest, readUnalignedRun)
+{
+	for (const WiiPartition::CryptoMethod crypto : readCryptoMethods) {
+		const bool is32K = ((crypto & WiiPartition::CM_MASK_SECTOR) == WiiPartition::CM_32K);
+		const unsigned int sds = (is32K ? SECTOR_SIZE : SECTOR_DATA_SIZE);
+		const std::shared_ptr<WiiPartition> wiiPartition = openPartition(partition, crypto);
+		ASSERT_TRUE(wiiPartition->isOpen());
+
+		checkRead(*wiiPartition, partition, crypto, (3 * sds) + 0x123, (40 * sds) + 0x456);
+		// Aligned start, unaligned end.
+		checkRead(*wiiPartition, partition, crypto, 100 * sds, (70 * sds) + 1);
+		// Unaligned start, aligned end.
+		checkRead(*wiiPartition, partition, crypto, (200 * sds) - 1, (33 * sds) + 1);
+		// Within a single sector.
+		checkRead(*wiiPartition, partition, crypto, (300 * sds) + 7, 0x100);
+		// Up to the end of the partition.
+		checkRead(*wiiPartition, partition, crypto, (480 * sds) + 0x800, (40 * sds) - 0x800);
+	}
+}
+
+/**
+ * Read runs that cross sectors in the sector cache.
+ */
+TEST_F(WiiPartitionTest, readAroundCachedSectors)
+{
+	for (const WiiPartition::CryptoMethod crypto : readCryptoMethods) {
+		const bool is32K = ((crypto & WiiPartition::CM_MASK_SECTOR) == WiiPartition::CM_32K);
+		const unsigned int sds = (is32K ? SECTOR_SIZE : SECTOR_DATA_SIZE);
+		const std::shared_ptr<WiiPartition> wiiPartition = openPartition(partition, crypto);
+		ASSERT_TRUE(wiiPartition->isOpen());
+
+		// Partial sector reads add sectors to the sector cache.
+		for (unsigned int sector : {6U, 9U, 10U, 40U}) {
+			checkRead(*wiiPartition, partition, crypto, (sector * sds) + 0x100, 16);
+		}
+
+		// The run is split around the cached sectors.
+		checkRead(*wiiPartition, partition, crypto, (4 * sds) + 0x10, (41 * sds) + 0x20);
+		// Cached sectors at both ends.
+		checkRead(*wiiPartition, partition, crypto, (6 * sds) + 0x200, (34 * sds) + 0x300);
+
+		// Evict all of the sectors, then read across them again.
+		for (unsigned int sector = 100; sector < 112; sector++) {
+			checkRead(*wiiPartition, partition, crypto, (sector * sds) + sector, 32);
+		}
+		checkRead(*wiiPartition, partition, crypto, (4 * sds) + 0x10, (41 * sds) + 0x20);
+		checkRead(*wiiPartition, partition, crypto, (98 * sds) + 0x4000, (16 * sds) + 0x40);
+	}
+}
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRomData test suite: WiiPartition tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
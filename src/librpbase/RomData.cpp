@@ -13,6 +13,9 @@
 // Other rom-properties libraries
 #include "libi18n/i18n.h"
 #include "libcachecommon/CacheKeys.hpp"
+#ifdef _WIN32
+#  include "librpfile/BufferedFile.hpp"
+#endif /* _WIN32 */
 using namespace LibRpFile;
 using namespace LibRpText;
 using namespace LibRpTexture;
@@ -56,7 +59,13 @@ RomDataPrivate::RomDataPrivate(const IRpFilePtr &file, const RomDataInfo *pRomDa
 
 #ifdef _WIN32
 		// If this is RpFile, get the UTF-16 filename directly.
-		RpFile *const rpFile = dynamic_cast<RpFile*>(this->file.get());
+		// NOTE: RomDataFactory may have wrapped it in a BufferedFile.
+		IRpFile *pFile = this->file.get();
+		const BufferedFile *const bufFile = dynamic_cast<const BufferedFile*>(pFile);
+		if (bufFile) {
+			pFile = bufFile->baseFile().get();
+		}
+		RpFile *const rpFile = dynamic_cast<RpFile*>(pFile);
 		if (rpFile) {
 			const wchar_t *const filenameW = rpFile->filenameW();
 			if (filenameW) {
@@ -1049,15 +1058,20 @@ int RomData::doRomOp(int id, RomOpParams *pParams)
 		closeFileAfter = false;
 	} else {
 		// Reopen the file.
+		// NOTE: Read-only operations, e.g. hash verification,
+		// shouldn't require write access to the file.
 		closeFileAfter = true;
+		const RpFile::FileMode mode = (v_ops[id].flags & RomOp::ROF_REQ_WRITABLE)
+			? RpFile::FM_OPEN_WRITE
+			: RpFile::FM_OPEN_READ;
 		IRpFilePtr file;
 #ifdef _WIN32
 		if (d->filenameW) {
-			file = std::make_shared<RpFile>(d->filenameW, RpFile::FM_OPEN_WRITE);
+			file = std::make_shared<RpFile>(d->filenameW, mode);
 		} else
 #endif /* _WIN32 */
 		{
-			file = std::make_shared<RpFile>(d->filename, RpFile::FM_OPEN_WRITE);
+			file = std::make_shared<RpFile>(d->filename, mode);
 		}
 
 		if (!file->isOpen()) {
@@ -1067,7 +1081,9 @@ int RomData::doRomOp(int id, RomOpParams *pParams)
 				ret = -EIO;
 			}
 			pParams->status = ret;
-			pParams->msg = C_("RomData", "Unable to reopen the file for writing.");
+			pParams->msg = (mode == RpFile::FM_OPEN_WRITE)
+				? C_("RomData", "Unable to reopen the file for writing.")
+				: C_("RomData", "Unable to reopen the file.");
 			return ret;
 		}
 		d->file = std::move(file);
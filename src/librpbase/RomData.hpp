@@ -611,6 +611,17 @@ public:
 		}
 	};
 
+	/**
+	 * ROM operation progress callback.
+	 * Used by long-running operations, e.g. hash verification.
+	 * May be called from a worker thread.
+	 * @param done		[in] Amount of work done
+	 * @param total		[in] Total amount of work
+	 * @param userdata	[in] User data
+	 * @return 0 to continue; non-zero to cancel the operation.
+	 */
+	typedef int (*RomOpProgressCallback)(uint64_t done, uint64_t total, void *userdata);
+
 	struct RomOpParams {
 		/** OUT: Results **/
 		int status;			// Status. (0 == success; negative == POSIX error; positive == other error)
@@ -619,10 +630,14 @@ public:
 
 		/** IN: Parameters **/
 		const char *save_filename;	// Filename for saving data.
+		RomOpProgressCallback progress;	// Progress callback. (optional)
+		void *progress_userdata;	// User data for the progress callback.
 
 		RomOpParams()
 			: status(0)
 			, save_filename(nullptr)
+			, progress(nullptr)
+			, progress_userdata(nullptr)
 		{}
 	};
 
@@ -34,6 +34,7 @@ class AesCipherFactory
 		 *
 		 * @return IAesCipher class, or nullptr if decryption isn't supported
 		 */
+		RP_LIBROMDATA_PUBLIC
 		static IAesCipher *create(void);
 
 	public:
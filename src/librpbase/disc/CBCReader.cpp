@@ -20,6 +20,8 @@
 #include "librpfile/IRpFile.hpp"
 using namespace LibRpFile;
 
+// C++ includes
+#include "uvector.h"
 #ifdef ENABLE_DECRYPTION
 using std::array;
 using std::unique_ptr;
@@ -49,6 +51,77 @@ class CBCReaderPrivate
 		array<uint8_t, 16> key;
 		array<uint8_t, 16> iv;
 		bool usesIV;
+
+		// Recently seen IVs, indexed by block position.
+		// For CBC, the IV for a block is the previous ciphertext block.
+		// Each read saves the IVs for its last block and the block
+		// after it, so sequential reads never have to re-read the IV,
+		// and repeated random seeks to the same blocks can reuse them.
+		static constexpr unsigned int IV_CACHE_SIZE = 8;
+		struct IVCacheEntry {
+			off64_t pos;	// Block position (-1 if unused)
+			array<uint8_t, 16> iv;
+		};
+		array<IVCacheEntry, IV_CACHE_SIZE> ivCache;
+		unsigned int ivCacheNext;	// Next entry to replace
+
+		/**
+		 * Look up the IV for a block.
+		 * @param pos	[in] Block position (must be a multiple of 16)
+		 * @param pIV	[out] IV
+		 * @return True if found; false if not.
+		 */
+		bool lookupIV(off64_t pos, uint8_t *pIV) const;
+
+		/**
+		 * Save the IV for a block.
+		 * @param pos	[in] Block position (must be a multiple of 16)
+		 * @param pIV	[in] IV (ciphertext of the previous block)
+		 */
+		void saveIV(off64_t pos, const uint8_t *pIV);
+
+		/** Pipelined reads **/
+
+		// After advise(AH_SEQUENTIAL), reads are decrypted in chunks.
+		// The next chunk is read while the current chunk is being
+		// decrypted, so decryption doesn't stall the I/O.
+		static constexpr size_t PIPELINE_CHUNK_SIZE = 128U * 1024U;
+		// Minimum read size to decrypt directly into the output buffer.
+		static constexpr size_t PIPELINE_MIN_SIZE = 2U * PIPELINE_CHUNK_SIZE;
+
+		// Sequential reads are decrypted ahead of time into
+		// a read-ahead buffer, one window at a time.
+		static constexpr size_t READAHEAD_SIZE = 1024U * 1024U;
+
+		rp::uvector<uint8_t> raBuf;	// Decrypted read-ahead data
+		off64_t raPos;			// Position of raBuf (-1 if empty)
+		size_t raLen;			// Amount of data in raBuf
+		IRpFile::AccessHint accessHint;	// Hint from advise()
+
+		/**
+		 * Read and decrypt data using the read/decrypt pipeline.
+		 * @param file	[in] IRpFile
+		 * @param pos	[in] Block position (must be a multiple of 16)
+		 * @param ptr	[out] Output buffer
+		 * @param size	[in] Size (must be a multiple of 16)
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int readPipelined(IRpFile *file, off64_t pos, uint8_t *ptr, size_t size);
+
+		/**
+		 * Read data using the read-ahead buffer and/or the pipeline.
+		 * This handles as much of the read as possible; the rest
+		 * must be handled by the regular block-based reader.
+		 *
+		 * NOTE: Only used after advise(AH_SEQUENTIAL).
+		 * NOTE: size must be within the bounds of the encrypted data.
+		 *
+		 * @param file	[in] IRpFile
+		 * @param ptr	[out] Output buffer
+		 * @param size	[in] Size
+		 * @return Number of bytes read. (pos is advanced by this amount)
+		 */
+		size_t readSequential(IRpFile *file, uint8_t *ptr, size_t size);
 #endif /* ENABLE_DECRYPTION */
 };
 
@@ -60,8 +133,18 @@ CBCReaderPrivate::CBCReaderPrivate(CBCReader *q, off64_t offset, off64_t length,
 	, pos(0)
 #ifdef ENABLE_DECRYPTION
 	, usesIV(iv != nullptr)
+	, ivCacheNext(0)
+	, raPos(-1)
+	, raLen(0)
+	, accessHint(IRpFile::AH_NORMAL)
 #endif /* ENABLE_DECRYPTION */
 {
+#ifdef ENABLE_DECRYPTION
+	for (IVCacheEntry &entry : ivCache) {
+		entry.pos = -1;
+	}
+#endif /* ENABLE_DECRYPTION */
+
 	assert(q->m_file);
 	if (!q->m_file) {
 		// No file...
@@ -114,6 +197,206 @@ CBCReaderPrivate::CBCReaderPrivate(CBCReader *q, off64_t offset, off64_t length,
 #endif /* ENABLE_DECRYPTION */
 }
 
+#ifdef ENABLE_DECRYPTION
+/**
+ * Look up the IV for a block.
+ * @param pos	[in] Block position (must be a multiple of 16)
+ * @param pIV	[out] IV
+ * @return True if found; false if not.
+ */
+bool CBCReaderPrivate::lookupIV(off64_t pos, uint8_t *pIV) const
+{
+	if (pos == 0) {
+		// Start of data. Use the specified IV.
+		memcpy(pIV, iv.data(), iv.size());
+		return true;
+	}
+
+	for (const IVCacheEntry &entry : ivCache) {
+		if (entry.pos == pos) {
+			memcpy(pIV, entry.iv.data(), entry.iv.size());
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Save the IV for a block.
+ * @param pos	[in] Block position (must be a multiple of 16)
+ * @param pIV	[in] IV (ciphertext of the previous block)
+ */
+void CBCReaderPrivate::saveIV(off64_t pos, const uint8_t *pIV)
+{
+	if (pos <= 0 || pos >= length) {
+		// Not needed.
+		return;
+	}
+
+	IVCacheEntry *pEntry = nullptr;
+	for (IVCacheEntry &entry : ivCache) {
+		if (entry.pos == pos) {
+			// Already cached.
+			pEntry = &entry;
+			break;
+		}
+	}
+	if (!pEntry) {
+		// Replace the oldest entry.
+		pEntry = &ivCache[ivCacheNext];
+		ivCacheNext = (ivCacheNext + 1) % IV_CACHE_SIZE;
+	}
+
+	pEntry->pos = pos;
+	memcpy(pEntry->iv.data(), pIV, pEntry->iv.size());
+}
+
+/**
+ * Read and decrypt data using the read/decrypt pipeline.
+ * @param file	[in] IRpFile
+ * @param pos	[in] Block position (must be a multiple of 16)
+ * @param ptr	[out] Output buffer
+ * @param size	[in] Size (must be a multiple of 16)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int CBCReaderPrivate::readPipelined(IRpFile *file, off64_t pos, uint8_t *ptr, size_t size)
+{
+	assert(pos % 16 == 0);
+	assert(size % 16 == 0);
+	assert(size > 0);
+
+	// Get the IV for the first block.
+	array<uint8_t, 16> iv;
+	const bool readIV = (usesIV && !lookupIV(pos, iv.data()));
+
+	const size_t chunkCount = (size + PIPELINE_CHUNK_SIZE - 1) / PIPELINE_CHUNK_SIZE;
+	auto chunkSize = [size](size_t i) -> size_t {
+		return std::min(size - (i * PIPELINE_CHUNK_SIZE), static_cast<size_t>(PIPELINE_CHUNK_SIZE));
+	};
+
+	// Read the first chunk, along with the IV if it isn't cached.
+	array<IRpFile::IoVec, 2> iov;
+	unsigned int iovcnt = 0;
+	size_t io_sz = 0;
+	if (readIV) {
+		iov[iovcnt++] = {iv.data(), iv.size()};
+		io_sz += iv.size();
+	}
+	iov[iovcnt++] = {ptr, chunkSize(0)};
+	io_sz += chunkSize(0);
+	if (file->readAtV(offset + pos - (readIV ? 16 : 0), iov.data(), iovcnt) != io_sz) {
+		return -EIO;
+	}
+
+	// Decrypt each chunk while reading the next one.
+	// NOTE: Chunks are decrypted in place, so the last ciphertext
+	// block of each chunk has to be saved for the next chunk's IV.
+	bool readOK = true, decryptOK = true;
+	array<uint8_t, 16> nextIV = {{0}};
+	for (size_t i = 0; i < chunkCount && readOK && decryptOK; i++) {
+		uint8_t *const pChunk = &ptr[i * PIPELINE_CHUNK_SIZE];
+		const size_t sz = chunkSize(i);
+		if (usesIV) {
+			memcpy(nextIV.data(), &pChunk[sz - 16], nextIV.size());
+		}
+
+#ifdef _OPENMP
+		#pragma omp parallel sections num_threads(2)
+#endif /* _OPENMP */
+		{
+#ifdef _OPENMP
+			#pragma omp section
+#endif /* _OPENMP */
+			if (i + 1 < chunkCount) {
+				const size_t next_sz = chunkSize(i + 1);
+				readOK = (file->readAt(offset + pos + ((i + 1) * PIPELINE_CHUNK_SIZE),
+					&pChunk[sz], next_sz) == next_sz);
+			}
+
+#ifdef _OPENMP
+			#pragma omp section
+#endif /* _OPENMP */
+			{
+				if (usesIV) {
+					decryptOK = (cipher->setIV(iv.data(), iv.size()) == 0);
+				}
+				if (decryptOK) {
+					decryptOK = (cipher->decrypt(pChunk, sz) == sz);
+				}
+			}
+		}
+
+		if (usesIV) {
+			iv = nextIV;
+		}
+	}
+	if (!readOK || !decryptOK) {
+		return -EIO;
+	}
+
+	if (usesIV) {
+		// Save the IV for the block after this read.
+		saveIV(pos + static_cast<off64_t>(size), iv.data());
+	}
+	return 0;
+}
+
+/**
+ * Read data using the read-ahead buffer and/or the pipeline.
+ * This handles as much of the read as possible; the rest
+ * must be handled by the regular block-based reader.
+ *
+ * NOTE: Only used after advise(AH_SEQUENTIAL).
+ * NOTE: size must be within the bounds of the encrypted data.
+ *
+ * @param file	[in] IRpFile
+ * @param ptr	[out] Output buffer
+ * @param size	[in] Size
+ * @return Number of bytes read. (pos is advanced by this amount)
+ */
+size_t CBCReaderPrivate::readSequential(IRpFile *file, uint8_t *ptr, size_t size)
+{
+	size_t done = 0;
+	while (done < size) {
+		if (raPos >= 0 && pos >= raPos && pos < raPos + static_cast<off64_t>(raLen)) {
+			// Copy from the read-ahead buffer.
+			const size_t raOffset = static_cast<size_t>(pos - raPos);
+			const size_t sz = std::min(size - done, raLen - raOffset);
+			memcpy(&ptr[done], &raBuf[raOffset], sz);
+			pos += sz;
+			done += sz;
+			continue;
+		}
+
+		const size_t remain = size - done;
+		if ((pos & 15) == 0 && remain >= PIPELINE_MIN_SIZE) {
+			// Large read. Decrypt directly into the output buffer.
+			const size_t sz = remain & ~static_cast<size_t>(15);
+			if (readPipelined(file, pos, &ptr[done], sz) != 0) {
+				break;
+			}
+			pos += sz;
+			done += sz;
+			continue;
+		}
+
+		// Fill the read-ahead buffer.
+		const off64_t ra_pos = pos & ~15LL;
+		const size_t ra_len = static_cast<size_t>(
+			std::min(static_cast<off64_t>(READAHEAD_SIZE), length - ra_pos));
+		raBuf.resize(READAHEAD_SIZE);
+		raPos = -1;
+		if (readPipelined(file, ra_pos, raBuf.data(), ra_len) != 0) {
+			break;
+		}
+		raPos = ra_pos;
+		raLen = ra_len;
+	}
+
+	return done;
+}
+#endif /* ENABLE_DECRYPTION */
+
 /** CBCReader **/
 
 /**
@@ -181,7 +464,8 @@ size_t CBCReader::read(void *ptr, size_t size)
 #endif /* ENABLE_DECRYPTION */
 	{
 		// No encryption. Read directly from the file.
-		size_t sz_read = m_file->seekAndRead(d->offset + d->pos, ptr, size);
+		// NOTE: Using readAt() so the file can be shared across threads.
+		size_t sz_read = m_file->readAt(d->offset + d->pos, ptr, size);
 		if (sz_read != size) {
 			// Seek and/or read error.
 			m_lastError = m_file->lastError();
@@ -203,141 +487,145 @@ size_t CBCReader::read(void *ptr, size_t size)
 		size = static_cast<size_t>(d->length - d->pos);
 	}
 
-	// Read the first block.
+	// After advise(AH_SEQUENTIAL), reads use the read/decrypt pipeline.
+	// Anything left over is handled by the block-based reader below.
+	size_t sz_seq = 0;
+	if (d->accessHint == AH_SEQUENTIAL) {
+		sz_seq = d->readSequential(m_file.get(), ptr8, size);
+		if (sz_seq == size) {
+			return size;
+		}
+		ptr8 += sz_seq;
+		size -= sz_seq;
+	}
+
+	// Split the read into a partial first block, full blocks,
+	// and a partial last block.
 	// NOTE: If we're in the middle of a block, round it down.
 	const off64_t pos_block = d->pos & ~15LL;
+	const size_t head_offset = static_cast<size_t>(d->pos & 15);
+	const size_t head_sz = (head_offset != 0 ? std::min(16U - head_offset, size) : 0);
+	const size_t full_block_sz = (size - head_sz) & ~static_cast<size_t>(15);
+	const size_t tail_sz = size - head_sz - full_block_sz;
+
+	// Get the IV for this position.
+	array<uint8_t, 16> iv;
+	bool readIV = false;
+	if (d->usesIV && !d->lookupIV(pos_block, iv.data())) {
+		// IV isn't cached. Read it from the previous 16 bytes.
+		readIV = true;
+	}
 
-	if (d->usesIV) {
-		// Initialize the IV for this position.
-		array<uint8_t, 16> iv;
+	// Read everything using a single vectored read:
+	// [IV] [first block] [full blocks] [last block]
+	// Full blocks are read directly into the output buffer.
+	array<uint8_t, 16> head_block, tail_block;
+	array<IRpFile::IoVec, 4> iov;
+	unsigned int iovcnt = 0;
+	size_t io_sz = 0;
+	if (readIV) {
+		iov[iovcnt++] = {iv.data(), iv.size()};
+		io_sz += iv.size();
+	}
+	if (head_sz > 0) {
+		iov[iovcnt++] = {head_block.data(), head_block.size()};
+		io_sz += head_block.size();
+	}
+	if (full_block_sz > 0) {
+		iov[iovcnt++] = {ptr8 + head_sz, full_block_sz};
+		io_sz += full_block_sz;
+	}
+	if (tail_sz > 0) {
+		iov[iovcnt++] = {tail_block.data(), tail_block.size()};
+		io_sz += tail_block.size();
+	}
 
-		// Get the IV.
-		if (pos_block == 0) {
-			// Start of data.
-			// Use the specified IV.
-			iv = d->iv;
-			m_file->seek(d->offset);
-		} else {
-			// Not start of data.
-			// Read the IV from the previous 16 bytes.
-			// TODO: Cache it!
-			m_file->seek(d->offset + pos_block - 16);
-			size_t sz_read = m_file->read(iv.data(), iv.size());
-			if (sz_read != iv.size()) {
-				// Read error.
-				m_lastError = m_file->lastError();
-				if (m_lastError == 0) {
-					m_lastError = EIO;
-				}
-				return 0;
+	const off64_t io_pos = d->offset + pos_block - (readIV ? 16 : 0);
+	size_t sz_read = m_file->readAtV(io_pos, iov.data(), iovcnt);
+	if (sz_read != io_sz) {
+		// Short read.
+		// Cannot decrypt with a short read.
+		m_lastError = m_file->lastError();
+		if (m_lastError == 0) {
+			m_lastError = EIO;
+		}
+		return sz_seq;
+	}
+
+	if (d->usesIV) {
+		// Save the IVs for the last block and the block after it
+		// before the ciphertext is overwritten.
+		// Ciphertext blocks, in order: [IV] [head] [full blocks] [tail]
+		const uint8_t *ct_last = nullptr, *ct_prev = iv.data();
+		if (head_sz > 0) {
+			ct_last = head_block.data();
+		}
+		if (full_block_sz > 0) {
+			if (full_block_sz >= 32) {
+				ct_prev = ptr8 + head_sz + full_block_sz - 32;
+			} else if (ct_last) {
+				ct_prev = ct_last;
 			}
+			ct_last = ptr8 + head_sz + full_block_sz - 16;
+		}
+		if (tail_sz > 0) {
+			if (ct_last) {
+				ct_prev = ct_last;
+			}
+			ct_last = tail_block.data();
 		}
 
+		// ct_last is always set, since size > 0.
+		const off64_t pos_last = pos_block + static_cast<off64_t>(io_sz - (readIV ? 32 : 16));
+		d->saveIV(pos_last, ct_prev);
+		d->saveIV(pos_last + 16, ct_last);
+
 		// Set the IV.
 		int ret = d->cipher->setIV(iv.data(), iv.size());
 		if (ret != 0) {
 			// setIV() failed.
 			m_lastError = EIO;
-			return 0;
+			return sz_seq;
 		}
-	} else {
-		// No IV is needed. Seek directly to the data.
-		m_file->seek(d->offset + pos_block);
 	}
 
-	// Total number of bytes read.
-	size_t total_sz_read = 0;
-
-	array<uint8_t, 16> block_tmp;
-	if (d->pos != pos_block) {
+	// Decrypt the data.
+	// NOTE: CBC chaining carries over between decrypt() calls.
+	if (head_sz > 0) {
 		// We're in the middle of a block.
-		// Read and decrypt the full block, and copy out
-		// the necessary bytes.
-		const size_t sz = std::min(16U - (static_cast<size_t>(d->pos) & 15U), size);
-		size_t sz_read = m_file->read(block_tmp.data(), block_tmp.size());
-		if (sz_read != block_tmp.size()) {
-			// Read error.
-			m_lastError = m_file->lastError();
-			if (m_lastError == 0) {
-				m_lastError = EIO;
-			}
-			return 0;
-		}
-
-		// Decrypt the data.
-		size_t sz_dec = d->cipher->decrypt(block_tmp.data(), block_tmp.size());
-		if (sz_dec != block_tmp.size()) {
+		// Decrypt the full block, and copy out the necessary bytes.
+		size_t sz_dec = d->cipher->decrypt(head_block.data(), head_block.size());
+		if (sz_dec != head_block.size()) {
 			// decrypt() failed.
 			m_lastError = EIO;
-			return 0;
+			return sz_seq;
 		}
-
-		memcpy(ptr8, &block_tmp[d->pos & 15], sz);
-		ptr8 += sz;
-		size -= sz;
-		total_sz_read += sz;
-		d->pos += sz;
+		memcpy(ptr8, &head_block[head_offset], head_sz);
 	}
-
-	// Read full blocks.
-	const size_t full_block_sz = (size & ~15ULL);
 	if (full_block_sz > 0) {
-		size_t sz_read = m_file->read(ptr8, full_block_sz);
-		if (sz_read != full_block_sz) {
-			// Short read.
-			// Cannot decrypt with a short read.
-			m_lastError = m_file->lastError();
-			if (m_lastError == 0) {
-				m_lastError = EIO;
-			}
-			return 0;
-		}
-
-		// Decrypt the data.
-		size_t sz_dec = d->cipher->decrypt(ptr8, full_block_sz);
+		// Decrypt all full blocks at once.
+		size_t sz_dec = d->cipher->decrypt(ptr8 + head_sz, full_block_sz);
 		if (sz_dec != full_block_sz) {
 			// decrypt() failed.
 			m_lastError = EIO;
-			return 0;
+			return sz_seq;
 		}
-
-		ptr8 += sz_read;
-		size -= sz_read;
-		total_sz_read += sz_read;
-		d->pos += sz_read;
 	}
-
-	if (size > 0) {
+	if (tail_sz > 0) {
 		// We need to decrypt a partial block at the end.
-		// Read and decrypt the full block, and copy out
-		// the necessary bytes.
-		size_t sz_read = m_file->read(block_tmp.data(), block_tmp.size());
-		if (sz_read != block_tmp.size()) {
-			// Read error.
-			m_lastError = m_file->lastError();
-			if (m_lastError == 0) {
-				m_lastError = EIO;
-			}
-			return 0;
-		}
-
-		// Decrypt the data.
-		size_t sz_dec = d->cipher->decrypt(block_tmp.data(), block_tmp.size());
-		if (sz_dec != block_tmp.size()) {
+		// Decrypt the full block, and copy out the necessary bytes.
+		size_t sz_dec = d->cipher->decrypt(tail_block.data(), tail_block.size());
+		if (sz_dec != tail_block.size()) {
 			// decrypt() failed.
 			m_lastError = EIO;
-			return 0;
+			return sz_seq;
 		}
-
-		memcpy(ptr8, block_tmp.data(), size);
-		ptr8 += size;
-		total_sz_read += size;
-		d->pos += size;
-		size = 0;
+		memcpy(ptr8 + head_sz + full_block_sz, tail_block.data(), tail_sz);
 	}
 
 	// Data read and decrypted successfully.
-	return total_sz_read;
+	d->pos += size;
+	return sz_seq + size;
 #else
 	// Cannot decrypt data if decryption is disabled.
 	return 0;
@@ -367,7 +655,7 @@ int CBCReader::seek(off64_t pos)
 	} else if (pos >= d->length) {
 		d->pos = d->length;
 	} else {
-		d->pos = static_cast<uint32_t>(pos);
+		d->pos = pos;
 	}
 	return 0;
 }
@@ -401,4 +689,56 @@ off64_t CBCReader::size(void)
 	return d->length;
 }
 
+/** Access pattern hints **/
+
+/**
+ * Tell the OS how a range of the file will be accessed.
+ *
+ * AH_SEQUENTIAL also enables decryption read-ahead and pipelined
+ * decryption for large reads. AH_NORMAL and AH_RANDOM disable it.
+ * This applies to the entire reader, not just the specified range.
+ *
+ * @param pos	[in] Start position.
+ * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+ * @param hint	[in] Access hint.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int CBCReader::advise(off64_t pos, off64_t size, AccessHint hint)
+{
+	RP_D(CBCReader);
+	if (!m_file) {
+		return -EBADF;
+	} else if (pos < 0 || size < 0) {
+		return -EINVAL;
+	}
+
+#ifdef ENABLE_DECRYPTION
+	switch (hint) {
+		case AH_SEQUENTIAL:
+			d->accessHint = hint;
+			break;
+		case AH_NORMAL:
+		case AH_RANDOM:
+			// Read-ahead is disabled, so free the buffer.
+			d->accessHint = hint;
+			d->raBuf.clear();
+			d->raBuf.shrink_to_fit();
+			d->raPos = -1;
+			break;
+		default:
+			break;
+	}
+#endif /* ENABLE_DECRYPTION */
+
+	if (pos >= d->length) {
+		return 0;
+	}
+
+	// Constrain size based on offset and length.
+	if (size == 0 || size > d->length - pos) {
+		size = d->length - pos;
+	}
+	return m_file->advise(d->offset + pos, size, hint);
+}
+
 }
@@ -77,6 +77,7 @@ public:
 	 * @param pos Partition position.
 	 * @return 0 on success; -1 on error.
 	 */
+	RP_LIBROMDATA_PUBLIC
 	int seek(off64_t pos) final;
 
 	/**
@@ -94,6 +95,24 @@ public:
 	 */
 	RP_LIBROMDATA_PUBLIC
 	off64_t size(void) final;
+
+public:
+	/** Access pattern hints **/
+
+	/**
+	 * Tell the OS how a range of the file will be accessed.
+	 *
+	 * AH_SEQUENTIAL also enables decryption read-ahead and pipelined
+	 * decryption for large reads. AH_NORMAL and AH_RANDOM disable it.
+	 * This applies to the entire reader, not just the specified range.
+	 *
+	 * @param pos	[in] Start position.
+	 * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+	 * @param hint	[in] Access hint.
+	 * @return 0 on success; negative POSIX error code on error.
+	 */
+	RP_LIBROMDATA_PUBLIC
+	int advise(off64_t pos, off64_t size, AccessHint hint) final;
 };
 
 typedef std::shared_ptr<CBCReader> CBCReaderPtr;
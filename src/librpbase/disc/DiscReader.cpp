@@ -125,6 +125,37 @@ size_t DiscReader::read(void *ptr, size_t size)
 	return ret;
 }
 
+/**
+ * Read data from the disc image at the specified position.
+ * The disc image position is not changed.
+ * @param pos	[in] Start position.
+ * @param ptr	[out] Output data buffer.
+ * @param size	[in] Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t DiscReader::readAt(off64_t pos, void *ptr, size_t size)
+{
+	assert(m_file != nullptr);
+	if (!m_file) {
+		m_lastError = EBADF;
+		return 0;
+	} else if (pos < 0) {
+		m_lastError = EINVAL;
+		return 0;
+	} else if (pos >= m_length) {
+		return 0;
+	}
+
+	// Constrain size based on length.
+	if (static_cast<off64_t>(size) > m_length - pos) {
+		size = static_cast<size_t>(m_length - pos);
+	}
+
+	const size_t ret = m_file->readAt(pos + m_offset, ptr, size);
+	m_lastError = m_file->lastError();
+	return ret;
+}
+
 /**
  * Set the disc image position.
  * @param pos Disc image position.
@@ -179,4 +210,30 @@ off64_t DiscReader::size(void)
 	return m_length;
 }
 
+/** Access pattern hints **/
+
+/**
+ * Tell the OS how a range of the file will be accessed.
+ * @param pos	[in] Start position.
+ * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+ * @param hint	[in] Access hint.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int DiscReader::advise(off64_t pos, off64_t size, AccessHint hint)
+{
+	if (!m_file) {
+		return -EBADF;
+	} else if (pos < 0 || size < 0) {
+		return -EINVAL;
+	} else if (pos >= m_length) {
+		return 0;
+	}
+
+	// Constrain size based on offset and length.
+	if (size == 0 || size > m_length - pos) {
+		size = m_length - pos;
+	}
+	return m_file->advise(m_offset + pos, size, hint);
+}
+
 }
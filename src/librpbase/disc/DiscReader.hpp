@@ -68,6 +68,17 @@ class DiscReader final : public IDiscReader
 		ATTR_ACCESS_SIZE(write_only, 2, 3)
 		size_t read(void *ptr, size_t size) override;
 
+		/**
+		 * Read data from the disc image at the specified position.
+		 * The disc image position is not changed.
+		 * @param pos	[in] Start position.
+		 * @param ptr	[out] Output data buffer.
+		 * @param size	[in] Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		size_t readAt(off64_t pos, void *ptr, size_t size) override;
+
 		/**
 		 * Set the disc image position.
 		 * @param pos Disc image position.
@@ -87,6 +98,18 @@ class DiscReader final : public IDiscReader
 		 */
 		off64_t size(void) override;
 
+	public:
+		/** Access pattern hints **/
+
+		/**
+		 * Tell the OS how a range of the file will be accessed.
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+		 * @param hint	[in] Access hint.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int advise(off64_t pos, off64_t size, AccessHint hint) final;
+
 	protected:
 		// Offset/length. Useful for e.g. GameCube TGC.
 		off64_t m_offset;
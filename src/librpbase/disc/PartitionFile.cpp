@@ -9,6 +9,13 @@
 #include "stdafx.h"
 #include "PartitionFile.hpp"
 
+// librpfile
+#include "librpfile/IoTrace.hpp"
+using LibRpFile::IoTrace;
+
+// C++ includes
+#include <typeinfo>
+
 // C++ STL classes.
 using std::string;
 
@@ -76,6 +83,7 @@ size_t PartitionFile::read(void *ptr, size_t size)
 		}
 	}
 
+	IoTrace::Scope trace(IoTrace::Op::Read, typeid(*this).name(), m_pos, size);
 	m_partition->clearError();
 	int iRet = m_partition->seek(m_offset + m_pos);
 	if (iRet != 0) {
@@ -91,7 +99,42 @@ size_t PartitionFile::read(void *ptr, size_t size)
 		m_lastError = m_partition->lastError();
 	}
 
-	return ret;
+	return trace.ret(ret);
+}
+
+/**
+ * Read data from the file at the specified position.
+ * The file position is not changed.
+ * @param pos	[in] Start position.
+ * @param ptr	[out] Output data buffer.
+ * @param size	[in] Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t PartitionFile::readAt(off64_t pos, void *ptr, size_t size)
+{
+	if (!m_partition) {
+		m_lastError = EBADF;
+		return 0;
+	} else if (pos < 0) {
+		m_lastError = EINVAL;
+		return 0;
+	} else if (pos >= m_size) {
+		// Nothing left.
+		return 0;
+	}
+
+	// Check if size is in bounds.
+	if (static_cast<off64_t>(size) > m_size - pos) {
+		// Not enough data.
+		// Copy whatever's left in the file.
+		size = static_cast<size_t>(m_size - pos);
+	}
+
+	IoTrace::Scope trace(IoTrace::Op::ReadAt, typeid(*this).name(), pos, size);
+	m_partition->clearError();
+	const size_t ret = m_partition->readAt(m_offset + pos, ptr, size);
+	m_lastError = m_partition->lastError();
+	return trace.ret(ret);
 }
 
 /**
@@ -163,4 +206,30 @@ off64_t PartitionFile::size(void)
 	return m_size;
 }
 
+/** Access pattern hints **/
+
+/**
+ * Tell the OS how a range of the file will be accessed.
+ * @param pos	[in] Start position.
+ * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+ * @param hint	[in] Access hint.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int PartitionFile::advise(off64_t pos, off64_t size, AccessHint hint)
+{
+	if (!m_partition) {
+		return -EBADF;
+	} else if (pos < 0 || size < 0) {
+		return -EINVAL;
+	} else if (pos >= m_size) {
+		return 0;
+	}
+
+	// Check if size is in bounds.
+	if (size == 0 || size > m_size - pos) {
+		size = m_size - pos;
+	}
+	return m_partition->advise(m_offset + pos, size, hint);
+}
+
 }
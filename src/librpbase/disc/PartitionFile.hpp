@@ -52,6 +52,17 @@ class PartitionFile final : public LibRpFile::IRpFile
 		ATTR_ACCESS_SIZE(write_only, 2, 3)
 		size_t read(void *ptr, size_t size) final;
 
+		/**
+		 * Read data from the file at the specified position.
+		 * The file position is not changed.
+		 * @param pos	[in] Start position.
+		 * @param ptr	[out] Output data buffer.
+		 * @param size	[in] Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		size_t readAt(off64_t pos, void *ptr, size_t size) final;
+
 		/**
 		 * Write data to the file.
 		 * (NOTE: Not valid for PartitionFile; this will always return 0.)
@@ -84,6 +95,18 @@ class PartitionFile final : public LibRpFile::IRpFile
 		 */
 		off64_t size(void) final;
 
+	public:
+		/** Access pattern hints **/
+
+		/**
+		 * Tell the OS how a range of the file will be accessed.
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+		 * @param hint	[in] Access hint.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int advise(off64_t pos, off64_t size, AccessHint hint) final;
+
 	protected:
 		IDiscReaderPtr m_partition;
 		off64_t m_offset;	// File starting offset.
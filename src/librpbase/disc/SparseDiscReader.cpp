@@ -3,7 +3,7 @@
  * SparseDiscReader.cpp: Disc reader base class for disc image formats     *
  * that use sparse and/or compressed blocks, e.g. CISO, WBFS, GCZ.         *
  *                                                                         *
- * Copyright (c) 2016-2023 by David Korth.                                 *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
  * SPDX-License-Identifier: GPL-2.0-or-later                               *
  ***************************************************************************/
 
@@ -12,8 +12,15 @@
 #include "SparseDiscReader_p.hpp"
 
 // librpfile
+#include "librpfile/IoTrace.hpp"
 using namespace LibRpFile;
 
+// librpthreads
+using LibRpThreads::MutexLocker;
+
+// C++ includes
+#include <typeinfo>
+
 namespace LibRpBase {
 
 /** SparseDiscReaderPrivate **/
@@ -23,6 +30,13 @@ SparseDiscReaderPrivate::SparseDiscReaderPrivate(SparseDiscReader *q)
 	, disc_size(0)
 	, pos(-1)
 	, block_size(0)
+	, wholeBlocks(false)
+	, parallelBlocks(false)
+	, physBlockAddrs(false)
+	, cacheSizeMB(SparseDiscReader::DEFAULT_CACHE_SIZE_MB)
+	, lineSize(0)
+	, lruCounter(0)
+	, stats()
 {
 	// NOTE: Can't check q->m_file here.
 
@@ -30,12 +44,134 @@ SparseDiscReaderPrivate::SparseDiscReaderPrivate(SparseDiscReader *q)
 	// set by the subclass.
 }
 
+/**
+ * Initialize the block cache.
+ * block_size must be set by the subclass first.
+ * NOTE: cacheMutex must be locked by the caller.
+ */
+void SparseDiscReaderPrivate::initCache(void)
+{
+	// Determine the cache line size.
+	// Large blocks that can be read partially are split into smaller lines.
+	lineSize = block_size;
+	if (!wholeBlocks && block_size > MAX_CACHE_LINE_SIZE &&
+	    (block_size % MAX_CACHE_LINE_SIZE) == 0)
+	{
+		lineSize = MAX_CACHE_LINE_SIZE;
+	}
+
+	// Line data is allocated on first use.
+	const uint64_t cacheSize = static_cast<uint64_t>(cacheSizeMB) * 1024U * 1024U;
+	size_t lineCount = static_cast<size_t>(cacheSize / lineSize);
+	if (lineCount == 0 && cacheSizeMB > 0) {
+		// Always cache at least one line.
+		lineCount = 1;
+	}
+
+	cache.resize(lineCount);
+	for (CacheLine &line : cache) {
+		line.lineIdx = ~0U;
+		line.size = 0;
+		line.lastUsed = 0;
+	}
+	lruCounter = 0;
+}
+
+/**
+ * Find a cache line and mark it as recently used.
+ * NOTE: cacheMutex must be locked by the caller.
+ * @param lineIdx Line index
+ * @return Cache line, or nullptr if the line isn't cached.
+ */
+const SparseDiscReaderPrivate::CacheLine *SparseDiscReaderPrivate::findCacheLine(uint32_t lineIdx)
+{
+	for (CacheLine &line : cache) {
+		if (line.lineIdx == lineIdx) {
+			line.lastUsed = ++lruCounter;
+			return &line;
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * Insert a line into the cache, replacing the least-recently used line.
+ * NOTE: cacheMutex must be locked by the caller.
+ * @param lineIdx	[in] Line index
+ * @param data		[in,out] Line data (swapped with the replaced line's buffer)
+ * @param size		[in] Valid data size
+ */
+void SparseDiscReaderPrivate::insertCacheLine(uint32_t lineIdx, rp::uvector<uint8_t> &data, uint32_t size)
+{
+	assert(!cache.empty());
+
+	// If another thread inserted this line while cacheMutex
+	// was unlocked, replace it instead of caching it twice.
+	CacheLine *lru = &cache[0];
+	for (CacheLine &line : cache) {
+		if (line.lineIdx == lineIdx) {
+			lru = &line;
+			break;
+		}
+		if (line.lastUsed < lru->lastUsed) {
+			lru = &line;
+		}
+	}
+
+	lru->data.swap(data);
+	lru->lineIdx = lineIdx;
+	lru->size = size;
+	lru->lastUsed = ++lruCounter;
+}
+
+/**
+ * Read data directly, bypassing the cache.
+ * The data must not cross a block boundary.
+ * NOTE: cacheMutex must *not* be locked by the caller.
+ * blockMutex is locked by this function.
+ * @param pos	[in] Disc position
+ * @param ptr	[out] Output data buffer
+ * @param size	[in] Amount of data to read, in bytes
+ * @return Number of bytes read, or -1 on error.
+ */
+int SparseDiscReaderPrivate::readDirect(off64_t pos, uint8_t *ptr, size_t size)
+{
+	// Convert the position to a block index and offset.
+	RP_Q(SparseDiscReader);
+	const uint32_t blockIdx = static_cast<uint32_t>(pos / block_size);
+	const int blockPos = static_cast<int>(pos % block_size);
+	MutexLocker blockLocker(blockMutex);
+	return q->readBlock(blockIdx, blockPos, ptr, size);
+}
+
+/**
+ * Read data from the underlying file.
+ * This can be called concurrently from readFullBlock().
+ * NOTE: IRpFile::readAt() can be called concurrently
+ * with itself, so no locking is needed here.
+ * @param pos	[in] Start position
+ * @param ptr	[out] Output data buffer
+ * @param size	[in] Amount of data to read, in bytes
+ * @return Number of bytes read.
+ */
+size_t SparseDiscReaderPrivate::readFileAt(off64_t pos, void *ptr, size_t size)
+{
+	RP_Q(SparseDiscReader);
+	return q->m_file->readAt(pos, ptr, size);
+}
+
 /** SparseDiscReader **/
 
 SparseDiscReader::SparseDiscReader(SparseDiscReaderPrivate *d, const IRpFilePtr &file)
 	: super(file)
 	, d_ptr(d)
-{ }
+{
+	// Sparse disc images are accessed one block at a time,
+	// usually in a non-sequential order.
+	if (m_file) {
+		m_file->advise(0, 0, IRpFile::AH_RANDOM);
+	}
+}
 
 SparseDiscReader::~SparseDiscReader()
 {
@@ -63,79 +199,260 @@ size_t SparseDiscReader::read(void *ptr, size_t size)
 		return -1;
 	}
 
+	const size_t ret = readAt(d->pos, ptr, size);
+	d->pos += ret;
+	return ret;
+}
+
+/**
+ * Read data from the disc image at the specified position.
+ * The disc image position is not changed.
+ * @param pos	[in] Start position.
+ * @param ptr	[out] Output data buffer.
+ * @param size	[in] Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t SparseDiscReader::readAt(off64_t pos, void *ptr, size_t size)
+{
+	RP_D(SparseDiscReader);
+	assert(m_file != nullptr);
+	assert(d->disc_size > 0);
+	assert(d->block_size != 0);
+	if (!m_file || d->disc_size <= 0 || d->block_size == 0) {
+		// Disc image wasn't initialized properly.
+		m_lastError = EBADF;
+		return 0;
+	} else if (pos < 0) {
+		m_lastError = EINVAL;
+		return 0;
+	}
+	IoTrace::Scope trace(IoTrace::Op::ReadAt, typeid(*this).name(), pos, size);
+
 	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
 	size_t ret = 0;
 
 	// Are we already at the end of the disc?
-	if (d->pos >= d->disc_size) {
+	if (pos >= d->disc_size) {
 		// End of the disc.
 		return 0;
 	}
 
-	// Make sure d->pos + size <= d->disc_size.
+	// Make sure pos + size <= d->disc_size.
 	// If it isn't, we'll do a short read.
-	if (d->pos + static_cast<off64_t>(size) >= d->disc_size) {
-		size = static_cast<size_t>(d->disc_size - d->pos);
+	if (pos + static_cast<off64_t>(size) >= d->disc_size) {
+		size = static_cast<size_t>(d->disc_size - pos);
 	}
 
-	// Check if we're not starting on a block boundary.
-	const uint32_t block_size = d->block_size;
-	const uint32_t blockStartOffset = d->pos % block_size;
-	if (blockStartOffset != 0) {
-		// Not a block boundary.
-		// Read the end of the block.
-		uint32_t read_sz = block_size - blockStartOffset;
-		if (size < static_cast<size_t>(read_sz)) {
-			read_sz = static_cast<uint32_t>(size);
+	// NOTE: cacheMutex is only held while accessing the cache.
+	// setCacheSize() may be called while the mutex is unlocked,
+	// so lines are only inserted if the line size hasn't changed.
+	uint32_t lineSize;
+	{
+		MutexLocker cacheLocker(d->cacheMutex);
+		if (d->lineSize == 0) {
+			// Initialize the block cache.
+			d->initCache();
 		}
+		lineSize = d->lineSize;
+	}
 
-		const unsigned int blockIdx = static_cast<unsigned int>(d->pos / block_size);
-		int rd = this->readBlock(blockIdx, blockStartOffset, ptr8, read_sz);
-		if (rd < 0 || rd != static_cast<int>(read_sz)) {
-			// Error reading the data.
-			return (rd > 0 ? rd : 0);
+	rp::uvector<uint8_t> lineBuf;
+	while (size > 0) {
+		const uint32_t lineIdx = static_cast<uint32_t>(pos / lineSize);
+		const uint32_t linePos = static_cast<uint32_t>(pos % lineSize);
+		size_t read_sz = lineSize - linePos;
+		if (size < read_sz) {
+			read_sz = size;
 		}
 
-		// Starting block read.
-		size -= read_sz;
-		ptr8 += read_sz;
-		ret += read_sz;
-		d->pos += read_sz;
-	}
+#ifdef _OPENMP
+		if (linePos == 0 && d->wholeBlocks && d->parallelBlocks &&
+		    size / lineSize >= SparseDiscReaderPrivate::PARALLEL_MIN_BLOCKS)
+		{
+			// Multiple full blocks are being read.
+			// Cached blocks are copied from the cache; the rest are
+			// decompressed in parallel directly into the output buffer.
+			const int count = static_cast<int>(size / lineSize);
+			std::vector<int> toRead;
+			toRead.reserve(count);
+			{
+				MutexLocker cacheLocker(d->cacheMutex);
+				for (int i = 0; i < count; i++) {
+					const SparseDiscReaderPrivate::CacheLine *const cachedLine =
+						(d->lineSize == lineSize ? d->findCacheLine(lineIdx + i) : nullptr);
+					if (cachedLine) {
+						memcpy(ptr8 + (static_cast<size_t>(i) * lineSize), cachedLine->data.data(), lineSize);
+						d->stats.hits++;
+					} else {
+						toRead.push_back(i);
+					}
+				}
+			}
+
+			// NOTE: wholeBlocks is set, so lines are blocks.
+			// readFullBlock() doesn't set m_lastError, since it's
+			// called from multiple threads. The error for the first
+			// failed block is saved and set after the loop.
+			assert(lineSize == d->block_size);
+			int firstErr = count;
+			int firstErrCode = 0;
+			const int readCount = static_cast<int>(toRead.size());
+			#pragma omp parallel for
+			for (int j = 0; j < readCount; j++) {
+				const int i = toRead[j];
+				const int err = readFullBlock(lineIdx + i, ptr8 + (static_cast<size_t>(i) * lineSize));
+				if (err != 0) {
+					// Error reading the data.
+					// Keep track of the first failed block.
+					#pragma omp critical
+					if (i < firstErr) {
+						firstErr = i;
+						firstErrCode = err;
+					}
+				}
+			}
+
+			{
+				MutexLocker cacheLocker(d->cacheMutex);
+				d->stats.bypass += readCount;
+			}
+			const size_t blocks_sz = static_cast<size_t>(firstErr) * lineSize;
+			if (firstErr != count) {
+				// Error reading the data.
+				// Only the blocks before the failed block are returned.
+				m_lastError = -firstErrCode;
+				return trace.ret(ret + blocks_sz);
+			}
+
+			size -= blocks_sz;
+			ptr8 += blocks_sz;
+			ret += blocks_sz;
+			pos += blocks_sz;
+			continue;
+		}
+#endif /* _OPENMP */
+
+		if (linePos == 0 && lineSize == d->block_size && size / lineSize >= 2) {
+			// Multiple full blocks are being read.
+			// Cached blocks are copied from the cache; each run of
+			// uncached blocks is read directly using readBlocks().
+			const unsigned int count = static_cast<unsigned int>(size / lineSize);
+			unsigned int i = 0;
+			while (i < count) {
+				unsigned int runEnd = i + 1;
+				{
+					MutexLocker cacheLocker(d->cacheMutex);
+					const bool lineSizeOK = (d->lineSize == lineSize);
+					const SparseDiscReaderPrivate::CacheLine *const cachedLine =
+						(lineSizeOK ? d->findCacheLine(lineIdx + i) : nullptr);
+					if (cachedLine) {
+						memcpy(ptr8 + (static_cast<size_t>(i) * lineSize), cachedLine->data.data(), lineSize);
+						d->stats.hits++;
+						i++;
+						continue;
+					}
+
+					// Find the end of this run of uncached blocks.
+					while (runEnd < count && !(lineSizeOK && d->findCacheLine(lineIdx + runEnd))) {
+						runEnd++;
+					}
+				}
+
+				const unsigned int runCount = runEnd - i;
+				unsigned int rd;
+				{
+					MutexLocker blockLocker(d->blockMutex);
+					rd = readBlocks(lineIdx + i, runCount, ptr8 + (static_cast<size_t>(i) * lineSize));
+				}
+				{
+					MutexLocker cacheLocker(d->cacheMutex);
+					if (!d->cache.empty()) {
+						d->stats.bypass += rd;
+					}
+				}
+				if (rd != runCount) {
+					// Error reading the data.
+					// Only the blocks before the failed block are returned.
+					return trace.ret(ret + (static_cast<size_t>(i + rd) * lineSize));
+				}
+				i = runEnd;
+			}
+
+			const size_t blocks_sz = static_cast<size_t>(count) * lineSize;
+			size -= blocks_sz;
+			ptr8 += blocks_sz;
+			ret += blocks_sz;
+			pos += blocks_sz;
+			continue;
+		}
 
-	// Read entire blocks.
-	for (; size >= block_size;
-	    size -= block_size, ptr8 += block_size,
-	    ret += block_size, d->pos += block_size)
-	{
-		assert(d->pos % block_size == 0);
-		const unsigned int blockIdx = static_cast<unsigned int>(d->pos / block_size);
-		int rd = this->readBlock(blockIdx, 0, ptr8, block_size);
-		if (rd < 0 || rd != static_cast<int>(block_size)) {
-			// Error reading the data.
-			return ret + (rd > 0 ? rd : 0);
+		// Check if the line is cached.
+		bool cacheEnabled;
+		{
+			MutexLocker cacheLocker(d->cacheMutex);
+			cacheEnabled = (!d->cache.empty() && d->lineSize == lineSize);
+			const SparseDiscReaderPrivate::CacheLine *const cachedLine =
+				(cacheEnabled ? d->findCacheLine(lineIdx) : nullptr);
+			if (cachedLine) {
+				// NOTE: If the entire line is being read, it's still
+				// faster to copy it from the cache.
+				memcpy(ptr8, &cachedLine->data[linePos], read_sz);
+				d->stats.hits++;
+				size -= read_sz;
+				ptr8 += read_sz;
+				ret += read_sz;
+				pos += read_sz;
+				continue;
+			}
+
+			if (cacheEnabled) {
+				if (linePos == 0 && read_sz == lineSize) {
+					// The entire line is being read, so it will bypass the cache.
+					d->stats.bypass++;
+				} else {
+					d->stats.misses++;
+				}
+			}
 		}
-	}
 
-	// Check if we still have data left. (not a full block)
-	if (size > 0) {
-		// Not a full block.
-		assert(d->pos % block_size == 0);
-
-		// Read the start of the block.
-		const unsigned int blockIdx = static_cast<unsigned int>(d->pos / block_size);
-		int rd = this->readBlock(blockIdx, 0, ptr8, size);
-		if (rd < 0 || rd != static_cast<int>(size)) {
-			// Error reading the data.
-			return ret + (rd > 0 ? rd : 0);
+		if (!cacheEnabled || (linePos == 0 && read_sz == lineSize)) {
+			// Cache is disabled, or the entire line is being read.
+			// Read the data directly into the output buffer.
+			const int rd = d->readDirect(pos, ptr8, read_sz);
+			if (rd < 0 || rd != static_cast<int>(read_sz)) {
+				// Error reading the data.
+				return trace.ret(ret + (rd > 0 ? rd : 0));
+			}
+		} else {
+			// Partial line. Read the entire line, then cache it.
+			const off64_t lineStart = static_cast<off64_t>(lineIdx) * lineSize;
+			uint32_t lineValid = lineSize;
+			if (lineStart + lineValid > d->disc_size) {
+				// Last line. Don't read past the end of the disc.
+				lineValid = static_cast<uint32_t>(d->disc_size - lineStart);
+			}
+			lineBuf.resize(lineSize);
+			const int rd = d->readDirect(lineStart, lineBuf.data(), lineValid);
+			if (rd != static_cast<int>(lineValid)) {
+				// Error reading the data.
+				return trace.ret(ret);
+			}
+			memcpy(ptr8, &lineBuf[linePos], read_sz);
+
+			MutexLocker cacheLocker(d->cacheMutex);
+			if (!d->cache.empty() && d->lineSize == lineSize) {
+				d->insertCacheLine(lineIdx, lineBuf, lineValid);
+			}
 		}
 
-		ret += size;
-		d->pos += size;
+		size -= read_sz;
+		ptr8 += read_sz;
+		ret += read_sz;
+		pos += read_sz;
 	}
 
 	// Finished reading the data.
-	return ret;
+	return trace.ret(ret);
 }
 
 /**
@@ -209,6 +526,146 @@ off64_t SparseDiscReader::size(void)
 	return d->disc_size;
 }
 
+/** Access pattern hints **/
+
+/**
+ * Tell the OS how a range of the disc image will be accessed.
+ *
+ * AH_WILLNEED, AH_DONTNEED, and AH_NOREUSE are converted to
+ * physical ranges using getPhysBlockAddr(). Other hints apply
+ * to the entire underlying file, since blocks are usually not
+ * stored in logical order.
+ *
+ * @param pos	[in] Start position.
+ * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+ * @param hint	[in] Access hint.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int SparseDiscReader::advise(off64_t pos, off64_t size, AccessHint hint)
+{
+	RP_D(const SparseDiscReader);
+	if (!m_file || d->disc_size <= 0 || d->block_size == 0) {
+		// Disc image wasn't initialized properly.
+		return -EBADF;
+	} else if (pos < 0 || size < 0) {
+		return -EINVAL;
+	}
+
+	switch (hint) {
+		case AH_WILLNEED:
+		case AH_DONTNEED:
+		case AH_NOREUSE:
+			// Convert the range to physical blocks.
+			break;
+		default:
+			// Access pattern for the entire file.
+			return m_file->advise(0, 0, hint);
+	}
+
+	if (!d->physBlockAddrs) {
+		// Physical block addresses aren't available.
+		return -ENOTSUP;
+	} else if (pos >= d->disc_size) {
+		return 0;
+	}
+
+	// Constrain size based on the disc size.
+	if (size == 0 || size > d->disc_size - pos) {
+		size = d->disc_size - pos;
+	}
+	const off64_t endPos = pos + size;
+
+	// Physically contiguous blocks are combined into a single range.
+	// NOTE: If blocks are compressed, the compressed size isn't known
+	// here, so the entire block_size is used. This may include the
+	// beginning of the next block, which is fine for a hint.
+	const uint32_t blockFirst = static_cast<uint32_t>(pos / d->block_size);
+	const uint32_t blockLast = static_cast<uint32_t>((endPos - 1) / d->block_size);
+	off64_t rangeAddr = 0;
+	off64_t rangeSize = 0;
+	for (uint32_t blockIdx = blockFirst; blockIdx <= blockLast; blockIdx++) {
+		const off64_t physBlockAddr = getPhysBlockAddr(blockIdx);
+		if (physBlockAddr <= 0) {
+			// Empty or invalid block. Nothing to read.
+			continue;
+		}
+
+		// Determine the part of this block that's in the range.
+		off64_t physAddr = physBlockAddr;
+		off64_t physSize = d->block_size;
+		if (!d->wholeBlocks) {
+			const off64_t blockPos = static_cast<off64_t>(blockIdx) * d->block_size;
+			const off64_t startPos = std::max(pos, blockPos);
+			physAddr += (startPos - blockPos);
+			physSize = std::min(endPos, blockPos + d->block_size) - startPos;
+		}
+
+		if (rangeSize != 0 && physAddr == rangeAddr + rangeSize) {
+			// Contiguous with the current range.
+			rangeSize += physSize;
+			continue;
+		}
+
+		if (rangeSize != 0) {
+			const int ret = m_file->advise(rangeAddr, rangeSize, hint);
+			if (ret != 0) {
+				return ret;
+			}
+		}
+		rangeAddr = physAddr;
+		rangeSize = physSize;
+	}
+
+	return (rangeSize != 0) ? m_file->advise(rangeAddr, rangeSize, hint) : 0;
+}
+
+/** Block cache **/
+
+/**
+ * Set the block cache size.
+ *
+ * Blocks are cached using an LRU cache, so alternating reads
+ * from a few areas of the disc, e.g. the FST and the banner,
+ * don't need to read and decompress the same blocks again.
+ * Reads that cover entire cache lines bypass the cache.
+ *
+ * Blocks that are compressed separately are cached in full.
+ * Other blocks are cached in lines of up to 64 KB.
+ *
+ * Any cached blocks are discarded.
+ *
+ * @param sizeMB Cache size, in MB. (0 to disable the cache)
+ */
+void SparseDiscReader::setCacheSize(unsigned int sizeMB)
+{
+	RP_D(SparseDiscReader);
+	MutexLocker cacheLocker(d->cacheMutex);
+	d->cacheSizeMB = sizeMB;
+	d->cache.clear();
+	d->lineSize = 0;	// The cache will be reinitialized on the next read.
+}
+
+/**
+ * Get the cache statistics.
+ * @return Cache statistics
+ */
+SparseDiscReader::CacheStats SparseDiscReader::cacheStats(void) const
+{
+	RP_D(const SparseDiscReader);
+	MutexLocker cacheLocker(d->cacheMutex);
+	return d->stats;
+}
+
+/**
+ * Reset the cache statistics.
+ */
+void SparseDiscReader::resetCacheStats(void)
+{
+	RP_D(SparseDiscReader);
+	MutexLocker cacheLocker(d->cacheMutex);
+	d->stats = CacheStats();
+}
+
 /** SparseDiscReader **/
 
 /**
@@ -258,9 +715,62 @@ int SparseDiscReader::readBlock(uint32_t blockIdx, int pos, void *ptr, size_t si
 	}
 
 	// Read from the block.
-	size_t sz_read = m_file->seekAndRead(physBlockAddr + pos, ptr, size);
+	size_t sz_read = m_file->readAt(physBlockAddr + pos, ptr, size);
 	m_lastError = m_file->lastError();
 	return (sz_read > 0 ? (int)sz_read : -1);
 }
 
+/**
+ * Read multiple full blocks.
+ *
+ * The default implementation calls readBlock() for each block.
+ * Subclasses can override this if consecutive blocks can be
+ * read more efficiently, e.g. with a single file read.
+ *
+ * NOTE: This is only used if blocks aren't split into
+ * multiple cache lines.
+ *
+ * @param blockIdx	[in] First block index.
+ * @param count		[in] Number of blocks to read.
+ * @param ptr		[out] Output data buffer. (Must be at least count * block_size bytes!)
+ * @return Number of full blocks read. (Less than count on error.)
+ */
+unsigned int SparseDiscReader::readBlocks(uint32_t blockIdx, unsigned int count, void *ptr)
+{
+	RP_D(const SparseDiscReader);
+	const unsigned int block_size = d->block_size;
+	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
+	for (unsigned int i = 0; i < count; i++, ptr8 += block_size) {
+		const int rd = readBlock(blockIdx + i, 0, ptr8, block_size);
+		if (rd != static_cast<int>(block_size)) {
+			// Error reading the block.
+			return i;
+		}
+	}
+	return count;
+}
+
+/**
+ * Read a full block. (thread-safe)
+ *
+ * If parallelBlocks is set in the private class, this is used
+ * to read multiple full blocks in parallel. It may be called
+ * concurrently from multiple threads, so it must not modify
+ * any shared state, including m_lastError and m_file.
+ * Use readFileAt() in the private class to read the file.
+ *
+ * Subclasses that set parallelBlocks must override this.
+ *
+ * @param blockIdx	[in] Block index.
+ * @param ptr		[out] Output data buffer. (Must be block_size bytes!)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int SparseDiscReader::readFullBlock(uint32_t blockIdx, void *ptr)
+{
+	RP_UNUSED(blockIdx);
+	RP_UNUSED(ptr);
+	assert(!"SparseDiscReader::readFullBlock() is not implemented.");
+	return -ENOTSUP;
+}
+
 }
@@ -3,13 +3,14 @@
  * SparseDiscReader.hpp: Disc reader base class for disc image formats     *
  * that use sparse and/or compressed blocks, e.g. CISO, WBFS, GCZ.         *
  *                                                                         *
- * Copyright (c) 2016-2023 by David Korth.                                 *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
  * SPDX-License-Identifier: GPL-2.0-or-later                               *
  ***************************************************************************/
 
 #pragma once
 
 #include "IDiscReader.hpp"
+#include "dll-macros.h"	// for RP_LIBROMDATA_PUBLIC
 
 namespace LibRpBase {
 
@@ -40,6 +41,17 @@ class NOVTABLE SparseDiscReader : public IDiscReader
 		ATTR_ACCESS_SIZE(write_only, 2, 3)
 		size_t read(void *ptr, size_t size) final;
 
+		/**
+		 * Read data from the disc image at the specified position.
+		 * The disc image position is not changed.
+		 * @param pos	[in] Start position.
+		 * @param ptr	[out] Output data buffer.
+		 * @param size	[in] Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		size_t readAt(off64_t pos, void *ptr, size_t size) final;
+
 		/**
 		 * Set the disc image position.
 		 * @param pos disc image position.
@@ -59,6 +71,70 @@ class NOVTABLE SparseDiscReader : public IDiscReader
 		 */
 		off64_t size(void) final;
 
+	public:
+		/** Access pattern hints **/
+
+		/**
+		 * Tell the OS how a range of the disc image will be accessed.
+		 *
+		 * AH_WILLNEED, AH_DONTNEED, and AH_NOREUSE are converted to
+		 * physical ranges using getPhysBlockAddr(). Other hints apply
+		 * to the entire underlying file, since blocks are usually not
+		 * stored in logical order.
+		 *
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+		 * @param hint	[in] Access hint.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int advise(off64_t pos, off64_t size, AccessHint hint) final;
+
+	public:
+		/** Block cache **/
+
+		// Default block cache size, in MB.
+		static constexpr unsigned int DEFAULT_CACHE_SIZE_MB = 2;
+
+		/**
+		 * Set the block cache size.
+		 *
+		 * Blocks are cached using an LRU cache, so alternating reads
+		 * from a few areas of the disc, e.g. the FST and the banner,
+		 * don't need to read and decompress the same blocks again.
+		 * Reads that cover entire cache lines bypass the cache.
+		 *
+		 * Blocks that are compressed separately are cached in full.
+		 * Other blocks are cached in lines of up to 64 KB.
+		 *
+		 * Any cached blocks are discarded.
+		 *
+		 * @param sizeMB Cache size, in MB. (0 to disable the cache)
+		 */
+		RP_LIBROMDATA_PUBLIC
+		void setCacheSize(unsigned int sizeMB);
+
+		/**
+		 * Cache statistics.
+		 */
+		struct CacheStats {
+			uint64_t hits;		// Line lookups satisfied by the cache
+			uint64_t misses;	// Line lookups that required reading a block
+			uint64_t bypass;	// Full-line reads passed directly to readBlock()
+		};
+
+		/**
+		 * Get the cache statistics.
+		 * @return Cache statistics
+		 */
+		RP_LIBROMDATA_PUBLIC
+		CacheStats cacheStats(void) const;
+
+		/**
+		 * Reset the cache statistics.
+		 */
+		RP_LIBROMDATA_PUBLIC
+		void resetCacheStats(void);
+
 	protected:
 		/** Virtual functions for SparseDiscReader subclasses. **/
 
@@ -85,6 +161,15 @@ class NOVTABLE SparseDiscReader : public IDiscReader
 		 * though usually it isn't needed. Override getPhysBlockAddr()
 		 * instead.
 		 *
+		 * NOTE: Blocks are cached by SparseDiscReader, so subclasses
+		 * shouldn't cache blocks themselves. If wholeBlocks is set in
+		 * the private class, cached reads will always be full blocks.
+		 * If parallelBlocks is also set, large reads will use
+		 * readFullBlock() instead.
+		 *
+		 * NOTE: SparseDiscReader doesn't call readBlock() or readBlocks()
+		 * concurrently, but readFullBlock() may be running at the same time.
+		 *
 		 * @param blockIdx	[in] Block index.
 		 * @param pos		[in] Starting position. (Must be >= 0 and <= the block size!)
 		 * @param ptr		[out] Output data buffer.
@@ -93,6 +178,40 @@ class NOVTABLE SparseDiscReader : public IDiscReader
 		 */
 		ATTR_ACCESS_SIZE(write_only, 4, 5)
 		virtual int readBlock(uint32_t blockIdx, int pos, void *ptr, size_t size);
+
+		/**
+		 * Read a full block. (thread-safe)
+		 *
+		 * If parallelBlocks is set in the private class, this is used
+		 * to read multiple full blocks in parallel. It may be called
+		 * concurrently from multiple threads, so it must not modify
+		 * any shared state, including m_lastError and m_file.
+		 * Use readFileAt() in the private class to read the file.
+		 *
+		 * Subclasses that set parallelBlocks must override this.
+		 *
+		 * @param blockIdx	[in] Block index.
+		 * @param ptr		[out] Output data buffer. (Must be block_size bytes!)
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		virtual int readFullBlock(uint32_t blockIdx, void *ptr);
+
+		/**
+		 * Read multiple full blocks.
+		 *
+		 * The default implementation calls readBlock() for each block.
+		 * Subclasses can override this if consecutive blocks can be
+		 * read more efficiently, e.g. with a single file read.
+		 *
+		 * NOTE: This is only used if blocks aren't split into
+		 * multiple cache lines.
+		 *
+		 * @param blockIdx	[in] First block index.
+		 * @param count		[in] Number of blocks to read.
+		 * @param ptr		[out] Output data buffer. (Must be at least count * block_size bytes!)
+		 * @return Number of full blocks read. (Less than count on error.)
+		 */
+		virtual unsigned int readBlocks(uint32_t blockIdx, unsigned int count, void *ptr);
 };
 
 }
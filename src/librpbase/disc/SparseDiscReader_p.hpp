@@ -13,6 +13,15 @@
 #include <cstdint>
 #include "common.h"
 
+// C++ includes
+#include <vector>
+#include "uvector.h"
+
+// librpthreads
+#include "librpthreads/Mutex.hpp"
+
+#include "SparseDiscReader.hpp"
+
 namespace LibRpBase {
 
 class SparseDiscReader;
@@ -33,6 +42,105 @@ class SparseDiscReaderPrivate
 		off64_t disc_size;		// Virtual disc image size.
 		off64_t pos;			// Read position.
 		unsigned int block_size;	// Block size.
+
+		// Set this to true if blocks must be read in full,
+		// e.g. if each block is compressed separately.
+		// Otherwise, large blocks are cached in smaller lines.
+		bool wholeBlocks;
+
+		// Set this to true if readFullBlock() is implemented.
+		// Large reads will then decompress multiple blocks in parallel.
+		bool parallelBlocks;
+
+		// Set this to true if getPhysBlockAddr() is implemented.
+		// advise() uses it to convert hints to physical ranges.
+		// If wholeBlocks is false, each block must be stored
+		// uncompressed, so partial blocks can be advised.
+		bool physBlockAddrs;
+
+		// Minimum number of full blocks for a parallel read.
+		static constexpr unsigned int PARALLEL_MIN_BLOCKS = 4;
+
+		/**
+		 * Read data from the underlying file.
+		 * This can be called concurrently from readFullBlock().
+		 * NOTE: IRpFile::readAt() can be called concurrently
+		 * with itself, so no locking is needed here.
+		 * @param pos	[in] Start position
+		 * @param ptr	[out] Output data buffer
+		 * @param size	[in] Amount of data to read, in bytes
+		 * @return Number of bytes read.
+		 */
+		size_t readFileAt(off64_t pos, void *ptr, size_t size);
+
+	public:
+		/** Block cache **/
+
+		// Maximum cache line size for blocks that don't need
+		// to be read in full.
+		static constexpr unsigned int MAX_CACHE_LINE_SIZE = 64U * 1024U;
+
+		// Cache line. Each line is one block, or part of a block.
+		struct CacheLine {
+			uint32_t lineIdx;	// Line index (~0U if empty)
+			uint32_t size;		// Valid data size (may be short at the end of the disc)
+			uint64_t lastUsed;	// LRU counter value at last use
+			rp::uvector<uint8_t> data;
+		};
+		std::vector<CacheLine> cache;
+		unsigned int cacheSizeMB;	// Cache size, in MB (0 to disable)
+		unsigned int lineSize;		// Cache line size (0 if not initialized yet)
+		uint64_t lruCounter;
+
+		SparseDiscReader::CacheStats stats;
+
+		// Mutex for the block cache and statistics.
+		// readAt() may be called concurrently. This mutex is only
+		// held while looking up or inserting cache lines, so cache
+		// hits don't wait for another thread's I/O.
+		mutable LibRpThreads::Mutex cacheMutex;
+
+		// Mutex for readBlock() and readBlocks().
+		// Subclasses may keep per-reader state for these, e.g. a
+		// decompression buffer, so calls from readAt() are serialized.
+		// readFullBlock() is thread-safe and doesn't use this mutex.
+		LibRpThreads::Mutex blockMutex;
+
+		/**
+		 * Initialize the block cache.
+		 * block_size must be set by the subclass first.
+		 * NOTE: cacheMutex must be locked by the caller.
+		 */
+		void initCache(void);
+
+		/**
+		 * Find a cache line and mark it as recently used.
+		 * NOTE: cacheMutex must be locked by the caller.
+		 * @param lineIdx Line index
+		 * @return Cache line, or nullptr if the line isn't cached.
+		 */
+		const CacheLine *findCacheLine(uint32_t lineIdx);
+
+		/**
+		 * Insert a line into the cache, replacing the least-recently used line.
+		 * NOTE: cacheMutex must be locked by the caller.
+		 * @param lineIdx	[in] Line index
+		 * @param data		[in,out] Line data (swapped with the replaced line's buffer)
+		 * @param size		[in] Valid data size
+		 */
+		void insertCacheLine(uint32_t lineIdx, rp::uvector<uint8_t> &data, uint32_t size);
+
+		/**
+		 * Read data directly, bypassing the cache.
+		 * The data must not cross a block boundary.
+		 * NOTE: cacheMutex must *not* be locked by the caller.
+		 * blockMutex is locked by this function.
+		 * @param pos	[in] Disc position
+		 * @param ptr	[out] Output data buffer
+		 * @param size	[in] Amount of data to read, in bytes
+		 * @return Number of bytes read, or -1 on error.
+		 */
+		int readDirect(off64_t pos, uint8_t *ptr, size_t size);
 };
 
 }
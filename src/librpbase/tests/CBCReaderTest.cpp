@@ -15,8 +15,15 @@
 // CBCReader
 #include "../disc/CBCReader.hpp"
 
+// librpbase
+#ifdef ENABLE_DECRYPTION
+#  include "../crypto/AesCipherFactory.hpp"
+#  include "../crypto/IAesCipher.hpp"
+#endif /* ENABLE_DECRYPTION */
+
 // librpfile
 #include "librpfile/MemFile.hpp"
+using LibRpFile::IRpFile;
 using LibRpFile::IRpFilePtr;
 using LibRpFile::MemFile;
 
@@ -25,11 +32,15 @@ using LibRpFile::MemFile;
 
 // C++ includes
 #include <array>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 using std::array;
 using std::ostringstream;
 using std::string;
+using std::unique_ptr;
+using std::vector;
 
 namespace LibRpBase { namespace Tests {
 
@@ -364,6 +375,281 @@ TEST_P(CBCReaderTest, decryptLast8Bytes)
 		EXPECT_EQ(0x55, decrypted[i]);
 	}
 }
+
+/**
+ * Decrypt the full data using small, unaligned sequential reads.
+ * Each read should reuse the IV saved by the previous read.
+ */
+TEST_P(CBCReaderTest, decryptSequentialSmallReads)
+{
+	static const uint8_t sizes[] = {5, 3, 8, 20, 1, 15, 12};
+
+	array<uint8_t, sizeof(plaintext)> decrypted;
+	size_t pos = 0;
+	for (unsigned int i = 0; pos < decrypted.size(); i++) {
+		const size_t sz = std::min(static_cast<size_t>(sizes[i % ARRAY_SIZE(sizes)]), decrypted.size() - pos);
+		EXPECT_EQ(sz, m_cbcReader->read(&decrypted[pos], sz));
+		pos += sz;
+	}
+	EXPECT_EQ(decrypted.size(), m_cbcReader->tell());
+
+	// Compare the decrypted data to the known plaintext.
+	CompareByteArrays(reinterpret_cast<const uint8_t*>(plaintext),
+		decrypted.data(), decrypted.size(), "Sequential small reads");
+}
+
+/**
+ * Decrypt data using random seeks, including repeated seeks
+ * to the same blocks.
+ */
+TEST_P(CBCReaderTest, decryptRandomSeeks)
+{
+	static const uint8_t offsets[] = {0x30, 0x20, 0x10, 0x00, 0x28, 0x14, 0x30, 0x04, 0x3C, 0x20};
+
+	for (const uint8_t offset : offsets) {
+		array<uint8_t, 12> decrypted;
+		const size_t sz = std::min(decrypted.size(), sizeof(plaintext) - offset);
+		EXPECT_EQ(sz, m_cbcReader->seekAndRead(offset, decrypted.data(), sz));
+		EXPECT_EQ(offset + sz, static_cast<size_t>(m_cbcReader->tell()));
+
+		// Compare the decrypted data to the known plaintext.
+		ostringstream oss;
+		oss << "Offset 0x" << std::hex << static_cast<unsigned int>(offset);
+		CompareByteArrays(reinterpret_cast<const uint8_t*>(&plaintext[offset]),
+			decrypted.data(), sz, oss.str().c_str());
+	}
+}
+#endif /* ENABLE_DECRYPTION */
+
+#ifdef ENABLE_DECRYPTION
+/**
+ * CBCReader tests using a large amount of data.
+ * These tests use the read/decrypt pipeline and read-ahead.
+ */
+class CBCReaderLargeTest : public ::testing::TestWithParam<CryptoMode>
+{
+protected:
+	void SetUp(void) final;
+	void TearDown(void) final;
+
+public:
+	static void SetUpTestSuite(void);
+	static void TearDownTestSuite(void);
+
+public:
+	// Data size: Not a multiple of the pipeline chunk size.
+	static constexpr size_t DATA_SIZE = (3U * 1024U * 1024U) + 48U;
+
+	// Ciphertext (random data) and the expected plaintext
+	// for each crypto mode, decrypted all at once.
+	static vector<uint8_t> ciphertext;
+	static vector<uint8_t> plaintext_ecb;
+	static vector<uint8_t> plaintext_cbc;
+
+	CBCReaderPtr m_cbcReader;
+	IRpFilePtr m_memFile;
+	const uint8_t *m_plaintext;
+
+	/**
+	 * Check decrypted data against the expected plaintext.
+	 * @param pos	[in] Position
+	 * @param data	[in] Decrypted data
+	 * @param size	[in] Size
+	 * @return True if the data matches; false if not.
+	 */
+	bool checkData(size_t pos, const uint8_t *data, size_t size) const
+	{
+		return !memcmp(&m_plaintext[pos], data, size);
+	}
+};
+
+vector<uint8_t> CBCReaderLargeTest::ciphertext;
+vector<uint8_t> CBCReaderLargeTest::plaintext_ecb;
+vector<uint8_t> CBCReaderLargeTest::plaintext_cbc;
+
+void CBCReaderLargeTest::SetUpTestSuite(void)
+{
+	ciphertext.resize(DATA_SIZE);
+	uint32_t seed = 0x13579BDF;
+	for (uint8_t &p : ciphertext) {
+		seed = seed * 1103515245U + 12345U;
+		p = static_cast<uint8_t>(seed >> 16);
+	}
+
+	unique_ptr<IAesCipher> cipher(AesCipherFactory::create());
+	ASSERT_TRUE(cipher != nullptr);
+	ASSERT_EQ(0, cipher->setKey(CBCReaderTest::aes_key.data(), CBCReaderTest::aes_key.size()));
+
+	plaintext_ecb = ciphertext;
+	ASSERT_EQ(0, cipher->setChainingMode(IAesCipher::ChainingMode::ECB));
+	ASSERT_EQ(DATA_SIZE, cipher->decrypt(plaintext_ecb.data(), plaintext_ecb.size()));
+
+	plaintext_cbc = ciphertext;
+	ASSERT_EQ(0, cipher->setChainingMode(IAesCipher::ChainingMode::CBC));
+	ASSERT_EQ(0, cipher->setIV(CBCReaderTest::aes_iv.data(), CBCReaderTest::aes_iv.size()));
+	ASSERT_EQ(DATA_SIZE, cipher->decrypt(plaintext_cbc.data(), plaintext_cbc.size()));
+}
+
+void CBCReaderLargeTest::TearDownTestSuite(void)
+{
+	ciphertext.clear();
+	ciphertext.shrink_to_fit();
+	plaintext_ecb.clear();
+	plaintext_ecb.shrink_to_fit();
+	plaintext_cbc.clear();
+	plaintext_cbc.shrink_to_fit();
+}
+
+/**
+ * SetUp() function.
+ * Run before each test.
+ */
+void CBCReaderLargeTest::SetUp(void)
+{
+	ASSERT_EQ(DATA_SIZE, ciphertext.size());
+	m_memFile = std::make_shared<MemFile>(ciphertext.data(), ciphertext.size());
+
+	if (GetParam() == CryptoMode::CBC) {
+		m_cbcReader = std::make_shared<CBCReader>(m_memFile, 0, DATA_SIZE,
+			CBCReaderTest::aes_key.data(), CBCReaderTest::aes_iv.data());
+		m_plaintext = plaintext_cbc.data();
+	} else {
+		m_cbcReader = std::make_shared<CBCReader>(m_memFile, 0, DATA_SIZE,
+			CBCReaderTest::aes_key.data(), nullptr);
+		m_plaintext = plaintext_ecb.data();
+	}
+	ASSERT_TRUE(m_cbcReader->isOpen());
+	ASSERT_EQ(static_cast<off64_t>(DATA_SIZE), m_cbcReader->size());
+}
+
+/**
+ * TearDown() function.
+ * Run after each test.
+ */
+void CBCReaderLargeTest::TearDown(void)
+{
+	m_cbcReader.reset();
+	m_memFile.reset();
+}
+
+/**
+ * Decrypt the full data using a single read.
+ */
+TEST_P(CBCReaderLargeTest, decryptFull)
+{
+	vector<uint8_t> decrypted(DATA_SIZE);
+	EXPECT_EQ(DATA_SIZE, m_cbcReader->read(decrypted.data(), decrypted.size()));
+	EXPECT_EQ(static_cast<off64_t>(DATA_SIZE), m_cbcReader->tell());
+	EXPECT_TRUE(checkData(0, decrypted.data(), decrypted.size()));
+}
+
+/**
+ * Decrypt large reads that don't start on a block boundary.
+ */
+TEST_P(CBCReaderLargeTest, decryptLargeUnalignedReads)
+{
+	static const size_t offsets[] = {0x12345, 0x200008, 0x3, 0x100000};
+	static constexpr size_t READ_SIZE = (1024U * 1024U) + 5U;
+
+	vector<uint8_t> decrypted(READ_SIZE);
+	for (const size_t offset : offsets) {
+		ASSERT_EQ(READ_SIZE, m_cbcReader->seekAndRead(offset, decrypted.data(), READ_SIZE));
+		EXPECT_TRUE(checkData(offset, decrypted.data(), READ_SIZE)) << "offset == " << offset;
+	}
+}
+
+/**
+ * Decrypt the full data using 64 KB sequential reads,
+ * as done by IRpFile::copyTo().
+ * Read-ahead is not used without advise(AH_SEQUENTIAL).
+ */
+TEST_P(CBCReaderLargeTest, decryptSequentialReads)
+{
+	static constexpr size_t READ_SIZE = 64U * 1024U;
+
+	vector<uint8_t> decrypted(DATA_SIZE);
+	for (size_t pos = 0; pos < DATA_SIZE; pos += READ_SIZE) {
+		const size_t sz = std::min(READ_SIZE, DATA_SIZE - pos);
+		ASSERT_EQ(sz, m_cbcReader->read(&decrypted[pos], sz)) << "pos == " << pos;
+	}
+	EXPECT_EQ(static_cast<off64_t>(DATA_SIZE), m_cbcReader->tell());
+	EXPECT_TRUE(checkData(0, decrypted.data(), decrypted.size()));
+}
+
+/**
+ * Decrypt the full data using 64 KB sequential reads after
+ * advise(AH_SEQUENTIAL), then switch back to AH_NORMAL.
+ */
+TEST_P(CBCReaderLargeTest, decryptSequentialReadsWithCopyToHint)
+{
+	// NOTE: MemFile doesn't support advise(), but CBCReader still uses the hint.
+	m_cbcReader->advise(0, 0, IRpFile::AH_SEQUENTIAL);
+
+	static constexpr size_t READ_SIZE = 64U * 1024U;
+	vector<uint8_t> decrypted(DATA_SIZE);
+	for (size_t pos = 0; pos < DATA_SIZE; pos += READ_SIZE) {
+		const size_t sz = std::min(READ_SIZE, DATA_SIZE - pos);
+		ASSERT_EQ(sz, m_cbcReader->read(&decrypted[pos], sz)) << "pos == " << pos;
+	}
+	EXPECT_EQ(static_cast<off64_t>(DATA_SIZE), m_cbcReader->tell());
+	EXPECT_TRUE(checkData(0, decrypted.data(), decrypted.size()));
+
+	// Reads after AH_NORMAL use the block-based reader again.
+	m_cbcReader->advise(0, 0, IRpFile::AH_NORMAL);
+	static constexpr size_t offset = 0x123457;
+	ASSERT_EQ(READ_SIZE, m_cbcReader->seekAndRead(offset, decrypted.data(), READ_SIZE));
+	EXPECT_TRUE(checkData(offset, decrypted.data(), READ_SIZE));
+}
+
+/**
+ * Decrypt data using odd-sized sequential reads after advise(AH_SEQUENTIAL),
+ * including a seek into the middle of the data.
+ */
+TEST_P(CBCReaderLargeTest, decryptSequentialReadsWithHint)
+{
+	// NOTE: MemFile doesn't support advise(), but CBCReader still uses the hint.
+	m_cbcReader->advise(0, 0, IRpFile::AH_SEQUENTIAL);
+
+	vector<uint8_t> decrypted(DATA_SIZE);
+	static const size_t starts[] = {0, 0x1FFFF7};
+	for (const size_t start : starts) {
+		ASSERT_EQ(0, m_cbcReader->seek(start));
+		size_t pos = start;
+		size_t chunk = 1;
+		while (pos < DATA_SIZE) {
+			const size_t sz = std::min(chunk, DATA_SIZE - pos);
+			ASSERT_EQ(sz, m_cbcReader->read(&decrypted[pos], sz)) << "pos == " << pos;
+			pos += sz;
+			chunk = (chunk * 7 + 13) % 40000 + 1;
+		}
+		EXPECT_TRUE(checkData(start, &decrypted[start], DATA_SIZE - start)) << "start == " << start;
+	}
+}
+
+/**
+ * Decrypt data using small sequential reads after advise(AH_RANDOM).
+ * Read-ahead is disabled.
+ */
+TEST_P(CBCReaderLargeTest, decryptSmallReadsWithRandomHint)
+{
+	// NOTE: MemFile doesn't support advise(), but CBCReader still uses the hint.
+	m_cbcReader->advise(0, 0, IRpFile::AH_RANDOM);
+
+	static constexpr size_t CHECK_SIZE = 64U * 1024U;
+	static constexpr size_t READ_SIZE = 100;
+	vector<uint8_t> decrypted(CHECK_SIZE);
+	for (size_t pos = 0; pos < CHECK_SIZE; pos += READ_SIZE) {
+		const size_t sz = std::min(READ_SIZE, CHECK_SIZE - pos);
+		ASSERT_EQ(sz, m_cbcReader->read(&decrypted[pos], sz)) << "pos == " << pos;
+	}
+	EXPECT_TRUE(checkData(0, decrypted.data(), decrypted.size()));
+}
+
+INSTANTIATE_TEST_SUITE_P(CBCReaderLargeTest, CBCReaderLargeTest,
+	::testing::Values(CryptoMode::ECB, CryptoMode::CBC),
+	[](const ::testing::TestParamInfo<CryptoMode> &info) -> string {
+		return (info.param == CryptoMode::CBC ? "CBC" : "ECB");
+	});
 #endif /* ENABLE_DECRYPTION */
 
 #ifdef ENABLE_DECRYPTION
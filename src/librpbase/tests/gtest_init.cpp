@@ -56,6 +56,7 @@ int RP_C_API _tmain(int argc, TCHAR *argv[])
 		SCMP_SYS(mprotect),	// iconv_open()
 		SCMP_SYS(munmap),	// free() [in some cases]
 		SCMP_SYS(lseek), SCMP_SYS(_llseek),
+		SCMP_SYS(pread64), SCMP_SYS(preadv),	// IRpFile::readAt(), readAtV()
 		SCMP_SYS(lstat), SCMP_SYS(lstat64),		// LibRpBase::FileSystem::is_symlink(), resolve_symlink()
 		SCMP_SYS(open),		// Ubuntu 16.04
 		SCMP_SYS(openat),	// glibc-2.31
@@ -68,6 +69,17 @@ int RP_C_API _tmain(int argc, TCHAR *argv[])
 		// for ImageDecoderTest so we don't have to copy the test files to the binary directory
 		SCMP_SYS(chdir),
 
+#ifdef RP_TEST_ALLOW_WPATH
+		// for GzIndexTest (temporary files and the index cache)
+		SCMP_SYS(mkdir),
+		SCMP_SYS(rename), SCMP_SYS(renameat),
+#  if defined(__SNR_renameat2)
+		SCMP_SYS(renameat2),
+#  elif defined(__NR_renameat2)
+		__NR_renameat2,
+#  endif /* __SNR_renameat2 || __NR_renameat2 */
+#endif /* RP_TEST_ALLOW_WPATH */
+
 		// Google Test
 		SCMP_SYS(getcwd),	// testing::internal::FilePath::GetCurrentDir()
 					// - testing::internal::UnitTestImpl::AddTestInfo()
@@ -89,6 +101,7 @@ int RP_C_API _tmain(int argc, TCHAR *argv[])
 		// for posix_fadvise()
 		SCMP_SYS(fadvise64), SCMP_SYS(fadvise64_64),
 		SCMP_SYS(arm_fadvise64_64),	// CPU-specific syscall for Linux on 32-bit ARM
+		SCMP_SYS(madvise),	// IRpFile::advise() [memory-mapped files]
 
 		// for Google Test Death Tests when spawning a new process
 		SCMP_SYS(pipe), SCMP_SYS(pipe2),
@@ -106,9 +119,18 @@ int RP_C_API _tmain(int argc, TCHAR *argv[])
 	// Promises:
 	// - stdio: General stdio functionality.
 	// - rpath: Read test cases.
+#  ifdef RP_TEST_ALLOW_WPATH
+	// - wpath, cpath: Temporary files. (GzIndexTest)
+	param.promises = "stdio rpath wpath cpath";
+#  else /* !RP_TEST_ALLOW_WPATH */
 	param.promises = "stdio rpath";
+#  endif /* RP_TEST_ALLOW_WPATH */
 #elif defined(HAVE_TAME)
+#  ifdef RP_TEST_ALLOW_WPATH
+	param.tame_flags = TAME_STDIO | TAME_RPATH | TAME_WPATH | TAME_CPATH;
+#  else /* !RP_TEST_ALLOW_WPATH */
 	param.tame_flags = TAME_STDIO | TAME_RPATH;
+#  endif /* RP_TEST_ALLOW_WPATH */
 #else
 	param.dummy = 0;
 #endif
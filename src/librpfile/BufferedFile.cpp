@@ -0,0 +1,751 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * BufferedFile.cpp: Read-coalescing block cache wrapper for IRpFile.      *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "stdafx.h"
+#include "BufferedFile.hpp"
+
+// C++ includes
+#include <vector>
+#include "uvector.h"
+
+// librpthreads
+#include "librpthreads/Mutex.hpp"
+using LibRpThreads::Mutex;
+using LibRpThreads::MutexLocker;
+
+// C++ STL classes
+using std::vector;
+
+namespace LibRpFile {
+
+/** BufferedFilePrivate **/
+
+class BufferedFilePrivate
+{
+	public:
+		BufferedFilePrivate(BufferedFile *q, const IRpFilePtr &file,
+			unsigned int blockSize, unsigned int blockCount);
+
+	private:
+		RP_DISABLE_COPY(BufferedFilePrivate)
+		BufferedFile *const q_ptr;
+
+	public:
+		IRpFilePtr file;	// Underlying file
+		off64_t pos;		// Current position
+		off64_t fileSize;	// File size
+
+		unsigned int blockSize;	// Block size (power of two)
+
+		// Cached block
+		struct Block {
+			off64_t blockIdx;	// Block index (-1 if empty)
+			uint64_t lastUsed;	// LRU counter value at last use
+			size_t validSize;	// Valid bytes in the block (less than blockSize at EOF)
+			uint8_t *data;		// Points into blockData
+		};
+		vector<Block> blocks;
+		rp::uvector<uint8_t> blockData;
+		uint64_t lruCounter;
+
+		// Incremented whenever blocks are invalidated.
+		// A block read without the mutex held is only inserted
+		// if this hasn't changed, so stale data isn't cached.
+		uint64_t generation;
+
+		BufferedFile::Stats stats;
+
+		// Mutex for the block cache and statistics.
+		// readAt() may be called concurrently. The mutex is *not*
+		// held while reading from the underlying file, so parallel
+		// readers don't block each other on I/O.
+		mutable Mutex mutex;
+
+	public:
+		/**
+		 * Read from the underlying file.
+		 * This uses readAt(), so the underlying file's position
+		 * isn't used or changed.
+		 * NOTE: Mutex must *not* be locked by the caller.
+		 * @param file	[in] Underlying file
+		 * @param pos	[in] Start position.
+		 * @param ptr	[out] Output data buffer.
+		 * @param size	[in] Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		size_t baseRead(const IRpFilePtr &file, off64_t pos, void *ptr, size_t size);
+
+		/**
+		 * Find a cached block.
+		 * NOTE: Mutex must be locked by the caller.
+		 * @param blockIdx Block index
+		 * @return Block, or nullptr if it isn't cached.
+		 */
+		const Block *findBlock(off64_t blockIdx);
+
+		/**
+		 * Insert a block into the cache, replacing the least-recently used block.
+		 * NOTE: Mutex must be locked by the caller.
+		 * @param blockIdx	[in] Block index
+		 * @param data		[in] Block data
+		 * @param validSize	[in] Valid bytes in data
+		 */
+		void insertBlock(off64_t blockIdx, const uint8_t *data, size_t validSize);
+
+		/**
+		 * Invalidate cached blocks that overlap the specified range.
+		 * NOTE: Mutex must be locked by the caller.
+		 * @param pos Start position
+		 * @param size Size
+		 */
+		void invalidateRange(off64_t pos, off64_t size);
+
+		/**
+		 * Invalidate all cached blocks.
+		 * NOTE: Mutex must be locked by the caller.
+		 */
+		void invalidateAll(void);
+};
+
+BufferedFilePrivate::BufferedFilePrivate(BufferedFile *q, const IRpFilePtr &file,
+	unsigned int blockSize, unsigned int blockCount)
+	: q_ptr(q)
+	, file(file)
+	, pos(0)
+	, fileSize(0)
+	, blockSize(blockSize)
+	, lruCounter(0)
+	, generation(0)
+	, stats{}
+{
+	// Block size must be a power of two.
+	assert(blockSize != 0 && (blockSize & (blockSize - 1)) == 0);
+	if (blockSize == 0 || (blockSize & (blockSize - 1)) != 0) {
+		this->blockSize = BufferedFile::DEFAULT_BLOCK_SIZE;
+	}
+	assert(blockCount != 0);
+	if (blockCount == 0) {
+		blockCount = BufferedFile::DEFAULT_BLOCK_COUNT;
+	}
+
+	blockData.resize(static_cast<size_t>(this->blockSize) * blockCount);
+	blocks.resize(blockCount);
+	uint8_t *p = blockData.data();
+	for (Block &block : blocks) {
+		block.blockIdx = -1;
+		block.lastUsed = 0;
+		block.validSize = 0;
+		block.data = p;
+		p += this->blockSize;
+	}
+}
+
+/**
+ * Read from the underlying file.
+ * This uses readAt(), so the underlying file's position
+ * isn't used or changed.
+ * NOTE: Mutex must *not* be locked by the caller.
+ * @param file	[in] Underlying file
+ * @param pos	[in] Start position.
+ * @param ptr	[out] Output data buffer.
+ * @param size	[in] Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t BufferedFilePrivate::baseRead(const IRpFilePtr &file, off64_t pos, void *ptr, size_t size)
+{
+	RP_Q(BufferedFile);
+	const size_t ret = file->readAt(pos, ptr, size);
+	if (ret != size) {
+		q->m_lastError = file->lastError();
+	}
+
+	MutexLocker locker(mutex);
+	stats.baseReads++;
+	stats.baseBytes += ret;
+	return ret;
+}
+
+/**
+ * Find a cached block.
+ * NOTE: Mutex must be locked by the caller.
+ * @param blockIdx Block index
+ * @return Block, or nullptr if it isn't cached.
+ */
+const BufferedFilePrivate::Block *BufferedFilePrivate::findBlock(off64_t blockIdx)
+{
+	for (Block &block : blocks) {
+		if (block.blockIdx == blockIdx) {
+			block.lastUsed = ++lruCounter;
+			return &block;
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * Insert a block into the cache, replacing the least-recently used block.
+ * NOTE: Mutex must be locked by the caller.
+ * @param blockIdx	[in] Block index
+ * @param data		[in] Block data
+ * @param validSize	[in] Valid bytes in data
+ */
+void BufferedFilePrivate::insertBlock(off64_t blockIdx, const uint8_t *data, size_t validSize)
+{
+	// If another thread inserted this block while the mutex
+	// was unlocked, overwrite it instead of caching it twice.
+	Block *lru = &blocks[0];
+	for (Block &block : blocks) {
+		if (block.blockIdx == blockIdx) {
+			lru = &block;
+			break;
+		}
+		if (block.lastUsed < lru->lastUsed) {
+			lru = &block;
+		}
+	}
+
+	memcpy(lru->data, data, validSize);
+	lru->blockIdx = blockIdx;
+	lru->lastUsed = ++lruCounter;
+	lru->validSize = validSize;
+}
+
+/**
+ * Invalidate cached blocks that overlap the specified range.
+ * NOTE: Mutex must be locked by the caller.
+ * @param pos Start position
+ * @param size Size
+ */
+void BufferedFilePrivate::invalidateRange(off64_t pos, off64_t size)
+{
+	if (size <= 0)
+		return;
+	generation++;
+
+	const off64_t firstBlock = pos / blockSize;
+	const off64_t lastBlock = (pos + size - 1) / blockSize;
+	for (Block &block : blocks) {
+		if (block.blockIdx >= firstBlock && block.blockIdx <= lastBlock) {
+			block.blockIdx = -1;
+			block.lastUsed = 0;
+			block.validSize = 0;
+		}
+	}
+}
+
+/**
+ * Invalidate all cached blocks.
+ * NOTE: Mutex must be locked by the caller.
+ */
+void BufferedFilePrivate::invalidateAll(void)
+{
+	generation++;
+	for (Block &block : blocks) {
+		block.blockIdx = -1;
+		block.lastUsed = 0;
+		block.validSize = 0;
+	}
+}
+
+/** BufferedFile **/
+
+/**
+ * Wrap an IRpFile with a small LRU block cache.
+ *
+ * Small reads are rounded up to whole blocks, so parsers that
+ * issue many tiny seekAndRead() calls only hit the underlying
+ * file once per block. Reads that are at least one block in size
+ * bypass the cache. Writes are passed through to the underlying
+ * file and invalidate any cached blocks they overlap.
+ *
+ * Reads from the underlying file use readAt(), so they don't depend
+ * on the underlying file's position. Writes seek the underlying file
+ * to the BufferedFile position before writing. Writing to the
+ * underlying file directly will leave stale data in the cache
+ * until invalidate() is called.
+ *
+ * @param file		[in] Underlying file
+ * @param blockSize	[in] Block size, in bytes (power of two)
+ * @param blockCount	[in] Number of blocks to cache
+ */
+BufferedFile::BufferedFile(const IRpFilePtr &file, unsigned int blockSize, unsigned int blockCount)
+	: d_ptr(new BufferedFilePrivate(this, file, blockSize, blockCount))
+{
+	assert((bool)file);
+	if (!file) {
+		m_lastError = EBADF;
+		return;
+	}
+
+	// Copy the file properties.
+	RP_D(BufferedFile);
+	m_isWritable = file->isWritable();
+	m_isCompressed = file->isCompressed();
+	m_fileType = file->fileType();
+	d->fileSize = file->size();
+	if (d->fileSize < 0) {
+		d->fileSize = 0;
+	}
+}
+
+BufferedFile::~BufferedFile()
+{
+	delete d_ptr;
+}
+
+/**
+ * Is the file open?
+ * This usually only returns false if an error occurred.
+ * @return True if the file is open; false if it isn't.
+ */
+bool BufferedFile::isOpen(void) const
+{
+	RP_D(const BufferedFile);
+	return (d->file && d->file->isOpen());
+}
+
+/**
+ * Close the file.
+ */
+void BufferedFile::close(void)
+{
+	RP_D(BufferedFile);
+	MutexLocker locker(d->mutex);
+	d->file.reset();
+	d->invalidateAll();
+}
+
+/**
+ * Read data from the file.
+ * @param ptr Output data buffer.
+ * @param size Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t BufferedFile::read(void *ptr, size_t size)
+{
+	RP_D(BufferedFile);
+	const size_t ret = readAt(d->pos, ptr, size);
+	d->pos += ret;
+	return ret;
+}
+
+/**
+ * Write data to the file.
+ * @param ptr Input data buffer.
+ * @param size Amount of data to write, in bytes.
+ * @return Number of bytes written.
+ */
+size_t BufferedFile::write(const void *ptr, size_t size)
+{
+	RP_D(BufferedFile);
+	MutexLocker locker(d->mutex);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return 0;
+	}
+
+	// NOTE: The underlying file's position may have been changed
+	// by someone else, so always seek before writing.
+	if (d->file->seek(d->pos) != 0) {
+		m_lastError = d->file->lastError();
+		return 0;
+	}
+
+	const size_t ret = d->file->write(ptr, size);
+	if (ret != size) {
+		m_lastError = d->file->lastError();
+	}
+
+	// Cached blocks in the written range are now stale.
+	d->invalidateRange(d->pos, static_cast<off64_t>(size));
+	d->pos += ret;
+	if (d->pos > d->fileSize) {
+		d->fileSize = d->pos;
+	}
+	return ret;
+}
+
+/**
+ * Set the file position.
+ * @param pos File position.
+ * @return 0 on success; -1 on error.
+ */
+int BufferedFile::seek(off64_t pos)
+{
+	RP_D(BufferedFile);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return -1;
+	} else if (pos < 0) {
+		m_lastError = EINVAL;
+		return -1;
+	}
+
+	// NOTE: The underlying file isn't seeked until data is read.
+	d->pos = pos;
+	return 0;
+}
+
+/**
+ * Get the file position.
+ * @return File position, or -1 on error.
+ */
+off64_t BufferedFile::tell(void)
+{
+	RP_D(const BufferedFile);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return -1;
+	}
+
+	return d->pos;
+}
+
+/**
+ * Truncate the file.
+ * @param size New size. (default is 0)
+ * @return 0 on success; -1 on error.
+ */
+int BufferedFile::truncate(off64_t size)
+{
+	RP_D(BufferedFile);
+	MutexLocker locker(d->mutex);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return -1;
+	}
+
+	const int ret = d->file->truncate(size);
+	if (ret != 0) {
+		m_lastError = d->file->lastError();
+	}
+
+	d->invalidateAll();
+	d->fileSize = d->file->size();
+	if (d->fileSize < 0) {
+		d->fileSize = 0;
+	}
+	return ret;
+}
+
+/**
+ * Flush buffers.
+ * This operation only makes sense on writable files.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int BufferedFile::flush(void)
+{
+	RP_D(BufferedFile);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return -EBADF;
+	}
+
+	return d->file->flush();
+}
+
+/** File properties **/
+
+/**
+ * Get the file size.
+ * @return File size, or negative on error.
+ */
+off64_t BufferedFile::size(void)
+{
+	RP_D(const BufferedFile);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return -1;
+	}
+
+	return d->fileSize;
+}
+
+/**
+ * Get the filename.
+ * @return Filename. (May be nullptr if the filename is not available.)
+ */
+const char *BufferedFile::filename(void) const
+{
+	RP_D(const BufferedFile);
+	return (d->file ? d->file->filename() : nullptr);
+}
+
+/** Extra functions **/
+
+/**
+ * Make the file writable.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int BufferedFile::makeWritable(void)
+{
+	RP_D(BufferedFile);
+	MutexLocker locker(d->mutex);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return -EBADF;
+	}
+
+	const int ret = d->file->makeWritable();
+	if (ret == 0) {
+		// The underlying file may have been reopened.
+		m_isWritable = d->file->isWritable();
+	}
+	return ret;
+}
+
+/** Positional I/O **/
+
+/**
+ * Read data from the file at the specified position.
+ * The file position is not changed.
+ * @param pos	[in] Start position.
+ * @param ptr	[out] Output data buffer.
+ * @param size	[in] Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t BufferedFile::readAt(off64_t pos, void *ptr, size_t size)
+{
+	RP_D(BufferedFile);
+
+	// NOTE: The mutex is only held while accessing the block cache.
+	// Reads from the underlying file are done without the mutex,
+	// so a reference to the underlying file is kept in case
+	// close() is called at the same time.
+	IRpFilePtr file;
+	off64_t fileSize;
+	{
+		MutexLocker locker(d->mutex);
+		if (!d->file) {
+			m_lastError = EBADF;
+			return 0;
+		}
+		file = d->file;
+		fileSize = d->fileSize;
+	}
+
+	if (pos < 0) {
+		m_lastError = EINVAL;
+		return 0;
+	} else if (size == 0 || pos >= fileSize) {
+		// Nothing to read.
+		return 0;
+	}
+
+	// Constrain size based on the file size.
+	if (static_cast<off64_t>(size) > fileSize - pos) {
+		size = static_cast<size_t>(fileSize - pos);
+	}
+
+	if (size >= d->blockSize) {
+		// Large read. Caching this wouldn't help,
+		// so read it directly from the underlying file.
+		{
+			MutexLocker locker(d->mutex);
+			d->stats.bypass++;
+		}
+		return d->baseRead(file, pos, ptr, size);
+	}
+
+	// Copy the data from the cached block(s).
+	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
+	size_t ret = 0;
+	rp::uvector<uint8_t> missBuf;
+	while (size > 0) {
+		const off64_t blockIdx = pos / d->blockSize;
+		const size_t blockOffset = static_cast<size_t>(pos % d->blockSize);
+
+		uint64_t generation;
+		{
+			MutexLocker locker(d->mutex);
+			const BufferedFilePrivate::Block *const block = d->findBlock(blockIdx);
+			if (block) {
+				// Cache hit.
+				d->stats.hits++;
+				if (blockOffset >= block->validSize) {
+					// Read error.
+					break;
+				}
+
+				const size_t cb = std::min(size, block->validSize - blockOffset);
+				memcpy(ptr8, &block->data[blockOffset], cb);
+				ptr8 += cb;
+				pos += cb;
+				size -= cb;
+				ret += cb;
+				continue;
+			}
+
+			// Cache miss.
+			d->stats.misses++;
+			generation = d->generation;
+		}
+
+		// Read the block without holding the mutex.
+		const off64_t blockPos = blockIdx * d->blockSize;
+		size_t blockSize = d->blockSize;
+		if (blockPos + static_cast<off64_t>(blockSize) > fileSize) {
+			blockSize = static_cast<size_t>(fileSize - blockPos);
+		}
+		missBuf.resize(blockSize);
+		const size_t validSize = d->baseRead(file, blockPos, missBuf.data(), blockSize);
+		if (validSize == 0 || blockOffset >= validSize) {
+			// Read error.
+			break;
+		}
+
+		{
+			MutexLocker locker(d->mutex);
+			if (generation == d->generation) {
+				// Nothing was invalidated while the block was being read.
+				d->insertBlock(blockIdx, missBuf.data(), validSize);
+			}
+		}
+
+		const size_t cb = std::min(size, validSize - blockOffset);
+		memcpy(ptr8, &missBuf[blockOffset], cb);
+		ptr8 += cb;
+		pos += cb;
+		size -= cb;
+		ret += cb;
+	}
+	return ret;
+}
+
+/** Access pattern hints **/
+
+/**
+ * Tell the OS how a range of the file will be accessed.
+ * This is forwarded to the underlying file.
+ * @param pos	[in] Start position.
+ * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+ * @param hint	[in] Access hint.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int BufferedFile::advise(off64_t pos, off64_t size, AccessHint hint)
+{
+	RP_D(BufferedFile);
+	if (!d->file) {
+		return -EBADF;
+	}
+	return d->file->advise(pos, size, hint);
+}
+
+/** BufferedFile functions **/
+
+/**
+ * Get the underlying file.
+ * @return Underlying file
+ */
+IRpFilePtr BufferedFile::baseFile(void) const
+{
+	RP_D(const BufferedFile);
+	return d->file;
+}
+
+/**
+ * Get the cache statistics.
+ * @return Cache statistics
+ */
+BufferedFile::Stats BufferedFile::stats(void) const
+{
+	RP_D(const BufferedFile);
+	MutexLocker locker(d->mutex);
+	return d->stats;
+}
+
+/**
+ * Reset the cache statistics.
+ */
+void BufferedFile::resetStats(void)
+{
+	RP_D(BufferedFile);
+	MutexLocker locker(d->mutex);
+	d->stats = {};
+}
+
+/**
+ * Discard all cached blocks.
+ */
+void BufferedFile::invalidate(void)
+{
+	RP_D(BufferedFile);
+	MutexLocker locker(d->mutex);
+	d->invalidateAll();
+}
+
+/**
+ * Get the block size.
+ * @return Block size, in bytes
+ */
+unsigned int BufferedFile::blockSize(void) const
+{
+	RP_D(const BufferedFile);
+	return d->blockSize;
+}
+
+/**
+ * Add data that was already read from the underlying file to the cache.
+ * This is used for batched reads, e.g. by RomDataFactory::createBatch().
+ *
+ * NOTE: pos must be block-aligned. Partial blocks are only
+ * accepted if they end at the end of the file.
+ *
+ * @param pos	[in] Block-aligned start position.
+ * @param ptr	[in] Block data.
+ * @param size	[in] Size of the block data.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int BufferedFile::prime(off64_t pos, const void *ptr, size_t size)
+{
+	RP_D(BufferedFile);
+	MutexLocker locker(d->mutex);
+	if (!d->file) {
+		return -EBADF;
+	} else if (pos < 0 || pos >= d->fileSize || (pos % d->blockSize) != 0) {
+		return -EINVAL;
+	}
+
+	const uint8_t *ptr8 = static_cast<const uint8_t*>(ptr);
+	for (; size > 0; pos += d->blockSize) {
+		size_t cb = d->blockSize;
+		if (size < cb) {
+			// Partial block. Only allowed at EOF.
+			if (pos + static_cast<off64_t>(size) != d->fileSize) {
+				return -EINVAL;
+			}
+			cb = size;
+		}
+
+		// Use the least-recently used block.
+		// NOTE: If the block is already cached, replace it.
+		const off64_t blockIdx = pos / d->blockSize;
+		BufferedFilePrivate::Block *dest = &d->blocks[0];
+		for (BufferedFilePrivate::Block &block : d->blocks) {
+			if (block.blockIdx == blockIdx) {
+				dest = &block;
+				break;
+			}
+			if (block.lastUsed < dest->lastUsed) {
+				dest = &block;
+			}
+		}
+
+		memcpy(dest->data, ptr8, cb);
+		dest->blockIdx = blockIdx;
+		dest->lastUsed = ++d->lruCounter;
+		dest->validSize = cb;
+
+		ptr8 += cb;
+		size -= cb;
+	}
+
+	return 0;
+}
+
+}
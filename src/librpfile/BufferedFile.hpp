@@ -0,0 +1,230 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * BufferedFile.hpp: Read-coalescing block cache wrapper for IRpFile.      *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+#include "IRpFile.hpp"
+
+namespace LibRpFile {
+
+class BufferedFilePrivate;
+class RP_LIBROMDATA_PUBLIC BufferedFile final : public IRpFile
+{
+	public:
+		/**
+		 * Default block size, in bytes.
+		 * Must be a power of two.
+		 */
+		static constexpr unsigned int DEFAULT_BLOCK_SIZE = 16U * 1024U;
+
+		/**
+		 * Default number of cached blocks.
+		 */
+		static constexpr unsigned int DEFAULT_BLOCK_COUNT = 8;
+
+		/**
+		 * Wrap an IRpFile with a small LRU block cache.
+		 *
+		 * Small reads are rounded up to whole blocks, so parsers that
+		 * issue many tiny seekAndRead() calls only hit the underlying
+		 * file once per block. Reads that are at least one block in size
+		 * bypass the cache. Writes are passed through to the underlying
+		 * file and invalidate any cached blocks they overlap.
+		 *
+		 * Reads from the underlying file use readAt(), so they don't depend
+		 * on the underlying file's position. Writes seek the underlying file
+		 * to the BufferedFile position before writing. Writing to the
+		 * underlying file directly will leave stale data in the cache
+		 * until invalidate() is called.
+		 *
+		 * @param file		[in] Underlying file
+		 * @param blockSize	[in] Block size, in bytes (power of two)
+		 * @param blockCount	[in] Number of blocks to cache
+		 */
+		explicit BufferedFile(const IRpFilePtr &file,
+			unsigned int blockSize = DEFAULT_BLOCK_SIZE,
+			unsigned int blockCount = DEFAULT_BLOCK_COUNT);
+		~BufferedFile() final;
+
+	private:
+		typedef IRpFile super;
+		RP_DISABLE_COPY(BufferedFile)
+	private:
+		friend class BufferedFilePrivate;
+		BufferedFilePrivate *const d_ptr;
+
+	public:
+		/**
+		 * Is the file open?
+		 * This usually only returns false if an error occurred.
+		 * @return True if the file is open; false if it isn't.
+		 */
+		bool isOpen(void) const final;
+
+		/**
+		 * Close the file.
+		 */
+		void close(void) final;
+
+		/**
+		 * Read data from the file.
+		 * @param ptr Output data buffer.
+		 * @param size Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 2, 3)
+		size_t read(void *ptr, size_t size) final;
+
+		/**
+		 * Write data to the file.
+		 * @param ptr Input data buffer.
+		 * @param size Amount of data to write, in bytes.
+		 * @return Number of bytes written.
+		 */
+		ATTR_ACCESS_SIZE(read_only, 2, 3)
+		size_t write(const void *ptr, size_t size) final;
+
+		/**
+		 * Set the file position.
+		 * @param pos File position.
+		 * @return 0 on success; -1 on error.
+		 */
+		int seek(off64_t pos) final;
+
+		/**
+		 * Get the file position.
+		 * @return File position, or -1 on error.
+		 */
+		off64_t tell(void) final;
+
+		/**
+		 * Truncate the file.
+		 * @param size New size. (default is 0)
+		 * @return 0 on success; -1 on error.
+		 */
+		int truncate(off64_t size = 0) final;
+
+		/**
+		 * Flush buffers.
+		 * This operation only makes sense on writable files.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int flush(void) final;
+
+	public:
+		/** File properties **/
+
+		/**
+		 * Get the file size.
+		 * @return File size, or negative on error.
+		 */
+		off64_t size(void) final;
+
+		/**
+		 * Get the filename.
+		 * @return Filename. (May be nullptr if the filename is not available.)
+		 */
+		const char *filename(void) const final;
+
+	public:
+		/** Extra functions **/
+
+		/**
+		 * Make the file writable.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int makeWritable(void) final;
+
+	public:
+		/** Positional I/O **/
+
+		/**
+		 * Read data from the file at the specified position.
+		 * The file position is not changed.
+		 * @param pos	[in] Start position.
+		 * @param ptr	[out] Output data buffer.
+		 * @param size	[in] Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		size_t readAt(off64_t pos, void *ptr, size_t size) final;
+
+	public:
+		/** Access pattern hints **/
+
+		/**
+		 * Tell the OS how a range of the file will be accessed.
+		 * This is forwarded to the underlying file.
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+		 * @param hint	[in] Access hint.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int advise(off64_t pos, off64_t size, AccessHint hint) final;
+
+	public:
+		/** BufferedFile functions **/
+
+		/**
+		 * Get the underlying file.
+		 * @return Underlying file
+		 */
+		IRpFilePtr baseFile(void) const;
+
+		/**
+		 * Cache statistics.
+		 */
+		struct Stats {
+			uint64_t hits;		// Block lookups satisfied by the cache
+			uint64_t misses;	// Block lookups that required a read
+			uint64_t bypass;	// Large reads passed directly to the underlying file
+			uint64_t baseReads;	// readAt() calls issued to the underlying file
+			uint64_t baseBytes;	// Bytes read from the underlying file
+		};
+
+		/**
+		 * Get the cache statistics.
+		 * @return Cache statistics
+		 */
+		Stats stats(void) const;
+
+		/**
+		 * Reset the cache statistics.
+		 */
+		void resetStats(void);
+
+		/**
+		 * Discard all cached blocks.
+		 */
+		void invalidate(void);
+
+		/**
+		 * Get the block size.
+		 * @return Block size, in bytes
+		 */
+		unsigned int blockSize(void) const;
+
+		/**
+		 * Add data that was already read from the underlying file to the cache.
+		 * This is used for batched reads, e.g. by RomDataFactory::createBatch().
+		 *
+		 * NOTE: pos must be block-aligned. Partial blocks are only
+		 * accepted if they end at the end of the file.
+		 *
+		 * @param pos	[in] Block-aligned start position.
+		 * @param ptr	[in] Block data.
+		 * @param size	[in] Size of the block data.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		ATTR_ACCESS_SIZE(read_only, 3, 4)
+		int prime(off64_t pos, const void *ptr, size_t size);
+};
+
+typedef std::shared_ptr<BufferedFile> BufferedFilePtr;
+
+}
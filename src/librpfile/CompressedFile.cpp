@@ -0,0 +1,602 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * CompressedFile.cpp: Random-access wrapper for block-compressed files.   *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "stdafx.h"
+#include "config.librpfile.h"
+#include "CompressedFile.hpp"
+
+#ifdef HAVE_ZSTD
+#  include "ZstdFile.hpp"
+#endif /* HAVE_ZSTD */
+#ifdef HAVE_LZMA
+#  include "XzFile.hpp"
+#endif /* HAVE_LZMA */
+
+// C++ includes
+#include <algorithm>
+#include "uvector.h"
+
+// librpthreads
+#include "librpthreads/Mutex.hpp"
+using LibRpThreads::Mutex;
+using LibRpThreads::MutexLocker;
+
+// C++ STL classes
+using std::vector;
+
+namespace LibRpFile {
+
+/** CompressedFilePrivate **/
+
+class CompressedFilePrivate
+{
+	public:
+		CompressedFilePrivate(CompressedFile *q, const IRpFilePtr &file);
+
+	private:
+		RP_DISABLE_COPY(CompressedFilePrivate)
+		CompressedFile *const q_ptr;
+
+	public:
+		// Blocks up to this size are decompressed and cached in full.
+		// Larger blocks are decompressed as a stream.
+		static constexpr size_t MAX_CACHED_BLOCK_SIZE = 4U * 1024U * 1024U;
+		// Number of cached blocks.
+		static constexpr unsigned int CACHE_COUNT = 4;
+		// Scratch buffer size for skipping data in streamed blocks.
+		static constexpr size_t SKIP_BUF_SIZE = 64U * 1024U;
+
+		IRpFilePtr file;	// Compressed file
+		off64_t pos;		// Current position (uncompressed)
+		off64_t uncompSize;	// Uncompressed size
+
+		vector<CompressedFile::Block> blocks;
+
+		// Cached blocks
+		struct CacheEntry {
+			int blockIdx;		// Block index (-1 if empty)
+			uint64_t lastUsed;	// LRU counter value at last use
+			rp::uvector<uint8_t> data;
+		};
+		CacheEntry cache[CACHE_COUNT];
+		uint64_t lruCounter;
+
+		// Streamed block
+		int streamBlockIdx;	// Block currently being streamed (-1 if none)
+		off64_t streamPos;	// Position within the streamed block
+		rp::uvector<uint8_t> skipBuf;
+
+		// Mutex for the block cache and the decompression state.
+		// readAt() may be called concurrently.
+		Mutex mutex;
+
+	public:
+		/**
+		 * Find the block containing the specified position.
+		 * @param pos Uncompressed position
+		 * @return Block index, or -1 if out of range.
+		 */
+		int findBlock(off64_t pos) const;
+
+		/**
+		 * Get a block from the cache, decompressing it if necessary.
+		 * NOTE: Mutex must be locked by the caller.
+		 * @param blockIdx Block index
+		 * @return Cache entry, or nullptr on error.
+		 */
+		const CacheEntry *getCachedBlock(int blockIdx);
+
+		/**
+		 * Read from a block using streaming decompression.
+		 * NOTE: Mutex must be locked by the caller.
+		 * @param blockIdx	[in] Block index
+		 * @param offset	[in] Offset within the block
+		 * @param ptr		[out] Output data buffer
+		 * @param size		[in] Amount of data to read, in bytes
+		 * @return Number of bytes read.
+		 */
+		size_t readStreamed(int blockIdx, off64_t offset, uint8_t *ptr, size_t size);
+};
+
+CompressedFilePrivate::CompressedFilePrivate(CompressedFile *q, const IRpFilePtr &file)
+	: q_ptr(q)
+	, file(file)
+	, pos(0)
+	, uncompSize(0)
+	, lruCounter(0)
+	, streamBlockIdx(-1)
+	, streamPos(0)
+{
+	for (CacheEntry &entry : cache) {
+		entry.blockIdx = -1;
+		entry.lastUsed = 0;
+	}
+}
+
+/**
+ * Find the block containing the specified position.
+ * @param pos Uncompressed position
+ * @return Block index, or -1 if out of range.
+ */
+int CompressedFilePrivate::findBlock(off64_t pos) const
+{
+	if (pos < 0 || pos >= uncompSize) {
+		return -1;
+	}
+
+	auto iter = std::upper_bound(blocks.cbegin(), blocks.cend(), pos,
+		[](off64_t pos, const CompressedFile::Block &block) {
+			return pos < block.uncompPos;
+		});
+	assert(iter != blocks.cbegin());
+	return static_cast<int>(std::distance(blocks.cbegin(), iter)) - 1;
+}
+
+/**
+ * Get a block from the cache, decompressing it if necessary.
+ * NOTE: Mutex must be locked by the caller.
+ * @param blockIdx Block index
+ * @return Cache entry, or nullptr on error.
+ */
+const CompressedFilePrivate::CacheEntry *CompressedFilePrivate::getCachedBlock(int blockIdx)
+{
+	// Check if the block is cached.
+	// Also find the least-recently used entry in case it isn't.
+	CacheEntry *lru = &cache[0];
+	for (CacheEntry &entry : cache) {
+		if (entry.blockIdx == blockIdx) {
+			// Found the block.
+			entry.lastUsed = ++lruCounter;
+			return &entry;
+		}
+		if (entry.lastUsed < lru->lastUsed) {
+			lru = &entry;
+		}
+	}
+
+	// Block isn't cached. Decompress it into the LRU entry.
+	RP_Q(CompressedFile);
+	const CompressedFile::Block &block = blocks[blockIdx];
+	lru->blockIdx = -1;
+	lru->lastUsed = 0;
+	lru->data.resize(static_cast<size_t>(block.uncompSize));
+
+	// NOTE: Decompressing a block resets the streaming state.
+	streamBlockIdx = -1;
+	int ret = q->beginBlock(static_cast<unsigned int>(blockIdx), block);
+	if (ret != 0) {
+		q->m_lastError = -ret;
+		return nullptr;
+	}
+	const size_t size = q->decodeBlock(lru->data.data(), lru->data.size());
+	if (size != lru->data.size()) {
+		// Decompression error.
+		if (q->m_lastError == 0) {
+			q->m_lastError = EIO;
+		}
+		return nullptr;
+	}
+
+	lru->blockIdx = blockIdx;
+	lru->lastUsed = ++lruCounter;
+	return lru;
+}
+
+/**
+ * Read from a block using streaming decompression.
+ * NOTE: Mutex must be locked by the caller.
+ * @param blockIdx	[in] Block index
+ * @param offset	[in] Offset within the block
+ * @param ptr		[out] Output data buffer
+ * @param size		[in] Amount of data to read, in bytes
+ * @return Number of bytes read.
+ */
+size_t CompressedFilePrivate::readStreamed(int blockIdx, off64_t offset, uint8_t *ptr, size_t size)
+{
+	RP_Q(CompressedFile);
+	if (streamBlockIdx != blockIdx || streamPos > offset) {
+		// Restart decompression at the beginning of the block.
+		streamBlockIdx = -1;
+		const int ret = q->beginBlock(static_cast<unsigned int>(blockIdx), blocks[blockIdx]);
+		if (ret != 0) {
+			q->m_lastError = -ret;
+			return 0;
+		}
+		streamBlockIdx = blockIdx;
+		streamPos = 0;
+	}
+
+	// Skip data up to the requested offset.
+	if (streamPos < offset && skipBuf.empty()) {
+		skipBuf.resize(SKIP_BUF_SIZE);
+	}
+	while (streamPos < offset) {
+		const size_t skip = static_cast<size_t>(std::min<off64_t>(offset - streamPos, SKIP_BUF_SIZE));
+		const size_t ret = q->decodeBlock(skipBuf.data(), skip);
+		streamPos += ret;
+		if (ret != skip) {
+			// Decompression error.
+			streamBlockIdx = -1;
+			return 0;
+		}
+	}
+
+	const size_t ret = q->decodeBlock(ptr, size);
+	streamPos += ret;
+	if (ret != size) {
+		// Decompression error.
+		streamBlockIdx = -1;
+	}
+	return ret;
+}
+
+/** CompressedFile **/
+
+/**
+ * Random-access wrapper for block-compressed files.
+ *
+ * Subclasses parse the container's block table and call
+ * setBlocks(). Blocks are decompressed on demand; small
+ * blocks are cached, and large blocks are decompressed
+ * as a stream, restarting only when seeking backwards.
+ *
+ * @param file Compressed file
+ */
+CompressedFile::CompressedFile(const IRpFilePtr &file)
+	: d_ptr(new CompressedFilePrivate(this, file))
+{
+	assert((bool)file);
+	if (!file) {
+		m_lastError = EBADF;
+		return;
+	}
+
+	// CompressedFile is always read-only.
+	m_isWritable = false;
+	m_isCompressed = true;
+	m_fileType = file->fileType();
+}
+
+CompressedFile::~CompressedFile()
+{
+	delete d_ptr;
+}
+
+/**
+ * Open a compressed file, if the container format is supported.
+ * Currently supported: seekable zstd, zstd, xz
+ * @param file File to check
+ * @return CompressedFile, or nullptr if the file isn't a supported compressed file.
+ */
+IRpFilePtr CompressedFile::open(const IRpFilePtr &file)
+{
+	if (!file || file->isCompressed() || file->isDevice()) {
+		// Already decompressed, or not supported.
+		return {};
+	}
+
+	uint8_t magic[6];
+	if (file->readAt(0, magic, sizeof(magic)) != sizeof(magic)) {
+		return {};
+	}
+
+	CompressedFilePtr cfile;
+#ifdef HAVE_ZSTD
+	if (!memcmp(magic, "\x28\xB5\x2F\xFD", 4)) {
+		// zstd frame
+		cfile = std::make_shared<ZstdFile>(file);
+	}
+#endif /* HAVE_ZSTD */
+#ifdef HAVE_LZMA
+	if (!memcmp(magic, "\xFD" "7zXZ\x00", 6)) {
+		// xz stream
+		cfile = std::make_shared<XzFile>(file);
+	}
+#endif /* HAVE_LZMA */
+
+	if (cfile && cfile->isOpen()) {
+		return cfile;
+	}
+	return {};
+}
+
+/**
+ * Is the file open?
+ * This usually only returns false if an error occurred.
+ * @return True if the file is open; false if it isn't.
+ */
+bool CompressedFile::isOpen(void) const
+{
+	RP_D(const CompressedFile);
+	return (d->file && d->file->isOpen() && !d->blocks.empty());
+}
+
+/**
+ * Close the file.
+ */
+void CompressedFile::close(void)
+{
+	RP_D(CompressedFile);
+	MutexLocker locker(d->mutex);
+	d->file.reset();
+	for (auto &entry : d->cache) {
+		entry.blockIdx = -1;
+		entry.lastUsed = 0;
+		entry.data.clear();
+		entry.data.shrink_to_fit();
+	}
+	d->streamBlockIdx = -1;
+}
+
+/**
+ * Read data from the file.
+ * @param ptr Output data buffer.
+ * @param size Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t CompressedFile::read(void *ptr, size_t size)
+{
+	RP_D(CompressedFile);
+	const size_t ret = readAt(d->pos, ptr, size);
+	d->pos += ret;
+	return ret;
+}
+
+/**
+ * Write data to the file.
+ * (NOTE: Not valid for CompressedFile; this will always return 0.)
+ * @param ptr Input data buffer.
+ * @param size Amount of data to read, in bytes.
+ * @return Number of bytes written.
+ */
+size_t CompressedFile::write(const void *ptr, size_t size)
+{
+	// Not a valid operation for CompressedFile.
+	RP_UNUSED(ptr);
+	RP_UNUSED(size);
+	m_lastError = EBADF;
+	return 0;
+}
+
+/**
+ * Set the file position.
+ * @param pos File position.
+ * @return 0 on success; -1 on error.
+ */
+int CompressedFile::seek(off64_t pos)
+{
+	RP_D(CompressedFile);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return -1;
+	} else if (pos < 0) {
+		m_lastError = EINVAL;
+		return -1;
+	}
+
+	// NOTE: Decompression is deferred until data is read.
+	d->pos = pos;
+	return 0;
+}
+
+/**
+ * Get the file position.
+ * @return File position, or -1 on error.
+ */
+off64_t CompressedFile::tell(void)
+{
+	RP_D(const CompressedFile);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return -1;
+	}
+
+	return d->pos;
+}
+
+/**
+ * Truncate the file.
+ * (NOTE: Not valid for CompressedFile; this will always return -1.)
+ * @param size New size. (default is 0)
+ * @return 0 on success; -1 on error.
+ */
+int CompressedFile::truncate(off64_t size)
+{
+	// Not a valid operation for CompressedFile.
+	RP_UNUSED(size);
+	m_lastError = EBADF;
+	return -1;
+}
+
+/**
+ * Flush buffers.
+ * (NOTE: Not valid for CompressedFile; this will always return -EBADF.)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int CompressedFile::flush(void)
+{
+	// Not a valid operation for CompressedFile.
+	m_lastError = EBADF;
+	return -EBADF;
+}
+
+/** File properties **/
+
+/**
+ * Get the file size.
+ * This is the uncompressed size.
+ * @return File size, or negative on error.
+ */
+off64_t CompressedFile::size(void)
+{
+	RP_D(const CompressedFile);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return -1;
+	}
+
+	return d->uncompSize;
+}
+
+/**
+ * Get the filename.
+ * @return Filename. (May be nullptr if the filename is not available.)
+ */
+const char *CompressedFile::filename(void) const
+{
+	RP_D(const CompressedFile);
+	return (d->file ? d->file->filename() : nullptr);
+}
+
+/** Positional I/O **/
+
+/**
+ * Read data from the file at the specified position.
+ * The file position is not changed.
+ * @param pos	[in] Start position.
+ * @param ptr	[out] Output data buffer.
+ * @param size	[in] Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t CompressedFile::readAt(off64_t pos, void *ptr, size_t size)
+{
+	RP_D(CompressedFile);
+	MutexLocker locker(d->mutex);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return 0;
+	} else if (pos < 0) {
+		m_lastError = EINVAL;
+		return 0;
+	}
+
+	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
+	size_t total = 0;
+	while (size > 0) {
+		const int blockIdx = d->findBlock(pos);
+		if (blockIdx < 0) {
+			// End of file.
+			break;
+		}
+
+		const Block &block = d->blocks[blockIdx];
+		const off64_t offset = pos - block.uncompPos;
+		const size_t len = static_cast<size_t>(std::min<off64_t>(size, block.uncompSize - offset));
+
+		size_t ret;
+		if (block.uncompSize <= static_cast<off64_t>(CompressedFilePrivate::MAX_CACHED_BLOCK_SIZE)) {
+			// Small block. Decompress and cache the whole block.
+			const CompressedFilePrivate::CacheEntry *const entry = d->getCachedBlock(blockIdx);
+			if (!entry) {
+				break;
+			}
+			memcpy(ptr8, &entry->data[static_cast<size_t>(offset)], len);
+			ret = len;
+		} else {
+			// Large block. Use streaming decompression.
+			ret = d->readStreamed(blockIdx, offset, ptr8, len);
+		}
+
+		ptr8 += ret;
+		pos += ret;
+		size -= ret;
+		total += ret;
+		if (ret != len) {
+			// Decompression error.
+			break;
+		}
+	}
+
+	return total;
+}
+
+/** CompressedFile functions **/
+
+/**
+ * Get the underlying compressed file.
+ * @return Underlying file
+ */
+IRpFilePtr CompressedFile::baseFile(void) const
+{
+	RP_D(const CompressedFile);
+	return d->file;
+}
+
+/**
+ * Get the number of compressed blocks.
+ * @return Number of blocks
+ */
+unsigned int CompressedFile::blockCount(void) const
+{
+	RP_D(const CompressedFile);
+	return static_cast<unsigned int>(d->blocks.size());
+}
+
+/**
+ * Set the block table.
+ * Blocks must be contiguous in the uncompressed data,
+ * starting at 0.
+ * @param blocks Block table
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int CompressedFile::setBlocks(vector<Block> &&blocks)
+{
+	RP_D(CompressedFile);
+	if (blocks.empty() || blocks.size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
+		return -EIO;
+	}
+
+	// Verify the block table.
+	off64_t uncompPos = 0;
+	for (const Block &block : blocks) {
+		if (block.uncompPos != uncompPos || block.uncompSize < 0 ||
+		    block.compPos < 0 || block.compSize <= 0)
+		{
+			return -EIO;
+		}
+		uncompPos += block.uncompSize;
+	}
+
+	// Remove empty blocks, since they can't contain any data.
+	blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+		[](const Block &block) {
+			return block.uncompSize == 0;
+		}), blocks.end());
+	if (blocks.empty()) {
+		return -EIO;
+	}
+
+	MutexLocker locker(d->mutex);
+	d->blocks = std::move(blocks);
+	d->uncompSize = uncompPos;
+	return 0;
+}
+
+/**
+ * Read compressed data.
+ * @param pos	[in] Compressed position
+ * @param ptr	[out] Output data buffer
+ * @param size	[in] Amount of data to read, in bytes
+ * @return Number of bytes read.
+ */
+size_t CompressedFile::readCompressed(off64_t pos, void *ptr, size_t size)
+{
+	RP_D(CompressedFile);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return 0;
+	}
+
+	const size_t ret = d->file->readAt(pos, ptr, size);
+	if (ret != size) {
+		m_lastError = d->file->lastError();
+	}
+	return ret;
+}
+
+}
@@ -0,0 +1,210 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * CompressedFile.hpp: Random-access wrapper for block-compressed files.   *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+#include "IRpFile.hpp"
+
+// C++ includes
+#include <vector>
+
+namespace LibRpFile {
+
+class CompressedFilePrivate;
+class RP_LIBROMDATA_PUBLIC CompressedFile : public IRpFile
+{
+	protected:
+		/**
+		 * Random-access wrapper for block-compressed files.
+		 *
+		 * Subclasses parse the container's block table and call
+		 * setBlocks(). Blocks are decompressed on demand; small
+		 * blocks are cached, and large blocks are decompressed
+		 * as a stream, restarting only when seeking backwards.
+		 *
+		 * @param file Compressed file
+		 */
+		explicit CompressedFile(const IRpFilePtr &file);
+	public:
+		~CompressedFile() override;
+
+	private:
+		typedef IRpFile super;
+		RP_DISABLE_COPY(CompressedFile)
+	private:
+		friend class CompressedFilePrivate;
+		CompressedFilePrivate *const d_ptr;
+
+	public:
+		/**
+		 * Open a compressed file, if the container format is supported.
+		 * Currently supported: seekable zstd, zstd, xz
+		 * @param file File to check
+		 * @return CompressedFile, or nullptr if the file isn't a supported compressed file.
+		 */
+		static IRpFilePtr open(const IRpFilePtr &file);
+
+	public:
+		/**
+		 * Is the file open?
+		 * This usually only returns false if an error occurred.
+		 * @return True if the file is open; false if it isn't.
+		 */
+		bool isOpen(void) const final;
+
+		/**
+		 * Close the file.
+		 */
+		void close(void) override;
+
+		/**
+		 * Read data from the file.
+		 * @param ptr Output data buffer.
+		 * @param size Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 2, 3)
+		size_t read(void *ptr, size_t size) final;
+
+		/**
+		 * Write data to the file.
+		 * (NOTE: Not valid for CompressedFile; this will always return 0.)
+		 * @param ptr Input data buffer.
+		 * @param size Amount of data to read, in bytes.
+		 * @return Number of bytes written.
+		 */
+		ATTR_ACCESS_SIZE(read_only, 2, 3)
+		size_t write(const void *ptr, size_t size) final;
+
+		/**
+		 * Set the file position.
+		 * @param pos File position.
+		 * @return 0 on success; -1 on error.
+		 */
+		int seek(off64_t pos) final;
+
+		/**
+		 * Get the file position.
+		 * @return File position, or -1 on error.
+		 */
+		off64_t tell(void) final;
+
+		/**
+		 * Truncate the file.
+		 * (NOTE: Not valid for CompressedFile; this will always return -1.)
+		 * @param size New size. (default is 0)
+		 * @return 0 on success; -1 on error.
+		 */
+		int truncate(off64_t size = 0) final;
+
+		/**
+		 * Flush buffers.
+		 * (NOTE: Not valid for CompressedFile; this will always return -EBADF.)
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int flush(void) final;
+
+	public:
+		/** File properties **/
+
+		/**
+		 * Get the file size.
+		 * This is the uncompressed size.
+		 * @return File size, or negative on error.
+		 */
+		off64_t size(void) final;
+
+		/**
+		 * Get the filename.
+		 * @return Filename. (May be nullptr if the filename is not available.)
+		 */
+		const char *filename(void) const final;
+
+	public:
+		/** Positional I/O **/
+
+		/**
+		 * Read data from the file at the specified position.
+		 * The file position is not changed.
+		 * @param pos	[in] Start position.
+		 * @param ptr	[out] Output data buffer.
+		 * @param size	[in] Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		size_t readAt(off64_t pos, void *ptr, size_t size) final;
+
+	public:
+		/** CompressedFile functions **/
+
+		/**
+		 * Get the underlying compressed file.
+		 * @return Underlying file
+		 */
+		IRpFilePtr baseFile(void) const;
+
+		/**
+		 * Get the number of compressed blocks.
+		 * @return Number of blocks
+		 */
+		unsigned int blockCount(void) const;
+
+	protected:
+		/**
+		 * Compressed block.
+		 * Each block must be independently decompressible.
+		 */
+		struct Block {
+			off64_t compPos;	// Compressed position
+			off64_t compSize;	// Compressed size
+			off64_t uncompPos;	// Uncompressed position
+			off64_t uncompSize;	// Uncompressed size
+		};
+
+		/**
+		 * Set the block table.
+		 * Blocks must be contiguous in the uncompressed data,
+		 * starting at 0.
+		 * @param blocks Block table
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int setBlocks(std::vector<Block> &&blocks);
+
+		/**
+		 * Read compressed data.
+		 * @param pos	[in] Compressed position
+		 * @param ptr	[out] Output data buffer
+		 * @param size	[in] Amount of data to read, in bytes
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		size_t readCompressed(off64_t pos, void *ptr, size_t size);
+
+		/**
+		 * Start decompressing a block.
+		 * NOTE: Called with the block cache locked.
+		 * @param blockIdx	[in] Block index
+		 * @param block		[in] Block
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		virtual int beginBlock(unsigned int blockIdx, const Block &block) = 0;
+
+		/**
+		 * Continue decompressing the block started with beginBlock().
+		 * NOTE: Called with the block cache locked.
+		 * @param ptr	[out] Output data buffer
+		 * @param size	[in] Amount of data to decompress, in bytes
+		 * @return Number of bytes decompressed. (less than size on error or end of block)
+		 */
+		ATTR_ACCESS_SIZE(write_only, 2, 3)
+		virtual size_t decodeBlock(uint8_t *ptr, size_t size) = 0;
+};
+
+typedef std::shared_ptr<CompressedFile> CompressedFilePtr;
+
+}
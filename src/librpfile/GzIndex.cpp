@@ -0,0 +1,993 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * GzIndex.cpp: Random-access gzip decompression using an index of         *
+ * access points. (based on zlib's zran.c example)                         *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "stdafx.h"
+#include "GzIndex.hpp"
+#include "FileSystem.hpp"
+
+// librpbyteswap
+#include "librpbyteswap/byteswap_rp.h"
+
+// libcachecommon
+#include "libcachecommon/CacheKeys.hpp"
+
+// librpthreads
+#include "librpthreads/Mutex.hpp"
+using LibRpThreads::Mutex;
+using LibRpThreads::MutexLocker;
+
+// zlib
+#include <zlib.h>
+
+// C includes
+#include <sys/stat.h>
+#ifdef _WIN32
+#  include <io.h>
+#  include "libwin32common/RpWin32_sdk.h"
+#  include "libwin32common/w32err.hpp"
+#else /* !_WIN32 */
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+// C includes (C++ namespace)
+#include <cstdio>
+
+// C++ includes
+#include <algorithm>
+#include <vector>
+
+// C++ STL classes
+using std::string;
+using std::vector;
+#ifdef _WIN32
+using std::wstring;
+#endif /* _WIN32 */
+
+namespace LibRpFile {
+
+/** GzIndexPrivate **/
+
+class GzIndexPrivate
+{
+	public:
+		explicit GzIndexPrivate(int fd);
+		~GzIndexPrivate();
+
+	private:
+		RP_DISABLE_COPY(GzIndexPrivate)
+
+	public:
+		static constexpr unsigned int WINSIZE = 32768U;	// deflate window size
+		static constexpr unsigned int CHUNK = 65536U;	// compressed data buffer size
+		static constexpr unsigned int MAX_POINTS = 256U;	// span is doubled if exceeded
+
+		/**
+		 * Access point.
+		 * Decompression can be restarted here without
+		 * decompressing anything before it.
+		 */
+		struct AccessPoint {
+			off64_t out;		// Uncompressed offset
+			off64_t in;		// Compressed offset of the first full byte
+			int bits;		// Number of bits (1-7) from the byte at in-1, or 0
+			vector<uint8_t> window;	// Preceding uncompressed data (up to 32 KB)
+		};
+
+		/**
+		 * Index file header.
+		 * All fields are in little-endian.
+		 * The access points follow the header, and a CRC32
+		 * of everything before it is stored at the end.
+		 */
+		static constexpr char INDEX_MAGIC[8] = {'R','P','G','Z','I','D','X','2'};
+		struct IndexHeader {
+			char magic[8];		// INDEX_MAGIC
+			uint64_t comp_size;	// Compressed file size
+			int64_t mtime;		// Compressed file mtime
+			uint32_t span;		// Access point spacing
+			uint32_t count;		// Number of access points
+		};
+		ASSERT_STRUCT(IndexHeader, 32);
+
+		struct IndexPoint {
+			uint64_t out;		// Uncompressed offset
+			uint64_t in;		// Compressed offset
+			uint32_t bits;		// Number of bits from the byte at in-1
+			uint32_t window_len;	// Window length (window data follows)
+		};
+		ASSERT_STRUCT(IndexPoint, 24);
+
+	public:
+		// Mutex for the decompression state and index.
+		// NOTE: All GzIndex functions lock this, since RpFile::readAt()
+		// may be called from multiple threads at once.
+		mutable Mutex mutex;
+
+		int fd;			// Compressed file
+		int lastError;		// Last POSIX error
+		off64_t pos;		// Current position (uncompressed)
+
+		// File identity, for validating the saved index.
+		off64_t comp_size;
+		int64_t mtime;
+
+		// Index
+		vector<AccessPoint> points;	// Sorted by uncompressed offset
+		uint32_t span;			// Access point spacing
+		bool dirty;			// Index has new access points
+
+		// Decompression state
+		z_stream strm;
+		bool strmInit;		// inflateInit2() was called
+		bool strmActive;	// strm can continue decompressing at outPos
+		bool rawMode;		// Raw deflate (restarted at an access point)
+		bool eof;		// End of the compressed data
+		off64_t inPos;		// Compressed offset of the next byte to read into inbuf
+		off64_t outPos;		// Uncompressed offset of the next byte to decompress
+
+		// Circular window of the most recently decompressed data.
+		// Valid length is min(outPos, WINSIZE).
+		unsigned int wpos;
+		uint8_t window[WINSIZE];
+		uint8_t inbuf[CHUNK];
+
+	public:
+		/**
+		 * Read compressed data.
+		 * @param offset	[in] Compressed offset
+		 * @param buf		[out] Output buffer
+		 * @param size		[in] Size
+		 * @return Number of bytes read, or negative POSIX error code on error.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		ssize_t readComp(off64_t offset, void *buf, size_t size);
+
+		/**
+		 * Refill the input buffer.
+		 * Any unconsumed input is moved to the start of the buffer.
+		 * @return Number of new bytes, or negative POSIX error code on error.
+		 */
+		int fillInput(void);
+
+		/**
+		 * Skip compressed input bytes.
+		 * @param n Number of bytes to skip
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int skipInput(unsigned int n);
+
+		/**
+		 * (Re-)Start decompression.
+		 * @param pt Access point, or nullptr to start at the beginning.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int startAt(const AccessPoint *pt);
+
+		/**
+		 * Find the last access point at or before the specified position.
+		 * @param offset Uncompressed offset
+		 * @return Access point, or nullptr if none.
+		 */
+		const AccessPoint *findPoint(off64_t offset) const;
+
+		/**
+		 * Add an access point at the current decompression position.
+		 * Must be called at a deflate block boundary.
+		 */
+		void addPoint(void);
+
+		/**
+		 * Decompress data into the window.
+		 * @param pHave [out] Number of bytes decompressed
+		 * @return 0 on success; 1 on EOF; negative POSIX error code on error.
+		 */
+		int inflateStep(unsigned int *pHave);
+
+		/**
+		 * Read uncompressed data.
+		 * @param offset	[in] Uncompressed offset
+		 * @param ptr		[out] Output buffer
+		 * @param size		[in] Size
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		size_t readAt(off64_t offset, uint8_t *ptr, size_t size);
+
+		/**
+		 * Get the index cache key.
+		 * @param filename gzip filename
+		 * @return Cache key
+		 */
+		static string getCacheKey(const char *filename);
+
+		/**
+		 * Load the index from a file.
+		 * @param f Index file
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int loadIndex(FILE *f);
+
+		/**
+		 * Save the index to a file.
+		 * @param f Index file
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int saveIndex(FILE *f) const;
+};
+
+constexpr char GzIndexPrivate::INDEX_MAGIC[8];
+
+GzIndexPrivate::GzIndexPrivate(int fd)
+	: fd(fd)
+	, lastError(0)
+	, pos(0)
+	, comp_size(-1)
+	, mtime(-1)
+	, span(GzIndex::DEFAULT_SPAN)
+	, dirty(false)
+	, strmInit(false)
+	, strmActive(false)
+	, rawMode(false)
+	, eof(false)
+	, inPos(0)
+	, outPos(0)
+	, wpos(0)
+{
+	memset(&strm, 0, sizeof(strm));
+
+	// Get the file identity.
+#ifdef _WIN32
+	struct _stat64 sb;
+	if (_fstat64(fd, &sb) == 0) {
+#else /* !_WIN32 */
+	struct stat sb;
+	if (fstat(fd, &sb) == 0) {
+#endif /* _WIN32 */
+		comp_size = sb.st_size;
+		mtime = sb.st_mtime;
+	}
+}
+
+GzIndexPrivate::~GzIndexPrivate()
+{
+	if (strmInit) {
+		inflateEnd(&strm);
+	}
+	if (fd >= 0) {
+#ifdef _WIN32
+		_close(fd);
+#else /* !_WIN32 */
+		::close(fd);
+#endif /* _WIN32 */
+	}
+}
+
+/**
+ * Read compressed data.
+ * @param offset	[in] Compressed offset
+ * @param buf		[out] Output buffer
+ * @param size		[in] Size
+ * @return Number of bytes read, or negative POSIX error code on error.
+ */
+ssize_t GzIndexPrivate::readComp(off64_t offset, void *buf, size_t size)
+{
+#ifdef _WIN32
+	if (_lseeki64(fd, offset, SEEK_SET) != offset) {
+		return -errno;
+	}
+	const int ret = _read(fd, buf, static_cast<unsigned int>(size));
+	return (ret >= 0) ? ret : -errno;
+#else /* !_WIN32 */
+	ssize_t ret;
+	do {
+		ret = pread(fd, buf, size, offset);
+	} while (ret < 0 && errno == EINTR);
+	return (ret >= 0) ? ret : -errno;
+#endif /* _WIN32 */
+}
+
+/**
+ * Refill the input buffer.
+ * Any unconsumed input is moved to the start of the buffer.
+ * @return Number of new bytes, or negative POSIX error code on error.
+ */
+int GzIndexPrivate::fillInput(void)
+{
+	if (strm.avail_in > 0 && strm.next_in != inbuf) {
+		memmove(inbuf, strm.next_in, strm.avail_in);
+	}
+	strm.next_in = inbuf;
+
+	const ssize_t ret = readComp(inPos, &inbuf[strm.avail_in], CHUNK - strm.avail_in);
+	if (ret < 0) {
+		return static_cast<int>(ret);
+	}
+	strm.avail_in += static_cast<uInt>(ret);
+	inPos += ret;
+	return static_cast<int>(ret);
+}
+
+/**
+ * Skip compressed input bytes.
+ * @param n Number of bytes to skip
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int GzIndexPrivate::skipInput(unsigned int n)
+{
+	while (n > 0) {
+		if (strm.avail_in == 0) {
+			const int ret = fillInput();
+			if (ret < 0) {
+				return ret;
+			} else if (ret == 0) {
+				// Truncated file.
+				return -EIO;
+			}
+		}
+
+		const unsigned int skip = std::min(n, static_cast<unsigned int>(strm.avail_in));
+		strm.next_in += skip;
+		strm.avail_in -= skip;
+		n -= skip;
+	}
+	return 0;
+}
+
+/**
+ * (Re-)Start decompression.
+ * @param pt Access point, or nullptr to start at the beginning.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int GzIndexPrivate::startAt(const AccessPoint *pt)
+{
+	// windowBits: 15 + 32 for gzip/zlib autodetection, or -15 for raw deflate.
+	const int windowBits = (pt ? -15 : 15 + 32);
+	int zret;
+	if (!strmInit) {
+		zret = inflateInit2(&strm, windowBits);
+		if (zret != Z_OK) {
+			strmActive = false;
+			return -ENOMEM;
+		}
+		strmInit = true;
+	} else {
+		zret = inflateReset2(&strm, windowBits);
+		assert(zret == Z_OK);
+	}
+
+	strm.next_in = inbuf;
+	strm.avail_in = 0;
+	strmActive = false;
+	eof = false;
+	rawMode = (pt != nullptr);
+
+	if (!pt) {
+		inPos = 0;
+		outPos = 0;
+		wpos = 0;
+		strmActive = true;
+		return 0;
+	}
+
+	// Restart at the access point.
+	inPos = pt->in;
+	if (pt->bits != 0) {
+		// Prime the inflater with the bits from the previous byte.
+		uint8_t b;
+		if (readComp(pt->in - 1, &b, 1) != 1) {
+			return -EIO;
+		}
+		inflatePrime(&strm, pt->bits, b >> (8 - pt->bits));
+	}
+
+	const unsigned int window_len = static_cast<unsigned int>(pt->window.size());
+	if (window_len > 0) {
+		inflateSetDictionary(&strm, pt->window.data(), window_len);
+		memcpy(window, pt->window.data(), window_len);
+	}
+	wpos = window_len % WINSIZE;
+	outPos = pt->out;
+	strmActive = true;
+	return 0;
+}
+
+/**
+ * Find the last access point at or before the specified position.
+ * @param offset Uncompressed offset
+ * @return Access point, or nullptr if none.
+ */
+const GzIndexPrivate::AccessPoint *GzIndexPrivate::findPoint(off64_t offset) const
+{
+	auto iter = std::upper_bound(points.cbegin(), points.cend(), offset,
+		[](off64_t offset, const AccessPoint &pt) {
+			return offset < pt.out;
+		});
+	if (iter == points.cbegin()) {
+		return nullptr;
+	}
+	return &(*(iter - 1));
+}
+
+/**
+ * Add an access point at the current decompression position.
+ * Must be called at a deflate block boundary.
+ */
+void GzIndexPrivate::addPoint(void)
+{
+	AccessPoint pt;
+	pt.out = outPos;
+	pt.in = inPos - strm.avail_in;
+	pt.bits = strm.data_type & 7;
+
+	// Save the window in linear order.
+	if (outPos >= WINSIZE) {
+		pt.window.resize(WINSIZE);
+		memcpy(pt.window.data(), &window[wpos], WINSIZE - wpos);
+		memcpy(&pt.window[WINSIZE - wpos], window, wpos);
+	} else {
+		pt.window.assign(window, window + wpos);
+	}
+	points.push_back(std::move(pt));
+	dirty = true;
+
+	if (points.size() > MAX_POINTS) {
+		// Too many access points. Double the span and
+		// remove the points that are too close together.
+		span *= 2;
+		off64_t last = 0;
+		auto iter = std::remove_if(points.begin(), points.end(),
+			[this, &last](const AccessPoint &pt) {
+				if (pt.out - last < span) {
+					return true;
+				}
+				last = pt.out;
+				return false;
+			});
+		points.erase(iter, points.end());
+	}
+}
+
+/**
+ * Decompress data into the window.
+ * @param pHave [out] Number of bytes decompressed
+ * @return 0 on success; 1 on EOF; negative POSIX error code on error.
+ */
+int GzIndexPrivate::inflateStep(unsigned int *pHave)
+{
+	*pHave = 0;
+	if (strm.avail_in == 0) {
+		const int ret = fillInput();
+		if (ret < 0) {
+			return ret;
+		} else if (ret == 0) {
+			// Truncated file. Treat it as EOF.
+			eof = true;
+			return 1;
+		}
+	}
+
+	// Decompress up to the end of the circular window.
+	// Z_BLOCK stops at deflate block boundaries so
+	// access points can be added.
+	strm.next_out = &window[wpos];
+	strm.avail_out = WINSIZE - wpos;
+	int zret = inflate(&strm, Z_BLOCK);
+	const unsigned int have = (WINSIZE - wpos) - strm.avail_out;
+	wpos = (wpos + have) % WINSIZE;
+	outPos += have;
+	*pHave = have;
+
+	switch (zret) {
+		case Z_OK:
+		case Z_BUF_ERROR:
+			break;
+		case Z_STREAM_END: {
+			// End of a gzip member.
+			if (rawMode) {
+				// Raw deflate doesn't process the gzip trailer.
+				const int ret = skipInput(8);
+				if (ret != 0) {
+					eof = true;
+					return 1;
+				}
+				rawMode = false;
+			}
+
+			// Check for another gzip member.
+			if (strm.avail_in < 2) {
+				const int ret = fillInput();
+				if (ret < 0) {
+					return ret;
+				}
+			}
+			if (strm.avail_in < 2 || strm.next_in[0] != 0x1F || strm.next_in[1] != 0x8B) {
+				// No more gzip members.
+				// NOTE: Trailing garbage is ignored, like gzip.
+				eof = true;
+				return 1;
+			}
+			zret = inflateReset2(&strm, 15 + 16);
+			assert(zret == Z_OK);
+			return 0;
+		}
+		case Z_MEM_ERROR:
+			return -ENOMEM;
+		default:
+			// Z_NEED_DICT, Z_DATA_ERROR, etc.
+			return -EIO;
+	}
+
+	// Add an access point at the end of a deflate block,
+	// but not at the end of the last block in a member.
+	if ((strm.data_type & 128) && !(strm.data_type & 64)) {
+		const off64_t last = (!points.empty() ? points.back().out : 0);
+		if (outPos - last >= span) {
+			addPoint();
+		}
+	}
+	return 0;
+}
+
+/**
+ * Read uncompressed data.
+ * @param offset	[in] Uncompressed offset
+ * @param ptr		[out] Output buffer
+ * @param size		[in] Size
+ * @return Number of bytes read.
+ */
+size_t GzIndexPrivate::readAt(off64_t offset, uint8_t *ptr, size_t size)
+{
+	size_t total = 0;
+
+	if (strmActive && offset < outPos) {
+		// If the data is still in the window, copy it from there.
+		const off64_t back = outPos - offset;
+		if (back <= std::min<off64_t>(outPos, WINSIZE)) {
+			unsigned int wstart = (wpos + WINSIZE - static_cast<unsigned int>(back)) % WINSIZE;
+			size_t n = std::min(size, static_cast<size_t>(back));
+			total = n;
+			while (n > 0) {
+				const size_t chunk = std::min(n, static_cast<size_t>(WINSIZE - wstart));
+				memcpy(ptr, &window[wstart], chunk);
+				ptr += chunk;
+				n -= chunk;
+				wstart = 0;
+			}
+			offset += total;
+			size -= total;
+			if (size == 0) {
+				return total;
+			}
+		}
+	}
+
+	// Restart decompression if seeking backwards, or if an
+	// access point allows skipping ahead.
+	const AccessPoint *const pt = findPoint(offset);
+	if (!strmActive || offset < outPos || (pt && pt->out > outPos)) {
+		const int ret = startAt(pt);
+		if (ret != 0) {
+			lastError = -ret;
+			return total;
+		}
+	}
+
+	while (size > 0 && !eof) {
+		const unsigned int wstart = wpos;
+		unsigned int have;
+		const int ret = inflateStep(&have);
+
+		if (have > 0 && offset < outPos) {
+			// Copy the requested part of the new data.
+			const off64_t start = outPos - have;
+			const unsigned int skip = (offset > start) ? static_cast<unsigned int>(offset - start) : 0;
+			const size_t n = std::min(size, static_cast<size_t>(have - skip));
+			memcpy(ptr, &window[wstart + skip], n);
+			ptr += n;
+			offset += n;
+			size -= n;
+			total += n;
+		}
+
+		if (ret < 0) {
+			lastError = -ret;
+			strmActive = false;
+			break;
+		}
+	}
+
+	return total;
+}
+
+/**
+ * Get the index cache key.
+ * @param filename gzip filename
+ * @return Cache key
+ */
+string GzIndexPrivate::getCacheKey(const char *filename)
+{
+	const size_t len = strlen(filename);
+	const uLong crc = crc32(0, reinterpret_cast<const Bytef*>(filename), static_cast<uInt>(len));
+	const uLong adler = adler32(1, reinterpret_cast<const Bytef*>(filename), static_cast<uInt>(len));
+
+	char buf[48];
+	snprintf(buf, sizeof(buf), "gzidx/%08lX%08lX.idx", crc, adler);
+	return buf;
+}
+
+/**
+ * Load the index from a file.
+ * @param f Index file
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int GzIndexPrivate::loadIndex(FILE *f)
+{
+	if (comp_size < 0) {
+		// File identity isn't available.
+		return -EIO;
+	}
+
+	IndexHeader header;
+	if (fread(&header, 1, sizeof(header), f) != sizeof(header) ||
+	    memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) != 0)
+	{
+		return -EIO;
+	}
+	uLong crc = crc32(0, reinterpret_cast<const Bytef*>(&header), sizeof(header));
+	if (le64_to_cpu(header.comp_size) != static_cast<uint64_t>(comp_size) ||
+	    static_cast<int64_t>(le64_to_cpu(header.mtime)) != mtime)
+	{
+		// Index is for a different version of the file.
+		return -ESTALE;
+	}
+
+	const uint32_t new_span = le32_to_cpu(header.span);
+	const uint32_t count = le32_to_cpu(header.count);
+	if (new_span < GzIndex::DEFAULT_SPAN || count > MAX_POINTS) {
+		return -EIO;
+	}
+
+	vector<AccessPoint> new_points;
+	new_points.reserve(count);
+	off64_t last_out = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		IndexPoint ipt;
+		if (fread(&ipt, 1, sizeof(ipt), f) != sizeof(ipt)) {
+			return -EIO;
+		}
+		crc = crc32(crc, reinterpret_cast<const Bytef*>(&ipt), sizeof(ipt));
+
+		AccessPoint pt;
+		pt.out = static_cast<off64_t>(le64_to_cpu(ipt.out));
+		pt.in = static_cast<off64_t>(le64_to_cpu(ipt.in));
+		pt.bits = static_cast<int>(le32_to_cpu(ipt.bits));
+		const uint32_t window_len = le32_to_cpu(ipt.window_len);
+		if (pt.out <= last_out || pt.in <= 0 || pt.in > comp_size ||
+		    pt.bits > 7 || window_len > WINSIZE ||
+		    (window_len < WINSIZE && window_len != pt.out))
+		{
+			return -EIO;
+		}
+
+		pt.window.resize(window_len);
+		if (fread(pt.window.data(), 1, window_len, f) != window_len) {
+			return -EIO;
+		}
+		crc = crc32(crc, pt.window.data(), window_len);
+		last_out = pt.out;
+		new_points.push_back(std::move(pt));
+	}
+
+	// Verify the CRC32.
+	uint32_t crc_stored;
+	if (fread(&crc_stored, 1, sizeof(crc_stored), f) != sizeof(crc_stored) ||
+	    le32_to_cpu(crc_stored) != static_cast<uint32_t>(crc))
+	{
+		return -EIO;
+	}
+
+	// Index loaded.
+	points = std::move(new_points);
+	span = new_span;
+	dirty = false;
+	strmActive = false;
+	return 0;
+}
+
+/**
+ * Save the index to a file.
+ * @param f Index file
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int GzIndexPrivate::saveIndex(FILE *f) const
+{
+	IndexHeader header;
+	memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+	header.comp_size = cpu_to_le64(static_cast<uint64_t>(comp_size));
+	header.mtime = cpu_to_le64(static_cast<uint64_t>(mtime));
+	header.span = cpu_to_le32(span);
+	header.count = cpu_to_le32(static_cast<uint32_t>(points.size()));
+	if (fwrite(&header, 1, sizeof(header), f) != sizeof(header)) {
+		return -EIO;
+	}
+	uLong crc = crc32(0, reinterpret_cast<const Bytef*>(&header), sizeof(header));
+
+	for (const AccessPoint &pt : points) {
+		IndexPoint ipt;
+		ipt.out = cpu_to_le64(static_cast<uint64_t>(pt.out));
+		ipt.in = cpu_to_le64(static_cast<uint64_t>(pt.in));
+		ipt.bits = cpu_to_le32(static_cast<uint32_t>(pt.bits));
+		ipt.window_len = cpu_to_le32(static_cast<uint32_t>(pt.window.size()));
+		if (fwrite(&ipt, 1, sizeof(ipt), f) != sizeof(ipt) ||
+		    fwrite(pt.window.data(), 1, pt.window.size(), f) != pt.window.size())
+		{
+			return -EIO;
+		}
+		crc = crc32(crc, reinterpret_cast<const Bytef*>(&ipt), sizeof(ipt));
+		crc = crc32(crc, pt.window.data(), static_cast<uInt>(pt.window.size()));
+	}
+
+	// CRC32 of everything above.
+	const uint32_t crc_le = cpu_to_le32(static_cast<uint32_t>(crc));
+	if (fwrite(&crc_le, 1, sizeof(crc_le), f) != sizeof(crc_le)) {
+		return -EIO;
+	}
+	return 0;
+}
+
+/** GzIndex **/
+
+/**
+ * Open a gzip file for random-access decompression.
+ *
+ * Access points are added to the index as the file is
+ * decompressed. Seeking backwards, or far forwards, restarts
+ * decompression at the nearest access point instead of at
+ * the beginning of the file.
+ *
+ * NOTE: GzIndex takes ownership of fd and closes it
+ * when it's deleted.
+ *
+ * @param fd File descriptor (must be seekable)
+ */
+GzIndex::GzIndex(int fd)
+	: d_ptr(new GzIndexPrivate(fd))
+{ }
+
+GzIndex::~GzIndex()
+{
+	delete d_ptr;
+}
+
+/**
+ * Read data from the current position.
+ * @param ptr	[out] Output data buffer
+ * @param size	[in] Amount of data to read, in bytes
+ * @return Number of bytes read. (Check lastError() on short reads.)
+ */
+size_t GzIndex::read(void *ptr, size_t size)
+{
+	RP_D(GzIndex);
+	MutexLocker locker(d->mutex);
+	const size_t ret = d->readAt(d->pos, static_cast<uint8_t*>(ptr), size);
+	d->pos += ret;
+	return ret;
+}
+
+/**
+ * Read data from the specified position.
+ * The current position is not changed.
+ * @param pos	[in] Uncompressed position
+ * @param ptr	[out] Output data buffer
+ * @param size	[in] Amount of data to read, in bytes
+ * @return Number of bytes read. (Check lastError() on short reads.)
+ */
+size_t GzIndex::readAt(off64_t pos, void *ptr, size_t size)
+{
+	RP_D(GzIndex);
+	MutexLocker locker(d->mutex);
+	if (pos < 0) {
+		d->lastError = EINVAL;
+		return 0;
+	}
+	return d->readAt(pos, static_cast<uint8_t*>(ptr), size);
+}
+
+/**
+ * Set the current position.
+ * Decompression is deferred until the next read().
+ * @param pos Uncompressed position
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int GzIndex::seek(off64_t pos)
+{
+	RP_D(GzIndex);
+	MutexLocker locker(d->mutex);
+	if (pos < 0) {
+		d->lastError = EINVAL;
+		return -EINVAL;
+	}
+	d->pos = pos;
+	return 0;
+}
+
+/**
+ * Get the current position.
+ * @return Uncompressed position
+ */
+off64_t GzIndex::tell(void) const
+{
+	RP_D(const GzIndex);
+	MutexLocker locker(d->mutex);
+	return d->pos;
+}
+
+/**
+ * Get the last error.
+ * @return Last POSIX error, or 0 if no error.
+ */
+int GzIndex::lastError(void) const
+{
+	RP_D(const GzIndex);
+	MutexLocker locker(d->mutex);
+	return d->lastError;
+}
+
+/** Index **/
+
+/**
+ * Get the number of access points in the index.
+ * @return Number of access points
+ */
+unsigned int GzIndex::pointCount(void) const
+{
+	RP_D(const GzIndex);
+	MutexLocker locker(d->mutex);
+	return static_cast<unsigned int>(d->points.size());
+}
+
+/**
+ * Has the index changed since it was created or loaded?
+ * @return True if the index has new access points.
+ */
+bool GzIndex::isIndexDirty(void) const
+{
+	RP_D(const GzIndex);
+	MutexLocker locker(d->mutex);
+	return d->dirty;
+}
+
+/**
+ * Load the index from the cache directory.
+ * The index is only used if it matches the gzip file's
+ * compressed size and modification time.
+ * @param filename gzip filename (UTF-8; used for the cache key)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int GzIndex::loadIndexFromCache(const char *filename)
+{
+	assert(filename != nullptr);
+	if (!filename || filename[0] == '\0') {
+		return -EINVAL;
+	}
+
+	RP_D(GzIndex);
+	const string cacheKey = GzIndexPrivate::getCacheKey(filename);
+#ifdef _WIN32
+	const wstring cacheFilename = LibCacheCommon::getCacheFilename(
+		wstring(cacheKey.begin(), cacheKey.end()));
+	if (cacheFilename.empty()) {
+		return -ENOENT;
+	}
+	FILE *f = _wfopen(cacheFilename.c_str(), L"rb");
+#else /* !_WIN32 */
+	const string cacheFilename = LibCacheCommon::getCacheFilename(cacheKey);
+	if (cacheFilename.empty()) {
+		return -ENOENT;
+	}
+	FILE *f = fopen(cacheFilename.c_str(), "rb");
+#endif /* _WIN32 */
+	if (!f) {
+		return -errno;
+	}
+
+	MutexLocker locker(d->mutex);
+	const int ret = d->loadIndex(f);
+	fclose(f);
+	return ret;
+}
+
+/**
+ * Save the index to the cache directory.
+ *
+ * The index is written to a temporary file first, then renamed
+ * into place, so other processes never see a partial index.
+ *
+ * @param filename gzip filename (UTF-8; used for the cache key)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int GzIndex::saveIndexToCache(const char *filename) const
+{
+	assert(filename != nullptr);
+	if (!filename || filename[0] == '\0') {
+		return -EINVAL;
+	}
+
+	RP_D(const GzIndex);
+	if (d->comp_size < 0) {
+		// File identity isn't available.
+		return -EIO;
+	}
+
+	// Temporary filename suffix.
+	// The process ID is included in case multiple processes
+	// are saving the same index at the same time.
+	char tmp_suffix[24];
+#ifdef _WIN32
+	snprintf(tmp_suffix, sizeof(tmp_suffix), ".%lu.tmp", GetCurrentProcessId());
+#else /* !_WIN32 */
+	snprintf(tmp_suffix, sizeof(tmp_suffix), ".%ld.tmp", static_cast<long>(getpid()));
+#endif /* _WIN32 */
+
+	const string cacheKey = GzIndexPrivate::getCacheKey(filename);
+#ifdef _WIN32
+	const wstring cacheFilename = LibCacheCommon::getCacheFilename(
+		wstring(cacheKey.begin(), cacheKey.end()));
+	if (cacheFilename.empty()) {
+		return -ENOENT;
+	}
+	const wstring tmpFilename = cacheFilename + wstring(tmp_suffix, tmp_suffix + strlen(tmp_suffix));
+	FileSystem::rmkdir(cacheFilename);
+	FILE *f = _wfopen(tmpFilename.c_str(), L"wb");
+#else /* !_WIN32 */
+	const string cacheFilename = LibCacheCommon::getCacheFilename(cacheKey);
+	if (cacheFilename.empty()) {
+		return -ENOENT;
+	}
+	const string tmpFilename = cacheFilename + tmp_suffix;
+	FileSystem::rmkdir(cacheFilename);
+	FILE *f = fopen(tmpFilename.c_str(), "wb");
+#endif /* _WIN32 */
+	if (!f) {
+		return -errno;
+	}
+
+	int ret;
+	{
+		MutexLocker locker(d->mutex);
+		ret = d->saveIndex(f);
+	}
+	if (fclose(f) != 0 && ret == 0) {
+		ret = -EIO;
+	}
+
+	if (ret == 0) {
+		// Move the new index into place.
+#ifdef _WIN32
+		if (!MoveFileExW(tmpFilename.c_str(), cacheFilename.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+			ret = -w32err_to_posix(GetLastError());
+		}
+#else /* !_WIN32 */
+		if (rename(tmpFilename.c_str(), cacheFilename.c_str()) != 0) {
+			ret = -errno;
+		}
+#endif /* _WIN32 */
+	}
+	if (ret != 0) {
+		// Don't leave a partial index behind.
+#ifdef _WIN32
+		_wremove(tmpFilename.c_str());
+#else /* !_WIN32 */
+		remove(tmpFilename.c_str());
+#endif /* _WIN32 */
+	}
+	return ret;
+}
+
+}
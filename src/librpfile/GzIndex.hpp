@@ -0,0 +1,129 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * GzIndex.hpp: Random-access gzip decompression using an index of         *
+ * access points. (based on zlib's zran.c example)                         *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+// C includes
+#include <sys/types.h>	// for off64_t
+
+// C includes (C++ namespace)
+#include <cstddef>	// for size_t
+#include <cstdint>
+
+// Common macros
+#include "common.h"
+
+namespace LibRpFile {
+
+class GzIndexPrivate;
+class GzIndex
+{
+	public:
+		/**
+		 * Default access point spacing, in bytes of uncompressed data.
+		 * This is doubled if the index gets too large.
+		 */
+		static constexpr uint32_t DEFAULT_SPAN = 1024U * 1024U;
+
+		/**
+		 * Open a gzip file for random-access decompression.
+		 *
+		 * Access points are added to the index as the file is
+		 * decompressed. Seeking backwards, or far forwards, restarts
+		 * decompression at the nearest access point instead of at
+		 * the beginning of the file.
+		 *
+		 * NOTE: GzIndex takes ownership of fd and closes it
+		 * when it's deleted.
+		 *
+		 * @param fd File descriptor (must be seekable)
+		 */
+		explicit GzIndex(int fd);
+		~GzIndex();
+
+	private:
+		RP_DISABLE_COPY(GzIndex)
+	private:
+		friend class GzIndexPrivate;
+		GzIndexPrivate *const d_ptr;
+
+	public:
+		/**
+		 * Read data from the current position.
+		 * @param ptr	[out] Output data buffer
+		 * @param size	[in] Amount of data to read, in bytes
+		 * @return Number of bytes read. (Check lastError() on short reads.)
+		 */
+		ATTR_ACCESS_SIZE(write_only, 2, 3)
+		size_t read(void *ptr, size_t size);
+
+		/**
+		 * Read data from the specified position.
+		 * The current position is not changed.
+		 * @param pos	[in] Uncompressed position
+		 * @param ptr	[out] Output data buffer
+		 * @param size	[in] Amount of data to read, in bytes
+		 * @return Number of bytes read. (Check lastError() on short reads.)
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		size_t readAt(off64_t pos, void *ptr, size_t size);
+
+		/**
+		 * Set the current position.
+		 * Decompression is deferred until the next read().
+		 * @param pos Uncompressed position
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int seek(off64_t pos);
+
+		/**
+		 * Get the current position.
+		 * @return Uncompressed position
+		 */
+		off64_t tell(void) const;
+
+		/**
+		 * Get the last error.
+		 * @return Last POSIX error, or 0 if no error.
+		 */
+		int lastError(void) const;
+
+	public:
+		/** Index **/
+
+		/**
+		 * Get the number of access points in the index.
+		 * @return Number of access points
+		 */
+		unsigned int pointCount(void) const;
+
+		/**
+		 * Has the index changed since it was created or loaded?
+		 * @return True if the index has new access points.
+		 */
+		bool isIndexDirty(void) const;
+
+		/**
+		 * Load the index from the cache directory.
+		 * The index is only used if it matches the gzip file's
+		 * compressed size and modification time.
+		 * @param filename gzip filename (UTF-8; used for the cache key)
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int loadIndexFromCache(const char *filename);
+
+		/**
+		 * Save the index to the cache directory.
+		 * @param filename gzip filename (UTF-8; used for the cache key)
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int saveIndexToCache(const char *filename) const;
+};
+
+}
@@ -9,6 +9,11 @@
 #include "stdafx.h"
 #include "IRpFile.hpp"
 
+// librpthreads
+#include "librpthreads/Mutex.hpp"
+using LibRpThreads::Mutex;
+using LibRpThreads::MutexLocker;
+
 namespace LibRpFile {
 
 IRpFile::IRpFile()
@@ -16,10 +21,138 @@ IRpFile::IRpFile()
 	, m_isWritable(false)
 	, m_isCompressed(false)
 	, m_fileType(DT_REG)
+	, m_peekBuf(nullptr)
+	, m_peekBufSize(0)
+	, m_readAtMutex(new Mutex())
 {
 	static_assert(sizeof(off64_t) == 8, "off64_t is not 64-bit!");
 }
 
+IRpFile::~IRpFile()
+{
+	free(m_peekBuf);
+	delete m_readAtMutex;
+}
+
+/**
+ * Get a read-only pointer to the data at the specified position.
+ *
+ * If isPeekZeroCopy() is true, the returned pointer refers to the
+ * file data directly (e.g. a memory buffer or a memory-mapped file)
+ * and remains valid until the file is closed.
+ *
+ * Otherwise, the data is read into an internal buffer, the
+ * file position is changed, and the returned pointer is only
+ * valid until the next call to peek().
+ *
+ * NOTE: The returned pointer has no alignment guarantee.
+ * For zero-copy files, it's usually only as aligned as pos.
+ * Check the alignment or use memcpy() before accessing
+ * anything larger than a byte.
+ *
+ * @param pos	[in] Start position.
+ * @param size	[in] Amount of data to access, in bytes.
+ * @return Pointer to the data, or nullptr if the full range isn't available.
+ */
+const uint8_t *IRpFile::peek(off64_t pos, size_t size)
+{
+	if (unlikely(size == 0 || pos < 0)) {
+		return nullptr;
+	}
+
+	// Default implementation: Read the data into the peek buffer.
+	if (size > m_peekBufSize) {
+		uint8_t *const newBuf = static_cast<uint8_t*>(realloc(m_peekBuf, size));
+		if (!newBuf) {
+			m_lastError = ENOMEM;
+			return nullptr;
+		}
+		m_peekBuf = newBuf;
+		m_peekBufSize = size;
+	}
+
+	const size_t cbRead = this->seekAndRead(pos, m_peekBuf, size);
+	return (cbRead == size) ? m_peekBuf : nullptr;
+}
+
+/**
+ * Read data from the file at the specified position.
+ * The file position is not changed.
+ *
+ * Subclasses that can do this natively (e.g. using pread())
+ * should override this function. The default implementation
+ * emulates it using seek() and read(), serialized by a mutex.
+ *
+ * NOTE: The emulated readAt() is only serialized against other
+ * readAt() calls. It temporarily changes the file position, so it
+ * must not be used while another thread calls read(), seek(), tell(),
+ * or anything else that uses the file position on the same object.
+ * Code that reads a file from multiple threads must only use
+ * readAt() and readAtV() while the threads are running.
+ *
+ * @param pos	[in] Start position.
+ * @param ptr	[out] Output data buffer.
+ * @param size	[in] Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t IRpFile::readAt(off64_t pos, void *ptr, size_t size)
+{
+	if (unlikely(pos < 0)) {
+		m_lastError = EINVAL;
+		return 0;
+	} else if (unlikely(size == 0)) {
+		return 0;
+	}
+
+	MutexLocker locker(*m_readAtMutex);
+
+	const off64_t oldPos = this->tell();
+	if (oldPos < 0) {
+		// tell() failed.
+		return 0;
+	}
+
+	const size_t ret = this->seekAndRead(pos, ptr, size);
+
+	// Restore the original file position.
+	// NOTE: Keep the read error, if any.
+	const int err = m_lastError;
+	this->seek(oldPos);
+	if (err != 0) {
+		m_lastError = err;
+	}
+	return ret;
+}
+
+/**
+ * Read a contiguous range of the file into multiple buffers.
+ * The file position is not changed.
+ *
+ * The buffers are filled in order, starting at pos.
+ * Reading stops at the first short read.
+ *
+ * NOTE: The same thread-safety rules as readAt() apply.
+ *
+ * @param pos	[in] Start position.
+ * @param iov	[in] Array of buffer descriptors.
+ * @param iovcnt	[in] Number of buffer descriptors.
+ * @return Total number of bytes read.
+ */
+size_t IRpFile::readAtV(off64_t pos, const IoVec *iov, unsigned int iovcnt)
+{
+	size_t total = 0;
+	for (; iovcnt > 0; iov++, iovcnt--) {
+		const size_t ret = this->readAt(pos, iov->ptr, iov->size);
+		total += ret;
+		if (ret != iov->size) {
+			// Short read.
+			break;
+		}
+		pos += ret;
+	}
+	return total;
+}
+
 /**
  * Get a single character (byte) from the file
  * @return Character from file, or EOF on end of file or error.
@@ -25,6 +25,10 @@
 #include "dll-macros.h"	// for RP_LIBROMDATA_PUBLIC
 #include "d_type.h"
 
+namespace LibRpThreads {
+	class Mutex;
+}
+
 namespace LibRpFile {
 
 class RP_LIBROMDATA_PUBLIC NOVTABLE IRpFile
@@ -32,7 +36,7 @@ class RP_LIBROMDATA_PUBLIC NOVTABLE IRpFile
 	protected:
 		explicit IRpFile();
 	public:
-		virtual ~IRpFile() = default;
+		virtual ~IRpFile();
 
 	private:
 		RP_DISABLE_COPY(IRpFile)
@@ -199,6 +203,128 @@ class RP_LIBROMDATA_PUBLIC NOVTABLE IRpFile
 			return -ENOTSUP;
 		}
 
+	public:
+		/** Zero-copy access **/
+
+		/**
+		 * Does peek() return a pointer into the file data itself?
+		 * If false, peek() is emulated by reading into an internal buffer.
+		 * @return True if peek() is zero-copy; false if not.
+		 */
+		virtual bool isPeekZeroCopy(void) const
+		{
+			return false;
+		}
+
+		/**
+		 * Get a read-only pointer to the data at the specified position.
+		 *
+		 * If isPeekZeroCopy() is true, the returned pointer refers to the
+		 * file data directly (e.g. a memory buffer or a memory-mapped file)
+		 * and remains valid until the file is closed.
+		 *
+		 * Otherwise, the data is read into an internal buffer, the
+		 * file position is changed, and the returned pointer is only
+		 * valid until the next call to peek().
+		 *
+		 * NOTE: The returned pointer has no alignment guarantee.
+		 * For zero-copy files, it's usually only as aligned as pos.
+		 * Check the alignment or use memcpy() before accessing
+		 * anything larger than a byte.
+		 *
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Amount of data to access, in bytes.
+		 * @return Pointer to the data, or nullptr if the full range isn't available.
+		 */
+		virtual const uint8_t *peek(off64_t pos, size_t size);
+
+	public:
+		/** Positional I/O **/
+
+		/**
+		 * Buffer descriptor for readAtV().
+		 */
+		struct IoVec {
+			void *ptr;	// Output data buffer
+			size_t size;	// Amount of data to read, in bytes
+		};
+
+		/**
+		 * Read data from the file at the specified position.
+		 * The file position is not changed.
+		 *
+		 * Subclasses that can do this natively (e.g. using pread())
+		 * should override this function. The default implementation
+		 * emulates it using seek() and read(), serialized by a mutex.
+		 *
+		 * NOTE: The emulated readAt() is only serialized against other
+		 * readAt() calls. It temporarily changes the file position, so it
+		 * must not be used while another thread calls read(), seek(), tell(),
+		 * or anything else that uses the file position on the same object.
+		 * Code that reads a file from multiple threads must only use
+		 * readAt() and readAtV() while the threads are running.
+		 *
+		 * @param pos	[in] Start position.
+		 * @param ptr	[out] Output data buffer.
+		 * @param size	[in] Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		virtual size_t readAt(off64_t pos, void *ptr, size_t size);
+
+		/**
+		 * Read a contiguous range of the file into multiple buffers.
+		 * The file position is not changed.
+		 *
+		 * The buffers are filled in order, starting at pos.
+		 * Reading stops at the first short read.
+		 *
+		 * NOTE: The same thread-safety rules as readAt() apply.
+		 *
+		 * @param pos	[in] Start position.
+		 * @param iov	[in] Array of buffer descriptors.
+		 * @param iovcnt	[in] Number of buffer descriptors.
+		 * @return Total number of bytes read.
+		 */
+		virtual size_t readAtV(off64_t pos, const IoVec *iov, unsigned int iovcnt);
+
+	public:
+		/** Access pattern hints **/
+
+		/**
+		 * Access pattern hint for advise().
+		 * These correspond to posix_fadvise() advice values.
+		 */
+		enum AccessHint : uint8_t {
+			AH_NORMAL	= 0,	// No specific access pattern (default)
+			AH_SEQUENTIAL	= 1,	// Sequential access; increase readahead
+			AH_RANDOM	= 2,	// Random access; disable readahead
+			AH_WILLNEED	= 3,	// Data will be needed soon; start reading it
+			AH_DONTNEED	= 4,	// Data won't be needed again; drop it from the page cache
+			AH_NOREUSE	= 5,	// Data will only be accessed once
+		};
+
+		/**
+		 * Tell the OS how a range of the file will be accessed.
+		 *
+		 * This is only a hint. It doesn't change the file contents
+		 * or the file position, and errors can usually be ignored.
+		 * Wrapper classes should translate the range and forward
+		 * the hint to the underlying file.
+		 *
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+		 * @param hint	[in] Access hint.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		virtual int advise(off64_t pos, off64_t size, AccessHint hint)
+		{
+			RP_UNUSED(pos);
+			RP_UNUSED(size);
+			RP_UNUSED(hint);
+			return -ENOTSUP;
+		}
+
 	public:
 		/** Convenience functions implemented for all IRpFile subclasses **/
 
@@ -287,6 +413,15 @@ class RP_LIBROMDATA_PUBLIC NOVTABLE IRpFile
 		bool m_isWritable;	// Is this file writable?
 		bool m_isCompressed;	// Is this file compressed?
 		uint8_t m_fileType;	// File type (see d_type.h)
+
+	private:
+		// Buffer for emulated peek()
+		uint8_t *m_peekBuf;
+		size_t m_peekBufSize;
+
+		// Mutex for emulated readAt()
+		// NOTE: Only serializes readAt() calls, not read() or seek().
+		LibRpThreads::Mutex *m_readAtMutex;
 };
 
 typedef std::shared_ptr<IRpFile> IRpFilePtr;
@@ -0,0 +1,310 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * IoTrace.cpp: I/O trace recorder for profiling file access patterns.     *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "stdafx.h"
+#include "IoTrace.hpp"
+
+// C++ includes
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+
+#ifdef __GNUC__
+#  include <cxxabi.h>
+#endif /* __GNUC__ */
+
+// librpthreads
+#include "librpthreads/Mutex.hpp"
+using LibRpThreads::Mutex;
+using LibRpThreads::MutexLocker;
+
+// C++ STL classes
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+namespace LibRpFile {
+
+/** IoTracePrivate **/
+
+class IoTracePrivate
+{
+	public:
+		IoTracePrivate();
+
+	private:
+		RP_DISABLE_COPY(IoTracePrivate)
+
+	public:
+		std::chrono::steady_clock::time_point start;
+		vector<IoTrace::Event> events;
+		mutable Mutex mutex;
+
+		// Active trace
+		static std::atomic<IoTrace*> active;
+};
+
+std::atomic<IoTrace*> IoTracePrivate::active(nullptr);
+
+IoTracePrivate::IoTracePrivate()
+	: start(std::chrono::steady_clock::now())
+{ }
+
+/** IoTrace **/
+
+/**
+ * I/O trace recorder.
+ *
+ * TracingFile records all accesses to its underlying file here.
+ * If an IoTrace is set as the active trace, child readers
+ * (SparseDiscReader, PartitionFile, SubFile, etc.) also record
+ * their reads, tagged with their class names.
+ */
+IoTrace::IoTrace()
+	: d_ptr(new IoTracePrivate())
+{ }
+
+IoTrace::~IoTrace()
+{
+	// Make sure this trace isn't still active.
+	IoTrace *self = this;
+	IoTracePrivate::active.compare_exchange_strong(self, nullptr);
+
+	delete d_ptr;
+}
+
+/**
+ * Get the current trace time.
+ * @return Nanoseconds since the trace was created
+ */
+uint64_t IoTrace::now(void) const
+{
+	RP_D(const IoTrace);
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - d->start).count());
+}
+
+/**
+ * Record an I/O event.
+ * This function is thread-safe.
+ * @param op		[in] Operation
+ * @param tag		[in] Caller tag (must have static storage duration)
+ * @param pos		[in] Position (-1 if unknown)
+ * @param size		[in] Requested size
+ * @param ret		[in] Bytes returned
+ * @param start_ns	[in] Start time, from now()
+ */
+void IoTrace::record(Op op, const char *tag, off64_t pos, size_t size, size_t ret, uint64_t start_ns)
+{
+	const uint64_t end_ns = now();
+
+	Event event;
+	event.start_ns = start_ns;
+	event.latency_ns = (end_ns > start_ns) ? (end_ns - start_ns) : 0;
+	event.tag = tag;
+	event.pos = pos;
+	event.size = size;
+	event.ret = ret;
+	event.op = op;
+
+	RP_D(IoTrace);
+	MutexLocker locker(d->mutex);
+	d->events.push_back(event);
+}
+
+/**
+ * Get all recorded events, sorted by start time.
+ * @return Events
+ */
+vector<IoTrace::Event> IoTrace::events(void) const
+{
+	RP_D(const IoTrace);
+	vector<Event> events;
+	{
+		MutexLocker locker(d->mutex);
+		events = d->events;
+	}
+
+	// Events are recorded when they finish, so nested
+	// events are recorded before their callers.
+	std::stable_sort(events.begin(), events.end(),
+		[](const Event &a, const Event &b) {
+			return a.start_ns < b.start_ns;
+		});
+	return events;
+}
+
+/**
+ * Discard all recorded events.
+ */
+void IoTrace::clear(void)
+{
+	RP_D(IoTrace);
+	MutexLocker locker(d->mutex);
+	d->events.clear();
+}
+
+/** Summary **/
+
+/**
+ * Summarize the recorded events by caller tag.
+ * Tags are listed in order of first access.
+ * @return Summaries
+ */
+vector<IoTrace::Summary> IoTrace::summarize(void) const
+{
+	vector<Summary> summaries;
+
+	// Per-tag state, indexed by raw tag pointer.
+	// NOTE: Different tag pointers may have the same display name,
+	// so the display names are merged afterwards.
+	struct TagState {
+		size_t idx;	// Index in summaries
+		off64_t pos;	// Current position (end of the previous access)
+	};
+	unordered_map<const char*, TagState> tagMap;
+	unordered_map<string, size_t> nameMap;
+
+	for (const Event &event : events()) {
+		auto iter = tagMap.find(event.tag);
+		if (iter == tagMap.end()) {
+			string name = tagName(event.tag);
+			size_t idx;
+			auto nameIter = nameMap.find(name);
+			if (nameIter != nameMap.end()) {
+				idx = nameIter->second;
+			} else {
+				idx = summaries.size();
+				Summary summary;
+				summary.tag = name;
+				summary.reads = 0;
+				summary.seeks = 0;
+				summary.bytesRequested = 0;
+				summary.bytesRead = 0;
+				summary.seekDistance = 0;
+				summary.latency_ns = 0;
+				summary.histogram.fill(0);
+				summaries.push_back(std::move(summary));
+				nameMap.emplace(std::move(name), idx);
+			}
+			iter = tagMap.emplace(event.tag, TagState{idx, 0}).first;
+		}
+
+		TagState &state = iter->second;
+		Summary &summary = summaries[state.idx];
+		if (event.op == Op::Seek) {
+			summary.seeks++;
+			if (event.pos >= 0) {
+				summary.seekDistance += static_cast<uint64_t>(std::abs(event.pos - state.pos));
+				state.pos = event.pos;
+			}
+			continue;
+		}
+
+		// Read, ReadAt, or Peek
+		summary.reads++;
+		summary.bytesRequested += event.size;
+		summary.bytesRead += event.ret;
+		summary.latency_ns += event.latency_ns;
+		if (event.pos >= 0) {
+			summary.seekDistance += static_cast<uint64_t>(std::abs(event.pos - state.pos));
+			state.pos = event.pos;
+		}
+		state.pos += event.ret;
+
+		// Histogram bucket: number of significant bits in the size.
+		unsigned int bucket = 0;
+		for (size_t sz = event.size; sz != 0 && bucket < HISTOGRAM_BUCKETS-1; sz >>= 1) {
+			bucket++;
+		}
+		summary.histogram[bucket]++;
+	}
+
+	return summaries;
+}
+
+/**
+ * Get the display name for a caller tag.
+ * Type names are demangled and namespaces are removed.
+ * @param tag Caller tag
+ * @return Display name
+ */
+string IoTrace::tagName(const char *tag)
+{
+	if (!tag) {
+		return "(unknown)";
+	}
+
+	string name;
+#ifdef __GNUC__
+	// typeid().name() is mangled on gcc and clang.
+	int status = -1;
+	char *const demangled = abi::__cxa_demangle(tag, nullptr, nullptr, &status);
+	if (demangled) {
+		if (status == 0) {
+			name = demangled;
+		}
+		free(demangled);
+	}
+#endif /* __GNUC__ */
+	if (name.empty()) {
+		name = tag;
+		// MSVC: Remove the "class " prefix.
+		if (!name.compare(0, 6, "class ")) {
+			name.erase(0, 6);
+		}
+	}
+
+	// Remove the namespace.
+	const size_t colon = name.rfind("::");
+	if (colon != string::npos) {
+		name.erase(0, colon + 2);
+	}
+	return name;
+}
+
+/**
+ * Get the name of an operation.
+ * @param op Operation
+ * @return Name
+ */
+const char *IoTrace::opName(Op op)
+{
+	static const char op_names[][8] = {
+		"read", "readAt", "peek", "seek",
+	};
+	static_assert(ARRAY_SIZE(op_names) == static_cast<size_t>(Op::Max), "op_names[] is out of sync with Op!");
+
+	const size_t idx = static_cast<size_t>(op);
+	assert(idx < ARRAY_SIZE(op_names));
+	return (idx < ARRAY_SIZE(op_names)) ? op_names[idx] : "unknown";
+}
+
+/** Active trace **/
+
+/**
+ * Get the active trace.
+ * @return Active trace, or nullptr if tracing is disabled.
+ */
+IoTrace *IoTrace::active(void)
+{
+	return IoTracePrivate::active.load(std::memory_order_relaxed);
+}
+
+/**
+ * Set the active trace.
+ * The caller retains ownership; call setActive(nullptr)
+ * before deleting the trace.
+ * @param trace Active trace, or nullptr to disable tracing.
+ */
+void IoTrace::setActive(IoTrace *trace)
+{
+	IoTracePrivate::active.store(trace, std::memory_order_relaxed);
+}
+
+}
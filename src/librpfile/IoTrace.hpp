@@ -0,0 +1,217 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * IoTrace.hpp: I/O trace recorder for profiling file access patterns.     *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+// C includes
+#include <sys/types.h>	// for off64_t
+
+// C includes (C++ namespace)
+#include <cstddef>	// for size_t
+#include <cstdint>
+
+// C++ includes
+#include <array>
+#include <string>
+#include <vector>
+
+// Common macros
+#include "common.h"
+#include "dll-macros.h"	// for RP_LIBROMDATA_PUBLIC
+
+namespace LibRpFile {
+
+class IoTracePrivate;
+class RP_LIBROMDATA_PUBLIC IoTrace
+{
+	public:
+		/**
+		 * I/O trace recorder.
+		 *
+		 * TracingFile records all accesses to its underlying file here.
+		 * If an IoTrace is set as the active trace, child readers
+		 * (SparseDiscReader, PartitionFile, SubFile, etc.) also record
+		 * their reads, tagged with their class names.
+		 */
+		IoTrace();
+		~IoTrace();
+
+	private:
+		RP_DISABLE_COPY(IoTrace)
+	private:
+		friend class IoTracePrivate;
+		IoTracePrivate *const d_ptr;
+
+	public:
+		enum class Op : uint8_t {
+			Read	= 0,	// read(): Sequential read
+			ReadAt	= 1,	// readAt(): Positional read
+			Peek	= 2,	// peek(): Zero-copy access
+			Seek	= 3,	// seek()
+
+			Max
+		};
+
+		/**
+		 * Recorded I/O event.
+		 */
+		struct Event {
+			uint64_t start_ns;	// Start time, relative to trace creation
+			uint64_t latency_ns;	// Time taken
+			const char *tag;	// Caller tag (raw type name; use tagName() to display)
+			off64_t pos;		// Position (-1 if unknown)
+			size_t size;		// Requested size
+			size_t ret;		// Bytes returned
+			Op op;			// Operation
+		};
+
+		/**
+		 * Get the current trace time.
+		 * @return Nanoseconds since the trace was created
+		 */
+		uint64_t now(void) const;
+
+		/**
+		 * Record an I/O event.
+		 * This function is thread-safe.
+		 * @param op		[in] Operation
+		 * @param tag		[in] Caller tag (must have static storage duration)
+		 * @param pos		[in] Position (-1 if unknown)
+		 * @param size		[in] Requested size
+		 * @param ret		[in] Bytes returned
+		 * @param start_ns	[in] Start time, from now()
+		 */
+		void record(Op op, const char *tag, off64_t pos, size_t size, size_t ret, uint64_t start_ns);
+
+		/**
+		 * Get all recorded events, sorted by start time.
+		 * @return Events
+		 */
+		std::vector<Event> events(void) const;
+
+		/**
+		 * Discard all recorded events.
+		 */
+		void clear(void);
+
+	public:
+		/** Summary **/
+
+		/**
+		 * Number of read size histogram buckets.
+		 * Bucket 0 is for empty reads; bucket n is for reads
+		 * of [2^(n-1), 2^n) bytes. The last bucket has all
+		 * reads that are larger than that.
+		 */
+		static constexpr unsigned int HISTOGRAM_BUCKETS = 24;
+
+		/**
+		 * Per-tag summary.
+		 */
+		struct Summary {
+			std::string tag;		// Caller tag (display name)
+			uint64_t reads;			// Number of read(), readAt(), and peek() calls
+			uint64_t seeks;			// Number of seek() calls
+			uint64_t bytesRequested;	// Total bytes requested
+			uint64_t bytesRead;		// Total bytes returned
+			uint64_t seekDistance;		// Total distance between the end of one access and the start of the next
+			uint64_t latency_ns;		// Total time spent in reads
+			std::array<uint64_t, HISTOGRAM_BUCKETS> histogram;	// Read size histogram
+		};
+
+		/**
+		 * Summarize the recorded events by caller tag.
+		 * Tags are listed in order of first access.
+		 * @return Summaries
+		 */
+		std::vector<Summary> summarize(void) const;
+
+		/**
+		 * Get the display name for a caller tag.
+		 * Type names are demangled and namespaces are removed.
+		 * @param tag Caller tag
+		 * @return Display name
+		 */
+		static std::string tagName(const char *tag);
+
+		/**
+		 * Get the name of an operation.
+		 * @param op Operation
+		 * @return Name
+		 */
+		static const char *opName(Op op);
+
+	public:
+		/** Active trace **/
+
+		/**
+		 * Get the active trace.
+		 * @return Active trace, or nullptr if tracing is disabled.
+		 */
+		static IoTrace *active(void);
+
+		/**
+		 * Set the active trace.
+		 * The caller retains ownership; call setActive(nullptr)
+		 * before deleting the trace.
+		 * @param trace Active trace, or nullptr to disable tracing.
+		 */
+		static void setActive(IoTrace *trace);
+
+		/**
+		 * Scoped recorder for the active trace.
+		 * Does nothing if tracing is disabled.
+		 */
+		class Scope
+		{
+			public:
+				inline Scope(Op op, const char *tag, off64_t pos, size_t size)
+					: m_trace(IoTrace::active())
+					, m_tag(tag)
+					, m_pos(pos)
+					, m_size(size)
+					, m_ret(0)
+					, m_start(0)
+					, m_op(op)
+				{
+					if (unlikely(m_trace)) {
+						m_start = m_trace->now();
+					}
+				}
+
+				inline ~Scope()
+				{
+					if (unlikely(m_trace)) {
+						m_trace->record(m_op, m_tag, m_pos, m_size, m_ret, m_start);
+					}
+				}
+
+				/**
+				 * Set the number of bytes returned.
+				 * @param ret Bytes returned
+				 * @return ret
+				 */
+				inline size_t ret(size_t ret)
+				{
+					m_ret = ret;
+					return ret;
+				}
+
+			private:
+				RP_DISABLE_COPY(Scope)
+				IoTrace *const m_trace;
+				const char *const m_tag;
+				const off64_t m_pos;
+				const size_t m_size;
+				size_t m_ret;
+				uint64_t m_start;
+				const Op m_op;
+		};
+};
+
+}
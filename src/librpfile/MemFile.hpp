@@ -114,6 +114,42 @@ class RP_LIBROMDATA_PUBLIC MemFile : public IRpFile
 			return m_filename;
 		}
 
+	public:
+		/** Zero-copy access **/
+
+		/**
+		 * Does peek() return a pointer into the file data itself?
+		 * @return True if peek() is zero-copy; false if not.
+		 */
+		bool isPeekZeroCopy(void) const final
+		{
+			return true;
+		}
+
+		/**
+		 * Get a read-only pointer to the data at the specified position.
+		 * The pointer refers to the memory buffer directly.
+		 * NOTE: The file position is not changed.
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Amount of data to access, in bytes.
+		 * @return Pointer to the data, or nullptr if the full range isn't available.
+		 */
+		const uint8_t *peek(off64_t pos, size_t size) final;
+
+	public:
+		/** Positional I/O **/
+
+		/**
+		 * Read data from the file at the specified position.
+		 * The file position is not changed.
+		 * @param pos	[in] Start position.
+		 * @param ptr	[out] Output data buffer.
+		 * @param size	[in] Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		size_t readAt(off64_t pos, void *ptr, size_t size) final;
+
 	public:
 		/** MemFile functions **/
 
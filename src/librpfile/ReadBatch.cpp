@@ -0,0 +1,604 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * ReadBatch.cpp: Batched positional reads across multiple files.          *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "stdafx.h"
+#include "config.librpfile.h"
+#include "ReadBatch.hpp"
+
+#include "RpFile.hpp"
+#include "RpFile_p.hpp"
+
+#ifdef HAVE_IO_URING
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+// C includes (C++ namespace)
+#  include <cstdio>
+#endif /* HAVE_IO_URING */
+
+// C++ STL classes
+using std::vector;
+
+namespace LibRpFile {
+
+/** ReadBatchPrivate **/
+
+class ReadBatchPrivate
+{
+	public:
+		explicit ReadBatchPrivate(unsigned int queueDepth);
+		~ReadBatchPrivate();
+
+	private:
+		RP_DISABLE_COPY(ReadBatchPrivate)
+
+	public:
+		struct Request {
+			IRpFilePtr file;
+			off64_t pos;
+			uint8_t *ptr;
+			size_t size;
+			size_t ret;	// Bytes read
+			int fd;		// File descriptor for direct reads (-1 if not usable)
+			bool done;	// Set if the request has been handled
+		};
+		vector<Request> reqs;
+		unsigned int queueDepth;
+		bool usedIoUring;
+
+		/**
+		 * Get the file descriptor for direct positional reads.
+		 * @param file IRpFile
+		 * @return File descriptor, or -1 if not usable.
+		 */
+		static int getReadFd(IRpFile *file);
+
+#ifdef HAVE_IO_URING
+	public:
+		/** io_uring **/
+		int ring_fd;
+
+		// Submission queue
+		uint8_t *sq_ring;
+		size_t sq_ring_sz;
+		uint32_t *sq_head;
+		uint32_t *sq_tail;
+		uint32_t sq_mask;
+		uint32_t *sq_array;
+		struct io_uring_sqe *sqes;
+		size_t sqes_sz;
+
+		// Completion queue
+		uint8_t *cq_ring;
+		size_t cq_ring_sz;
+		uint32_t *cq_head;
+		uint32_t *cq_tail;
+		uint32_t cq_mask;
+		struct io_uring_cqe *cqes;
+
+		unsigned int ring_entries;
+
+		/**
+		 * Is a seccomp filter active for this process?
+		 *
+		 * The io_uring syscalls aren't whitelisted by any of the
+		 * rom-properties sandboxes, and a seccomp filter may kill
+		 * the process instead of returning an error, so io_uring
+		 * isn't used if a filter is active.
+		 *
+		 * NOTE: This reads /proc/self/status instead of calling
+		 * prctl(PR_GET_SECCOMP), since prctl() may not be allowed.
+		 *
+		 * @return True if a seccomp filter is active (or if it can't be determined).
+		 */
+		static bool isSeccompActive(void);
+
+		/**
+		 * Initialize the io_uring.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int initRing(void);
+
+		/**
+		 * Wait for all in-flight requests to complete.
+		 * @param inflight [in/out] Number of requests in flight
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int drainRing(unsigned int &inflight);
+
+		/**
+		 * Reap available completions.
+		 * @param inflight [in/out] Number of requests in flight
+		 */
+		void reapRing(unsigned int &inflight);
+
+		/**
+		 * Close the io_uring.
+		 */
+		void closeRing(void);
+
+		/**
+		 * Submit all requests with a usable file descriptor to the io_uring.
+		 * Requests that complete are marked as done.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int submitRing(void);
+#endif /* HAVE_IO_URING */
+};
+
+ReadBatchPrivate::ReadBatchPrivate(unsigned int queueDepth)
+	: queueDepth(queueDepth > 0 ? queueDepth : ReadBatch::DEFAULT_QUEUE_DEPTH)
+	, usedIoUring(false)
+#ifdef HAVE_IO_URING
+	, ring_fd(-1)
+	, sq_ring(nullptr)
+	, sq_ring_sz(0)
+	, sq_head(nullptr)
+	, sq_tail(nullptr)
+	, sq_mask(0)
+	, sq_array(nullptr)
+	, sqes(nullptr)
+	, sqes_sz(0)
+	, cq_ring(nullptr)
+	, cq_ring_sz(0)
+	, cq_head(nullptr)
+	, cq_tail(nullptr)
+	, cq_mask(0)
+	, cqes(nullptr)
+	, ring_entries(0)
+#endif /* HAVE_IO_URING */
+{ }
+
+ReadBatchPrivate::~ReadBatchPrivate()
+{
+#ifdef HAVE_IO_URING
+	closeRing();
+#endif /* HAVE_IO_URING */
+}
+
+/**
+ * Get the file descriptor for direct positional reads.
+ * @param file IRpFile
+ * @return File descriptor, or -1 if not usable.
+ */
+int ReadBatchPrivate::getReadFd(IRpFile *file)
+{
+#ifndef _WIN32
+	RpFile *const rpFile = dynamic_cast<RpFile*>(file);
+	if (rpFile) {
+		return rpFile->d_ptr->preadFd();
+	}
+#else /* _WIN32 */
+	RP_UNUSED(file);
+#endif /* !_WIN32 */
+	return -1;
+}
+
+#ifdef HAVE_IO_URING
+/**
+ * Is a seccomp filter active for this process?
+ *
+ * The io_uring syscalls aren't whitelisted by any of the
+ * rom-properties sandboxes, and a seccomp filter may kill
+ * the process instead of returning an error, so io_uring
+ * isn't used if a filter is active.
+ *
+ * NOTE: This reads /proc/self/status instead of calling
+ * prctl(PR_GET_SECCOMP), since prctl() may not be allowed.
+ *
+ * @return True if a seccomp filter is active (or if it can't be determined).
+ */
+bool ReadBatchPrivate::isSeccompActive(void)
+{
+	FILE *f = fopen("/proc/self/status", "r");
+	if (!f) {
+		// Can't tell. Assume it's active.
+		return true;
+	}
+
+	bool active = true;
+	char line[128];
+	while (fgets(line, sizeof(line), f)) {
+		if (!strncmp(line, "Seccomp:", 8)) {
+			// 0 == disabled; 1 == strict; 2 == filter
+			active = (atoi(&line[8]) != 0);
+			break;
+		}
+	}
+	fclose(f);
+	return active;
+}
+
+/**
+ * Initialize the io_uring.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ReadBatchPrivate::initRing(void)
+{
+	if (ring_fd >= 0) {
+		// Already initialized.
+		return 0;
+	} else if (isSeccompActive()) {
+		// Sandboxed. Don't use io_uring.
+		return -EPERM;
+	}
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	const int fd = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &params));
+	if (fd < 0) {
+		// io_uring is not available.
+		// (ENOSYS on older kernels; EPERM if disabled by sysctl.)
+		return -errno;
+	}
+	ring_fd = fd;
+	ring_entries = params.sq_entries;
+
+	// Map the submission and completion queue rings.
+	sq_ring_sz = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	cq_ring_sz = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		// Both rings share a single mapping.
+		sq_ring_sz = std::max(sq_ring_sz, cq_ring_sz);
+		cq_ring_sz = sq_ring_sz;
+	}
+
+	void *ptr = mmap(nullptr, sq_ring_sz, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED) {
+		const int err = errno;
+		sq_ring = nullptr;
+		closeRing();
+		return -err;
+	}
+	sq_ring = static_cast<uint8_t*>(ptr);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		cq_ring = sq_ring;
+	} else {
+		ptr = mmap(nullptr, cq_ring_sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+		if (ptr == MAP_FAILED) {
+			const int err = errno;
+			cq_ring = nullptr;
+			closeRing();
+			return -err;
+		}
+		cq_ring = static_cast<uint8_t*>(ptr);
+	}
+
+	// Map the submission queue entries.
+	sqes_sz = params.sq_entries * sizeof(struct io_uring_sqe);
+	ptr = mmap(nullptr, sqes_sz, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+	if (ptr == MAP_FAILED) {
+		const int err = errno;
+		sqes = nullptr;
+		closeRing();
+		return -err;
+	}
+	sqes = static_cast<struct io_uring_sqe*>(ptr);
+
+	sq_head = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.head);
+	sq_tail = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.tail);
+	sq_mask = *reinterpret_cast<const uint32_t*>(sq_ring + params.sq_off.ring_mask);
+	sq_array = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.array);
+
+	cq_head = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.head);
+	cq_tail = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.tail);
+	cq_mask = *reinterpret_cast<const uint32_t*>(cq_ring + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<struct io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+	return 0;
+}
+
+/**
+ * Close the io_uring.
+ */
+void ReadBatchPrivate::closeRing(void)
+{
+	if (sqes) {
+		munmap(sqes, sqes_sz);
+		sqes = nullptr;
+	}
+	if (cq_ring && cq_ring != sq_ring) {
+		munmap(cq_ring, cq_ring_sz);
+	}
+	cq_ring = nullptr;
+	if (sq_ring) {
+		munmap(sq_ring, sq_ring_sz);
+		sq_ring = nullptr;
+	}
+	if (ring_fd >= 0) {
+		::close(ring_fd);
+		ring_fd = -1;
+	}
+}
+
+/**
+ * Reap available completions.
+ * @param inflight [in/out] Number of requests in flight
+ */
+void ReadBatchPrivate::reapRing(unsigned int &inflight)
+{
+	uint32_t head = *cq_head;
+	const uint32_t cq_tail_val = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != cq_tail_val; head++) {
+		const struct io_uring_cqe *const cqe = &cqes[head & cq_mask];
+		Request &req = reqs[static_cast<size_t>(cqe->user_data)];
+		if (cqe->res >= 0) {
+			req.ret = static_cast<size_t>(cqe->res);
+			// Short reads (other than EOF) are finished
+			// by the fallback path.
+			req.done = (req.ret == req.size || cqe->res == 0);
+			if (!req.done) {
+				req.fd = -1;
+			}
+		} else {
+			// Read error. (e.g. -EINVAL if IORING_OP_READ
+			// isn't supported by this kernel)
+			req.fd = -1;
+		}
+		inflight--;
+	}
+	__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * Wait for all in-flight requests to complete.
+ * @param inflight [in/out] Number of requests in flight
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ReadBatchPrivate::drainRing(unsigned int &inflight)
+{
+	while (inflight > 0) {
+		const int ret = static_cast<int>(syscall(__NR_io_uring_enter,
+			ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+		if (ret < 0 && errno != EINTR) {
+			return -errno;
+		}
+		reapRing(inflight);
+	}
+	return 0;
+}
+
+/**
+ * Submit all requests with a usable file descriptor to the io_uring.
+ * Requests that complete are marked as done.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ReadBatchPrivate::submitRing(void)
+{
+	const size_t count = reqs.size();
+	size_t next = 0;
+	unsigned int inflight = 0;	// Consumed by the kernel, but not completed yet
+
+	for (;;) {
+		// Entries that were queued but not consumed by the kernel yet.
+		// These are resubmitted on the next io_uring_enter().
+		uint32_t tail = *sq_tail;
+		unsigned int pending = tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+
+		// Queue as many requests as will fit.
+		for (; next < count && inflight + pending < ring_entries; next++) {
+			Request &req = reqs[next];
+			if (req.done || req.fd < 0)
+				continue;
+
+			// NOTE: IORING_OP_READ only takes a 32-bit length.
+			const uint32_t idx = tail & sq_mask;
+			struct io_uring_sqe *const sqe = &sqes[idx];
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_READ;
+			sqe->fd = req.fd;
+			sqe->off = static_cast<uint64_t>(req.pos);
+			sqe->addr = reinterpret_cast<uintptr_t>(req.ptr);
+			sqe->len = static_cast<uint32_t>(std::min<size_t>(req.size, 0x7FFFF000U));
+			sqe->user_data = next;
+			sq_array[idx] = idx;
+			tail++;
+			pending++;
+		}
+		__atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+		if (pending == 0 && inflight == 0) {
+			// Nothing left to do.
+			break;
+		}
+
+		// Submit and wait for at least one completion.
+		// NOTE: io_uring_enter() returns the number of entries consumed,
+		// which may be less than the number submitted. If nothing is in
+		// flight afterwards, don't wait, since that would hang.
+		int ret = static_cast<int>(syscall(__NR_io_uring_enter,
+			ring_fd, pending, (inflight > 0 ? 1 : 0),
+			(inflight > 0 ? IORING_ENTER_GETEVENTS : 0), nullptr, 0));
+		if (ret < 0) {
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+				// Interrupted, or the kernel is temporarily out of
+				// resources. Nothing was consumed, so reap any
+				// completions and try again.
+				if (errno != EINTR && inflight == 0) {
+					// Nothing will complete to free up resources.
+					ret = -errno;
+				} else {
+					reapRing(inflight);
+					continue;
+				}
+			} else {
+				ret = -errno;
+			}
+
+			// Unrecoverable error.
+			// Discard entries that weren't consumed, and wait for the
+			// in-flight requests to complete, since their buffers may
+			// be reused or freed once we return. Anything that didn't
+			// complete will be handled by the fallback path.
+			__atomic_store_n(sq_tail, __atomic_load_n(sq_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+			if (drainRing(inflight) != 0) {
+				// Can't wait for the requests. This shouldn't happen,
+				// since waiting only fails if the ring itself is invalid.
+				// Tear down the ring so it isn't reused.
+				closeRing();
+			}
+			return ret;
+		}
+		if (ret == 0 && inflight == 0) {
+			// Nothing was consumed, and nothing is in flight.
+			// Shouldn't happen, but don't spin forever.
+			__atomic_store_n(sq_tail, __atomic_load_n(sq_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+			return -EIO;
+		}
+		inflight += static_cast<unsigned int>(ret);
+
+		// Reap completions.
+		reapRing(inflight);
+	}
+
+	return 0;
+}
+#endif /* HAVE_IO_URING */
+
+/** ReadBatch **/
+
+/**
+ * Batch of positional reads.
+ *
+ * On Linux, if io_uring is available, reads from regular files
+ * are submitted to the kernel together, which keeps the queue
+ * depth up on SSDs and network storage. Otherwise, or for files
+ * that can't be read directly (compressed, devices, etc.),
+ * the reads are done one at a time using IRpFile::readAt().
+ *
+ * io_uring is not used if a seccomp filter is active, since
+ * the sandbox whitelists don't allow the io_uring syscalls.
+ *
+ * @param queueDepth Maximum number of reads in flight at once
+ */
+ReadBatch::ReadBatch(unsigned int queueDepth)
+	: d_ptr(new ReadBatchPrivate(queueDepth))
+{ }
+
+ReadBatch::~ReadBatch()
+{
+	delete d_ptr;
+}
+
+/**
+ * Add a read to the batch.
+ * The file and buffer must remain valid until submit() returns.
+ * @param file	[in] File
+ * @param pos	[in] Start position
+ * @param ptr	[out] Output data buffer
+ * @param size	[in] Amount of data to read, in bytes
+ * @return Request index
+ */
+size_t ReadBatch::add(const IRpFilePtr &file, off64_t pos, void *ptr, size_t size)
+{
+	RP_D(ReadBatch);
+	ReadBatchPrivate::Request req;
+	req.file = file;
+	req.pos = pos;
+	req.ptr = static_cast<uint8_t*>(ptr);
+	req.size = size;
+	req.ret = 0;
+	req.fd = -1;
+	req.done = false;
+	d->reqs.push_back(std::move(req));
+	return d->reqs.size() - 1;
+}
+
+/**
+ * Get the number of reads in the batch.
+ * @return Number of reads
+ */
+size_t ReadBatch::count(void) const
+{
+	RP_D(const ReadBatch);
+	return d->reqs.size();
+}
+
+/**
+ * Submit all reads in the batch and wait for them to complete.
+ * @return Number of reads that returned all requested data.
+ */
+size_t ReadBatch::submit(void)
+{
+	RP_D(ReadBatch);
+	d->usedIoUring = false;
+
+#ifdef HAVE_IO_URING
+	// Find requests that can be submitted to the io_uring.
+	bool haveFds = false;
+	for (auto &req : d->reqs) {
+		if (req.done || !req.file || req.pos < 0)
+			continue;
+		req.fd = ReadBatchPrivate::getReadFd(req.file.get());
+		if (req.fd >= 0) {
+			haveFds = true;
+		}
+	}
+
+	if (haveFds && d->initRing() == 0) {
+		d->usedIoUring = true;
+		d->submitRing();
+	}
+#endif /* HAVE_IO_URING */
+
+	// Fallback: Handle anything that wasn't completed above.
+	// This also finishes short reads from io_uring.
+	size_t complete = 0;
+	for (auto &req : d->reqs) {
+		if (!req.done) {
+			if (req.file && req.ret < req.size) {
+				req.ret += req.file->readAt(req.pos + req.ret,
+					req.ptr + req.ret, req.size - req.ret);
+			}
+			req.done = true;
+		}
+		if (req.file && req.ret == req.size) {
+			complete++;
+		}
+	}
+	return complete;
+}
+
+/**
+ * Get the result of a read after submit().
+ * @param idx Request index
+ * @return Number of bytes read
+ */
+size_t ReadBatch::result(size_t idx) const
+{
+	RP_D(const ReadBatch);
+	assert(idx < d->reqs.size());
+	if (idx >= d->reqs.size())
+		return 0;
+	return d->reqs[idx].ret;
+}
+
+/**
+ * Clear the batch.
+ */
+void ReadBatch::clear(void)
+{
+	RP_D(ReadBatch);
+	d->reqs.clear();
+}
+
+/**
+ * Was io_uring used for the last submit()?
+ * @return True if io_uring was used; false if not.
+ */
+bool ReadBatch::isUsingIoUring(void) const
+{
+	RP_D(const ReadBatch);
+	return d->usedIoUring;
+}
+
+}
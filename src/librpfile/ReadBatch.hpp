@@ -0,0 +1,91 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * ReadBatch.hpp: Batched positional reads across multiple files.          *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+#include "IRpFile.hpp"
+
+namespace LibRpFile {
+
+class ReadBatchPrivate;
+class RP_LIBROMDATA_PUBLIC ReadBatch
+{
+	public:
+		/**
+		 * Default queue depth.
+		 */
+		static constexpr unsigned int DEFAULT_QUEUE_DEPTH = 64;
+
+		/**
+		 * Batch of positional reads.
+		 *
+		 * On Linux, if io_uring is available, reads from regular files
+		 * are submitted to the kernel together, which keeps the queue
+		 * depth up on SSDs and network storage. Otherwise, or for files
+		 * that can't be read directly (compressed, devices, etc.),
+		 * the reads are done one at a time using IRpFile::readAt().
+		 *
+		 * io_uring is not used if a seccomp filter is active, since
+		 * the sandbox whitelists don't allow the io_uring syscalls.
+		 *
+		 * @param queueDepth Maximum number of reads in flight at once
+		 */
+		explicit ReadBatch(unsigned int queueDepth = DEFAULT_QUEUE_DEPTH);
+		~ReadBatch();
+
+	private:
+		RP_DISABLE_COPY(ReadBatch)
+	private:
+		friend class ReadBatchPrivate;
+		ReadBatchPrivate *const d_ptr;
+
+	public:
+		/**
+		 * Add a read to the batch.
+		 * The file and buffer must remain valid until submit() returns.
+		 * @param file	[in] File
+		 * @param pos	[in] Start position
+		 * @param ptr	[out] Output data buffer
+		 * @param size	[in] Amount of data to read, in bytes
+		 * @return Request index
+		 */
+		ATTR_ACCESS_SIZE(write_only, 4, 5)
+		size_t add(const IRpFilePtr &file, off64_t pos, void *ptr, size_t size);
+
+		/**
+		 * Get the number of reads in the batch.
+		 * @return Number of reads
+		 */
+		size_t count(void) const;
+
+		/**
+		 * Submit all reads in the batch and wait for them to complete.
+		 * @return Number of reads that returned all requested data.
+		 */
+		size_t submit(void);
+
+		/**
+		 * Get the result of a read after submit().
+		 * @param idx Request index
+		 * @return Number of bytes read
+		 */
+		size_t result(size_t idx) const;
+
+		/**
+		 * Clear the batch.
+		 */
+		void clear(void);
+
+		/**
+		 * Was io_uring used for the last submit()?
+		 * @return True if io_uring was used; false if not.
+		 */
+		bool isUsingIoUring(void) const;
+};
+
+}
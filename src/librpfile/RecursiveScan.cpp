@@ -0,0 +1,358 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * RecursiveScan.cpp: Recursively scan for cache files to delete.          *
+ * (Common functions)                                                      *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "stdafx.h"
+#include "RecursiveScan.hpp"
+#include "RecursiveScan_p.hpp"
+
+// d_type compatibility values
+#include "d_type.h"
+
+// C++ STL classes
+#include <system_error>
+#include <thread>
+#include <vector>
+using std::forward_list;
+using std::pair;
+using std::tstring;
+using std::vector;
+
+// RecursiveScan isn't used by libromdata directly,
+// so use some linker hax to force linkage.
+extern "C" {
+	extern unsigned char RP_LibRpFile_RecursiveScan_ForceLinkage;
+	unsigned char RP_LibRpFile_RecursiveScan_ForceLinkage;
+}
+
+namespace LibRpFile {
+
+namespace RecursiveScanPrivate {
+
+// Maximum number of worker threads.
+// Directory scanning is mostly limited by the filesystem,
+// so more threads than this doesn't help.
+//
+// NOTE: This uses a small std::thread pool instead of OpenMP.
+// The directory tree isn't known until it's scanned, so there's no
+// loop for "omp parallel for" to split up; subdirectories have to be
+// queued as they're found. OpenMP tasks would handle that, but MSVC
+// only supports OpenMP 2.0 (no tasks). OpenMP is also optional
+// (ENABLE_OPENMP), and librpfile doesn't link to it.
+static constexpr unsigned int MAX_THREADS = 8;
+
+ScanContext::ScanContext(unsigned int flags, RecursiveScanCallback callback, void *userdata)
+	: m_flags(flags)
+	, m_callback(callback)
+	, m_userdata(userdata)
+	, m_activeJobs(0)
+	, m_files(0)
+	, m_dirs(0)
+	, m_bytes(0)
+	, m_error(0)
+{}
+
+/**
+ * Scan a directory tree using a pool of worker threads.
+ * @param path Root directory
+ * @return 0 on success; negative POSIX error code on error; callback's return value if stopped.
+ */
+int ScanContext::run(const TCHAR *path)
+{
+	// Queue the root directory.
+	m_nodes.emplace_front(tstring(path), nullptr);
+	m_queue.push_back(&m_nodes.front());
+	m_activeJobs = 1;
+
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0) {
+		threadCount = 1;
+	} else if (threadCount > MAX_THREADS) {
+		threadCount = MAX_THREADS;
+	}
+
+	// The current thread is also used as a worker.
+	vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (unsigned int i = 1; i < threadCount; i++) {
+		try {
+			threads.emplace_back(&ScanContext::worker, this);
+		} catch (const std::system_error&) {
+			// Unable to create a thread.
+			// Continue with the threads we have.
+			break;
+		}
+	}
+
+	worker();
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	return m_error.load();
+}
+
+/**
+ * Worker thread function.
+ */
+void ScanContext::worker(void)
+{
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	while (true) {
+		m_queueCond.wait(lock, [this]() { return !m_queue.empty() || m_activeJobs == 0; });
+		if (m_queue.empty()) {
+			// No more directories.
+			break;
+		}
+
+		DirNode *const node = m_queue.front();
+		m_queue.pop_front();
+		lock.unlock();
+
+		// If the scan was stopped, the remaining directories
+		// are dequeued without being scanned.
+		if (!isStopped()) {
+			const int ret = scanDirectory(*this, node);
+			if (ret != 0) {
+				setError(ret);
+			}
+		}
+		finishDirectory(node);
+
+		lock.lock();
+		assert(m_activeJobs > 0);
+		if (--m_activeJobs == 0) {
+			// All directories have been scanned.
+			m_queueCond.notify_all();
+		}
+	}
+}
+
+/**
+ * Queue a subdirectory for scanning.
+ * @param parent Parent directory
+ * @param path Full path of the subdirectory
+ */
+void ScanContext::addDirectory(DirNode *parent, tstring &&path)
+{
+	parent->pending.fetch_add(1);
+
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_nodes.emplace_front(std::move(path), parent);
+		m_queue.push_back(&m_nodes.front());
+		m_activeJobs++;
+	}
+	m_queueCond.notify_one();
+}
+
+/**
+ * A directory listing has finished.
+ * Report any directories that are now complete.
+ * @param node Directory
+ */
+void ScanContext::finishDirectory(DirNode *node)
+{
+	// A directory is complete once its own listing and all of
+	// its subdirectories are finished. This may complete the
+	// parent directory, too.
+	while (node && node->pending.fetch_sub(1) == 1) {
+		DirNode *const parent = node->parent;
+		if (!parent) {
+			// Root directory. This isn't reported.
+			break;
+		}
+
+		m_dirs.fetch_add(1, std::memory_order_relaxed);
+		if (m_callback) {
+			std::lock_guard<std::mutex> lock(m_callbackMutex);
+			if (!isStopped()) {
+				RecursiveScanEntry entry;
+				entry.path = node->path.c_str();
+				entry.size = 0;
+				entry.atime = node->atime;
+				entry.d_type = DT_DIR;
+				const int ret = m_callback(&entry, m_userdata);
+				if (ret != 0) {
+					setError(ret);
+				}
+			}
+		}
+
+		node = parent;
+	}
+}
+
+/**
+ * Add a file to the totals and call the callback, if set.
+ * @param entry Entry (path is only valid if hasCallback() is true)
+ * @return 0 to continue; non-zero to stop.
+ */
+int ScanContext::addFile(const RecursiveScanEntry &entry)
+{
+	m_files.fetch_add(1, std::memory_order_relaxed);
+	m_bytes.fetch_add(static_cast<uint64_t>(entry.size), std::memory_order_relaxed);
+	if (!m_callback) {
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock(m_callbackMutex);
+	if (isStopped()) {
+		return m_error.load();
+	}
+	const int ret = m_callback(&entry, m_userdata);
+	if (ret != 0) {
+		setError(ret);
+	}
+	return ret;
+}
+
+/**
+ * Stop the scan due to an error.
+ * Only the first error is kept.
+ * @param err Error code
+ */
+void ScanContext::setError(int err)
+{
+	assert(err != 0);
+	int expected = 0;
+	m_error.compare_exchange_strong(expected, err);
+}
+
+/**
+ * Check if a file is an expected cache file, if RSF_CHECK_CACHE_FILES is set.
+ * @param filename Filename (without the path)
+ * @return True if the file is allowed; false if not.
+ */
+bool ScanContext::isAllowedFile(const TCHAR *filename) const
+{
+	if (!(m_flags & RSF_CHECK_CACHE_FILES)) {
+		// Not checking files.
+		return true;
+	}
+
+	// Thumbs.db files can be deleted.
+	if (!_tcsicmp(filename, _T("Thumbs.db"))) {
+		return true;
+	}
+
+	// Check the extension.
+	const size_t len = _tcslen(filename);
+	if (len <= 4) {
+		// Filename is too short. This is bad.
+		return false;
+	}
+
+	const TCHAR *const pExt = &filename[len-4];
+	return (!_tcsicmp(pExt, _T(".png")) ||
+		!_tcsicmp(pExt, _T(".jpg")) ||
+		!_tcsicmp(pExt, _T(".jxl")) ||
+		!_tcsicmp(filename, _T("version.txt")));
+}
+
+/**
+ * Get the totals.
+ * @param pTotals Totals
+ */
+void ScanContext::getTotals(RecursiveScanTotals *pTotals) const
+{
+	pTotals->files = m_files.load();
+	pTotals->dirs = m_dirs.load();
+	pTotals->bytes = m_bytes.load();
+}
+
+}
+
+using namespace RecursiveScanPrivate;
+
+/**
+ * Recursively scan a directory.
+ *
+ * Subdirectories are scanned in parallel. Entries are passed to
+ * the callback as they're found instead of being stored in a list.
+ * Each subdirectory is reported *after* all of its contents, so the
+ * callback can delete entries as they're found. The directory being
+ * scanned is not reported.
+ *
+ * If callback is nullptr, only the totals are calculated.
+ * This is faster, since full paths aren't needed for files.
+ *
+ * Symbolic links are reported as DT_LNK and are not followed, so
+ * symlinked directories aren't scanned and the callback can't delete
+ * anything outside of the directory being scanned. (The list-based
+ * recursiveScan() used to dereference symlinks and scan symlinked
+ * directories.) On Windows, directory junctions have the directory
+ * attribute set, so they're still scanned as subdirectories.
+ *
+ * If an error occurs in any subdirectory, e.g. it can't be opened or
+ * RSF_CHECK_CACHE_FILES finds an unexpected file, the entire scan is
+ * stopped and that error is returned. (The list-based recursiveScan()
+ * used to ignore errors in subdirectories.)
+ *
+ * @param path		[in] Path to scan
+ * @param flags		[in] RecursiveScanFlags
+ * @param callback	[in,opt] Callback function
+ * @param userdata	[in,opt] User data for the callback
+ * @param pTotals	[out,opt] Totals
+ * @return 0 on success; negative POSIX error code on error; callback's return value if stopped.
+ */
+int recursiveScan(const TCHAR *path, unsigned int flags,
+	RecursiveScanCallback callback, void *userdata,
+	RecursiveScanTotals *pTotals)
+{
+	assert(path != nullptr);
+	assert(path[0] != _T('\0'));
+	if (unlikely(!path || path[0] == _T('\0'))) {
+		return -EINVAL;
+	}
+
+	ScanContext ctx(flags, callback, userdata);
+	const int ret = ctx.run(path);
+	if (pTotals) {
+		ctx.getTotals(pTotals);
+	}
+	return ret;
+}
+
+/**
+ * Recursively scan a directory for cache files to delete.
+ * This finds *.png, *.jpg, *.jxl, and "version.txt".
+ *
+ * NOTE: This stores every entry in a list. For large caches,
+ * use the callback version of recursiveScan() instead.
+ *
+ * Symbolic links are listed as DT_LNK and are not followed.
+ * An error in any subdirectory fails the entire scan.
+ *
+ * @param path	[in] Path to scan.
+ * @param rlist	[in/out] Return list for filenames and file types. (d_type)
+ *			Entries are in deletion order, i.e. subdirectories
+ *			are listed after their contents.
+ * @return 0 on success; non-zero on error.
+ */
+int recursiveScan(const TCHAR *path, forward_list<pair<tstring, uint8_t> > &rlist)
+{
+	vector<pair<tstring, uint8_t> > entries;
+	const int ret = recursiveScan(path, RSF_CHECK_CACHE_FILES | RSF_NO_STAT,
+		[](const RecursiveScanEntry *entry, void *userdata) -> int {
+			auto *const pEntries = static_cast<vector<pair<tstring, uint8_t> >*>(userdata);
+			pEntries->emplace_back(entry->path, entry->d_type);
+			return 0;
+		}, &entries);
+	if (ret != 0) {
+		return ret;
+	}
+
+	// Entries are in deletion order, so add them to the list in reverse.
+	for (auto iter = entries.rbegin(); iter != entries.rend(); ++iter) {
+		rlist.emplace_front(std::move(*iter));
+	}
+	return 0;
+}
+
+}
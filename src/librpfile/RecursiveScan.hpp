@@ -1,6 +1,6 @@
 /***************************************************************************
  * ROM Properties Page shell extension. (librpfile)                        *
- * RecursiveScan.cpp: Recursively scan for cache files to delete.          *
+ * RecursiveScan.hpp: Recursively scan for cache files to delete.          *
  *                                                                         *
  * Copyright (c) 2016-2024 by David Korth.                                 *
  * SPDX-License-Identifier: GPL-2.0-or-later                               *
@@ -8,7 +8,14 @@
 
 #pragma once
 
+// C includes
+#include <sys/types.h>	// for off64_t
+
+// C includes (C++ namespace)
 #include <cstdint>
+#include <ctime>
+
+#include "common.h"
 #include "dll-macros.h"	// for RP_LIBROMDATA_PUBLIC
 
 #include "tcharx.h"
@@ -18,14 +25,114 @@
 #include <string>
 #include <utility>
 
-namespace LibRpFile { 
+namespace LibRpFile {
+
+/**
+ * Recursive scan entry.
+ */
+struct RecursiveScanEntry {
+	const TCHAR *path;	// Full path
+	off64_t size;		// File size (0 for directories)
+	time_t atime;		// Last access time (UNIX timestamp)
+	uint8_t d_type;		// File type (d_type)
+};
+
+/**
+ * Recursive scan totals.
+ */
+struct RecursiveScanTotals {
+	uint64_t files;		// Number of files (including symlinks)
+	uint64_t dirs;		// Number of subdirectories
+	uint64_t bytes;		// Total size of all files, in bytes
+};
+
+/**
+ * Recursive scan callback.
+ *
+ * Calls are serialized, so the callback doesn't have to be
+ * thread-safe, but it may be called from a worker thread.
+ *
+ * @param entry		[in] Entry
+ * @param userdata	[in] User data
+ * @return 0 to continue scanning; non-zero to stop. (returned by recursiveScan())
+ */
+typedef int (*RecursiveScanCallback)(const RecursiveScanEntry *entry, void *userdata);
+
+/**
+ * Recursive scan flags.
+ */
+enum RecursiveScanFlags {
+	// Fail with -EIO if anything other than cache files are found.
+	// Cache files are *.png, *.jpg, *.jxl, "version.txt", and "Thumbs.db".
+	RSF_CHECK_CACHE_FILES	= (1U << 0),
+
+	// Don't get file sizes and access times. (size and atime will be 0)
+	// On some systems, this avoids a stat() call for each file.
+	RSF_NO_STAT		= (1U << 1),
+};
+
+/**
+ * Recursively scan a directory.
+ *
+ * Subdirectories are scanned in parallel. Entries are passed to
+ * the callback as they're found instead of being stored in a list.
+ * Each subdirectory is reported *after* all of its contents, so the
+ * callback can delete entries as they're found. The directory being
+ * scanned is not reported.
+ *
+ * If callback is nullptr, only the totals are calculated.
+ * This is faster, since full paths aren't needed for files.
+ *
+ * Symbolic links are reported as DT_LNK and are not followed, so
+ * symlinked directories aren't scanned and the callback can't delete
+ * anything outside of the directory being scanned. (The list-based
+ * recursiveScan() used to dereference symlinks and scan symlinked
+ * directories.) On Windows, directory junctions have the directory
+ * attribute set, so they're still scanned as subdirectories.
+ *
+ * If an error occurs in any subdirectory, e.g. it can't be opened or
+ * RSF_CHECK_CACHE_FILES finds an unexpected file, the entire scan is
+ * stopped and that error is returned. (The list-based recursiveScan()
+ * used to ignore errors in subdirectories.)
+ *
+ * @param path		[in] Path to scan
+ * @param flags		[in] RecursiveScanFlags
+ * @param callback	[in,opt] Callback function
+ * @param userdata	[in,opt] User data for the callback
+ * @param pTotals	[out,opt] Totals
+ * @return 0 on success; negative POSIX error code on error; callback's return value if stopped.
+ */
+RP_LIBROMDATA_PUBLIC
+int recursiveScan(const TCHAR *path, unsigned int flags,
+	RecursiveScanCallback callback, void *userdata,
+	RecursiveScanTotals *pTotals = nullptr);
+
+/**
+ * Recursively calculate the totals for a directory.
+ * @param path		[in] Path to scan
+ * @param pTotals	[out] Totals
+ * @param flags		[in] RecursiveScanFlags
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static inline int recursiveScanTotals(const TCHAR *path, RecursiveScanTotals *pTotals, unsigned int flags = 0)
+{
+	return recursiveScan(path, flags, nullptr, nullptr, pTotals);
+}
 
 /**
  * Recursively scan a directory for cache files to delete.
- * This finds *.png, *.jpg, and "version.txt".
+ * This finds *.png, *.jpg, *.jxl, and "version.txt".
+ *
+ * NOTE: This stores every entry in a list. For large caches,
+ * use the callback version of recursiveScan() instead.
+ *
+ * Symbolic links are listed as DT_LNK and are not followed.
+ * An error in any subdirectory fails the entire scan.
  *
  * @param path	[in] Path to scan.
  * @param rlist	[in/out] Return list for filenames and file types. (d_type)
+ *			Entries are in deletion order, i.e. subdirectories
+ *			are listed after their contents.
  * @return 0 on success; non-zero on error.
  */
 RP_LIBROMDATA_PUBLIC
@@ -0,0 +1,173 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * RecursiveScan_p.hpp: Recursively scan for cache files to delete.        *
+ * (PRIVATE CLASS)                                                         *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+#include "RecursiveScan.hpp"
+
+// C++ includes
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <forward_list>
+#include <mutex>
+
+namespace LibRpFile { namespace RecursiveScanPrivate {
+
+/**
+ * Directory being scanned.
+ */
+struct DirNode {
+	std::tstring path;	// Full path
+	DirNode *parent;	// Parent directory (nullptr for the root directory)
+	time_t atime;		// Last access time (set by scanDirectory())
+
+	// Number of outstanding tasks for this directory:
+	// 1 for its own listing, plus 1 for each unfinished subdirectory.
+	std::atomic<unsigned int> pending;
+
+	DirNode(std::tstring &&path, DirNode *parent)
+		: path(std::move(path))
+		, parent(parent)
+		, atime(0)
+		, pending(1)
+	{ }
+};
+
+class ScanContext
+{
+	public:
+		ScanContext(unsigned int flags, RecursiveScanCallback callback, void *userdata);
+
+	private:
+		RP_DISABLE_COPY(ScanContext)
+
+	public:
+		/**
+		 * Scan a directory tree using a pool of worker threads.
+		 * @param path Root directory
+		 * @return 0 on success; negative POSIX error code on error; callback's return value if stopped.
+		 */
+		int run(const TCHAR *path);
+
+		/**
+		 * Queue a subdirectory for scanning.
+		 * @param parent Parent directory
+		 * @param path Full path of the subdirectory
+		 */
+		void addDirectory(DirNode *parent, std::tstring &&path);
+
+		/**
+		 * Add a file to the totals and call the callback, if set.
+		 * @param entry Entry (path is only valid if hasCallback() is true)
+		 * @return 0 to continue; non-zero to stop.
+		 */
+		int addFile(const RecursiveScanEntry &entry);
+
+		/**
+		 * Stop the scan due to an error.
+		 * Only the first error is kept.
+		 * @param err Error code
+		 */
+		void setError(int err);
+
+		/**
+		 * Has the scan been stopped?
+		 * @return True if stopped.
+		 */
+		inline bool isStopped(void) const
+		{
+			return (m_error.load(std::memory_order_relaxed) != 0);
+		}
+
+		/**
+		 * Is a callback function set?
+		 * If not, full paths don't need to be built for files.
+		 * @return True if a callback is set.
+		 */
+		inline bool hasCallback(void) const
+		{
+			return (m_callback != nullptr);
+		}
+
+		/**
+		 * Are file sizes and access times needed?
+		 * @return True if needed; false if RSF_NO_STAT is set.
+		 */
+		inline bool needStat(void) const
+		{
+			return !(m_flags & RSF_NO_STAT);
+		}
+
+		/**
+		 * Check if a file is an expected cache file, if RSF_CHECK_CACHE_FILES is set.
+		 * @param filename Filename (without the path)
+		 * @return True if the file is allowed; false if not.
+		 */
+		bool isAllowedFile(const TCHAR *filename) const;
+
+		/**
+		 * Get the totals.
+		 * @param pTotals Totals
+		 */
+		void getTotals(RecursiveScanTotals *pTotals) const;
+
+	private:
+		/**
+		 * Worker thread function.
+		 */
+		void worker(void);
+
+		/**
+		 * A directory listing has finished.
+		 * Report any directories that are now complete.
+		 * @param node Directory
+		 */
+		void finishDirectory(DirNode *node);
+
+	private:
+		const unsigned int m_flags;
+		const RecursiveScanCallback m_callback;
+		void *const m_userdata;
+
+		// Work queue
+		std::mutex m_queueMutex;
+		std::condition_variable m_queueCond;
+		std::deque<DirNode*> m_queue;
+		unsigned int m_activeJobs;	// Queued or running directories
+
+		// All directory nodes (owned here so they're
+		// freed properly if the scan is stopped)
+		std::forward_list<DirNode> m_nodes;
+
+		// Callback serialization
+		std::mutex m_callbackMutex;
+
+		// Totals
+		std::atomic<uint64_t> m_files;
+		std::atomic<uint64_t> m_dirs;
+		std::atomic<uint64_t> m_bytes;
+
+		// First error
+		std::atomic<int> m_error;
+};
+
+/**
+ * Scan a single directory. (OS-specific)
+ *
+ * Files are passed to ctx.addFile(); subdirectories
+ * are passed to ctx.addDirectory().
+ *
+ * @param ctx	[in] Scan context
+ * @param node	[in/out] Directory (atime is set here)
+ * @return 0 on success; non-zero on error.
+ */
+int scanDirectory(ScanContext &ctx, DirNode *node);
+
+} }
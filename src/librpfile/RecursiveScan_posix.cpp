@@ -8,51 +8,79 @@
  ***************************************************************************/
 
 #include "stdafx.h"
-#include "RecursiveScan.hpp"
-#include "FileSystem.hpp"
+#include "RecursiveScan_p.hpp"
 
 // d_type compatibility values
 #include "d_type.h"
 
 // C includes
-#include <sys/types.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifndef O_CLOEXEC
+#  define O_CLOEXEC 0
+#endif /* O_CLOEXEC */
 
 // C++ STL classes
-using std::forward_list;
-using std::pair;
 using std::tstring;
 
-// RecursiveScan isn't used by libromdata directly,
-// so use some linker hax to force linkage.
-extern "C" {
-	extern unsigned char RP_LibRpFile_RecursiveScan_ForceLinkage;
-	unsigned char RP_LibRpFile_RecursiveScan_ForceLinkage;
-}
-
-namespace LibRpFile {
+namespace LibRpFile { namespace RecursiveScanPrivate {
 
 /**
- * Recursively scan a directory for cache files to delete.
- * This finds *.png, *.jpg, *.jxl, and "version.txt".
+ * Scan a single directory. (OS-specific)
  *
- * POSIX implementation: Uses readdir().
+ * Files are passed to ctx.addFile(); subdirectories
+ * are passed to ctx.addDirectory().
  *
- * @param path	[in] Path to scan.
- * @param rlist	[in/out] Return list for filenames and file types. (d_type)
+ * POSIX implementation: Uses readdir() and fstatat().
+ * Files are stat()'d relative to the directory's file descriptor,
+ * so full paths are only built if the callback needs them.
+ * If RSF_NO_STAT is set, files are only stat()'d if readdir()
+ * doesn't return the file type.
+ *
+ * @param ctx	[in] Scan context
+ * @param node	[in/out] Directory (atime is set here)
  * @return 0 on success; non-zero on error.
  */
-int recursiveScan(const TCHAR *path, forward_list<pair<tstring, uint8_t> > &rlist)
+int scanDirectory(ScanContext &ctx, DirNode *node)
 {
-	DIR *const pdir = opendir(path);
-	if (!pdir) {
+	const int fd = open(node->path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
 		// Error opening the directory.
 		return -errno;
 	}
 
+	struct stat sb;
+	if (ctx.needStat() && fstat(fd, &sb) == 0) {
+		node->atime = sb.st_atime;
+	}
+
+	DIR *const pdir = fdopendir(fd);
+	if (!pdir) {
+		// Error opening the directory.
+		const int err = -errno;
+		close(fd);
+		return err;
+	}
+
+	// Full path buffer: "path/filename"
+	// Only used if a callback is set, or for subdirectories.
+	tstring fullpath(node->path);
+	fullpath += '/';
+	const size_t pathlen = fullpath.size();
+
 	// Search for files and directories.
+	int ret = 0;
 	struct dirent *dirent;
 	while ((dirent = readdir(pdir)) != nullptr) {
+		if (ctx.isStopped()) {
+			// Scan was stopped by another thread.
+			break;
+		}
+
 		// Skip "." and "..".
 		if (dirent->d_name[0] == '.' &&
 		    (dirent->d_name[1] == '\0' ||
@@ -61,129 +89,74 @@ int recursiveScan(const TCHAR *path, forward_list<pair<tstring, uint8_t> > &rlis
 			continue;
 		}
 
-		string fullpath(path);
-		fullpath += '/';
-		fullpath += dirent->d_name;
-
-		// Check if this is a regular file.
-		uint8_t d_type = dirent->d_type;
-		switch (d_type) {
-			default:
-				// Not supported.
-				// TODO: Better error message.
-				closedir(pdir);
-				return -EIO;
-
-			case DT_REG:
-			case DT_DIR:
-				// Supported.
-				break;
-
-			case DT_LNK:
-				// Symbolic link. Dereference it and check again.
-				d_type = FileSystem::get_file_d_type(fullpath.c_str(), true);
-				switch (d_type) {
-					default:
-						// Not supported.
-						// TODO: Better error message.
-						closedir(pdir);
-						return -EIO;
-
-					case DT_REG:
-					case DT_DIR:
-						// Supported.
-						break;
-
-					case DT_UNKNOWN:
-						// This is probably a dangling symlink.
-						// Delete it anyway.
-						break;
-				}
-				break;
-
-			case DT_UNKNOWN:
-				// Unknown. Use stat().
-				d_type = FileSystem::get_file_d_type(fullpath.c_str(), false);
-				switch (d_type) {
-					default:
-						// Not supported.
-						// TODO: Better error message.
-						closedir(pdir);
-						return -EIO;
-
-					case DT_REG:
-					case DT_DIR:
-						// Supported.
-						break;
-
-					case DT_LNK:
-						// Symbolic link. Dereference it and check again.
-						d_type = FileSystem::get_file_d_type(fullpath.c_str(), true);
-						switch (d_type) {
-							default:
-								// Not supported.
-								// TODO: Better error message.
-								closedir(pdir);
-								return -EIO;
-
-							case DT_REG:
-							case DT_DIR:
-								// Supported.
-								break;
-
-							case DT_UNKNOWN:
-								// This is probably a dangling symlink.
-								// Delete it anyway.
-								break;
-						}
-						break;
-				}
-				break;
+		if (dirent->d_type == DT_DIR) {
+			// Subdirectory. This will be scanned separately.
+			fullpath.resize(pathlen);
+			fullpath += dirent->d_name;
+			ctx.addDirectory(node, std::move(fullpath));
+			fullpath = node->path;
+			fullpath += '/';
+			continue;
 		}
 
-		// Check the filename to see if we should delete it.
-		if (d_type == DT_REG || d_type == DT_UNKNOWN) {
-			// Thumbs.db files can be deleted.
-			if (!strcasecmp(dirent->d_name, "Thumbs.db"))
-				goto isok;
-
-			// Check the extension.
-			const size_t len = strlen(dirent->d_name);
-			if (len <= 4) {
-				// Filename is too short. This is bad.
-				closedir(pdir);
-				return -EIO;
+		RecursiveScanEntry entry;
+		entry.size = 0;
+		entry.atime = 0;
+		if (!ctx.needStat() && (dirent->d_type == DT_REG || dirent->d_type == DT_LNK)) {
+			// File type is known, and the size isn't needed.
+			entry.d_type = dirent->d_type;
+		} else {
+			// Get the file size and type.
+			// NOTE: Symbolic links are not dereferenced.
+			if (fstatat(fd, dirent->d_name, &sb, AT_SYMLINK_NOFOLLOW) != 0) {
+				ret = -errno;
+				break;
 			}
 
-			const char *pExt = &dirent->d_name[len-4];
-			if (strcasecmp(pExt, ".png") != 0 &&
-			    strcasecmp(pExt, ".jpg") != 0 &&
-			    strcasecmp(pExt, ".jxl") != 0 &&
-			    strcasecmp(dirent->d_name, "version.txt") != 0)
-			{
-				// Extension is not valid.
-				closedir(pdir);
-				return -EIO;
+			if (S_ISREG(sb.st_mode)) {
+				entry.d_type = DT_REG;
+			} else if (S_ISDIR(sb.st_mode)) {
+				// Subdirectory. (d_type was DT_UNKNOWN)
+				fullpath.resize(pathlen);
+				fullpath += dirent->d_name;
+				ctx.addDirectory(node, std::move(fullpath));
+				fullpath = node->path;
+				fullpath += '/';
+				continue;
+			} else if (S_ISLNK(sb.st_mode)) {
+				entry.d_type = DT_LNK;
+			} else {
+				// Not supported.
+				// TODO: Better error message.
+				ret = -EIO;
+				break;
 			}
-
-			// All checks pass.
+			entry.size = sb.st_size;
+			entry.atime = sb.st_atime;
 		}
 
-	isok:
-		// Add the filename and file type.
-		rlist.emplace_front(fullpath, d_type);
+		// Check the filename.
+		if (!ctx.isAllowedFile(dirent->d_name)) {
+			// Not a cache file.
+			ret = -EIO;
+			break;
+		}
 
-		// If this is a directory, recursively scan it.
-		// This is done *after* adding the directory because forward_list
-		// enumerates items in reverse order.
-		if (d_type == DT_DIR) {
-			// Recursively scan the directory.
-			recursiveScan(fullpath.c_str(), rlist);
+		if (ctx.hasCallback()) {
+			fullpath.resize(pathlen);
+			fullpath += dirent->d_name;
+			entry.path = fullpath.c_str();
+		} else {
+			entry.path = nullptr;
+		}
+		ret = ctx.addFile(entry);
+		if (ret != 0) {
+			break;
 		}
-	};
+	}
 	closedir(pdir);
 
-	return 0;
+	return ret;
 }
 
-}
+} }
@@ -20,6 +20,10 @@ struct _ATA_RESP_IDENTIFY_DEVICE;
 
 namespace LibRpFile {
 
+namespace Tests {
+	class RpFileDeviceTest;
+}
+
 class RpFilePrivate;
 class RpFile final : public IRpFile
 {
@@ -42,6 +46,13 @@ class RpFile final : public IRpFile
 			// Extras.
 			FM_GZIP_DECOMPRESS = 4,	// Transparent gzip decompression. (read-only!)
 			FM_OPEN_READ_GZ = FM_READ | FM_GZIP_DECOMPRESS,
+			// Memory-map regular files for zero-copy access. (read-only!)
+			// NOTE: If the file is truncated while it's mapped, accessing
+			// the missing pages raises SIGBUS on POSIX systems. Only use this
+			// for files that won't be modified by other processes.
+			FM_MMAP = 8,
+			FM_OPEN_READ_GZ_MMAP = FM_READ | FM_GZIP_DECOMPRESS | FM_MMAP,
+			FM_GZIP_INDEX_CACHE = 16,	// Save the gzip random-access index in the cache directory.
 		};
 
 		/**
@@ -77,6 +88,8 @@ class RpFile final : public IRpFile
 		RP_DISABLE_COPY(RpFile)
 	protected:
 		friend class RpFilePrivate;
+		friend class ReadBatchPrivate;
+		friend class Tests::RpFileDeviceTest;	// Sector cache tests
 		RpFilePrivate *const d_ptr;
 
 	public:
@@ -166,6 +179,84 @@ class RpFile final : public IRpFile
 		const wchar_t *filenameW(void) const;
 #endif /* _WIN32 */
 
+	public:
+		/** Zero-copy access **/
+
+		/**
+		 * Does peek() return a pointer into the file data itself?
+		 * This is only true if the file was memory-mapped. (FM_MMAP)
+		 * @return True if peek() is zero-copy; false if not.
+		 */
+		RP_LIBROMDATA_PUBLIC
+		bool isPeekZeroCopy(void) const final;
+
+		/**
+		 * Get a read-only pointer to the data at the specified position.
+		 *
+		 * If the file is memory-mapped, the pointer refers to the mapping,
+		 * and the file position is not changed. Otherwise, this falls back
+		 * to IRpFile's emulated peek().
+		 *
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Amount of data to access, in bytes.
+		 * @return Pointer to the data, or nullptr if the full range isn't available.
+		 */
+		RP_LIBROMDATA_PUBLIC
+		const uint8_t *peek(off64_t pos, size_t size) final;
+
+	public:
+		/** Positional I/O **/
+
+		/**
+		 * Read data from the file at the specified position.
+		 * The file position is not changed.
+		 *
+		 * Memory-mapped files are read directly from the mapping.
+		 * Regular read-only files use pread() on POSIX systems.
+		 * Other files (compressed, writable, devices) fall back
+		 * to IRpFile's emulated readAt().
+		 *
+		 * @param pos	[in] Start position.
+		 * @param ptr	[out] Output data buffer.
+		 * @param size	[in] Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		RP_LIBROMDATA_PUBLIC
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		size_t readAt(off64_t pos, void *ptr, size_t size) final;
+
+		/**
+		 * Read a contiguous range of the file into multiple buffers.
+		 * The file position is not changed.
+		 *
+		 * Regular read-only files use preadv() if available.
+		 *
+		 * @param pos	[in] Start position.
+		 * @param iov	[in] Array of buffer descriptors.
+		 * @param iovcnt	[in] Number of buffer descriptors.
+		 * @return Total number of bytes read.
+		 */
+		RP_LIBROMDATA_PUBLIC
+		size_t readAtV(off64_t pos, const IoVec *iov, unsigned int iovcnt) final;
+
+	public:
+		/** Access pattern hints **/
+
+		/**
+		 * Tell the OS how a range of the file will be accessed.
+		 *
+		 * On POSIX systems, this uses posix_fadvise(). If the file
+		 * is memory-mapped, posix_madvise() is used for the mapping.
+		 * Not supported for compressed files or devices.
+		 *
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+		 * @param hint	[in] Access hint.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		RP_LIBROMDATA_PUBLIC
+		int advise(off64_t pos, off64_t size, AccessHint hint) final;
+
 	public:
 		/** Extra functions **/
 
@@ -195,6 +286,41 @@ class RpFile final : public IRpFile
 		 */
 		int rereadDeviceSizeScsi(off64_t *pDeviceSize = nullptr, uint32_t *pSectorSize = nullptr);
 
+		/**
+		 * Set the device read-ahead size.
+		 *
+		 * Reads that aren't large enough to be transferred directly
+		 * are rounded up to this size and cached, so subsequent small
+		 * reads from the same area don't need another device command.
+		 *
+		 * The size is rounded down to a multiple of the sector size,
+		 * with a minimum of one sector and a maximum of 1 MB.
+		 * Default is 64 KB.
+		 *
+		 * @param size Read-ahead size, in bytes.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		RP_LIBROMDATA_PUBLIC
+		int setDeviceReadAhead(uint32_t size);
+
+		/**
+		 * Device read statistics.
+		 */
+		struct DeviceStats {
+			uint64_t commands;	// Number of read commands sent to the device
+			uint64_t bytes;		// Number of bytes transferred from the device
+			uint64_t hits;		// Number of reads serviced from the sector cache
+			uint64_t misses;	// Number of reads that loaded the sector cache
+		};
+
+		/**
+		 * Get the device read statistics.
+		 * @param pStats	[out] Device read statistics.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		RP_LIBROMDATA_PUBLIC
+		int getDeviceStats(DeviceStats *pStats) const;
+
 	public:
 		/** Public SCSI command wrapper functions **/
 
@@ -17,17 +17,8 @@
 // C++ includes
 #include <memory>
 
-// zlib for transparent gzip decompression.
-#include <zlib.h>
-// gzclose_r() and gzclose_w() were introduced in zlib-1.2.4.
-#if (ZLIB_VER_MAJOR > 1) || \
-    (ZLIB_VER_MAJOR == 1 && ZLIB_VER_MINOR > 2) || \
-    (ZLIB_VER_MAJOR == 1 && ZLIB_VER_MINOR == 2 && ZLIB_VER_REVISION >= 4)
-// zlib-1.2.4 or later
-#else
-#  define gzclose_r(file) gzclose(file)
-#  define gzclose_w(file) gzclose(file)
-#endif
+// Transparent gzip decompression.
+#include "GzIndex.hpp"
 
 #ifdef _WIN32
 // Windows SDK
@@ -84,9 +75,19 @@ class RpFilePrivate
 #endif /* _WIN32 */
 		RpFile::FileMode mode;	// File mode
 
-		gzFile gzfd;		// Used for transparent gzip decompression.
+		GzIndex *gzIndex;	// Used for transparent gzip decompression.
 		off64_t gzsz;		// Uncompressed file size.
 
+		// Memory-mapped file. (FM_MMAP)
+		// If set, read(), seek(), tell(), and size() use the
+		// mapping instead of the file handle.
+		const uint8_t *mmap_buf;	// Mapped file data
+		size_t mmap_sz;			// Size of the mapping
+		off64_t mmap_pos;		// Current position (may be past the end of the mapping)
+#ifdef _WIN32
+		HANDLE hMapping;		// File mapping object
+#endif /* _WIN32 */
+
 		// Device information struct.
 		// Only used if the underlying file
 		// is a device node.
@@ -97,20 +98,39 @@ class RpFilePrivate
 			bool isKreonUnlocked;	// Is Kreon mode unlocked?
 
 			// Sector cache
+			// Small reads are rounded up to readahead_size bytes,
+			// and then serviced from the cache.
 			std::unique_ptr<uint8_t[]> sector_cache;	// Sector cache
-			uint32_t lba_cache;				// Last LBA cached
+			uint32_t lba_cache;		// First LBA cached
+			uint32_t lba_cache_count;	// Number of LBAs cached
+			uint32_t readahead_size;	// Read-ahead size, in bytes (also the cache size)
+			uint32_t sector_cache_size;	// Allocated sector cache size, in bytes
+
+			// Statistics
+			RpFile::DeviceStats stats;
 
 			// OS-specific variables.
 #ifdef USING_FREEBSD_CAMLIB
 			struct cam_device *cam;
 #endif /* USING_FREEBSD_CAMLIB */
 
+			// Default read-ahead size: 64 KB
+			// This is the largest transfer that works reliably
+			// with READ(10) on Kreon drives.
+			static constexpr uint32_t READAHEAD_SIZE_DEFAULT = 64U * 1024U;
+			// Maximum read-ahead size: 1 MB
+			static constexpr uint32_t READAHEAD_SIZE_MAX = 1024U * 1024U;
+
 			DeviceInfo()
 				: device_pos(0)
 				, device_size(0)
 				, sector_size(0)
 				, isKreonUnlocked(false)
 				, lba_cache(~0U)
+				, lba_cache_count(0)
+				, readahead_size(READAHEAD_SIZE_DEFAULT)
+				, sector_cache_size(0)
+				, stats()
 #ifdef USING_FREEBSD_CAMLIB
 				, cam(nullptr)
 #endif /* USING_FREEBSD_CAMLIB */
@@ -125,20 +145,54 @@ class RpFilePrivate
 #endif /* USING_FREEBSD_CAMLIB */
 			}
 
+			/**
+			 * Get the number of LBAs to read ahead.
+			 * @return Number of LBAs to read ahead. (at least 1)
+			 */
+			uint32_t readahead_lbas(void) const
+			{
+				const uint32_t lbas = readahead_size / sector_size;
+				return (lbas > 0 ? lbas : 1);
+			}
+
 			void alloc_sector_cache(void)
 			{
 				assert(sector_size >= 512);
 				assert(sector_size <= 65536);
-				if (!sector_cache) {
-					if (sector_size >= 512 && sector_size <= 65536) {
-						sector_cache.reset(new uint8_t[sector_size]);
-					}
+				if (sector_size < 512 || sector_size > 65536) {
+					return;
+				}
+
+				const uint32_t cache_size = readahead_lbas() * sector_size;
+				if (!sector_cache || sector_cache_size != cache_size) {
+					sector_cache.reset(new uint8_t[cache_size]);
+					sector_cache_size = cache_size;
+					invalidate_sector_cache();
 				}
 			}
 
+			void invalidate_sector_cache(void)
+			{
+				lba_cache = ~0U;
+				lba_cache_count = 0;
+			}
+
+			/**
+			 * Is the specified LBA in the sector cache?
+			 * @param lba LBA
+			 * @return True if cached; false if not.
+			 */
+			bool is_lba_cached(uint32_t lba) const
+			{
+				// NOTE: Unsigned subtraction handles lba < lba_cache.
+				return (lba - lba_cache < lba_cache_count);
+			}
+
 			void close(void)
 			{
 				sector_cache.reset();
+				sector_cache_size = 0;
+				invalidate_sector_cache();
 
 #ifdef USING_FREEBSD_CAMLIB
 				if (cam) {
@@ -180,7 +234,7 @@ class RpFilePrivate
 		/**
 		 * (Re-)Open the main file.
 		 *
-		 * INTERNAL FUNCTION. This does NOT affect gzfd.
+		 * INTERNAL FUNCTION. This does NOT affect gzIndex.
 		 * NOTE: This function sets q->m_lastError.
 		 *
 		 * Uses parameters stored in this->filename and this->mode.
@@ -188,13 +242,70 @@ class RpFilePrivate
 		 */
 		int reOpenFile(void);
 
+		/**
+		 * Memory-map the main file. (FM_MMAP)
+		 *
+		 * INTERNAL FUNCTION. This is only done for regular files
+		 * opened as read-only without gzip decompression.
+		 * If mapping fails, the file handle is used as usual.
+		 *
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int mapFile(void);
+
+		/**
+		 * Unmap the main file.
+		 * The file handle's position is set to the mapping's position.
+		 */
+		void unmapFile(void);
+
+		/**
+		 * Close the gzip index. (FM_GZIP_DECOMPRESS)
+		 *
+		 * If FM_GZIP_INDEX_CACHE is set and new access points
+		 * were added, the index is saved to the cache directory.
+		 */
+		void closeGzIndex(void);
+
+#ifndef _WIN32
+		/**
+		 * Get the file descriptor for positional reads.
+		 *
+		 * This is only usable for regular files opened as read-only
+		 * without gzip decompression, since stdio buffering and gzip
+		 * state would otherwise be bypassed.
+		 *
+		 * @return File descriptor, or -1 if positional reads can't be used.
+		 */
+		int preadFd(void) const
+		{
+			if (!file || gzIndex || devInfo || (mode & RpFile::FM_WRITE))
+				return -1;
+			return fileno(file);
+		}
+#endif /* !_WIN32 */
+
 	public:
 		/**
-		 * Read one sector into the sector cache.
+		 * Read LBAs from the device, bypassing the sector cache.
+		 * Kreon drives use SCSI READ(10) in 64 KB transfers;
+		 * other drives use the OS API.
+		 * @param lba		[in] First LBA to read.
+		 * @param lbaCount	[in] Number of LBAs to read.
+		 * @param pBuf		[out] Output buffer. (must be at least lbaCount * sector_size bytes)
+		 * @return 0 on success, positive for SCSI sense key, negative for POSIX error code.
+		 */
+		int readLBAs(uint32_t lba, uint32_t lbaCount, uint8_t *pBuf);
+
+		/**
+		 * Load an LBA into the sector cache.
+		 * If the LBA isn't cached, up to readahead_size bytes
+		 * are read, starting at the specified LBA. If that fails,
+		 * only the specified LBA is read.
 		 * @param lba LBA to read.
 		 * @return 0 on success; non-zero on error.
 		 */
-		int readOneLBA(uint32_t lba);
+		int loadLBAIntoCache(uint32_t lba);
 
 		/**
 		 * Read using block reads.
@@ -21,8 +21,12 @@
 
 // C includes
 #include <fcntl.h>	// AT_EMPTY_PATH
+#include <sys/mman.h>	// mmap(), munmap()
 #include <sys/stat.h>	// stat(), statx()
-#include <unistd.h>	// ftruncate()
+#include <unistd.h>	// ftruncate(), pread()
+#ifdef HAVE_PREADV
+#  include <sys/uio.h>	// preadv()
+#endif /* HAVE_PREADV */
 
 // C++ STL classes
 using std::string;
@@ -33,7 +37,8 @@ namespace LibRpFile {
 
 RpFilePrivate::RpFilePrivate(RpFile *q, const char *filename, RpFile::FileMode mode)
 	: q_ptr(q), file(INVALID_HANDLE_VALUE)
-	, mode(mode), gzfd(nullptr), gzsz(-1)
+	, mode(mode), gzIndex(nullptr), gzsz(-1)
+	, mmap_buf(nullptr), mmap_sz(0), mmap_pos(0)
 {
 	assert(filename != nullptr);
 	this->filename = strdup(filename);
@@ -41,9 +46,10 @@ RpFilePrivate::RpFilePrivate(RpFile *q, const char *filename, RpFile::FileMode m
 
 RpFilePrivate::~RpFilePrivate()
 {
-	if (gzfd != nullptr) {
-		gzclose_r(gzfd);
+	if (mmap_buf) {
+		munmap(const_cast<uint8_t*>(mmap_buf), mmap_sz);
 	}
+	closeGzIndex();
 	if (file) {
 		fclose(file);
 	}
@@ -74,7 +80,7 @@ inline const char *RpFilePrivate::mode_to_str(RpFile::FileMode mode)
 /**
  * (Re-)Open the main file.
  *
- * INTERNAL FUNCTION. This does NOT affect gzfd.
+ * INTERNAL FUNCTION. This does NOT affect gzIndex.
  * NOTE: This function sets q->m_lastError.
  *
  * Uses parameters stored in this->filename and this->mode.
@@ -224,6 +230,90 @@ int RpFilePrivate::reOpenFile(void)
 	return 0;
 }
 
+/**
+ * Memory-map the main file. (FM_MMAP)
+ *
+ * INTERNAL FUNCTION. This is only done for regular files
+ * opened as read-only without gzip decompression.
+ * If mapping fails, the file handle is used as usual.
+ *
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int RpFilePrivate::mapFile(void)
+{
+	assert(file != nullptr);
+	assert(mmap_buf == nullptr);
+	if (!file || mmap_buf) {
+		return -EBADF;
+	}
+
+	const int fd = fileno(file);
+	struct stat sb;
+	if (fstat(fd, &sb) != 0) {
+		return -errno;
+	} else if (!S_ISREG(sb.st_mode) || sb.st_size <= 0) {
+		// Only non-empty regular files can be mapped.
+		return -ENOTSUP;
+	} else if (static_cast<uint64_t>(sb.st_size) > std::numeric_limits<size_t>::max()) {
+		// File is too big to map on this system. (32-bit)
+		return -EFBIG;
+	}
+
+	// NOTE: If the file is truncated by another process while
+	// it's mapped, accessing the missing pages will raise SIGBUS,
+	// even with MAP_PRIVATE. This is why FM_MMAP is opt-in.
+	const size_t sz = static_cast<size_t>(sb.st_size);
+	void *const p = mmap(nullptr, sz, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		return -errno;
+	}
+
+	// Start at the file handle's current position.
+	const off64_t pos = ftello(file);
+	mmap_buf = static_cast<const uint8_t*>(p);
+	mmap_sz = sz;
+	mmap_pos = (pos > 0) ? pos : 0;
+	return 0;
+}
+
+/**
+ * Unmap the main file.
+ * The file handle's position is set to the mapping's position.
+ */
+void RpFilePrivate::unmapFile(void)
+{
+	if (!mmap_buf)
+		return;
+
+	munmap(const_cast<uint8_t*>(mmap_buf), mmap_sz);
+	mmap_buf = nullptr;
+	if (file) {
+		fseeko(file, mmap_pos, SEEK_SET);
+	}
+	mmap_sz = 0;
+	mmap_pos = 0;
+}
+
+/**
+ * Close the gzip index. (FM_GZIP_DECOMPRESS)
+ *
+ * If FM_GZIP_INDEX_CACHE is set and new access points
+ * were added, the index is saved to the cache directory.
+ */
+void RpFilePrivate::closeGzIndex(void)
+{
+	if (!gzIndex)
+		return;
+
+	if ((mode & RpFile::FM_GZIP_INDEX_CACHE) && gzIndex->isIndexDirty()) {
+		// NOTE: Errors are ignored, since the index
+		// can be rebuilt the next time.
+		gzIndex->saveIndexToCache(filename);
+	}
+	delete gzIndex;
+	gzIndex = nullptr;
+}
+
 /** RpFile **/
 
 /**
@@ -255,7 +345,7 @@ RpFile::RpFile(const char *filename, FileMode mode)
 	// Check if this is a gzipped file.
 	// If it is, use transparent decompression.
 	// Reference: https://www.forensicswiki.org/wiki/Gzip
-	const bool tryGzip = (d->mode == FM_OPEN_READ_GZ);
+	const bool tryGzip = ((d->mode & ~(FM_MMAP | FM_GZIP_INDEX_CACHE)) == FM_OPEN_READ_GZ);
 	if (tryGzip) { do {
 		uint16_t gzmagic;
 		size_t size = fread(&gzmagic, 1, sizeof(gzmagic), d->file);
@@ -283,31 +373,33 @@ RpFile::RpFile(const char *filename, FileMode mode)
 		// TODO: Add better verification heuristics?
 		d->gzsz = static_cast<off64_t>(uncomp_sz);
 
-		// Make sure the CRC32 table is initialized.
-		get_crc_table();
-
-		// Open the file with gzdopen().
+		// Open the file with GzIndex for random access.
+		// NOTE: GzIndex uses pread(), so the stdio buffer is bypassed.
 		::rewind(d->file);
 		::fflush(d->file);
 		int gzfd_dup = ::dup(fileno(d->file));
 		if (gzfd_dup >= 0) {
-			d->gzfd = gzdopen(gzfd_dup, "r");
-			if (d->gzfd) {
-				m_isCompressed = true;
-			} else {
-				// gzdopen() failed.
-				// Close the dup()'d handle to prevent a leak.
-				::close(gzfd_dup);
+			d->gzIndex = new GzIndex(gzfd_dup);
+			m_isCompressed = true;
+			if (d->mode & FM_GZIP_INDEX_CACHE) {
+				// Load the saved index, if available.
+				d->gzIndex->loadIndexFromCache(d->filename);
 			}
 		}
 	} while (0); }
 
-	if (tryGzip && !d->gzfd) {
+	if (tryGzip && !d->gzIndex) {
 		// Not a gzipped file.
 		// Rewind and flush the file.
 		::rewind(d->file);
 		::fflush(d->file);
 	}
+
+	if ((d->mode & FM_MMAP) && !(d->mode & FM_WRITE) && !d->gzIndex && !d->devInfo) {
+		// Memory-map the file.
+		// If this fails, the file handle will be used as usual.
+		d->mapFile();
+	}
 }
 
 /**
@@ -351,10 +443,8 @@ void RpFile::close(void)
 		d->devInfo->close();
 	}
 
-	if (d->gzfd != nullptr) {
-		gzclose_r(d->gzfd);
-		d->gzfd = nullptr;
-	}
+	d->unmapFile();
+	d->closeGzIndex();
 	if (d->file) {
 		fclose(d->file);
 		d->file = nullptr;
@@ -380,15 +470,25 @@ size_t RpFile::read(void *ptr, size_t size)
 		return d->readUsingBlocks(ptr, size);
 	}
 
+	if (d->mmap_buf) {
+		// Memory-mapped file.
+		if (d->mmap_pos >= static_cast<off64_t>(d->mmap_sz)) {
+			// End of file.
+			return 0;
+		}
+		const size_t mmap_pos = static_cast<size_t>(d->mmap_pos);
+		size = std::min(size, d->mmap_sz - mmap_pos);
+		memcpy(ptr, &d->mmap_buf[mmap_pos], size);
+		d->mmap_pos += size;
+		return size;
+	}
+
 	size_t ret;
-	if (d->gzfd != nullptr) {
-		int iret = gzread(d->gzfd, ptr, size);
-		if (iret >= 0) {
-			ret = static_cast<size_t>(iret);
-		} else {
+	if (d->gzIndex != nullptr) {
+		ret = d->gzIndex->read(ptr, size);
+		if (ret != size && d->gzIndex->lastError() != 0) {
 			// An error occurred.
-			ret = 0;
-			m_lastError = errno;
+			m_lastError = d->gzIndex->lastError();
 		}
 	} else {
 		ret = fread(ptr, 1, size, d->file);
@@ -451,26 +551,33 @@ int RpFile::seek(off64_t pos)
 		return 0;
 	}
 
-	int ret;
-	if (d->gzfd != nullptr) {
-		errno = 0;
-		z_off_t zret = gzseek(d->gzfd, pos, SEEK_SET);
-		if (zret >= 0) {
-			ret = 0;
-		} else {
-			ret = -1;
-			m_lastError = -errno;
-			if (m_lastError == 0) {
-				m_lastError = -EIO;
-			}
+	if (d->mmap_buf) {
+		// Memory-mapped file.
+		// NOTE: Seeking past EOF is allowed, same as fseeko().
+		if (pos < 0) {
+			m_lastError = EINVAL;
+			return -1;
 		}
-	} else {
-		ret = fseeko(d->file, pos, SEEK_SET);
+		d->mmap_pos = pos;
+		return 0;
+	}
+
+	int ret;
+	if (d->gzIndex != nullptr) {
+		// NOTE: Decompression is deferred until the next read().
+		ret = d->gzIndex->seek(pos);
 		if (ret != 0) {
-			m_lastError = errno;
+			m_lastError = -ret;
+			ret = -1;
 		}
+		return ret;
+	}
+
+	ret = fseeko(d->file, pos, SEEK_SET);
+	if (ret != 0) {
+		m_lastError = errno;
 	}
-	::fflush(d->file);	// needed for some things like gzip
+	::fflush(d->file);
 	return ret;
 }
 
@@ -486,8 +593,10 @@ off64_t RpFile::tell(void)
 		return -1;
 	}
 
-	if (d->gzfd != nullptr) {
-		return static_cast<off64_t>(gztell(d->gzfd));
+	if (d->mmap_buf) {
+		return d->mmap_pos;
+	} else if (d->gzIndex != nullptr) {
+		return d->gzIndex->tell();
 	}
 	return ftello(d->file);
 }
@@ -579,7 +688,10 @@ off64_t RpFile::size(void)
 	if (d->devInfo) {
 		// Block device. Use the cached device size.
 		return d->devInfo->device_size;
-	} else if (d->gzfd != nullptr) {
+	} else if (d->mmap_buf) {
+		// Memory-mapped file. Use the mapping size.
+		return static_cast<off64_t>(d->mmap_sz);
+	} else if (d->gzIndex != nullptr) {
 		// gzipped files have the uncompressed size stored
 		// at the end of the stream.
 		return d->gzsz;
@@ -609,6 +721,283 @@ const char *RpFile::filename(void) const
 	return (d->filename != nullptr && d->filename[0] != '\0') ? d->filename : nullptr;
 }
 
+/** Zero-copy access **/
+
+/**
+ * Does peek() return a pointer into the file data itself?
+ * This is only true if the file was memory-mapped. (FM_MMAP)
+ * @return True if peek() is zero-copy; false if not.
+ */
+bool RpFile::isPeekZeroCopy(void) const
+{
+	RP_D(const RpFile);
+	return (d->mmap_buf != nullptr);
+}
+
+/**
+ * Get a read-only pointer to the data at the specified position.
+ *
+ * If the file is memory-mapped, the pointer refers to the mapping,
+ * and the file position is not changed. Otherwise, this falls back
+ * to IRpFile's emulated peek().
+ *
+ * @param pos	[in] Start position.
+ * @param size	[in] Amount of data to access, in bytes.
+ * @return Pointer to the data, or nullptr if the full range isn't available.
+ */
+const uint8_t *RpFile::peek(off64_t pos, size_t size)
+{
+	RP_D(RpFile);
+	if (!d->mmap_buf) {
+		// Not memory-mapped.
+		return super::peek(pos, size);
+	}
+
+	// NOTE: Need to use a signed comparison here.
+	if (pos < 0 || size == 0 ||
+	    pos > static_cast<off64_t>(d->mmap_sz) - static_cast<off64_t>(size))
+	{
+		// Out of range.
+		return nullptr;
+	}
+
+	return &d->mmap_buf[static_cast<size_t>(pos)];
+}
+
+/** Positional I/O **/
+
+/**
+ * Read data from the file at the specified position.
+ * The file position is not changed.
+ *
+ * Memory-mapped files are read directly from the mapping.
+ * Regular read-only files use pread() on POSIX systems.
+ * Other files (compressed, writable, devices) fall back
+ * to IRpFile's emulated readAt().
+ *
+ * @param pos	[in] Start position.
+ * @param ptr	[out] Output data buffer.
+ * @param size	[in] Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t RpFile::readAt(off64_t pos, void *ptr, size_t size)
+{
+	RP_D(RpFile);
+	if (!d->file) {
+		m_lastError = EBADF;
+		return 0;
+	} else if (pos < 0) {
+		m_lastError = EINVAL;
+		return 0;
+	}
+
+	if (d->mmap_buf) {
+		// Memory-mapped file.
+		if (pos >= static_cast<off64_t>(d->mmap_sz)) {
+			return 0;
+		}
+		size = std::min(size, d->mmap_sz - static_cast<size_t>(pos));
+		memcpy(ptr, &d->mmap_buf[static_cast<size_t>(pos)], size);
+		return size;
+	}
+
+	if (d->gzIndex) {
+		// gzipped file. GzIndex restarts decompression
+		// at the nearest access point.
+		const size_t ret = d->gzIndex->readAt(pos, ptr, size);
+		if (ret != size && d->gzIndex->lastError() != 0) {
+			m_lastError = d->gzIndex->lastError();
+		}
+		return ret;
+	}
+
+	const int fd = d->preadFd();
+	if (fd < 0) {
+		// Devices need to go through read().
+		// Writable files might have unflushed data in the stdio buffer.
+		return super::readAt(pos, ptr, size);
+	}
+
+	// Use pread(). stdio buffering doesn't affect this,
+	// since the file is read-only.
+	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
+	size_t total = 0;
+	while (size > 0) {
+		const ssize_t ret = pread(fd, ptr8, size, pos);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			m_lastError = errno;
+			break;
+		} else if (ret == 0) {
+			// End of file.
+			break;
+		}
+		ptr8 += ret;
+		pos += ret;
+		size -= ret;
+		total += ret;
+	}
+	return total;
+}
+
+/**
+ * Read a contiguous range of the file into multiple buffers.
+ * The file position is not changed.
+ *
+ * Regular read-only files use preadv() if available.
+ *
+ * @param pos	[in] Start position.
+ * @param iov	[in] Array of buffer descriptors.
+ * @param iovcnt	[in] Number of buffer descriptors.
+ * @return Total number of bytes read.
+ */
+size_t RpFile::readAtV(off64_t pos, const IoVec *iov, unsigned int iovcnt)
+{
+#ifdef HAVE_PREADV
+	RP_D(RpFile);
+	const int fd = d->preadFd();
+	if (fd < 0 || d->mmap_buf || pos < 0 || iovcnt == 0) {
+		// Not usable with preadv().
+		return super::readAtV(pos, iov, iovcnt);
+	}
+
+	// Convert to struct iovec.
+	// NOTE: Using a fixed-size array on the stack for
+	// the common case of a small number of buffers.
+	static constexpr unsigned int IOV_STACK_MAX = 16;
+	struct iovec iov_stack[IOV_STACK_MAX];
+	std::unique_ptr<struct iovec[]> iov_heap;
+	struct iovec *piov = iov_stack;
+	if (iovcnt > IOV_STACK_MAX) {
+		iov_heap.reset(new struct iovec[iovcnt]);
+		piov = iov_heap.get();
+	}
+
+	size_t size_total = 0;
+	for (unsigned int i = 0; i < iovcnt; i++) {
+		piov[i].iov_base = iov[i].ptr;
+		piov[i].iov_len = iov[i].size;
+		size_total += iov[i].size;
+	}
+
+	ssize_t ret;
+	do {
+		ret = preadv(fd, piov, static_cast<int>(iovcnt), pos);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		m_lastError = errno;
+		return 0;
+	} else if (static_cast<size_t>(ret) < size_total && ret > 0) {
+		// Short read. This is usually EOF, but it might be a
+		// partial read, so fall back to readAt() for the rest.
+		size_t skip = static_cast<size_t>(ret);
+		unsigned int i = 0;
+		for (; i < iovcnt && skip >= iov[i].size; i++) {
+			skip -= iov[i].size;
+		}
+		size_t total = static_cast<size_t>(ret);
+		off64_t cur = pos + ret;
+		for (; i < iovcnt; i++, skip = 0) {
+			const size_t want = iov[i].size - skip;
+			const size_t cb = readAt(cur, static_cast<uint8_t*>(iov[i].ptr) + skip, want);
+			total += cb;
+			cur += cb;
+			if (cb != want)
+				break;
+		}
+		return total;
+	}
+	return static_cast<size_t>(ret);
+#else /* !HAVE_PREADV */
+	return super::readAtV(pos, iov, iovcnt);
+#endif /* HAVE_PREADV */
+}
+
+/** Access pattern hints **/
+
+/**
+ * Tell the OS how a range of the file will be accessed.
+ *
+ * On POSIX systems, this uses posix_fadvise(). If the file
+ * is memory-mapped, posix_madvise() is used for the mapping.
+ * Not supported for compressed files or devices.
+ *
+ * @param pos	[in] Start position.
+ * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+ * @param hint	[in] Access hint.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int RpFile::advise(off64_t pos, off64_t size, AccessHint hint)
+{
+	RP_D(RpFile);
+	if (!d->file || d->gzIndex || d->devInfo) {
+		// Not supported for compressed files or devices.
+		return -ENOTSUP;
+	} else if (pos < 0 || size < 0) {
+		return -EINVAL;
+	}
+
+#if defined(HAVE_POSIX_FADVISE) || defined(HAVE_POSIX_MADVISE)
+	int ret = 0;
+
+#  ifdef HAVE_POSIX_MADVISE
+	if (d->mmap_buf && pos < static_cast<off64_t>(d->mmap_sz)) {
+		// Memory-mapped file. The range must be page-aligned.
+		// NOTE: POSIX_MADV_DONTNEED is ignored by glibc, and there's
+		// no NOREUSE equivalent, so posix_fadvise() handles those.
+		int madv = -1;
+		switch (hint) {
+			case AH_NORMAL:		madv = POSIX_MADV_NORMAL;	break;
+			case AH_SEQUENTIAL:	madv = POSIX_MADV_SEQUENTIAL;	break;
+			case AH_RANDOM:		madv = POSIX_MADV_RANDOM;	break;
+			case AH_WILLNEED:	madv = POSIX_MADV_WILLNEED;	break;
+			default:		break;
+		}
+		if (madv >= 0) {
+			static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			const size_t start = static_cast<size_t>(pos) & ~(pageSize - 1);
+			size_t end = (size == 0 || static_cast<uint64_t>(pos + size) > d->mmap_sz)
+				? d->mmap_sz
+				: static_cast<size_t>(pos + size);
+			ret = posix_madvise(const_cast<uint8_t*>(d->mmap_buf) + start, end - start, madv);
+		}
+	}
+#  endif /* HAVE_POSIX_MADVISE */
+
+#  ifdef HAVE_POSIX_FADVISE
+	static const int fadv_tbl[] = {
+		POSIX_FADV_NORMAL,	// AH_NORMAL
+		POSIX_FADV_SEQUENTIAL,	// AH_SEQUENTIAL
+		POSIX_FADV_RANDOM,	// AH_RANDOM
+		POSIX_FADV_WILLNEED,	// AH_WILLNEED
+		POSIX_FADV_DONTNEED,	// AH_DONTNEED
+		POSIX_FADV_NOREUSE,	// AH_NOREUSE
+	};
+	assert(hint < ARRAY_SIZE(fadv_tbl));
+	if (hint >= ARRAY_SIZE(fadv_tbl)) {
+		return -EINVAL;
+	}
+
+	// NOTE: posix_fadvise() returns the error code instead of setting errno.
+	// On Linux, POSIX_FADV_WILLNEED starts readahead for the range.
+	const int fret = posix_fadvise(fileno(d->file), pos, size, fadv_tbl[hint]);
+	if (fret != 0) {
+		ret = fret;
+	}
+#  endif /* HAVE_POSIX_FADVISE */
+
+	if (ret != 0) {
+		m_lastError = ret;
+		return -ret;
+	}
+	return 0;
+#else /* !HAVE_POSIX_FADVISE && !HAVE_POSIX_MADVISE */
+	RP_UNUSED(hint);
+	return -ENOTSUP;
+#endif /* HAVE_POSIX_FADVISE || HAVE_POSIX_MADVISE */
+}
+
 /** Extra functions **/
 
 /**
@@ -626,6 +1015,8 @@ int RpFile::makeWritable(void)
 	}
 
 	RP_D(RpFile);
+	// The mapping is read-only, so switch back to the file handle.
+	d->unmapFile();
 	off64_t prev_pos = ftello(d->file);
 	fclose(d->file);
 	d->file = fopen(d->filename, "rb+");
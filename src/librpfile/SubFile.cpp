@@ -0,0 +1,70 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * SubFile.cpp: SubFile sub-file implementation, essentially the           *
+ * equivalent of DiscReader+PartitionFile but with less overhead.          *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "stdafx.h"
+#include "SubFile.hpp"
+#include "IoTrace.hpp"
+
+// C++ includes
+#include <typeinfo>
+
+namespace LibRpFile {
+
+/**
+ * Read data from the file.
+ * @param ptr Output data buffer.
+ * @param size Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t SubFile::read(void *ptr, size_t size)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return 0;
+	}
+
+	// NOTE: Not enforcing length bounds.
+	IoTrace::Scope trace(IoTrace::Op::Read, typeid(*this).name(), -1, size);
+	return trace.ret(m_file->read(ptr, size));
+}
+
+/**
+ * Read data from the file at the specified position.
+ * The file position is not changed.
+ * @param pos	[in] Start position.
+ * @param ptr	[out] Output data buffer.
+ * @param size	[in] Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t SubFile::readAt(off64_t pos, void *ptr, size_t size)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return 0;
+	} else if (pos < 0) {
+		m_lastError = EINVAL;
+		return 0;
+	} else if (pos >= m_length) {
+		return 0;
+	}
+
+	// Constrain size based on the subfile length.
+	if (static_cast<off64_t>(size) > m_length - pos) {
+		size = static_cast<size_t>(m_length - pos);
+	}
+
+	IoTrace::Scope trace(IoTrace::Op::ReadAt, typeid(*this).name(), pos, size);
+	const size_t ret = m_file->readAt(pos + m_offset, ptr, size);
+	if (ret != size) {
+		m_lastError = m_file->lastError();
+	}
+	return trace.ret(ret);
+}
+
+}
@@ -55,16 +55,7 @@ class SubFile final : public IRpFile
 		 * @return Number of bytes read.
 		 */
 		ATTR_ACCESS_SIZE(write_only, 2, 3)
-		size_t read(void *ptr, size_t size) final
-		{
-			if (!m_file) {
-				m_lastError = EBADF;
-				return 0;
-			}
-
-			// NOTE: Not enforcing length bounds.
-			return m_file->read(ptr, size);
-		}
+		size_t read(void *ptr, size_t size) final;
 
 		/**
 		 * Write data to the file.
@@ -151,6 +142,81 @@ class SubFile final : public IRpFile
 			return m_length;
 		}
 
+	public:
+		/** Zero-copy access **/
+
+		/**
+		 * Does peek() return a pointer into the file data itself?
+		 * @return True if peek() is zero-copy; false if not.
+		 */
+		bool isPeekZeroCopy(void) const final
+		{
+			return (m_file && m_file->isPeekZeroCopy());
+		}
+
+		/**
+		 * Get a read-only pointer to the data at the specified position.
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Amount of data to access, in bytes.
+		 * @return Pointer to the data, or nullptr if the full range isn't available.
+		 */
+		const uint8_t *peek(off64_t pos, size_t size) final
+		{
+			if (!m_file) {
+				m_lastError = EBADF;
+				return nullptr;
+			}
+
+			// NOTE: Need to use a signed comparison here.
+			if (pos < 0 || pos > m_length - static_cast<off64_t>(size)) {
+				// Out of range.
+				return nullptr;
+			}
+
+			return m_file->peek(pos + m_offset, size);
+		}
+
+	public:
+		/** Positional I/O **/
+
+		/**
+		 * Read data from the file at the specified position.
+		 * The file position is not changed.
+		 * @param pos	[in] Start position.
+		 * @param ptr	[out] Output data buffer.
+		 * @param size	[in] Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		size_t readAt(off64_t pos, void *ptr, size_t size) final;
+
+	public:
+		/** Access pattern hints **/
+
+		/**
+		 * Tell the OS how a range of the file will be accessed.
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+		 * @param hint	[in] Access hint.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int advise(off64_t pos, off64_t size, AccessHint hint) final
+		{
+			if (!m_file) {
+				return -EBADF;
+			} else if (pos < 0 || size < 0) {
+				return -EINVAL;
+			} else if (pos >= m_length) {
+				return 0;
+			}
+
+			// Constrain size based on the subfile length.
+			if (size == 0 || size > m_length - pos) {
+				size = m_length - pos;
+			}
+			return m_file->advise(pos + m_offset, size, hint);
+		}
+
 	protected:
 		LibRpFile::IRpFilePtr m_file;
 		off64_t m_offset;
@@ -0,0 +1,336 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * TracingFile.cpp: IRpFile wrapper that records all accesses.             *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "stdafx.h"
+#include "TracingFile.hpp"
+
+// C++ includes
+#include <typeinfo>
+
+// TracingFile isn't used by libromdata directly,
+// so use some linker hax to force linkage.
+extern "C" {
+	extern unsigned char RP_LibRpFile_TracingFile_ForceLinkage;
+	unsigned char RP_LibRpFile_TracingFile_ForceLinkage;
+}
+
+namespace LibRpFile {
+
+/**
+ * Wrap an IRpFile and record all accesses in an IoTrace.
+ *
+ * Accesses are tagged with the underlying file's class name.
+ * Zero-copy access (peek()) is passed through, so wrapping
+ * a file doesn't change how RomData subclasses read it.
+ *
+ * @param file	[in] Underlying file
+ * @param trace	[in] Trace to record accesses in
+ */
+TracingFile::TracingFile(const IRpFilePtr &file, const std::shared_ptr<IoTrace> &trace)
+	: m_file(file)
+	, m_trace(trace)
+	, m_tag(nullptr)
+	, m_pos(-1)
+{
+	assert((bool)file);
+	assert((bool)trace);
+	if (!file || !trace) {
+		m_file.reset();
+		m_lastError = EBADF;
+		return;
+	}
+
+	// Copy the file properties.
+	m_isWritable = file->isWritable();
+	m_isCompressed = file->isCompressed();
+	m_fileType = file->fileType();
+	m_tag = typeid(*file).name();
+	m_pos = file->tell();
+}
+
+/**
+ * Is the file open?
+ * This usually only returns false if an error occurred.
+ * @return True if the file is open; false if it isn't.
+ */
+bool TracingFile::isOpen(void) const
+{
+	return m_file && m_file->isOpen();
+}
+
+/**
+ * Close the file.
+ */
+void TracingFile::close(void)
+{
+	if (m_file) {
+		m_file->close();
+	}
+}
+
+/**
+ * Read data from the file.
+ * @param ptr Output data buffer.
+ * @param size Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t TracingFile::read(void *ptr, size_t size)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return 0;
+	}
+
+	const uint64_t start_ns = m_trace->now();
+	const size_t ret = m_file->read(ptr, size);
+	m_lastError = m_file->lastError();
+	m_trace->record(IoTrace::Op::Read, m_tag, m_pos, size, ret, start_ns);
+	if (m_pos >= 0) {
+		m_pos += ret;
+	}
+	return ret;
+}
+
+/**
+ * Write data to the file.
+ * @param ptr Input data buffer.
+ * @param size Amount of data to write, in bytes.
+ * @return Number of bytes written.
+ */
+size_t TracingFile::write(const void *ptr, size_t size)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return 0;
+	}
+
+	// NOTE: Writes aren't traced.
+	const size_t ret = m_file->write(ptr, size);
+	m_lastError = m_file->lastError();
+	if (m_pos >= 0) {
+		m_pos += ret;
+	}
+	return ret;
+}
+
+/**
+ * Set the file position.
+ * @param pos File position.
+ * @return 0 on success; -1 on error.
+ */
+int TracingFile::seek(off64_t pos)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return -1;
+	}
+
+	const uint64_t start_ns = m_trace->now();
+	const int ret = m_file->seek(pos);
+	m_lastError = m_file->lastError();
+	m_trace->record(IoTrace::Op::Seek, m_tag, pos, 0, 0, start_ns);
+	m_pos = (ret == 0) ? pos : -1;
+	return ret;
+}
+
+/**
+ * Get the file position.
+ * @return File position, or -1 on error.
+ */
+off64_t TracingFile::tell(void)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return -1;
+	}
+
+	m_pos = m_file->tell();
+	return m_pos;
+}
+
+/**
+ * Truncate the file.
+ * @param size New size. (default is 0)
+ * @return 0 on success; -1 on error.
+ */
+int TracingFile::truncate(off64_t size)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return -1;
+	}
+
+	const int ret = m_file->truncate(size);
+	m_lastError = m_file->lastError();
+	m_pos = m_file->tell();
+	return ret;
+}
+
+/**
+ * Flush buffers.
+ * This operation only makes sense on writable files.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int TracingFile::flush(void)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return -EBADF;
+	}
+	return m_file->flush();
+}
+
+/** File properties **/
+
+/**
+ * Get the file size.
+ * @return File size, or negative on error.
+ */
+off64_t TracingFile::size(void)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return -1;
+	}
+	return m_file->size();
+}
+
+/**
+ * Get the filename.
+ * @return Filename. (May be nullptr if the filename is not available.)
+ */
+const char *TracingFile::filename(void) const
+{
+	return (m_file ? m_file->filename() : nullptr);
+}
+
+/** Extra functions **/
+
+/**
+ * Make the file writable.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int TracingFile::makeWritable(void)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return -EBADF;
+	}
+
+	const int ret = m_file->makeWritable();
+	m_isWritable = m_file->isWritable();
+	m_pos = m_file->tell();
+	return ret;
+}
+
+/** Zero-copy access **/
+
+/**
+ * Does peek() return a pointer into the file data itself?
+ * If false, peek() is emulated by reading into an internal buffer.
+ * @return True if peek() is zero-copy; false if not.
+ */
+bool TracingFile::isPeekZeroCopy(void) const
+{
+	return (m_file ? m_file->isPeekZeroCopy() : false);
+}
+
+/**
+ * Get a read-only pointer to the data at the specified position.
+ * @param pos	[in] Start position.
+ * @param size	[in] Amount of data to access, in bytes.
+ * @return Pointer to the data, or nullptr if the full range isn't available.
+ */
+const uint8_t *TracingFile::peek(off64_t pos, size_t size)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return nullptr;
+	}
+
+	const uint64_t start_ns = m_trace->now();
+	const uint8_t *const ret = m_file->peek(pos, size);
+	m_lastError = m_file->lastError();
+	m_trace->record(IoTrace::Op::Peek, m_tag, pos, size, (ret ? size : 0), start_ns);
+	if (!m_file->isPeekZeroCopy()) {
+		// Emulated peek() changes the file position.
+		m_pos = m_file->tell();
+	}
+	return ret;
+}
+
+/** Positional I/O **/
+
+/**
+ * Read data from the file at the specified position.
+ * The file position is not changed.
+ * @param pos	[in] Start position.
+ * @param ptr	[out] Output data buffer.
+ * @param size	[in] Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t TracingFile::readAt(off64_t pos, void *ptr, size_t size)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return 0;
+	}
+
+	const uint64_t start_ns = m_trace->now();
+	const size_t ret = m_file->readAt(pos, ptr, size);
+	m_lastError = m_file->lastError();
+	m_trace->record(IoTrace::Op::ReadAt, m_tag, pos, size, ret, start_ns);
+	return ret;
+}
+
+/**
+ * Read a contiguous range of the file into multiple buffers.
+ * The file position is not changed.
+ * @param pos	[in] Start position.
+ * @param iov	[in] Array of buffer descriptors.
+ * @param iovcnt	[in] Number of buffer descriptors.
+ * @return Total number of bytes read.
+ */
+size_t TracingFile::readAtV(off64_t pos, const IoVec *iov, unsigned int iovcnt)
+{
+	if (!m_file) {
+		m_lastError = EBADF;
+		return 0;
+	}
+
+	size_t size = 0;
+	for (unsigned int i = 0; i < iovcnt; i++) {
+		size += iov[i].size;
+	}
+
+	const uint64_t start_ns = m_trace->now();
+	const size_t ret = m_file->readAtV(pos, iov, iovcnt);
+	m_lastError = m_file->lastError();
+	m_trace->record(IoTrace::Op::ReadAt, m_tag, pos, size, ret, start_ns);
+	return ret;
+}
+
+/** Access pattern hints **/
+
+/**
+ * Tell the OS how a range of the file will be accessed.
+ * This is forwarded to the underlying file.
+ * @param pos	[in] Start position.
+ * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+ * @param hint	[in] Access hint.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int TracingFile::advise(off64_t pos, off64_t size, AccessHint hint)
+{
+	if (!m_file) {
+		return -EBADF;
+	}
+	return m_file->advise(pos, size, hint);
+}
+
+}
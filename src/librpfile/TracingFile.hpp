@@ -0,0 +1,202 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * TracingFile.hpp: IRpFile wrapper that records all accesses.             *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+#include "IRpFile.hpp"
+#include "IoTrace.hpp"
+
+namespace LibRpFile {
+
+class RP_LIBROMDATA_PUBLIC TracingFile final : public IRpFile
+{
+	public:
+		/**
+		 * Wrap an IRpFile and record all accesses in an IoTrace.
+		 *
+		 * Accesses are tagged with the underlying file's class name.
+		 * Zero-copy access (peek()) is passed through, so wrapping
+		 * a file doesn't change how RomData subclasses read it.
+		 *
+		 * @param file	[in] Underlying file
+		 * @param trace	[in] Trace to record accesses in
+		 */
+		TracingFile(const IRpFilePtr &file, const std::shared_ptr<IoTrace> &trace);
+
+	private:
+		typedef IRpFile super;
+		RP_DISABLE_COPY(TracingFile)
+
+	public:
+		/**
+		 * Is the file open?
+		 * This usually only returns false if an error occurred.
+		 * @return True if the file is open; false if it isn't.
+		 */
+		bool isOpen(void) const final;
+
+		/**
+		 * Close the file.
+		 */
+		void close(void) final;
+
+		/**
+		 * Read data from the file.
+		 * @param ptr Output data buffer.
+		 * @param size Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 2, 3)
+		size_t read(void *ptr, size_t size) final;
+
+		/**
+		 * Write data to the file.
+		 * @param ptr Input data buffer.
+		 * @param size Amount of data to write, in bytes.
+		 * @return Number of bytes written.
+		 */
+		ATTR_ACCESS_SIZE(read_only, 2, 3)
+		size_t write(const void *ptr, size_t size) final;
+
+		/**
+		 * Set the file position.
+		 * @param pos File position.
+		 * @return 0 on success; -1 on error.
+		 */
+		int seek(off64_t pos) final;
+
+		/**
+		 * Get the file position.
+		 * @return File position, or -1 on error.
+		 */
+		off64_t tell(void) final;
+
+		/**
+		 * Truncate the file.
+		 * @param size New size. (default is 0)
+		 * @return 0 on success; -1 on error.
+		 */
+		int truncate(off64_t size = 0) final;
+
+		/**
+		 * Flush buffers.
+		 * This operation only makes sense on writable files.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int flush(void) final;
+
+	public:
+		/** File properties **/
+
+		/**
+		 * Get the file size.
+		 * @return File size, or negative on error.
+		 */
+		off64_t size(void) final;
+
+		/**
+		 * Get the filename.
+		 * @return Filename. (May be nullptr if the filename is not available.)
+		 */
+		const char *filename(void) const final;
+
+	public:
+		/** Extra functions **/
+
+		/**
+		 * Make the file writable.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int makeWritable(void) final;
+
+	public:
+		/** Zero-copy access **/
+
+		/**
+		 * Does peek() return a pointer into the file data itself?
+		 * If false, peek() is emulated by reading into an internal buffer.
+		 * @return True if peek() is zero-copy; false if not.
+		 */
+		bool isPeekZeroCopy(void) const final;
+
+		/**
+		 * Get a read-only pointer to the data at the specified position.
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Amount of data to access, in bytes.
+		 * @return Pointer to the data, or nullptr if the full range isn't available.
+		 */
+		const uint8_t *peek(off64_t pos, size_t size) final;
+
+	public:
+		/** Positional I/O **/
+
+		/**
+		 * Read data from the file at the specified position.
+		 * The file position is not changed.
+		 * @param pos	[in] Start position.
+		 * @param ptr	[out] Output data buffer.
+		 * @param size	[in] Amount of data to read, in bytes.
+		 * @return Number of bytes read.
+		 */
+		ATTR_ACCESS_SIZE(write_only, 3, 4)
+		size_t readAt(off64_t pos, void *ptr, size_t size) final;
+
+		/**
+		 * Read a contiguous range of the file into multiple buffers.
+		 * The file position is not changed.
+		 * @param pos	[in] Start position.
+		 * @param iov	[in] Array of buffer descriptors.
+		 * @param iovcnt	[in] Number of buffer descriptors.
+		 * @return Total number of bytes read.
+		 */
+		size_t readAtV(off64_t pos, const IoVec *iov, unsigned int iovcnt) final;
+
+	public:
+		/** Access pattern hints **/
+
+		/**
+		 * Tell the OS how a range of the file will be accessed.
+		 * This is forwarded to the underlying file.
+		 * @param pos	[in] Start position.
+		 * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+		 * @param hint	[in] Access hint.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int advise(off64_t pos, off64_t size, AccessHint hint) final;
+
+	public:
+		/** TracingFile functions **/
+
+		/**
+		 * Get the underlying file.
+		 * @return Underlying file
+		 */
+		inline IRpFilePtr baseFile(void) const
+		{
+			return m_file;
+		}
+
+		/**
+		 * Get the trace.
+		 * @return Trace
+		 */
+		inline std::shared_ptr<IoTrace> trace(void) const
+		{
+			return m_trace;
+		}
+
+	private:
+		IRpFilePtr m_file;
+		std::shared_ptr<IoTrace> m_trace;
+		const char *m_tag;	// Caller tag (underlying file's type name)
+		off64_t m_pos;		// Current position (-1 if unknown)
+};
+
+typedef std::shared_ptr<TracingFile> TracingFilePtr;
+
+}
@@ -147,4 +147,65 @@ int VectorFile::truncate(off64_t size)
 	return 0;
 }
 
+/** Zero-copy access **/
+
+/**
+ * Get a read-only pointer to the data at the specified position.
+ * The pointer refers to the std::vector's data directly, and is
+ * invalidated if the file is written to or truncated.
+ * NOTE: The file position is not changed.
+ * @param pos	[in] Start position.
+ * @param size	[in] Amount of data to access, in bytes.
+ * @return Pointer to the data, or nullptr if the full range isn't available.
+ */
+const uint8_t *VectorFile::peek(off64_t pos, size_t size)
+{
+	// NOTE: Need to use a signed comparison here.
+	const size_t vec_size = m_pVector->size();
+	if (pos < 0 || size == 0 ||
+	    pos > static_cast<off64_t>(vec_size) - static_cast<off64_t>(size))
+	{
+		// Out of range.
+		return nullptr;
+	}
+
+	return m_pVector->data() + static_cast<size_t>(pos);
+}
+
+
+/** Positional I/O **/
+
+/**
+ * Read data from the file at the specified position.
+ * The file position is not changed.
+ * @param pos	[in] Start position.
+ * @param ptr	[out] Output data buffer.
+ * @param size	[in] Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t VectorFile::readAt(off64_t pos, void *ptr, size_t size)
+{
+	if (unlikely(pos < 0)) {
+		m_lastError = EINVAL;
+		return 0;
+	}
+
+	// Check if size is in bounds.
+	const size_t buf_size = m_pVector->size();
+	if (size == 0 || pos >= static_cast<off64_t>(buf_size)) {
+		// Nothing to read.
+		return 0;
+	}
+	const size_t offset = static_cast<size_t>(pos);
+	if (size > buf_size - offset) {
+		// Not enough data.
+		// Copy whatever's left in the buffer.
+		size = buf_size - offset;
+	}
+
+	// Copy the data.
+	memcpy(ptr, m_pVector->data() + offset, size);
+	return size;
+}
+
 }
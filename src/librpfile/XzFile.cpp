@@ -0,0 +1,273 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * XzFile.cpp: Random-access xz decompression.                             *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "stdafx.h"
+#include "XzFile.hpp"
+
+// C++ STL classes
+using std::vector;
+
+namespace LibRpFile {
+
+/**
+ * Open an xz-compressed file.
+ *
+ * Each xz block listed in the stream indexes is a block.
+ * Files compressed with multi-threaded xz have multiple
+ * blocks; single-threaded xz only creates one block,
+ * so seeking backwards requires decompressing from the
+ * beginning of the file.
+ *
+ * @param file Compressed file
+ */
+XzFile::XzFile(const IRpFilePtr &file)
+	: super(file)
+	, m_strm(LZMA_STREAM_INIT)
+	, m_inPos(0)
+	, m_inEnd(0)
+	, m_blockDone(true)
+{
+	if (!file) {
+		return;
+	}
+
+	vector<Block> blocks;
+	int ret = loadIndex(blocks);
+	if (ret == 0) {
+		ret = setBlocks(std::move(blocks));
+	}
+	if (ret != 0) {
+		m_lastError = -ret;
+		return;
+	}
+
+	m_inBuf.resize(64U * 1024U);
+}
+
+XzFile::~XzFile()
+{
+	lzma_end(&m_strm);
+}
+
+/**
+ * Close the file.
+ */
+void XzFile::close(void)
+{
+	super::close();
+	lzma_end(&m_strm);
+	m_blockDone = true;
+}
+
+/**
+ * Load the block table from the stream indexes.
+ * @param blocks [out] Block table
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int XzFile::loadIndex(vector<Block> &blocks)
+{
+	// Read the stream indexes, starting from the end of the file.
+	// Reference: https://tukaani.org/xz/xz-file-format.txt
+	lzma_index *combined = nullptr;
+	off64_t pos = baseFile()->size();
+	int ret = 0;
+	while (pos > 0) {
+		// Skip stream padding.
+		lzma_vli padding = 0;
+		while (pos >= 4) {
+			uint32_t pad;
+			if (readCompressed(pos - 4, &pad, sizeof(pad)) != sizeof(pad)) {
+				ret = -EIO;
+				break;
+			} else if (pad != 0) {
+				break;
+			}
+			pos -= 4;
+			padding += 4;
+		}
+		if (ret != 0) {
+			break;
+		} else if (pos < LZMA_STREAM_HEADER_SIZE * 2) {
+			ret = -EIO;
+			break;
+		}
+
+		// Stream footer
+		uint8_t buf[LZMA_STREAM_HEADER_SIZE];
+		lzma_stream_flags footerFlags;
+		if (readCompressed(pos - LZMA_STREAM_HEADER_SIZE, buf, sizeof(buf)) != sizeof(buf) ||
+		    lzma_stream_footer_decode(&footerFlags, buf) != LZMA_OK)
+		{
+			ret = -EIO;
+			break;
+		}
+
+		// Index
+		const off64_t indexPos = pos - LZMA_STREAM_HEADER_SIZE - static_cast<off64_t>(footerFlags.backward_size);
+		if (indexPos < LZMA_STREAM_HEADER_SIZE) {
+			ret = -EIO;
+			break;
+		}
+		vector<uint8_t> indexBuf(static_cast<size_t>(footerFlags.backward_size));
+		if (readCompressed(indexPos, indexBuf.data(), indexBuf.size()) != indexBuf.size()) {
+			ret = -EIO;
+			break;
+		}
+
+		lzma_index *index = nullptr;
+		uint64_t memlimit = UINT64_MAX;
+		size_t in_pos = 0;
+		if (lzma_index_buffer_decode(&index, &memlimit, nullptr,
+		    indexBuf.data(), &in_pos, indexBuf.size()) != LZMA_OK)
+		{
+			ret = -EIO;
+			break;
+		}
+
+		// Verify the stream header.
+		const lzma_vli streamSize = lzma_index_stream_size(index);
+		lzma_stream_flags headerFlags;
+		if (streamSize > static_cast<lzma_vli>(pos) ||
+		    readCompressed(pos - static_cast<off64_t>(streamSize), buf, sizeof(buf)) != sizeof(buf) ||
+		    lzma_stream_header_decode(&headerFlags, buf) != LZMA_OK ||
+		    lzma_stream_flags_compare(&headerFlags, &footerFlags) != LZMA_OK)
+		{
+			lzma_index_end(index, nullptr);
+			ret = -EIO;
+			break;
+		}
+
+		// NOTE: Streams are read backwards, so the previously-read
+		// streams are appended to this one.
+		if (lzma_index_stream_flags(index, &footerFlags) != LZMA_OK ||
+		    lzma_index_stream_padding(index, padding) != LZMA_OK ||
+		    (combined && lzma_index_cat(index, combined, nullptr) != LZMA_OK))
+		{
+			lzma_index_end(index, nullptr);
+			ret = -EIO;
+			break;
+		}
+		combined = index;
+		pos -= static_cast<off64_t>(streamSize);
+	}
+
+	if (ret != 0 || !combined) {
+		lzma_index_end(combined, nullptr);
+		return (ret != 0 ? ret : -EIO);
+	}
+
+	// Get the blocks.
+	lzma_index_iter iter;
+	lzma_index_iter_init(&iter, combined);
+	while (!lzma_index_iter_next(&iter, LZMA_INDEX_ITER_NONEMPTY_BLOCK)) {
+		Block block;
+		block.compPos = static_cast<off64_t>(iter.block.compressed_file_offset);
+		block.compSize = static_cast<off64_t>(iter.block.total_size);
+		block.uncompPos = static_cast<off64_t>(iter.block.uncompressed_file_offset);
+		block.uncompSize = static_cast<off64_t>(iter.block.uncompressed_size);
+		blocks.push_back(block);
+		m_blockChecks.push_back(iter.stream.flags->check);
+	}
+
+	lzma_index_end(combined, nullptr);
+	return (!blocks.empty() ? 0 : -EIO);
+}
+
+/**
+ * Start decompressing a block.
+ * NOTE: Called with the block cache locked.
+ * @param blockIdx	[in] Block index
+ * @param block		[in] Block
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int XzFile::beginBlock(unsigned int blockIdx, const Block &block)
+{
+	assert(blockIdx < m_blockChecks.size());
+	if (blockIdx >= m_blockChecks.size()) {
+		return -EINVAL;
+	}
+
+	// Read the block header.
+	uint8_t header[LZMA_BLOCK_HEADER_SIZE_MAX];
+	if (readCompressed(block.compPos, header, 1) != 1 || header[0] == 0) {
+		return -EIO;
+	}
+	lzma_block lzBlock;
+	memset(&lzBlock, 0, sizeof(lzBlock));
+	lzBlock.version = 0;
+	lzBlock.check = m_blockChecks[blockIdx];
+	lzBlock.header_size = lzma_block_header_size_decode(header[0]);
+	if (readCompressed(block.compPos + 1, &header[1], lzBlock.header_size - 1) != lzBlock.header_size - 1) {
+		return -EIO;
+	}
+
+	lzma_filter filters[LZMA_FILTERS_MAX + 1];
+	lzBlock.filters = filters;
+	if (lzma_block_header_decode(&lzBlock, nullptr, header) != LZMA_OK) {
+		return -EIO;
+	}
+
+	const lzma_ret lzret = lzma_block_decoder(&m_strm, &lzBlock);
+
+	// Filter options were allocated by lzma_block_header_decode().
+	for (unsigned int i = 0; filters[i].id != LZMA_VLI_UNKNOWN; i++) {
+		free(filters[i].options);
+	}
+	if (lzret != LZMA_OK) {
+		return (lzret == LZMA_MEM_ERROR) ? -ENOMEM : -EIO;
+	}
+
+	m_strm.next_in = nullptr;
+	m_strm.avail_in = 0;
+	m_inPos = block.compPos + lzBlock.header_size;
+	m_inEnd = block.compPos + block.compSize;
+	m_blockDone = false;
+	return 0;
+}
+
+/**
+ * Continue decompressing the block started with beginBlock().
+ * NOTE: Called with the block cache locked.
+ * @param ptr	[out] Output data buffer
+ * @param size	[in] Amount of data to decompress, in bytes
+ * @return Number of bytes decompressed. (less than size on error or end of block)
+ */
+size_t XzFile::decodeBlock(uint8_t *ptr, size_t size)
+{
+	m_strm.next_out = ptr;
+	m_strm.avail_out = size;
+	while (m_strm.avail_out > 0 && !m_blockDone) {
+		if (m_strm.avail_in == 0 && m_inPos < m_inEnd) {
+			// Read more compressed data.
+			const size_t toRead = static_cast<size_t>(
+				std::min<off64_t>(m_inEnd - m_inPos, m_inBuf.size()));
+			const size_t ret = readCompressed(m_inPos, m_inBuf.data(), toRead);
+			if (ret == 0) {
+				break;
+			}
+			m_strm.next_in = m_inBuf.data();
+			m_strm.avail_in = ret;
+			m_inPos += ret;
+		}
+
+		// NOTE: If there's no more input, lzma_code() returns
+		// LZMA_BUF_ERROR once it can't make any progress.
+		const lzma_ret lzret = lzma_code(&m_strm, LZMA_RUN);
+		if (lzret == LZMA_STREAM_END) {
+			// End of block.
+			m_blockDone = true;
+		} else if (lzret != LZMA_OK) {
+			m_lastError = (lzret == LZMA_MEM_ERROR) ? ENOMEM : EIO;
+			break;
+		}
+	}
+
+	return size - m_strm.avail_out;
+}
+
+}
@@ -0,0 +1,84 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * XzFile.hpp: Random-access xz decompression.                             *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+#include "CompressedFile.hpp"
+
+// liblzma
+#include <lzma.h>
+
+namespace LibRpFile {
+
+class XzFile final : public CompressedFile
+{
+	public:
+		/**
+		 * Open an xz-compressed file.
+		 *
+		 * Each xz block listed in the stream indexes is a block.
+		 * Files compressed with multi-threaded xz have multiple
+		 * blocks; single-threaded xz only creates one block,
+		 * so seeking backwards requires decompressing from the
+		 * beginning of the file.
+		 *
+		 * @param file Compressed file
+		 */
+		explicit XzFile(const IRpFilePtr &file);
+		~XzFile() final;
+
+	private:
+		typedef CompressedFile super;
+		RP_DISABLE_COPY(XzFile)
+
+	public:
+		/**
+		 * Close the file.
+		 */
+		void close(void) final;
+
+	private:
+		/**
+		 * Load the block table from the stream indexes.
+		 * @param blocks [out] Block table
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int loadIndex(std::vector<Block> &blocks);
+
+	protected:
+		/**
+		 * Start decompressing a block.
+		 * NOTE: Called with the block cache locked.
+		 * @param blockIdx	[in] Block index
+		 * @param block		[in] Block
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int beginBlock(unsigned int blockIdx, const Block &block) final;
+
+		/**
+		 * Continue decompressing the block started with beginBlock().
+		 * NOTE: Called with the block cache locked.
+		 * @param ptr	[out] Output data buffer
+		 * @param size	[in] Amount of data to decompress, in bytes
+		 * @return Number of bytes decompressed. (less than size on error or end of block)
+		 */
+		ATTR_ACCESS_SIZE(write_only, 2, 3)
+		size_t decodeBlock(uint8_t *ptr, size_t size) final;
+
+	private:
+		lzma_stream m_strm;
+		std::vector<lzma_check> m_blockChecks;	// Check type for each block
+
+		// Compressed input
+		std::vector<uint8_t> m_inBuf;
+		off64_t m_inPos;	// Compressed position of the next read
+		off64_t m_inEnd;	// End of the current block
+		bool m_blockDone;	// Current block is fully decompressed
+};
+
+}
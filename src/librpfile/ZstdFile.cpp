@@ -0,0 +1,344 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * ZstdFile.cpp: Random-access zstd decompression.                         *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "stdafx.h"
+#include "ZstdFile.hpp"
+
+// librpbyteswap
+#include "librpbyteswap/byteswap_rp.h"
+
+// zstd
+#include <zstd.h>
+
+// C++ STL classes
+using std::vector;
+
+namespace LibRpFile {
+
+// Magic numbers
+static constexpr uint32_t ZSTD_FRAME_MAGIC = 0xFD2FB528U;
+static constexpr uint32_t ZSTD_SKIPPABLE_MAGIC = 0x184D2A50U;	// low 4 bits are user-defined
+static constexpr uint32_t ZSTD_SKIPPABLE_MAGIC_MASK = 0xFFFFFFF0U;
+static constexpr uint32_t ZSTD_SEEKTABLE_SKIPPABLE_MAGIC = 0x184D2A5EU;
+static constexpr uint32_t ZSTD_SEEKABLE_MAGIC = 0x8F92EAB1U;
+
+// Maximum frame header size
+// (ZSTD_FRAMEHEADERSIZE_MAX requires ZSTD_STATIC_LINKING_ONLY.)
+static constexpr unsigned int ZSTD_FRAME_HEADER_SIZE_MAX = 18;
+
+/**
+ * zstd seekable format: Seek table footer
+ * All fields are in little-endian.
+ */
+#pragma pack(1)
+typedef struct PACKED _Zstd_SeekTable_Footer {
+	uint32_t frame_count;	// Number of frames
+	uint8_t descriptor;	// Descriptor (bit 7: checksums present)
+	uint32_t magic;		// ZSTD_SEEKABLE_MAGIC
+} Zstd_SeekTable_Footer;
+ASSERT_STRUCT(Zstd_SeekTable_Footer, 9);
+#pragma pack()
+
+/**
+ * Open a zstd-compressed file.
+ *
+ * If the file has a seek table (zstd seekable format),
+ * each frame listed in the seek table is a block.
+ * Otherwise, the frames are scanned, and each frame
+ * is a block. This requires each frame header to have
+ * the decompressed size.
+ *
+ * @param file Compressed file
+ */
+ZstdFile::ZstdFile(const IRpFilePtr &file)
+	: super(file)
+	, m_dctx(nullptr)
+	, m_inBufPos(0)
+	, m_inBufLen(0)
+	, m_inPos(0)
+	, m_inEnd(0)
+	, m_frameDone(true)
+{
+	if (!file) {
+		return;
+	}
+
+	m_dctx = ZSTD_createDCtx();
+	if (!m_dctx) {
+		m_lastError = ENOMEM;
+		return;
+	}
+	m_inBuf.resize(ZSTD_DStreamInSize());
+
+	vector<Block> blocks;
+	int ret = loadSeekTable(blocks);
+	if (ret != 0) {
+		// No seek table. Scan the frames instead.
+		blocks.clear();
+		ret = scanFrames(blocks);
+	}
+	if (ret == 0) {
+		ret = setBlocks(std::move(blocks));
+	}
+	if (ret != 0) {
+		m_lastError = -ret;
+	}
+}
+
+ZstdFile::~ZstdFile()
+{
+	ZSTD_freeDCtx(m_dctx);
+}
+
+/**
+ * Close the file.
+ */
+void ZstdFile::close(void)
+{
+	super::close();
+	ZSTD_freeDCtx(m_dctx);
+	m_dctx = nullptr;
+}
+
+/**
+ * Load the seek table. (zstd seekable format)
+ * @param blocks [out] Block table
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ZstdFile::loadSeekTable(vector<Block> &blocks)
+{
+	const off64_t compSize = baseFile()->size();
+	if (compSize < static_cast<off64_t>(8 + sizeof(Zstd_SeekTable_Footer))) {
+		return -EIO;
+	}
+
+	Zstd_SeekTable_Footer footer;
+	size_t size = readCompressed(compSize - sizeof(footer), &footer, sizeof(footer));
+	if (size != sizeof(footer) ||
+	    le32_to_cpu(footer.magic) != ZSTD_SEEKABLE_MAGIC ||
+	    (footer.descriptor & 0x7C) != 0)
+	{
+		// Not a seekable zstd file.
+		return -ENOENT;
+	}
+
+	// Seek table entries: compressed size, decompressed size, [checksum]
+	const unsigned int entrySize = (footer.descriptor & 0x80) ? 12 : 8;
+	const uint32_t frameCount = le32_to_cpu(footer.frame_count);
+	const off64_t tableSize = static_cast<off64_t>(frameCount) * entrySize;
+	const off64_t tablePos = compSize - static_cast<off64_t>(sizeof(footer)) - tableSize;
+	if (frameCount == 0 || tablePos < 8) {
+		return -EIO;
+	}
+
+	// Verify the skippable frame header.
+	uint32_t frameHeader[2];
+	size = readCompressed(tablePos - 8, frameHeader, sizeof(frameHeader));
+	if (size != sizeof(frameHeader) ||
+	    le32_to_cpu(frameHeader[0]) != ZSTD_SEEKTABLE_SKIPPABLE_MAGIC ||
+	    le32_to_cpu(frameHeader[1]) != static_cast<uint32_t>(tableSize + sizeof(footer)))
+	{
+		return -EIO;
+	}
+
+	vector<uint8_t> table(static_cast<size_t>(tableSize));
+	size = readCompressed(tablePos, table.data(), table.size());
+	if (size != table.size()) {
+		return -EIO;
+	}
+
+	blocks.resize(frameCount);
+	off64_t compPos = 0, uncompPos = 0;
+	const uint8_t *p = table.data();
+	for (Block &block : blocks) {
+		uint32_t sizes[2];
+		memcpy(sizes, p, sizeof(sizes));
+		p += entrySize;
+
+		block.compPos = compPos;
+		block.compSize = le32_to_cpu(sizes[0]);
+		block.uncompPos = uncompPos;
+		block.uncompSize = le32_to_cpu(sizes[1]);
+		compPos += block.compSize;
+		uncompPos += block.uncompSize;
+	}
+
+	if (compPos > tablePos - 8) {
+		// Frames overlap the seek table.
+		return -EIO;
+	}
+	return 0;
+}
+
+/**
+ * Scan the frame headers to build the block table.
+ * @param blocks [out] Block table
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ZstdFile::scanFrames(vector<Block> &blocks)
+{
+	const off64_t compSize = baseFile()->size();
+	off64_t pos = 0, uncompPos = 0;
+
+	while (pos < compSize) {
+		uint8_t header[ZSTD_FRAME_HEADER_SIZE_MAX];
+		const size_t size = readCompressed(pos, header, sizeof(header));
+		if (size < 8) {
+			break;
+		}
+
+		uint32_t magic;
+		memcpy(&magic, header, sizeof(magic));
+		magic = le32_to_cpu(magic);
+		if ((magic & ZSTD_SKIPPABLE_MAGIC_MASK) == ZSTD_SKIPPABLE_MAGIC) {
+			// Skippable frame.
+			uint32_t frameSize;
+			memcpy(&frameSize, &header[4], sizeof(frameSize));
+			pos += 8 + static_cast<off64_t>(le32_to_cpu(frameSize));
+			continue;
+		} else if (magic != ZSTD_FRAME_MAGIC) {
+			// Not a zstd frame. Ignore trailing data.
+			break;
+		}
+
+		// The decompressed size must be stored in the frame header.
+		const unsigned long long contentSize = ZSTD_getFrameContentSize(header, size);
+		if (contentSize == ZSTD_CONTENTSIZE_UNKNOWN || contentSize == ZSTD_CONTENTSIZE_ERROR) {
+			return -ENOTSUP;
+		}
+
+		// Get the frame header size.
+		// Reference: RFC 8878, section 3.1.1.1
+		static constexpr uint8_t fcsSizes[4] = {0, 2, 4, 8};
+		static constexpr uint8_t dictIdSizes[4] = {0, 1, 2, 4};
+		const uint8_t fhd = header[4];
+		const bool singleSegment = !!(fhd & 0x20);
+		const bool hasChecksum = !!(fhd & 0x04);
+		unsigned int fcsSize = fcsSizes[fhd >> 6];
+		if (fcsSize == 0 && singleSegment) {
+			fcsSize = 1;
+		}
+		const unsigned int headerSize = 4 + 1 + (singleSegment ? 0 : 1) + dictIdSizes[fhd & 3] + fcsSize;
+
+		// Walk the block headers to find the compressed frame size.
+		// Reference: RFC 8878, section 3.1.1.2
+		off64_t blockPos = pos + headerSize;
+		bool lastBlock = false;
+		while (!lastBlock) {
+			uint8_t bh[3];
+			if (readCompressed(blockPos, bh, sizeof(bh)) != sizeof(bh)) {
+				return -EIO;
+			}
+			const uint32_t blockHeader = bh[0] | (bh[1] << 8) | (bh[2] << 16);
+			lastBlock = !!(blockHeader & 1);
+			const unsigned int blockType = (blockHeader >> 1) & 3;
+			const uint32_t blockSize = blockHeader >> 3;
+			switch (blockType) {
+				case 0:	// Raw_Block
+				case 2:	// Compressed_Block
+					blockPos += 3 + blockSize;
+					break;
+				case 1:	// RLE_Block
+					blockPos += 3 + 1;
+					break;
+				default:
+					// Reserved
+					return -EIO;
+			}
+		}
+		if (hasChecksum) {
+			blockPos += 4;
+		}
+		if (blockPos > compSize) {
+			// Truncated frame.
+			return -EIO;
+		}
+
+		Block block;
+		block.compPos = pos;
+		block.compSize = blockPos - pos;
+		block.uncompPos = uncompPos;
+		block.uncompSize = static_cast<off64_t>(contentSize);
+		blocks.push_back(block);
+
+		pos = blockPos;
+		uncompPos += block.uncompSize;
+	}
+
+	return (!blocks.empty() ? 0 : -EIO);
+}
+
+/**
+ * Start decompressing a block.
+ * NOTE: Called with the block cache locked.
+ * @param blockIdx	[in] Block index
+ * @param block		[in] Block
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ZstdFile::beginBlock(unsigned int blockIdx, const Block &block)
+{
+	RP_UNUSED(blockIdx);
+	if (!m_dctx) {
+		return -EBADF;
+	}
+
+	ZSTD_DCtx_reset(m_dctx, ZSTD_reset_session_only);
+	m_inBufPos = 0;
+	m_inBufLen = 0;
+	m_inPos = block.compPos;
+	m_inEnd = block.compPos + block.compSize;
+	m_frameDone = false;
+	return 0;
+}
+
+/**
+ * Continue decompressing the block started with beginBlock().
+ * NOTE: Called with the block cache locked.
+ * @param ptr	[out] Output data buffer
+ * @param size	[in] Amount of data to decompress, in bytes
+ * @return Number of bytes decompressed. (less than size on error or end of block)
+ */
+size_t ZstdFile::decodeBlock(uint8_t *ptr, size_t size)
+{
+	ZSTD_outBuffer out = {ptr, size, 0};
+	while (out.pos < out.size && !m_frameDone) {
+		if (m_inBufPos == m_inBufLen && m_inPos < m_inEnd) {
+			// Read more compressed data.
+			const size_t toRead = static_cast<size_t>(
+				std::min<off64_t>(m_inEnd - m_inPos, m_inBuf.size()));
+			m_inBufLen = readCompressed(m_inPos, m_inBuf.data(), toRead);
+			m_inBufPos = 0;
+			if (m_inBufLen == 0) {
+				break;
+			}
+			m_inPos += m_inBufLen;
+		}
+
+		// NOTE: If all of the input has been consumed, zstd
+		// may still have buffered output to flush.
+		const size_t prevOutPos = out.pos;
+		ZSTD_inBuffer in = {m_inBuf.data(), m_inBufLen, m_inBufPos};
+		const size_t ret = ZSTD_decompressStream(m_dctx, &out, &in);
+		m_inBufPos = in.pos;
+		if (ZSTD_isError(ret)) {
+			m_lastError = EIO;
+			break;
+		} else if (ret == 0) {
+			// End of frame.
+			m_frameDone = true;
+		} else if (out.pos == prevOutPos && m_inBufPos == m_inBufLen && m_inPos >= m_inEnd) {
+			// No more input, and no progress. Frame is truncated.
+			m_lastError = EIO;
+			break;
+		}
+	}
+
+	return out.pos;
+}
+
+}
@@ -0,0 +1,92 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile)                        *
+ * ZstdFile.hpp: Random-access zstd decompression.                         *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#pragma once
+
+#include "CompressedFile.hpp"
+
+// zstd
+typedef struct ZSTD_DCtx_s ZSTD_DCtx;
+
+namespace LibRpFile {
+
+class ZstdFile final : public CompressedFile
+{
+	public:
+		/**
+		 * Open a zstd-compressed file.
+		 *
+		 * If the file has a seek table (zstd seekable format),
+		 * each frame listed in the seek table is a block.
+		 * Otherwise, the frames are scanned, and each frame
+		 * is a block. This requires each frame header to have
+		 * the decompressed size.
+		 *
+		 * @param file Compressed file
+		 */
+		explicit ZstdFile(const IRpFilePtr &file);
+		~ZstdFile() final;
+
+	private:
+		typedef CompressedFile super;
+		RP_DISABLE_COPY(ZstdFile)
+
+	public:
+		/**
+		 * Close the file.
+		 */
+		void close(void) final;
+
+	private:
+		/**
+		 * Load the seek table. (zstd seekable format)
+		 * @param blocks [out] Block table
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int loadSeekTable(std::vector<Block> &blocks);
+
+		/**
+		 * Scan the frame headers to build the block table.
+		 * @param blocks [out] Block table
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int scanFrames(std::vector<Block> &blocks);
+
+	protected:
+		/**
+		 * Start decompressing a block.
+		 * NOTE: Called with the block cache locked.
+		 * @param blockIdx	[in] Block index
+		 * @param block		[in] Block
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int beginBlock(unsigned int blockIdx, const Block &block) final;
+
+		/**
+		 * Continue decompressing the block started with beginBlock().
+		 * NOTE: Called with the block cache locked.
+		 * @param ptr	[out] Output data buffer
+		 * @param size	[in] Amount of data to decompress, in bytes
+		 * @return Number of bytes decompressed. (less than size on error or end of block)
+		 */
+		ATTR_ACCESS_SIZE(write_only, 2, 3)
+		size_t decodeBlock(uint8_t *ptr, size_t size) final;
+
+	private:
+		ZSTD_DCtx *m_dctx;
+
+		// Compressed input
+		std::vector<uint8_t> m_inBuf;
+		size_t m_inBufPos;	// Position in m_inBuf
+		size_t m_inBufLen;	// Valid data in m_inBuf
+		off64_t m_inPos;	// Compressed position of the next read
+		off64_t m_inEnd;	// End of the current frame
+		bool m_frameDone;	// Current frame is fully decompressed
+};
+
+}
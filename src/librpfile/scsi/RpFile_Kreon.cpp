@@ -216,6 +216,8 @@ int RpFile::setKreonLockState(KreonLockState lockState)
 	int ret = d->scsi_send_cdb(cdb.data(), cdb.size(), nullptr, 0, RpFilePrivate::ScsiDirection::In);
 	if (ret == 0) {
 		d->devInfo->isKreonUnlocked = (lockState != KreonLockState::Locked);
+		// Cached sectors may have been read in the previous lock state.
+		d->devInfo->invalidate_sector_cache();
 	}
 	return ret;
 #else /* !RP_OS_SCSI_SUPPORTED */
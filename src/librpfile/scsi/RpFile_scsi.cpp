@@ -26,12 +26,17 @@
 namespace LibRpFile {
 
 /**
- * Read one sector into the sector cache.
- * @param lba LBA to read.
- * @return 0 on success; non-zero on error.
+ * Read LBAs from the device, bypassing the sector cache.
+ * Kreon drives use SCSI READ(10) in 64 KB transfers;
+ * other drives use the OS API.
+ * @param lba		[in] First LBA to read.
+ * @param lbaCount	[in] Number of LBAs to read.
+ * @param pBuf		[out] Output buffer. (must be at least lbaCount * sector_size bytes)
+ * @return 0 on success, positive for SCSI sense key, negative for POSIX error code.
  */
-int RpFilePrivate::readOneLBA(uint32_t lba)
+int RpFilePrivate::readLBAs(uint32_t lba, uint32_t lbaCount, uint8_t *pBuf)
 {
+	assert(devInfo != nullptr);
 	if (!devInfo) {
 		// Not a device.
 		return -ENODEV;
@@ -46,86 +51,135 @@ int RpFilePrivate::readOneLBA(uint32_t lba)
 	//
 	// TODO: Not sure about NetBSD...
 	RP_Q(RpFile);
-	if (lba == devInfo->lba_cache) {
-		// This LBA is already cached.
-		// TODO: Special case for ~0U?
-		if (!devInfo->isKreonUnlocked) {
-			// OSAPI: Seek to the next sector.
-			const off64_t seek_pos = (static_cast<off64_t>(lba) + 1) * devInfo->sector_size;
-#ifdef _WIN32
-			LARGE_INTEGER liSeekPos;
-			liSeekPos.QuadPart = seek_pos;
-			BOOL bRet = SetFilePointerEx(file, liSeekPos, nullptr, FILE_BEGIN);
-			if (!bRet) {
-				// Seek error.
-				q->m_lastError = w32err_to_posix(GetLastError());
-				return -q->m_lastError;
-			}
-#else /* !_WIN32 */
-			int ret = fseeko(file, seek_pos, SEEK_SET);
-			if (ret != 0) {
-				// Seek error.
-				q->m_lastError = errno;
-				return -q->m_lastError;
+	if (devInfo->isKreonUnlocked) {
+		// Kreon drive. Use SCSI commands.
+		// NOTE: Reading up to 65535 LBAs at a time due to READ(10) limitations.
+		// FIXME: Seems to have issues above a certain number of LBAs on Linux...
+		// Reducing it to 64 KB maximum reads.
+		const uint32_t lba_increment = 65536 / devInfo->sector_size;
+		while (lbaCount > 0) {
+			const uint16_t lba_cur_count = static_cast<uint16_t>(lbaCount > lba_increment ? lba_increment : lbaCount);
+			const size_t lba_cur_size = static_cast<size_t>(lba_cur_count) * devInfo->sector_size;
+			devInfo->stats.commands++;
+			int sret = scsi_read(lba, lba_cur_count, pBuf, lba_cur_size);
+			if (sret != 0) {
+				// Read error.
+				// TODO: Handle this properly?
+				q->m_lastError = (sret < 0 ? -sret : EIO);
+				return sret;
 			}
-#endif /* !_WIN32 */
+			devInfo->stats.bytes += lba_cur_size;
+			lba += lba_cur_count;
+			lbaCount -= lba_cur_count;
+			pBuf += lba_cur_size;
 		}
 		return 0;
 	}
 
-	// Read the first block.
-	if (devInfo->isKreonUnlocked) {
-		// Kreon drive. Use SCSI commands.
-		int sret = scsi_read(lba, 1, devInfo->sector_cache.get(), devInfo->sector_size);
-		if (sret != 0) {
-			// Read error.
-			// TODO: Handle this properly?
-			devInfo->lba_cache = ~0U;
-			q->m_lastError = sret;
-			return sret;
-		}
-	} else {
-		// Not a Kreon drive. Use the OS API.
-		const off64_t seek_pos = static_cast<off64_t>(lba) * devInfo->sector_size;
+	// Not a Kreon drive. Use the OS API.
+	const off64_t seek_pos = static_cast<off64_t>(lba) * devInfo->sector_size;
+	const size_t read_size = static_cast<size_t>(lbaCount) * devInfo->sector_size;
+	devInfo->stats.commands++;
 #ifdef _WIN32
-		LARGE_INTEGER liSeekPos;
-		liSeekPos.QuadPart = seek_pos;
-		BOOL bRet = SetFilePointerEx(file, liSeekPos, nullptr, FILE_BEGIN);
-		if (!bRet) {
-			// Seek error.
-			devInfo->lba_cache = ~0U;
-			q->m_lastError = w32err_to_posix(GetLastError());
-			return -q->m_lastError;
-		}
+	LARGE_INTEGER liSeekPos;
+	liSeekPos.QuadPart = seek_pos;
+	BOOL bRet = SetFilePointerEx(file, liSeekPos, nullptr, FILE_BEGIN);
+	if (!bRet) {
+		// Seek error.
+		q->m_lastError = w32err_to_posix(GetLastError());
+		return -q->m_lastError;
+	}
 
-		DWORD bytesRead;
-		bRet = ReadFile(file, devInfo->sector_cache.get(), devInfo->sector_size, &bytesRead, nullptr);
-		if (bRet == 0 || bytesRead != devInfo->sector_size) {
-			// Read error.
-			devInfo->lba_cache = ~0U;
-			q->m_lastError = w32err_to_posix(GetLastError());
-			return -q->m_lastError;
+	DWORD bytesRead;
+	bRet = ReadFile(file, pBuf, static_cast<DWORD>(read_size), &bytesRead, nullptr);
+	devInfo->stats.bytes += bytesRead;
+	if (bRet == 0 || bytesRead != read_size) {
+		// Read error.
+		q->m_lastError = w32err_to_posix(GetLastError());
+		if (q->m_lastError == 0) {
+			q->m_lastError = EIO;
 		}
+		return -q->m_lastError;
+	}
 #else /* !_WIN32 */
-		int ret = fseeko(file, seek_pos, SEEK_SET);
-		if (ret != 0) {
-			// Seek error.
-			devInfo->lba_cache = ~0U;
-			q->m_lastError = errno;
-			return -q->m_lastError;
-		}
-		size_t bytesRead = fread(devInfo->sector_cache.get(), 1, devInfo->sector_size, file);
-		if (ferror(file) || bytesRead != devInfo->sector_size) {
-			// Read error.
-			devInfo->lba_cache = ~0U;
-			q->m_lastError = errno;
-			return -q->m_lastError;
+	int ret = fseeko(file, seek_pos, SEEK_SET);
+	if (ret != 0) {
+		// Seek error.
+		q->m_lastError = errno;
+		return -q->m_lastError;
+	}
+	size_t bytesRead = fread(pBuf, 1, read_size, file);
+	devInfo->stats.bytes += bytesRead;
+	if (ferror(file) || bytesRead != read_size) {
+		// Read error.
+		q->m_lastError = errno;
+		if (q->m_lastError == 0) {
+			q->m_lastError = EIO;
 		}
+		return -q->m_lastError;
+	}
 #endif /* _WIN32 */
+
+	return 0;
+}
+
+/**
+ * Load an LBA into the sector cache.
+ * If the LBA isn't cached, up to readahead_size bytes
+ * are read, starting at the specified LBA. If that fails,
+ * only the specified LBA is read.
+ * @param lba LBA to read.
+ * @return 0 on success; non-zero on error.
+ */
+int RpFilePrivate::loadLBAIntoCache(uint32_t lba)
+{
+	if (!devInfo) {
+		// Not a device.
+		return -ENODEV;
+	}
+
+	if (devInfo->is_lba_cached(lba)) {
+		// This LBA is already cached.
+		devInfo->stats.hits++;
+		return 0;
+	}
+	devInfo->stats.misses++;
+
+	// Make sure the sector cache is allocated.
+	devInfo->alloc_sector_cache();
+	if (!devInfo->sector_cache) {
+		// Invalid sector size.
+		return -EIO;
+	}
+
+	// Read ahead, but don't go past the end of the device.
+	// TODO: 64-bit LBAs?
+	const uint32_t lba_total = static_cast<uint32_t>(
+		(devInfo->device_size + devInfo->sector_size - 1) / devInfo->sector_size);
+	uint32_t lba_count = devInfo->readahead_lbas();
+	if (lba >= lba_total) {
+		return -EIO;
+	} else if (lba_count > lba_total - lba) {
+		lba_count = lba_total - lba;
+	}
+
+	devInfo->invalidate_sector_cache();
+	int ret = readLBAs(lba, lba_count, devInfo->sector_cache.get());
+	if (ret != 0 && lba_count > 1) {
+		// Read error. One of the read-ahead LBAs might be
+		// unreadable, so retry with only the requested LBA.
+		lba_count = 1;
+		ret = readLBAs(lba, lba_count, devInfo->sector_cache.get());
+	}
+	if (ret != 0) {
+		// Read error.
+		// NOTE: q->m_lastError is set by readLBAs().
+		return ret;
 	}
 
 	// Sector cache has been updated.
 	devInfo->lba_cache = lba;
+	devInfo->lba_cache_count = lba_count;
 	return 0;
 }
 
@@ -156,8 +210,6 @@ size_t RpFilePrivate::readUsingBlocks(void *ptr, size_t size)
 	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
 	size_t ret = 0;
 
-	RP_Q(RpFile);
-
 	// Are we already at the end of the block device?
 	if (devInfo->device_pos >= devInfo->device_size) {
 		// End of the block device.
@@ -172,143 +224,57 @@ size_t RpFilePrivate::readUsingBlocks(void *ptr, size_t size)
 
 	// sector_size must be a power of two.
 	assert(isPow2(devInfo->sector_size));
-	// TODO: 64-bit LBAs?
-	uint32_t lba_cur = static_cast<uint32_t>(devInfo->device_pos / devInfo->sector_size);
 
 	// Make sure the sector cache is allocated.
 	devInfo->alloc_sector_cache();
 
-	// Check if we're not starting on a block boundary.
-	const uint32_t blockStartOffset = devInfo->device_pos % devInfo->sector_size;
-	if (blockStartOffset != 0) {
-		// Not a block boundary.
-		// Read the end of the first block.
-		int lret = readOneLBA(lba_cur);
-		if (lret != 0) {
-			// Read error.
-			// NOTE: q->m_lastError is set by readOneLBA().
-			// TODO: readOneLBA() should return number of bytes read,
-			// then return that value instead of 0?
-			return 0;
-		}
-
-		// Copy the data from the sector buffer.
-		uint32_t read_sz = devInfo->sector_size - blockStartOffset;
-		if (size < static_cast<size_t>(read_sz)) {
-			read_sz = static_cast<uint32_t>(size);
-		}
-		memcpy(ptr8, &devInfo->sector_cache[blockStartOffset], read_sz);
-
-		// Starting block read.
-		lba_cur++;
-		devInfo->device_pos += read_sz;
-		size -= read_sz;
-		ptr8 += read_sz;
-		ret += read_sz;
-	}
-
-	if (size == 0) {
-		// Nothing else to read here.
-		return ret;
-	}
-
-	// Must be on a sector boundary now.
-	assert(devInfo->device_pos % devInfo->sector_size == 0);
-
-	// Read contiguous blocks.
-	uint32_t lba_count = static_cast<uint32_t>(size / devInfo->sector_size);
-	const size_t contig_size = static_cast<off64_t>(lba_count) * devInfo->sector_size;
-	if (devInfo->isKreonUnlocked) {
-		// Kreon drive. Use SCSI commands.
-		// NOTE: Reading up to 65535 LBAs at a time due to READ(10) limitations.
-		// TODO: Move the 65535 LBA code down to RpFile::scsi_read()?
-		// FIXME: Seems to have issues above a certain number of LBAs on Linux...
-		// Reducing it to 64 KB maximum reads.
-		// TODO: Use the sector cache for the first LBA if possible.
-		const uint32_t lba_increment = 65536 / devInfo->sector_size;
-		for (; lba_count > 0; lba_count -= lba_increment) {
-			const uint16_t lba_cur_count = (lba_count > lba_increment ? lba_increment : (uint16_t)lba_count);
-			const size_t lba_cur_size = (size_t)lba_cur_count * devInfo->sector_size;
-			int sret = scsi_read(lba_cur, lba_cur_count, ptr8, lba_cur_size);
-			if (sret != 0) {
+	while (size > 0) {
+		// TODO: 64-bit LBAs?
+		const uint32_t lba_cur = static_cast<uint32_t>(devInfo->device_pos / devInfo->sector_size);
+		const uint32_t blockStartOffset = devInfo->device_pos % devInfo->sector_size;
+
+		if (blockStartOffset == 0 && size >= devInfo->sector_cache_size &&
+		    !devInfo->is_lba_cached(lba_cur))
+		{
+			// Large aligned read that isn't cached.
+			// Read contiguous blocks directly into the output buffer.
+			const uint32_t lba_count = static_cast<uint32_t>(size / devInfo->sector_size);
+			const size_t contig_size = static_cast<size_t>(lba_count) * devInfo->sector_size;
+			int lret = readLBAs(lba_cur, lba_count, ptr8);
+			if (lret != 0) {
 				// Read error.
-				// TODO: Handle this properly?
-				q->m_lastError = sret;
-				return ret;
+				// NOTE: q->m_lastError is set by readLBAs().
+				// TODO: Return the number of bytes that were actually read?
+				break;
 			}
-			devInfo->device_pos += lba_cur_size;
-			lba_cur += lba_cur_count;
-			size -= lba_cur_size;
-			ptr8 += lba_cur_size;
-			ret += lba_cur_size;
-		}
-	} else {
-		// Not a Kreon drive. Use the OS API.
-		// TODO: Use the sector cache for the first LBA if possible.
-
-		// Make sure we're at the correct address. The initial seek may
-		// have been skipped if we started at the beginning of a block
-		// or if the partial block was cached.
-		const off64_t seek_pos = static_cast<off64_t>(lba_cur) * devInfo->sector_size;
-#ifdef _WIN32
-		LARGE_INTEGER liSeekPos;
-		liSeekPos.QuadPart = seek_pos;
-		BOOL bRet = SetFilePointerEx(file, liSeekPos, nullptr, FILE_BEGIN);
-		if (!bRet) {
-			// Seek error.
-			q->m_lastError = w32err_to_posix(GetLastError());
-			return ret;
-		}
 
-		DWORD bytesRead;
-		bRet = ReadFile(file, ptr8, static_cast<DWORD>(contig_size), &bytesRead, nullptr);
-		if (bRet == 0 || bytesRead != contig_size) {
-			// Read error.
-			q->m_lastError = w32err_to_posix(GetLastError());
-			return ret + bytesRead;
-		}
-#else /* !_WIN32 */
-		int sret = fseeko(file, seek_pos, SEEK_SET);
-		if (sret != 0) {
-			// Seek error.
-			q->m_lastError = errno;
-			return ret;
-		}
-		size_t bytesRead = fread(ptr8, 1, contig_size, file);
-		if (ferror(file) || bytesRead != contig_size) {
-			// Read error.
-			q->m_lastError = errno;
-			return ret + bytesRead;
+			devInfo->device_pos += contig_size;
+			size -= contig_size;
+			ptr8 += contig_size;
+			ret += contig_size;
+			continue;
 		}
-#endif /* !_WIN32 */
 
-		devInfo->device_pos += contig_size;
-		lba_cur += lba_count;
-		size -= contig_size;
-		ptr8 += contig_size;
-		ret += contig_size;
-	}
-
-	// Check if we still have data left. (not a full block)
-	if (size > 0) {
-		// Must be on a sector boundary now.
-		assert(devInfo->device_pos % devInfo->sector_size == 0);
-
-		// Read the last block.
-		int lret = readOneLBA(lba_cur);
+		// Small or unaligned read. Use the sector cache.
+		int lret = loadLBAIntoCache(lba_cur);
 		if (lret != 0) {
 			// Read error.
-			// NOTE: q->m_lastError is set by readOneLBA().
-			// TODO: readOneLBA() should return number of bytes read,
-			// then add it to ret?
-			return ret;
+			// NOTE: q->m_lastError is set by loadLBAIntoCache().
+			break;
 		}
 
-		// Copy the data from the sector buffer.
-		memcpy(ptr8, devInfo->sector_cache.get(), size);
+		// Copy as much data as possible from the sector cache.
+		const size_t cache_offset = (static_cast<size_t>(lba_cur - devInfo->lba_cache) * devInfo->sector_size) + blockStartOffset;
+		size_t read_sz = (static_cast<size_t>(devInfo->lba_cache_count) * devInfo->sector_size) - cache_offset;
+		if (size < read_sz) {
+			read_sz = size;
+		}
+		memcpy(ptr8, &devInfo->sector_cache[cache_offset], read_sz);
 
-		devInfo->device_pos += size;
-		ret += size;
+		devInfo->device_pos += read_sz;
+		size -= read_sz;
+		ptr8 += read_sz;
+		ret += read_sz;
 	}
 
 	// Finished reading the data.
@@ -500,6 +466,7 @@ int RpFile::rereadDeviceSizeScsi(off64_t *pDeviceSize, uint32_t *pSectorSize)
 
 	// Update the device size.
 	d->devInfo->device_size = device_size;
+	d->devInfo->invalidate_sector_cache();
 
 	// Return the values.
 	if (pDeviceSize) {
@@ -517,6 +484,57 @@ int RpFile::rereadDeviceSizeScsi(off64_t *pDeviceSize, uint32_t *pSectorSize)
 #endif /* RP_OS_SCSI_SUPPORTED */
 }
 
+/**
+ * Set the device read-ahead size.
+ *
+ * Reads that aren't large enough to be transferred directly
+ * are rounded up to this size and cached, so subsequent small
+ * reads from the same area don't need another device command.
+ *
+ * The size is rounded down to a multiple of the sector size,
+ * with a minimum of one sector and a maximum of 1 MB.
+ * Default is 64 KB.
+ *
+ * @param size Read-ahead size, in bytes.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int RpFile::setDeviceReadAhead(uint32_t size)
+{
+	RP_D(RpFile);
+	if (!d->devInfo) {
+		// Not a device.
+		return -ENODEV;
+	}
+
+	if (size > RpFilePrivate::DeviceInfo::READAHEAD_SIZE_MAX) {
+		size = RpFilePrivate::DeviceInfo::READAHEAD_SIZE_MAX;
+	}
+
+	// NOTE: The sector cache is reallocated on the next read.
+	d->devInfo->readahead_size = size;
+	return 0;
+}
+
+/**
+ * Get the device read statistics.
+ * @param pStats	[out] Device read statistics.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int RpFile::getDeviceStats(DeviceStats *pStats) const
+{
+	RP_D(const RpFile);
+	assert(pStats != nullptr);
+	if (!pStats) {
+		return -EINVAL;
+	} else if (!d->devInfo) {
+		// Not a device.
+		return -ENODEV;
+	}
+
+	*pStats = d->devInfo->stats;
+	return 0;
+}
+
 /** RpFile: Public SCSI command wrapper functions **/
 
 /**
@@ -0,0 +1,364 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile/tests)                  *
+ * BufferedFileTest.cpp: BufferedFile class test.                          *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// librpfile
+#include "librpfile/BufferedFile.hpp"
+#include "librpfile/MemFile.hpp"
+#include "librpfile/RpFile.hpp"
+using LibRpFile::BufferedFile;
+using LibRpFile::IRpFilePtr;
+using LibRpFile::MemFile;
+using LibRpFile::RpFile;
+
+// C includes
+#ifdef _WIN32
+#  include <process.h>
+#  define getpid() _getpid()
+#else /* !_WIN32 */
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+// C includes (C++ namespace)
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using std::string;
+using std::vector;
+
+namespace LibRpFile { namespace Tests {
+
+class BufferedFileTest : public ::testing::Test
+{
+	protected:
+		BufferedFileTest() = default;
+
+	public:
+		static constexpr unsigned int BLOCK_SIZE = 4096;
+		static constexpr unsigned int BLOCK_COUNT = 2;
+		static constexpr size_t FILE_SIZE = (BLOCK_SIZE * 8) + 1234;
+
+		static void SetUpTestSuite(void);
+
+		void SetUp(void) final
+		{
+			m_baseFile = std::make_shared<MemFile>(data.data(), data.size());
+			m_bufFile = std::make_shared<BufferedFile>(m_baseFile, BLOCK_SIZE, BLOCK_COUNT);
+		}
+
+		/**
+		 * Read data from the BufferedFile and compare it to the original data.
+		 * @param pos Start position
+		 * @param size Size
+		 */
+		void checkRead(off64_t pos, size_t size)
+		{
+			vector<uint8_t> buf(size);
+			ASSERT_EQ(size, m_bufFile->seekAndRead(pos, buf.data(), size));
+			EXPECT_EQ(0, memcmp(&data[static_cast<size_t>(pos)], buf.data(), size))
+				<< "pos == " << pos << ", size == " << size;
+		}
+
+	public:
+		static vector<uint8_t> data;	// File contents
+
+		IRpFilePtr m_baseFile;
+		std::shared_ptr<BufferedFile> m_bufFile;
+};
+
+vector<uint8_t> BufferedFileTest::data;
+
+/**
+ * IRpFile wrapper that holds each readAt() call until another
+ * readAt() call is in progress, or until a timeout expires.
+ * This is used to check that BufferedFile doesn't serialize
+ * reads from the underlying file.
+ */
+class GateFile final : public IRpFile
+{
+	public:
+		explicit GateFile(const IRpFilePtr &file)
+			: m_file(file)
+		{}
+
+	public:
+		bool isOpen(void) const final { return m_file->isOpen(); }
+		void close(void) final { m_file->close(); }
+		size_t read(void *ptr, size_t size) final { return m_file->read(ptr, size); }
+		size_t write(const void *ptr, size_t size) final { return m_file->write(ptr, size); }
+		int seek(off64_t pos) final { return m_file->seek(pos); }
+		off64_t tell(void) final { return m_file->tell(); }
+		off64_t size(void) final { return m_file->size(); }
+
+		size_t readAt(off64_t pos, void *ptr, size_t size) final
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_inFlight++;
+				if (m_inFlight > maxInFlight) {
+					maxInFlight = m_inFlight;
+				}
+				m_cond.notify_all();
+				m_cond.wait_for(lock, std::chrono::seconds(2), [this]() { return maxInFlight >= 2; });
+				m_inFlight--;
+			}
+			return m_file->readAt(pos, ptr, size);
+		}
+
+	public:
+		unsigned int maxInFlight = 0;
+
+	private:
+		IRpFilePtr m_file;
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		unsigned int m_inFlight = 0;
+};
+
+void BufferedFileTest::SetUpTestSuite(void)
+{
+	data.resize(FILE_SIZE);
+	uint32_t state = 0x1234;
+	for (uint8_t &p : data) {
+		state = (state * 1103515245U) + 12345U;
+		p = static_cast<uint8_t>(state >> 16);
+	}
+}
+
+/**
+ * Small reads within a block should only read the block once.
+ */
+TEST_F(BufferedFileTest, smallReads)
+{
+	for (unsigned int i = 0; i < 16; i++) {
+		checkRead(100 + (i * 200), 16);
+	}
+
+	const BufferedFile::Stats stats = m_bufFile->stats();
+	EXPECT_EQ(1U, stats.misses);
+	EXPECT_EQ(15U, stats.hits);
+	EXPECT_EQ(1U, stats.baseReads);
+	EXPECT_EQ(BLOCK_SIZE, stats.baseBytes);
+}
+
+/**
+ * Reads that cross a block boundary should use both blocks.
+ */
+TEST_F(BufferedFileTest, blockBoundary)
+{
+	checkRead(BLOCK_SIZE - 50, 100);
+	BufferedFile::Stats stats = m_bufFile->stats();
+	EXPECT_EQ(2U, stats.misses);
+	EXPECT_EQ(0U, stats.hits);
+
+	// Both blocks should now be cached.
+	checkRead(BLOCK_SIZE - 10, 20);
+	checkRead(0, 10);
+	checkRead((BLOCK_SIZE * 2) - 10, 10);
+	stats = m_bufFile->stats();
+	EXPECT_EQ(2U, stats.misses);
+	EXPECT_EQ(4U, stats.hits);
+
+	// Partial block at EOF.
+	checkRead(FILE_SIZE - 100, 100);
+	uint8_t buf[64];
+	EXPECT_EQ(10U, m_bufFile->seekAndRead(FILE_SIZE - 10, buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(&data[FILE_SIZE - 10], buf, 10));
+	EXPECT_EQ(0U, m_bufFile->seekAndRead(FILE_SIZE, buf, sizeof(buf)));
+}
+
+/**
+ * The least-recently used block should be evicted.
+ */
+TEST_F(BufferedFileTest, lruEviction)
+{
+	// Load blocks 0 and 1.
+	checkRead(0, 16);
+	checkRead(BLOCK_SIZE, 16);
+	// Use block 0 again, so block 1 is the LRU block.
+	checkRead(32, 16);
+	BufferedFile::Stats stats = m_bufFile->stats();
+	EXPECT_EQ(2U, stats.misses);
+	EXPECT_EQ(1U, stats.hits);
+
+	// Load block 2. This should evict block 1.
+	checkRead(BLOCK_SIZE * 2, 16);
+	stats = m_bufFile->stats();
+	EXPECT_EQ(3U, stats.misses);
+
+	// Block 0 should still be cached.
+	checkRead(64, 16);
+	stats = m_bufFile->stats();
+	EXPECT_EQ(3U, stats.misses);
+	EXPECT_EQ(2U, stats.hits);
+
+	// Block 1 was evicted.
+	checkRead(BLOCK_SIZE + 64, 16);
+	stats = m_bufFile->stats();
+	EXPECT_EQ(4U, stats.misses);
+	EXPECT_EQ(2U, stats.hits);
+}
+
+/**
+ * Large reads should bypass the cache.
+ */
+TEST_F(BufferedFileTest, bypass)
+{
+	checkRead(123, BLOCK_SIZE * 3);
+	const BufferedFile::Stats stats = m_bufFile->stats();
+	EXPECT_EQ(1U, stats.bypass);
+	EXPECT_EQ(0U, stats.misses);
+	EXPECT_EQ(0U, stats.hits);
+	EXPECT_EQ(BLOCK_SIZE * 3U, stats.baseBytes);
+}
+
+/**
+ * Moving the underlying file's position shouldn't affect BufferedFile,
+ * and BufferedFile reads shouldn't move the underlying file's position.
+ */
+TEST_F(BufferedFileTest, externalSeek)
+{
+	checkRead(0, 16);
+
+	// Move the underlying file's position.
+	uint8_t buf[16];
+	ASSERT_EQ(sizeof(buf), m_baseFile->seekAndRead(BLOCK_SIZE * 5, buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(&data[BLOCK_SIZE * 5], buf, sizeof(buf)));
+
+	// Sequential reads from BufferedFile should continue from its own position.
+	m_bufFile->rewind();
+	for (unsigned int i = 0; i < 4; i++) {
+		ASSERT_EQ(sizeof(buf), m_bufFile->read(buf, sizeof(buf)));
+		EXPECT_EQ(0, memcmp(&data[i * sizeof(buf)], buf, sizeof(buf)));
+		ASSERT_EQ(0, m_baseFile->seek(BLOCK_SIZE * (i + 1)));
+	}
+
+	// Cache misses and bypassed reads must not move the underlying file's position.
+	ASSERT_EQ(0, m_baseFile->seek(777));
+	checkRead(BLOCK_SIZE * 3, 16);
+	checkRead(BLOCK_SIZE * 4, BLOCK_SIZE * 2);
+	EXPECT_EQ(777, m_baseFile->tell());
+}
+
+/**
+ * Writes should go to the BufferedFile position, even if the
+ * underlying file's position was moved, and should invalidate
+ * any cached blocks they overlap.
+ */
+TEST_F(BufferedFileTest, writeAfterExternalSeek)
+{
+	string filename = ::testing::TempDir();
+	if (!filename.empty() && filename.back() != '/' && filename.back() != '\\') {
+		filename += '/';
+	}
+	char buf[64];
+	snprintf(buf, sizeof(buf), "BufferedFileTest.%u.bin", static_cast<unsigned int>(getpid()));
+	filename += buf;
+
+	vector<uint8_t> expected = data;
+	{
+		const IRpFilePtr baseFile = std::make_shared<RpFile>(filename.c_str(), RpFile::FM_CREATE_WRITE);
+		ASSERT_TRUE(baseFile->isOpen());
+		ASSERT_EQ(data.size(), baseFile->write(data.data(), data.size()));
+
+		BufferedFile bufFile(baseFile, BLOCK_SIZE, BLOCK_COUNT);
+		uint8_t rbuf[16];
+		ASSERT_EQ(sizeof(rbuf), bufFile.seekAndRead(BLOCK_SIZE + 100, rbuf, sizeof(rbuf)));
+
+		// Move the underlying file's position, then write through BufferedFile.
+		ASSERT_EQ(0, baseFile->seek(10));
+		static const uint8_t wbuf[8] = {'B','U','F','F','E','R','E','D'};
+		ASSERT_EQ(0, bufFile.seek(BLOCK_SIZE + 104));
+		ASSERT_EQ(sizeof(wbuf), bufFile.write(wbuf, sizeof(wbuf)));
+		memcpy(&expected[BLOCK_SIZE + 104], wbuf, sizeof(wbuf));
+
+		// The cached block should have been invalidated.
+		ASSERT_EQ(sizeof(rbuf), bufFile.seekAndRead(BLOCK_SIZE + 100, rbuf, sizeof(rbuf)));
+		EXPECT_EQ(0, memcmp(&expected[BLOCK_SIZE + 100], rbuf, sizeof(rbuf)));
+	}
+
+	// Verify the file contents.
+	IRpFilePtr file = std::make_shared<RpFile>(filename.c_str(), RpFile::FM_OPEN_READ);
+	ASSERT_TRUE(file->isOpen());
+	vector<uint8_t> actual(expected.size());
+	ASSERT_EQ(actual.size(), file->read(actual.data(), actual.size()));
+	EXPECT_EQ(expected, actual);
+	file.reset();
+	remove(filename.c_str());
+}
+
+/**
+ * Concurrent cache misses and bypassed reads shouldn't block each other
+ * while the underlying file is being read.
+ */
+TEST_F(BufferedFileTest, concurrentReads)
+{
+	const std::shared_ptr<GateFile> gateFile = std::make_shared<GateFile>(m_baseFile);
+	BufferedFile bufFile(gateFile, BLOCK_SIZE, BLOCK_COUNT);
+
+	// Cache misses
+	vector<uint8_t> buf1(16), buf2(16);
+	std::thread thread1([&]() { EXPECT_EQ(16U, bufFile.readAt(BLOCK_SIZE * 1, buf1.data(), 16)); });
+	std::thread thread2([&]() { EXPECT_EQ(16U, bufFile.readAt(BLOCK_SIZE * 3, buf2.data(), 16)); });
+	thread1.join();
+	thread2.join();
+	EXPECT_EQ(2U, gateFile->maxInFlight);
+	EXPECT_EQ(0, memcmp(&data[BLOCK_SIZE * 1], buf1.data(), 16));
+	EXPECT_EQ(0, memcmp(&data[BLOCK_SIZE * 3], buf2.data(), 16));
+
+	BufferedFile::Stats stats = bufFile.stats();
+	EXPECT_EQ(2U, stats.misses);
+	EXPECT_EQ(2U, stats.baseReads);
+
+	// Both blocks should have been cached.
+	uint8_t buf[16];
+	EXPECT_EQ(sizeof(buf), bufFile.readAt(BLOCK_SIZE * 1 + 16, buf, sizeof(buf)));
+	EXPECT_EQ(sizeof(buf), bufFile.readAt(BLOCK_SIZE * 3 + 16, buf, sizeof(buf)));
+	stats = bufFile.stats();
+	EXPECT_EQ(2U, stats.hits);
+
+	// Bypassed reads
+	gateFile->maxInFlight = 0;
+	buf1.resize(BLOCK_SIZE * 2);
+	buf2.resize(BLOCK_SIZE * 2);
+	std::thread thread3([&]() { EXPECT_EQ(buf1.size(), bufFile.readAt(0, buf1.data(), buf1.size())); });
+	std::thread thread4([&]() { EXPECT_EQ(buf2.size(), bufFile.readAt(BLOCK_SIZE * 4, buf2.data(), buf2.size())); });
+	thread3.join();
+	thread4.join();
+	EXPECT_EQ(2U, gateFile->maxInFlight);
+	EXPECT_EQ(0, memcmp(&data[0], buf1.data(), buf1.size()));
+	EXPECT_EQ(0, memcmp(&data[BLOCK_SIZE * 4], buf2.data(), buf2.size()));
+	stats = bufFile.stats();
+	EXPECT_EQ(2U, stats.bypass);
+}
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRpFile test suite: BufferedFile tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,595 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile/tests)                  *
+ * CompressedFileTest.cpp: ZstdFile and XzFile test.                       *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "librpfile/config.librpfile.h"
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// librpfile
+#include "librpfile/CompressedFile.hpp"
+#include "librpfile/MemFile.hpp"
+
+// zstd
+#ifdef HAVE_ZSTD
+#  include <zstd.h>
+#endif /* HAVE_ZSTD */
+
+// liblzma
+#ifdef HAVE_LZMA
+#  include <lzma.h>
+#endif /* HAVE_LZMA */
+
+// C includes (C++ namespace)
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <memory>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+namespace LibRpFile { namespace Tests {
+
+class CompressedFileTest : public ::testing::Test
+{
+	protected:
+		CompressedFileTest() = default;
+
+	public:
+		static void SetUpTestSuite(void);
+		static void TearDownTestSuite(void);
+
+		/**
+		 * Open a compressed file from memory.
+		 * @param compData Compressed data
+		 * @return CompressedFile, or nullptr if it couldn't be opened.
+		 */
+		static shared_ptr<CompressedFile> openCompressed(const vector<uint8_t> &compData);
+
+		/**
+		 * Check sequential reads, reads across block boundaries,
+		 * and random reads against the uncompressed data.
+		 * @param file		[in] CompressedFile
+		 * @param blockSizes	[in] Uncompressed block sizes
+		 */
+		static void checkReads(CompressedFile *file, const vector<size_t> &blockSizes);
+
+		/**
+		 * Append a little-endian 32-bit value.
+		 * @param buf	[in,out] Buffer
+		 * @param value	[in] Value
+		 */
+		static inline void appendLE32(vector<uint8_t> &buf, uint32_t value)
+		{
+			buf.push_back(static_cast<uint8_t>(value));
+			buf.push_back(static_cast<uint8_t>(value >> 8));
+			buf.push_back(static_cast<uint8_t>(value >> 16));
+			buf.push_back(static_cast<uint8_t>(value >> 24));
+		}
+
+#ifdef HAVE_ZSTD
+		/**
+		 * Compress data as a single zstd frame.
+		 * @param data		[in] Data
+		 * @param size		[in] Size of data
+		 * @param contentSize	[in] If true, store the decompressed size in the frame header.
+		 * @return zstd frame
+		 */
+		static vector<uint8_t> zstdFrame(const uint8_t *data, size_t size, bool contentSize = true);
+
+		/**
+		 * Build a zstd file with one frame per block.
+		 * @param blockSizes	[in] Uncompressed block sizes
+		 * @param pFrameSizes	[out,opt] Compressed frame sizes
+		 * @return zstd frames
+		 */
+		static vector<uint8_t> zstdFrames(const vector<size_t> &blockSizes, vector<uint32_t> *pFrameSizes = nullptr);
+
+		/**
+		 * Append a zstd seek table. (zstd seekable format)
+		 * @param buf		[in,out] zstd frames
+		 * @param blockSizes	[in] Uncompressed block sizes
+		 * @param frameSizes	[in] Compressed frame sizes
+		 * @param checksums	[in] If true, include checksums in the seek table.
+		 */
+		static void zstdAppendSeekTable(vector<uint8_t> &buf, const vector<size_t> &blockSizes,
+			const vector<uint32_t> &frameSizes, bool checksums);
+#endif /* HAVE_ZSTD */
+
+#ifdef HAVE_LZMA
+		/**
+		 * Build an xz file with one stream per block.
+		 * @param blockSizes	[in] Uncompressed block sizes
+		 * @param padding	[in] Stream padding after each stream except the last one
+		 * @return xz streams
+		 */
+		static vector<uint8_t> xzStreams(const vector<size_t> &blockSizes, unsigned int padding);
+#endif /* HAVE_LZMA */
+
+	public:
+		static vector<uint8_t> data;	// Uncompressed data
+
+		// Block sizes for the multi-block tests.
+		// Includes a block that's larger than the 64 KB read buffers.
+		static const vector<size_t> blockSizes;
+};
+
+vector<uint8_t> CompressedFileTest::data;
+const vector<size_t> CompressedFileTest::blockSizes = {40000, 65536, 1234, 100000, 70000};
+
+/**
+ * Simple LCG, so the test data is the same on all platforms.
+ * @param state [in/out] LCG state
+ * @return Next value
+ */
+static inline uint32_t lcg_next(uint32_t &state)
+{
+	state = (state * 1103515245U) + 12345U;
+	return (state >> 16);
+}
+
+void CompressedFileTest::SetUpTestSuite(void)
+{
+	// Create compressible, but not trivially compressible, test data.
+	// This is large enough for a block that's streamed instead of cached.
+	data.resize(5U * 1024U * 1024U);
+	uint32_t state = 0x5678;
+	for (uint8_t &p : data) {
+		p = static_cast<uint8_t>('a' + (lcg_next(state) % 16));
+	}
+}
+
+void CompressedFileTest::TearDownTestSuite(void)
+{
+	data.clear();
+	data.shrink_to_fit();
+}
+
+/**
+ * Open a compressed file from memory.
+ * @param compData Compressed data
+ * @return CompressedFile, or nullptr if it couldn't be opened.
+ */
+shared_ptr<CompressedFile> CompressedFileTest::openCompressed(const vector<uint8_t> &compData)
+{
+	const IRpFilePtr memFile = std::make_shared<MemFile>(compData.data(), compData.size());
+	return std::dynamic_pointer_cast<CompressedFile>(CompressedFile::open(memFile));
+}
+
+/**
+ * Check sequential reads, reads across block boundaries,
+ * and random reads against the uncompressed data.
+ * @param file		[in] CompressedFile
+ * @param blockSizes	[in] Uncompressed block sizes
+ */
+void CompressedFileTest::checkReads(CompressedFile *file, const vector<size_t> &blockSizes)
+{
+	size_t totalSize = 0;
+	for (size_t blockSize : blockSizes) {
+		totalSize += blockSize;
+	}
+	ASSERT_EQ(static_cast<off64_t>(totalSize), file->size());
+
+	// Sequential reads, with a chunk size that doesn't match the blocks.
+	vector<uint8_t> buf(totalSize + 100);
+	ASSERT_EQ(0, file->seek(0));
+	size_t pos = 0;
+	while (pos < totalSize) {
+		const size_t ret = file->read(&buf[pos], 7777);
+		ASSERT_GT(ret, 0U) << "pos " << pos;
+		pos += ret;
+	}
+	EXPECT_EQ(totalSize, pos);
+	EXPECT_EQ(0, memcmp(data.data(), buf.data(), totalSize));
+
+	// Reads across each block boundary, backwards.
+	size_t boundary = totalSize;
+	for (auto iter = blockSizes.crbegin(); iter != blockSizes.crend() - 1; ++iter) {
+		boundary -= *iter;
+		const size_t start = boundary - 100;
+		ASSERT_EQ(200U, file->readAt(static_cast<off64_t>(start), buf.data(), 200)) << "boundary " << boundary;
+		EXPECT_EQ(0, memcmp(&data[start], buf.data(), 200)) << "boundary " << boundary;
+	}
+
+	// A read spanning all blocks, starting in the middle of the first one.
+	ASSERT_EQ(totalSize - 10, file->readAt(10, buf.data(), totalSize - 10));
+	EXPECT_EQ(0, memcmp(&data[10], buf.data(), totalSize - 10));
+
+	// Random reads.
+	uint32_t state = 0x9ABC;
+	for (unsigned int i = 0; i < 100; i++) {
+		const size_t start = (lcg_next(state) << 8 | lcg_next(state)) % totalSize;
+		size_t size = lcg_next(state) % 2048;
+		const size_t ret = file->readAt(static_cast<off64_t>(start), buf.data(), size);
+		if (size > totalSize - start) {
+			size = totalSize - start;
+		}
+		ASSERT_EQ(size, ret) << "start " << start;
+		EXPECT_EQ(0, memcmp(&data[start], buf.data(), size)) << "start " << start;
+	}
+
+	// Reads past EOF
+	EXPECT_EQ(5U, file->readAt(static_cast<off64_t>(totalSize - 5), buf.data(), 10));
+	EXPECT_EQ(0U, file->readAt(static_cast<off64_t>(totalSize), buf.data(), 10));
+}
+
+#ifdef HAVE_ZSTD
+/**
+ * Compress data as a single zstd frame.
+ * @param data		[in] Data
+ * @param size		[in] Size of data
+ * @param contentSize	[in] If true, store the decompressed size in the frame header.
+ * @return zstd frame
+ */
+vector<uint8_t> CompressedFileTest::zstdFrame(const uint8_t *data, size_t size, bool contentSize)
+{
+	ZSTD_CCtx *const cctx = ZSTD_createCCtx();
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_contentSizeFlag, contentSize ? 1 : 0);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+
+	vector<uint8_t> out(ZSTD_compressBound(size));
+	const size_t ret = ZSTD_compress2(cctx, out.data(), out.size(), data, size);
+	ZSTD_freeCCtx(cctx);
+	EXPECT_FALSE(ZSTD_isError(ret));
+	out.resize(ZSTD_isError(ret) ? 0 : ret);
+	return out;
+}
+
+/**
+ * Build a zstd file with one frame per block.
+ * @param blockSizes	[in] Uncompressed block sizes
+ * @param pFrameSizes	[out,opt] Compressed frame sizes
+ * @return zstd frames
+ */
+vector<uint8_t> CompressedFileTest::zstdFrames(const vector<size_t> &blockSizes, vector<uint32_t> *pFrameSizes)
+{
+	vector<uint8_t> buf;
+	size_t pos = 0;
+	for (size_t blockSize : blockSizes) {
+		const vector<uint8_t> frame = zstdFrame(&data[pos], blockSize);
+		buf.insert(buf.end(), frame.begin(), frame.end());
+		if (pFrameSizes) {
+			pFrameSizes->push_back(static_cast<uint32_t>(frame.size()));
+		}
+		pos += blockSize;
+	}
+	return buf;
+}
+
+/**
+ * Append a zstd seek table. (zstd seekable format)
+ * @param buf		[in,out] zstd frames
+ * @param blockSizes	[in] Uncompressed block sizes
+ * @param frameSizes	[in] Compressed frame sizes
+ * @param checksums	[in] If true, include checksums in the seek table.
+ */
+void CompressedFileTest::zstdAppendSeekTable(vector<uint8_t> &buf, const vector<size_t> &blockSizes,
+	const vector<uint32_t> &frameSizes, bool checksums)
+{
+	const unsigned int entrySize = (checksums ? 12 : 8);
+	appendLE32(buf, 0x184D2A5EU);
+	appendLE32(buf, static_cast<uint32_t>(blockSizes.size() * entrySize + 9));
+	for (size_t i = 0; i < blockSizes.size(); i++) {
+		appendLE32(buf, frameSizes[i]);
+		appendLE32(buf, static_cast<uint32_t>(blockSizes[i]));
+		if (checksums) {
+			// NOTE: Checksums aren't verified.
+			appendLE32(buf, 0x12345678U);
+		}
+	}
+	appendLE32(buf, static_cast<uint32_t>(blockSizes.size()));
+	buf.push_back(checksums ? 0x80 : 0x00);
+	appendLE32(buf, 0x8F92EAB1U);
+}
+
+/**
+ * zstd seekable format, with and without checksums in the seek table.
+ */
+TEST_F(CompressedFileTest, zstdSeekTable)
+{
+	for (unsigned int checksums = 0; checksums < 2; checksums++) {
+		SCOPED_TRACE(checksums ? "with checksums" : "without checksums");
+
+		vector<uint32_t> frameSizes;
+		vector<uint8_t> zst = zstdFrames(blockSizes, &frameSizes);
+		zstdAppendSeekTable(zst, blockSizes, frameSizes, !!checksums);
+
+		const shared_ptr<CompressedFile> file = openCompressed(zst);
+		ASSERT_TRUE((bool)file);
+		EXPECT_TRUE(file->isCompressed());
+		EXPECT_EQ(blockSizes.size(), file->blockCount());
+		ASSERT_NO_FATAL_FAILURE(checkReads(file.get(), blockSizes));
+	}
+}
+
+/**
+ * zstd frames without a seek table.
+ * Skippable frames are ignored, and so is trailing data.
+ */
+TEST_F(CompressedFileTest, zstdScanFrames)
+{
+	vector<uint32_t> frameSizes;
+	vector<uint8_t> zst = zstdFrames(blockSizes, &frameSizes);
+
+	// Insert a skippable frame after the first frame.
+	static const uint8_t skippable[] = {
+		0x53, 0x2A, 0x4D, 0x18,	// magic (user value 3)
+		0x04, 0x00, 0x00, 0x00,	// size
+		'J', 'U', 'N', 'K',
+	};
+	zst.insert(zst.begin() + frameSizes[0], skippable, skippable + sizeof(skippable));
+
+	// Trailing data
+	static const char trailer[] = "TRAILER";
+	zst.insert(zst.end(), trailer, trailer + sizeof(trailer));
+
+	const shared_ptr<CompressedFile> file = openCompressed(zst);
+	ASSERT_TRUE((bool)file);
+	EXPECT_EQ(blockSizes.size(), file->blockCount());
+	ASSERT_NO_FATAL_FAILURE(checkReads(file.get(), blockSizes));
+}
+
+/**
+ * A zstd frame that's larger than the block cache limit is streamed.
+ * Seeking backwards restarts decompression at the beginning of the frame.
+ */
+TEST_F(CompressedFileTest, zstdStreamedFrame)
+{
+	const vector<size_t> sizes = {1000, data.size() - 1000};
+	const vector<uint8_t> zst = zstdFrames(sizes);
+
+	const shared_ptr<CompressedFile> file = openCompressed(zst);
+	ASSERT_TRUE((bool)file);
+	EXPECT_EQ(2U, file->blockCount());
+
+	uint8_t buf[4096];
+	static const size_t positions[] = {
+		4000000, 4001000, 500000, 2000, 900, 5000000, 4000000,
+	};
+	for (size_t pos : positions) {
+		ASSERT_EQ(sizeof(buf), file->readAt(static_cast<off64_t>(pos), buf, sizeof(buf))) << "pos " << pos;
+		EXPECT_EQ(0, memcmp(&data[pos], buf, sizeof(buf))) << "pos " << pos;
+	}
+}
+
+/**
+ * zstd frames without the decompressed size can't be opened
+ * unless there's a seek table.
+ */
+TEST_F(CompressedFileTest, zstdNoContentSize)
+{
+	vector<uint8_t> zst = zstdFrame(data.data(), blockSizes[0], false);
+	EXPECT_FALSE((bool)openCompressed(zst));
+
+	// With a seek table, the frame header isn't needed.
+	const uint32_t frameSize = static_cast<uint32_t>(zst.size());
+	zstdAppendSeekTable(zst, {blockSizes[0]}, {frameSize}, false);
+	const shared_ptr<CompressedFile> file = openCompressed(zst);
+	ASSERT_TRUE((bool)file);
+	ASSERT_NO_FATAL_FAILURE(checkReads(file.get(), {blockSizes[0]}));
+}
+
+/**
+ * Truncated or invalid seek tables are ignored, and the frames are scanned instead.
+ */
+TEST_F(CompressedFileTest, zstdInvalidSeekTable)
+{
+	vector<uint32_t> frameSizes;
+	const vector<uint8_t> frames = zstdFrames(blockSizes, &frameSizes);
+	vector<uint8_t> seekable = frames;
+	zstdAppendSeekTable(seekable, blockSizes, frameSizes, true);
+	const size_t footerPos = seekable.size() - 9;
+	const size_t tableHeaderPos = frames.size();
+
+	vector<vector<uint8_t>> tests;
+
+	// Truncated footer
+	tests.emplace_back(seekable.begin(), seekable.end() - 5);
+
+	// Frame count is too large for the file.
+	tests.push_back(seekable);
+	tests.back()[footerPos + 3] = 0x10;
+
+	// Skippable frame size doesn't match the seek table size.
+	tests.push_back(seekable);
+	tests.back()[tableHeaderPos + 4]++;
+
+	// Frames overlap the seek table.
+	tests.push_back(seekable);
+	tests.back()[tableHeaderPos + 8 + 2] = 0x10;
+
+	for (size_t i = 0; i < tests.size(); i++) {
+		SCOPED_TRACE(i);
+		const shared_ptr<CompressedFile> file = openCompressed(tests[i]);
+		ASSERT_TRUE((bool)file);
+		EXPECT_EQ(blockSizes.size(), file->blockCount());
+		ASSERT_NO_FATAL_FAILURE(checkReads(file.get(), blockSizes));
+	}
+}
+
+/**
+ * Seek tables that don't match the frames cause read errors.
+ */
+TEST_F(CompressedFileTest, zstdCorruptSeekTable)
+{
+	vector<uint32_t> frameSizes;
+	const vector<uint8_t> frames = zstdFrames(blockSizes, &frameSizes);
+	uint8_t buf[256];
+
+	// Frame 1 starts one byte late.
+	vector<uint32_t> badFrameSizes = frameSizes;
+	badFrameSizes[0]++;
+	badFrameSizes[1]--;
+	vector<uint8_t> zst = frames;
+	zstdAppendSeekTable(zst, blockSizes, badFrameSizes, false);
+	shared_ptr<CompressedFile> file = openCompressed(zst);
+	ASSERT_TRUE((bool)file);
+	ASSERT_EQ(sizeof(buf), file->readAt(0, buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(data.data(), buf, sizeof(buf)));
+	EXPECT_EQ(0U, file->readAt(static_cast<off64_t>(blockSizes[0]), buf, sizeof(buf)));
+	EXPECT_NE(0, file->lastError());
+
+	// Frame 0 is shorter than the seek table says.
+	// Reads in frame 0 fail, but frame 2 can still be read.
+	vector<size_t> badBlockSizes = blockSizes;
+	badBlockSizes[0]++;
+	badBlockSizes[1]--;
+	zst = frames;
+	zstdAppendSeekTable(zst, badBlockSizes, frameSizes, false);
+	file = openCompressed(zst);
+	ASSERT_TRUE((bool)file);
+	EXPECT_EQ(0U, file->readAt(0, buf, sizeof(buf)));
+	EXPECT_EQ(EIO, file->lastError());
+	const size_t frame2 = blockSizes[0] + blockSizes[1];
+	ASSERT_EQ(sizeof(buf), file->readAt(static_cast<off64_t>(frame2), buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(&data[frame2], buf, sizeof(buf)));
+}
+
+/**
+ * Truncated zstd frames without a seek table can't be opened.
+ */
+TEST_F(CompressedFileTest, zstdTruncatedFrame)
+{
+	const vector<uint8_t> frames = zstdFrames(blockSizes);
+	const vector<uint8_t> zst(frames.begin(), frames.end() - 100);
+	EXPECT_FALSE((bool)openCompressed(zst));
+}
+#endif /* HAVE_ZSTD */
+
+#ifdef HAVE_LZMA
+/**
+ * Build an xz file with one stream per block.
+ * @param blockSizes	[in] Uncompressed block sizes
+ * @param padding	[in] Stream padding after each stream except the last one
+ * @return xz streams
+ */
+vector<uint8_t> CompressedFileTest::xzStreams(const vector<size_t> &blockSizes, unsigned int padding)
+{
+	vector<uint8_t> buf;
+	size_t pos = 0;
+	for (size_t i = 0; i < blockSizes.size(); i++) {
+		const size_t blockSize = blockSizes[i];
+		vector<uint8_t> stream(lzma_stream_buffer_bound(blockSize));
+		size_t out_pos = 0;
+		const lzma_ret ret = lzma_easy_buffer_encode(1, LZMA_CHECK_CRC64, nullptr,
+			&data[pos], blockSize, stream.data(), &out_pos, stream.size());
+		EXPECT_EQ(LZMA_OK, ret);
+		buf.insert(buf.end(), stream.begin(), stream.begin() + out_pos);
+		if (i + 1 < blockSizes.size()) {
+			buf.resize(buf.size() + padding);
+		}
+		pos += blockSize;
+	}
+	return buf;
+}
+
+/**
+ * Concatenated xz streams, with and without stream padding.
+ * Each stream has one block.
+ */
+TEST_F(CompressedFileTest, xzMultiStream)
+{
+	for (unsigned int padding = 0; padding <= 8; padding += 8) {
+		SCOPED_TRACE(padding);
+		const vector<uint8_t> xz = xzStreams(blockSizes, padding);
+
+		const shared_ptr<CompressedFile> file = openCompressed(xz);
+		ASSERT_TRUE((bool)file);
+		EXPECT_TRUE(file->isCompressed());
+		EXPECT_EQ(blockSizes.size(), file->blockCount());
+		ASSERT_NO_FATAL_FAILURE(checkReads(file.get(), blockSizes));
+	}
+}
+
+/**
+ * An xz block that's larger than the block cache limit is streamed.
+ */
+TEST_F(CompressedFileTest, xzStreamedBlock)
+{
+	const vector<size_t> sizes = {data.size()};
+	const vector<uint8_t> xz = xzStreams(sizes, 0);
+
+	const shared_ptr<CompressedFile> file = openCompressed(xz);
+	ASSERT_TRUE((bool)file);
+	EXPECT_EQ(1U, file->blockCount());
+
+	uint8_t buf[4096];
+	static const size_t positions[] = {3000000, 3004096, 100, 5000000};
+	for (size_t pos : positions) {
+		ASSERT_EQ(sizeof(buf), file->readAt(static_cast<off64_t>(pos), buf, sizeof(buf))) << "pos " << pos;
+		EXPECT_EQ(0, memcmp(&data[pos], buf, sizeof(buf))) << "pos " << pos;
+	}
+}
+
+/**
+ * Truncated xz files and corrupt indexes can't be opened.
+ */
+TEST_F(CompressedFileTest, xzCorruptIndex)
+{
+	const vector<uint8_t> xz = xzStreams(blockSizes, 4);
+
+	// Truncated stream footer
+	vector<uint8_t> bad(xz.begin(), xz.end() - 1);
+	EXPECT_FALSE((bool)openCompressed(bad));
+
+	// Index CRC32 of the last stream. (right before the 12-byte footer)
+	bad = xz;
+	bad[bad.size() - LZMA_STREAM_HEADER_SIZE - 1] ^= 0x55;
+	EXPECT_FALSE((bool)openCompressed(bad));
+
+	// Stream padding that isn't a multiple of 4 bytes
+	bad = xzStreams(blockSizes, 2);
+	EXPECT_FALSE((bool)openCompressed(bad));
+}
+
+/**
+ * A corrupt xz block causes read errors in that block only.
+ */
+TEST_F(CompressedFileTest, xzCorruptBlock)
+{
+	const vector<size_t> sizes = {blockSizes[0], blockSizes[1], blockSizes[2]};
+	const vector<uint8_t> stream0 = xzStreams({sizes[0]}, 0);
+
+	// Corrupt the middle of the second stream's compressed data.
+	vector<uint8_t> xz = xzStreams(sizes, 0);
+	const size_t stream1 = stream0.size();
+	const size_t stream1Size = xzStreams({sizes[0], sizes[1]}, 0).size() - stream1;
+	xz[stream1 + (stream1Size / 2)] ^= 0xFF;
+
+	const shared_ptr<CompressedFile> file = openCompressed(xz);
+	ASSERT_TRUE((bool)file);
+	EXPECT_EQ(3U, file->blockCount());
+
+	uint8_t buf[256];
+	ASSERT_EQ(sizeof(buf), file->readAt(100, buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(&data[100], buf, sizeof(buf)));
+	EXPECT_EQ(0U, file->readAt(static_cast<off64_t>(sizes[0]), buf, sizeof(buf)));
+	EXPECT_NE(0, file->lastError());
+	const size_t block2 = sizes[0] + sizes[1];
+	ASSERT_EQ(sizeof(buf), file->readAt(static_cast<off64_t>(block2), buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(&data[block2], buf, sizeof(buf)));
+}
+#endif /* HAVE_LZMA */
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRpFile test suite: CompressedFile tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,453 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile/tests)                  *
+ * GzIndexTest.cpp: GzIndex class test.                                    *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// GzIndex
+#include "librpfile/GzIndex.hpp"
+using LibRpFile::GzIndex;
+
+// libcachecommon
+#include "libcachecommon/CacheKeys.hpp"
+
+// zlib
+#include <zlib.h>
+
+// C includes
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#  include <direct.h>
+#  include <io.h>
+#  include <process.h>
+#  define getpid() _getpid()
+#else /* !_WIN32 */
+#  include <dirent.h>
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+// C includes (C++ namespace)
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// C++ includes
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+#ifndef O_BINARY
+#  define O_BINARY 0
+#endif
+
+namespace LibRpFile { namespace Tests {
+
+class GzIndexTest : public ::testing::Test
+{
+	protected:
+		GzIndexTest() = default;
+
+	public:
+		// Uncompressed test data size.
+		// This is large enough for several access points.
+		static constexpr size_t DATA_SIZE = (GzIndex::DEFAULT_SPAN * 5) + 12345;
+
+		static void SetUpTestSuite(void);
+		static void TearDownTestSuite(void);
+
+		/**
+		 * Open the gzip test file.
+		 * @return GzIndex, or nullptr on error.
+		 */
+		static unique_ptr<GzIndex> openGz(void);
+
+		/**
+		 * Get the filename of the saved index in the cache directory.
+		 * @return Index filename, or empty string if not found.
+		 */
+		static string findIndexFile(void);
+
+		/**
+		 * Check random reads against the uncompressed data.
+		 * @param gz	[in] GzIndex
+		 * @param seed	[in] Random seed
+		 * @param count	[in] Number of reads
+		 */
+		static void checkRandomReads(GzIndex *gz, unsigned int seed, unsigned int count);
+
+	public:
+		static vector<uint8_t> data;	// Uncompressed data
+		static string tmpDir;		// Temporary directory (also used as the cache directory)
+		static string gzFilename;	// gzip test file
+};
+
+vector<uint8_t> GzIndexTest::data;
+string GzIndexTest::tmpDir;
+string GzIndexTest::gzFilename;
+
+/**
+ * Simple LCG, so the test data is the same on all platforms.
+ * @param state [in/out] LCG state
+ * @return Next value
+ */
+static inline uint32_t lcg_next(uint32_t &state)
+{
+	state = (state * 1103515245U) + 12345U;
+	return (state >> 16);
+}
+
+void GzIndexTest::SetUpTestSuite(void)
+{
+	// Create compressible, but not trivially compressible, test data.
+	data.resize(DATA_SIZE);
+	uint32_t state = 0x1234;
+	for (uint8_t &p : data) {
+		p = static_cast<uint8_t>('A' + (lcg_next(state) % 16));
+	}
+
+	// Compress it. (windowBits 15+16 == gzip format)
+	z_stream strm;
+	memset(&strm, 0, sizeof(strm));
+	ASSERT_EQ(Z_OK, deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY));
+	vector<uint8_t> gzData(deflateBound(&strm, static_cast<uLong>(data.size())));
+	strm.next_in = data.data();
+	strm.avail_in = static_cast<uInt>(data.size());
+	strm.next_out = gzData.data();
+	strm.avail_out = static_cast<uInt>(gzData.size());
+	ASSERT_EQ(Z_STREAM_END, deflate(&strm, Z_FINISH));
+	gzData.resize(strm.total_out);
+	deflateEnd(&strm);
+
+	// Write it to a temporary directory.
+	tmpDir = ::testing::TempDir();
+	if (!tmpDir.empty() && tmpDir.back() != '/' && tmpDir.back() != '\\') {
+		tmpDir += '/';
+	}
+	char dirname[32];
+	snprintf(dirname, sizeof(dirname), "GzIndexTest.%u", static_cast<unsigned int>(getpid()));
+	tmpDir += dirname;
+#ifdef _WIN32
+	_mkdir(tmpDir.c_str());
+#else /* !_WIN32 */
+	mkdir(tmpDir.c_str(), 0700);
+#endif /* _WIN32 */
+
+	gzFilename = tmpDir + "/test.bin.gz";
+	FILE *f = fopen(gzFilename.c_str(), "wb");
+	ASSERT_NE(nullptr, f);
+	ASSERT_EQ(gzData.size(), fwrite(gzData.data(), 1, gzData.size(), f));
+	fclose(f);
+
+#ifndef _WIN32
+	// Use the temporary directory as the cache directory.
+	// NOTE: This must be set before the cache directory is first used.
+	setenv("XDG_CACHE_HOME", tmpDir.c_str(), 1);
+#endif /* !_WIN32 */
+}
+
+void GzIndexTest::TearDownTestSuite(void)
+{
+	// NOTE: Temporary files are left in the test's temporary directory.
+	data.clear();
+	data.shrink_to_fit();
+}
+
+/**
+ * Open the gzip test file.
+ * @return GzIndex, or nullptr on error.
+ */
+unique_ptr<GzIndex> GzIndexTest::openGz(void)
+{
+	const int fd = open(gzFilename.c_str(), O_RDONLY | O_BINARY);
+	if (fd < 0) {
+		return {};
+	}
+	return unique_ptr<GzIndex>(new GzIndex(fd));
+}
+
+/**
+ * Get the filename of the saved index in the cache directory.
+ * @return Index filename, or empty string if not found.
+ */
+string GzIndexTest::findIndexFile(void)
+{
+	// Get the index directory from a dummy cache filename.
+	string idxDir = LibCacheCommon::getCacheFilename("gzidx/dummy.idx");
+#ifdef _WIN32
+	const size_t slash_pos = idxDir.find_last_of("/\\");
+#else /* !_WIN32 */
+	const size_t slash_pos = idxDir.rfind('/');
+#endif /* _WIN32 */
+	if (slash_pos == string::npos) {
+		return {};
+	}
+	idxDir.resize(slash_pos + 1);
+
+	string ret;
+#ifdef _WIN32
+	struct _finddata_t fd;
+	const intptr_t hFind = _findfirst((idxDir + "*.idx").c_str(), &fd);
+	if (hFind == -1) {
+		return {};
+	}
+	do {
+		if (!(fd.attrib & _A_SUBDIR)) {
+			ret = idxDir + fd.name;
+			break;
+		}
+	} while (_findnext(hFind, &fd) == 0);
+	_findclose(hFind);
+#else /* !_WIN32 */
+	DIR *pDir = opendir(idxDir.c_str());
+	if (!pDir) {
+		return {};
+	}
+	const struct dirent *dirent;
+	while ((dirent = readdir(pDir)) != nullptr) {
+		const size_t len = strlen(dirent->d_name);
+		if (len > 4 && !strcmp(&dirent->d_name[len - 4], ".idx")) {
+			ret = idxDir + dirent->d_name;
+			break;
+		}
+	}
+	closedir(pDir);
+#endif /* _WIN32 */
+	return ret;
+}
+
+/**
+ * Check random reads against the uncompressed data.
+ * @param gz	[in] GzIndex
+ * @param seed	[in] Random seed
+ * @param count	[in] Number of reads
+ */
+void GzIndexTest::checkRandomReads(GzIndex *gz, unsigned int seed, unsigned int count)
+{
+	uint32_t state = seed;
+	vector<uint8_t> buf;
+	for (unsigned int i = 0; i < count; i++) {
+		const size_t pos = (lcg_next(state) << 8 | (lcg_next(state) & 0xFF)) % data.size();
+		const size_t size = std::min(static_cast<size_t>(lcg_next(state) % 70000U), data.size() - pos);
+		buf.resize(size);
+		ASSERT_EQ(size, gz->readAt(static_cast<off64_t>(pos), buf.data(), size)) << "pos == " << pos;
+		ASSERT_EQ(0, memcmp(&data[pos], buf.data(), size)) << "pos == " << pos;
+	}
+}
+
+/**
+ * Sequential read of the entire file.
+ */
+TEST_F(GzIndexTest, sequentialRead)
+{
+	unique_ptr<GzIndex> gz = openGz();
+	ASSERT_NE(nullptr, gz);
+
+	vector<uint8_t> buf(65536 + 17);
+	size_t pos = 0;
+	while (pos < data.size()) {
+		const size_t size = gz->read(buf.data(), buf.size());
+		ASSERT_GT(size, 0U);
+		ASSERT_EQ(0, memcmp(&data[pos], buf.data(), size)) << "pos == " << pos;
+		pos += size;
+		EXPECT_EQ(static_cast<off64_t>(pos), gz->tell());
+	}
+	EXPECT_EQ(data.size(), pos);
+
+	// Reading past EOF should return 0.
+	EXPECT_EQ(0U, gz->read(buf.data(), buf.size()));
+
+	// Access points should have been added.
+	EXPECT_GE(gz->pointCount(), 4U);
+	EXPECT_TRUE(gz->isIndexDirty());
+}
+
+/**
+ * Random reads with an empty index.
+ * Backwards seeks restart at the beginning or at an access point.
+ */
+TEST_F(GzIndexTest, randomReads)
+{
+	unique_ptr<GzIndex> gz = openGz();
+	ASSERT_NE(nullptr, gz);
+	ASSERT_NO_FATAL_FAILURE(checkRandomReads(gz.get(), 1, 64));
+
+	// Once the index is built, random reads should still match.
+	EXPECT_GT(gz->pointCount(), 0U);
+	ASSERT_NO_FATAL_FAILURE(checkRandomReads(gz.get(), 2, 64));
+}
+
+/**
+ * readAt() past EOF should return a short read.
+ */
+TEST_F(GzIndexTest, readAtEOF)
+{
+	unique_ptr<GzIndex> gz = openGz();
+	ASSERT_NE(nullptr, gz);
+
+	uint8_t buf[256];
+	const off64_t pos = static_cast<off64_t>(data.size() - 100);
+	EXPECT_EQ(100U, gz->readAt(pos, buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(&data[data.size() - 100], buf, 100));
+	EXPECT_EQ(0U, gz->readAt(static_cast<off64_t>(data.size()) + 10, buf, sizeof(buf)));
+}
+
+/**
+ * Concurrent readAt() from multiple threads.
+ */
+TEST_F(GzIndexTest, concurrentReadAt)
+{
+	unique_ptr<GzIndex> gz = openGz();
+	ASSERT_NE(nullptr, gz);
+
+	static constexpr unsigned int THREAD_COUNT = 4;
+	bool ok[THREAD_COUNT];
+	vector<std::thread> threads;
+	for (unsigned int i = 0; i < THREAD_COUNT; i++) {
+		ok[i] = false;
+		threads.emplace_back([&gz, &ok, i]() {
+			uint32_t state = 100 + i;
+			vector<uint8_t> buf;
+			for (unsigned int j = 0; j < 32; j++) {
+				const size_t pos = (lcg_next(state) << 8 | (lcg_next(state) & 0xFF)) % data.size();
+				const size_t size = std::min(static_cast<size_t>(lcg_next(state) % 40000U), data.size() - pos);
+				buf.resize(size);
+				if (gz->readAt(static_cast<off64_t>(pos), buf.data(), size) != size ||
+				    memcmp(&data[pos], buf.data(), size) != 0)
+				{
+					return;
+				}
+			}
+			ok[i] = true;
+		});
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+	for (unsigned int i = 0; i < THREAD_COUNT; i++) {
+		EXPECT_TRUE(ok[i]) << "thread " << i;
+	}
+}
+
+#ifndef _WIN32
+/**
+ * Save the index to the cache and load it again.
+ */
+TEST_F(GzIndexTest, saveAndLoadIndex)
+{
+	unsigned int pointCount;
+	{
+		unique_ptr<GzIndex> gz = openGz();
+		ASSERT_NE(nullptr, gz);
+		ASSERT_NO_FATAL_FAILURE(checkRandomReads(gz.get(), 3, 32));
+		vector<uint8_t> buf(data.size());
+		ASSERT_EQ(data.size(), gz->readAt(0, buf.data(), buf.size()));
+		pointCount = gz->pointCount();
+		ASSERT_GT(pointCount, 0U);
+		ASSERT_EQ(0, gz->saveIndexToCache(gzFilename.c_str()));
+	}
+	EXPECT_FALSE(findIndexFile().empty());
+
+	unique_ptr<GzIndex> gz = openGz();
+	ASSERT_NE(nullptr, gz);
+	ASSERT_EQ(0, gz->loadIndexFromCache(gzFilename.c_str()));
+	EXPECT_EQ(pointCount, gz->pointCount());
+	EXPECT_FALSE(gz->isIndexDirty());
+	ASSERT_NO_FATAL_FAILURE(checkRandomReads(gz.get(), 4, 64));
+}
+
+/**
+ * Load a truncated or corrupted index.
+ * The index should be rejected, and reads should still work.
+ */
+TEST_F(GzIndexTest, badIndex)
+{
+	// Create and save the index.
+	{
+		unique_ptr<GzIndex> gz = openGz();
+		ASSERT_NE(nullptr, gz);
+		vector<uint8_t> buf(data.size());
+		ASSERT_EQ(data.size(), gz->readAt(0, buf.data(), buf.size()));
+		ASSERT_EQ(0, gz->saveIndexToCache(gzFilename.c_str()));
+	}
+	const string idxFilename = findIndexFile();
+	ASSERT_FALSE(idxFilename.empty());
+
+	// Read the saved index.
+	vector<uint8_t> idxData;
+	{
+		FILE *f = fopen(idxFilename.c_str(), "rb");
+		ASSERT_NE(nullptr, f);
+		uint8_t buf[4096];
+		size_t size;
+		while ((size = fread(buf, 1, sizeof(buf), f)) > 0) {
+			idxData.insert(idxData.end(), buf, buf + size);
+		}
+		fclose(f);
+	}
+	ASSERT_GT(idxData.size(), 64U);
+
+	auto writeIndex = [&idxFilename](const uint8_t *p, size_t size) {
+		FILE *f = fopen(idxFilename.c_str(), "wb");
+		ASSERT_NE(nullptr, f);
+		ASSERT_EQ(size, fwrite(p, 1, size, f));
+		fclose(f);
+	};
+	auto checkRejected = [](const char *desc) {
+		unique_ptr<GzIndex> gz = openGz();
+		ASSERT_NE(nullptr, gz);
+		EXPECT_LT(gz->loadIndexFromCache(gzFilename.c_str()), 0) << desc;
+		EXPECT_EQ(0U, gz->pointCount()) << desc;
+		ASSERT_NO_FATAL_FAILURE(checkRandomReads(gz.get(), 5, 16)) << desc;
+	};
+
+	// Truncated index.
+	ASSERT_NO_FATAL_FAILURE(writeIndex(idxData.data(), idxData.size() / 2));
+	ASSERT_NO_FATAL_FAILURE(checkRejected("truncated"));
+	ASSERT_NO_FATAL_FAILURE(writeIndex(idxData.data(), idxData.size() - 1));
+	ASSERT_NO_FATAL_FAILURE(checkRejected("missing CRC32"));
+
+	// Corrupted header.
+	vector<uint8_t> bad = idxData;
+	bad[0] ^= 0xFF;
+	ASSERT_NO_FATAL_FAILURE(writeIndex(bad.data(), bad.size()));
+	ASSERT_NO_FATAL_FAILURE(checkRejected("bad magic"));
+
+	// Corrupted window data. (Detected by the CRC32.)
+	bad = idxData;
+	bad[bad.size() / 2] ^= 0x55;
+	ASSERT_NO_FATAL_FAILURE(writeIndex(bad.data(), bad.size()));
+	ASSERT_NO_FATAL_FAILURE(checkRejected("bad window data"));
+
+	// The original index should still load.
+	ASSERT_NO_FATAL_FAILURE(writeIndex(idxData.data(), idxData.size()));
+	unique_ptr<GzIndex> gz = openGz();
+	ASSERT_NE(nullptr, gz);
+	EXPECT_EQ(0, gz->loadIndexFromCache(gzFilename.c_str()));
+}
+#endif /* !_WIN32 */
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRpFile test suite: GzIndex tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
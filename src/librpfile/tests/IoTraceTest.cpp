@@ -0,0 +1,272 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile/tests)                  *
+ * IoTraceTest.cpp: IoTrace and TracingFile test.                          *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// librpfile
+#include "librpfile/IoTrace.hpp"
+#include "librpfile/MemFile.hpp"
+#include "librpfile/SubFile.hpp"
+#include "librpfile/TracingFile.hpp"
+
+// C includes (C++ namespace)
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <memory>
+#include <string>
+#include <vector>
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace LibRpFile { namespace Tests {
+
+class IoTraceTest : public ::testing::Test
+{
+	protected:
+		IoTraceTest() = default;
+
+	public:
+		static constexpr size_t FILE_SIZE = 1000;
+
+		void SetUp(void) final
+		{
+			data.resize(FILE_SIZE);
+			for (size_t i = 0; i < data.size(); i++) {
+				data[i] = static_cast<uint8_t>(i * 7);
+			}
+			m_baseFile = std::make_shared<MemFile>(data.data(), data.size());
+			m_trace = std::make_shared<IoTrace>();
+		}
+
+		void TearDown(void) final
+		{
+			IoTrace::setActive(nullptr);
+		}
+
+		/**
+		 * Check an event.
+		 * @param event Event
+		 * @param op Expected operation
+		 * @param tag Expected tag (display name)
+		 * @param pos Expected position
+		 * @param size Expected requested size
+		 * @param ret Expected bytes returned
+		 */
+		static void checkEvent(const IoTrace::Event &event, IoTrace::Op op,
+			const char *tag, off64_t pos, size_t size, size_t ret)
+		{
+			EXPECT_EQ(op, event.op);
+			EXPECT_EQ(tag, IoTrace::tagName(event.tag));
+			EXPECT_EQ(pos, event.pos);
+			EXPECT_EQ(size, event.size);
+			EXPECT_EQ(ret, event.ret);
+		}
+
+	public:
+		vector<uint8_t> data;
+		shared_ptr<MemFile> m_baseFile;
+		shared_ptr<IoTrace> m_trace;
+};
+
+/**
+ * TracingFile records each access, tagged with the underlying file's class.
+ * Sequential reads use the tracked file position.
+ */
+TEST_F(IoTraceTest, tracingFileEvents)
+{
+	TracingFile file(m_baseFile, m_trace);
+	ASSERT_TRUE(file.isOpen());
+	EXPECT_EQ(static_cast<off64_t>(FILE_SIZE), file.size());
+
+	uint8_t buf[64];
+	ASSERT_EQ(0, file.seek(100));
+	ASSERT_EQ(50U, file.read(buf, 50));
+	EXPECT_EQ(0, memcmp(&data[100], buf, 50));
+	ASSERT_EQ(10U, file.read(buf, 10));
+	ASSERT_EQ(10U, file.readAt(500, buf, 10));
+	EXPECT_EQ(0, memcmp(&data[500], buf, 10));
+	const uint8_t *const p = file.peek(4, 4);
+	ASSERT_NE(nullptr, p);
+	EXPECT_EQ(0, memcmp(&data[4], p, 4));
+
+	// Short read at EOF
+	ASSERT_EQ(0, file.seek(FILE_SIZE - 8));
+	EXPECT_EQ(8U, file.read(buf, sizeof(buf)));
+
+	const vector<IoTrace::Event> events = m_trace->events();
+	ASSERT_EQ(7U, events.size());
+	checkEvent(events[0], IoTrace::Op::Seek,	"MemFile", 100, 0, 0);
+	checkEvent(events[1], IoTrace::Op::Read,	"MemFile", 100, 50, 50);
+	checkEvent(events[2], IoTrace::Op::Read,	"MemFile", 150, 10, 10);
+	checkEvent(events[3], IoTrace::Op::ReadAt,	"MemFile", 500, 10, 10);
+	checkEvent(events[4], IoTrace::Op::Peek,	"MemFile", 4, 4, 4);
+	checkEvent(events[5], IoTrace::Op::Seek,	"MemFile", FILE_SIZE - 8, 0, 0);
+	checkEvent(events[6], IoTrace::Op::Read,	"MemFile", FILE_SIZE - 8, sizeof(buf), 8);
+
+	for (size_t i = 1; i < events.size(); i++) {
+		EXPECT_LE(events[i-1].start_ns, events[i].start_ns);
+	}
+
+	m_trace->clear();
+	EXPECT_TRUE(m_trace->events().empty());
+}
+
+/**
+ * Child readers record to the active trace, if one is set.
+ */
+TEST_F(IoTraceTest, activeTrace)
+{
+	SubFile subFile(m_baseFile, 200, 300);
+	uint8_t buf[16];
+
+	// No active trace.
+	ASSERT_EQ(sizeof(buf), subFile.readAt(10, buf, sizeof(buf)));
+	EXPECT_TRUE(m_trace->events().empty());
+
+	IoTrace::setActive(m_trace.get());
+	EXPECT_EQ(m_trace.get(), IoTrace::active());
+	ASSERT_EQ(sizeof(buf), subFile.readAt(10, buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(&data[210], buf, sizeof(buf)));
+	ASSERT_EQ(0, subFile.seek(0));
+	ASSERT_EQ(sizeof(buf), subFile.read(buf, sizeof(buf)));
+
+	// Size is constrained to the end of the SubFile.
+	EXPECT_EQ(4U, subFile.readAt(296, buf, sizeof(buf)));
+
+	{
+		static constexpr char tag[] = "ScopeTest";
+		IoTrace::Scope scope(IoTrace::Op::ReadAt, tag, 1234, 100);
+		scope.ret(80);
+	}
+
+	const vector<IoTrace::Event> events = m_trace->events();
+	ASSERT_EQ(4U, events.size());
+	checkEvent(events[0], IoTrace::Op::ReadAt,	"SubFile", 10, sizeof(buf), sizeof(buf));
+	checkEvent(events[1], IoTrace::Op::Read,	"SubFile", -1, sizeof(buf), sizeof(buf));
+	checkEvent(events[2], IoTrace::Op::ReadAt,	"SubFile", 296, 4, 4);
+	checkEvent(events[3], IoTrace::Op::ReadAt,	"ScopeTest", 1234, 100, 80);
+
+	// Deleting the active trace deactivates it.
+	IoTrace *const trace = new IoTrace();
+	IoTrace::setActive(trace);
+	delete trace;
+	EXPECT_EQ(nullptr, IoTrace::active());
+}
+
+/**
+ * summarize() groups events by display name, in order of first access.
+ */
+TEST_F(IoTraceTest, summarize)
+{
+	// Different raw tags with the same display name are merged,
+	// but each raw tag has its own position for the seek distance.
+	static constexpr char tagA[] = "Alpha";
+	static constexpr char tagA2[] = "Test::Alpha";
+	static constexpr char tagB[] = "Beta";
+
+	// Start times are set explicitly to fix the event order.
+	m_trace->record(IoTrace::Op::ReadAt,	tagB,  0,   16,  16,  0);
+	m_trace->record(IoTrace::Op::ReadAt,	tagA,  0,   100, 100, 1);
+	m_trace->record(IoTrace::Op::ReadAt,	tagA,  300, 50,  50,  2);	// seek distance 200
+	m_trace->record(IoTrace::Op::Seek,	tagA2, 100, 0,   0,   3);	// seek distance 100
+	m_trace->record(IoTrace::Op::Read,	tagA2, -1,  10,  10,  4);	// sequential
+	m_trace->record(IoTrace::Op::Peek,	tagA,  120, 8,   0,   5);	// seek distance 230
+	m_trace->record(IoTrace::Op::ReadAt,	tagB,  100, 16,  8,   6);	// seek distance 84
+
+	const vector<IoTrace::Summary> summaries = m_trace->summarize();
+	ASSERT_EQ(2U, summaries.size());
+
+	const IoTrace::Summary &b = summaries[0];
+	EXPECT_EQ("Beta", b.tag);
+	EXPECT_EQ(2U, b.reads);
+	EXPECT_EQ(0U, b.seeks);
+	EXPECT_EQ(32U, b.bytesRequested);
+	EXPECT_EQ(24U, b.bytesRead);
+	EXPECT_EQ(84U, b.seekDistance);
+	EXPECT_GT(b.latency_ns, 0U);
+
+	const IoTrace::Summary &a = summaries[1];
+	EXPECT_EQ("Alpha", a.tag);
+	EXPECT_EQ(4U, a.reads);
+	EXPECT_EQ(1U, a.seeks);
+	EXPECT_EQ(168U, a.bytesRequested);
+	EXPECT_EQ(160U, a.bytesRead);
+	EXPECT_EQ(530U, a.seekDistance);
+}
+
+/**
+ * Read size histogram buckets.
+ */
+TEST_F(IoTraceTest, histogram)
+{
+	static constexpr char tag[] = "Histogram";
+	struct BucketTest {
+		size_t size;
+		unsigned int bucket;
+	};
+	static const BucketTest tests[] = {
+		{0, 0},
+		{1, 1},
+		{2, 2}, {3, 2},
+		{4, 3},
+		{1023, 10},
+		{1024, 11},
+		{(1U << 22) - 1, 22},
+		{1U << 22, IoTrace::HISTOGRAM_BUCKETS - 1},
+		{1U << 30, IoTrace::HISTOGRAM_BUCKETS - 1},
+	};
+
+	std::array<uint64_t, IoTrace::HISTOGRAM_BUCKETS> expected;
+	expected.fill(0);
+	uint64_t start_ns = 0;
+	for (const BucketTest &test : tests) {
+		m_trace->record(IoTrace::Op::ReadAt, tag, 0, test.size, test.size, start_ns++);
+		expected[test.bucket]++;
+	}
+
+	// Seeks aren't counted.
+	m_trace->record(IoTrace::Op::Seek, tag, 0, 0, 0, start_ns++);
+
+	const vector<IoTrace::Summary> summaries = m_trace->summarize();
+	ASSERT_EQ(1U, summaries.size());
+	EXPECT_EQ(ARRAY_SIZE(tests), summaries[0].reads);
+	for (unsigned int i = 0; i < IoTrace::HISTOGRAM_BUCKETS; i++) {
+		EXPECT_EQ(expected[i], summaries[0].histogram[i]) << "bucket " << i;
+	}
+}
+
+/**
+ * Operation names
+ */
+TEST_F(IoTraceTest, opName)
+{
+	EXPECT_STREQ("read", IoTrace::opName(IoTrace::Op::Read));
+	EXPECT_STREQ("readAt", IoTrace::opName(IoTrace::Op::ReadAt));
+	EXPECT_STREQ("peek", IoTrace::opName(IoTrace::Op::Peek));
+	EXPECT_STREQ("seek", IoTrace::opName(IoTrace::Op::Seek));
+}
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRpFile test suite: IoTrace tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
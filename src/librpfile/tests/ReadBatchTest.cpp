@@ -0,0 +1,181 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile/tests)                  *
+ * ReadBatchTest.cpp: ReadBatch class test.                                *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// librpfile
+#include "librpfile/MemFile.hpp"
+#include "librpfile/ReadBatch.hpp"
+#include "librpfile/RpFile.hpp"
+using LibRpFile::IRpFilePtr;
+using LibRpFile::MemFile;
+using LibRpFile::ReadBatch;
+using LibRpFile::RpFile;
+
+// C includes
+#ifdef _WIN32
+#  include <process.h>
+#  define getpid() _getpid()
+#else /* !_WIN32 */
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+// C includes (C++ namespace)
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <memory>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+namespace LibRpFile { namespace Tests {
+
+class ReadBatchTest : public ::testing::Test
+{
+	protected:
+		ReadBatchTest() = default;
+
+	public:
+		static constexpr size_t FILE_COUNT = 3;
+		static constexpr size_t FILE_SIZE = 256 * 1024;
+
+		static void SetUpTestSuite(void);
+
+	public:
+		static vector<uint8_t> data[FILE_COUNT];	// File contents
+		static string filenames[FILE_COUNT];		// Temporary files
+};
+
+vector<uint8_t> ReadBatchTest::data[FILE_COUNT];
+string ReadBatchTest::filenames[FILE_COUNT];
+
+void ReadBatchTest::SetUpTestSuite(void)
+{
+	string tmpDir = ::testing::TempDir();
+	if (!tmpDir.empty() && tmpDir.back() != '/' && tmpDir.back() != '\\') {
+		tmpDir += '/';
+	}
+
+	uint32_t state = 0x5678;
+	for (size_t i = 0; i < FILE_COUNT; i++) {
+		// Each file is a different size.
+		data[i].resize(FILE_SIZE - (i * 4099));
+		for (uint8_t &p : data[i]) {
+			state = (state * 1103515245U) + 12345U;
+			p = static_cast<uint8_t>(state >> 16);
+		}
+
+		char buf[64];
+		snprintf(buf, sizeof(buf), "ReadBatchTest.%u.%u.bin",
+			static_cast<unsigned int>(getpid()), static_cast<unsigned int>(i));
+		filenames[i] = tmpDir + buf;
+		FILE *f = fopen(filenames[i].c_str(), "wb");
+		ASSERT_NE(nullptr, f);
+		ASSERT_EQ(data[i].size(), fwrite(data[i].data(), 1, data[i].size(), f));
+		fclose(f);
+	}
+}
+
+/**
+ * Many reads across multiple files.
+ * The queue depth is smaller than the number of reads,
+ * so the reads are submitted in several rounds.
+ */
+TEST_F(ReadBatchTest, manyReads)
+{
+	IRpFilePtr files[FILE_COUNT];
+	for (size_t i = 0; i < FILE_COUNT; i++) {
+		files[i] = std::make_shared<RpFile>(filenames[i].c_str(), RpFile::FM_OPEN_READ);
+		ASSERT_TRUE(files[i]->isOpen());
+	}
+
+	static constexpr size_t READ_COUNT = 50;
+	static constexpr size_t READ_SIZE = 3000;
+	ReadBatch batch(4);
+	vector<uint8_t> buf(READ_COUNT * READ_SIZE);
+	for (size_t i = 0; i < READ_COUNT; i++) {
+		const size_t fileIdx = i % FILE_COUNT;
+		const off64_t pos = static_cast<off64_t>((i * 4567) % (data[fileIdx].size() - READ_SIZE));
+		EXPECT_EQ(i, batch.add(files[fileIdx], pos, &buf[i * READ_SIZE], READ_SIZE));
+	}
+	EXPECT_EQ(READ_COUNT, batch.count());
+	EXPECT_EQ(READ_COUNT, batch.submit());
+	printf("io_uring was %sused.\n", batch.isUsingIoUring() ? "" : "not ");
+
+	for (size_t i = 0; i < READ_COUNT; i++) {
+		const size_t fileIdx = i % FILE_COUNT;
+		const size_t pos = (i * 4567) % (data[fileIdx].size() - READ_SIZE);
+		EXPECT_EQ(READ_SIZE, batch.result(i));
+		EXPECT_EQ(0, memcmp(&data[fileIdx][pos], &buf[i * READ_SIZE], READ_SIZE)) << "read " << i;
+	}
+
+	// Clear the batch and reuse it.
+	batch.clear();
+	EXPECT_EQ(0U, batch.count());
+	EXPECT_EQ(0U, batch.submit());
+}
+
+/**
+ * Short reads at EOF, and reads past EOF.
+ */
+TEST_F(ReadBatchTest, shortReads)
+{
+	const IRpFilePtr file = std::make_shared<RpFile>(filenames[0].c_str(), RpFile::FM_OPEN_READ);
+	ASSERT_TRUE(file->isOpen());
+
+	uint8_t buf1[1024], buf2[1024];
+	ReadBatch batch;
+	const size_t idx1 = batch.add(file, static_cast<off64_t>(data[0].size() - 100), buf1, sizeof(buf1));
+	const size_t idx2 = batch.add(file, static_cast<off64_t>(data[0].size() + 100), buf2, sizeof(buf2));
+	EXPECT_EQ(0U, batch.submit());
+
+	EXPECT_EQ(100U, batch.result(idx1));
+	EXPECT_EQ(0, memcmp(&data[0][data[0].size() - 100], buf1, 100));
+	EXPECT_EQ(0U, batch.result(idx2));
+}
+
+/**
+ * Files that can't be read directly use the fallback path.
+ */
+TEST_F(ReadBatchTest, fallback)
+{
+	const IRpFilePtr rpFile = std::make_shared<RpFile>(filenames[1].c_str(), RpFile::FM_OPEN_READ);
+	ASSERT_TRUE(rpFile->isOpen());
+	const IRpFilePtr memFile = std::make_shared<MemFile>(data[2].data(), data[2].size());
+
+	uint8_t buf1[4096], buf2[4096];
+	ReadBatch batch;
+	const size_t idx1 = batch.add(rpFile, 12345, buf1, sizeof(buf1));
+	const size_t idx2 = batch.add(memFile, 23456, buf2, sizeof(buf2));
+	EXPECT_EQ(2U, batch.submit());
+
+	EXPECT_EQ(sizeof(buf1), batch.result(idx1));
+	EXPECT_EQ(0, memcmp(&data[1][12345], buf1, sizeof(buf1)));
+	EXPECT_EQ(sizeof(buf2), batch.result(idx2));
+	EXPECT_EQ(0, memcmp(&data[2][23456], buf2, sizeof(buf2)));
+}
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRpFile test suite: ReadBatch tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,492 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile/tests)                  *
+ * RecursiveScanTest.cpp: recursiveScan() test.                            *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// librpfile
+#include "librpfile/RecursiveScan.hpp"
+using LibRpFile::RecursiveScanEntry;
+using LibRpFile::RecursiveScanTotals;
+
+// d_type compatibility values
+#include "d_type.h"
+
+// C includes
+#include <sys/stat.h>
+#ifdef _WIN32
+#  include <direct.h>
+#  include <process.h>
+#  define getpid() _getpid()
+#else /* !_WIN32 */
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+// C includes (C++ namespace)
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <forward_list>
+#include <string>
+#include <utility>
+#include <vector>
+using std::forward_list;
+using std::pair;
+using std::string;
+using std::tstring;
+using std::vector;
+
+namespace LibRpFile { namespace Tests {
+
+#ifdef _WIN32
+#  define DIR_SEP_CHR _T('\\')
+#else /* !_WIN32 */
+#  define DIR_SEP_CHR _T('/')
+#endif /* _WIN32 */
+
+struct ScanEntry {
+	tstring path;
+	off64_t size;
+	uint8_t d_type;
+};
+
+class RecursiveScanTest : public ::testing::Test
+{
+	protected:
+		RecursiveScanTest() = default;
+
+	public:
+		void SetUp(void) final;
+		void TearDown(void) final;
+
+		/**
+		 * Create a directory.
+		 * @param path Directory path, relative to m_root
+		 */
+		void createDir(const TCHAR *path);
+
+		/**
+		 * Create a file.
+		 * @param path File path, relative to m_root
+		 * @param size File size
+		 */
+		void createFile(const TCHAR *path, size_t size);
+
+		/**
+		 * Create the default cache-like directory tree.
+		 * - 5 files, totalling 1010 bytes
+		 * - 3 subdirectories, including one empty subdirectory
+		 */
+		void createCacheTree(void);
+
+		/**
+		 * recursiveScan() callback: Add the entry to a vector<ScanEntry>.
+		 * @param entry Entry
+		 * @param userdata vector<ScanEntry>
+		 * @return 0 to continue scanning.
+		 */
+		static int addEntry(const RecursiveScanEntry *entry, void *userdata);
+
+		/**
+		 * recursiveScan() callback: Delete a file or directory.
+		 * @param entry Entry
+		 * @param userdata Unused
+		 * @return 0 to continue scanning; negative POSIX error code on error.
+		 */
+		static int deleteEntry(const RecursiveScanEntry *entry, void *userdata);
+
+	public:
+		tstring m_root;		// Root of the test directory tree
+};
+
+void RecursiveScanTest::SetUp(void)
+{
+	static unsigned int counter = 0;
+
+	const string tmpDir = ::testing::TempDir();
+	m_root.assign(tmpDir.begin(), tmpDir.end());
+	if (!m_root.empty() && m_root.back() != _T('/') && m_root.back() != _T('\\')) {
+		m_root += DIR_SEP_CHR;
+	}
+
+	char buf[64];
+	snprintf(buf, sizeof(buf), "RecursiveScanTest.%u.%u",
+		static_cast<unsigned int>(getpid()), counter++);
+	m_root.append(buf, buf + strlen(buf));
+	ASSERT_NO_FATAL_FAILURE(createDir(nullptr));
+}
+
+void RecursiveScanTest::TearDown(void)
+{
+	// Remove everything that's left.
+	recursiveScan(m_root.c_str(), 0, deleteEntry, nullptr);
+#ifdef _WIN32
+	_trmdir(m_root.c_str());
+#else /* !_WIN32 */
+	rmdir(m_root.c_str());
+#endif /* _WIN32 */
+}
+
+/**
+ * Create a directory.
+ * @param path Directory path, relative to m_root
+ */
+void RecursiveScanTest::createDir(const TCHAR *path)
+{
+	tstring fullPath = m_root;
+	if (path) {
+		fullPath += DIR_SEP_CHR;
+		fullPath += path;
+	}
+#ifdef _WIN32
+	ASSERT_EQ(0, _tmkdir(fullPath.c_str()));
+#else /* !_WIN32 */
+	ASSERT_EQ(0, mkdir(fullPath.c_str(), 0700));
+#endif /* _WIN32 */
+}
+
+/**
+ * Create a file.
+ * @param path File path, relative to m_root
+ * @param size File size
+ */
+void RecursiveScanTest::createFile(const TCHAR *path, size_t size)
+{
+	tstring fullPath = m_root;
+	fullPath += DIR_SEP_CHR;
+	fullPath += path;
+
+	FILE *f = _tfopen(fullPath.c_str(), _T("wb"));
+	ASSERT_NE(nullptr, f);
+	const vector<uint8_t> data(size, 0x55);
+	ASSERT_EQ(size, fwrite(data.data(), 1, data.size(), f));
+	fclose(f);
+}
+
+/**
+ * Create the default cache-like directory tree.
+ * - 5 files, totalling 1010 bytes
+ * - 3 subdirectories, including one empty subdirectory
+ */
+void RecursiveScanTest::createCacheTree(void)
+{
+	ASSERT_NO_FATAL_FAILURE(createFile(_T("a.png"), 100));
+	ASSERT_NO_FATAL_FAILURE(createFile(_T("version.txt"), 10));
+	ASSERT_NO_FATAL_FAILURE(createDir(_T("sub1")));
+	ASSERT_NO_FATAL_FAILURE(createFile(_T("sub1/b.jpg"), 200));
+	ASSERT_NO_FATAL_FAILURE(createFile(_T("sub1/c.png"), 300));
+	ASSERT_NO_FATAL_FAILURE(createDir(_T("sub1/sub2")));
+	ASSERT_NO_FATAL_FAILURE(createFile(_T("sub1/sub2/d.jxl"), 400));
+	ASSERT_NO_FATAL_FAILURE(createDir(_T("sub3")));
+}
+
+/**
+ * recursiveScan() callback: Add the entry to a vector<ScanEntry>.
+ * @param entry Entry
+ * @param userdata vector<ScanEntry>
+ * @return 0 to continue scanning.
+ */
+int RecursiveScanTest::addEntry(const RecursiveScanEntry *entry, void *userdata)
+{
+	vector<ScanEntry> *const pEntries = static_cast<vector<ScanEntry>*>(userdata);
+	pEntries->push_back({entry->path, entry->size, entry->d_type});
+	return 0;
+}
+
+/**
+ * recursiveScan() callback: Delete a file or directory.
+ * @param entry Entry
+ * @param userdata Unused
+ * @return 0 to continue scanning; negative POSIX error code on error.
+ */
+int RecursiveScanTest::deleteEntry(const RecursiveScanEntry *entry, void *userdata)
+{
+	RP_UNUSED(userdata);
+#ifdef _WIN32
+	const int ret = (entry->d_type == DT_DIR) ? _trmdir(entry->path) : _tremove(entry->path);
+#else /* !_WIN32 */
+	const int ret = (entry->d_type == DT_DIR) ? rmdir(entry->path) : unlink(entry->path);
+#endif /* _WIN32 */
+	return (ret == 0 ? 0 : -errno);
+}
+
+/**
+ * Totals only. (no callback)
+ */
+TEST_F(RecursiveScanTest, totals)
+{
+	ASSERT_NO_FATAL_FAILURE(createCacheTree());
+
+	RecursiveScanTotals totals;
+	ASSERT_EQ(0, recursiveScanTotals(m_root.c_str(), &totals));
+	EXPECT_EQ(5U, totals.files);
+	EXPECT_EQ(3U, totals.dirs);
+	EXPECT_EQ(1010U, totals.bytes);
+
+	// RSF_NO_STAT may skip the file sizes, but the counts must still be correct.
+	ASSERT_EQ(0, recursiveScanTotals(m_root.c_str(), &totals, LibRpFile::RSF_NO_STAT));
+	EXPECT_EQ(5U, totals.files);
+	EXPECT_EQ(3U, totals.dirs);
+}
+
+/**
+ * An empty directory has no entries.
+ */
+TEST_F(RecursiveScanTest, emptyDir)
+{
+	vector<ScanEntry> entries;
+	RecursiveScanTotals totals;
+	ASSERT_EQ(0, recursiveScan(m_root.c_str(), 0, addEntry, &entries, &totals));
+	EXPECT_TRUE(entries.empty());
+	EXPECT_EQ(0U, totals.files);
+	EXPECT_EQ(0U, totals.dirs);
+	EXPECT_EQ(0U, totals.bytes);
+}
+
+/**
+ * A directory that doesn't exist is an error.
+ */
+TEST_F(RecursiveScanTest, notFound)
+{
+	const tstring path = m_root + DIR_SEP_CHR + _T("nonexistent");
+	RecursiveScanTotals totals;
+	EXPECT_LT(recursiveScanTotals(path.c_str(), &totals), 0);
+	EXPECT_EQ(0U, totals.files);
+	EXPECT_EQ(0U, totals.dirs);
+}
+
+/**
+ * Callback entries: Each subdirectory is reported after its contents,
+ * and the directory being scanned is not reported.
+ */
+TEST_F(RecursiveScanTest, callbackOrder)
+{
+	ASSERT_NO_FATAL_FAILURE(createCacheTree());
+
+	vector<ScanEntry> entries;
+	RecursiveScanTotals totals;
+	ASSERT_EQ(0, recursiveScan(m_root.c_str(), 0, addEntry, &entries, &totals));
+	ASSERT_EQ(8U, entries.size());
+	EXPECT_EQ(5U, totals.files);
+	EXPECT_EQ(3U, totals.dirs);
+	EXPECT_EQ(1010U, totals.bytes);
+
+	unsigned int dirs = 0;
+	off64_t bytes = 0;
+	for (size_t i = 0; i < entries.size(); i++) {
+		const ScanEntry &entry = entries[i];
+
+		// All entries must be below the root directory.
+		ASSERT_GT(entry.path.size(), m_root.size() + 1);
+		EXPECT_EQ(0, entry.path.compare(0, m_root.size(), m_root));
+
+		if (entry.d_type != DT_DIR) {
+			bytes += entry.size;
+			continue;
+		}
+		dirs++;
+		EXPECT_EQ(0, entry.size);
+
+		// Nothing inside this directory may be reported after it.
+		const tstring prefix = entry.path + DIR_SEP_CHR;
+		for (size_t j = i + 1; j < entries.size(); j++) {
+			EXPECT_NE(0, entries[j].path.compare(0, prefix.size(), prefix))
+				<< "entry " << j << " was reported after its parent directory";
+		}
+	}
+	EXPECT_EQ(3U, dirs);
+	EXPECT_EQ(1010, bytes);
+}
+
+/**
+ * RSF_CHECK_CACHE_FILES fails if an unexpected file is found.
+ */
+TEST_F(RecursiveScanTest, checkCacheFiles)
+{
+	ASSERT_NO_FATAL_FAILURE(createCacheTree());
+	RecursiveScanTotals totals;
+	EXPECT_EQ(0, recursiveScanTotals(m_root.c_str(), &totals, LibRpFile::RSF_CHECK_CACHE_FILES));
+
+	// Add an unexpected file.
+	ASSERT_NO_FATAL_FAILURE(createFile(_T("sub1/sub2/notes.doc"), 16));
+	EXPECT_EQ(-EIO, recursiveScanTotals(m_root.c_str(), &totals, LibRpFile::RSF_CHECK_CACHE_FILES));
+
+	// Without RSF_CHECK_CACHE_FILES, the file is counted normally.
+	ASSERT_EQ(0, recursiveScanTotals(m_root.c_str(), &totals));
+	EXPECT_EQ(6U, totals.files);
+	EXPECT_EQ(1026U, totals.bytes);
+}
+
+/**
+ * The list-based wrapper returns entries in deletion order,
+ * and fails if an unexpected file is found.
+ */
+TEST_F(RecursiveScanTest, listWrapper)
+{
+	ASSERT_NO_FATAL_FAILURE(createCacheTree());
+
+	forward_list<pair<tstring, uint8_t> > rlist;
+	ASSERT_EQ(0, recursiveScan(m_root.c_str(), rlist));
+
+	vector<pair<tstring, uint8_t> > entries(rlist.begin(), rlist.end());
+	ASSERT_EQ(8U, entries.size());
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].second != DT_DIR)
+			continue;
+		const tstring prefix = entries[i].first + DIR_SEP_CHR;
+		for (size_t j = i + 1; j < entries.size(); j++) {
+			EXPECT_NE(0, entries[j].first.compare(0, prefix.size(), prefix))
+				<< "entry " << j << " was listed after its parent directory";
+		}
+	}
+
+	ASSERT_NO_FATAL_FAILURE(createFile(_T("sub3/notes.doc"), 16));
+	rlist.clear();
+	EXPECT_NE(0, recursiveScan(m_root.c_str(), rlist));
+}
+
+/**
+ * A non-zero return value from the callback stops the scan.
+ */
+TEST_F(RecursiveScanTest, stopScan)
+{
+	ASSERT_NO_FATAL_FAILURE(createCacheTree());
+
+	unsigned int count = 0;
+	const int ret = recursiveScan(m_root.c_str(), 0,
+		[](const RecursiveScanEntry *entry, void *userdata) -> int {
+			RP_UNUSED(entry);
+			unsigned int *const pCount = static_cast<unsigned int*>(userdata);
+			return (++(*pCount) == 2) ? 1234 : 0;
+		}, &count);
+	EXPECT_EQ(1234, ret);
+	EXPECT_EQ(2U, count);
+}
+
+/**
+ * The callback can delete entries as they're reported.
+ */
+TEST_F(RecursiveScanTest, deleteFromCallback)
+{
+	ASSERT_NO_FATAL_FAILURE(createCacheTree());
+
+	RecursiveScanTotals totals;
+	ASSERT_EQ(0, recursiveScan(m_root.c_str(), LibRpFile::RSF_NO_STAT, deleteEntry, nullptr, &totals));
+	EXPECT_EQ(5U, totals.files);
+	EXPECT_EQ(3U, totals.dirs);
+
+	// Everything should be gone.
+	ASSERT_EQ(0, recursiveScanTotals(m_root.c_str(), &totals));
+	EXPECT_EQ(0U, totals.files);
+	EXPECT_EQ(0U, totals.dirs);
+	EXPECT_EQ(0U, totals.bytes);
+}
+
+/**
+ * An error in a subdirectory stops the entire scan.
+ */
+TEST_F(RecursiveScanTest, subdirError)
+{
+	ASSERT_NO_FATAL_FAILURE(createCacheTree());
+	ASSERT_NO_FATAL_FAILURE(createFile(_T("sub1/sub2/notes.doc"), 16));
+
+	// The error is returned, and directories containing the
+	// unexpected file are never passed to the callback.
+	vector<ScanEntry> entries;
+	EXPECT_EQ(-EIO, recursiveScan(m_root.c_str(), LibRpFile::RSF_CHECK_CACHE_FILES, addEntry, &entries));
+	for (const ScanEntry &entry : entries) {
+		if (entry.d_type != DT_DIR)
+			continue;
+		const tstring subdir = entry.path.substr(m_root.size() + 1);
+		EXPECT_NE(_T("sub1"), subdir);
+		EXPECT_NE(tstring(_T("sub1")) + DIR_SEP_CHR + _T("sub2"), subdir);
+	}
+
+#ifndef _WIN32
+	// A subdirectory that can't be opened is also an error.
+	// NOTE: root can open the directory anyway.
+	if (geteuid() != 0) {
+		ASSERT_EQ(0, unlink((m_root + _T("/sub1/sub2/notes.doc")).c_str()));
+		const tstring sub3 = m_root + _T("/sub3");
+		ASSERT_EQ(0, chmod(sub3.c_str(), 0));
+		RecursiveScanTotals totals;
+		EXPECT_EQ(-EACCES, recursiveScanTotals(m_root.c_str(), &totals));
+		ASSERT_EQ(0, chmod(sub3.c_str(), 0700));
+	}
+#endif /* !_WIN32 */
+}
+
+#ifndef _WIN32
+/**
+ * Symbolic links are reported as DT_LNK and are not followed.
+ */
+TEST_F(RecursiveScanTest, symlinks)
+{
+	ASSERT_NO_FATAL_FAILURE(createCacheTree());
+
+	// Directory outside of the scanned directory.
+	const tstring extDir = m_root + _T(".ext");
+	const tstring extFile = extDir + _T("/e.png");
+	ASSERT_EQ(0, mkdir(extDir.c_str(), 0700));
+	FILE *f = fopen(extFile.c_str(), "wb");
+	ASSERT_NE(nullptr, f);
+	fclose(f);
+
+	ASSERT_EQ(0, symlink(extDir.c_str(), (m_root + _T("/ext.png")).c_str()));
+	ASSERT_EQ(0, symlink(_T("sub1"), (m_root + _T("/sub1link.png")).c_str()));
+	ASSERT_EQ(0, symlink(_T("a.png"), (m_root + _T("/alink.png")).c_str()));
+	ASSERT_EQ(0, symlink(_T("nonexistent"), (m_root + _T("/dangling.png")).c_str()));
+
+	static const unsigned int flags_tbl[] = {0, LibRpFile::RSF_NO_STAT};
+	for (unsigned int flags : flags_tbl) {
+		vector<ScanEntry> entries;
+		RecursiveScanTotals totals;
+		ASSERT_EQ(0, recursiveScan(m_root.c_str(), flags | LibRpFile::RSF_CHECK_CACHE_FILES,
+			addEntry, &entries, &totals));
+		EXPECT_EQ(12U, entries.size());
+		EXPECT_EQ(9U, totals.files);
+		EXPECT_EQ(3U, totals.dirs);
+
+		unsigned int links = 0;
+		for (const ScanEntry &entry : entries) {
+			// The symlinked directories must not be scanned.
+			EXPECT_EQ(tstring::npos, entry.path.find(_T("ext.png/")));
+			EXPECT_EQ(tstring::npos, entry.path.find(_T("sub1link.png/")));
+			if (entry.d_type == DT_LNK) {
+				links++;
+			}
+		}
+		EXPECT_EQ(4U, links);
+	}
+
+	// Deleting everything only deletes the symlinks, not their targets.
+	ASSERT_EQ(0, recursiveScan(m_root.c_str(), 0, deleteEntry, nullptr));
+	EXPECT_EQ(0, access(extFile.c_str(), F_OK));
+
+	EXPECT_EQ(0, unlink(extFile.c_str()));
+	EXPECT_EQ(0, rmdir(extDir.c_str()));
+}
+#endif /* !_WIN32 */
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRpFile test suite: RecursiveScan tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
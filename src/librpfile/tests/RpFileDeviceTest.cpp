@@ -0,0 +1,250 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile/tests)                  *
+ * RpFileDeviceTest.cpp: RpFile device sector cache test.                  *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// librpfile
+#include "librpfile/RpFile.hpp"
+#include "librpfile/RpFile_p.hpp"
+
+// C includes
+#ifdef _WIN32
+#  include <process.h>
+#  define getpid() _getpid()
+#else /* !_WIN32 */
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+// C includes (C++ namespace)
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <memory>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+namespace LibRpFile { namespace Tests {
+
+/**
+ * The device is emulated by attaching a DeviceInfo to a regular file.
+ * Since the file isn't a Kreon drive, readLBAs() uses the OS API,
+ * and a read past the end of the file fails like an unreadable sector.
+ */
+class RpFileDeviceTest : public ::testing::Test
+{
+	protected:
+		RpFileDeviceTest() = default;
+
+	public:
+		static constexpr uint32_t SECTOR_SIZE = 2048;
+		static constexpr unsigned int SECTOR_COUNT = 16;
+		static constexpr size_t FILE_SIZE = SECTOR_SIZE * SECTOR_COUNT;
+
+		static void SetUpTestSuite(void);
+		static void TearDownTestSuite(void);
+
+		void SetUp(void) final
+		{
+			m_file = std::make_shared<RpFile>(filename.c_str(), RpFile::FM_OPEN_READ);
+			ASSERT_TRUE(m_file->isOpen());
+		}
+
+		/**
+		 * Treat the file as a device.
+		 * @param sectors Number of sectors reported by the device
+		 */
+		void attachDevice(unsigned int sectors)
+		{
+			RpFilePrivate *const d = m_file->d_ptr;
+			d->devInfo.reset(new RpFilePrivate::DeviceInfo());
+			d->devInfo->device_size = static_cast<off64_t>(sectors) * SECTOR_SIZE;
+			d->devInfo->sector_size = SECTOR_SIZE;
+		}
+
+		/**
+		 * Read data from the device and compare it to the file contents.
+		 * @param pos Position
+		 * @param size Size
+		 */
+		void checkRead(off64_t pos, size_t size)
+		{
+			vector<uint8_t> buf(size);
+			ASSERT_EQ(0, m_file->seek(pos));
+			ASSERT_EQ(size, m_file->read(buf.data(), size));
+			EXPECT_EQ(0, memcmp(&data[static_cast<size_t>(pos)], buf.data(), size));
+		}
+
+		/**
+		 * Check the device read statistics.
+		 * @param commands Expected number of read commands
+		 * @param bytes Expected number of bytes transferred
+		 * @param hits Expected number of cache hits
+		 * @param misses Expected number of cache misses
+		 */
+		void checkStats(uint64_t commands, uint64_t bytes, uint64_t hits, uint64_t misses)
+		{
+			RpFile::DeviceStats stats;
+			ASSERT_EQ(0, m_file->getDeviceStats(&stats));
+			EXPECT_EQ(commands, stats.commands);
+			EXPECT_EQ(bytes, stats.bytes);
+			EXPECT_EQ(hits, stats.hits);
+			EXPECT_EQ(misses, stats.misses);
+		}
+
+	public:
+		static vector<uint8_t> data;	// File contents
+		static string filename;		// Temporary file
+
+		std::shared_ptr<RpFile> m_file;
+};
+
+vector<uint8_t> RpFileDeviceTest::data;
+string RpFileDeviceTest::filename;
+
+void RpFileDeviceTest::SetUpTestSuite(void)
+{
+	data.resize(FILE_SIZE);
+	uint32_t state = 0x1357;
+	for (uint8_t &p : data) {
+		state = (state * 1103515245U) + 12345U;
+		p = static_cast<uint8_t>(state >> 16);
+	}
+
+	filename = ::testing::TempDir();
+	if (!filename.empty() && filename.back() != '/' && filename.back() != '\\') {
+		filename += '/';
+	}
+	char buf[64];
+	snprintf(buf, sizeof(buf), "RpFileDeviceTest.%u.bin", static_cast<unsigned int>(getpid()));
+	filename += buf;
+
+	FILE *f = fopen(filename.c_str(), "wb");
+	ASSERT_NE(nullptr, f);
+	ASSERT_EQ(data.size(), fwrite(data.data(), 1, data.size(), f));
+	fclose(f);
+}
+
+void RpFileDeviceTest::TearDownTestSuite(void)
+{
+	remove(filename.c_str());
+}
+
+/**
+ * Small reads load the read-ahead window into the sector cache.
+ * The window is truncated at the end of the device.
+ */
+TEST_F(RpFileDeviceTest, readAheadWindow)
+{
+	attachDevice(SECTOR_COUNT);
+	ASSERT_EQ(0, m_file->setDeviceReadAhead(4 * SECTOR_SIZE));
+	EXPECT_EQ(static_cast<off64_t>(FILE_SIZE), m_file->size());
+	checkStats(0, 0, 0, 0);
+
+	// Sectors 0-3 are loaded.
+	ASSERT_NO_FATAL_FAILURE(checkRead(100, 10));
+	checkStats(1, 4 * SECTOR_SIZE, 0, 1);
+
+	// Within the window: no device command.
+	ASSERT_NO_FATAL_FAILURE(checkRead(3 * SECTOR_SIZE + 5, 100));
+	checkStats(1, 4 * SECTOR_SIZE, 1, 1);
+
+	// Crossing the end of the window: the rest is loaded from sector 4.
+	ASSERT_NO_FATAL_FAILURE(checkRead(4 * SECTOR_SIZE - 50, 100));
+	checkStats(2, 8 * SECTOR_SIZE, 2, 2);
+
+	// Back to sector 0: the window was replaced.
+	ASSERT_NO_FATAL_FAILURE(checkRead(0, 16));
+	checkStats(3, 12 * SECTOR_SIZE, 2, 3);
+
+	// Only two sectors remain before the end of the device.
+	ASSERT_NO_FATAL_FAILURE(checkRead(14 * SECTOR_SIZE + 7, 10));
+	checkStats(4, 14 * SECTOR_SIZE, 2, 4);
+	ASSERT_NO_FATAL_FAILURE(checkRead(FILE_SIZE - 10, 10));
+	checkStats(4, 14 * SECTOR_SIZE, 3, 4);
+}
+
+/**
+ * Large aligned reads bypass the sector cache.
+ */
+TEST_F(RpFileDeviceTest, largeReadBypass)
+{
+	attachDevice(SECTOR_COUNT);
+	ASSERT_EQ(0, m_file->setDeviceReadAhead(4 * SECTOR_SIZE));
+
+	ASSERT_NO_FATAL_FAILURE(checkRead(8 * SECTOR_SIZE, 6 * SECTOR_SIZE));
+	checkStats(1, 6 * SECTOR_SIZE, 0, 0);
+
+	// The cache wasn't loaded.
+	ASSERT_NO_FATAL_FAILURE(checkRead(8 * SECTOR_SIZE + 1, 1));
+	checkStats(2, 10 * SECTOR_SIZE, 0, 1);
+
+	// Large aligned reads starting in the cached window use the cache first.
+	// The remaining 2 sectors are smaller than the window, so they're
+	// loaded into the cache as well.
+	ASSERT_NO_FATAL_FAILURE(checkRead(8 * SECTOR_SIZE, 6 * SECTOR_SIZE));
+	checkStats(3, 14 * SECTOR_SIZE, 1, 2);
+}
+
+/**
+ * If the read-ahead window can't be read, only the requested LBA is read.
+ */
+TEST_F(RpFileDeviceTest, readAheadRetry)
+{
+	// The device reports 4 more sectors than the file has,
+	// so reads past sector 15 fail.
+	attachDevice(SECTOR_COUNT + 4);
+	ASSERT_EQ(0, m_file->setDeviceReadAhead(8 * SECTOR_SIZE));
+
+	// Sectors 12-19 fail with a short read of 4 sectors.
+	// Sector 12 is read by itself.
+	ASSERT_NO_FATAL_FAILURE(checkRead(12 * SECTOR_SIZE + 1, 10));
+	checkStats(2, 5 * SECTOR_SIZE, 0, 1);
+
+	// Only sector 12 was cached.
+	ASSERT_NO_FATAL_FAILURE(checkRead(12 * SECTOR_SIZE + 100, 10));
+	checkStats(2, 5 * SECTOR_SIZE, 1, 1);
+	ASSERT_NO_FATAL_FAILURE(checkRead(13 * SECTOR_SIZE, 10));
+	checkStats(4, 9 * SECTOR_SIZE, 1, 2);
+
+	// Sectors before the unreadable area still use the full window.
+	ASSERT_NO_FATAL_FAILURE(checkRead(2 * SECTOR_SIZE, 10));
+	checkStats(5, 17 * SECTOR_SIZE, 1, 3);
+
+	// Sector 16 can't be read at all.
+	uint8_t buf[16];
+	ASSERT_EQ(0, m_file->seek(16 * SECTOR_SIZE));
+	EXPECT_EQ(0U, m_file->read(buf, sizeof(buf)));
+	EXPECT_NE(0, m_file->lastError());
+	checkStats(7, 17 * SECTOR_SIZE, 1, 4);
+
+	// A read that ends in the unreadable area is short.
+	vector<uint8_t> buf2(2 * SECTOR_SIZE);
+	ASSERT_EQ(0, m_file->seek(15 * SECTOR_SIZE));
+	EXPECT_EQ(SECTOR_SIZE, m_file->read(buf2.data(), 2 * SECTOR_SIZE));
+	EXPECT_EQ(0, memcmp(&data[15 * SECTOR_SIZE], buf2.data(), SECTOR_SIZE));
+}
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRpFile test suite: RpFile device sector cache tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
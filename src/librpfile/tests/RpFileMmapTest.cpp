@@ -0,0 +1,168 @@
+/***************************************************************************
+ * ROM Properties Page shell extension. (librpfile/tests)                  *
+ * RpFileMmapTest.cpp: RpFile memory-mapped file test.                     *
+ *                                                                         *
+ * Copyright (c) 2016-2024 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+#include "tcharx.h"
+
+// librpfile
+#include "librpfile/RpFile.hpp"
+using LibRpFile::RpFile;
+
+// C includes
+#ifdef _WIN32
+#  include <process.h>
+#  define getpid() _getpid()
+#else /* !_WIN32 */
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+// C includes (C++ namespace)
+#include <cstdio>
+#include <cstring>
+
+// C++ includes
+#include <memory>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+namespace LibRpFile { namespace Tests {
+
+class RpFileMmapTest : public ::testing::TestWithParam<RpFile::FileMode>
+{
+	protected:
+		RpFileMmapTest() = default;
+
+	public:
+		static constexpr size_t FILE_SIZE = 65536 + 123;
+
+		static void SetUpTestSuite(void);
+		static void TearDownTestSuite(void);
+
+		void SetUp(void) final
+		{
+			m_file = std::make_shared<RpFile>(filename.c_str(), GetParam());
+			ASSERT_TRUE(m_file->isOpen());
+		}
+
+	public:
+		static vector<uint8_t> data;	// File contents
+		static string filename;		// Temporary file
+
+		std::shared_ptr<RpFile> m_file;
+};
+
+vector<uint8_t> RpFileMmapTest::data;
+string RpFileMmapTest::filename;
+
+void RpFileMmapTest::SetUpTestSuite(void)
+{
+	data.resize(FILE_SIZE);
+	uint32_t state = 0x2468;
+	for (uint8_t &p : data) {
+		state = (state * 1103515245U) + 12345U;
+		p = static_cast<uint8_t>(state >> 16);
+	}
+
+	filename = ::testing::TempDir();
+	if (!filename.empty() && filename.back() != '/' && filename.back() != '\\') {
+		filename += '/';
+	}
+	char buf[64];
+	snprintf(buf, sizeof(buf), "RpFileMmapTest.%u.bin", static_cast<unsigned int>(getpid()));
+	filename += buf;
+
+	FILE *f = fopen(filename.c_str(), "wb");
+	ASSERT_NE(nullptr, f);
+	ASSERT_EQ(data.size(), fwrite(data.data(), 1, data.size(), f));
+	fclose(f);
+}
+
+void RpFileMmapTest::TearDownTestSuite(void)
+{
+	remove(filename.c_str());
+}
+
+/**
+ * Sequential reads, and a seek within the file.
+ */
+TEST_P(RpFileMmapTest, read)
+{
+	EXPECT_EQ(static_cast<off64_t>(FILE_SIZE), m_file->size());
+	EXPECT_EQ((GetParam() & RpFile::FM_MMAP) != 0, m_file->isPeekZeroCopy());
+
+	vector<uint8_t> buf(FILE_SIZE);
+	ASSERT_EQ(FILE_SIZE, m_file->read(buf.data(), buf.size()));
+	EXPECT_EQ(data, buf);
+	EXPECT_EQ(static_cast<off64_t>(FILE_SIZE), m_file->tell());
+
+	uint8_t small[100];
+	ASSERT_EQ(0, m_file->seek(12345));
+	ASSERT_EQ(sizeof(small), m_file->read(small, sizeof(small)));
+	EXPECT_EQ(0, memcmp(&data[12345], small, sizeof(small)));
+	EXPECT_EQ(12345 + static_cast<off64_t>(sizeof(small)), m_file->tell());
+}
+
+/**
+ * Seeking past EOF is allowed. Reads past EOF return 0 bytes.
+ * Negative seeks fail and don't change the position.
+ */
+TEST_P(RpFileMmapTest, seekPastEOF)
+{
+	uint8_t buf[16];
+	const off64_t pastEOF = static_cast<off64_t>(FILE_SIZE) + 1000;
+	ASSERT_EQ(0, m_file->seek(pastEOF));
+	EXPECT_EQ(pastEOF, m_file->tell());
+	EXPECT_EQ(0U, m_file->read(buf, sizeof(buf)));
+	EXPECT_EQ(pastEOF, m_file->tell());
+
+	ASSERT_EQ(0, m_file->seek(100));
+	EXPECT_EQ(-1, m_file->seek(-1));
+	EXPECT_EQ(100, m_file->tell());
+
+	// Short read at EOF.
+	ASSERT_EQ(0, m_file->seek(static_cast<off64_t>(FILE_SIZE) - 4));
+	EXPECT_EQ(4U, m_file->read(buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(&data[FILE_SIZE - 4], buf, 4));
+}
+
+/**
+ * peek() returns the file data, or nullptr if the range is out of bounds.
+ */
+TEST_P(RpFileMmapTest, peek)
+{
+	const uint8_t *const p = m_file->peek(1001, 200);
+	ASSERT_NE(nullptr, p);
+	EXPECT_EQ(0, memcmp(&data[1001], p, 200));
+
+	EXPECT_EQ(nullptr, m_file->peek(static_cast<off64_t>(FILE_SIZE) - 10, 20));
+	EXPECT_EQ(nullptr, m_file->peek(-1, 20));
+}
+
+INSTANTIATE_TEST_SUITE_P(RpFileMmapTest, RpFileMmapTest,
+	::testing::Values(RpFile::FM_OPEN_READ, RpFile::FM_MMAP),
+	[](const ::testing::TestParamInfo<RpFile::FileMode> &info) -> string {
+		return (info.param & RpFile::FM_MMAP) ? "mmap" : "stdio";
+	});
+
+} }
+
+/**
+ * Test suite main function.
+ */
+extern "C" int gtest_main(int argc, TCHAR *argv[])
+{
+	fputs("LibRpFile test suite: RpFile mmap tests.\n\n", stderr);
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -8,104 +8,103 @@
  ***************************************************************************/
 
 #include "stdafx.h"
-#include "RecursiveScan.hpp"
-#include "FileSystem.hpp"
+#include "../RecursiveScan_p.hpp"
+#include "../FileSystem.hpp"
 
 // d_type compatibility values
 #include "d_type.h"
 
+// libwin32common
+#include "libwin32common/RpWin32_sdk.h"
+#include "libwin32common/w32err.hpp"
+#include "libwin32common/w32time.h"
+
 // C++ STL classes
-using std::forward_list;
-using std::pair;
 using std::tstring;
 
-// RecursiveScan isn't used by libromdata directly,
-// so use some linker hax to force linkage.
-extern "C" {
-	extern unsigned char RP_LibRpFile_RecursiveScan_ForceLinkage;
-	unsigned char RP_LibRpFile_RecursiveScan_ForceLinkage;
-}
-
-namespace LibRpFile {
+namespace LibRpFile { namespace RecursiveScanPrivate {
 
 /**
- * Recursively scan a directory for cache files to delete.
- * This finds *.png, *.jpg, *.jxl, and "version.txt".
+ * Scan a single directory. (OS-specific)
+ *
+ * Files are passed to ctx.addFile(); subdirectories
+ * are passed to ctx.addDirectory().
  *
  * Win32 implementation: Uses FindFirstFile() and FindNextFile().
+ * These return the file size and access time, so no extra
+ * system calls are needed for each file.
  *
- * @param path	[in] Path to scan.
- * @param rlist	[in/out] Return list for filenames and file types. (d_type)
+ * @param ctx	[in] Scan context
+ * @param node	[in/out] Directory (atime is set here)
  * @return 0 on success; non-zero on error.
  */
-int recursiveScan(const TCHAR *path, forward_list<pair<tstring, uint8_t> > &rlist)
+int scanDirectory(ScanContext &ctx, DirNode *node)
 {
-	tstring findFilter(path);
-	findFilter += _T("\\*");
+	// Full path buffer: "path\\filename"
+	tstring fullpath(node->path);
+	fullpath += _T('\\');
+	const size_t pathlen = fullpath.size();
 
+	fullpath += _T('*');
 	WIN32_FIND_DATA findFileData;
-	HANDLE hFindFile = FindFirstFile(findFilter.c_str(), &findFileData);
+	HANDLE hFindFile = FindFirstFile(fullpath.c_str(), &findFileData);
 	if (!hFindFile || hFindFile == INVALID_HANDLE_VALUE) {
 		// Error finding files.
-		return -1;
+		const int err = w32err_to_posix(GetLastError());
+		return (err != 0 ? -err : -EIO);
 	}
 
+	int ret = 0;
 	do {
+		if (ctx.isStopped()) {
+			// Scan was stopped by another thread.
+			break;
+		}
+
 		// Skip "." and "..".
 		if (findFileData.cFileName[0] == _T('.') &&
 			(findFileData.cFileName[1] == _T('\0') ||
 			 (findFileData.cFileName[1] == _T('.') && findFileData.cFileName[2] == _T('\0'))))
 		{
+			// NOTE: The directory's own access time is only available here.
+			if (findFileData.cFileName[1] == _T('\0')) {
+				node->atime = FileTimeToUnixTime(&findFileData.ftLastAccessTime);
+			}
 			continue;
 		}
 
-		// Make sure we should delete this file.
-		if (!(findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-			// Thumbs.db files can be deleted.
-			if (!_tcsicmp(findFileData.cFileName, _T("Thumbs.db")))
-				goto isok;
+		fullpath.resize(pathlen);
+		fullpath += findFileData.cFileName;
 
-			// Check the extension.
-			size_t len = _tcslen(findFileData.cFileName);
-			if (len <= 4) {
-				// Filename is too short. This is bad.
-				FindClose(hFindFile);
-				return -EIO;
-			}
-
-			const TCHAR *pExt = &findFileData.cFileName[len-4];
-			if (_tcsicmp(pExt, _T(".png")) != 0 &&
-			    _tcsicmp(pExt, _T(".jpg")) != 0 &&
-			    _tcsicmp(pExt, _T(".jxl")) != 0 &&
-			    _tcsicmp(findFileData.cFileName, _T("version.txt")) != 0)
-			{
-				// Extension is not valid.
-				FindClose(hFindFile);
-				return -EIO;
-			}
-
-			// All checks pass.
+		const uint8_t d_type = FileSystem::win32_attrs_to_d_type(findFileData.dwFileAttributes);
+		if (d_type == DT_DIR) {
+			// Subdirectory. This will be scanned separately.
+			ctx.addDirectory(node, tstring(fullpath));
+			continue;
+		} else if (!ctx.isAllowedFile(findFileData.cFileName)) {
+			// Not a cache file.
+			ret = -EIO;
+			break;
 		}
 
-	isok:
-		tstring fullFileName(path);
-		fullFileName += _T('\\');
-		fullFileName += findFileData.cFileName;
-
-		// Add the filename and d_type.
-		rlist.emplace_front(fullFileName, FileSystem::win32_attrs_to_d_type(findFileData.dwFileAttributes));
-
-		// If this is a directory, recursively scan it.
-		// This is done *after* adding the directory because forward_list
-		// enumerates items in reverse order.
-		if (findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-			// Recursively scan it.
-			recursiveScan(fullFileName.c_str(), rlist);
+		// Convert the file size from two DWORDs to off64_t.
+		LARGE_INTEGER fileSize;
+		fileSize.LowPart = findFileData.nFileSizeLow;
+		fileSize.HighPart = findFileData.nFileSizeHigh;
+
+		RecursiveScanEntry entry;
+		entry.path = fullpath.c_str();
+		entry.size = fileSize.QuadPart;
+		entry.atime = FileTimeToUnixTime(&findFileData.ftLastAccessTime);
+		entry.d_type = d_type;
+		ret = ctx.addFile(entry);
+		if (ret != 0) {
+			break;
 		}
 	} while (FindNextFile(hFindFile, &findFileData));
 	FindClose(hFindFile);
 
-	return 0;
+	return ret;
 }
 
-}
+} }
@@ -31,6 +31,9 @@ using std::wstring;
 #ifdef _MSC_VER
 // MSVC: Exception handling for /DELAYLOAD.
 #include "libwin32common/DelayLoadHelper.h"
+
+// zlib
+#include <zlib.h>
 #endif /* _MSC_VER */
 
 #define ISDRIVELETTERA(x) ((x) >= 'A' && (x) <= 'Z')
@@ -52,7 +55,9 @@ DELAYLOAD_TEST_FUNCTION_IMPL0(get_crc_table);
 
 RpFilePrivate::RpFilePrivate(RpFile *q, const wchar_t *filenameW, RpFile::FileMode mode)
 	: q_ptr(q), file(INVALID_HANDLE_VALUE), filename(nullptr)
-	, mode(mode), gzfd(nullptr), gzsz(-1)
+	, mode(mode), gzIndex(nullptr), gzsz(-1)
+	, mmap_buf(nullptr), mmap_sz(0), mmap_pos(0)
+	, hMapping(nullptr)
 {
 	assert(filenameW != nullptr);
 	this->filenameW = wcsdup(filenameW);
@@ -60,9 +65,13 @@ RpFilePrivate::RpFilePrivate(RpFile *q, const wchar_t *filenameW, RpFile::FileMo
 
 RpFilePrivate::~RpFilePrivate()
 {
-	if (gzfd) {
-		gzclose_r(gzfd);
+	if (mmap_buf) {
+		UnmapViewOfFile(mmap_buf);
+	}
+	if (hMapping) {
+		CloseHandle(hMapping);
 	}
+	closeGzIndex();
 	if (file && file != INVALID_HANDLE_VALUE) {
 		CloseHandle(file);
 	}
@@ -112,7 +121,7 @@ inline int RpFilePrivate::mode_to_win32(RpFile::FileMode mode,
 /**
  * (Re-)Open the main file.
  *
- * INTERNAL FUNCTION. This does NOT affect gzfd.
+ * INTERNAL FUNCTION. This does NOT affect gzIndex.
  * NOTE: This function sets q->m_lastError.
  *
  * Uses parameters stored in this->filename and this->mode.
@@ -293,6 +302,103 @@ int RpFilePrivate::reOpenFile(void)
 	return (!file || file == INVALID_HANDLE_VALUE);
 }
 
+/**
+ * Memory-map the main file. (FM_MMAP)
+ *
+ * INTERNAL FUNCTION. This is only done for regular files
+ * opened as read-only without gzip decompression.
+ * If mapping fails, the file handle is used as usual.
+ *
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int RpFilePrivate::mapFile(void)
+{
+	assert(file != nullptr && file != INVALID_HANDLE_VALUE);
+	assert(mmap_buf == nullptr);
+	if (!file || file == INVALID_HANDLE_VALUE || mmap_buf) {
+		return -EBADF;
+	}
+
+	LARGE_INTEGER liFileSize;
+	if (!GetFileSizeEx(file, &liFileSize)) {
+		return -w32err_to_posix(GetLastError());
+	} else if (liFileSize.QuadPart <= 0) {
+		// Empty files can't be mapped.
+		return -ENOTSUP;
+	} else if (static_cast<uint64_t>(liFileSize.QuadPart) > std::numeric_limits<size_t>::max()) {
+		// File is too big to map on this system. (32-bit)
+		return -EFBIG;
+	}
+
+	hMapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!hMapping) {
+		return -w32err_to_posix(GetLastError());
+	}
+	const void *const p = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!p) {
+		const int err = w32err_to_posix(GetLastError());
+		CloseHandle(hMapping);
+		hMapping = nullptr;
+		return -err;
+	}
+
+	// Start at the file handle's current position.
+	LARGE_INTEGER liSeekPos, liSeekRet;
+	liSeekPos.QuadPart = 0;
+	if (!SetFilePointerEx(file, liSeekPos, &liSeekRet, FILE_CURRENT)) {
+		liSeekRet.QuadPart = 0;
+	}
+
+	mmap_buf = static_cast<const uint8_t*>(p);
+	mmap_sz = static_cast<size_t>(liFileSize.QuadPart);
+	mmap_pos = (liSeekRet.QuadPart > 0) ? liSeekRet.QuadPart : 0;
+	return 0;
+}
+
+/**
+ * Unmap the main file.
+ * The file handle's position is set to the mapping's position.
+ */
+void RpFilePrivate::unmapFile(void)
+{
+	if (!mmap_buf)
+		return;
+
+	UnmapViewOfFile(mmap_buf);
+	mmap_buf = nullptr;
+	if (hMapping) {
+		CloseHandle(hMapping);
+		hMapping = nullptr;
+	}
+	if (file && file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER liSeekPos;
+		liSeekPos.QuadPart = static_cast<LONGLONG>(mmap_pos);
+		SetFilePointerEx(file, liSeekPos, nullptr, FILE_BEGIN);
+	}
+	mmap_sz = 0;
+	mmap_pos = 0;
+}
+
+/**
+ * Close the gzip index. (FM_GZIP_DECOMPRESS)
+ *
+ * If FM_GZIP_INDEX_CACHE is set and new access points
+ * were added, the index is saved to the cache directory.
+ */
+void RpFilePrivate::closeGzIndex(void)
+{
+	if (!gzIndex)
+		return;
+
+	if ((mode & RpFile::FM_GZIP_INDEX_CACHE) && gzIndex->isIndexDirty()) {
+		// NOTE: Errors are ignored, since the index
+		// can be rebuilt the next time.
+		gzIndex->saveIndexToCache(W2U8(filenameW).c_str());
+	}
+	delete gzIndex;
+	gzIndex = nullptr;
+}
+
 /** RpFile **/
 
 /**
@@ -324,7 +430,7 @@ RpFile::RpFile(const wchar_t *filenameW, FileMode mode)
 	// Check if this is a gzipped file.
 	// If it is, use transparent decompression.
 	// Reference: https://www.forensicswiki.org/wiki/Gzip
-	const bool tryGzip = (!d->devInfo && d->mode == FM_OPEN_READ_GZ);
+	const bool tryGzip = (!d->devInfo && (d->mode & ~(FM_MMAP | FM_GZIP_INDEX_CACHE)) == FM_OPEN_READ_GZ);
 	if (tryGzip) { do {
 #if defined(_MSC_VER) && defined(ZLIB_IS_DLL)
 		// Delay load verification.
@@ -374,7 +480,7 @@ RpFile::RpFile(const wchar_t *filenameW, FileMode mode)
 		// NOTE: Not sure if this is needed on Windows.
 		FlushFileBuffers(d->file);
 
-		// Open the file with gzdopen().
+		// Open the file with GzIndex for random access.
 		HANDLE hGzDup;
 		bRet = DuplicateHandle(
 			GetCurrentProcess(),	// hSourceProcessHandle
@@ -391,13 +497,11 @@ RpFile::RpFile(const wchar_t *filenameW, FileMode mode)
 		// underlying Windows handle.
 		int gzfd_dup = _open_osfhandle((intptr_t)hGzDup, _O_RDONLY);
 		if (gzfd_dup >= 0) {
-			d->gzfd = gzdopen(gzfd_dup, "r");
-			if (d->gzfd) {
-				m_isCompressed = true;
-			} else {
-				// gzdopen() failed.
-				// Close the dup()'d handle to prevent a leak.
-				_close(gzfd_dup);
+			d->gzIndex = new GzIndex(gzfd_dup);
+			m_isCompressed = true;
+			if (d->mode & FM_GZIP_INDEX_CACHE) {
+				// Load the saved index, if available.
+				d->gzIndex->loadIndexFromCache(W2U8(d->filenameW).c_str());
 			}
 		} else {
 			// Unable to open an fd.
@@ -405,7 +509,7 @@ RpFile::RpFile(const wchar_t *filenameW, FileMode mode)
 		}
 	} while (0); }
 
-	if (tryGzip && !d->gzfd) {
+	if (tryGzip && !d->gzIndex) {
 		// Not a gzipped file.
 		// Rewind and flush the file.
 		LARGE_INTEGER liSeekPos;
@@ -414,6 +518,12 @@ RpFile::RpFile(const wchar_t *filenameW, FileMode mode)
 		// NOTE: Not sure if this is needed on Windows.
 		FlushFileBuffers(d->file);
 	}
+
+	if ((d->mode & FM_MMAP) && !(d->mode & FM_WRITE) && !d->gzIndex && !d->devInfo) {
+		// Memory-map the file.
+		// If this fails, the file handle will be used as usual.
+		d->mapFile();
+	}
 }
 
 /**
@@ -477,10 +587,8 @@ void RpFile::close(void)
 		d->devInfo->close();
 	}
 
-	if (d->gzfd) {
-		gzclose_r(d->gzfd);
-		d->gzfd = nullptr;
-	}
+	d->unmapFile();
+	d->closeGzIndex();
 	if (d->file && d->file != INVALID_HANDLE_VALUE) {
 		CloseHandle(d->file);
 		d->file = INVALID_HANDLE_VALUE;
@@ -509,15 +617,25 @@ size_t RpFile::read(void *ptr, size_t size)
 		return d->readUsingBlocks(ptr, size);
 	}
 
+	if (d->mmap_buf) {
+		// Memory-mapped file.
+		if (d->mmap_pos >= static_cast<off64_t>(d->mmap_sz)) {
+			// End of file.
+			return 0;
+		}
+		const size_t mmap_pos = static_cast<size_t>(d->mmap_pos);
+		size = std::min(size, d->mmap_sz - mmap_pos);
+		memcpy(ptr, &d->mmap_buf[mmap_pos], size);
+		d->mmap_pos += size;
+		return size;
+	}
+
 	DWORD bytesRead;
-	if (d->gzfd) {
-		int iret = gzread(d->gzfd, ptr, (unsigned int)size);
-		if (iret >= 0) {
-			bytesRead = (DWORD)iret;
-		} else {
+	if (d->gzIndex) {
+		bytesRead = static_cast<DWORD>(d->gzIndex->read(ptr, size));
+		if (bytesRead != size && d->gzIndex->lastError() != 0) {
 			// An error occurred.
-			bytesRead = 0;
-			m_lastError = errno;
+			m_lastError = d->gzIndex->lastError();
 		}
 	} else {
 		BOOL bRet = ReadFile(d->file, ptr, static_cast<DWORD>(size), &bytesRead, nullptr);
@@ -591,18 +709,24 @@ int RpFile::seek(off64_t pos)
 		return 0;
 	}
 
+	if (d->mmap_buf) {
+		// Memory-mapped file.
+		// NOTE: Seeking past EOF is allowed, same as SetFilePointerEx().
+		if (pos < 0) {
+			m_lastError = EINVAL;
+			return -1;
+		}
+		d->mmap_pos = pos;
+		return 0;
+	}
+
 	int ret;
-	if (d->gzfd) {
-		// FIXME: Might not work with >2GB files...
-		z_off_t zret = gzseek(d->gzfd, (long)pos, SEEK_SET);
-		if (zret >= 0) {
-			ret = 0;
-		} else {
+	if (d->gzIndex) {
+		// NOTE: Decompression is deferred until the next read().
+		ret = d->gzIndex->seek(pos);
+		if (ret != 0) {
+			m_lastError = -ret;
 			ret = -1;
-			m_lastError = -errno;
-			if (m_lastError == 0) {
-				m_lastError = -EIO;
-			}
 		}
 	} else {
 		LARGE_INTEGER liSeekPos;
@@ -638,8 +762,10 @@ off64_t RpFile::tell(void)
 		return d->devInfo->device_pos;
 	}
 
-	if (d->gzfd) {
-		return (off64_t)gztell(d->gzfd);
+	if (d->mmap_buf) {
+		return d->mmap_pos;
+	} else if (d->gzIndex) {
+		return d->gzIndex->tell();
 	}
 
 	LARGE_INTEGER liSeekPos, liSeekRet;
@@ -748,7 +874,10 @@ off64_t RpFile::size(void)
 	if (d->devInfo) {
 		// Block device. Use the cached device size.
 		return d->devInfo->device_size;
-	} else if (d->gzfd) {
+	} else if (d->mmap_buf) {
+		// Memory-mapped file. Use the mapping size.
+		return static_cast<off64_t>(d->mmap_sz);
+	} else if (d->gzIndex) {
 		// gzipped files have the uncompressed size stored
 		// at the end of the stream.
 		return d->gzsz;
@@ -794,6 +923,127 @@ const wchar_t *RpFile::filenameW(void) const
 	return (d->filenameW != nullptr && d->filenameW[0] != L'\0') ? d->filenameW : nullptr;
 }
 
+/** Zero-copy access **/
+
+/**
+ * Does peek() return a pointer into the file data itself?
+ * This is only true if the file was memory-mapped. (FM_MMAP)
+ * @return True if peek() is zero-copy; false if not.
+ */
+bool RpFile::isPeekZeroCopy(void) const
+{
+	RP_D(const RpFile);
+	return (d->mmap_buf != nullptr);
+}
+
+/**
+ * Get a read-only pointer to the data at the specified position.
+ *
+ * If the file is memory-mapped, the pointer refers to the mapping,
+ * and the file position is not changed. Otherwise, this falls back
+ * to IRpFile's emulated peek().
+ *
+ * @param pos	[in] Start position.
+ * @param size	[in] Amount of data to access, in bytes.
+ * @return Pointer to the data, or nullptr if the full range isn't available.
+ */
+const uint8_t *RpFile::peek(off64_t pos, size_t size)
+{
+	RP_D(RpFile);
+	if (!d->mmap_buf) {
+		// Not memory-mapped.
+		return super::peek(pos, size);
+	}
+
+	// NOTE: Need to use a signed comparison here.
+	if (pos < 0 || size == 0 ||
+	    pos > static_cast<off64_t>(d->mmap_sz) - static_cast<off64_t>(size))
+	{
+		// Out of range.
+		return nullptr;
+	}
+
+	return &d->mmap_buf[static_cast<size_t>(pos)];
+}
+
+/** Positional I/O **/
+
+/**
+ * Read data from the file at the specified position.
+ * The file position is not changed.
+ *
+ * Memory-mapped files are read directly from the mapping,
+ * and gzipped files are read using the gzip index.
+ * Other files fall back to IRpFile's emulated readAt(),
+ * since ReadFile() with an OVERLAPPED offset still updates
+ * the file pointer for synchronous handles.
+ *
+ * @param pos	[in] Start position.
+ * @param ptr	[out] Output data buffer.
+ * @param size	[in] Amount of data to read, in bytes.
+ * @return Number of bytes read.
+ */
+size_t RpFile::readAt(off64_t pos, void *ptr, size_t size)
+{
+	RP_D(RpFile);
+	if (d->gzIndex) {
+		// gzipped file. GzIndex restarts decompression
+		// at the nearest access point.
+		const size_t ret = d->gzIndex->readAt(pos, ptr, size);
+		if (ret != size && d->gzIndex->lastError() != 0) {
+			m_lastError = d->gzIndex->lastError();
+		}
+		return ret;
+	} else if (!d->mmap_buf) {
+		// Not memory-mapped.
+		return super::readAt(pos, ptr, size);
+	} else if (pos < 0) {
+		m_lastError = EINVAL;
+		return 0;
+	} else if (pos >= static_cast<off64_t>(d->mmap_sz)) {
+		return 0;
+	}
+
+	size = std::min(size, d->mmap_sz - static_cast<size_t>(pos));
+	memcpy(ptr, &d->mmap_buf[static_cast<size_t>(pos)], size);
+	return size;
+}
+
+/**
+ * Read a contiguous range of the file into multiple buffers.
+ * The file position is not changed.
+ * @param pos	[in] Start position.
+ * @param iov	[in] Array of buffer descriptors.
+ * @param iovcnt	[in] Number of buffer descriptors.
+ * @return Total number of bytes read.
+ */
+size_t RpFile::readAtV(off64_t pos, const IoVec *iov, unsigned int iovcnt)
+{
+	// No native vectored positional read on Windows.
+	return super::readAtV(pos, iov, iovcnt);
+}
+
+/** Access pattern hints **/
+
+/**
+ * Tell the OS how a range of the file will be accessed.
+ *
+ * Windows doesn't have a per-range equivalent of posix_fadvise()
+ * for file handles, so this isn't supported.
+ *
+ * @param pos	[in] Start position.
+ * @param size	[in] Size of the range, in bytes. (0 for "until EOF")
+ * @param hint	[in] Access hint.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int RpFile::advise(off64_t pos, off64_t size, AccessHint hint)
+{
+	RP_UNUSED(pos);
+	RP_UNUSED(size);
+	RP_UNUSED(hint);
+	return -ENOTSUP;
+}
+
 /** Extra functions **/
 
 /**
@@ -811,6 +1061,8 @@ int RpFile::makeWritable(void)
 	}
 
 	RP_D(RpFile);
+	// The mapping is read-only, so switch back to the file handle.
+	d->unmapFile();
 	const off64_t prev_pos = this->tell();
 	// Set file mode to FM_WRITE and reopen it.
 	d->mode = (RpFile::FileMode)(d->mode | FM_WRITE);
@@ -93,6 +93,10 @@ int rp_stub_do_security_options(bool config)
 		SCMP_SYS(futex), SCMP_SYS(futex_time64),	// pthread_once()
 		SCMP_SYS(getuid), SCMP_SYS(geteuid),		// TODO: Only use geteuid()?
 		SCMP_SYS(lseek), SCMP_SYS(_llseek),
+		SCMP_SYS(preadv),	// IRpFile::readAtV()
+		SCMP_SYS(fadvise64), SCMP_SYS(fadvise64_64),	// IRpFile::advise()
+		SCMP_SYS(arm_fadvise64_64),	// CPU-specific syscall for Linux on 32-bit ARM
+		SCMP_SYS(madvise),	// IRpFile::advise() [memory-mapped files]
 		SCMP_SYS(lstat), SCMP_SYS(lstat64),		// realpath() [LibRpBase::FileSystem::resolve_symlink()]
 		SCMP_SYS(readlink),	// realpath() [LibRpBase::FileSystem::resolve_symlink()]
 
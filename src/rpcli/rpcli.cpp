@@ -34,8 +34,10 @@ using namespace LibRpText;
 
 // librpfile
 #include "librpfile/config.librpfile.h"
+#include "librpfile/BufferedFile.hpp"
 #include "librpfile/FileSystem.hpp"
 #include "librpfile/RpFile.hpp"
+#include "librpfile/TracingFile.hpp"
 using namespace LibRpFile;
 
 // libromdata
@@ -66,6 +68,13 @@ using namespace LibRpTexture;
 #endif
 #include "tcharx.h"
 
+// C includes (C++ namespace)
+#include <cinttypes>	// for PRIu64
+#include <csignal>	// for SIGINT (cancelling ROM operations)
+
+// C++ includes
+#include <unordered_map>
+
 // C++ STL classes
 using std::cout;
 using std::cerr;
@@ -74,6 +83,7 @@ using std::ofstream;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::unordered_map;
 using std::vector;
 
 #include "libi18n/config.libi18n.h"
@@ -221,18 +231,293 @@ static void ExtractImages(const RomData *romData, const vector<ExtractParam> &ex
 	}
 }
 
+// Set by the SIGINT handler to cancel a running ROM operation.
+static volatile sig_atomic_t romOpCancelled = 0;
+
+/**
+ * SIGINT handler used while a ROM operation is running.
+ * @param sig Signal number
+ */
+static void RomOpSigintHandler(int sig)
+{
+	RP_UNUSED(sig);
+	romOpCancelled = 1;
+}
+
+/**
+ * ROM operation progress callback.
+ * @param done		[in] Amount of work done
+ * @param total		[in] Total amount of work
+ * @param userdata	[in] Last percentage printed (int*)
+ * @return 0 to continue; non-zero to cancel the operation.
+ */
+static int RomOpProgress(uint64_t done, uint64_t total, void *userdata)
+{
+	int *const pLastPct = static_cast<int*>(userdata);
+	const int pct = (total > 0) ? static_cast<int>((done * 100) / total) : 100;
+	if (pct != *pLastPct) {
+		*pLastPct = pct;
+		fprintf(stderr, "\r   %3d%%", pct);
+		fflush(stderr);
+	}
+	return romOpCancelled;
+}
+
+/**
+ * Run ROM operations.
+ * @param romData RomData object
+ * @param romOps ROM operation IDs
+ * @return 0 if all ROM operations succeeded; non-zero if any of them failed.
+ */
+static int RunRomOps(RomData *romData, const vector<int> &romOps)
+{
+	int ret = 0;
+	const vector<RomData::RomOp> ops = romData->romOps();
+	for (const int id : romOps) {
+		if (id < 0 || id >= static_cast<int>(ops.size()) ||
+		    !(ops[id].flags & RomData::RomOp::ROF_ENABLED) ||
+		    (ops[id].flags & RomData::RomOp::ROF_SAVE_FILE))
+		{
+			cerr << "-- " << rp_sprintf(C_("rpcli", "ROM operation %d is not available"), id) << '\n';
+			if (!ops.empty()) {
+				cerr << "   " << C_("rpcli", "Available ROM operations:") << '\n';
+				for (size_t i = 0; i < ops.size(); i++) {
+					string desc = ops[i].desc;
+					desc.erase(std::remove(desc.begin(), desc.end(), '&'), desc.end());
+					cerr << "   " << i << ": " << desc;
+					if (!(ops[i].flags & RomData::RomOp::ROF_ENABLED)) {
+						cerr << ' ' << C_("rpcli", "(disabled)");
+					} else if (ops[i].flags & RomData::RomOp::ROF_SAVE_FILE) {
+						cerr << ' ' << C_("rpcli", "(requires a save file; not supported by rpcli)");
+					}
+					cerr << '\n';
+				}
+			}
+			cerr.flush();
+			ret = 1;
+			continue;
+		}
+
+		// Remove mnemonics from the description.
+		string desc = ops[id].desc;
+		desc.erase(std::remove(desc.begin(), desc.end(), '&'), desc.end());
+		cerr << "-- " << rp_sprintf(C_("rpcli", "Running ROM operation %d: %s"), id, desc.c_str()) << '\n';
+		cerr.flush();
+
+		// Ctrl-C cancels the ROM operation.
+		int lastPct = -1;
+		RomData::RomOpParams params;
+		params.progress = RomOpProgress;
+		params.progress_userdata = &lastPct;
+		romOpCancelled = 0;
+		void (*const oldHandler)(int) = signal(SIGINT, RomOpSigintHandler);
+		romData->doRomOp(id, &params);
+		signal(SIGINT, oldHandler);
+		if (lastPct >= 0) {
+			fputc('\n', stderr);
+		}
+
+		if (!params.msg.empty()) {
+			cerr << params.msg << '\n';
+		}
+		cerr.flush();
+		if (params.status != 0) {
+			ret = 1;
+		}
+	}
+	return ret;
+}
+
+/**
+ * Print an I/O trace summary.
+ * @param trace I/O trace
+ */
+static void PrintIoTraceSummary(const IoTrace &trace)
+{
+	const vector<IoTrace::Summary> summaries = trace.summarize();
+	fputs("-- ", stderr);
+	fputs(C_("rpcli", "I/O trace summary:"), stderr);
+	fputc('\n', stderr);
+	if (summaries.empty()) {
+		fputs("   ", stderr);
+		fputs(C_("rpcli", "No I/O was recorded."), stderr);
+		fputc('\n', stderr);
+		fflush(stderr);
+		return;
+	}
+
+	for (const IoTrace::Summary &summary : summaries) {
+		fprintf(stderr, "   %s: ", summary.tag.c_str());
+		fprintf(stderr, C_("rpcli", "%" PRIu64 " reads, %" PRIu64 " seeks, %" PRIu64 " bytes read (%" PRIu64 " requested), "
+			"seek distance %" PRIu64 ", %.3f ms"),
+			summary.reads, summary.seeks, summary.bytesRead, summary.bytesRequested,
+			summary.seekDistance, static_cast<double>(summary.latency_ns) / 1000000.0);
+		fputc('\n', stderr);
+
+		// Read size histogram
+		for (unsigned int i = 0; i < IoTrace::HISTOGRAM_BUCKETS; i++) {
+			if (summary.histogram[i] == 0)
+				continue;
+
+			if (i == 0) {
+				fputs("     0: ", stderr);
+			} else if (i == IoTrace::HISTOGRAM_BUCKETS-1) {
+				fprintf(stderr, "     >=%" PRIu64 ": ", UINT64_C(1) << (i-1));
+			} else {
+				fprintf(stderr, "     %" PRIu64 "-%" PRIu64 ": ", UINT64_C(1) << (i-1), (UINT64_C(1) << i) - 1);
+			}
+			fprintf(stderr, "%" PRIu64 "\n", summary.histogram[i]);
+		}
+	}
+	fflush(stderr);
+}
+
+/**
+ * Escape a string for JSON output.
+ * @param str UTF-8 string
+ * @return Escaped string, including the quotes
+ */
+static string JSONEscape(const char *str)
+{
+	string ret;
+	ret.reserve(strlen(str) + 2);
+	ret += '"';
+	for (; *str != '\0'; str++) {
+		const unsigned char chr = static_cast<unsigned char>(*str);
+		switch (chr) {
+			case '"':
+				ret += "\\\"";
+				break;
+			case '\\':
+				ret += "\\\\";
+				break;
+			case '\n':
+				ret += "\\n";
+				break;
+			case '\r':
+				ret += "\\r";
+				break;
+			case '\t':
+				ret += "\\t";
+				break;
+			default:
+				if (chr < 0x20) {
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04X", chr);
+					ret += buf;
+				} else {
+					ret += static_cast<char>(chr);
+				}
+				break;
+		}
+	}
+	ret += '"';
+	return ret;
+}
+
+/**
+ * Append an I/O trace to a JSON array of traced files.
+ * @param out		[in,out] JSON output
+ * @param trace		[in] I/O trace
+ * @param filename	[in] Traced filename
+ */
+static void AppendIoTraceJSON(string &out, const IoTrace &trace, const TCHAR *filename)
+{
+	if (!out.empty()) {
+		out += ',';
+	}
+	// FIXME: Make T2U8c() unnecessary here.
+	out += "\n{\"filename\":";
+	out += JSONEscape(T2U8c(filename));
+
+	out += ",\n\"summary\":[";
+	bool first = true;
+	for (const IoTrace::Summary &summary : trace.summarize()) {
+		out += (first ? "\n{\"tag\":" : ",\n{\"tag\":");
+		out += JSONEscape(summary.tag.c_str());
+		out += rp_sprintf(",\"reads\":%" PRIu64 ",\"seeks\":%" PRIu64
+			",\"bytesRequested\":%" PRIu64 ",\"bytesRead\":%" PRIu64
+			",\"seekDistance\":%" PRIu64 ",\"latency_ns\":%" PRIu64 ",\"histogram\":[",
+			summary.reads, summary.seeks, summary.bytesRequested, summary.bytesRead,
+			summary.seekDistance, summary.latency_ns);
+		for (unsigned int i = 0; i < IoTrace::HISTOGRAM_BUCKETS; i++) {
+			out += rp_sprintf("%s%" PRIu64, (i == 0 ? "" : ","), summary.histogram[i]);
+		}
+		out += "]}";
+		first = false;
+	}
+
+	out += "],\n\"events\":[";
+	first = true;
+	unordered_map<const char*, string> tagNames;
+	for (const IoTrace::Event &event : trace.events()) {
+		auto iter = tagNames.find(event.tag);
+		if (iter == tagNames.end()) {
+			iter = tagNames.emplace(event.tag, JSONEscape(IoTrace::tagName(event.tag).c_str())).first;
+		}
+		out += rp_sprintf("%s\n{\"start_ns\":%" PRIu64 ",\"latency_ns\":%" PRIu64
+			",\"tag\":%s,\"op\":\"%s\",\"pos\":%" PRId64 ",\"size\":%" PRIu64 ",\"ret\":%" PRIu64 "}",
+			(first ? "" : ","), event.start_ns, event.latency_ns,
+			iter->second.c_str(), IoTrace::opName(event.op), static_cast<int64_t>(event.pos),
+			static_cast<uint64_t>(event.size), static_cast<uint64_t>(event.ret));
+		first = false;
+	}
+	out += "]}";
+}
+
+/**
+ * Write the I/O traces of all files as JSON.
+ * @param files		[in] JSON array of traced files, from AppendIoTraceJSON()
+ * @param filename	[in] Output filename
+ */
+static void WriteIoTraceJSON(const string &files, const TCHAR *filename)
+{
+	FILE *f = _tfopen(filename, _T("w"));
+	if (!f) {
+		fputs("-- ", stderr);
+		// FIXME: Make T2U8c() unnecessary here.
+		fprintf(stderr, C_("rpcli", "Couldn't write I/O trace to '%s': %s"), T2U8c(filename), strerror(errno));
+		fputc('\n', stderr);
+		fflush(stderr);
+		return;
+	}
+
+	fputs("{\"files\":[", f);
+	fwrite(files.data(), 1, files.size(), f);
+	fputs("]}\n", f);
+	fclose(f);
+}
+
 /**
  * Shows info about file
  * @param filename ROM filename
  * @param json Is program running in json mode?
  * @param extract Vector of image extraction parameters
+ * @param romOps Vector of ROM operation IDs to run
  * @param lc Language code (0 for default)
  * @param flags ROMOutput flags (see OutputFlags)
+ * @param useMmap If true, memory-map the file for zero-copy access.
+ * @param buffered If true, use a BufferedFile and print cache statistics.
+ * @param trace If true, trace all I/O and print a summary.
+ * @param pTraceJSON If not nullptr, append the full I/O trace to this JSON array.
+ * @return 0 on success; non-zero if a ROM operation failed.
  */
-static void DoFile(const TCHAR *filename, bool json, const vector<ExtractParam> &extract,
-	uint32_t lc = 0, unsigned int flags = 0)
+static int DoFile(const TCHAR *filename, bool json, const vector<ExtractParam> &extract,
+	const vector<int> &romOps, uint32_t lc = 0, unsigned int flags = 0, bool useMmap = false,
+	bool buffered = false, bool trace = false, string *pTraceJSON = nullptr)
 {
+	int ret = 0;
 	RomDataPtr romData;
+	BufferedFilePtr bufFile;
+	shared_ptr<RpFile> devFile;
+
+	// I/O trace
+	// NOTE: Child readers record to the active trace.
+	shared_ptr<IoTrace> ioTrace;
+	if (trace || pTraceJSON) {
+		ioTrace = std::make_shared<IoTrace>();
+		IoTrace::setActive(ioTrace.get());
+	}
 
 	if (likely(!FileSystem::is_directory(filename))) {
 		// File: Open the file and call RomDataFactory::create() with the opened file.
@@ -243,7 +528,10 @@ static void DoFile(const TCHAR *filename, bool json, const vector<ExtractParam>
 		fputc('\n', stderr);
 		fflush(stderr);
 
-		shared_ptr<RpFile> file = std::make_shared<RpFile>(filename, RpFile::FM_OPEN_READ_GZ);
+		// NOTE: Memory-mapping is opt-in, since the process crashes
+		// if the file is truncated by another process while it's mapped.
+		shared_ptr<RpFile> file = std::make_shared<RpFile>(filename, static_cast<RpFile::FileMode>(
+			((useMmap && !buffered) ? RpFile::FM_OPEN_READ_GZ_MMAP : RpFile::FM_OPEN_READ_GZ) | RpFile::FM_GZIP_INDEX_CACHE));
 		if (!file->isOpen()) {
 			// TODO: Return an error code?
 			fputs("-- ", stderr);
@@ -254,10 +542,25 @@ static void DoFile(const TCHAR *filename, bool json, const vector<ExtractParam>
 				printf("{\"error\":\"couldn't open file\",\"code\":%d}\n", file->lastError());
 				fflush(stdout);
 			}
-			return;
+			return 0;
 		}
 
-		romData = RomDataFactory::create(file);
+		if (file->isDevice()) {
+			// Keep a reference to print the device read statistics.
+			devFile = file;
+		}
+
+		IRpFilePtr srcFile = file;
+		if (ioTrace) {
+			srcFile = std::make_shared<TracingFile>(file, ioTrace);
+		}
+
+		if (buffered) {
+			bufFile = std::make_shared<BufferedFile>(srcFile);
+			romData = RomDataFactory::create(bufFile);
+		} else {
+			romData = RomDataFactory::create(srcFile);
+		}
 	} else {
 		// Directory: Call RomDataFactory::create() with the filename.
 
@@ -283,6 +586,9 @@ static void DoFile(const TCHAR *filename, bool json, const vector<ExtractParam>
 		}
 		cout.flush();
 		ExtractImages(romData.get(), extract);
+		if (!romOps.empty()) {
+			ret = RunRomOps(romData.get(), romOps);
+		}
 	} else {
 		fputs("-- ", stderr);
 		fputs(C_("rpcli", "ROM is not supported"), stderr);
@@ -294,6 +600,42 @@ static void DoFile(const TCHAR *filename, bool json, const vector<ExtractParam>
 			fflush(stdout);
 		}
 	}
+
+	if (bufFile) {
+		// Print the BufferedFile cache statistics.
+		const BufferedFile::Stats stats = bufFile->stats();
+		fputs("-- ", stderr);
+		fprintf(stderr, C_("rpcli", "BufferedFile: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " bypassed reads"),
+			stats.hits, stats.misses, stats.bypass);
+		fputc('\n', stderr);
+		fputs("-- ", stderr);
+		fprintf(stderr, C_("rpcli", "Underlying file: %" PRIu64 " reads, %" PRIu64 " bytes"),
+			stats.baseReads, stats.baseBytes);
+		fputc('\n', stderr);
+		fflush(stderr);
+	}
+
+	if (devFile) {
+		// Print the device read statistics.
+		RpFile::DeviceStats stats;
+		if (devFile->getDeviceStats(&stats) == 0) {
+			fputs("-- ", stderr);
+			fprintf(stderr, C_("rpcli", "Device: %" PRIu64 " read commands, %" PRIu64 " bytes transferred, %" PRIu64 " cache hits, %" PRIu64 " cache misses"),
+				stats.commands, stats.bytes, stats.hits, stats.misses);
+			fputc('\n', stderr);
+			fflush(stderr);
+		}
+	}
+
+	if (ioTrace) {
+		IoTrace::setActive(nullptr);
+		PrintIoTraceSummary(*ioTrace);
+		if (pTraceJSON) {
+			AppendIoTraceJSON(*pTraceJSON, *ioTrace, filename);
+		}
+	}
+
+	return ret;
 }
 
 /**
@@ -481,10 +823,10 @@ static void ShowUsage(void)
 	// TODO: Use argv[0] instead of hard-coding 'rpcli'?
 
 #ifdef ENABLE_DECRYPTION	
-	fputs(C_("rpcli", "Usage: rpcli [-k] [-c] [-p] [-j] [-l lang] [[-xN outfile]... [-mN outfile]... [-a apngoutfile] filename]..."), stderr);
+	fputs(C_("rpcli", "Usage: rpcli [-k] [-c] [-p] [-j] [-M] [-b] [-t] [-T tracefile] [-l lang] [[-xN outfile]... [-mN outfile]... [-a apngoutfile] [-rN]... filename]..."), stderr);
 	fputc('\n', stderr);
 #else /* !ENABLE_DECRYPTION */
-	fputs(C_("rpcli", "Usage: rpcli [-c] [-p] [-j] [-l lang] [[-xN outfile]... [-mN outfile]... [-a apngoutfile] filename]..."), stderr);
+	fputs(C_("rpcli", "Usage: rpcli [-c] [-p] [-j] [-M] [-b] [-t] [-T tracefile] [-l lang] [[-xN outfile]... [-mN outfile]... [-a apngoutfile] [-rN]... filename]..."), stderr);
 	fputc('\n', stderr);
 #endif /* ENABLE_DECRYPTION */
 
@@ -502,10 +844,15 @@ static void ShowUsage(void)
 		{"  -p:  ", NOP_C_("rpcli", "Print system path information.")},
 		{"  -d:  ", NOP_C_("rpcli", "Skip ListData fields with more than 10 items. [text only]")},
 		{"  -j:  ", NOP_C_("rpcli", "Use JSON output format.")},
+		{"  -M:  ", NOP_C_("rpcli", "Memory-map files for zero-copy access.")},
+		{"  -b:  ", NOP_C_("rpcli", "Use buffered file I/O and print cache statistics.")},
+		{"  -t:  ", NOP_C_("rpcli", "Trace file I/O and print a summary.")},
+		{"  -T:  ", NOP_C_("rpcli", "Trace file I/O and write the full trace to tracefile in JSON format.")},
 		{"  -l:  ", NOP_C_("rpcli", "Retrieve the specified language from the ROM image.")},
 		{"  -xN: ", NOP_C_("rpcli", "Extract image N to outfile in PNG format.")},
 		{"  -mN: ", NOP_C_("rpcli", "Extract mipmap level N to outfile in PNG format.")},
 		{"  -a:  ", NOP_C_("rpcli", "Extract the animated icon to outfile in APNG format.")},
+		{"  -rN: ", NOP_C_("rpcli", "Run ROM operation N, e.g. hash verification. (Ctrl-C to cancel)")},
 	};
 
 	for (const auto &p : cmds) {
@@ -626,6 +973,7 @@ int RP_C_API _tmain(int argc, TCHAR *argv[])
 	// DoFile parameters
 	bool json = false;
 	vector<ExtractParam> extract;
+	vector<int> romOps;
 
 	for (int i = 1; i < argc; i++) { // figure out the json mode in advance
 		if (argv[i][0] == _T('-')) {
@@ -660,6 +1008,11 @@ int RP_C_API _tmain(int argc, TCHAR *argv[])
 	bool inq_ata_packet = false;
 #endif /* RP_OS_SCSI_SUPPORTED */
 	uint32_t lc = 0;
+	bool useMmap = false;
+	bool buffered = false;
+	bool trace = false;
+	const TCHAR *traceJSON = nullptr;
+	string traceJSONFiles;	// Traced files, written after all files are processed
 	bool first = true;
 	int ret = 0;
 	for (int i = 1; i < argc; i++){
@@ -724,6 +1077,22 @@ int RP_C_API _tmain(int argc, TCHAR *argv[])
 				flags |= LibRpBase::OF_SkipInternalImages;
 				break;
 			}
+			case _T('M'):
+				// Memory-map files.
+				useMmap = true;
+				break;
+			case _T('b'):
+				// Use BufferedFile and print cache statistics.
+				buffered = true;
+				break;
+			case _T('t'):
+				// Trace file I/O and print a summary.
+				trace = true;
+				break;
+			case _T('T'):
+				// Trace file I/O and write the full trace as JSON.
+				traceJSON = argv[++i];
+				break;
 			case _T('d'): {
 				// Skip RFT_LISTDATA with more than 10 items. (Text only)
 				flags |= LibRpBase::OF_SkipListDataMoreThan10;
@@ -756,6 +1125,12 @@ int RP_C_API _tmain(int argc, TCHAR *argv[])
 			case _T('a'):
 				extract.emplace_back(argv[++i], -1);
 				break;
+			case _T('r'):
+				// Run a ROM operation.
+				// NOTE: Invalid IDs are reported by RunRomOps(),
+				// along with a list of valid ROM operations.
+				romOps.push_back(static_cast<int>(_ttol(argv[i] + 2)));
+				break;
 			case _T('j'): // do nothing
 			case _T('J'): // still do nothing
 				break;
@@ -819,7 +1194,10 @@ int RP_C_API _tmain(int argc, TCHAR *argv[])
 #endif /* RP_OS_SCSI_SUPPORTED */
 			{
 				// Regular file.
-				DoFile(argv[i], json, extract, lc, flags);
+				if (DoFile(argv[i], json, extract, romOps, lc, flags, useMmap, buffered, trace,
+					(traceJSON ? &traceJSONFiles : nullptr)) != 0) {
+					ret = EXIT_FAILURE;
+				}
 			}
 
 #ifdef RP_OS_SCSI_SUPPORTED
@@ -828,6 +1206,7 @@ int RP_C_API _tmain(int argc, TCHAR *argv[])
 			inq_ata_packet = false;
 #endif /* RP_OS_SCSI_SUPPORTED */
 			extract.clear();
+			romOps.clear();
 		}
 	}
 	if (json) {
@@ -835,6 +1214,11 @@ int RP_C_API _tmain(int argc, TCHAR *argv[])
 		cout.flush();
 	}
 
+	if (traceJSON) {
+		// Write the I/O traces of all files.
+		WriteIoTraceJSON(traceJSONFiles, traceJSON);
+	}
+
 #ifdef _WIN32
 	// Shut down GDI+.
 	GdiplusHelper::ShutdownGDIPlus(gdipToken);
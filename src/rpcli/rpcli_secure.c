@@ -42,7 +42,19 @@ int rpcli_do_security_options(void)
 		SCMP_SYS(gettimeofday),	// 32-bit only?
 		SCMP_SYS(ioctl),	// for devices; also afl-fuzz
 		SCMP_SYS(lseek), SCMP_SYS(_llseek),
+		SCMP_SYS(pread64), SCMP_SYS(preadv),	// IRpFile::readAt(), readAtV()
+		SCMP_SYS(fadvise64), SCMP_SYS(fadvise64_64),	// IRpFile::advise()
+		SCMP_SYS(arm_fadvise64_64),	// CPU-specific syscall for Linux on 32-bit ARM
+		SCMP_SYS(madvise),	// IRpFile::advise() [memory-mapped files]
 		SCMP_SYS(lstat), SCMP_SYS(lstat64),	// LibRpBase::FileSystem::is_symlink(), resolve_symlink()
+		SCMP_SYS(mkdir),	// FileSystem::rmkdir() [GzIndex::saveIndexToCache()]
+		SCMP_SYS(rename), SCMP_SYS(renameat),	// GzIndex::saveIndexToCache()
+#if defined(__SNR_renameat2)
+		SCMP_SYS(renameat2),	// GzIndex::saveIndexToCache() [glibc on some architectures]
+#elif defined(__NR_renameat2)
+		__NR_renameat2,		// GzIndex::saveIndexToCache() [glibc on some architectures]
+#endif /* __SNR_renameat2 || __NR_renameat2 */
+		SCMP_SYS(unlink), SCMP_SYS(unlinkat),	// GzIndex::saveIndexToCache() [on error]
 		SCMP_SYS(mmap), SCMP_SYS(mmap2),
 		SCMP_SYS(mprotect),	// dlopen()
 		SCMP_SYS(munmap),